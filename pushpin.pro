@@ -6,3 +6,9 @@ tools.subdir = tools
 tools.depends = src
 
 SUBDIRS += src tools
+
+# run the benchmark targets and compare against this host's committed
+#   baseline. see tools/perf-baselines/README.md
+checkperf.target = check-perf
+checkperf.commands = python $$PWD/tools/checkperf.py --build-dir $$OUT_PWD
+QMAKE_EXTRA_TARGETS += checkperf
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "blockpool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+#include "log.h"
+
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+// registry of live pools, for logStatus
+static BlockPool *g_pools = 0;
+
+static bool g_hugePages = false;
+
+BlockPool::BlockPool(const char *name, size_t blockSize, int blocksPerSlab) :
+	name_(name),
+	blocksPerSlab_(blocksPerSlab),
+	freeList_(0),
+	inUse_(0)
+{
+	assert(blocksPerSlab > 0);
+
+	// a free block must fit in the space, and keeping blocks aligned
+	//   to 16 is good for any member type
+	if(blockSize < sizeof(FreeBlock))
+		blockSize = sizeof(FreeBlock);
+	blockSize_ = (blockSize + 15) & ~(size_t)15;
+
+	nextPool_ = g_pools;
+	g_pools = this;
+}
+
+BlockPool::~BlockPool()
+{
+	assert(inUse_ == 0);
+
+	foreach(const Slab &slab, slabs_)
+	{
+		if(slab.huge)
+			::free(slab.p);
+		else
+			delete [] slab.p;
+	}
+
+	BlockPool **at = &g_pools;
+	while(*at && *at != this)
+		at = &((*at)->nextPool_);
+	if(*at)
+		*at = nextPool_;
+}
+
+size_t BlockPool::blockSize() const
+{
+	return blockSize_;
+}
+
+quint64 BlockPool::blocksInUse() const
+{
+	return inUse_;
+}
+
+quint64 BlockPool::bytesReserved() const
+{
+	quint64 total = 0;
+	foreach(const Slab &slab, slabs_)
+		total += (quint64)slab.blocks * blockSize_;
+
+	return total;
+}
+
+void *BlockPool::alloc()
+{
+	if(!freeList_)
+	{
+		Slab slab;
+		slab.blocks = blocksPerSlab_;
+		slab.huge = false;
+
+#ifdef Q_OS_LINUX
+		if(g_hugePages)
+		{
+			// size and align slabs to whole huge pages, so the kernel
+			//   can back them with 2M mappings
+			if(slab.blocks < (int)(HUGE_PAGE_SIZE / blockSize_))
+				slab.blocks = (int)(HUGE_PAGE_SIZE / blockSize_);
+
+			size_t size = ((slab.blocks * blockSize_) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+			void *p;
+			if(posix_memalign(&p, HUGE_PAGE_SIZE, size) == 0)
+			{
+				madvise(p, size, MADV_HUGEPAGE);
+
+				slab.p = (char *)p;
+				slab.blocks = (int)(size / blockSize_);
+				slab.huge = true;
+			}
+		}
+#endif
+
+		if(!slab.huge)
+			slab.p = new char[blockSize_ * slab.blocks];
+
+		slabs_ += slab;
+
+		for(int n = 0; n < slab.blocks; ++n)
+		{
+			FreeBlock *b = (FreeBlock *)(slab.p + ((size_t)n * blockSize_));
+			b->next = freeList_;
+			freeList_ = b;
+		}
+	}
+
+	FreeBlock *b = freeList_;
+	freeList_ = b->next;
+	++inUse_;
+
+	return b;
+}
+
+void BlockPool::free(void *p)
+{
+	if(!p)
+		return;
+
+	FreeBlock *b = (FreeBlock *)p;
+	b->next = freeList_;
+	freeList_ = b;
+	--inUse_;
+}
+
+void BlockPool::setHugePagesEnabled(bool on)
+{
+	// only consulted on linux. harmless to set elsewhere
+	g_hugePages = on;
+}
+
+void BlockPool::logStatus()
+{
+	for(BlockPool *p = g_pools; p; p = p->nextPool_)
+	{
+		log_info("pool %s: in-use=%llu reserved=%llu bytes",
+			p->name_,
+			(unsigned long long)p->inUse_,
+			(unsigned long long)p->bytesReserved());
+	}
+}
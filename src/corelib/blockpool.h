@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef BLOCKPOOL_H
+#define BLOCKPOOL_H
+
+#include <stddef.h>
+#include <QList>
+
+// fixed-size block allocator for high-churn objects. blocks are carved
+//   out of larger slabs and recycled through a free list, so repeated
+//   session setup/teardown reuses the same memory instead of
+//   fragmenting the heap. slabs are retained for the life of the pool.
+//   intended use is overriding operator new/delete of a specific class.
+//   not thread safe
+class BlockPool
+{
+public:
+	BlockPool(const char *name, size_t blockSize, int blocksPerSlab = 256);
+	~BlockPool();
+
+	size_t blockSize() const;
+	quint64 blocksInUse() const;
+	quint64 bytesReserved() const;
+
+	void *alloc();
+	void free(void *p);
+
+	// log one line per live pool, showing usage per subsystem
+	static void logStatus();
+
+	// back slabs allocated from now on with transparent hugepages:
+	//   slabs are sized and aligned to whole huge pages and advised
+	//   with MADV_HUGEPAGE, shrinking the tlb footprint of large
+	//   pools. linux only; a no-op elsewhere. set at startup, before
+	//   the pools see traffic
+	static void setHugePagesEnabled(bool on);
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock *next;
+	};
+
+	struct Slab
+	{
+		char *p;
+		int blocks;
+		bool huge;
+	};
+
+	const char *name_;
+	size_t blockSize_;
+	int blocksPerSlab_;
+	QList<Slab> slabs_;
+	FreeBlock *freeList_;
+	quint64 inUse_;
+	BlockPool *nextPool_;
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "busypoller.h"
+
+#include <QTimer>
+#include <QElapsedTimer>
+
+class BusyPoller::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	BusyPoller *q;
+	int idleTimeout;
+	QTimer *spinTimer;
+	QElapsedTimer lastActivity;
+
+	Private(BusyPoller *_q) :
+		QObject(_q),
+		q(_q),
+		idleTimeout(0)
+	{
+		// a pending zero-interval timer makes the event loop poll fds
+		//   with no timeout instead of blocking, which is the whole
+		//   mechanism. the slot only decides whether to re-arm
+		spinTimer = new QTimer(this);
+		connect(spinTimer, &QTimer::timeout, this, &Private::spin_timeout);
+
+		spinTimer->setSingleShot(true);
+	}
+
+	~Private()
+	{
+		spinTimer->disconnect(this);
+		spinTimer->setParent(0);
+		spinTimer->deleteLater();
+	}
+
+	void activity()
+	{
+		lastActivity.start();
+
+		if(!spinTimer->isActive())
+			spinTimer->start(0);
+	}
+
+private slots:
+	void spin_timeout()
+	{
+		if(lastActivity.elapsed() < idleTimeout)
+			spinTimer->start(0);
+
+		// else: go idle. the next activity() starts a new spin
+	}
+};
+
+BusyPoller::BusyPoller(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+BusyPoller::~BusyPoller()
+{
+	delete d;
+}
+
+void BusyPoller::setIdleTimeout(int msecs)
+{
+	d->idleTimeout = msecs;
+}
+
+void BusyPoller::activity()
+{
+	d->activity();
+}
+
+#include "busypoller.moc"
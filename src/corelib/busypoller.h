@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2018 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef BUSYPOLLER_H
+#define BUSYPOLLER_H
+
+#include <QObject>
+
+// opt-in low-latency mode that trades cpu for wakeup latency. while
+//   active, a zero-interval timer keeps the event loop from blocking,
+//   so each iteration polls the socket fds with no timeout and ready
+//   messages are picked up within microseconds instead of after a
+//   sleeping-poll wakeup. callers report traffic on latency-critical
+//   sockets via activity(); spinning stops once no activity has been
+//   reported for the idle timeout, and normal sleeping poll resumes.
+//   best combined with the runner's cpu_affinity so the spin burns a
+//   dedicated core
+
+class BusyPoller : public QObject
+{
+	Q_OBJECT
+
+public:
+	// spins the event loop of the current thread
+	BusyPoller(QObject *parent = 0);
+	~BusyPoller();
+
+	// time (msecs) to keep spinning after the last reported activity
+	void setIdleTimeout(int msecs);
+
+	// report traffic. starts spinning, or extends the current spin
+	void activity();
+
+private:
+	class Private;
+	Private *d;
+};
+
+#endif
@@ -44,9 +44,17 @@ SOURCES += \
 	$$PWD/packet/zrpcresponsepacket.cpp
 
 HEADERS += \
+	$$PWD/tnetstringview.h \
+	$$PWD/timerwheel.h \
+	$$PWD/histogram.h \
+	$$PWD/blockpool.h \
+	$$PWD/stablehash.h \
+	$$PWD/rid.h \
+	$$PWD/tracepoints.h \
 	$$PWD/logutil.h \
 	$$PWD/uuidutil.h \
 	$$PWD/zutil.h \
+	$$PWD/zpubsubbroker.h \
 	$$PWD/httprequest.h \
 	$$PWD/websocket.h \
 	$$PWD/zhttpmanager.h \
@@ -58,12 +66,19 @@ HEADERS += \
 	$$PWD/inspectdata.h \
 	$$PWD/cors.h \
 	$$PWD/statsmanager.h \
+	$$PWD/eventloopprofiler.h \
+	$$PWD/busypoller.h \
 	$$PWD/settings.h
 
 SOURCES += \
+	$$PWD/tnetstringview.cpp \
+	$$PWD/timerwheel.cpp \
+	$$PWD/histogram.cpp \
+	$$PWD/blockpool.cpp \
 	$$PWD/logutil.cpp \
 	$$PWD/uuidutil.cpp \
 	$$PWD/zutil.cpp \
+	$$PWD/zpubsubbroker.cpp \
 	$$PWD/zhttpmanager.cpp \
 	$$PWD/zhttprequest.cpp \
 	$$PWD/zwebsocket.cpp \
@@ -72,4 +87,6 @@ SOURCES += \
 	$$PWD/statusreasons.cpp \
 	$$PWD/cors.cpp \
 	$$PWD/statsmanager.cpp \
+	$$PWD/eventloopprofiler.cpp \
+	$$PWD/busypoller.cpp \
 	$$PWD/settings.cpp
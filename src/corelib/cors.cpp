@@ -61,30 +61,46 @@ static bool headerNameStartsWith(const QByteArray &name, const char *value)
 
 void applyCorsHeaders(const HttpHeaders &requestHeaders, HttpHeaders *responseHeaders)
 {
-	if(!responseHeaders->contains("Access-Control-Allow-Methods"))
+	// this runs on every response of a cross-origin route, so build the
+	//   constant names/values once instead of converting from literals
+	//   each time
+	static const QByteArray allowMethodsName("Access-Control-Allow-Methods");
+	static const QByteArray allowHeadersName("Access-Control-Allow-Headers");
+	static const QByteArray exposeHeadersName("Access-Control-Expose-Headers");
+	static const QByteArray allowCredentialsName("Access-Control-Allow-Credentials");
+	static const QByteArray allowOriginName("Access-Control-Allow-Origin");
+	static const QByteArray maxAgeName("Access-Control-Max-Age");
+	static const QByteArray requestMethodName("Access-Control-Request-Method");
+	static const QByteArray requestHeadersName("Access-Control-Request-Headers");
+	static const QByteArray defaultAllowMethods("OPTIONS, HEAD, GET, POST, PUT, DELETE");
+	static const QByteArray trueValue("true");
+	static const QByteArray anyOrigin("*");
+	static const QByteArray defaultMaxAge("3600");
+
+	if(!responseHeaders->contains(allowMethodsName))
 	{
-		QByteArray method = requestHeaders.get("Access-Control-Request-Method");
+		QByteArray method = requestHeaders.get(requestMethodName);
 
 		if(!method.isEmpty())
-			*responseHeaders += HttpHeader("Access-Control-Allow-Methods", method);
+			*responseHeaders += HttpHeader(allowMethodsName, method);
 		else
-			*responseHeaders += HttpHeader("Access-Control-Allow-Methods", "OPTIONS, HEAD, GET, POST, PUT, DELETE");
+			*responseHeaders += HttpHeader(allowMethodsName, defaultAllowMethods);
 	}
 
-	if(!responseHeaders->contains("Access-Control-Allow-Headers"))
+	if(!responseHeaders->contains(allowHeadersName))
 	{
 		QList<QByteArray> allowHeaders;
-		foreach(const QByteArray &h, requestHeaders.getAll("Access-Control-Request-Headers", true))
+		foreach(const QByteArray &h, requestHeaders.getAll(requestHeadersName, true))
 		{
 			if(!h.isEmpty())
 				allowHeaders += h;
 		}
 
 		if(!allowHeaders.isEmpty())
-			*responseHeaders += HttpHeader("Access-Control-Allow-Headers", HttpHeaders::join(allowHeaders));
+			*responseHeaders += HttpHeader(allowHeadersName, HttpHeaders::join(allowHeaders));
 	}
 
-	if(!responseHeaders->contains("Access-Control-Expose-Headers"))
+	if(!responseHeaders->contains(exposeHeadersName))
 	{
 		QList<QByteArray> exposeHeaders;
 		foreach(const HttpHeader &h, *responseHeaders)
@@ -94,24 +110,24 @@ void applyCorsHeaders(const HttpHeaders &requestHeaders, HttpHeaders *responseHe
 		}
 
 		if(!exposeHeaders.isEmpty())
-			*responseHeaders += HttpHeader("Access-Control-Expose-Headers", HttpHeaders::join(exposeHeaders));
+			*responseHeaders += HttpHeader(exposeHeadersName, HttpHeaders::join(exposeHeaders));
 	}
 
-	if(!responseHeaders->contains("Access-Control-Allow-Credentials"))
-		*responseHeaders += HttpHeader("Access-Control-Allow-Credentials", "true");
+	if(!responseHeaders->contains(allowCredentialsName))
+		*responseHeaders += HttpHeader(allowCredentialsName, trueValue);
 
-	if(!responseHeaders->contains("Access-Control-Allow-Origin"))
+	if(!responseHeaders->contains(allowOriginName))
 	{
 		QByteArray origin = requestHeaders.get("Origin");
 
 		if(origin.isEmpty())
-			origin = "*";
+			origin = anyOrigin;
 
-		*responseHeaders += HttpHeader("Access-Control-Allow-Origin", origin);
+		*responseHeaders += HttpHeader(allowOriginName, origin);
 	}
 
-	if(!responseHeaders->contains("Access-Control-Max-Age"))
-		*responseHeaders += HttpHeader("Access-Control-Max-Age", "3600");
+	if(!responseHeaders->contains(maxAgeName))
+		*responseHeaders += HttpHeader(maxAgeName, defaultMaxAge);
 }
 
 }
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "eventloopprofiler.h"
+
+#include <assert.h>
+#include <QAbstractEventDispatcher>
+#include <QElapsedTimer>
+#include "log.h"
+#include "statsmanager.h"
+#include "tracepoints.h"
+
+class EventLoopProfiler::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	EventLoopProfiler *q;
+	StatsManager *stats;
+	int stallThreshold; // msecs. 0 or less means disabled
+	QElapsedTimer elapsed;
+	bool awake;
+
+	Private(EventLoopProfiler *_q, StatsManager *_stats) :
+		QObject(_q),
+		q(_q),
+		stats(_stats),
+		stallThreshold(-1),
+		awake(false)
+	{
+		QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+		assert(dispatcher);
+
+		connect(dispatcher, &QAbstractEventDispatcher::awake, this, &Private::dispatcher_awake);
+		connect(dispatcher, &QAbstractEventDispatcher::aboutToBlock, this, &Private::dispatcher_aboutToBlock);
+	}
+
+private slots:
+	void dispatcher_awake()
+	{
+		elapsed.start();
+		awake = true;
+	}
+
+	void dispatcher_aboutToBlock()
+	{
+		// aboutToBlock can fire without a preceding awake during
+		//   nested loops. only count complete iterations
+		if(!awake)
+			return;
+
+		awake = false;
+
+		int msec = (int)elapsed.elapsed();
+
+		stats->addEventLoopIteration(msec);
+
+		if(stallThreshold > 0 && msec >= stallThreshold)
+		{
+			TRACEPOINT1(event_loop_stall, msec);
+
+			stats->addEventLoopStall();
+
+			log_warning("event loop iteration took %dms", msec);
+		}
+	}
+};
+
+EventLoopProfiler::EventLoopProfiler(StatsManager *stats, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, stats);
+}
+
+EventLoopProfiler::~EventLoopProfiler()
+{
+	delete d;
+}
+
+void EventLoopProfiler::setStallThreshold(int msec)
+{
+	d->stallThreshold = msec;
+}
+
+#include "eventloopprofiler.moc"
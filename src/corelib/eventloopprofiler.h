@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef EVENTLOOPPROFILER_H
+#define EVENTLOOPPROFILER_H
+
+#include <QObject>
+
+class StatsManager;
+
+// opt-in event loop observability. measures the duration of each event
+//   loop iteration (from waking up to blocking again) and feeds it into
+//   StatsManager, where it is exposed as a histogram. iterations at or
+//   above the stall threshold are additionally counted, logged, and
+//   announced through the event_loop_stall tracepoint, so long stalls
+//   can be attributed in production by correlating with the lifecycle
+//   tracepoints that fired during the same window
+
+class EventLoopProfiler : public QObject
+{
+	Q_OBJECT
+
+public:
+	// observes the event loop of the current thread
+	EventLoopProfiler(StatsManager *stats, QObject *parent = 0);
+	~EventLoopProfiler();
+
+	// iterations taking at least this long (msecs) count as stalls.
+	//   0 or less disables stall detection but keeps the histogram
+	void setStallThreshold(int msec);
+
+private:
+	class Private;
+	Private *d;
+};
+
+#endif
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "histogram.h"
+
+#define SUB_BUCKETS 16
+
+// largest representable value. anything bigger is clamped into the top
+//   bucket. 2^30 msec is about 12 days, far beyond any sane latency
+#define VALUE_MAX ((qint64(1) << 30) - 1)
+
+// shifts range 0-26 (2^30 >> 26 = 16), so the top index is 26*16+31
+#define BUCKET_COUNT 448
+
+// for a value v normalized so that (v >> shift) falls in
+//   [SUB_BUCKETS, SUB_BUCKETS*2), the index is
+//   (shift * SUB_BUCKETS) + (v >> shift). values below SUB_BUCKETS use
+//   shift 0 and index exactly
+static int bucketIndex(qint64 value)
+{
+	int shift = 0;
+	qint64 v = value;
+	while(v >= SUB_BUCKETS * 2)
+	{
+		v >>= 1;
+		++shift;
+	}
+
+	return (shift * SUB_BUCKETS) + (int)v;
+}
+
+// upper bound of the value range covered by a bucket
+static qint64 bucketUpperValue(int index)
+{
+	if(index < SUB_BUCKETS)
+		return index;
+
+	int shift = (index / SUB_BUCKETS) - 1;
+	qint64 m = SUB_BUCKETS + (index % SUB_BUCKETS);
+	return ((m + 1) << shift) - 1;
+}
+
+Histogram::Histogram() :
+	buckets_(BUCKET_COUNT),
+	count_(0),
+	max_(0)
+{
+}
+
+bool Histogram::isEmpty() const
+{
+	return (count_ == 0);
+}
+
+quint64 Histogram::count() const
+{
+	return count_;
+}
+
+qint64 Histogram::maxValue() const
+{
+	return max_;
+}
+
+void Histogram::add(qint64 value)
+{
+	if(value < 0)
+		value = 0;
+	else if(value > VALUE_MAX)
+		value = VALUE_MAX;
+
+	++buckets_[bucketIndex(value)];
+	++count_;
+
+	if(value > max_)
+		max_ = value;
+}
+
+qint64 Histogram::percentile(double p) const
+{
+	if(count_ == 0)
+		return 0;
+
+	if(p < 0.0)
+		p = 0.0;
+	else if(p > 1.0)
+		p = 1.0;
+
+	quint64 target = (quint64)(p * count_);
+	if(target < 1)
+		target = 1;
+
+	quint64 seen = 0;
+	for(int n = 0; n < buckets_.count(); ++n)
+	{
+		seen += buckets_[n];
+		if(seen >= target)
+		{
+			// don't report beyond the largest recorded value
+			return qMin(bucketUpperValue(n), max_);
+		}
+	}
+
+	return max_;
+}
+
+void Histogram::clear()
+{
+	buckets_.fill(0);
+	count_ = 0;
+	max_ = 0;
+}
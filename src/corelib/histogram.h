@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <QVector>
+
+// log-bucketed histogram, intended for recording latencies in
+//   milliseconds. values are grouped with 16 sub-buckets per power of
+//   two (~6% relative precision), so memory use is small and fixed
+//   regardless of sample count and percentile queries are a single
+//   bucket scan
+class Histogram
+{
+public:
+	Histogram();
+
+	bool isEmpty() const;
+	quint64 count() const;
+	qint64 maxValue() const;
+
+	void add(qint64 value);
+
+	// return an upper bound of the value at the given percentile
+	//   (0.0-1.0), e.g. 0.999 for p999
+	qint64 percentile(double p) const;
+
+	void clear();
+
+private:
+	QVector<quint32> buckets_;
+	quint64 count_;
+	qint64 max_;
+};
+
+#endif
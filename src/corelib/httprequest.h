@@ -53,7 +53,25 @@ public:
 		ErrorRequestTooLarge
 	};
 
-	HttpRequest(QObject *parent = 0) : QObject(parent) {}
+	// receives the per-chunk callbacks as direct virtual calls,
+	//   bypassing signal dispatch. for the data path only; lifecycle
+	//   events (paused, error) remain signals
+	class Listener
+	{
+	public:
+		virtual ~Listener() {}
+
+		virtual void requestReadyRead(HttpRequest *req) = 0;
+		virtual void requestBytesWritten(HttpRequest *req, int count) = 0;
+	};
+
+	HttpRequest(QObject *parent = 0) : QObject(parent), listener_(0) {}
+
+	// when a listener is set, readyRead and bytesWritten are delivered
+	//   to it instead of being emitted, saving the metacall dispatch
+	//   and argument marshalling on every chunk. one listener at most;
+	//   pass 0 to return to signal delivery
+	void setListener(Listener *listener) { listener_ = listener; }
 
 	virtual QHostAddress peerAddress() const = 0;
 
@@ -96,6 +114,28 @@ signals:
 	void bytesWritten(int count);
 	void paused();
 	void error();
+
+protected:
+	// subclasses report data events through these rather than emitting
+	//   the signals themselves, so the listener fast path applies
+	void emitReadyRead()
+	{
+		if(listener_)
+			listener_->requestReadyRead(this);
+		else
+			emit readyRead();
+	}
+
+	void emitBytesWritten(int count)
+	{
+		if(listener_)
+			listener_->requestBytesWritten(this, count);
+		else
+			emit bytesWritten(count);
+	}
+
+private:
+	Listener *listener_;
 };
 
 #endif
@@ -131,6 +131,11 @@ static void logPacket(int level, const QVariant &data, const QString &contentFie
 
 void logVariant(int level, const QVariant &data, const char *fmt, ...)
 {
+	// stringifying the data is costly, so don't bother unless the
+	//   message will actually be output
+	if(level > log_outputLevel())
+		return;
+
 	va_list ap;
 	va_start(ap, fmt);
 	logPacket(level, data, fmt, ap);
@@ -139,6 +144,9 @@ void logVariant(int level, const QVariant &data, const char *fmt, ...)
 
 void logByteArray(int level, const QByteArray &content, const char *fmt, ...)
 {
+	if(level > log_outputLevel())
+		return;
+
 	va_list ap;
 	va_start(ap, fmt);
 	logPacket(level, content, fmt, ap);
@@ -147,6 +155,9 @@ void logByteArray(int level, const QByteArray &content, const char *fmt, ...)
 
 void logVariantWithContent(int level, const QVariant &data, const QString &contentField, const char *fmt, ...)
 {
+	if(level > log_outputLevel())
+		return;
+
 	va_list ap;
 	va_start(ap, fmt);
 	logPacket(level, data, contentField, fmt, ap);
@@ -155,6 +166,9 @@ void logVariantWithContent(int level, const QVariant &data, const QString &conte
 
 void logRequest(int level, const RequestData &data, const Config &config)
 {
+	if(level > log_outputLevel())
+		return;
+
 	QString msg = QString("%1 %2").arg(data.requestData.method, data.requestData.uri.toString(QUrl::FullyEncoded));
 
 	if(!data.targetStr.isEmpty())
@@ -28,6 +28,15 @@
 
 #include "retryrequestpacket.h"
 
+#include "tnetstring.h"
+
+// detach a view from the source frame, for values retained beyond
+//   parsing
+static QByteArray copyView(const QByteArray &view)
+{
+	return QByteArray(view.constData(), view.size());
+}
+
 RetryRequestPacket::RetryRequestPacket() :
 	haveInspectInfo(false)
 {
@@ -327,3 +336,327 @@ bool RetryRequestPacket::fromVariant(const QVariant &in)
 
 	return true;
 }
+
+RetryRequestPacket::LazyReader::LazyReader() :
+	haveInspectInfo(false)
+{
+}
+
+bool RetryRequestPacket::LazyReader::start(const QByteArray &frame)
+{
+	TnetStringView root(frame);
+	if(root.type() != TnetStringView::Map)
+		return false;
+
+	frame_ = frame;
+
+	TnetStringView vrequests;
+	TnetStringView vrequestData;
+	TnetStringView vinspect;
+
+	QByteArray key;
+	TnetStringView value;
+	TnetStringView::MapIterator it(root);
+	while(it.next(&key, &value))
+	{
+		if(key == "requests")
+		{
+			if(value.type() != TnetStringView::List)
+				return false;
+
+			vrequests = value;
+		}
+		else if(key == "request-data")
+		{
+			if(value.type() != TnetStringView::Map)
+				return false;
+
+			vrequestData = value;
+		}
+		else if(key == "inspect")
+		{
+			if(value.type() != TnetStringView::Map)
+				return false;
+
+			vinspect = value;
+		}
+	}
+
+	if(!vrequests.isValid() || !vrequestData.isValid())
+		return false;
+
+	bool haveMethod = false;
+	bool haveUri = false;
+	bool haveBody = false;
+
+	TnetStringView::MapIterator dit(vrequestData);
+	while(dit.next(&key, &value))
+	{
+		if(key == "method")
+		{
+			if(value.type() != TnetStringView::ByteArray)
+				return false;
+
+			requestData.method = QString::fromLatin1(value.toByteArray());
+			haveMethod = true;
+		}
+		else if(key == "uri")
+		{
+			if(value.type() != TnetStringView::ByteArray)
+				return false;
+
+			requestData.uri = QUrl::fromEncoded(value.toByteArray(), QUrl::StrictMode);
+			haveUri = true;
+		}
+		else if(key == "headers")
+		{
+			if(value.type() != TnetStringView::List)
+				return false;
+
+			TnetStringView vheader;
+			TnetStringView::ListIterator hit(value);
+			while(hit.next(&vheader))
+			{
+				if(vheader.type() != TnetStringView::List)
+					return false;
+
+				TnetStringView hname;
+				TnetStringView hvalue;
+				TnetStringView::ListIterator pit(vheader);
+				if(!pit.next(&hname) || hname.type() != TnetStringView::ByteArray)
+					return false;
+				if(!pit.next(&hvalue) || hvalue.type() != TnetStringView::ByteArray)
+					return false;
+
+				requestData.headers += HttpHeader(copyView(hname.toByteArray()), copyView(hvalue.toByteArray()));
+			}
+		}
+		else if(key == "body")
+		{
+			if(value.type() != TnetStringView::ByteArray)
+				return false;
+
+			requestData.body = copyView(value.toByteArray());
+			haveBody = true;
+		}
+	}
+
+	if(!haveMethod || !haveUri || !haveBody)
+		return false;
+
+	if(vinspect.isValid())
+	{
+		bool haveNoProxy = false;
+
+		TnetStringView::MapIterator iit(vinspect);
+		while(iit.next(&key, &value))
+		{
+			if(key == "no-proxy")
+			{
+				bool ok;
+				inspectInfo.doProxy = !value.toBool(&ok);
+				if(!ok)
+					return false;
+
+				haveNoProxy = true;
+			}
+			else if(key == "sharing-key")
+			{
+				if(value.type() != TnetStringView::ByteArray)
+					return false;
+
+				inspectInfo.sharingKey = copyView(value.toByteArray());
+			}
+			else if(key == "sid")
+			{
+				if(value.type() != TnetStringView::ByteArray)
+					return false;
+
+				inspectInfo.sid = copyView(value.toByteArray());
+			}
+			else if(key == "last-ids")
+			{
+				if(value.type() != TnetStringView::Map)
+					return false;
+
+				QByteArray lkey;
+				TnetStringView lvalue;
+				TnetStringView::MapIterator lit(value);
+				while(lit.next(&lkey, &lvalue))
+				{
+					if(lvalue.type() != TnetStringView::ByteArray)
+						return false;
+
+					inspectInfo.lastIds.insert(copyView(lkey), copyView(lvalue.toByteArray()));
+				}
+			}
+			else if(key == "user-data")
+			{
+				// subtrees that map to arbitrary variants go through
+				//   the regular parser
+				bool ok;
+				inspectInfo.userData = TnetString::toVariant(frame_, value.offset(), &ok);
+				if(!ok)
+					return false;
+			}
+		}
+
+		if(!haveNoProxy)
+			return false;
+
+		haveInspectInfo = true;
+	}
+
+	requestsIt_ = TnetStringView::ListIterator(vrequests);
+
+	return true;
+}
+
+int RetryRequestPacket::LazyReader::nextRequest(Request *r)
+{
+	TnetStringView vrequest;
+	if(!requestsIt_.next(&vrequest))
+		return 0;
+
+	if(vrequest.type() != TnetStringView::Map)
+		return -1;
+
+	Request out;
+
+	bool haveRid = false;
+	bool haveInSeq = false;
+	bool haveOutSeq = false;
+	bool haveOutCredits = false;
+
+	QByteArray key;
+	TnetStringView value;
+	TnetStringView::MapIterator it(vrequest);
+	while(it.next(&key, &value))
+	{
+		if(key == "rid")
+		{
+			if(value.type() != TnetStringView::Map)
+				return -1;
+
+			QByteArray sender;
+			QByteArray id;
+			bool haveSender = false;
+			bool haveId = false;
+
+			QByteArray rkey;
+			TnetStringView rvalue;
+			TnetStringView::MapIterator rit(value);
+			while(rit.next(&rkey, &rvalue))
+			{
+				if(rkey == "sender")
+				{
+					if(rvalue.type() != TnetStringView::ByteArray)
+						return -1;
+
+					sender = copyView(rvalue.toByteArray());
+					haveSender = true;
+				}
+				else if(rkey == "id")
+				{
+					if(rvalue.type() != TnetStringView::ByteArray)
+						return -1;
+
+					id = copyView(rvalue.toByteArray());
+					haveId = true;
+				}
+			}
+
+			if(!haveSender || !haveId)
+				return -1;
+
+			out.rid = Rid(sender, id);
+			haveRid = true;
+		}
+		else if(key == "https")
+		{
+			bool ok;
+			out.https = value.toBool(&ok);
+			if(!ok)
+				return -1;
+		}
+		else if(key == "peer-address")
+		{
+			if(value.type() != TnetStringView::ByteArray)
+				return -1;
+
+			out.peerAddress = QHostAddress(QString::fromUtf8(value.toByteArray()));
+		}
+		else if(key == "debug")
+		{
+			bool ok;
+			out.debug = value.toBool(&ok);
+			if(!ok)
+				return -1;
+		}
+		else if(key == "auto-cross-origin")
+		{
+			bool ok;
+			out.autoCrossOrigin = value.toBool(&ok);
+			if(!ok)
+				return -1;
+		}
+		else if(key == "jsonp-callback")
+		{
+			if(value.type() != TnetStringView::ByteArray)
+				return -1;
+
+			out.jsonpCallback = copyView(value.toByteArray());
+		}
+		else if(key == "jsonp-extended-response")
+		{
+			bool ok;
+			out.jsonpExtendedResponse = value.toBool(&ok);
+			if(!ok)
+				return -1;
+		}
+		else if(key == "in-seq")
+		{
+			bool ok;
+			out.inSeq = (int)value.toInt(&ok);
+			if(!ok)
+				return -1;
+
+			haveInSeq = true;
+		}
+		else if(key == "out-seq")
+		{
+			bool ok;
+			out.outSeq = (int)value.toInt(&ok);
+			if(!ok)
+				return -1;
+
+			haveOutSeq = true;
+		}
+		else if(key == "out-credits")
+		{
+			bool ok;
+			out.outCredits = (int)value.toInt(&ok);
+			if(!ok)
+				return -1;
+
+			haveOutCredits = true;
+		}
+		else if(key == "user-data")
+		{
+			bool ok;
+			out.userData = TnetString::toVariant(frame_, value.offset(), &ok);
+			if(!ok)
+				return -1;
+		}
+	}
+
+	if(!haveRid || !haveInSeq || !haveOutSeq || !haveOutCredits)
+		return -1;
+
+	// jsonp-extended-response is only meaningful with a callback
+	if(out.jsonpCallback.isEmpty())
+		out.jsonpExtendedResponse = false;
+
+	*r = out;
+	return 1;
+}
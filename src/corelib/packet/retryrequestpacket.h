@@ -32,6 +32,7 @@
 #include <QVariant>
 #include <QHostAddress>
 #include "httprequestdata.h"
+#include "tnetstringview.h"
 
 class RetryRequestPacket
 {
@@ -92,6 +93,36 @@ public:
 
 	QVariant toVariant() const;
 	bool fromVariant(const QVariant &in);
+
+	// lazy decode over the raw tnetstring frame. start() parses the
+	//   shared request data and inspect info once and only locates the
+	//   request entries; each entry is materialized on demand by
+	//   nextRequest(). a mass-retry packet carrying thousands of
+	//   entries can then be executed a few entries per event-loop pass
+	//   without parsing every entry up front. entry fields are copied
+	//   out of the frame, so they stay valid after the reader is gone
+	class LazyReader
+	{
+	public:
+		// shared fields. valid after a successful start()
+		HttpRequestData requestData;
+		bool haveInspectInfo;
+		InspectInfo inspectInfo;
+
+		LazyReader();
+
+		// parses everything except the request entries. returns false
+		//   on malformed input
+		bool start(const QByteArray &frame);
+
+		// materialize the next request entry. returns 1 on success, 0
+		//   at the end of the entries, -1 on malformed input
+		int nextRequest(Request *r);
+
+	private:
+		QByteArray frame_;
+		TnetStringView::ListIterator requestsIt_;
+	};
 };
 
 #endif
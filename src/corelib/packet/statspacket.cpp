@@ -30,6 +30,99 @@
 
 #include <assert.h>
 
+// compact encoding: the frame starts with a varint packet type,
+//   followed by fields. each field starts with a varint header of
+//   (id << 2) | wire type. wire types: 0 = varint value, 1 = length
+//   prefixed bytes, 2 = flag with no payload. unknown ids can be
+//   skipped by wire type, so fields may be added without breaking
+//   old readers
+
+#define WIRE_VARINT 0
+#define WIRE_BYTES 1
+#define WIRE_FLAG 2
+
+enum CompactField
+{
+	CF_From = 1,
+	CF_Route = 2,
+	CF_Count = 3,
+	CF_ConnectionId = 4,
+	CF_ConnectionType = 5,
+	CF_PeerAddress = 6,
+	CF_Ssl = 7,
+	CF_Ttl = 8,
+	CF_Mode = 9,
+	CF_Channel = 10,
+	CF_ItemId = 11,
+	CF_Transport = 12,
+	CF_Blocks = 13,
+	CF_Subscribers = 14,
+	CF_Seq = 15,
+	CF_ConnectionsMax = 16,
+	CF_ConnectionsMinutes = 17,
+	CF_MessagesReceived = 18,
+	CF_MessagesSent = 19,
+	CF_HttpResponseMessagesSent = 20,
+	CF_MessagesDropped = 21,
+	CF_BlocksReceived = 22,
+	CF_BlocksSent = 23,
+	CF_Duration = 24,
+	CF_MessageLatency = 25
+};
+
+static void appendVarint(QByteArray *out, quint64 value)
+{
+	while(value >= 0x80)
+	{
+		*out += (char)((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+
+	*out += (char)value;
+}
+
+static bool readVarint(const QByteArray &in, int *pos, quint64 *value)
+{
+	quint64 v = 0;
+	int shift = 0;
+
+	while(*pos < in.size() && shift <= 63)
+	{
+		quint8 b = (quint8)in[*pos];
+		++(*pos);
+
+		v |= (quint64)(b & 0x7f) << shift;
+
+		if(!(b & 0x80))
+		{
+			*value = v;
+			return true;
+		}
+
+		shift += 7;
+	}
+
+	return false;
+}
+
+static void appendIntField(QByteArray *out, int id, quint64 value)
+{
+	appendVarint(out, ((quint64)id << 2) | WIRE_VARINT);
+	appendVarint(out, value);
+}
+
+static void appendBytesField(QByteArray *out, int id, const QByteArray &value)
+{
+	appendVarint(out, ((quint64)id << 2) | WIRE_BYTES);
+	appendVarint(out, (quint64)value.size());
+	*out += value;
+}
+
+static void appendFlagField(QByteArray *out, int id)
+{
+	appendVarint(out, ((quint64)id << 2) | WIRE_FLAG);
+}
+
 QVariant StatsPacket::toVariant() const
 {
 	QVariantHash obj;
@@ -92,6 +185,9 @@ QVariant StatsPacket::toVariant() const
 		obj["mode"] = mode;
 		obj["channel"] = channel;
 
+		if(seq >= 0)
+			obj["seq"] = seq;
+
 		if(type == Subscribed)
 		{
 			obj["ttl"] = ttl;
@@ -116,12 +212,16 @@ QVariant StatsPacket::toVariant() const
 			obj["sent"] = messagesSent;
 		if(httpResponseMessagesSent != -1)
 			obj["http-response-sent"] = httpResponseMessagesSent;
+		if(messagesDropped != -1)
+			obj["dropped"] = messagesDropped;
 		if(blocksReceived >= 0)
 			obj["blocks-received"] = blocksReceived;
 		if(blocksSent >= 0)
 			obj["blocks-sent"] = blocksSent;
 		if(duration >= 0)
 			obj["duration"] = duration;
+		if(!messageLatency.isEmpty())
+			obj["message-latency"] = messageLatency;
 	}
 
 	return obj;
@@ -295,6 +395,16 @@ bool StatsPacket::fromVariant(const QByteArray &_type, const QVariant &in)
 					return false;
 			}
 		}
+
+		if(obj.contains("seq"))
+		{
+			if(!obj["seq"].canConvert(QVariant::LongLong))
+				return false;
+
+			seq = obj["seq"].toLongLong();
+			if(seq < 0)
+				return false;
+		}
 	}
 	else if(_type == "report")
 	{
@@ -338,6 +448,14 @@ bool StatsPacket::fromVariant(const QByteArray &_type, const QVariant &in)
 			httpResponseMessagesSent = obj["http-response-sent"].toInt();
 		}
 
+		if(obj.contains("dropped"))
+		{
+			if(!obj["dropped"].canConvert(QVariant::Int))
+				return false;
+
+			messagesDropped = obj["dropped"].toInt();
+		}
+
 		if(obj.contains("blocks-received"))
 		{
 			if(!obj["blocks-received"].canConvert(QVariant::Int))
@@ -361,9 +479,254 @@ bool StatsPacket::fromVariant(const QByteArray &_type, const QVariant &in)
 
 			duration = obj["duration"].toInt();
 		}
+
+		if(obj.contains("message-latency"))
+		{
+			if(obj["message-latency"].type() != QVariant::Hash)
+				return false;
+
+			messageLatency = obj["message-latency"].toHash();
+		}
 	}
 	else
 		return false;
 
 	return true;
 }
+
+QByteArray StatsPacket::toCompact() const
+{
+	QByteArray out;
+
+	appendVarint(&out, (quint64)type);
+
+	if(!from.isEmpty())
+		appendBytesField(&out, CF_From, from);
+
+	if(!route.isEmpty())
+		appendBytesField(&out, CF_Route, route);
+
+	if(type == Activity)
+	{
+		appendIntField(&out, CF_Count, (quint64)qMax(count, 0));
+	}
+	else if(type == Message)
+	{
+		appendBytesField(&out, CF_Channel, channel);
+
+		if(!itemId.isNull())
+			appendBytesField(&out, CF_ItemId, itemId);
+
+		appendIntField(&out, CF_Count, (quint64)qMax(count, 0));
+
+		if(blocks >= 0)
+			appendIntField(&out, CF_Blocks, (quint64)blocks);
+
+		appendBytesField(&out, CF_Transport, transport);
+	}
+	else if(type == Connected || type == Disconnected)
+	{
+		appendBytesField(&out, CF_ConnectionId, connectionId);
+
+		if(type == Connected)
+		{
+			appendIntField(&out, CF_ConnectionType, (connectionType == WebSocket) ? 1 : 0);
+			appendBytesField(&out, CF_PeerAddress, peerAddress.toString().toUtf8());
+
+			if(ssl)
+				appendFlagField(&out, CF_Ssl);
+
+			appendIntField(&out, CF_Ttl, (quint64)qMax(ttl, 0));
+		}
+	}
+	else if(type == Subscribed || type == Unsubscribed)
+	{
+		appendBytesField(&out, CF_Mode, mode);
+		appendBytesField(&out, CF_Channel, channel);
+
+		if(seq >= 0)
+			appendIntField(&out, CF_Seq, (quint64)seq);
+
+		if(type == Subscribed)
+		{
+			appendIntField(&out, CF_Ttl, (quint64)qMax(ttl, 0));
+
+			if(subscribers >= 0)
+				appendIntField(&out, CF_Subscribers, (quint64)subscribers);
+		}
+	}
+	else // Report
+	{
+		if(connectionsMax != -1)
+			appendIntField(&out, CF_ConnectionsMax, (quint64)connectionsMax);
+		if(connectionsMinutes != -1)
+			appendIntField(&out, CF_ConnectionsMinutes, (quint64)connectionsMinutes);
+		if(messagesReceived != -1)
+			appendIntField(&out, CF_MessagesReceived, (quint64)messagesReceived);
+		if(messagesSent != -1)
+			appendIntField(&out, CF_MessagesSent, (quint64)messagesSent);
+		if(httpResponseMessagesSent != -1)
+			appendIntField(&out, CF_HttpResponseMessagesSent, (quint64)httpResponseMessagesSent);
+		if(messagesDropped != -1)
+			appendIntField(&out, CF_MessagesDropped, (quint64)messagesDropped);
+		if(blocksReceived >= 0)
+			appendIntField(&out, CF_BlocksReceived, (quint64)blocksReceived);
+		if(blocksSent >= 0)
+			appendIntField(&out, CF_BlocksSent, (quint64)blocksSent);
+		if(duration >= 0)
+			appendIntField(&out, CF_Duration, (quint64)duration);
+
+		if(!messageLatency.isEmpty())
+		{
+			// transport -> percentiles, as nested count-prefixed maps
+			QByteArray buf;
+			appendVarint(&buf, (quint64)messageLatency.count());
+
+			QHashIterator<QString, QVariant> it(messageLatency);
+			while(it.hasNext())
+			{
+				it.next();
+
+				QByteArray key = it.key().toUtf8();
+				appendVarint(&buf, (quint64)key.size());
+				buf += key;
+
+				QVariantHash percentiles = it.value().toHash();
+				appendVarint(&buf, (quint64)percentiles.count());
+
+				QHashIterator<QString, QVariant> pit(percentiles);
+				while(pit.hasNext())
+				{
+					pit.next();
+
+					QByteArray pkey = pit.key().toUtf8();
+					appendVarint(&buf, (quint64)pkey.size());
+					buf += pkey;
+
+					appendVarint(&buf, (quint64)qMax(pit.value().toLongLong(), (qint64)0));
+				}
+			}
+
+			appendBytesField(&out, CF_MessageLatency, buf);
+		}
+	}
+
+	return out;
+}
+
+static bool readBytes(const QByteArray &in, int *pos, QByteArray *out)
+{
+	quint64 len;
+	if(!readVarint(in, pos, &len) || (quint64)(in.size() - *pos) < len)
+		return false;
+
+	*out = in.mid(*pos, (int)len);
+	*pos += (int)len;
+
+	return true;
+}
+
+bool StatsPacket::fromCompact(const QByteArray &in)
+{
+	int pos = 0;
+	quint64 v;
+
+	if(!readVarint(in, &pos, &v) || v > (quint64)Report)
+		return false;
+
+	type = (Type)v;
+
+	while(pos < in.size())
+	{
+		quint64 header;
+		if(!readVarint(in, &pos, &header))
+			return false;
+
+		int id = (int)(header >> 2);
+		int wire = (int)(header & 3);
+
+		QByteArray bytes;
+		quint64 value = 0;
+
+		if(wire == WIRE_VARINT)
+		{
+			if(!readVarint(in, &pos, &value))
+				return false;
+		}
+		else if(wire == WIRE_BYTES)
+		{
+			if(!readBytes(in, &pos, &bytes))
+				return false;
+		}
+		else if(wire != WIRE_FLAG)
+			return false;
+
+		switch(id)
+		{
+			case CF_From: from = bytes; break;
+			case CF_Route: route = bytes; break;
+			case CF_Count: count = (int)value; break;
+			case CF_ConnectionId: connectionId = bytes; break;
+			case CF_ConnectionType: connectionType = (value == 1) ? WebSocket : Http; break;
+			case CF_PeerAddress:
+				if(!peerAddress.setAddress(QString::fromUtf8(bytes)))
+					return false;
+				break;
+			case CF_Ssl: ssl = true; break;
+			case CF_Ttl: ttl = (int)value; break;
+			case CF_Mode: mode = bytes; break;
+			case CF_Channel: channel = bytes; break;
+			case CF_ItemId: itemId = bytes; break;
+			case CF_Transport: transport = bytes; break;
+			case CF_Blocks: blocks = (int)value; break;
+			case CF_Subscribers: subscribers = (int)value; break;
+			case CF_Seq: seq = (qint64)value; break;
+			case CF_ConnectionsMax: connectionsMax = (int)value; break;
+			case CF_ConnectionsMinutes: connectionsMinutes = (int)value; break;
+			case CF_MessagesReceived: messagesReceived = (int)value; break;
+			case CF_MessagesSent: messagesSent = (int)value; break;
+			case CF_HttpResponseMessagesSent: httpResponseMessagesSent = (int)value; break;
+			case CF_MessagesDropped: messagesDropped = (int)value; break;
+			case CF_BlocksReceived: blocksReceived = (int)value; break;
+			case CF_BlocksSent: blocksSent = (int)value; break;
+			case CF_Duration: duration = (int)value; break;
+			case CF_MessageLatency:
+			{
+				int bpos = 0;
+				quint64 transports;
+				if(!readVarint(bytes, &bpos, &transports))
+					return false;
+
+				for(quint64 n = 0; n < transports; ++n)
+				{
+					QByteArray key;
+					if(!readBytes(bytes, &bpos, &key))
+						return false;
+
+					quint64 pcount;
+					if(!readVarint(bytes, &bpos, &pcount))
+						return false;
+
+					QVariantHash percentiles;
+					for(quint64 k = 0; k < pcount; ++k)
+					{
+						QByteArray pkey;
+						quint64 pvalue;
+						if(!readBytes(bytes, &bpos, &pkey) || !readVarint(bytes, &bpos, &pvalue))
+							return false;
+
+						percentiles[QString::fromUtf8(pkey)] = (qint64)pvalue;
+					}
+
+					messageLatency[QString::fromUtf8(key)] = percentiles;
+				}
+
+				break;
+			}
+			default:
+				break; // unknown field, skip
+		}
+	}
+
+	return true;
+}
@@ -68,14 +68,17 @@ public:
 	QByteArray transport; // message
 	int blocks; // message
 	int subscribers; // subscribed
+	qint64 seq; // subscribed, unsubscribed. for gap detection
 	int connectionsMax; // report
 	int connectionsMinutes; // report
 	int messagesReceived; // report
 	int messagesSent; // report
 	int httpResponseMessagesSent; // report
+	int messagesDropped; // report
 	int blocksReceived; // report
 	int blocksSent; // report
 	int duration; // report
+	QVariantHash messageLatency; // report: transport -> percentiles
 
 	StatsPacket() :
 		type((Type)-1),
@@ -85,11 +88,13 @@ public:
 		ttl(-1),
 		blocks(-1),
 		subscribers(-1),
+		seq(-1),
 		connectionsMax(-1),
 		connectionsMinutes(-1),
 		messagesReceived(-1),
 		messagesSent(-1),
 		httpResponseMessagesSent(-1),
+		messagesDropped(-1),
 		blocksReceived(-1),
 		blocksSent(-1),
 		duration(-1)
@@ -98,6 +103,12 @@ public:
 
 	QVariant toVariant() const;
 	bool fromVariant(const QByteArray &type, const QVariant &in);
+
+	// compact binary encoding: field ids and varints instead of a
+	//   tnetstring map with string keys. the packet type is part of
+	//   the frame, so the result is self-describing
+	QByteArray toCompact() const;
+	bool fromCompact(const QByteArray &in);
 };
 
 #endif
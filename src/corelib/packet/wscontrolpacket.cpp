@@ -29,6 +29,7 @@
 #include "wscontrolpacket.h"
 
 #include <assert.h>
+#include <stdio.h>
 
 // FIXME: rewrite packet class using this code?
 /*class WsControlPacket
@@ -155,6 +156,202 @@ public:
 	}
 };*/
 
+// direct tnetstring writers, for encoding without a QVariant
+//   intermediate. payload sizes are computed up front so each element
+//   is written in one forward pass
+
+static int numDigits(int n)
+{
+	int digits = 1;
+	while(n >= 10)
+	{
+		n /= 10;
+		++digits;
+	}
+
+	return digits;
+}
+
+// encoded size of an element with the given payload size: length
+//   digits, colon, payload, type char
+static int elementSize(int payloadSize)
+{
+	return numDigits(payloadSize) + 1 + payloadSize + 1;
+}
+
+static void appendHeader(QByteArray *out, int payloadSize)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%d:", payloadSize);
+	out->append(buf, len);
+}
+
+static void appendString(QByteArray *out, const char *data, int size)
+{
+	appendHeader(out, size);
+	out->append(data, size);
+	out->append(',');
+}
+
+static void appendString(QByteArray *out, const QByteArray &s)
+{
+	appendString(out, s.constData(), s.size());
+}
+
+static void appendInt(QByteArray *out, int value)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%d", value);
+	appendHeader(out, len);
+	out->append(buf, len);
+	out->append('#');
+}
+
+static const char *itemTypeString(WsControlPacket::Item::Type type)
+{
+	switch(type)
+	{
+		case WsControlPacket::Item::Here:           return "here";
+		case WsControlPacket::Item::KeepAlive:      return "keep-alive";
+		case WsControlPacket::Item::Gone:           return "gone";
+		case WsControlPacket::Item::Grip:           return "grip";
+		case WsControlPacket::Item::KeepAliveSetup: return "keep-alive-setup";
+		case WsControlPacket::Item::Cancel:         return "cancel";
+		case WsControlPacket::Item::Send:           return "send";
+		case WsControlPacket::Item::NeedKeepAlive:  return "need-keep-alive";
+		case WsControlPacket::Item::Subscribe:      return "subscribe";
+		case WsControlPacket::Item::Close:          return "close";
+		case WsControlPacket::Item::Detach:         return "detach";
+		case WsControlPacket::Item::Ack:            return "ack";
+		default:
+			assert(0);
+			return 0;
+	}
+}
+
+// must stay in step with appendItem below
+static int itemPayloadSize(const WsControlPacket::Item &item, const char *typeStr, const QByteArray &uriEnc)
+{
+	int size = 0;
+
+	size += elementSize(3) + elementSize(item.cid.size()); // cid
+	size += elementSize(4) + elementSize(qstrlen(typeStr)); // type
+
+	if(!item.requestId.isEmpty())
+		size += elementSize(6) + elementSize(item.requestId.size()); // req-id
+
+	if(!uriEnc.isEmpty())
+		size += elementSize(3) + elementSize(uriEnc.size()); // uri
+
+	if(!item.contentType.isEmpty())
+		size += elementSize(12) + elementSize(item.contentType.size()); // content-type
+
+	if(!item.message.isNull())
+		size += elementSize(7) + elementSize(item.message.size()); // message
+
+	if(item.queue)
+		size += elementSize(5) + 7; // queue, "4:true!"
+
+	if(item.code >= 0)
+		size += elementSize(4) + elementSize(numDigits(item.code)); // code
+
+	if(!item.route.isEmpty())
+		size += elementSize(5) + elementSize(item.route.size()); // route
+
+	if(!item.channelPrefix.isEmpty())
+		size += elementSize(14) + elementSize(item.channelPrefix.size()); // channel-prefix
+
+	if(!item.channel.isEmpty())
+		size += elementSize(7) + elementSize(item.channel.size()); // channel
+
+	if(item.ttl >= 0)
+		size += elementSize(3) + elementSize(numDigits(item.ttl)); // ttl
+
+	if(item.timeout >= 0)
+		size += elementSize(7) + elementSize(numDigits(item.timeout)); // timeout
+
+	return size;
+}
+
+static void appendItem(QByteArray *out, const WsControlPacket::Item &item, const char *typeStr, const QByteArray &uriEnc)
+{
+	appendHeader(out, itemPayloadSize(item, typeStr, uriEnc));
+
+	appendString(out, "cid", 3);
+	appendString(out, item.cid);
+
+	appendString(out, "type", 4);
+	appendString(out, typeStr, qstrlen(typeStr));
+
+	if(!item.requestId.isEmpty())
+	{
+		appendString(out, "req-id", 6);
+		appendString(out, item.requestId);
+	}
+
+	if(!uriEnc.isEmpty())
+	{
+		appendString(out, "uri", 3);
+		appendString(out, uriEnc);
+	}
+
+	if(!item.contentType.isEmpty())
+	{
+		appendString(out, "content-type", 12);
+		appendString(out, item.contentType);
+	}
+
+	if(!item.message.isNull())
+	{
+		appendString(out, "message", 7);
+		appendString(out, item.message);
+	}
+
+	if(item.queue)
+	{
+		appendString(out, "queue", 5);
+		out->append("4:true!", 7);
+	}
+
+	if(item.code >= 0)
+	{
+		appendString(out, "code", 4);
+		appendInt(out, item.code);
+	}
+
+	if(!item.route.isEmpty())
+	{
+		appendString(out, "route", 5);
+		appendString(out, item.route);
+	}
+
+	if(!item.channelPrefix.isEmpty())
+	{
+		appendString(out, "channel-prefix", 14);
+		appendString(out, item.channelPrefix);
+	}
+
+	if(!item.channel.isEmpty())
+	{
+		appendString(out, "channel", 7);
+		appendString(out, item.channel);
+	}
+
+	if(item.ttl >= 0)
+	{
+		appendString(out, "ttl", 3);
+		appendInt(out, item.ttl);
+	}
+
+	if(item.timeout >= 0)
+	{
+		appendString(out, "timeout", 7);
+		appendInt(out, item.timeout);
+	}
+
+	out->append('}');
+}
+
 QVariant WsControlPacket::toVariant() const
 {
 	QVariantHash obj;
@@ -222,10 +419,57 @@ QVariant WsControlPacket::toVariant() const
 		vitems += vitem;
 	}
 
+	if(!from.isEmpty())
+		obj["from"] = from;
+
 	obj["items"] = vitems;
 	return obj;
 }
 
+void WsControlPacket::toTnetString(QByteArray *out) const
+{
+	// keep the capacity across calls, so a reused buffer stops
+	//   allocating once it reaches working size
+	out->resize(0);
+
+	int itemsPayload = 0;
+	foreach(const Item &item, items)
+	{
+		QByteArray uriEnc = (!item.uri.isEmpty() ? item.uri.toEncoded() : QByteArray());
+		itemsPayload += elementSize(itemPayloadSize(item, itemTypeString(item.type), uriEnc));
+	}
+
+	int objPayload = 0;
+
+	if(!from.isEmpty())
+		objPayload += elementSize(4) + elementSize(from.size()); // from
+
+	objPayload += elementSize(5) + elementSize(itemsPayload); // items
+
+	out->reserve(elementSize(objPayload));
+
+	appendHeader(out, objPayload);
+
+	if(!from.isEmpty())
+	{
+		appendString(out, "from", 4);
+		appendString(out, from);
+	}
+
+	appendString(out, "items", 5);
+	appendHeader(out, itemsPayload);
+
+	foreach(const Item &item, items)
+	{
+		QByteArray uriEnc = (!item.uri.isEmpty() ? item.uri.toEncoded() : QByteArray());
+		appendItem(out, item, itemTypeString(item.type), uriEnc);
+	}
+
+	out->append(']');
+
+	out->append('}');
+}
+
 bool WsControlPacket::fromVariant(const QVariant &in)
 {
 	if(in.type() != QVariant::Hash)
@@ -233,6 +477,14 @@ bool WsControlPacket::fromVariant(const QVariant &in)
 
 	QVariantHash obj = in.toHash();
 
+	if(obj.contains("from"))
+	{
+		if(obj["from"].type() != QVariant::ByteArray)
+			return false;
+
+		from = obj["from"].toByteArray();
+	}
+
 	if(!obj.contains("items") || obj["items"].type() != QVariant::List)
 		return false;
 	QVariantList vitems = obj["items"].toList();
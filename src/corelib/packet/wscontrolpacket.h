@@ -80,10 +80,17 @@ public:
 		}
 	};
 
+	QByteArray from; // sender's instance id. may be empty
 	QList<Item> items;
 
 	QVariant toVariant() const;
 	bool fromVariant(const QVariant &in);
+
+	// encode directly as a tnetstring into out, reusing out's existing
+	//   capacity. the high-rate encode path skips the QVariant
+	//   intermediate and stops allocating once the buffer has grown to
+	//   working size
+	void toTnetString(QByteArray *out) const;
 };
 
 #endif
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef RID_H
+#define RID_H
+
+#include <QByteArray>
+#include <QPair>
+#include "stablehash.h"
+
+// identifier of a zhttp conversation: (peer instance address, per
+//   connection id). packet routing looks a rid up in several hash
+//   tables per message, so the hash is computed once here at
+//   construction instead of over both arrays on every lookup. member
+//   names match the QPair this replaced, and conversions to and from
+//   the pair form are provided for packet classes that still use it
+class Rid
+{
+public:
+	QByteArray first;
+	QByteArray second;
+
+	Rid()
+	{
+		computeHash();
+	}
+
+	Rid(const QByteArray &_first, const QByteArray &_second) :
+		first(_first),
+		second(_second)
+	{
+		computeHash();
+	}
+
+	Rid(const QPair<QByteArray, QByteArray> &other) :
+		first(other.first),
+		second(other.second)
+	{
+		computeHash();
+	}
+
+	operator QPair<QByteArray, QByteArray>() const
+	{
+		return QPair<QByteArray, QByteArray>(first, second);
+	}
+
+	bool operator==(const Rid &other) const
+	{
+		// differing rids almost always differ in hash, making this a
+		//   cheap rejection before the byte compares
+		return (hash_ == other.hash_ && second == other.second && first == other.first);
+	}
+
+	bool operator!=(const Rid &other) const
+	{
+		return !(*this == other);
+	}
+
+	quint64 hash() const { return hash_; }
+
+private:
+	quint64 hash_;
+
+	void computeHash()
+	{
+		// mix a constant between the parts so ("ab", "c") and
+		//   ("a", "bc") hash differently
+		hash_ = stableHash64(second, stableHash64(first) ^ 0x9e3779b97f4a7c15ULL);
+	}
+};
+
+inline uint qHash(const Rid &rid, uint seed = 0)
+{
+	quint64 h = rid.hash();
+	return ((uint)(h >> 32) ^ (uint)h) ^ seed;
+}
+
+#endif
@@ -35,10 +35,15 @@
 #include "config.h"
 
 Settings::Settings(const QString &fileName) :
-	include_(0),
 	portOffset_(0)
 {
-	main_ = new QSettings(fileName, QSettings::IniFormat);
+	QSettings main(fileName, QSettings::IniFormat);
+
+	// snapshot everything into a plain hash, so the files are parsed
+	//   exactly once and later reads don't go through QSettings' locked
+	//   backend
+	foreach(const QString &key, main.allKeys())
+		values_.insert(key, main.value(key));
 
 	libdir_ = valueRaw("global/libdir").toString();
 	if(libdir_.isEmpty())
@@ -81,14 +86,19 @@ Settings::Settings(const QString &fileName) :
 		if(fi.isRelative())
 			includeFile = QFileInfo(QFileInfo(fileName).absoluteDir(), includeFile).filePath();
 
-		include_ = new QSettings(includeFile, QSettings::IniFormat);
+		QSettings include(includeFile, QSettings::IniFormat);
+
+		// included values only apply where the main file has no entry
+		foreach(const QString &key, include.allKeys())
+		{
+			if(!values_.contains(key))
+				values_.insert(key, include.value(key));
+		}
 	}
 }
 
 Settings::~Settings()
 {
-	delete include_;
-	delete main_;
 }
 
 QString Settings::resolveVars(const QString &in) const
@@ -132,15 +142,7 @@ QString Settings::resolveVars(const QString &in) const
 
 QVariant Settings::valueRaw(const QString &key, const QVariant &defaultValue) const
 {
-	if(include_)
-	{
-		if(main_->contains(key))
-			return main_->value(key);
-		else
-			return include_->value(key, defaultValue);
-	}
-	else
-		return main_->value(key, defaultValue);
+	return values_.value(key, defaultValue);
 }
 
 QVariant Settings::value(const QString &key, const QVariant &defaultValue) const
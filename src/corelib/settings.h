@@ -31,8 +31,7 @@
 
 #include <QString>
 #include <QVariant>
-
-class QSettings;
+#include <QHash>
 
 class Settings
 {
@@ -48,8 +47,7 @@ public:
 	void setPortOffset(int x);
 
 private:
-	QSettings *main_;
-	QSettings *include_;
+	QHash<QString, QVariant> values_;
 	QString libdir_;
 	QString rundir_;
 	QString ipcPrefix_;
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef STABLEHASH_H
+#define STABLEHASH_H
+
+#include <QByteArray>
+
+// continue an existing hash with more data, e.g. for a compound key,
+//   without concatenating the parts first
+inline quint64 stableHash64(const QByteArray &data, quint64 h)
+{
+	for(int n = 0; n < data.size(); ++n)
+	{
+		h ^= (quint64)(unsigned char)data[n];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+// stable 64-bit hash (FNV-1a). unlike qHash, produces the same value
+//   in every process, and is wide enough that collisions between
+//   fingerprints are negligible
+inline quint64 stableHash64(const QByteArray &data)
+{
+	return stableHash64(data, 14695981039346656037ULL);
+}
+
+#endif
@@ -36,6 +36,7 @@
 #include "qzmqsocket.h"
 #include "log.h"
 #include "tnetstring.h"
+#include "histogram.h"
 #include "packet/statspacket.h"
 #include "zutil.h"
 
@@ -48,6 +49,9 @@
 #define SHOULD_PROCESS_TIME(x) (x * 3 / 4)
 #define MUST_PROCESS_TIME(x) (x * 4 / 5)
 
+#define EXTERNAL_PACKET_BATCH_MAX 500
+#define EXTERNAL_PACKET_QUEUE_MAX 100000
+
 class StatsManager::Private : public QObject
 {
 	Q_OBJECT
@@ -64,6 +68,8 @@ public:
 		qint64 lastRefresh;
 		int refreshBucket;
 		bool linger;
+		bool pendingIndex; // waiting to be folded into the refresh indexes
+		bool dead; // removed while pending; owned by the index queue
 		qint64 lastReport;
 		QByteArray from; // external
 		int ttl; // external
@@ -74,6 +80,8 @@ public:
 			lastRefresh(-1),
 			refreshBucket(-1),
 			linger(false),
+			pendingIndex(false),
+			dead(false),
 			lastReport(-1),
 			ttl(-1),
 			lastActive(-1)
@@ -106,22 +114,27 @@ public:
 		QByteArray routeId;
 		int connectionsMax;
 		bool connectionsMaxStale;
+		int externalConnectionsMax; // sum over peer instances
 		int connectionsMinutes;
 		int messagesReceived;
 		int messagesSent;
 		int httpResponseMessagesSent;
+		int messagesDropped;
 		int blocksReceived;
 		int blocksSent;
+		QHash<QString, Histogram> latencyByTransport;
 		qint64 lastUpdate;
 		qint64 startTime;
 
 		Report() :
 			connectionsMax(0),
 			connectionsMaxStale(true),
+			externalConnectionsMax(0),
 			connectionsMinutes(0),
 			messagesReceived(0),
 			messagesSent(0),
 			httpResponseMessagesSent(0),
+			messagesDropped(0),
 			blocksReceived(-1),
 			blocksSent(-1),
 			lastUpdate(-1),
@@ -132,10 +145,12 @@ public:
 		bool isEmpty() const
 		{
 			return (connectionsMax == 0 &&
+				externalConnectionsMax == 0 &&
 				connectionsMinutes == 0 &&
 				messagesReceived == 0 &&
 				messagesSent == 0 &&
 				httpResponseMessagesSent == 0 &&
+				messagesDropped == 0 &&
 				blocksReceived <= 0 &&
 				blocksSent <= 0);
 		}
@@ -152,6 +167,7 @@ public:
 	int subscriptionTtl;
 	int subscriptionLinger;
 	int reportInterval;
+	StatsManager::OutputFormat outputFormat;
 	QZmq::Socket *sock;
 	QHash<QByteArray, int> routeActivity;
 	QHash<QByteArray, ConnectionInfo*> connectionInfoById;
@@ -159,14 +175,55 @@ public:
 	QMap<QPair<qint64, ConnectionInfo*>, ConnectionInfo*> connectionInfoByLastRefresh;
 	QVector<QSet<ConnectionInfo*> > connectionInfoRefreshBuckets;
 	int currentConnectionInfoRefreshBucket;
+
+	// connections waiting to be folded into the refresh indexes. recording
+	//   a connect is just a hash insert and a list append; the periodic
+	//   refresh pass does the ordered-map and bucket work in batch, and a
+	//   connection that disconnects before the next pass never touches
+	//   them at all
+	QList<ConnectionInfo*> connectionIndexQueue;
 	QHash<QByteArray, QHash<QByteArray, ConnectionInfo*> > externalConnectionInfoByFrom;
 	QHash<QByteArray, QSet<ConnectionInfo*> > externalConnectionInfoByRoute;
 	QMap<QPair<qint64, ConnectionInfo*>, ConnectionInfo*> externalConnectionInfoByLastActive;
+
+	// external conn packets are queued and applied in bounded batches
+	//   from a zero-interval timer, so a peer refresh flood can't stall
+	//   the event loop. keyed dedupe collapses repeat refreshes for the
+	//   same connection while they wait
+	QList<StatsPacket> externalPacketQueue;
+	QHash<QPair<QByteArray, QByteArray>, qint64> externalPacketSeqs; // (from, conn id) -> seq
+	qint64 externalPacketBase; // seq of the queue head
+	QTimer *externalPacketTimer;
 	QHash<SubscriptionKey, Subscription*> subscriptionsByKey;
 	QMap<QPair<qint64, Subscription*>, Subscription*> subscriptionsByLastRefresh;
 	QVector<QSet<Subscription*> > subscriptionRefreshBuckets;
 	int currentSubscriptionRefreshBucket;
 	QHash<QByteArray, Report*> reports;
+
+	// per-instance counter stamped on subscribed/unsubscribed packets.
+	//   consumers tracking it can treat periodic refreshes as redundant
+	//   and detect dropped messages, resyncing via the recover command
+	qint64 subSeq;
+
+	// cumulative process-lifetime counters, for the prometheus endpoint.
+	//   unlike the report counters, these are never reset
+	quint64 totalActivity;
+	quint64 totalMessagesReceived;
+	quint64 totalMessagesSent;
+	quint64 totalHttpResponseMessagesSent;
+	quint64 totalMessagesDropped;
+	quint64 totalBlocksReceived;
+	quint64 totalBlocksSent;
+	QHash<QByteArray, quint64> zmqHwmHits; // by socket name
+	qint64 publishSpoolBytes; // -1 means no spool configured
+	qint64 retainedBodyBytes; // -1 means no pool configured
+	quint64 retainedBodyEvictions;
+	qint64 routeHeldBytes; // -1 means no budget accounting
+	quint64 routeHoldsRejected;
+	Histogram eventLoopIterations;
+	quint64 eventLoopStalls;
+
+	QByteArray metricsBuf;
 	QTimer *activityTimer;
 	QTimer *reportTimer;
 	QTimer *refreshTimer;
@@ -180,9 +237,26 @@ public:
 		subscriptionTtl(60 * 1000),
 		subscriptionLinger(60 * 1000),
 		reportInterval(10 * 1000),
+		outputFormat(StatsManager::TnetStringFormat),
+		subSeq(0),
+		totalActivity(0),
+		totalMessagesReceived(0),
+		totalMessagesSent(0),
+		totalHttpResponseMessagesSent(0),
+		totalMessagesDropped(0),
+		totalBlocksReceived(0),
+		totalBlocksSent(0),
+		publishSpoolBytes(-1),
+		retainedBodyBytes(-1),
+		retainedBodyEvictions(0),
+		routeHeldBytes(-1),
+		routeHoldsRejected(0),
+		eventLoopStalls(0),
 		sock(0),
 		currentConnectionInfoRefreshBucket(0),
 		currentSubscriptionRefreshBucket(0),
+		externalPacketBase(0),
+		externalPacketTimer(0),
 		reportTimer(0)
 	{
 		activityTimer = new QTimer(this);
@@ -223,8 +297,23 @@ public:
 			refreshTimer = 0;
 		}
 
+		if(externalPacketTimer)
+		{
+			externalPacketTimer->setParent(0);
+			externalPacketTimer->disconnect(this);
+			externalPacketTimer->deleteLater();
+			externalPacketTimer = 0;
+		}
+
 		qDeleteAll(connectionInfoById);
 
+		// dead queued connections are no longer in the id table
+		foreach(ConnectionInfo *c, connectionIndexQueue)
+		{
+			if(c->dead)
+				delete c;
+		}
+
 		QMutableHashIterator<QByteArray, QHash<QByteArray, ConnectionInfo*> > it(externalConnectionInfoByFrom);
 		while(it.hasNext())
 		{
@@ -356,12 +445,12 @@ public:
 		cs += c;
 
 		assert(c->lastRefresh >= 0);
-		connectionInfoByLastRefresh.insert(QPair<qint64, ConnectionInfo*>(c->lastRefresh, c), c);
-
-		c->refreshBucket = smallestConnectionInfoRefreshBucket();
-		connectionInfoRefreshBuckets[c->refreshBucket] += c;
+		c->pendingIndex = true;
+		connectionIndexQueue += c;
 	}
 
+	// removes c from the tables and deletes it, either now or, if it's
+	//   still in the index queue, when the queue is next drained
 	void removeConnection(ConnectionInfo *c)
 	{
 		connectionInfoById.remove(c->id);
@@ -375,11 +464,40 @@ public:
 				connectionInfoByRoute.remove(c->routeId);
 		}
 
+		if(c->pendingIndex)
+		{
+			c->dead = true;
+			return;
+		}
+
 		if(c->lastRefresh >= 0)
 		{
 			connectionInfoByLastRefresh.remove(QPair<qint64, ConnectionInfo*>(c->lastRefresh, c));
 			connectionInfoRefreshBuckets[c->refreshBucket].remove(c);
 		}
+
+		delete c;
+	}
+
+	void drainConnectionIndexQueue()
+	{
+		foreach(ConnectionInfo *c, connectionIndexQueue)
+		{
+			if(c->dead)
+			{
+				delete c;
+				continue;
+			}
+
+			c->pendingIndex = false;
+
+			connectionInfoByLastRefresh.insert(QPair<qint64, ConnectionInfo*>(c->lastRefresh, c), c);
+
+			c->refreshBucket = smallestConnectionInfoRefreshBucket();
+			connectionInfoRefreshBuckets[c->refreshBucket] += c;
+		}
+
+		connectionIndexQueue.clear();
 	}
 
 	void insertExternalConnection(ConnectionInfo *c)
@@ -420,6 +538,130 @@ public:
 			externalConnectionInfoByLastActive.remove(QPair<qint64, ConnectionInfo*>(c->lastActive, c));
 	}
 
+	void enqueueExternalPacket(const StatsPacket &packet)
+	{
+		QPair<QByteArray, QByteArray> key(packet.from, packet.connectionId);
+
+		qint64 seq = externalPacketSeqs.value(key, -1);
+		if(seq >= 0)
+		{
+			int at = (int)(seq - externalPacketBase);
+			if(externalPacketQueue[at].type == packet.type)
+			{
+				// a newer packet of the same kind supersedes the queued one
+				externalPacketQueue[at] = packet;
+				return;
+			}
+		}
+
+		if(externalPacketQueue.count() >= EXTERNAL_PACKET_QUEUE_MAX)
+		{
+			// a dropped refresh is repaired by the peer's next refresh
+			//   cycle, and expiry is ttl-based anyway
+			log_debug("stats: external packet queue full, dropping");
+			return;
+		}
+
+		externalPacketSeqs[key] = externalPacketBase + externalPacketQueue.count();
+		externalPacketQueue += packet;
+
+		if(!externalPacketTimer)
+		{
+			externalPacketTimer = new QTimer(this);
+			connect(externalPacketTimer, &QTimer::timeout, this, &Private::externalPackets_timeout);
+			externalPacketTimer->setSingleShot(true);
+		}
+
+		if(!externalPacketTimer->isActive())
+			externalPacketTimer->start(0);
+	}
+
+	void applyExternalPacket(const StatsPacket &packet)
+	{
+		// can't add an external connection with same ID as local
+		if(packet.type == StatsPacket::Connected && connectionInfoById.contains(packet.connectionId))
+			return;
+
+		// if the connection exists under a different from address, remove it.
+		// note: this iterates over all the known external sources, which at
+		//   at the time of this writing is almost certainly just 1 (a single
+		//   pushpin-proxy source).
+		QList<ConnectionInfo*> toDelete;
+		QHashIterator<QByteArray, QHash<QByteArray, ConnectionInfo*> > it(externalConnectionInfoByFrom);
+		while(it.hasNext())
+		{
+			it.next();
+			const QByteArray &from = it.key();
+
+			if(from == packet.from)
+				continue;
+
+			const QHash<QByteArray, ConnectionInfo*> &otherConnectionInfoById = it.value();
+
+			ConnectionInfo *c = otherConnectionInfoById.value(packet.connectionId);
+			if(c)
+				toDelete += c;
+		}
+		foreach(ConnectionInfo *c, toDelete)
+		{
+			removeExternalConnection(c);
+			delete c;
+		}
+
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+		QHash<QByteArray, ConnectionInfo*> &extConnectionInfoById = externalConnectionInfoByFrom[packet.from];
+
+		if(packet.type == StatsPacket::Connected)
+		{
+			// add/update
+			ConnectionInfo *c = extConnectionInfoById.value(packet.connectionId);
+			if(!c)
+			{
+				c = new ConnectionInfo;
+				c->id = packet.connectionId;
+				c->routeId = packet.route;
+				c->type = packet.connectionType == StatsPacket::Http ? StatsManager::Http : StatsManager::WebSocket;
+				c->peerAddress = packet.peerAddress;
+				c->ssl = packet.ssl;
+				c->lastReport = now;
+				c->from = packet.from;
+				c->lastActive = now;
+				insertExternalConnection(c);
+
+				updateConnectionsMax(c->routeId, now);
+
+				Report *report = getOrCreateReport(c->routeId);
+				++(report->connectionsMinutes); // minutes are rounded up so count one immediately
+			}
+			else
+			{
+				c->ttl = packet.ttl;
+
+				// move to the end
+				externalConnectionInfoByLastActive.remove(QPair<qint64, ConnectionInfo*>(c->lastActive, c));
+				c->lastActive = now;
+				externalConnectionInfoByLastActive.insert(QPair<qint64, ConnectionInfo*>(c->lastActive, c), c);
+			}
+
+			updateConnectionsMinutes(c, now);
+		}
+		else // Disconnected
+		{
+			ConnectionInfo *c = extConnectionInfoById.value(packet.connectionId);
+			if(!c)
+				return;
+
+			QByteArray routeId = c->routeId;
+
+			updateConnectionsMinutes(c, now);
+			removeExternalConnection(c);
+			delete c;
+
+			updateConnectionsMax(routeId, now);
+		}
+	}
+
 	void insertSubscription(Subscription *s)
 	{
 		SubscriptionKey subKey(s->mode, s->channel);
@@ -481,11 +723,22 @@ public:
 		else // Report
 			prefix = "report";
 
-		QVariant vpacket = packet.toVariant();
-		QByteArray buf = prefix + " T" + TnetString::fromVariant(vpacket);
+		QByteArray buf;
+		if(outputFormat == StatsManager::CompactFormat)
+		{
+			buf = prefix + " B" + packet.toCompact();
+
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("stats: OUT %s (compact, %d bytes)", prefix.data(), buf.size());
+		}
+		else
+		{
+			QVariant vpacket = packet.toVariant();
+			buf = prefix + " T" + TnetString::fromVariant(vpacket);
 
-		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-			log_debug("stats: OUT %s %s", prefix.data(), qPrintable(TnetString::variantToString(vpacket, -1)));
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("stats: OUT %s %s", prefix.data(), qPrintable(TnetString::variantToString(vpacket, -1)));
+		}
 
 		sock->write(QList<QByteArray>() << buf);
 	}
@@ -564,6 +817,7 @@ public:
 		p.channel = s->channel.toUtf8();
 		p.ttl = subscriptionTtl / 1000;
 		p.subscribers = s->subscriberCount;
+		p.seq = subSeq++;
 		write(p);
 	}
 
@@ -577,6 +831,7 @@ public:
 		p.from = instanceId;
 		p.mode = s->mode.toUtf8();
 		p.channel = s->channel.toUtf8();
+		p.seq = subSeq++;
 		write(p);
 	}
 
@@ -690,7 +945,6 @@ public:
 			//   owns the connection now
 
 			removeConnection(c);
-			delete c;
 		}
 
 		if(!refreshedIds.isEmpty())
@@ -815,6 +1069,28 @@ private slots:
 		routeActivity.clear();
 	}
 
+	void externalPackets_timeout()
+	{
+		int processed = 0;
+		while(!externalPacketQueue.isEmpty() && processed < EXTERNAL_PACKET_BATCH_MAX)
+		{
+			StatsPacket packet = externalPacketQueue.takeFirst();
+
+			QPair<QByteArray, QByteArray> key(packet.from, packet.connectionId);
+			if(externalPacketSeqs.value(key, -1) == externalPacketBase)
+				externalPacketSeqs.remove(key);
+
+			++externalPacketBase;
+
+			applyExternalPacket(packet);
+			++processed;
+		}
+
+		// let the event loop breathe between batches
+		if(!externalPacketQueue.isEmpty())
+			externalPacketTimer->start(0);
+	}
+
 	void report_timeout()
 	{
 		qint64 now = QDateTime::currentMSecsSinceEpoch();
@@ -840,23 +1116,50 @@ private slots:
 			p.type = StatsPacket::Report;
 			p.from = instanceId;
 			p.route = routeId;
-			p.connectionsMax = report->connectionsMax;
+			p.connectionsMax = report->connectionsMax + report->externalConnectionsMax;
 			p.connectionsMinutes = report->connectionsMinutes;
 			p.messagesReceived = report->messagesReceived;
 			p.messagesSent = report->messagesSent;
 			p.httpResponseMessagesSent = report->httpResponseMessagesSent;
+			p.messagesDropped = report->messagesDropped;
 			p.blocksReceived = report->blocksReceived;
 			p.blocksSent = report->blocksSent;
 			p.duration = now - report->startTime;
 
+			if(!report->latencyByTransport.isEmpty())
+			{
+				QVariantHash vlatency;
+
+				QHashIterator<QString, Histogram> lit(report->latencyByTransport);
+				while(lit.hasNext())
+				{
+					lit.next();
+					const Histogram &h = lit.value();
+
+					QVariantHash vh;
+					vh["count"] = h.count();
+					vh["p50"] = h.percentile(0.5);
+					vh["p99"] = h.percentile(0.99);
+					vh["p999"] = h.percentile(0.999);
+					vh["max"] = h.maxValue();
+
+					vlatency[lit.key()] = vh;
+				}
+
+				p.messageLatency = vlatency;
+			}
+
 			report->startTime = now;
 			report->connectionsMaxStale = true;
+			report->externalConnectionsMax = 0;
 			report->connectionsMinutes = 0;
 			report->messagesReceived = 0;
 			report->messagesSent = 0;
 			report->httpResponseMessagesSent = 0;
+			report->messagesDropped = 0;
 			report->blocksReceived = -1;
 			report->blocksSent = -1;
+			report->latencyByTransport.clear();
 
 			if(report->isEmpty())
 			{
@@ -884,6 +1187,7 @@ private slots:
 	{
 		qint64 now = QDateTime::currentMSecsSinceEpoch();
 
+		drainConnectionIndexQueue();
 		refreshConnections(now);
 		expireExternalConnections(now);
 		refreshSubscriptions(now);
@@ -940,6 +1244,17 @@ void StatsManager::setReportInterval(int secs)
 	d->setupReportTimer();
 }
 
+void StatsManager::setOutputFormat(OutputFormat format)
+{
+	d->outputFormat = format;
+}
+
+void StatsManager::setCapacityHint(int connections)
+{
+	d->connectionInfoById.reserve(connections);
+	d->externalPacketSeqs.reserve(connections);
+}
+
 void StatsManager::addActivity(const QByteArray &routeId, int count)
 {
 	assert(count >= 0);
@@ -949,6 +1264,8 @@ void StatsManager::addActivity(const QByteArray &routeId, int count)
 	else
 		d->routeActivity[routeId] = count;
 
+	d->totalActivity += count;
+
 	if(!d->activityTimer->isActive())
 		d->activityTimer->start(ACTIVITY_TIMEOUT);
 }
@@ -966,10 +1283,7 @@ void StatsManager::addConnection(const QByteArray &id, const QByteArray &routeId
 	//   it back to us for retrying
 	Private::ConnectionInfo *c = d->connectionInfoById.value(id);
 	if(c)
-	{
 		d->removeConnection(c);
-		delete c;
-	}
 
 	qint64 now = QDateTime::currentMSecsSinceEpoch();
 
@@ -1041,17 +1355,24 @@ void StatsManager::removeConnection(const QByteArray &id, bool linger)
 			// hack to ensure full linger time honored by refresh processing
 			qint64 lingerStartTime = now + (d->connectionLinger - MUST_PROCESS_TIME(d->connectionTtl));
 
-			// move to the end
-			d->connectionInfoByLastRefresh.remove(QPair<qint64, Private::ConnectionInfo*>(c->lastRefresh, c));
-			c->lastRefresh = lingerStartTime;
-			d->connectionInfoByLastRefresh.insert(QPair<qint64, Private::ConnectionInfo*>(c->lastRefresh, c), c);
+			if(c->pendingIndex)
+			{
+				// not indexed yet. it'll be inserted with the new time
+				c->lastRefresh = lingerStartTime;
+			}
+			else
+			{
+				// move to the end
+				d->connectionInfoByLastRefresh.remove(QPair<qint64, Private::ConnectionInfo*>(c->lastRefresh, c));
+				c->lastRefresh = lingerStartTime;
+				d->connectionInfoByLastRefresh.insert(QPair<qint64, Private::ConnectionInfo*>(c->lastRefresh, c), c);
+			}
 		}
 	}
 	else
 	{
 		d->sendDisconnected(c);
 		d->removeConnection(c);
-		delete c;
 	}
 
 	if(d->reportInterval > 0)
@@ -1153,6 +1474,10 @@ void StatsManager::removeSubscription(const QString &mode, const QString &channe
 
 void StatsManager::addMessageReceived(const QByteArray &routeId, int blocks)
 {
+	++d->totalMessagesReceived;
+	if(blocks > 0)
+		d->totalBlocksReceived += blocks;
+
 	if(d->reportInterval <= 0)
 		return;
 
@@ -1173,6 +1498,12 @@ void StatsManager::addMessageReceived(const QByteArray &routeId, int blocks)
 
 void StatsManager::addMessageSent(const QByteArray &routeId, const QString &transport, int blocks)
 {
+	++d->totalMessagesSent;
+	if(transport == "http-response")
+		++d->totalHttpResponseMessagesSent;
+	if(blocks > 0)
+		d->totalBlocksSent += blocks;
+
 	if(d->reportInterval <= 0)
 		return;
 
@@ -1194,101 +1525,234 @@ void StatsManager::addMessageSent(const QByteArray &routeId, const QString &tran
 	report->lastUpdate = QDateTime::currentMSecsSinceEpoch();
 }
 
-bool StatsManager::checkConnection(const QByteArray &id)
+void StatsManager::addMessageDropped(const QByteArray &routeId, int count)
 {
-	return d->connectionInfoById.contains(id);
+	d->totalMessagesDropped += count;
+
+	if(d->reportInterval <= 0)
+		return;
+
+	Private::Report *report = d->getOrCreateReport(routeId);
+
+	report->messagesDropped += count;
+
+	report->lastUpdate = QDateTime::currentMSecsSinceEpoch();
 }
 
-void StatsManager::processExternalPacket(const StatsPacket &packet)
+void StatsManager::addMessageLatency(const QByteArray &routeId, const QString &transport, int msec)
 {
 	if(d->reportInterval <= 0)
 		return;
 
-	if(packet.type != StatsPacket::Connected && packet.type != StatsPacket::Disconnected)
-		return;
+	Private::Report *report = d->getOrCreateReport(routeId);
 
-	// can't add an external connection with same ID as local
-	if(packet.type == StatsPacket::Connected && d->connectionInfoById.contains(packet.connectionId))
-		return;
+	report->latencyByTransport[transport].add(msec);
 
-	// if the connection exists under a different from address, remove it.
-	// note: this iterates over all the known external sources, which at
-	//   at the time of this writing is almost certainly just 1 (a single
-	//   pushpin-proxy source).
-	QList<Private::ConnectionInfo*> toDelete;
-	QHashIterator<QByteArray, QHash<QByteArray, Private::ConnectionInfo*> > it(d->externalConnectionInfoByFrom);
-	while(it.hasNext())
-	{
-		it.next();
-		const QByteArray &from = it.key();
+	report->lastUpdate = QDateTime::currentMSecsSinceEpoch();
+}
 
-		if(from == packet.from)
-			continue;
+void StatsManager::addZmqHwmHit(const QByteArray &socket)
+{
+	++d->zmqHwmHits[socket];
+}
 
-		const QHash<QByteArray, Private::ConnectionInfo*> &extConnectionInfoById = it.value();
+void StatsManager::setPublishSpoolDepth(qint64 bytes)
+{
+	d->publishSpoolBytes = bytes;
+}
 
-		Private::ConnectionInfo *c = extConnectionInfoById.value(packet.connectionId);
-		if(c)
-			toDelete += c;
-	}
-	foreach(Private::ConnectionInfo *c, toDelete)
-	{
-		d->removeExternalConnection(c);
-		delete c;
-	}
+void StatsManager::setRetainedBodyPool(qint64 bytes, quint64 evictions)
+{
+	d->retainedBodyBytes = bytes;
+	d->retainedBodyEvictions = evictions;
+}
 
-	qint64 now = QDateTime::currentMSecsSinceEpoch();
+void StatsManager::setRouteBudgetTotals(qint64 heldBytes, quint64 holdsRejected)
+{
+	d->routeHeldBytes = heldBytes;
+	d->routeHoldsRejected = holdsRejected;
+}
 
-	QHash<QByteArray, Private::ConnectionInfo*> &extConnectionInfoById = d->externalConnectionInfoByFrom[packet.from];
+void StatsManager::addEventLoopIteration(int msec)
+{
+	d->eventLoopIterations.add(msec);
+}
+
+void StatsManager::addEventLoopStall()
+{
+	++d->eventLoopStalls;
+}
 
-	if(packet.type == StatsPacket::Connected)
+QByteArray StatsManager::prometheusMetrics()
+{
+	// the buffer is kept at its high-water size, so steady-state
+	//   scrapes render into existing storage
+	QByteArray &buf = d->metricsBuf;
+	buf.resize(0);
+
+	char line[256];
+
+	int written = qsnprintf(line, sizeof(line),
+		"# TYPE pushpin_connections gauge\n"
+		"pushpin_connections %d\n"
+		"# TYPE pushpin_subscriptions gauge\n"
+		"pushpin_subscriptions %d\n",
+		d->connectionInfoById.count(),
+		d->subscriptionsByKey.count());
+	buf.append(line, written);
+
+	written = qsnprintf(line, sizeof(line),
+		"# TYPE pushpin_activity_total counter\n"
+		"pushpin_activity_total %llu\n"
+		"# TYPE pushpin_messages_received_total counter\n"
+		"pushpin_messages_received_total %llu\n",
+		(unsigned long long)d->totalActivity,
+		(unsigned long long)d->totalMessagesReceived);
+	buf.append(line, written);
+
+	written = qsnprintf(line, sizeof(line),
+		"# TYPE pushpin_messages_sent_total counter\n"
+		"pushpin_messages_sent_total %llu\n"
+		"# TYPE pushpin_http_response_messages_sent_total counter\n"
+		"pushpin_http_response_messages_sent_total %llu\n",
+		(unsigned long long)d->totalMessagesSent,
+		(unsigned long long)d->totalHttpResponseMessagesSent);
+	buf.append(line, written);
+
+	written = qsnprintf(line, sizeof(line),
+		"# TYPE pushpin_messages_dropped_total counter\n"
+		"pushpin_messages_dropped_total %llu\n",
+		(unsigned long long)d->totalMessagesDropped);
+	buf.append(line, written);
+
+	written = qsnprintf(line, sizeof(line),
+		"# TYPE pushpin_blocks_received_total counter\n"
+		"pushpin_blocks_received_total %llu\n"
+		"# TYPE pushpin_blocks_sent_total counter\n"
+		"pushpin_blocks_sent_total %llu\n",
+		(unsigned long long)d->totalBlocksReceived,
+		(unsigned long long)d->totalBlocksSent);
+	buf.append(line, written);
+
+	if(!d->zmqHwmHits.isEmpty())
 	{
-		// add/update
-		Private::ConnectionInfo *c = extConnectionInfoById.value(packet.connectionId);
-		if(!c)
-		{
-			c = new Private::ConnectionInfo;
-			c->id = packet.connectionId;
-			c->routeId = packet.route;
-			c->type = packet.connectionType == StatsPacket::Http ? Http : WebSocket;
-			c->peerAddress = packet.peerAddress;
-			c->ssl = packet.ssl;
-			c->lastReport = now;
-			c->from = packet.from;
-			c->lastActive = now;
-			d->insertExternalConnection(c);
-
-			d->updateConnectionsMax(c->routeId, now);
+		buf.append("# TYPE pushpin_zmq_hwm_hits_total counter\n");
 
-			Private::Report *report = d->getOrCreateReport(c->routeId);
-			++(report->connectionsMinutes); // minutes are rounded up so count one immediately
-		}
-		else
+		QHashIterator<QByteArray, quint64> it(d->zmqHwmHits);
+		while(it.hasNext())
 		{
-			c->ttl = packet.ttl;
+			it.next();
 
-			// move to the end
-			d->externalConnectionInfoByLastActive.remove(QPair<qint64, Private::ConnectionInfo*>(c->lastActive, c));
-			c->lastActive = now;
-			d->externalConnectionInfoByLastActive.insert(QPair<qint64, Private::ConnectionInfo*>(c->lastActive, c), c);
+			written = qsnprintf(line, sizeof(line), "pushpin_zmq_hwm_hits_total{socket=\"%s\"} %llu\n", it.key().data(), (unsigned long long)it.value());
+			buf.append(line, written);
 		}
-
-		d->updateConnectionsMinutes(c, now);
 	}
-	else // Disconnected
+
+	if(d->publishSpoolBytes >= 0)
 	{
-		Private::ConnectionInfo *c = extConnectionInfoById.value(packet.connectionId);
-		if(!c)
-			return;
+		written = qsnprintf(line, sizeof(line),
+			"# TYPE pushpin_publish_spool_bytes gauge\n"
+			"pushpin_publish_spool_bytes %lld\n",
+			(long long)d->publishSpoolBytes);
+		buf.append(line, written);
+	}
 
-		QByteArray routeId = c->routeId;
+	if(d->retainedBodyBytes >= 0)
+	{
+		written = qsnprintf(line, sizeof(line),
+			"# TYPE pushpin_retained_body_bytes gauge\n"
+			"pushpin_retained_body_bytes %lld\n"
+			"# TYPE pushpin_retained_body_evictions_total counter\n"
+			"pushpin_retained_body_evictions_total %llu\n",
+			(long long)d->retainedBodyBytes,
+			(unsigned long long)d->retainedBodyEvictions);
+		buf.append(line, written);
+	}
 
-		d->updateConnectionsMinutes(c, now);
-		d->removeExternalConnection(c);
-		delete c;
+	if(d->routeHeldBytes >= 0)
+	{
+		written = qsnprintf(line, sizeof(line),
+			"# TYPE pushpin_route_held_bytes gauge\n"
+			"pushpin_route_held_bytes %lld\n"
+			"# TYPE pushpin_route_holds_rejected_total counter\n"
+			"pushpin_route_holds_rejected_total %llu\n",
+			(long long)d->routeHeldBytes,
+			(unsigned long long)d->routeHoldsRejected);
+		buf.append(line, written);
+	}
 
-		d->updateConnectionsMax(routeId, now);
+	if(!d->eventLoopIterations.isEmpty())
+	{
+		// process-lifetime percentiles, like the other totals here
+		written = qsnprintf(line, sizeof(line),
+			"# TYPE pushpin_event_loop_msec gauge\n"
+			"pushpin_event_loop_msec{quantile=\"0.5\"} %lld\n"
+			"pushpin_event_loop_msec{quantile=\"0.99\"} %lld\n"
+			"pushpin_event_loop_msec{quantile=\"0.999\"} %lld\n",
+			(long long)d->eventLoopIterations.percentile(0.5),
+			(long long)d->eventLoopIterations.percentile(0.99),
+			(long long)d->eventLoopIterations.percentile(0.999));
+		buf.append(line, written);
+
+		written = qsnprintf(line, sizeof(line),
+			"# TYPE pushpin_event_loop_stalls_total counter\n"
+			"pushpin_event_loop_stalls_total %llu\n",
+			(unsigned long long)d->eventLoopStalls);
+		buf.append(line, written);
 	}
+
+	return buf;
+}
+
+bool StatsManager::checkConnection(const QByteArray &id)
+{
+	return d->connectionInfoById.contains(id);
+}
+
+int StatsManager::connectionCount(const QByteArray &routeId) const
+{
+	return d->connectionInfoByRoute.value(routeId).count();
+}
+
+void StatsManager::processExternalPacket(const StatsPacket &packet)
+{
+	if(d->reportInterval <= 0)
+		return;
+
+	if(packet.type != StatsPacket::Connected && packet.type != StatsPacket::Disconnected)
+		return;
+
+	d->enqueueExternalPacket(packet);
+}
+
+void StatsManager::processExternalReport(const StatsPacket &packet)
+{
+	if(d->reportInterval <= 0)
+		return;
+
+	Private::Report *report = d->getOrCreateReport(packet.route);
+
+	// the peer's counters are sums over its own report interval, so
+	//   fold them into the current interval here. latency percentiles
+	//   can't be meaningfully merged and are not carried over
+	if(packet.connectionsMax > 0)
+		report->externalConnectionsMax += packet.connectionsMax;
+	if(packet.connectionsMinutes > 0)
+		report->connectionsMinutes += packet.connectionsMinutes;
+	if(packet.messagesReceived > 0)
+		report->messagesReceived += packet.messagesReceived;
+	if(packet.messagesSent > 0)
+		report->messagesSent += packet.messagesSent;
+	if(packet.httpResponseMessagesSent > 0)
+		report->httpResponseMessagesSent += packet.httpResponseMessagesSent;
+	if(packet.messagesDropped > 0)
+		report->messagesDropped += packet.messagesDropped;
+	if(packet.blocksReceived > 0)
+		report->blocksReceived = qMax(report->blocksReceived, 0) + packet.blocksReceived;
+	if(packet.blocksSent > 0)
+		report->blocksSent = qMax(report->blocksSent, 0) + packet.blocksSent;
+
+	report->lastUpdate = QDateTime::currentMSecsSinceEpoch();
 }
 
 void StatsManager::sendPacket(const StatsPacket &packet)
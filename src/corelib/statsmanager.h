@@ -46,6 +46,14 @@ public:
 		WebSocket
 	};
 
+	// wire encoding for outgoing packets. compact cuts size and
+	//   serialize cost, but all consumers must understand it
+	enum OutputFormat
+	{
+		TnetStringFormat,
+		CompactFormat
+	};
+
 	StatsManager(QObject *parent = 0);
 	~StatsManager();
 
@@ -56,6 +64,12 @@ public:
 	void setSubscriptionTtl(int secs);
 	void setSubscriptionLinger(int secs);
 	void setReportInterval(int secs);
+	void setOutputFormat(OutputFormat format);
+
+	// pre-size the connection tables for this many concurrent
+	//   connections, so steady-state capacity is reached without
+	//   incremental rehashing under load
+	void setCapacityHint(int connections);
 
 	// routeId may be empty for non-identified route
 
@@ -77,12 +91,48 @@ public:
 	// for reporting only
 	void addMessageReceived(const QByteArray &routeId, int blocks = -1);
 	void addMessageSent(const QByteArray &routeId, const QString &transport, int blocks = -1);
+	void addMessageDropped(const QByteArray &routeId, int count = 1);
+
+	// record publish-to-delivery time of a message handed to zhttp, in
+	//   milliseconds. reported per transport as percentiles
+	void addMessageLatency(const QByteArray &routeId, const QString &transport, int msec);
+
+	// count a write issued to a zmq socket whose queue is at hwm
+	void addZmqHwmHit(const QByteArray &socket);
+
+	// current depth of the publish spool, in bytes
+	void setPublishSpoolDepth(qint64 bytes);
+
+	// size and cumulative evictions of the shared retained-body pool
+	void setRetainedBodyPool(qint64 bytes, quint64 evictions);
+
+	// totals from per-route budget accounting: held bytes across all
+	//   routes and cumulative holds rejected for being over budget
+	void setRouteBudgetTotals(qint64 heldBytes, quint64 holdsRejected);
+
+	// event loop iteration duration, in milliseconds. fed by
+	//   EventLoopProfiler, reported as process-level percentiles
+	void addEventLoopIteration(int msec);
+
+	// count an event loop iteration that exceeded the stall threshold
+	void addEventLoopStall();
+
+	// render current counters and gauges in prometheus text exposition
+	//   format. the output buffer is retained between calls, so repeated
+	//   scrapes don't allocate
+	QByteArray prometheusMetrics();
 
 	bool checkConnection(const QByteArray &id);
 
+	// number of locally tracked connections on the route
+	int connectionCount(const QByteArray &routeId) const;
+
 	// for reporting
 	void processExternalPacket(const StatsPacket &packet);
 
+	// merge a peer instance's report counters into our own reports
+	void processExternalReport(const StatsPacket &packet);
+
 	// directly send, for proxy->handler passthrough
 	void sendPacket(const StatsPacket &packet);
 
@@ -103,7 +103,11 @@ const char *getReasonRaw(int code)
 
 QByteArray getReason(int code)
 {
-	return getReasonRaw(code);
+	const char *s = getReasonRaw(code);
+
+	// the reasons are static strings, so wrap without copying. safe to
+	//   hold indefinitely, and any modification detaches
+	return QByteArray::fromRawData(s, qstrlen(s));
 }
 
 }
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "timerwheel.h"
+
+#include <assert.h>
+#include <QTimer>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QDateTime>
+#include <QPointer>
+
+#define WHEEL_SIZE 1024
+
+TimerWheel::Expirable::~Expirable()
+{
+}
+
+class TimerWheel::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Entry
+	{
+	public:
+		Expirable *target;
+		qint64 deadline;
+		int bucket;
+
+		Entry() :
+			target(0),
+			deadline(-1),
+			bucket(-1)
+		{
+		}
+	};
+
+	TimerWheel *q;
+	int tickMsec;
+	QTimer *tickTimer;
+	QVector< QSet<int> > buckets;
+	QHash<int, Entry> entries;
+	int nextHandle;
+	qint64 curTick; // tick represented by curBucket
+	int curBucket;
+
+	Private(TimerWheel *_q, int _tickMsec) :
+		QObject(_q),
+		q(_q),
+		tickMsec(_tickMsec),
+		buckets(WHEEL_SIZE),
+		nextHandle(0)
+	{
+		curTick = QDateTime::currentMSecsSinceEpoch() / tickMsec;
+		curBucket = (int)(curTick % WHEEL_SIZE);
+
+		tickTimer = new QTimer(this);
+		connect(tickTimer, &QTimer::timeout, this, &Private::tickTimer_timeout);
+	}
+
+	~Private()
+	{
+		tickTimer->disconnect(this);
+		tickTimer->setParent(0);
+		tickTimer->deleteLater();
+	}
+
+	int start(int msec, Expirable *target)
+	{
+		assert(target);
+
+		int handle = nextHandle++;
+		if(nextHandle < 0)
+			nextHandle = 0;
+
+		qint64 deadline = QDateTime::currentMSecsSinceEpoch() + msec;
+
+		Entry e;
+		e.target = target;
+		e.deadline = deadline;
+		e.bucket = bucketForDeadline(deadline);
+
+		entries.insert(handle, e);
+		buckets[e.bucket] += handle;
+
+		if(!tickTimer->isActive())
+			tickTimer->start(tickMsec);
+
+		return handle;
+	}
+
+	void stop(int handle)
+	{
+		if(!entries.contains(handle))
+			return;
+
+		Entry e = entries.take(handle);
+		buckets[e.bucket].remove(handle);
+
+		if(entries.isEmpty())
+			tickTimer->stop();
+	}
+
+private:
+	int bucketForDeadline(qint64 deadline) const
+	{
+		qint64 tick = deadline / tickMsec;
+
+		// past deadlines fire on the next tick
+		if(tick <= curTick)
+			tick = curTick + 1;
+
+		return (int)(tick % WHEEL_SIZE);
+	}
+
+private slots:
+	void tickTimer_timeout()
+	{
+		QPointer<QObject> self = this;
+
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+		qint64 tick = now / tickMsec;
+
+		// process every bucket between the last position and now, so
+		//   that a stalled event loop doesn't skip deadlines
+		while(curTick < tick)
+		{
+			++curTick;
+			curBucket = (int)(curTick % WHEEL_SIZE);
+
+			// an entry in this bucket is due unless its deadline is a
+			//   whole wheel rotation (or more) away
+			QList<int> expired;
+			foreach(int handle, buckets[curBucket])
+			{
+				const Entry &e = entries[handle];
+				if(e.deadline <= now)
+					expired += handle;
+			}
+
+			foreach(int handle, expired)
+			{
+				if(!entries.contains(handle))
+					continue; // stopped by an earlier callback
+
+				Entry e = entries.take(handle);
+				buckets[curBucket].remove(handle);
+
+				e.target->timerExpired(handle);
+				if(!self)
+					return;
+			}
+		}
+
+		if(entries.isEmpty())
+			tickTimer->stop();
+	}
+};
+
+TimerWheel::TimerWheel(int tickMsec, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, tickMsec);
+}
+
+TimerWheel::~TimerWheel()
+{
+	delete d;
+}
+
+int TimerWheel::count() const
+{
+	return d->entries.count();
+}
+
+int TimerWheel::start(int msec, Expirable *target)
+{
+	return d->start(msec, target);
+}
+
+void TimerWheel::stop(int handle)
+{
+	d->stop(handle);
+}
+
+#include "timerwheel.moc"
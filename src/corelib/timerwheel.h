@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QObject>
+
+// coarse timer service for large numbers of timeouts. deadlines are
+//   hashed into wheel buckets of tick granularity, so each registration
+//   costs a few bytes instead of a kernel-armed timer, and a single
+//   QTimer drives expiry for all of them. deadlines may fire up to one
+//   tick late. targets implement Expirable and are called back with the
+//   handle returned by start()
+class TimerWheel : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Expirable
+	{
+	public:
+		virtual ~Expirable();
+
+		virtual void timerExpired(int handle) = 0;
+	};
+
+	TimerWheel(int tickMsec = 100, QObject *parent = 0);
+	~TimerWheel();
+
+	int count() const;
+
+	// returns a handle. the target must outlive the registration or
+	//   stop it first
+	int start(int msec, Expirable *target);
+
+	void stop(int handle);
+
+private:
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "tnetstringview.h"
+
+TnetStringView::TnetStringView() :
+	offset_(-1),
+	payloadOffset_(-1),
+	payloadSize_(-1),
+	type_(Invalid)
+{
+}
+
+TnetStringView::TnetStringView(const QByteArray &frame, int offset) :
+	frame_(frame),
+	offset_(offset),
+	payloadOffset_(-1),
+	payloadSize_(-1),
+	type_(Invalid)
+{
+	// parse "SIZE:PAYLOADTYPE" header without touching the payload
+
+	int at = offset;
+	int size = 0;
+	bool haveDigit = false;
+
+	while(at < frame.length() && frame[at] >= '0' && frame[at] <= '9')
+	{
+		// guard against overflow from absurd length headers
+		if(size > (1 << 27))
+			return;
+
+		size = (size * 10) + (frame[at] - '0');
+		haveDigit = true;
+		++at;
+	}
+
+	if(!haveDigit || at >= frame.length() || frame[at] != ':')
+		return;
+
+	++at; // skip ':'
+
+	if(at + size + 1 > frame.length())
+		return;
+
+	char typeChar = frame[at + size];
+
+	switch(typeChar)
+	{
+		case ',': type_ = ByteArray; break;
+		case '#': type_ = Int; break;
+		case '^': type_ = Double; break;
+		case '!': type_ = Bool; break;
+		case '~': type_ = Null; break;
+		case '}': type_ = Map; break;
+		case ']': type_ = List; break;
+		default: return;
+	}
+
+	payloadOffset_ = at;
+	payloadSize_ = size;
+}
+
+bool TnetStringView::isValid() const
+{
+	return (type_ != Invalid);
+}
+
+TnetStringView::Type TnetStringView::type() const
+{
+	return type_;
+}
+
+int TnetStringView::offset() const
+{
+	return offset_;
+}
+
+int TnetStringView::encodedSize() const
+{
+	if(type_ == Invalid)
+		return -1;
+
+	return (payloadOffset_ - offset_) + payloadSize_ + 1;
+}
+
+QByteArray TnetStringView::toByteArray() const
+{
+	if(type_ != ByteArray)
+		return QByteArray();
+
+	return QByteArray::fromRawData(frame_.constData() + payloadOffset_, payloadSize_);
+}
+
+qint64 TnetStringView::toInt(bool *ok) const
+{
+	if(type_ != Int)
+	{
+		if(ok)
+			*ok = false;
+		return 0;
+	}
+
+	return QByteArray::fromRawData(frame_.constData() + payloadOffset_, payloadSize_).toLongLong(ok);
+}
+
+bool TnetStringView::toBool(bool *ok) const
+{
+	if(type_ != Bool)
+	{
+		if(ok)
+			*ok = false;
+		return false;
+	}
+
+	QByteArray val = QByteArray::fromRawData(frame_.constData() + payloadOffset_, payloadSize_);
+
+	if(val == "true")
+	{
+		if(ok)
+			*ok = true;
+		return true;
+	}
+	else if(val == "false")
+	{
+		if(ok)
+			*ok = true;
+		return false;
+	}
+
+	if(ok)
+		*ok = false;
+	return false;
+}
+
+TnetStringView::MapIterator::MapIterator(const TnetStringView &map) :
+	at_(-1),
+	end_(-1)
+{
+	if(map.type() == TnetStringView::Map)
+	{
+		frame_ = map.frame_;
+		at_ = map.payloadOffset_;
+		end_ = map.payloadOffset_ + map.payloadSize_;
+	}
+}
+
+bool TnetStringView::MapIterator::next(QByteArray *key, TnetStringView *value)
+{
+	if(at_ < 0 || at_ >= end_)
+		return false;
+
+	TnetStringView k(frame_, at_);
+	if(k.type() != TnetStringView::ByteArray)
+		return false;
+
+	at_ += k.encodedSize();
+
+	TnetStringView v(frame_, at_);
+	if(!v.isValid() || at_ + v.encodedSize() > end_)
+		return false;
+
+	at_ += v.encodedSize();
+
+	*key = k.toByteArray();
+	*value = v;
+	return true;
+}
+
+TnetStringView::ListIterator::ListIterator() :
+	at_(-1),
+	end_(-1)
+{
+}
+
+TnetStringView::ListIterator::ListIterator(const TnetStringView &list) :
+	at_(-1),
+	end_(-1)
+{
+	if(list.type() == TnetStringView::List)
+	{
+		frame_ = list.frame_;
+		at_ = list.payloadOffset_;
+		end_ = list.payloadOffset_ + list.payloadSize_;
+	}
+}
+
+bool TnetStringView::ListIterator::next(TnetStringView *value)
+{
+	if(at_ < 0 || at_ >= end_)
+		return false;
+
+	TnetStringView v(frame_, at_);
+	if(!v.isValid() || at_ + v.encodedSize() > end_)
+		return false;
+
+	at_ += v.encodedSize();
+
+	*value = v;
+	return true;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef TNETSTRINGVIEW_H
+#define TNETSTRINGVIEW_H
+
+#include <QByteArray>
+
+// lazy cursor over a tnetstring element. nothing is decoded or copied up
+//   front: the view just records where the element lives in the source
+//   frame, and map/list children are parsed one at a time as they are
+//   visited. byte array payloads are returned as views into the frame
+//   (QByteArray::fromRawData), so the frame must outlive anything
+//   retained from them unless explicitly copied.
+class TnetStringView
+{
+public:
+	enum Type
+	{
+		ByteArray,
+		Int,
+		Double,
+		Bool,
+		Null,
+		Map,
+		List,
+		Invalid
+	};
+
+	TnetStringView();
+	TnetStringView(const QByteArray &frame, int offset = 0);
+
+	bool isValid() const;
+	Type type() const;
+
+	// absolute offset of the element within the frame, e.g. for handing
+	//   a subtree to TnetString::toVariant
+	int offset() const;
+
+	// total encoded size, including length header and type character
+	int encodedSize() const;
+
+	QByteArray toByteArray() const; // view, not a copy
+	qint64 toInt(bool *ok = 0) const;
+	bool toBool(bool *ok = 0) const;
+
+	class MapIterator
+	{
+	public:
+		MapIterator(const TnetStringView &map);
+
+		// returns false at the end of the map or on malformed input
+		bool next(QByteArray *key, TnetStringView *value);
+
+	private:
+		QByteArray frame_;
+		int at_;
+		int end_;
+	};
+
+	class ListIterator
+	{
+	public:
+		// an empty iterator, for holding iteration state as a member
+		//   before a list is available
+		ListIterator();
+
+		ListIterator(const TnetStringView &list);
+
+		bool next(TnetStringView *value);
+
+	private:
+		QByteArray frame_;
+		int at_;
+		int end_;
+	};
+
+private:
+	QByteArray frame_; // shallow copy of the source frame
+	int offset_;
+	int payloadOffset_;
+	int payloadSize_;
+	Type type_;
+
+	friend class MapIterator;
+	friend class ListIterator;
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef TRACEPOINTS_H
+#define TRACEPOINTS_H
+
+// static tracepoints (USDT) at request lifecycle transitions, for
+//   attaching bpftrace/perf in production without a rebuild. build
+//   with DEFINES+=USE_SDT (requires sys/sdt.h, e.g. systemtap-sdt-dev)
+//   to arm them. disarmed probes compile to a single nop, and when
+//   USE_SDT is not defined the macros expand to nothing at all, so
+//   there is no cost in the default build.
+//
+// probes live in the "pushpin" provider. arguments must be cheap
+//   scalars (pointers, integers) that are already at hand. example:
+//
+//   bpftrace -e 'usdt:./pushpin-handler:pushpin:publish_ingest { @in[arg0] = nsecs }'
+
+#ifdef USE_SDT
+
+#include <sys/sdt.h>
+
+#define TRACEPOINT(name) DTRACE_PROBE(pushpin, name)
+#define TRACEPOINT1(name, a1) DTRACE_PROBE1(pushpin, name, a1)
+#define TRACEPOINT2(name, a1, a2) DTRACE_PROBE2(pushpin, name, a1, a2)
+
+#else
+
+#define TRACEPOINT(name)
+#define TRACEPOINT1(name, a1)
+#define TRACEPOINT2(name, a1, a2)
+
+#endif
+
+#endif
@@ -28,11 +28,78 @@
 
 #include "uuidutil.h"
 
+#include <string.h>
 #include <QUuid>
+#include <QFile>
+
+#define POOL_IDS 256
 
 namespace UuidUtil {
 
-QByteArray createUuid()
+// ids are drawn from a pool of random bytes filled in one read, so a
+//   connection storm costs one syscall per POOL_IDS ids instead of an
+//   entropy round-trip for each
+static unsigned char pool[POOL_IDS * 16];
+static int poolPos = POOL_IDS; // start empty
+static QFile *randomSource = 0;
+
+static bool fillPool()
+{
+	if(!randomSource)
+	{
+		randomSource = new QFile("/dev/urandom");
+		if(!randomSource->open(QFile::ReadOnly | QFile::Unbuffered))
+		{
+			delete randomSource;
+			randomSource = 0;
+			return false;
+		}
+	}
+
+	if(randomSource->read((char *)pool, sizeof(pool)) != (qint64)sizeof(pool))
+		return false;
+
+	poolPos = 0;
+	return true;
+}
+
+static bool nextId(unsigned char *dest)
+{
+	if(poolPos >= POOL_IDS && !fillPool())
+		return false;
+
+	memcpy(dest, pool + (poolPos * 16), 16);
+	++poolPos;
+
+	// set the version 4 and variant bits, as QUuid would
+	dest[6] = (dest[6] & 0x0f) | 0x40;
+	dest[8] = (dest[8] & 0x3f) | 0x80;
+
+	return true;
+}
+
+static QByteArray formatId(const unsigned char *id)
+{
+	const char *hexDigits = "0123456789abcdef";
+
+	QByteArray out;
+	out.resize(36);
+
+	char *p = out.data();
+	for(int n = 0; n < 16; ++n)
+	{
+		if(n == 4 || n == 6 || n == 8 || n == 10)
+			*(p++) = '-';
+
+		*(p++) = hexDigits[id[n] >> 4];
+		*(p++) = hexDigits[id[n] & 0x0f];
+	}
+
+	return out;
+}
+
+// fall back to qt if the system entropy source is unavailable
+static QByteArray createUuidFallback()
 {
 	QByteArray out = QUuid::createUuid().toString().toLatin1();
 	if(out[0] == '{' && out[out.length() - 1] == '}')
@@ -40,4 +107,22 @@ QByteArray createUuid()
 	return out;
 }
 
+QByteArray createUuid()
+{
+	unsigned char id[16];
+	if(!nextId(id))
+		return createUuidFallback();
+
+	return formatId(id);
+}
+
+QByteArray createUuidBinary()
+{
+	unsigned char id[16];
+	if(!nextId(id))
+		return QUuid::createUuid().toRfc4122();
+
+	return QByteArray((const char *)id, 16);
+}
+
 }
@@ -33,8 +33,14 @@ class QByteArray;
 
 namespace UuidUtil {
 
+// random (version 4) uuid in the usual text form, e.g.
+//   "b29d4575-a8b2-46cd-9bfc-e554a50a4c41"
 QByteArray createUuid();
 
+// same, but the compact 16-byte binary form. suitable for ids that
+//   only travel in packets and hash keys
+QByteArray createUuidBinary();
+
 }
 
 #endif
@@ -83,7 +83,25 @@ public:
 		}
 	};
 
-	WebSocket(QObject *parent = 0) : QObject(parent) {}
+	// receives the per-frame callbacks as direct virtual calls,
+	//   bypassing signal dispatch. for the data path only; lifecycle
+	//   events (connected, peerClosed, closed, error) remain signals
+	class Listener
+	{
+	public:
+		virtual ~Listener() {}
+
+		virtual void socketReadyRead(WebSocket *sock) = 0;
+		virtual void socketFramesWritten(WebSocket *sock, int count, int contentBytes) = 0;
+	};
+
+	WebSocket(QObject *parent = 0) : QObject(parent), listener_(0) {}
+
+	// when a listener is set, readyRead and framesWritten are
+	//   delivered to it instead of being emitted, saving the metacall
+	//   dispatch and argument marshalling on every frame. one listener
+	//   at most; pass 0 to return to signal delivery
+	void setListener(Listener *listener) { listener_ = listener; }
 
 	virtual QHostAddress peerAddress() const = 0;
 
@@ -123,6 +141,28 @@ signals:
 	void peerClosed(); // emitted only if peer closes before we do
 	void closed(); // emitted after peer acks our close, or immediately if we were acking
 	void error();
+
+protected:
+	// subclasses report data events through these rather than emitting
+	//   the signals themselves, so the listener fast path applies
+	void emitReadyRead()
+	{
+		if(listener_)
+			listener_->socketReadyRead(this);
+		else
+			emit readyRead();
+	}
+
+	void emitFramesWritten(int count, int contentBytes)
+	{
+		if(listener_)
+			listener_->socketFramesWritten(this, count, contentBytes);
+		else
+			emit framesWritten(count, contentBytes);
+	}
+
+private:
+	Listener *listener_;
 };
 
 #endif
@@ -59,9 +59,26 @@
 #define ZHTTP_MUST_PROCESS (ZHTTP_EXPIRE * 4 / 5)
 #define ZHTTP_REFRESH_BUCKETS (ZHTTP_SHOULD_PROCESS / REFRESH_INTERVAL)
 
+// sessions with outbound activity this recent don't need an explicit
+//   keep alive when their refresh bucket comes up
+#define ZHTTP_REFRESH_SKIP (ZHTTP_SHOULD_PROCESS / 2)
+
 // this doesn't have to match the peer, but we'll set a reasonable number
 #define ZHTTP_IDS_MAX 128
 
+// server-out packets up to this size are considered for merging
+#define SERVER_MERGE_BODY_MAX 4096
+
+// max server-out packets held for same-turn aggregation
+#define SERVER_OUT_ITEMS_MAX 128
+
+// body bytes each session may send per round when draining server-out
+//   packets via deficit round robin
+#define SERVER_OUT_QUANTUM 16384
+
+// max req-mode responses processed per event loop pass
+#define REQ_DRAIN_MAX 50
+
 class ZhttpManager::Private : public QObject
 {
 	Q_OBJECT
@@ -83,6 +100,27 @@ public:
 		int refreshBucket;
 	};
 
+	class ServerOutItem
+	{
+	public:
+		SessionType type;
+		QByteArray instanceAddress;
+		ZhttpResponsePacket packet;
+		QByteArray mergeKey; // serialized packet minus ids. null if not mergeable
+	};
+
+	class ServerOutSessionQueue
+	{
+	public:
+		QList<ServerOutItem> items;
+		qint64 deficit;
+
+		ServerOutSessionQueue() :
+			deficit(0)
+		{
+		}
+	};
+
 	ZhttpManager *q;
 	QStringList client_out_specs;
 	QStringList client_out_stream_specs;
@@ -110,7 +148,10 @@ public:
 	QHash<ZWebSocket::Rid, ZWebSocket*> clientSocksByRid;
 	QHash<ZWebSocket::Rid, ZWebSocket*> serverSocksByRid;
 	QList<ZWebSocket*> serverPendingSocks;
+	QList<ServerOutItem> pendingServerOut;
+	QTimer *serverOutFlushTimer;
 	QTimer *refreshTimer;
+	QTimer *reqDrainTimer;
 	QHash<void*, KeepAliveRegistration*> keepAliveRegistrations;
 	QMap<QPair<qint64, KeepAliveRegistration*>, KeepAliveRegistration*> sessionsByLastRefresh;
 	QSet<KeepAliveRegistration*> sessionRefreshBuckets[ZHTTP_REFRESH_BUCKETS];
@@ -133,22 +174,41 @@ public:
 		doBind(false),
 		currentSessionRefreshBucket(0)
 	{
+		serverOutFlushTimer = new QTimer(this);
+		serverOutFlushTimer->setSingleShot(true);
+		connect(serverOutFlushTimer, &QTimer::timeout, this, &Private::serverOutFlush_timeout);
+
 		refreshTimer = new QTimer(this);
 		connect(refreshTimer, &QTimer::timeout, this, &Private::refresh_timeout);
+
+		reqDrainTimer = new QTimer(this);
+		reqDrainTimer->setSingleShot(true);
+		connect(reqDrainTimer, &QTimer::timeout, this, &Private::client_req_readyRead);
 	}
 
 	~Private()
 	{
+		if(server_out_sock)
+			flushServerOut();
+
 		assert(clientReqsByRid.isEmpty());
 		assert(serverReqsByRid.isEmpty());
 		assert(clientSocksByRid.isEmpty());
 		assert(serverSocksByRid.isEmpty());
 		assert(keepAliveRegistrations.isEmpty());
 
+		serverOutFlushTimer->disconnect(this);
+		serverOutFlushTimer->setParent(0);
+		serverOutFlushTimer->deleteLater();
+
 		refreshTimer->disconnect(this);
 		refreshTimer->setParent(0);
 		refreshTimer->deleteLater();
 
+		reqDrainTimer->disconnect(this);
+		reqDrainTimer->setParent(0);
+		reqDrainTimer->deleteLater();
+
 		qDeleteAll(serverPendingReqs);
 		qDeleteAll(serverPendingSocks);
 	}
@@ -389,10 +449,128 @@ public:
 	void write(SessionType type, const ZhttpResponsePacket &packet, const QByteArray &instanceAddress)
 	{
 		assert(server_out_sock);
+
+		ServerOutItem item;
+		item.type = type;
+		item.instanceAddress = instanceAddress;
+		item.packet = packet;
+
+		// during fan-out, many sessions on the same peer are sent the
+		//   same payload back-to-back within a turn. the packet format
+		//   supports multiple ids, so such writes can share one packet.
+		//   the merge key is the serialized packet minus its ids: any
+		//   two packets that differ only by session compare equal. only
+		//   small single-id packets are worth the extra serialization
+		if(packet.ids.count() == 1 && packet.body.size() <= SERVER_MERGE_BODY_MAX)
+		{
+			ZhttpResponsePacket stripped = packet;
+			stripped.ids.clear();
+			item.mergeKey = TnetString::fromVariant(stripped.toVariant());
+		}
+
+		pendingServerOut += item;
+
+		if(pendingServerOut.count() >= SERVER_OUT_ITEMS_MAX)
+			flushServerOut();
+		else if(!serverOutFlushTimer->isActive())
+			serverOutFlushTimer->start(0);
+	}
+
+	void flushServerOut()
+	{
+		// merge adjacent packets that differ only by session id.
+		//   consecutive-only, so per-session ordering is preserved
+		QList<ServerOutItem> items;
+		while(!pendingServerOut.isEmpty())
+		{
+			ServerOutItem item = pendingServerOut.takeFirst();
+
+			if(!item.mergeKey.isNull())
+			{
+				while(!pendingServerOut.isEmpty() && item.packet.ids.count() < ZHTTP_IDS_MAX)
+				{
+					const ServerOutItem &next = pendingServerOut.first();
+					if(next.instanceAddress != item.instanceAddress || next.mergeKey != item.mergeKey)
+						break;
+
+					item.packet.ids += next.packet.ids;
+					pendingServerOut.removeFirst();
+				}
+			}
+
+			items += item;
+		}
+
+		serverOutFlushTimer->stop();
+
+		if(items.count() < 2)
+		{
+			foreach(const ServerOutItem &item, items)
+				writeServerPacket(item.type, item.packet, item.instanceAddress);
+
+			return;
+		}
+
+		// group into per-peer, per-session queues. grouping is stable,
+		//   so per-session ordering still holds
+		QHash<QPair<QByteArray, QByteArray>, int> queueIndexes;
+		QList<ServerOutSessionQueue> queues;
+		foreach(const ServerOutItem &item, items)
+		{
+			QPair<QByteArray, QByteArray> key(item.instanceAddress, !item.packet.ids.isEmpty() ? item.packet.ids.first().id : QByteArray());
+
+			int at = queueIndexes.value(key, -1);
+			if(at < 0)
+			{
+				at = queues.count();
+				queueIndexes.insert(key, at);
+				queues += ServerOutSessionQueue();
+			}
+
+			queues[at].items += item;
+		}
+
+		// deficit round robin across the session queues, so a session
+		//   flushing a large body doesn't head-of-line block other
+		//   sessions' small packets to the same peer. bodyless packets
+		//   (credits, keep alives) always fit the deficit and interleave
+		//   freely
+		int remaining = items.count();
+		while(remaining > 0)
+		{
+			for(int n = 0; n < queues.count(); ++n)
+			{
+				ServerOutSessionQueue &sq = queues[n];
+				if(sq.items.isEmpty())
+					continue;
+
+				sq.deficit += SERVER_OUT_QUANTUM;
+
+				while(!sq.items.isEmpty() && sq.items.first().packet.body.size() <= sq.deficit)
+				{
+					ServerOutItem item = sq.items.takeFirst();
+					sq.deficit -= item.packet.body.size();
+					--remaining;
+
+					writeServerPacket(item.type, item.packet, item.instanceAddress);
+				}
+			}
+		}
+	}
+
+	void writeServerPacket(SessionType type, const ZhttpResponsePacket &packet, const QByteArray &instanceAddress)
+	{
 		const char *logprefix = logPrefixForType(type);
 
 		QVariant vpacket = packet.toVariant();
-		QByteArray buf = instanceAddress + " T" + TnetString::fromVariant(vpacket);
+		QByteArray tnet = TnetString::fromVariant(vpacket);
+
+		// concatenating in one pass avoids a second copy of the payload
+		QByteArray buf;
+		buf.reserve(instanceAddress.size() + 2 + tnet.size());
+		buf += instanceAddress;
+		buf += " T";
+		buf += tnet;
 
 		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
 			LogUtil::logVariantWithContent(LOG_LEVEL_DEBUG, vpacket, "body", "%s server: OUT %s", logprefix, instanceAddress.data());
@@ -449,6 +627,23 @@ public:
 		setupKeepAlive();
 	}
 
+	void keepAliveActivity(void *p)
+	{
+		KeepAliveRegistration *r = keepAliveRegistrations.value(p);
+		if(!r)
+			return;
+
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+		if(now == r->lastRefresh)
+			return;
+
+		// an outbound packet refreshes the peer's expiration the same
+		//   as an explicit keep alive, so count it as one
+		sessionsByLastRefresh.remove(QPair<qint64, KeepAliveRegistration*>(r->lastRefresh, r));
+		r->lastRefresh = now;
+		sessionsByLastRefresh.insert(QPair<qint64, KeepAliveRegistration*>(r->lastRefresh, r), r);
+	}
+
 	void setupKeepAlive()
 	{
 		if(!keepAliveRegistrations.isEmpty())
@@ -479,6 +674,11 @@ public:
 	}
 
 public slots:
+	void serverOutFlush_timeout()
+	{
+		flushServerOut();
+	}
+
 	void client_out_messagesWritten(int count)
 	{
 		Q_UNUSED(count);
@@ -505,14 +705,15 @@ public slots:
 		}
 
 		QByteArray receiver = msg[0].mid(0, at);
-		QByteArray dataRaw = msg[0].mid(at + 1);
-		if(dataRaw.length() < 1 || dataRaw[0] != 'T')
+
+		if(at + 1 >= msg[0].length() || msg[0][at + 1] != 'T')
 		{
 			log_warning("zhttp/zws client: received message with invalid format (missing type), skipping");
 			return;
 		}
 
-		QVariant data = TnetString::toVariant(dataRaw.mid(1));
+		// parse in place to avoid slicing off a copy of the payload
+		QVariant data = TnetString::toVariant(msg[0], at + 2);
 		if(data.isNull())
 		{
 			log_warning("zhttp/zws client: received message with invalid format (tnetstring parse failed), skipping");
@@ -583,7 +784,7 @@ public slots:
 			return;
 		}
 
-		QVariant data = TnetString::toVariant(msg[0].mid(1));
+		QVariant data = TnetString::toVariant(msg[0], 1);
 		if(data.isNull())
 		{
 			log_warning("zhttp/zws server: received message with invalid format (tnetstring parse failed), skipping");
@@ -678,25 +879,30 @@ public slots:
 
 	void client_req_readyRead()
 	{
+		// drain a bounded batch per wakeup, so a burst of responses
+		//   doesn't starve the other sockets sharing the event loop. if
+		//   messages remain after the batch, continue on the next pass
 		QPointer<QObject> self = this;
 
-		while(client_req_sock->canRead())
+		int count = 0;
+		while(client_req_sock->canRead() && count < REQ_DRAIN_MAX)
 		{
 			QList<QByteArray> msg = client_req_sock->read();
+			++count;
+
 			if(msg.count() != 2)
 			{
 				log_warning("zhttp/zws client req: received message with parts != 2, skipping");
 				continue;
 			}
 
-			QByteArray dataRaw = msg[1];
-			if(dataRaw.length() < 1 || dataRaw[0] != 'T')
+			if(msg[1].length() < 1 || msg[1][0] != 'T')
 			{
 				log_warning("zhttp/zws client req: received message with invalid format (missing type), skipping");
 				continue;
 			}
 
-			QVariant data = TnetString::toVariant(dataRaw.mid(1));
+			QVariant data = TnetString::toVariant(msg[1], 1);
 			if(data.isNull())
 			{
 				log_warning("zhttp/zws client req: received message with invalid format (tnetstring parse failed), skipping");
@@ -735,6 +941,9 @@ public slots:
 
 			// NOTE: we don't respond with a cancel message in req mode
 		}
+
+		if(client_req_sock->canRead())
+			reqDrainTimer->start(0);
 	}
 
 	void server_in_stream_readyRead(const QList<QByteArray> &msg)
@@ -751,7 +960,7 @@ public slots:
 			return;
 		}
 
-		QVariant data = TnetString::toVariant(msg[2].mid(1));
+		QVariant data = TnetString::toVariant(msg[2], 1);
 		if(data.isNull())
 		{
 			log_warning("zhttp/zws server: received message with invalid format (tnetstring parse failed), skipping");
@@ -824,6 +1033,12 @@ public slots:
 		const QSet<KeepAliveRegistration*> &bucket = sessionRefreshBuckets[currentSessionRefreshBucket];
 		foreach(KeepAliveRegistration *r, bucket)
 		{
+			// a recently active session doesn't need an explicit keep
+			//   alive yet. if it goes quiet, the lastRefresh ordering
+			//   below will pick it up before the peer expires it
+			if(now - r->lastRefresh < ZHTTP_REFRESH_SKIP)
+				continue;
+
 			QPair<QByteArray, QByteArray> rid;
 			bool isServer;
 			if(r->type == HttpSession)
@@ -1104,6 +1319,14 @@ void ZhttpManager::setBind(bool enable)
 	d->doBind = enable;
 }
 
+void ZhttpManager::setCapacityHint(int sessions)
+{
+	d->clientReqsByRid.reserve(sessions);
+	d->serverReqsByRid.reserve(sessions);
+	d->clientSocksByRid.reserve(sessions);
+	d->serverSocksByRid.reserve(sessions);
+}
+
 bool ZhttpManager::setClientOutSpecs(const QStringList &specs)
 {
 	d->client_out_specs = specs;
@@ -1312,4 +1535,14 @@ void ZhttpManager::unregisterKeepAlive(ZWebSocket *sock)
 	d->unregisterKeepAlive(sock);
 }
 
+void ZhttpManager::keepAliveActivity(ZhttpRequest *req)
+{
+	d->keepAliveActivity(req);
+}
+
+void ZhttpManager::keepAliveActivity(ZWebSocket *sock)
+{
+	d->keepAliveActivity(sock);
+}
+
 #include "zhttpmanager.moc"
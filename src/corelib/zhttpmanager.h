@@ -54,6 +54,11 @@ public:
 	void setIpcFileMode(int mode);
 	void setBind(bool enable);
 
+	// pre-size the session tables for this many concurrent sessions,
+	//   so steady-state capacity is reached without incremental
+	//   rehashing under load
+	void setCapacityHint(int sessions);
+
 	bool setClientOutSpecs(const QStringList &specs);
 	bool setClientOutStreamSpecs(const QStringList &specs);
 	bool setClientInSpecs(const QStringList &specs);
@@ -100,6 +105,11 @@ private:
 	void unregisterKeepAlive(ZhttpRequest *req);
 	void registerKeepAlive(ZWebSocket *sock);
 	void unregisterKeepAlive(ZWebSocket *sock);
+
+	// sessions report outbound packets so keep alives can be skipped
+	//   while there is regular activity
+	void keepAliveActivity(ZhttpRequest *req);
+	void keepAliveActivity(ZWebSocket *sock);
 };
 
 #endif
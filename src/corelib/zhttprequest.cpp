@@ -34,6 +34,7 @@
 #include "zhttprequestpacket.h"
 #include "zhttpresponsepacket.h"
 #include "bufferlist.h"
+#include "blockpool.h"
 #include "log.h"
 #include "zhttpmanager.h"
 #include "uuidutil.h"
@@ -43,11 +44,38 @@
 #define KEEPALIVE_INTERVAL 45000
 #define REQ_BUF_MAX 1000000
 
+#define CREDITS_WINDOW_MAX 2000000
+#define CREDITS_GROW_THRESHOLD 4
+#define CREDITS_EXTRA_TOTAL_MAX 50000000
+
+// total window growth beyond IDEAL_CREDITS across all sessions in the
+//   process. sessions return their extra allotment when they finish, so
+//   a few fast transfers can't starve everyone else of buffer space
+static int g_extraCreditsUsed = 0;
+
+// session churn allocates one of these per request. pool them so the
+//   memory is recycled instead of ping-ponging through the heap
+static BlockPool *g_privatePool = 0;
+
 class ZhttpRequest::Private : public QObject
 {
 	Q_OBJECT
 
 public:
+	static void *operator new(size_t size)
+	{
+		if(!g_privatePool)
+			g_privatePool = new BlockPool("zhttprequest", size);
+
+		assert(size <= g_privatePool->blockSize());
+		return g_privatePool->alloc();
+	}
+
+	static void operator delete(void *p)
+	{
+		g_privatePool->free(p);
+	}
+
 	enum State
 	{
 		Stopped,                 // response finished, error, or not even started
@@ -89,6 +117,8 @@ public:
 	int outCredits;
 	bool bodyFinished; // user has finished providing input
 	int pendingInCredits;
+	int inWindow; // receive window we've granted the peer
+	int fastReceives; // consecutive data packets that found our buffer drained
 	bool haveRequestBody;
 	bool haveResponseValues;
 	int responseCode;
@@ -124,6 +154,8 @@ public:
 		outCredits(0),
 		bodyFinished(false),
 		pendingInCredits(0),
+		inWindow(IDEAL_CREDITS),
+		fastReceives(0),
 		haveRequestBody(false),
 		haveResponseValues(false),
 		pausing(false),
@@ -156,6 +188,12 @@ public:
 	{
 		needPause = false;
 
+		if(inWindow > IDEAL_CREDITS)
+		{
+			g_extraCreditsUsed -= inWindow - IDEAL_CREDITS;
+			inWindow = IDEAL_CREDITS;
+		}
+
 		if(expireTimer)
 		{
 			expireTimer->disconnect(this);
@@ -353,6 +391,41 @@ public:
 		expireTimer->start(SESSION_EXPIRE);
 	}
 
+	// called when an incoming data packet is handled. if the reader
+	//   keeps draining our buffer before the next packet arrives, then
+	//   the window is the bottleneck rather than the reader, so grow it
+	//   (up to a per-session cap and a process-wide budget). the extra
+	//   credits are granted to the peer with the next credit flush
+	void trackReceiveWindow(bool bufWasEmpty, bool more, int bodySize)
+	{
+		if(!more || bodySize <= 0)
+			return;
+
+		if(!bufWasEmpty)
+		{
+			fastReceives = 0;
+			return;
+		}
+
+		++fastReceives;
+		if(fastReceives < CREDITS_GROW_THRESHOLD)
+			return;
+
+		fastReceives = 0;
+
+		if(inWindow >= CREDITS_WINDOW_MAX)
+			return;
+
+		int delta = qMin(inWindow, CREDITS_WINDOW_MAX - inWindow);
+		delta = qMin(delta, CREDITS_EXTRA_TOTAL_MAX - g_extraCreditsUsed);
+		if(delta <= 0)
+			return;
+
+		g_extraCreditsUsed += delta;
+		inWindow += delta;
+		pendingInCredits += delta;
+	}
+
 	void update()
 	{
 		if(!pendingUpdate)
@@ -413,7 +486,7 @@ public:
 				p.type = ZhttpRequestPacket::Data;
 				writePacket(p);
 
-				emit q->bytesWritten(0);
+				q->emitBytesWritten(0);
 			}
 			else if(!requestBodyBuf.isEmpty() && outCredits > 0)
 			{
@@ -439,7 +512,7 @@ public:
 
 				writePacket(p);
 
-				emit q->bytesWritten(buf.size());
+				q->emitBytesWritten(buf.size());
 			}
 		}
 		else if(state == ClientReceiving)
@@ -473,7 +546,7 @@ public:
 					cleanup();
 				}
 
-				emit q->bytesWritten(packet.body.size());
+				q->emitBytesWritten(packet.body.size());
 			}
 		}
 
@@ -560,6 +633,8 @@ public:
 
 		if(packet.type == ZhttpRequestPacket::Data)
 		{
+			trackReceiveWindow(requestBodyBuf.isEmpty(), packet.more, packet.body.size());
+
 			requestBodyBuf += packet.body;
 
 			bool done = haveRequestBody;
@@ -574,7 +649,7 @@ public:
 				outCredits += packet.credits;
 
 			if(!packet.body.isEmpty() || (!done && haveRequestBody))
-				emit q->readyRead();
+				q->emitReadyRead();
 		}
 		else if(packet.type == ZhttpRequestPacket::Credit)
 		{
@@ -724,8 +799,10 @@ public:
 			}
 			else
 			{
-				if(responseBodyBuf.size() + packet.body.size() > IDEAL_CREDITS)
+				if(responseBodyBuf.size() + packet.body.size() > inWindow)
 					log_warning("zhttp client: id=%s server is sending too fast", id.data());
+
+				trackReceiveWindow(responseBodyBuf.isEmpty(), packet.more, packet.body.size());
 			}
 
 			responseBodyBuf += packet.body;
@@ -746,14 +823,14 @@ public:
 			if(packet.more)
 			{
 				if(needToSendHeaders || !packet.body.isEmpty())
-					emit q->readyRead();
+					q->emitReadyRead();
 			}
 			else
 			{
 				// always emit readyRead here even if body is empty, for EOF
 				state = Stopped;
 				cleanup();
-				emit q->readyRead();
+				q->emitReadyRead();
 			}
 		}
 		else if(packet.type == ZhttpResponsePacket::Credit)
@@ -826,6 +903,8 @@ public:
 				manager->writeHttp(out, toAddress);
 			}
 		}
+
+		manager->keepAliveActivity(q);
 	}
 
 	void writePacket(const ZhttpResponsePacket &packet)
@@ -836,8 +915,10 @@ public:
 		out.from = manager->instanceId();
 		out.ids += ZhttpResponsePacket::Id(rid.second, outSeq++);
 		out.userData = userData;
-		
+
 		manager->writeHttp(out, rid.first);
+
+		manager->keepAliveActivity(q);
 	}
 
 	void writeCancel()
@@ -957,7 +1038,7 @@ public slots:
 
 					state = ClientRequestFinishWait;
 
-					emit q->bytesWritten(p.body.size());
+					q->emitBytesWritten(p.body.size());
 				}
 			}
 			else
@@ -1003,7 +1084,7 @@ public slots:
 					p.passthrough = passthrough;
 				if(quiet)
 					p.quiet = true;
-				p.credits = IDEAL_CREDITS;
+				p.credits = inWindow;
 				p.multi = true;
 				writePacket(p);
 
@@ -1013,9 +1094,9 @@ public slots:
 					state = ClientRequestFinishWait;
 
 				if(!p.body.isEmpty())
-					emit q->bytesWritten(p.body.size());
+					q->emitBytesWritten(p.body.size());
 				else if(!p.more)
-					emit q->bytesWritten(0);
+					q->emitBytesWritten(0);
 			}
 		}
 		else if(state == ClientRequesting)
@@ -1042,13 +1123,13 @@ public slots:
 				// send credits ack
 				ZhttpResponsePacket p;
 				p.type = ZhttpResponsePacket::Credit;
-				p.credits = IDEAL_CREDITS - responseBodyBuf.size();
+				p.credits = inWindow - responseBodyBuf.size();
 				if(multi)
 					p.multi = true;
 				writePacket(p);
 			}
 
-			emit q->readyRead();
+			q->emitReadyRead();
 		}
 		else if(state == ServerResponseWait)
 		{
@@ -1078,9 +1159,9 @@ public slots:
 			QPointer<QObject> self = this;
 
 			if(!packet.body.isEmpty())
-				emit q->bytesWritten(packet.body.size());
+				q->emitBytesWritten(packet.body.size());
 			else if(!packet.more)
-				emit q->bytesWritten(0);
+				q->emitBytesWritten(0);
 
 			if(!self)
 				return;
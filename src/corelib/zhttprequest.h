@@ -31,6 +31,7 @@
 
 #include <QVariant>
 #include "httprequest.h"
+#include "rid.h"
 
 class ZhttpRequestPacket;
 class ZhttpResponsePacket;
@@ -41,8 +42,8 @@ class ZhttpRequest : public HttpRequest
 	Q_OBJECT
 
 public:
-	// pair of sender + request id
-	typedef QPair<QByteArray, QByteArray> Rid;
+	// sender + request id, with the hash cached at construction
+	typedef ::Rid Rid;
 
 	class ServerState
 	{
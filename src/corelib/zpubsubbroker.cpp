@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "zpubsubbroker.h"
+
+#include <QStringList>
+#include "qzmqsocket.h"
+#include "zutil.h"
+#include "log.h"
+
+class ZPubSubBroker::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	ZPubSubBroker *q;
+	QZmq::Socket *frontSock;
+	QZmq::Socket *backSock;
+	int hwm;
+	int ipcFileMode;
+
+	Private(ZPubSubBroker *_q) :
+		QObject(_q),
+		q(_q),
+		frontSock(0),
+		backSock(0),
+		hwm(-1),
+		ipcFileMode(-1)
+	{
+	}
+
+	bool setup(const QString &frontSpec, const QString &backSpec, QString *errorMessage)
+	{
+		frontSock = new QZmq::Socket(QZmq::Socket::XSub, this);
+		frontSock->setShutdownWaitTime(0);
+		if(hwm >= 0)
+			frontSock->setHwm(hwm);
+
+		connect(frontSock, &QZmq::Socket::readyRead, this, &Private::front_readyRead);
+
+		if(!ZUtil::setupSocket(frontSock, frontSpec, true, ipcFileMode, errorMessage))
+			return false;
+
+		backSock = new QZmq::Socket(QZmq::Socket::XPub, this);
+		backSock->setShutdownWaitTime(0);
+		if(hwm >= 0)
+			backSock->setHwm(hwm);
+
+		connect(backSock, &QZmq::Socket::readyRead, this, &Private::back_readyRead);
+
+		if(!ZUtil::setupSocket(backSock, backSpec, true, ipcFileMode, errorMessage))
+			return false;
+
+		return true;
+	}
+
+public slots:
+	void front_readyRead()
+	{
+		// published messages flow front to back. xpub applies the
+		//   subscription filter on the way out
+		while(frontSock->canRead())
+			backSock->write(frontSock->read());
+	}
+
+	void back_readyRead()
+	{
+		// subscribe/unsubscribe frames flow back to front, where zmq
+		//   delivers them into the publishers' own filters
+		while(backSock->canRead())
+			frontSock->write(backSock->read());
+	}
+};
+
+ZPubSubBroker::ZPubSubBroker(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+ZPubSubBroker::~ZPubSubBroker()
+{
+	delete d;
+}
+
+void ZPubSubBroker::setHwm(int hwm)
+{
+	d->hwm = hwm;
+}
+
+void ZPubSubBroker::setIpcFileMode(int mode)
+{
+	d->ipcFileMode = mode;
+}
+
+bool ZPubSubBroker::setup(const QString &frontSpec, const QString &backSpec, QString *errorMessage)
+{
+	return d->setup(frontSpec, backSpec, errorMessage);
+}
+
+#include "zpubsubbroker.moc"
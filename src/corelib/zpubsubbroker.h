@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef ZPUBSUBBROKER_H
+#define ZPUBSUBBROKER_H
+
+#include <QObject>
+
+// an XPUB/XSUB forwarder. publishers connect to the front side and
+//   subscribers to the back side. subscription frames received on the
+//   back side are propagated out the front side, so publishers only
+//   carry messages for channels that somebody is actually subscribed to
+
+class ZPubSubBroker : public QObject
+{
+	Q_OBJECT
+
+public:
+	ZPubSubBroker(QObject *parent = 0);
+	~ZPubSubBroker();
+
+	void setHwm(int hwm);
+	void setIpcFileMode(int mode);
+
+	// binds an XSUB socket at frontSpec for publishers and an XPUB
+	//   socket at backSpec for subscribers
+	bool setup(const QString &frontSpec, const QString &backSpec, QString *errorMessage = 0);
+
+private:
+	class Private;
+	Private *d;
+};
+
+#endif
@@ -73,6 +73,8 @@ public:
 	QZmq::Valve *serverValve;
 	QHash<QByteArray, ZrpcRequest*> clientReqsById;
 	QList<PendingItem> pending;
+	QList<ZrpcRequestPacket> clientPending;
+	int clientPendingMax;
 
 	Private(ZrpcManager *_q) :
 		QObject(_q),
@@ -83,7 +85,8 @@ public:
 		clientSock(0),
 		serverSock(0),
 		clientValve(0),
-		serverValve(0)
+		serverValve(0),
+		clientPendingMax(PENDING_MAX)
 	{
 	}
 
@@ -98,10 +101,13 @@ public:
 		delete clientSock;
 
 		clientSock = new QZmq::Socket(QZmq::Socket::Dealer, this);
+		connect(clientSock, &QZmq::Socket::messagesWritten, this, &Private::clientSock_messagesWritten);
 
 		clientSock->setSendHwm(OUT_HWM);
 		clientSock->setShutdownWaitTime(REQ_WAIT_TIME);
 
+		clientPending.clear();
+
 		QString errorMessage;
 		if(!ZUtil::setupSocket(clientSock, clientSpecs, doBind, ipcFileMode, &errorMessage))
 		{
@@ -146,6 +152,19 @@ public:
 	{
 		assert(clientSock);
 
+		// requests are correlated by id, so many can be outstanding
+		//   at once. if the socket is busy, queue and preserve order
+		if(!clientPending.isEmpty() || !clientSock->canWriteImmediately())
+		{
+			clientPending += packet;
+			return;
+		}
+
+		writeClientNow(packet);
+	}
+
+	void writeClientNow(const ZrpcRequestPacket &packet)
+	{
 		QVariant vpacket = packet.toVariant();
 		QByteArray buf = TnetString::fromVariant(vpacket);
 
@@ -173,6 +192,14 @@ public:
 	}
 
 private slots:
+	void clientSock_messagesWritten(int count)
+	{
+		Q_UNUSED(count);
+
+		while(!clientPending.isEmpty() && clientSock->canWriteImmediately())
+			writeClientNow(clientPending.takeFirst());
+	}
+
 	void client_readyRead(const QList<QByteArray> &message)
 	{
 		if(message.count() != 2)
@@ -311,11 +338,21 @@ ZrpcRequest *ZrpcManager::takeNext()
 	return req;
 }
 
+int ZrpcManager::pendingMax() const
+{
+	return d->clientPendingMax;
+}
+
+void ZrpcManager::setPendingMax(int count)
+{
+	d->clientPendingMax = count;
+}
+
 bool ZrpcManager::canWriteImmediately() const
 {
 	assert(d->clientSock);
 
-	return d->clientSock->canWriteImmediately();
+	return d->clientSock->canWriteImmediately() || d->clientPending.count() < d->clientPendingMax;
 }
 
 void ZrpcManager::link(ZrpcRequest *req)
@@ -44,10 +44,15 @@ public:
 	~ZrpcManager();
 
 	int timeout() const;
+	int pendingMax() const;
 
 	void setIpcFileMode(int mode);
 	void setBind(bool enable);
 	void setTimeout(int ms);
+
+	// max requests to queue while the socket is busy (the pipelining
+	//   window). requests beyond this fail with ErrorUnavailable
+	void setPendingMax(int count);
 	void setUnavailableOnTimeout(bool enable);
 
 	bool setClientSpecs(const QStringList &specs);
@@ -29,6 +29,9 @@
 #include "zwebsocket.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
 #include <QTimer>
 #include <QPointer>
 #include "zhttprequestpacket.h"
@@ -41,6 +44,111 @@
 #define SESSION_EXPIRE 60000
 #define KEEPALIVE_INTERVAL 45000
 
+// fifo of frames backed by a ring whose storage is retained at its
+//   high-water mark, so a session pushing small frames at a high rate
+//   stops allocating once warmed up. QList would heap-allocate a node
+//   per frame. frame payloads are QByteArrays, so handing frames in
+//   and out shares the data refcounted rather than copying it
+class FrameQueue
+{
+public:
+	FrameQueue() :
+		buf_(0),
+		capacity_(0),
+		head_(0),
+		count_(0)
+	{
+	}
+
+	~FrameQueue()
+	{
+		clear();
+		free(buf_);
+	}
+
+	bool isEmpty() const
+	{
+		return (count_ == 0);
+	}
+
+	int count() const
+	{
+		return count_;
+	}
+
+	const WebSocket::Frame &first() const
+	{
+		assert(count_ > 0);
+
+		return buf_[head_];
+	}
+
+	const WebSocket::Frame &at(int i) const
+	{
+		assert(i >= 0 && i < count_);
+
+		return buf_[(head_ + i) % capacity_];
+	}
+
+	void append(const WebSocket::Frame &frame)
+	{
+		if(count_ == capacity_)
+			grow();
+
+		new (&buf_[(head_ + count_) % capacity_]) WebSocket::Frame(frame);
+		++count_;
+	}
+
+	WebSocket::Frame takeFirst()
+	{
+		assert(count_ > 0);
+
+		WebSocket::Frame f = buf_[head_];
+		buf_[head_].~Frame();
+		head_ = (head_ + 1) % capacity_;
+		--count_;
+
+		return f;
+	}
+
+	void clear()
+	{
+		while(count_ > 0)
+		{
+			buf_[head_].~Frame();
+			head_ = (head_ + 1) % capacity_;
+			--count_;
+		}
+
+		head_ = 0;
+	}
+
+private:
+	WebSocket::Frame *buf_;
+	int capacity_;
+	int head_;
+	int count_;
+
+	void grow()
+	{
+		int newCapacity = qMax(capacity_ * 2, 8);
+		WebSocket::Frame *newBuf = (WebSocket::Frame *)malloc(newCapacity * sizeof(WebSocket::Frame));
+
+		// frames hold no pointers to themselves, so relocate by raw
+		//   copy without touching the payload refcounts
+		for(int n = 0; n < count_; ++n)
+			memcpy((void *)&newBuf[n], (const void *)&buf_[(head_ + n) % capacity_], sizeof(WebSocket::Frame));
+
+		free(buf_);
+		buf_ = newBuf;
+		capacity_ = newCapacity;
+		head_ = 0;
+	}
+
+	FrameQueue(const FrameQueue &);
+	FrameQueue &operator=(const FrameQueue &);
+};
+
 class ZWebSocket::Private : public QObject
 {
 	Q_OBJECT
@@ -89,8 +197,8 @@ public:
 	ErrorCondition errorCondition;
 	QTimer *expireTimer;
 	QTimer *keepAliveTimer;
-	QList<Frame> inFrames;
-	QList<Frame> outFrames;
+	FrameQueue inFrames;
+	FrameQueue outFrames;
 	int inSize;
 	int inContentType;
 	int outContentType;
@@ -302,7 +410,7 @@ public:
 		//   the only way for the user to fully avoid it is by checking
 		//   canWrite() beforehand which is burdensome
 		assert(state == Connected || state == ConnectedPeerClosed);
-		outFrames += frame;
+		outFrames.append(frame);
 		update();
 	}
 
@@ -365,7 +473,7 @@ public:
 
 			if(written > 0)
 			{
-				emit q->framesWritten(written, contentBytesWritten);
+				q->emitFramesWritten(written, contentBytesWritten);
 				if(!self)
 					return;
 			}
@@ -417,7 +525,7 @@ public:
 			inContentType = (int)ftype;
 		}
 
-		inFrames += Frame(ftype, !data.isNull() ? data : QByteArray(""), more);
+		inFrames.append(Frame(ftype, !data.isNull() ? data : QByteArray(""), more));
 		inSize += data.size();
 
 		if(!more)
@@ -483,12 +591,12 @@ public:
 			}
 			else if(packet.type == ZhttpRequestPacket::Ping)
 			{
-				inFrames += Frame(Frame::Ping, packet.body, false);
+				inFrames.append(Frame(Frame::Ping, packet.body, false));
 				inSize += packet.body.size();
 			}
 			else if(packet.type == ZhttpRequestPacket::Pong)
 			{
-				inFrames += Frame(Frame::Pong, packet.body, false);
+				inFrames.append(Frame(Frame::Pong, packet.body, false));
 				inSize += packet.body.size();
 			}
 
@@ -505,7 +613,7 @@ public:
 				}
 			}
 
-			emit q->readyRead();
+			q->emitReadyRead();
 		}
 		else if(packet.type == ZhttpRequestPacket::Close)
 		{
@@ -640,12 +748,12 @@ public:
 				}
 				else if(packet.type == ZhttpResponsePacket::Ping)
 				{
-					inFrames += Frame(Frame::Ping, packet.body, false);
+					inFrames.append(Frame(Frame::Ping, packet.body, false));
 					inSize += packet.body.size();
 				}
 				else if(packet.type == ZhttpResponsePacket::Pong)
 				{
-					inFrames += Frame(Frame::Pong, packet.body, false);
+					inFrames.append(Frame(Frame::Pong, packet.body, false));
 					inSize += packet.body.size();
 				}
 
@@ -662,7 +770,7 @@ public:
 					}
 				}
 
-				emit q->readyRead();
+				q->emitReadyRead();
 			}
 		}
 		else if(packet.type == ZhttpResponsePacket::Close)
@@ -732,6 +840,8 @@ public:
 			assert(!toAddress.isEmpty());
 			manager->writeWs(out, toAddress);
 		}
+
+		manager->keepAliveActivity(q);
 	}
 
 	void writePacket(const ZhttpResponsePacket &packet)
@@ -742,8 +852,10 @@ public:
 		out.from = manager->instanceId();
 		out.ids += ZhttpResponsePacket::Id(rid.second, outSeq++);
 		out.userData = userData;
-		
+
 		manager->writeWs(out, rid.first);
+
+		manager->keepAliveActivity(q);
 	}
 
 	void writeFrameInternal(const Frame &frame, int credits = -1)
@@ -1186,8 +1298,10 @@ bool ZWebSocket::canWrite() const
 int ZWebSocket::writeBytesAvailable() const
 {
 	int avail = d->outCredits;
-	foreach(const Frame &f, d->outFrames)
+	for(int n = 0; n < d->outFrames.count(); ++n)
 	{
+		const Frame &f = d->outFrames.at(n);
+
 		if(f.data.size() >= avail)
 			return 0;
 
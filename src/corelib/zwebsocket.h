@@ -30,6 +30,7 @@
 #define ZWEBSOCKET_H
 
 #include "websocket.h"
+#include "rid.h"
 
 class ZhttpRequestPacket;
 class ZhttpResponsePacket;
@@ -40,8 +41,8 @@ class ZWebSocket : public WebSocket
 	Q_OBJECT
 
 public:
-	// pair of sender + request id
-	typedef QPair<QByteArray, QByteArray> Rid;
+	// sender + request id, with the hash cached at construction
+	typedef ::Rid Rid;
 
 	~ZWebSocket();
 
@@ -147,6 +147,43 @@ static CommandLineParseResult parseCommandLine(QCommandLineParser *parser, ArgsD
 	return CommandLineOk;
 }
 
+// settings that a running engine can accept without restarting. read at
+//   startup and again on reload (see Engine::reload)
+static void readRuntimeSettings(Settings *settings, Engine::Configuration *config)
+{
+	config->messageRate = settings->value("handler/message_rate", -1).toInt();
+	config->messageHwm = settings->value("handler/message_hwm", -1).toInt();
+	config->messageBlockSize = settings->value("handler/message_block_size", -1).toInt();
+	config->priorityChannelPrefixes = settings->value("handler/priority_channel_prefixes").toStringList();
+	config->lastItemChannelPrefixes = settings->value("handler/last_item_channel_prefixes").toStringList();
+	config->replayChannelPrefixes = settings->value("handler/replay_channel_prefixes").toStringList();
+	config->replayItemsMax = settings->value("handler/replay_items_max", 64).toInt();
+	config->replayBytesMax = settings->value("handler/replay_bytes_max", 262144).toLongLong();
+	config->replayItemTtl = settings->value("handler/replay_item_ttl", 60).toInt();
+	config->idCacheTtl = settings->value("handler/id_cache_ttl", 0).toInt();
+	config->connectionSubscriptionMax = settings->value("handler/connection_subscription_max", 20).toInt();
+	config->routeConnectionsMax = settings->value("handler/route_connections_max", -1).toInt();
+	config->routeHeldBytesMax = settings->value("handler/route_held_bytes_max", -1).toLongLong();
+	config->routeSubscriptionsMax = settings->value("handler/route_subscriptions_max", -1).toInt();
+	config->publishQueueHwm = settings->value("handler/publish_queue_hwm", 100000).toInt();
+	config->publishQueueLwm = settings->value("handler/publish_queue_lwm", -1).toInt();
+	config->publishQueueOverflow = settings->value("handler/publish_queue_overflow", "drop-newest").toString();
+	config->publishDedupWindow = settings->value("handler/publish_dedup_window", 0).toInt() * 1000;
+	config->unsubscribeLinger = settings->value("handler/unsubscribe_linger", 0).toInt();
+	config->unsubscribeLingerMax = settings->value("handler/unsubscribe_linger_max", 10000).toInt();
+	config->subscriptionLinger = settings->value("handler/subscription_linger", 60).toInt();
+	config->statsConnectionTtl = settings->value("global/stats_connection_ttl", 120).toInt();
+	config->statsSubscriptionTtl = settings->value("handler/stats_subscription_ttl", 60).toInt();
+	config->statsReportInterval = settings->value("handler/stats_report_interval", 10).toInt();
+	config->statsFormat = settings->value("handler/stats_format", QString("tnetstring")).toString();
+	config->eventLoopStallThreshold = settings->value("handler/event_loop_stall_threshold", 0).toInt();
+	config->busyPollIdleTimeout = settings->value("handler/busy_poll_idle_timeout", 0).toInt();
+	config->expectedConnections = settings->value("handler/expected_connections", 0).toInt();
+	config->expectedChannels = settings->value("handler/expected_channels", 0).toInt();
+	config->hugePages = settings->value("handler/huge_pages").toBool();
+	config->streamGzip = settings->value("handler/stream_gzip").toBool();
+}
+
 class App::Private : public QObject
 {
 	Q_OBJECT
@@ -154,6 +191,7 @@ class App::Private : public QObject
 public:
 	App *q;
 	ArgsData args;
+	QString configFile;
 	Engine *engine;
 
 	Private(App *_q) :
@@ -209,7 +247,7 @@ public:
 
 		log_info("starting...");
 
-		QString configFile = args.configFile;
+		configFile = args.configFile;
 		if(configFile.isEmpty())
 			configFile = QDir(CONFIGDIR).filePath("pushpin.conf");
 
@@ -248,26 +286,28 @@ public:
 		QString ws_control_in_spec = settings.value("handler/proxy_ws_control_in_spec").toString();
 		QString ws_control_out_spec = settings.value("handler/proxy_ws_control_out_spec").toString();
 		QString stats_spec = settings.value("handler/stats_spec").toString();
+		QStringList stats_in_specs = settings.value("handler/stats_in_specs").toStringList();
 		QString command_spec = settings.value("handler/command_spec").toString();
 		QString state_spec = settings.value("handler/state_spec").toString();
 		QString proxy_stats_spec = settings.value("handler/proxy_stats_spec").toString();
 		QString proxy_command_spec = settings.value("handler/proxy_command_spec").toString();
-		QString push_in_spec = settings.value("handler/push_in_spec").toString();
+		QStringList push_in_specs = settings.value("handler/push_in_spec").toStringList();
 		QString push_in_sub_spec = settings.value("handler/push_in_sub_spec").toString();
+		QString push_in_broker_spec = settings.value("handler/push_in_broker_spec").toString();
+		QString peer_out_spec = settings.value("handler/peer_out_spec").toString();
+		QStringList peer_in_specs = settings.value("handler/peer_in_specs").toStringList();
 		QString push_in_http_addr = settings.value("handler/push_in_http_addr").toString();
 		int push_in_http_port = settings.adjustedPort("handler/push_in_http_port");
 		bool ok;
 		int ipcFileMode = settings.value("handler/ipc_file_mode", -1).toString().toInt(&ok, 8);
 		bool shareAll = settings.value("handler/share_all").toBool();
-		int messageRate = settings.value("handler/message_rate", -1).toInt();
-		int messageHwm = settings.value("handler/message_hwm", -1).toInt();
-		int messageBlockSize = settings.value("handler/message_block_size", -1).toInt();
-		int idCacheTtl = settings.value("handler/id_cache_ttl", 0).toInt();
-		int connectionSubscriptionMax = settings.value("handler/connection_subscription_max", 20).toInt();
-		int subscriptionLinger = settings.value("handler/subscription_linger", 60).toInt();
-		int statsConnectionTtl = settings.value("global/stats_connection_ttl", 120).toInt();
-		int statsSubscriptionTtl = settings.value("handler/stats_subscription_ttl", 60).toInt();
-		int statsReportInterval = settings.value("handler/stats_report_interval", 10).toInt();
+		int publishShardSize = settings.value("handler/publish_shard_size", -1).toInt();
+		int shardId = settings.value("handler/shard_id", 0).toInt();
+		int shardCount = settings.value("handler/shard_count", 0).toInt();
+		QString lastIdsFile = settings.value("handler/last_ids_file").toString();
+		QString publishSpoolFile = settings.value("handler/publish_spool_file").toString();
+		qint64 publishSpoolSize = settings.value("handler/publish_spool_size", 1073741824).toLongLong();
+		int zmqHwm = settings.value("handler/zmq_hwm", -1).toInt();
 
 		if(m2a_in_stream_specs.isEmpty() || m2a_out_specs.isEmpty())
 		{
@@ -283,6 +323,20 @@ public:
 			return;
 		}
 
+		if(!push_in_broker_spec.isEmpty() && push_in_sub_spec.isEmpty())
+		{
+			log_error("push_in_broker_spec requires push_in_sub_spec");
+			emit q->quit();
+			return;
+		}
+
+		if(shardCount > 0 && (shardId < 0 || shardId >= shardCount))
+		{
+			log_error("shard_id must be in the range 0 to shard_count-1");
+			emit q->quit();
+			return;
+		}
+
 		Engine::Configuration config;
 		config.appVersion = VERSION;
 		config.instanceId = "pushpin-handler_" + QByteArray::number(QCoreApplication::applicationPid());
@@ -297,25 +351,28 @@ public:
 		config.wsControlInSpec = ws_control_in_spec;
 		config.wsControlOutSpec = ws_control_out_spec;
 		config.statsSpec = stats_spec;
+		config.statsInSpecs = stats_in_specs;
 		config.commandSpec = command_spec;
 		config.stateSpec = state_spec;
 		config.proxyStatsSpec = proxy_stats_spec;
 		config.proxyCommandSpec = proxy_command_spec;
-		config.pushInSpec = push_in_spec;
+		config.pushInSpecs = push_in_specs;
 		config.pushInSubSpec = push_in_sub_spec;
+		config.pushInBrokerSpec = push_in_broker_spec;
+		config.peerOutSpec = peer_out_spec;
+		config.peerInSpecs = peer_in_specs;
 		config.pushInHttpAddr = QHostAddress(push_in_http_addr);
 		config.pushInHttpPort = push_in_http_port;
 		config.ipcFileMode = ipcFileMode;
 		config.shareAll = shareAll;
-		config.messageRate = messageRate;
-		config.messageHwm = messageHwm;
-		config.messageBlockSize = messageBlockSize;
-		config.idCacheTtl = idCacheTtl;
-		config.connectionSubscriptionMax = connectionSubscriptionMax;
-		config.subscriptionLinger = subscriptionLinger;
-		config.statsConnectionTtl = statsConnectionTtl;
-		config.statsSubscriptionTtl = statsSubscriptionTtl;
-		config.statsReportInterval = statsReportInterval;
+		config.publishShardSize = publishShardSize;
+		config.shardId = shardId;
+		config.shardCount = shardCount;
+		config.lastIdsFile = lastIdsFile;
+		config.publishSpoolFile = publishSpoolFile;
+		config.publishSpoolSize = publishSpoolSize;
+		config.zmqHwm = zmqHwm;
+		readRuntimeSettings(&settings, &config);
 
 		engine = new Engine(this);
 		if(!engine->start(config))
@@ -332,7 +389,18 @@ private slots:
 	{
 		log_info("reloading");
 		log_rotate();
-		engine->reload();
+
+		if(!engine)
+			return;
+
+		// re-read the config and hand the engine the fields it can
+		//   apply without restarting. socket specs, shard layout, and
+		//   identity still require a restart to change
+		Settings settings(configFile);
+
+		Engine::Configuration config;
+		readRuntimeSettings(&settings, &config);
+		engine->reload(config);
 	}
 
 	void doQuit()
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "bodycache.h"
+
+#include "stablehash.h"
+
+BodyCache::BodyCache(qint64 maxBytes) :
+	maxBytes_(maxBytes),
+	totalBytes_(0),
+	evictions_(0),
+	useSeq_(0)
+{
+}
+
+QByteArray BodyCache::intern(const QByteArray &body)
+{
+	if(body.isEmpty() || body.size() > maxBytes_)
+		return body;
+
+	quint64 h = stableHash64(body);
+
+	QHash<quint64, Entry>::iterator it = entriesByHash_.find(h);
+	if(it != entriesByHash_.end())
+	{
+		Entry &e = it.value();
+
+		if(e.body == body)
+		{
+			hashesByLastUse_.remove(e.lastUse);
+			e.lastUse = ++useSeq_;
+			hashesByLastUse_.insert(e.lastUse, h);
+
+			return e.body;
+		}
+
+		// hash collision. keep the existing entry and don't share
+		return body;
+	}
+
+	while(totalBytes_ + body.size() > maxBytes_ && !hashesByLastUse_.isEmpty())
+	{
+		QMap<quint64, quint64>::iterator oldest = hashesByLastUse_.begin();
+		Entry old = entriesByHash_.take(oldest.value());
+		hashesByLastUse_.erase(oldest);
+
+		totalBytes_ -= old.body.size();
+		++evictions_;
+	}
+
+	Entry e;
+	e.body = body;
+	e.lastUse = ++useSeq_;
+
+	entriesByHash_.insert(h, e);
+	hashesByLastUse_.insert(e.lastUse, h);
+	totalBytes_ += body.size();
+
+	return body;
+}
+
+qint64 BodyCache::totalBytes() const
+{
+	return totalBytes_;
+}
+
+quint64 BodyCache::evictions() const
+{
+	return evictions_;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef BODYCACHE_H
+#define BODYCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+
+// content-addressed pool of retained request bodies. every held
+//   connection keeps its request data around for the retry flow, so
+//   when many connections carry identical requests the retained copies
+//   can all point at one shared buffer instead of separate allocations.
+//   entries are evicted by least recent use once the pool exceeds
+//   maxBytes. eviction only limits future sharing; buffers already
+//   handed out stay valid through their own references
+class BodyCache
+{
+public:
+	BodyCache(qint64 maxBytes = 1048576);
+
+	// return a buffer equal to body, shared with previous callers when
+	//   possible
+	QByteArray intern(const QByteArray &body);
+
+	qint64 totalBytes() const;
+	quint64 evictions() const;
+
+private:
+	class Entry
+	{
+	public:
+		QByteArray body;
+		quint64 lastUse;
+
+		Entry() :
+			lastUse(0)
+		{
+		}
+	};
+
+	qint64 maxBytes_;
+	qint64 totalBytes_;
+	quint64 evictions_;
+	quint64 useSeq_;
+	QHash<quint64, Entry> entriesByHash_;
+	QMap<quint64, quint64> hashesByLastUse_;
+};
+
+#endif
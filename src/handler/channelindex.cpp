@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "channelindex.h"
+
+class ChannelIndex::Node
+{
+public:
+	QHash<QChar, Node*> children;
+	QSet<QObject*> targets; // prefix subscriptions ending at this node
+
+	~Node()
+	{
+		qDeleteAll(children);
+	}
+};
+
+static QString wildcardPrefix(const QString &channel)
+{
+	if(ChannelIndex::isWildcard(channel))
+		return channel.mid(0, channel.length() - 1);
+
+	return channel;
+}
+
+ChannelIndex::ChannelIndex()
+{
+	root_ = new Node;
+}
+
+ChannelIndex::~ChannelIndex()
+{
+	delete root_;
+}
+
+bool ChannelIndex::isWildcard(const QString &channel)
+{
+	return channel.endsWith('*');
+}
+
+void ChannelIndex::add(const QString &channel, QObject *target)
+{
+	QString prefix = wildcardPrefix(channel);
+
+	Node *n = root_;
+	for(int at = 0; at < prefix.length(); ++at)
+	{
+		QChar c = prefix[at];
+
+		Node *next = n->children.value(c);
+		if(!next)
+		{
+			next = new Node;
+			n->children.insert(c, next);
+		}
+
+		n = next;
+	}
+
+	n->targets += target;
+}
+
+void ChannelIndex::remove(const QString &channel, QObject *target)
+{
+	QString prefix = wildcardPrefix(channel);
+
+	// walk to the subscription's node, remembering the path so empty
+	//   nodes can be pruned afterwards
+	QList<Node*> path;
+	Node *n = root_;
+	path += n;
+	for(int at = 0; at < prefix.length(); ++at)
+	{
+		n = n->children.value(prefix[at]);
+		if(!n)
+			return;
+
+		path += n;
+	}
+
+	n->targets.remove(target);
+
+	for(int at = prefix.length(); at >= 1; --at)
+	{
+		Node *cur = path[at];
+		if(!cur->targets.isEmpty() || !cur->children.isEmpty())
+			break;
+
+		path[at - 1]->children.remove(prefix[at - 1]);
+		delete cur;
+	}
+}
+
+bool ChannelIndex::contains(const QString &channel) const
+{
+	return (count(channel) > 0);
+}
+
+int ChannelIndex::count(const QString &channel) const
+{
+	return subscribers(channel).count();
+}
+
+QSet<QObject*> ChannelIndex::subscribers(const QString &channel) const
+{
+	QString prefix = wildcardPrefix(channel);
+
+	Node *n = root_;
+	for(int at = 0; at < prefix.length(); ++at)
+	{
+		n = n->children.value(prefix[at]);
+		if(!n)
+			return QSet<QObject*>();
+	}
+
+	return n->targets;
+}
+
+QSet<QObject*> ChannelIndex::matches(const QString &channel) const
+{
+	QSet<QObject*> out;
+
+	Node *n = root_;
+	out += n->targets;
+
+	for(int at = 0; at < channel.length(); ++at)
+	{
+		n = n->children.value(channel[at]);
+		if(!n)
+			break;
+
+		out += n->targets;
+	}
+
+	return out;
+}
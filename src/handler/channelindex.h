@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef CHANNELINDEX_H
+#define CHANNELINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+class QObject;
+
+// trie of prefix (wildcard) channel subscriptions. a subscription string
+//   ending in '*' matches any channel starting with the part before the
+//   '*'. lookup cost is bounded by the channel name length, regardless of
+//   how many subscriptions are registered.
+class ChannelIndex
+{
+public:
+	ChannelIndex();
+	~ChannelIndex();
+
+	static bool isWildcard(const QString &channel);
+
+	void add(const QString &channel, QObject *target);
+	void remove(const QString &channel, QObject *target);
+
+	// these operate on the subscription string, e.g. "orders.*"
+	bool contains(const QString &channel) const;
+	int count(const QString &channel) const;
+	QSet<QObject*> subscribers(const QString &channel) const;
+
+	// targets of all prefix subscriptions matching a concrete channel
+	QSet<QObject*> matches(const QString &channel) const;
+
+private:
+	class Node;
+
+	Node *root_;
+
+	ChannelIndex(const ChannelIndex &other);
+	ChannelIndex & operator=(const ChannelIndex &other);
+};
+
+#endif
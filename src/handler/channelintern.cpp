@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "channelintern.h"
+
+#include <assert.h>
+
+ChannelIntern::ChannelIntern()
+{
+}
+
+int ChannelIntern::add(const QString &name)
+{
+	int id = idsByName_.value(name, -1);
+	if(id >= 0)
+	{
+		++(entries_[id].refs);
+		return id;
+	}
+
+	if(!freeIds_.isEmpty())
+	{
+		id = freeIds_.takeLast();
+	}
+	else
+	{
+		id = entries_.count();
+		entries_ += Entry();
+	}
+
+	Entry &e = entries_[id];
+	e.name = name;
+	e.refs = 1;
+
+	idsByName_.insert(name, id);
+
+	return id;
+}
+
+int ChannelIntern::id(const QString &name) const
+{
+	return idsByName_.value(name, -1);
+}
+
+QString ChannelIntern::name(int id) const
+{
+	if(id < 0 || id >= entries_.count())
+		return QString();
+
+	return entries_[id].name;
+}
+
+void ChannelIntern::release(int id)
+{
+	assert(id >= 0 && id < entries_.count());
+
+	Entry &e = entries_[id];
+	assert(e.refs > 0);
+
+	--e.refs;
+	if(e.refs == 0)
+	{
+		idsByName_.remove(e.name);
+		e.name = QString();
+		freeIds_ += id;
+	}
+}
+
+int ChannelIntern::count() const
+{
+	return idsByName_.count();
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef CHANNELINTERN_H
+#define CHANNELINTERN_H
+
+#include <QString>
+#include <QHash>
+#include <QVector>
+#include <QList>
+
+// maps channel names to small integer ids, so that per-channel indexes
+//   can key on ints instead of rehashing the same strings. ids are
+//   refcounted and recycled: each add() takes a reference that must be
+//   returned with release()
+class ChannelIntern
+{
+public:
+	ChannelIntern();
+
+	// intern the name, creating an id on first sight
+	int add(const QString &name);
+
+	// id of an already-interned name, or -1 if not present
+	int id(const QString &name) const;
+
+	// name for an id, or null string if not present
+	QString name(int id) const;
+
+	void release(int id);
+
+	int count() const;
+
+private:
+	class Entry
+	{
+	public:
+		QString name;
+		int refs;
+
+		Entry() :
+			refs(0)
+		{
+		}
+	};
+
+	QHash<QString, int> idsByName_;
+	QVector<Entry> entries_;
+	QList<int> freeIds_;
+};
+
+#endif
@@ -30,10 +30,12 @@
 #define CIDSET_H
 
 #include <QSet>
-#include <QString>
+#include <QByteArray>
 #include <QMetaType>
 
-typedef QSet<QString> CidSet;
+// connection ids are opaque byte strings from the wire. keep them as
+//   QByteArray so tracking a cid doesn't pay for a UTF-16 expansion
+typedef QSet<QByteArray> CidSet;
 Q_DECLARE_METATYPE(CidSet);
 
 #endif
@@ -48,6 +48,7 @@ ConnCheckWorker::ConnCheckWorker(ZrpcRequest *req, ZrpcManager *proxyControlClie
 
 	QVariantList vids = args["ids"].toList();
 
+	// build the response in one pass, rather than materializing id sets
 	foreach(const QVariant &vid, vids)
 	{
 		if(vid.type() != QVariant::ByteArray)
@@ -56,12 +57,11 @@ ConnCheckWorker::ConnCheckWorker(ZrpcRequest *req, ZrpcManager *proxyControlClie
 			return;
 		}
 
-		cids_ += QString::fromUtf8(vid.toByteArray());
-	}
+		QByteArray cid = vid.toByteArray();
 
-	foreach(const QString &cid, cids_)
-	{
-		if(!stats->checkConnection(cid.toUtf8()))
+		if(stats->checkConnection(cid))
+			result_ += vid;
+		else
 			missing_ += cid;
 	}
 
@@ -84,14 +84,7 @@ void ConnCheckWorker::respondError(const QByteArray &condition)
 
 void ConnCheckWorker::doFinish()
 {
-	foreach(const QString &cid, missing_)
-		cids_.remove(cid);
-
-	QVariantList result;
-	foreach(const QString &cid, cids_)
-		result += cid.toUtf8();
-
-	req_->respond(result);
+	req_->respond(result_);
 	setFinished(true);
 }
 
@@ -101,8 +94,11 @@ void ConnCheckWorker::proxyConnCheck_finished(const DeferredResult &result)
 	{
 		CidSet found = result.value.value<CidSet>();
 
-		foreach(const QString &cid, found)
-			missing_.remove(cid);
+		foreach(const QByteArray &cid, missing_)
+		{
+			if(found.contains(cid))
+				result_ += cid;
+		}
 
 		doFinish();
 	}
@@ -30,6 +30,7 @@
 #define CONNCHECKWORKER_H
 
 #include <QByteArray>
+#include <QVariantList>
 #include "deferred.h"
 #include "cidset.h"
 
@@ -46,7 +47,7 @@ public:
 
 private:
 	ZrpcRequest *req_;
-	CidSet cids_;
+	QVariantList result_;
 	CidSet missing_;
 
 	void respondError(const QByteArray &condition);
@@ -46,8 +46,8 @@ public:
 		connect(req, &ZrpcRequest::finished, this, &ConnCheck::req_finished);
 
 		QVariantList vcids;
-		foreach(const QString &cid, cids)
-			vcids += cid.toUtf8();
+		foreach(const QByteArray &cid, cids)
+			vcids += cid;
 
 		QVariantHash args;
 		args["ids"] = vcids;
@@ -79,7 +79,7 @@ private slots:
 					return;
 				}
 
-				out += QString::fromUtf8(vcid.toByteArray());
+				out += vcid.toByteArray();
 			}
 
 			setFinished(true, QVariant::fromValue<CidSet>(out));
@@ -118,6 +118,37 @@ public:
 	}
 };
 
+class RefreshBatch : public Deferred
+{
+	Q_OBJECT
+
+public:
+	RefreshBatch(ZrpcManager *controlClient, const QList<QByteArray> &cids, QObject *parent) :
+		Deferred(parent)
+	{
+		ZrpcRequest *req = new ZrpcRequest(controlClient, this);
+		connect(req, &ZrpcRequest::finished, this, &RefreshBatch::req_finished);
+
+		QVariantList vcids;
+		foreach(const QByteArray &cid, cids)
+			vcids += cid;
+
+		QVariantHash args;
+		args["cids"] = vcids;
+		req->start("refresh", args);
+	}
+
+	void req_finished()
+	{
+		ZrpcRequest *req = (ZrpcRequest *)sender();
+
+		if(req->success())
+			setFinished(true);
+		else
+			setFinished(false, req->errorConditionString());
+	}
+};
+
 class Report : public Deferred
 {
 	Q_OBJECT
@@ -155,6 +186,11 @@ Deferred *refresh(ZrpcManager *controlClient, const QByteArray &cid, QObject *pa
 	return new Refresh(controlClient, cid, parent);
 }
 
+Deferred *refreshBatch(ZrpcManager *controlClient, const QList<QByteArray> &cids, QObject *parent)
+{
+	return new RefreshBatch(controlClient, cids, parent);
+}
+
 Deferred *report(ZrpcManager *controlClient, const StatsPacket &packet, QObject *parent)
 {
 	return new Report(controlClient, packet, parent);
@@ -29,6 +29,7 @@
 #ifndef CONTROLREQUEST_H
 #define CONTROLREQUEST_H
 
+#include <QList>
 #include "cidset.h"
 
 class QObject;
@@ -41,6 +42,10 @@ namespace ControlRequest {
 
 Deferred *connCheck(ZrpcManager *controlClient, const CidSet &cids, QObject *parent = 0);
 Deferred *refresh(ZrpcManager *controlClient, const QByteArray &cid, QObject *parent = 0);
+
+// refresh many connections in one round-trip. missing cids are
+//   skipped by the proxy rather than treated as errors
+Deferred *refreshBatch(ZrpcManager *controlClient, const QList<QByteArray> &cids, QObject *parent = 0);
 Deferred *report(ZrpcManager *controlClient, const StatsPacket &packet, QObject *parent = 0);
 
 }
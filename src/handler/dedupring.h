@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef DEDUPRING_H
+#define DEDUPRING_H
+
+#include <qglobal.h>
+
+// fixed-size ring of recently delivered content hashes, used to skip
+//   duplicate payloads published to overlapping channels
+class DedupRing
+{
+public:
+	DedupRing() :
+		pos_(0)
+	{
+		for(int n = 0; n < Size; ++n)
+			times_[n] = -1;
+	}
+
+	// if the hash was seen within the window (msecs) then return true,
+	//   else record it and return false
+	bool checkUpdate(quint64 hash, qint64 now, int window)
+	{
+		for(int n = 0; n < Size; ++n)
+		{
+			if(times_[n] >= 0 && hashes_[n] == hash && now - times_[n] <= window)
+				return true;
+		}
+
+		hashes_[pos_] = hash;
+		times_[pos_] = now;
+		pos_ = (pos_ + 1) % Size;
+
+		return false;
+	}
+
+private:
+	enum { Size = 8 };
+
+	quint64 hashes_[Size];
+	qint64 times_[Size];
+	int pos_;
+};
+
+#endif
@@ -28,10 +28,20 @@
 
 #include "deferred.h"
 
+#include <QMetaMethod>
+
+static bool resultTypeRegistered = false;
+
 Deferred::Deferred(QObject *parent) :
 	QObject(parent)
 {
-	qRegisterMetaType<DeferredResult>();
+	// register once. a deferred is constructed for every step of every
+	//   rpc flow, and registration takes a lock in the meta type system
+	if(!resultTypeRegistered)
+	{
+		qRegisterMetaType<DeferredResult>();
+		resultTypeRegistered = true;
+	}
 }
 
 Deferred::~Deferred()
@@ -48,11 +58,19 @@ void Deferred::setFinished(bool ok, const QVariant &value)
 	result_.success = ok;
 	result_.value = value;
 
-	QMetaObject::invokeMethod(this, "doFinish", Qt::QueuedConnection);
+	// same as invokeMethod(this, "doFinish", ...), but the name is
+	//   resolved to a method index only once
+	static const int doFinishIndex = staticMetaObject.indexOfMethod("doFinish()");
+	staticMetaObject.method(doFinishIndex).invoke(this, Qt::QueuedConnection);
+}
+
+void Deferred::dispose()
+{
+	delete this;
 }
 
 void Deferred::doFinish()
 {
 	emit finished(result_);
-	delete this;
+	dispose();
 }
@@ -69,6 +69,11 @@ protected:
 
 	void setFinished(bool ok, const QVariant &value = QVariant());
 
+	// called after the finished signal to release the object. the
+	//   default deletes. subclasses created at high rates may override
+	//   to reset and recycle themselves instead
+	virtual void dispose();
+
 private slots:
 	void doFinish();
 
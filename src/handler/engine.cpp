@@ -30,15 +30,18 @@
 
 #include <assert.h>
 #include <algorithm>
+#include <utility>
 #include <QPointer>
 #include <QTimer>
 #include <QUrlQuery>
+#include <QCache>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
 #include "qzmqsocket.h"
 #include "qzmqvalve.h"
 #include "tnetstring.h"
+#include "stablehash.h"
 #include "log.h"
 #include "packet/httprequestdata.h"
 #include "packet/httpresponsedata.h"
@@ -47,11 +50,15 @@
 #include "packet/statspacket.h"
 #include "inspectdata.h"
 #include "zutil.h"
+#include "zpubsubbroker.h"
 #include "zrpcmanager.h"
 #include "zrpcrequest.h"
 #include "zhttpmanager.h"
 #include "zhttprequest.h"
 #include "statsmanager.h"
+#include "eventloopprofiler.h"
+#include "busypoller.h"
+#include "blockpool.h"
 #include "deferred.h"
 #include "simplehttpserver.h"
 #include "variantutil.h"
@@ -59,12 +66,17 @@
 #include "lastids.h"
 #include "cidset.h"
 #include "sessionrequest.h"
+#include "sessionupdater.h"
 #include "requeststate.h"
 #include "wscontrolmessage.h"
 #include "publishformat.h"
 #include "publishitem.h"
+#include "rendercache.h"
+#include "dedupring.h"
+#include "tracepoints.h"
 #include "jsonpointer.h"
 #include "publishlastids.h"
+#include "publishspool.h"
 #include "instruct.h"
 #include "httpsession.h"
 #include "controlrequest.h"
@@ -74,6 +86,14 @@
 #include "httpsessionupdatemanager.h"
 #include "sequencer.h"
 #include "filterstack.h"
+#include "publishfanout.h"
+#include "channelindex.h"
+#include "channelintern.h"
+#include "heavyhitters.h"
+#include "bodycache.h"
+#include "routebudgets.h"
+#include "replayring.h"
+#include "timerwheel.h"
 
 #define DEFAULT_HWM 101000
 #define SUB_SNDHWM 0 // infinite
@@ -84,13 +104,93 @@
 #define DEFAULT_WS_KEEPALIVE_TIMEOUT 55
 #define DEFAULT_WS_SENDDELAYED_TIMEOUT 1
 #define WSCONTROL_REQUEST_TIMEOUT 8000
+#define WS_DELAYED_MESSAGES_MAX 16
 #define SUBSCRIBED_DELAY 1000
 
 #define INSPECT_WORKERS_MAX 10
 #define ACCEPT_WORKERS_MAX 10
+#define PUBLISH_DRAIN_MAX 50
+#define PUBLISH_INGEST_QUEUE_MAX 50000
+#define SPOOL_DRAIN_RETRY_INTERVAL 25
+#define SESSION_DRAIN_MAX 50
+#define SUB_SYNC_BATCH_MAX 5000
+#define WSCONTROL_ITEMS_MAX 128
+#define RETRY_PACKETS_MAX 128
+#define RETRY_PACKET_REQUESTS_MAX 100
+
+#define DETECT_RULES_CACHE_TTL 10000
+#define DETECT_RULES_CACHE_MAX 1000
+
+#define TOP_CHANNELS_DECAY_INTERVAL 10000
+
+#define SUBS_DUMP_PAGE_DEFAULT 1000
+#define SUBS_DUMP_PAGE_MAX 10000
+#define SUBS_DUMP_TTL 60000
+
+#define LAST_ITEM_CACHE_MAX 10000
+#define IMPLICIT_CHANNEL_SETS_MAX 1000
 
 using namespace VariantUtil;
 
+// jump consistent hash (Lamping/Veach). growing the shard count only
+//   remaps the keys that move to the new shards
+static int shardForHash(quint64 key, int numShards)
+{
+	qint64 b = -1;
+	qint64 j = 0;
+
+	while(j < numShards)
+	{
+		b = j;
+		key = (key * 2862933555777941757ULL) + 1;
+		j = (qint64)((double)(b + 1) * ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+	}
+
+	return (int)b;
+}
+
+// tnetstring serialization requires byte arrays. items ingested as json
+//   carry strings, so convert before forwarding to peers
+static QVariant convertToTnetStyle(const QVariant &in)
+{
+	if(in.type() == QVariant::String)
+		return in.toString().toUtf8();
+
+	if(in.type() == QVariant::List)
+	{
+		QVariantList out;
+		foreach(const QVariant &v, in.toList())
+			out += convertToTnetStyle(v);
+		return out;
+	}
+
+	if(in.type() == QVariant::Map)
+	{
+		QVariantHash out;
+		QMapIterator<QString, QVariant> it(in.toMap());
+		while(it.hasNext())
+		{
+			it.next();
+			out.insert(it.key(), convertToTnetStyle(it.value()));
+		}
+		return out;
+	}
+
+	if(in.type() == QVariant::Hash)
+	{
+		QVariantHash out;
+		QHashIterator<QString, QVariant> it(in.toHash());
+		while(it.hasNext())
+		{
+			it.next();
+			out.insert(it.key(), convertToTnetStyle(it.value()));
+		}
+		return out;
+	}
+
+	return in;
+}
+
 static QList<PublishItem> parseHttpItems(const QVariantList &vitems, bool *ok = 0, QString *errorMessage = 0)
 {
 	QList<PublishItem> out;
@@ -113,6 +213,72 @@ static QList<PublishItem> parseHttpItems(const QVariantList &vitems, bool *ok =
 	return out;
 }
 
+// cached detect rules per (domain, path), including negative (empty)
+//   results, so hot endpoints don't hit the state service on every
+//   inspect. entries are short-lived since rules may be set by other
+//   instances sharing the state
+class DetectRuleCache
+{
+public:
+	DetectRuleCache() :
+		cache_(DETECT_RULES_CACHE_MAX)
+	{
+	}
+
+	bool get(const QString &domain, const QByteArray &path, QList<DetectRule> *rules)
+	{
+		QByteArray key = makeKey(domain, path);
+
+		Entry *e = cache_.object(key);
+		if(!e)
+			return false;
+
+		if(QDateTime::currentMSecsSinceEpoch() >= e->expires)
+		{
+			cache_.remove(key);
+			return false;
+		}
+
+		*rules = e->rules;
+		return true;
+	}
+
+	void insert(const QString &domain, const QByteArray &path, const QList<DetectRule> &rules)
+	{
+		Entry *e = new Entry;
+		e->rules = rules;
+		e->expires = QDateTime::currentMSecsSinceEpoch() + DETECT_RULES_CACHE_TTL;
+		cache_.insert(makeKey(domain, path), e);
+	}
+
+	// rules changed for a domain; forget everything we have for it
+	void invalidateDomain(const QString &domain)
+	{
+		QByteArray prefix = domain.toUtf8() + '\n';
+
+		foreach(const QByteArray &key, cache_.keys())
+		{
+			if(key.startsWith(prefix))
+				cache_.remove(key);
+		}
+	}
+
+private:
+	class Entry
+	{
+	public:
+		QList<DetectRule> rules;
+		qint64 expires;
+	};
+
+	static QByteArray makeKey(const QString &domain, const QByteArray &path)
+	{
+		return domain.toUtf8() + '\n' + path;
+	}
+
+	QCache<QByteArray, Entry> cache_;
+};
+
 class InspectWorker : public Deferred
 {
 	Q_OBJECT
@@ -120,22 +286,34 @@ class InspectWorker : public Deferred
 public:
 	ZrpcRequest *req;
 	ZrpcManager *stateClient;
+	DetectRuleCache *ruleCache;
 	bool shareAll;
 	HttpRequestData requestData;
 	bool truncated;
 	bool autoShare;
 	QString sid;
 	LastIds lastIds;
+	QList<InspectWorker*> *pool;
 
-	InspectWorker(ZrpcRequest *_req, ZrpcManager *_stateClient, bool _shareAll, QObject *parent = 0) :
+	InspectWorker(ZrpcManager *_stateClient, DetectRuleCache *_ruleCache, QList<InspectWorker*> *_pool, QObject *parent = 0) :
 		Deferred(parent),
-		req(_req),
+		req(0),
 		stateClient(_stateClient),
-		shareAll(_shareAll),
+		ruleCache(_ruleCache),
+		shareAll(false),
 		truncated(false),
-		autoShare(false)
+		autoShare(false),
+		pool(_pool)
 	{
+	}
+
+	// config values are passed per run rather than at construction,
+	//   because the object may outlive a config reload
+	void start(ZrpcRequest *_req, bool _shareAll)
+	{
+		req = _req;
 		req->setParent(this);
+		shareAll = _shareAll;
 
 		if(req->method() == "inspect")
 		{
@@ -233,9 +411,24 @@ public:
 			if(getSession && stateClient)
 			{
 				// determine session info
-				Deferred *d = SessionRequest::detectRulesGet(stateClient, requestData.uri.host().toUtf8(), requestData.uri.path(QUrl::FullyEncoded).toUtf8(), this);
-				connect(d, &Deferred::finished, this, &InspectWorker::sessionDetectRulesGet_finished);
-				return;
+				QList<DetectRule> rules;
+				if(ruleCache->get(requestData.uri.host(), requestData.uri.path(QUrl::FullyEncoded).toUtf8(), &rules))
+				{
+					applyDetectRules(rules);
+
+					if(!sid.isEmpty())
+					{
+						Deferred *d = SessionRequest::getLastIds(stateClient, sid, this);
+						connect(d, &Deferred::finished, this, &InspectWorker::sessionGetLastIds_finished);
+						return;
+					}
+				}
+				else
+				{
+					Deferred *d = SessionRequest::detectRulesGet(stateClient, requestData.uri.host().toUtf8(), requestData.uri.path(QUrl::FullyEncoded).toUtf8(), this);
+					connect(d, &Deferred::finished, this, &InspectWorker::sessionDetectRulesGet_finished);
+					return;
+				}
 			}
 
 			doFinish();
@@ -246,6 +439,25 @@ public:
 		}
 	}
 
+protected:
+	// reset and park in the pool instead of deleting. the engine runs a
+	//   bounded number of these at once, so the pool stays small
+	virtual void dispose()
+	{
+		disconnect(this, 0, 0, 0);
+
+		delete req;
+		req = 0;
+
+		requestData = HttpRequestData();
+		truncated = false;
+		autoShare = false;
+		sid.clear();
+		lastIds.clear();
+
+		pool->append(this);
+	}
+
 private:
 	void respondError(const QByteArray &condition)
 	{
@@ -253,6 +465,48 @@ private:
 		setFinished(true);
 	}
 
+	void applyDetectRules(const QList<DetectRule> &rules)
+	{
+		foreach(const DetectRule &rule, rules)
+		{
+			QByteArray jsonData;
+
+			if(!rule.jsonParam.isEmpty())
+			{
+				QUrlQuery tmp(QString::fromUtf8(requestData.body));
+				jsonData = tmp.queryItemValue(rule.jsonParam, QUrl::FullyDecoded).toUtf8();
+			}
+			else
+			{
+				jsonData = requestData.body;
+			}
+
+			QJsonParseError e;
+			QJsonDocument doc = QJsonDocument::fromJson(jsonData, &e);
+			if(e.error != QJsonParseError::NoError)
+				continue;
+
+			QVariant vdata;
+			if(doc.isObject())
+				vdata = doc.object().toVariantMap();
+			else if(doc.isArray())
+				vdata = doc.array().toVariantList();
+			else
+				continue;
+
+			JsonPointer ptr = JsonPointer::resolve(&vdata, rule.sidPtr);
+			if(!ptr.isNull() && ptr.exists())
+			{
+				bool ok;
+				sid = getString(ptr.value(), &ok);
+				if(!ok)
+					continue;
+
+				break;
+			}
+		}
+	}
+
 	void doFinish()
 	{
 		QVariantHash result;
@@ -311,44 +565,9 @@ private slots:
 			QList<DetectRule> rules = result.value.value<DetectRuleList>();
 			log_debug("retrieved %d rules", rules.count());
 
-			foreach(const DetectRule &rule, rules)
-			{
-				QByteArray jsonData;
-
-				if(!rule.jsonParam.isEmpty())
-				{
-					QUrlQuery tmp(QString::fromUtf8(requestData.body));
-					jsonData = tmp.queryItemValue(rule.jsonParam, QUrl::FullyDecoded).toUtf8();
-				}
-				else
-				{
-					jsonData = requestData.body;
-				}
-
-				QJsonParseError e;
-				QJsonDocument doc = QJsonDocument::fromJson(jsonData, &e);
-				if(e.error != QJsonParseError::NoError)
-					continue;
-
-				QVariant vdata;
-				if(doc.isObject())
-					vdata = doc.object().toVariantMap();
-				else if(doc.isArray())
-					vdata = doc.array().toVariantList();
-				else
-					continue;
-
-				JsonPointer ptr = JsonPointer::resolve(&vdata, rule.sidPtr);
-				if(!ptr.isNull() && ptr.exists())
-				{
-					bool ok;
-					sid = getString(ptr.value(), &ok);
-					if(!ok)
-						continue;
+			ruleCache->insert(requestData.uri.host(), requestData.uri.path(QUrl::FullyEncoded).toUtf8(), rules);
 
-					break;
-				}
-			}
+			applyDetectRules(rules);
 
 			if(!sid.isEmpty())
 			{
@@ -387,12 +606,26 @@ private slots:
 	}
 };
 
-class WsSession : public QObject
+class WsSession : public QObject, public TimerWheel::Expirable
 {
 	Q_OBJECT
 
 public:
+	class DelayedMessage
+	{
+	public:
+		QByteArray type;
+		QByteArray message;
+		qint64 sendTime;
+
+		DelayedMessage() :
+			sendTime(-1)
+		{
+		}
+	};
+
 	QString cid;
+	QByteArray peer; // instance id of the owning proxy. empty if the proxy predates peer liveness
 	int nextReqId;
 	QString channelPrefix;
 	HttpRequestData requestData;
@@ -405,66 +638,69 @@ public:
 	int ttl;
 	QByteArray keepAliveType;
 	QByteArray keepAliveMessage;
-	QByteArray delayedType;
-	QByteArray delayedMessage;
+	QList<DelayedMessage> delayedMessages; // arrival order
 	QHash<int, qint64> pendingRequests;
-	QTimer *expireTimer;
-	QTimer *delayedTimer;
-	QTimer *requestTimer;
+	DedupRing dedupRing;
+	TimerWheel *wheel;
+	int expireHandle;
+	int delayedHandle;
+	int requestHandle;
 
-	WsSession(QObject *parent = 0) :
+	WsSession(TimerWheel *_wheel, QObject *parent = 0) :
 		QObject(parent),
-		nextReqId(0)
+		nextReqId(0),
+		wheel(_wheel),
+		expireHandle(-1),
+		delayedHandle(-1),
+		requestHandle(-1)
 	{
-		expireTimer = new QTimer(this);
-		expireTimer->setSingleShot(true);
-		connect(expireTimer, &QTimer::timeout, this, &WsSession::expireTimer_timeout);
-
-		delayedTimer = new QTimer(this);
-		delayedTimer->setSingleShot(true);
-		connect(delayedTimer, &QTimer::timeout, this, &WsSession::delayedTimer_timeout);
-
-		requestTimer = new QTimer(this);
-		requestTimer->setSingleShot(true);
-		connect(requestTimer, &QTimer::timeout, this, &WsSession::requestTimer_timeout);
 	}
 
 	~WsSession()
 	{
-		expireTimer->disconnect(this);
-		expireTimer->setParent(0);
-		expireTimer->deleteLater();
-
-		delayedTimer->disconnect(this);
-		delayedTimer->setParent(0);
-		delayedTimer->deleteLater();
-
-		requestTimer->disconnect(this);
-		requestTimer->setParent(0);
-		requestTimer->deleteLater();
+		if(expireHandle >= 0)
+			wheel->stop(expireHandle);
+		if(delayedHandle >= 0)
+			wheel->stop(delayedHandle);
+		if(requestHandle >= 0)
+			wheel->stop(requestHandle);
 	}
 
 	void refreshExpiration()
 	{
-		expireTimer->start(ttl * 1000);
+		if(expireHandle >= 0)
+			wheel->stop(expireHandle);
+
+		expireHandle = wheel->start(ttl * 1000, this);
 	}
 
 	void flushDelayed()
 	{
-		if(delayedTimer->isActive())
+		if(delayedHandle >= 0)
 		{
-			delayedTimer->stop();
-			delayedTimer_timeout();
+			wheel->stop(delayedHandle);
+			delayedHandle = -1;
 		}
+
+		while(!delayedMessages.isEmpty())
+			sendQueued(delayedMessages.takeFirst());
 	}
 
 	void sendDelayed(const QByteArray &type, const QByteArray &message, int timeout)
 	{
-		flushDelayed();
-
-		delayedType = type;
-		delayedMessage = message;
-		delayedTimer->start(timeout * 1000);
+		// messages queue instead of forcing out whatever was already
+		//   delayed. a bound keeps a chatty backend from holding
+		//   arbitrary data per session
+		if(delayedMessages.count() >= WS_DELAYED_MESSAGES_MAX)
+			sendQueued(delayedMessages.takeFirst());
+
+		DelayedMessage m;
+		m.type = type;
+		m.message = message;
+		m.sendTime = QDateTime::currentMSecsSinceEpoch() + (timeout * 1000);
+		delayedMessages += m;
+
+		setupDelayedTimer();
 	}
 
 	void ack(int reqId)
@@ -476,6 +712,42 @@ public:
 		}
 	}
 
+	// find the subscription entry matching a concrete channel, either
+	//   exact or wildcard prefix
+	QString subscriptionForChannel(const QString &channel) const
+	{
+		if(channels.contains(channel))
+			return channel;
+
+		foreach(const QString &name, channels)
+		{
+			if(ChannelIndex::isWildcard(name) && channel.startsWith(name.mid(0, name.length() - 1)))
+				return name;
+		}
+
+		return QString();
+	}
+
+	// TimerWheel::Expirable
+	virtual void timerExpired(int handle)
+	{
+		if(handle == expireHandle)
+		{
+			expireHandle = -1;
+			handleExpired();
+		}
+		else if(handle == delayedHandle)
+		{
+			delayedHandle = -1;
+			handleDelayed();
+		}
+		else if(handle == requestHandle)
+		{
+			requestHandle = -1;
+			handleRequestTimeout();
+		}
+	}
+
 signals:
 	void send(int reqId, const QByteArray &type, const QByteArray &message);
 	void expired();
@@ -484,6 +756,12 @@ signals:
 private:
 	void setupRequestTimer()
 	{
+		if(requestHandle >= 0)
+		{
+			wheel->stop(requestHandle);
+			requestHandle = -1;
+		}
+
 		if(!pendingRequests.isEmpty())
 		{
 			// find next expiring request
@@ -500,36 +778,69 @@ private:
 
 			int until = int(lowestTime - QDateTime::currentMSecsSinceEpoch());
 
-			requestTimer->start(qMax(until, 0));
-		}
-		else
-		{
-			requestTimer->stop();
+			requestHandle = wheel->start(qMax(until, 0), this);
 		}
 	}
 
-private slots:
-	void expireTimer_timeout()
+	void handleExpired()
 	{
 		log_debug("timing out ws session: %s", qPrintable(cid));
 
 		emit expired();
 	}
 
-	void delayedTimer_timeout()
+	void setupDelayedTimer()
 	{
-		int reqId = nextReqId++;
+		if(delayedHandle >= 0)
+		{
+			wheel->stop(delayedHandle);
+			delayedHandle = -1;
+		}
+
+		if(!delayedMessages.isEmpty())
+		{
+			// a single handle covers the whole queue, armed for the
+			//   earliest deadline
+			qint64 lowestTime = -1;
+			foreach(const DelayedMessage &m, delayedMessages)
+			{
+				if(lowestTime == -1 || m.sendTime < lowestTime)
+					lowestTime = m.sendTime;
+			}
+
+			int until = int(lowestTime - QDateTime::currentMSecsSinceEpoch());
+
+			delayedHandle = wheel->start(qMax(until, 0), this);
+		}
+	}
 
-		QByteArray message = delayedMessage;
-		delayedMessage.clear();
+	void handleDelayed()
+	{
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+		for(int n = 0; n < delayedMessages.count(); ++n)
+		{
+			if(delayedMessages[n].sendTime <= now)
+			{
+				sendQueued(delayedMessages.takeAt(n));
+				--n;
+			}
+		}
+
+		setupDelayedTimer();
+	}
+
+	void sendQueued(const DelayedMessage &m)
+	{
+		int reqId = nextReqId++;
 
 		pendingRequests[reqId] = QDateTime::currentMSecsSinceEpoch() + WSCONTROL_REQUEST_TIMEOUT;
 		setupRequestTimer();
 
-		emit send(reqId, delayedType, message);
+		emit send(reqId, m.type, m.message);
 	}
 
-	void requestTimer_timeout()
+	void handleRequestTimeout()
 	{
 		// on error, destroy any other pending requests
 		pendingRequests.clear();
@@ -546,14 +857,37 @@ class CommonState
 public:
 	QHash<ZhttpRequest::Rid, HttpSession*> httpSessions;
 	QHash<QString, WsSession*> wsSessions;
-	QHash<QString, QSet<HttpSession*> > responseSessionsByChannel;
-	QHash<QString, QSet<HttpSession*> > streamSessionsByChannel;
-	QHash<QString, QSet<WsSession*> > wsSessionsByChannel;
+
+	// per-channel session indexes are keyed by interned channel id. a
+	//   map entry holds a reference on the id for the life of the key
+	ChannelIntern channelIntern;
+	QHash<int, QSet<HttpSession*> > responseSessionsByChannel;
+	QHash<int, QSet<HttpSession*> > streamSessionsByChannel;
+	QHash<int, QSet<WsSession*> > wsSessionsByChannel;
+	ChannelIndex responseWildcards;
+	ChannelIndex streamWildcards;
+	ChannelIndex wsWildcards;
 	PublishLastIds publishLastIds;
 	QHash<QString, Subscription*> subs;
 
+	// most recent published item per opted-in channel, delivered to
+	//   newly attached sessions so latest-value clients don't need an
+	//   origin fetch to reach current state
+	QCache<QString, PublishItem> lastItems;
+
+	// recent items per opted-in channel, for serving last-id catch-up
+	//   from memory instead of retrying reconnects to the origin
+	ReplayRing replayRing;
+
+	// implicit channel set per unique subscription list, shared by
+	//   every session accepted with that list instead of built per
+	//   session
+	QCache<QString, QSharedPointer<QSet<QString> > > implicitChannelSets;
+
 	CommonState() :
-		publishLastIds(1000000)
+		publishLastIds(1000000),
+		lastItems(LAST_ITEM_CACHE_MAX),
+		implicitChannelSets(IMPLICIT_CHANNEL_SETS_MAX)
 	{
 	}
 };
@@ -565,6 +899,8 @@ class AcceptWorker : public Deferred
 public:
 	ZrpcRequest *req;
 	ZrpcManager *stateClient;
+	SessionUpdater *sessionUpdater;
+	DetectRuleCache *ruleCache;
 	CommonState *cs;
 	ZhttpManager *zhttpIn;
 	ZhttpManager *zhttpOut;
@@ -588,27 +924,52 @@ public:
 	LastIds lastIds;
 	QList<HttpSession*> sessions;
 	int connectionSubscriptionMax;
-
-	AcceptWorker(ZrpcRequest *_req, ZrpcManager *_stateClient, CommonState *_cs, ZhttpManager *_zhttpIn, ZhttpManager *_zhttpOut, StatsManager *_stats, RateLimiter *_updateLimiter, HttpSessionUpdateManager *_httpSessionUpdateManager, int _connectionSubscriptionMax, QObject *parent = 0) :
+	int publishQueueHwm;
+	int publishQueueLwm;
+	HttpSession::QueueOverflowPolicy publishQueueOverflow;
+	bool streamGzip;
+	BodyCache *bodyCache;
+	RouteBudgets *routeBudgets;
+	QList<AcceptWorker*> *pool;
+
+	AcceptWorker(ZrpcManager *_stateClient, SessionUpdater *_sessionUpdater, DetectRuleCache *_ruleCache, CommonState *_cs, ZhttpManager *_zhttpIn, ZhttpManager *_zhttpOut, StatsManager *_stats, RateLimiter *_updateLimiter, HttpSessionUpdateManager *_httpSessionUpdateManager, BodyCache *_bodyCache, RouteBudgets *_routeBudgets, QList<AcceptWorker*> *_pool, QObject *parent = 0) :
 		Deferred(parent),
-		req(_req),
+		req(0),
 		stateClient(_stateClient),
+		sessionUpdater(_sessionUpdater),
+		ruleCache(_ruleCache),
 		cs(_cs),
 		zhttpIn(_zhttpIn),
 		zhttpOut(_zhttpOut),
 		stats(_stats),
 		updateLimiter(_updateLimiter),
 		httpSessionUpdateManager(_httpSessionUpdateManager),
+		bodyCache(_bodyCache),
+		routeBudgets(_routeBudgets),
 		trusted(false),
 		haveInspectInfo(false),
 		responseSent(false),
-		connectionSubscriptionMax(_connectionSubscriptionMax)
+		connectionSubscriptionMax(0),
+		publishQueueHwm(-1),
+		publishQueueLwm(-1),
+		publishQueueOverflow(HttpSession::QueueDropNewest),
+		streamGzip(false),
+		pool(_pool)
 	{
-		req->setParent(this);
 	}
 
-	void start()
+	// config values are passed per run rather than at construction,
+	//   because the object may outlive a config reload
+	void start(ZrpcRequest *_req, int _connectionSubscriptionMax, int _publishQueueHwm, int _publishQueueLwm, HttpSession::QueueOverflowPolicy _publishQueueOverflow, bool _streamGzip)
 	{
+		req = _req;
+		req->setParent(this);
+		connectionSubscriptionMax = _connectionSubscriptionMax;
+		publishQueueHwm = _publishQueueHwm;
+		publishQueueLwm = _publishQueueLwm;
+		publishQueueOverflow = _publishQueueOverflow;
+		streamGzip = _streamGzip;
+
 		if(req->method() == "accept")
 		{
 			QVariantHash args = req->args();
@@ -727,6 +1088,11 @@ public:
 				return;
 			}
 
+			// held connections often carry identical requests, so point
+			//   the retained bodies at shared buffers
+			requestData.body = bodyCache->intern(requestData.body);
+			origRequestData.body = bodyCache->intern(origRequestData.body);
+
 			// parse response
 
 			if(!args.contains("response") || args["response"].type() != QVariant::Hash)
@@ -783,7 +1149,10 @@ public:
 				return;
 			}
 
-			responseData.body = rd["body"].toByteArray();
+			// the timeout response is retained for the life of every
+			//   response hold, and is normally identical across accepts
+			//   on the same route, so share it too
+			responseData.body = bodyCache->intern(rd["body"].toByteArray());
 
 			if(args.contains("inspect"))
 			{
@@ -908,6 +1277,9 @@ public:
 			{
 				if(!rules.isEmpty())
 				{
+					// the rules for this domain are changing
+					ruleCache->invalidateDomain(requestData.uri.host());
+
 					Deferred *d = SessionRequest::detectRulesSet(stateClient, rules, this);
 					connect(d, &Deferred::finished, this, &AcceptWorker::sessionDetectRulesSet_finished);
 				}
@@ -942,6 +1314,40 @@ signals:
 	void sessionsReady();
 	void retryPacketReady(const RetryRequestPacket &packet);
 
+protected:
+	// reset and park in the pool instead of deleting. the engine runs a
+	//   bounded number of these at once, so the pool stays small
+	virtual void dispose()
+	{
+		disconnect(this, 0, 0, 0);
+
+		delete req;
+		req = 0;
+
+		// sessions are normally handed off via takeSessions. any left
+		//   here belong to a failed accept
+		qDeleteAll(sessions);
+		sessions.clear();
+
+		route.clear();
+		channelPrefix.clear();
+		implicitChannels.clear();
+		sigIss.clear();
+		sigKey.clear();
+		trusted = false;
+		requestStates.clear();
+		requestData = HttpRequestData();
+		origRequestData = HttpRequestData();
+		haveInspectInfo = false;
+		inspectInfo = InspectData();
+		responseData = HttpResponseData();
+		responseSent = false;
+		sid.clear();
+		lastIds.clear();
+
+		pool->append(this);
+	}
+
 private:
 	static HttpRequestData parseRequestData(const QVariantHash &args, const QString &field)
 	{
@@ -996,13 +1402,33 @@ private:
 	{
 		if(!sid.isEmpty())
 		{
-			Deferred *d = SessionRequest::createOrUpdate(stateClient, sid, lastIds, this);
-			connect(d, &Deferred::finished, this, &AcceptWorker::sessionCreateOrUpdate_finished);
+			// write-behind: the store's ack was only used for logging,
+			//   so don't hold up accept processing waiting for it. the
+			//   updater merges an accept burst into one store call
+			sessionUpdater->createOrUpdate(sid, lastIds);
 		}
-		else
+
+		afterSessionCalls();
+	}
+
+	// every session accepted on a route carries the same implicit
+	//   channel list, so resolve it to a shared set keyed on content.
+	//   a route config change simply produces a new entry
+	QSharedPointer<QSet<QString> > implicitChannelSet()
+	{
+		if(implicitChannels.isEmpty())
+			return QSharedPointer<QSet<QString> >();
+
+		QString key = implicitChannels.join(QChar('\n'));
+
+		QSharedPointer<QSet<QString> > *set = cs->implicitChannelSets.object(key);
+		if(!set)
 		{
-			afterSessionCalls();
+			set = new QSharedPointer<QSet<QString> >(new QSet<QString>(implicitChannels.toSet()));
+			cs->implicitChannelSets.insert(key, set);
 		}
+
+		return *set;
 	}
 
 	void afterSessionCalls()
@@ -1078,6 +1504,40 @@ private:
 			return;
 		}
 
+		// enforce the per-route hold budget before taking ownership, so
+		//   one route's runaway channel patterns throttle that route
+		//   instead of exhausting the process. skipped if the response
+		//   already started, since the client can't receive an error
+		//   at that point
+		if(!responseSent)
+		{
+			qint64 retained = (qint64)(requestData.body.size() + instruct.response.body.size()) * requestStates.count();
+			if(!routeBudgets->canAcceptHold(route, requestStates.count(), retained))
+			{
+				routeBudgets->recordHoldRejected(route);
+
+				log_warning("rejecting hold for route %s: over budget", qPrintable(route));
+
+				QVariantHash vresponse;
+				vresponse["code"] = 503;
+				vresponse["reason"] = QByteArray("Service Unavailable");
+				QVariantList vheaders;
+				QVariantList vheader;
+				vheader += QByteArray("Content-Type");
+				vheader += QByteArray("text/plain");
+				vheaders += QVariant(vheader);
+				vresponse["headers"] = vheaders;
+				vresponse["body"] = QByteArray("Service Unavailable\nRoute is over its resource budget.\n");
+
+				QVariantHash result;
+				result["response"] = vresponse;
+				req->respond(result);
+
+				setFinished(true);
+				return;
+			}
+		}
+
 		QVariantHash result;
 		result["accepted"] = true;
 		req->respond(result);
@@ -1096,6 +1556,16 @@ private:
 					QString lastId = cs->publishLastIds.value(name);
 					if(!lastId.isNull() && lastId != c.prevId)
 					{
+						// if the replay ring still covers the client's
+						//   position, the session is caught up from
+						//   memory after it starts, so there's no need
+						//   to retry to the origin
+						if(cs->replayRing.contains(name, c.prevId, QDateTime::currentMSecsSinceEpoch()))
+						{
+							log_debug("last ID inconsistency (got=%s, expected=%s), serving from replay ring", qPrintable(c.prevId), qPrintable(lastId));
+							continue;
+						}
+
 						log_debug("last ID inconsistency (got=%s, expected=%s), retrying", qPrintable(c.prevId), qPrintable(lastId));
 						cs->publishLastIds.remove(name);
 						conflict = true;
@@ -1202,7 +1672,7 @@ private:
 			adata.jsonpExtendedResponse = rs.jsonpExtendedResponse;
 			adata.route = route;
 			adata.channelPrefix = channelPrefix;
-			adata.implicitChannels = implicitChannels.toSet();
+			adata.implicitChannels = implicitChannelSet();
 			adata.sid = sid;
 			adata.responseSent = responseSent;
 			adata.sigIss = sigIss;
@@ -1211,7 +1681,7 @@ private:
 			adata.haveInspectInfo = haveInspectInfo;
 			adata.inspectInfo = inspectInfo;
 
-			sessions += new HttpSession(httpReq, adata, instruct, zhttpOut, stats, updateLimiter, &cs->publishLastIds, httpSessionUpdateManager, connectionSubscriptionMax, this);
+			sessions += new HttpSession(httpReq, adata, instruct, zhttpOut, stats, updateLimiter, &cs->publishLastIds, httpSessionUpdateManager, connectionSubscriptionMax, publishQueueHwm, publishQueueLwm, publishQueueOverflow, streamGzip, this);
 		}
 
 		// engine should directly connect to this and register the holds
@@ -1229,14 +1699,6 @@ private slots:
 
 		afterSetRules();
 	}
-
-	void sessionCreateOrUpdate_finished(const DeferredResult &result)
-	{
-		if(!result.success)
-			log_error("couldn't create/update session: condition=%d", result.value.toInt());
-
-		afterSessionCalls();
-	}
 };
 
 class Subscription : public QObject
@@ -1319,37 +1781,204 @@ public:
 		}
 	};
 
-	Engine *q;
-	Configuration config;
-	ZhttpManager *zhttpIn;
-	ZhttpManager *zhttpOut;
-	ZrpcManager *inspectServer;
-	ZrpcManager *acceptServer;
-	ZrpcManager *stateClient;
-	ZrpcManager *controlServer;
-	ZrpcManager *proxyControlClient;
-	QZmq::Socket *inPullSock;
-	QZmq::Valve *inPullValve;
-	QZmq::Socket *inSubSock;
-	QZmq::Valve *inSubValve;
-	QZmq::Socket *retrySock;
-	QZmq::Socket *wsControlInSock;
-	QZmq::Valve *wsControlInValve;
-	QZmq::Socket *wsControlOutSock;
-	QZmq::Socket *statsSock;
-	QZmq::Socket *proxyStatsSock;
-	QZmq::Valve *proxyStatsValve;
+	class HttpFanOutJob : public PublishFanOut::Job
+	{
+	public:
+		Engine::Private *ep;
+		QList<QPointer<HttpSession> > sessions;
+		PublishItem item;
+		QList<QByteArray> exposeHeaders;
+		QString transport;
+		int blocks;
+		int at;
+
+		HttpFanOutJob(Engine::Private *_ep) :
+			ep(_ep),
+			blocks(-1),
+			at(0)
+		{
+		}
+
+		virtual bool process(int max)
+		{
+			qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+			int priority = ep->channelPriority(item.channel);
+
+			int processed = 0;
+			while(processed < max && at < sessions.count())
+			{
+				HttpSession *hs = sessions[at++].data();
+				++processed;
+
+				// session may have gone away while the job was queued
+				if(!hs)
+					continue;
+
+				// the hash is only set when dedup applies to the transport
+				if(item.contentHash != 0 && hs->recentlyDelivered(item.contentHash, now, ep->config.publishDedupWindow))
+				{
+					log_debug("dedup: skipping duplicate content on channel %s", qPrintable(item.channel));
+					continue;
+				}
+
+				QString route = hs->route();
+
+				if(!ep->publishLimiter->addAction(route, item.channel, new PublishAction(ep, hs, item, exposeHeaders), blocks != -1 ? blocks : 1, priority))
+				{
+					if(!route.isEmpty())
+						log_warning("exceeded publish hwm (%d) for route %s, dropping message", ep->config.messageHwm, qPrintable(route));
+					else
+						log_warning("exceeded publish hwm (%d), dropping message", ep->config.messageHwm);
+				}
+
+				ep->stats->addMessageSent(route.toUtf8(), transport, blocks);
+				ep->routeBudgets.addPublishBytes(route, item.format.body.size());
+
+				if(item.ingestTime >= 0)
+					ep->stats->addMessageLatency(route.toUtf8(), transport, (int)(now - item.ingestTime));
+			}
+
+			return (at >= sessions.count());
+		}
+	};
+
+	class WsFanOutJob : public PublishFanOut::Job
+	{
+	public:
+		Engine::Private *ep;
+		QList<QPointer<WsSession> > sessions;
+		PublishItem item;
+		int blocks;
+		int at;
+
+		WsFanOutJob(Engine::Private *_ep) :
+			ep(_ep),
+			blocks(-1),
+			at(0)
+		{
+		}
+
+		virtual bool process(int max)
+		{
+			qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+			int priority = ep->channelPriority(item.channel);
+
+			int processed = 0;
+			while(processed < max && at < sessions.count())
+			{
+				WsSession *s = sessions[at++].data();
+				++processed;
+
+				// session may have gone away while the job was queued
+				if(!s)
+					continue;
+
+				if(item.contentHash != 0 && s->dedupRing.checkUpdate(item.contentHash, now, ep->config.publishDedupWindow))
+				{
+					log_debug("dedup: skipping duplicate content on channel %s", qPrintable(item.channel));
+					continue;
+				}
+
+				QString route = s->route;
+
+				if(!ep->publishLimiter->addAction(route, item.channel, new PublishAction(ep, s, item), blocks != -1 ? blocks : 1, priority))
+				{
+					if(!route.isEmpty())
+						log_warning("exceeded publish hwm (%d) for route %s, dropping message", ep->config.messageHwm, qPrintable(route));
+					else
+						log_warning("exceeded publish hwm (%d), dropping message", ep->config.messageHwm);
+				}
+
+				ep->stats->addMessageSent(route.toUtf8(), "ws-message", blocks);
+				ep->routeBudgets.addPublishBytes(route, item.format.body.size());
+
+				if(item.ingestTime >= 0)
+					ep->stats->addMessageLatency(route.toUtf8(), "ws-message", (int)(now - item.ingestTime));
+			}
+
+			return (at >= sessions.count());
+		}
+	};
+
+	Engine *q;
+	Configuration config;
+	ZhttpManager *zhttpIn;
+	ZhttpManager *zhttpOut;
+	ZrpcManager *inspectServer;
+	ZrpcManager *acceptServer;
+	QTimer *acceptDrainTimer;
+	ZrpcManager *stateClient;
+	SessionUpdater *sessionUpdater;
+	ZrpcManager *controlServer;
+	ZrpcManager *proxyControlClient;
+	QList<QZmq::Socket*> inPullSocks;
+	QList<QList<QByteArray> > inPullPending; // raw frames drained ahead of processing
+	QTimer *inPullDrainTimer;
+	QZmq::Socket *inSubSock;
+	QList<QList<QByteArray> > inSubPending;
+	QTimer *inSubDrainTimer;
+	ZPubSubBroker *broker;
+	QZmq::Socket *peerOutSock;
+	QZmq::Socket *peerInSock;
+	QTimer *peerInDrainTimer;
+	QHash<QByteArray, int> pendingSubOps; // prefix -> net subscribe count
+	QStringList wildcardSubPrefixes; // sharded mode: prefixes of active wildcard subs
+	QTimer *subSyncTimer;
+	QHash<QString, qint64> lingeringSubs; // channel -> expire time
+	QList<QPair<QString, qint64> > lingerQueue; // in expire order. stale entries skipped on pop
+	QTimer *subLingerTimer;
+	QZmq::Socket *retrySock;
+	QList<RetryRequestPacket> pendingRetryPackets;
+	QTimer *retryFlushTimer;
+	QZmq::Socket *wsControlInSock;
+	QZmq::Valve *wsControlInValve;
+	QZmq::Socket *wsControlOutSock;
+	QList<WsControlPacket::Item> pendingWsControlItems;
+	QByteArray wsControlEncodeBuf; // reused across flushes
+	QTimer *wsControlFlushTimer;
+	QHash<QByteArray, qint64> wsControlPeers; // k=proxy instance id, v=liveness deadline
+	QZmq::Socket *statsSock;
+	QZmq::Socket *proxyStatsSock;
+	QZmq::Valve *proxyStatsValve;
+	QZmq::Socket *peerStatsSock;
+	QZmq::Valve *peerStatsValve;
 	SimpleHttpServer *controlHttpServer;
+	QSet<HttpSession*> drainSessions;
+	QTimer *sessionDrainTimer;
 	StatsManager *stats;
+	EventLoopProfiler *loopProfiler;
+	BusyPoller *busyPoller;
 	RateLimiter *publishLimiter;
 	RateLimiter *updateLimiter;
 	HttpSessionUpdateManager *httpSessionUpdateManager;
 	Sequencer *sequencer;
+	PublishFanOut *fanOut;
+	PublishSpool publishSpool;
+	QTimer *spoolDrainTimer;
+	bool spoolHighWarned;
+	TimerWheel *wsTimerWheel;
 	CommonState cs;
+	DetectRuleCache detectRuleCache;
+	int publishQueueHwm;
+	int publishQueueLwm;
+	HttpSession::QueueOverflowPolicy publishQueueOverflow;
 	QSet<InspectWorker*> inspectWorkers;
 	QSet<AcceptWorker*> acceptWorkers;
+	QList<InspectWorker*> inspectWorkerPool;
+	QList<AcceptWorker*> acceptWorkerPool;
 	QSet<Deferred*> deferreds;
 	Deferred *report;
+	HeavyHitters publishTop;
+	HeavyHitters subscribeTop;
+	QTimer *topDecayTimer;
+	BodyCache bodyCache;
+	RouteBudgets routeBudgets;
+	QHash<HttpSession*, qint64> sessionHeldBytes;
+	quint64 subsDumpId;
+	QStringList subsDumpKeys;
+	QTimer *subsDumpExpireTimer;
 
 	Private(Engine *_q) :
 		QObject(_q),
@@ -1358,23 +1987,45 @@ public:
 		zhttpOut(0),
 		inspectServer(0),
 		acceptServer(0),
+		acceptDrainTimer(0),
 		stateClient(0),
+		sessionUpdater(0),
 		controlServer(0),
 		proxyControlClient(0),
-		inPullSock(0),
-		inPullValve(0),
+		inPullDrainTimer(0),
 		inSubSock(0),
-		inSubValve(0),
+		inSubDrainTimer(0),
+		broker(0),
+		peerOutSock(0),
+		peerInSock(0),
+		peerInDrainTimer(0),
+		subSyncTimer(0),
+		subLingerTimer(0),
 		retrySock(0),
+		retryFlushTimer(0),
 		wsControlInSock(0),
 		wsControlInValve(0),
 		wsControlOutSock(0),
+		wsControlFlushTimer(0),
 		statsSock(0),
 		proxyStatsSock(0),
 		proxyStatsValve(0),
+		peerStatsSock(0),
+		peerStatsValve(0),
 		controlHttpServer(0),
+		sessionDrainTimer(0),
 		stats(0),
-		report(0)
+		loopProfiler(0),
+		busyPoller(0),
+		spoolDrainTimer(0),
+		spoolHighWarned(false),
+		publishQueueHwm(-1),
+		publishQueueLwm(-1),
+		publishQueueOverflow(HttpSession::QueueDropNewest),
+		report(0),
+		topDecayTimer(0),
+		subsDumpId(0),
+		subsDumpExpireTimer(0)
 	{
 		qRegisterMetaType<DetectRuleList>();
 
@@ -1385,12 +2036,18 @@ public:
 
 		sequencer = new Sequencer(&cs.publishLastIds, this);
 		connect(sequencer, &Sequencer::itemReady, this, &Private::sequencer_itemReady);
+
+		fanOut = new PublishFanOut(this);
+
+		wsTimerWheel = new TimerWheel(100, this);
 	}
 
 	~Private()
 	{
 		qDeleteAll(inspectWorkers);
 		qDeleteAll(acceptWorkers);
+		qDeleteAll(inspectWorkerPool);
+		qDeleteAll(acceptWorkerPool);
 		qDeleteAll(deferreds);
 		qDeleteAll(cs.wsSessions);
 		qDeleteAll(cs.httpSessions);
@@ -1401,13 +2058,58 @@ public:
 	{
 		config = _config;
 
-		publishLimiter->setRate(config.messageRate);
-		publishLimiter->setHwm(config.messageHwm);
-
 		updateLimiter->setRate(10);
 		updateLimiter->setBatchWaitEnabled(true);
 
-		sequencer->setIdCacheTtl(config.idCacheTtl);
+		if(!config.lastIdsFile.isEmpty())
+		{
+			// not fatal if this fails. we just lose warm restart
+			if(cs.publishLastIds.setPersistentFile(config.lastIdsFile))
+				log_info("using last ids file: %s", qPrintable(config.lastIdsFile));
+		}
+
+		if(config.publishShardSize > 0)
+			fanOut->setShardSize(config.publishShardSize);
+
+		if(config.shardCount > 1)
+			log_info("sharded mode: this instance is shard %d of %d", config.shardId, config.shardCount);
+
+		if(!config.publishSpoolFile.isEmpty() && config.publishSpoolSize > 0)
+		{
+			// not fatal if this fails. we just lose burst absorption
+			if(publishSpool.setup(config.publishSpoolFile, config.publishSpoolSize))
+			{
+				spoolDrainTimer = new QTimer(this);
+				spoolDrainTimer->setSingleShot(true);
+				connect(spoolDrainTimer, &QTimer::timeout, this, &Private::spoolDrain_timeout);
+
+				log_info("using publish spool file: %s (%lld bytes)", qPrintable(config.publishSpoolFile), (long long)config.publishSpoolSize);
+			}
+		}
+
+		// pre-size the big tables for the expected steady state, so
+		//   capacity is reached at startup instead of by rehashing
+		//   through early production load
+		if(config.expectedConnections > 0)
+		{
+			cs.httpSessions.reserve(config.expectedConnections);
+			cs.wsSessions.reserve(config.expectedConnections);
+		}
+
+		if(config.expectedChannels > 0)
+		{
+			cs.subs.reserve(config.expectedChannels);
+			cs.responseSessionsByChannel.reserve(config.expectedChannels);
+			cs.streamSessionsByChannel.reserve(config.expectedChannels);
+			cs.wsSessionsByChannel.reserve(config.expectedChannels);
+		}
+
+		if(config.hugePages)
+			BlockPool::setHugePagesEnabled(true);
+
+		// per-socket zmq queue bound. raising it trades memory for
+		//   absorbing bigger spikes before writes start backing up
+		int zmqHwm = (config.zmqHwm > 0 ? config.zmqHwm : DEFAULT_HWM);
 
 		zhttpIn = new ZhttpManager(this);
 		zhttpIn->setInstanceId(config.instanceId);
@@ -1420,6 +2122,12 @@ public:
 		zhttpOut->setClientOutStreamSpecs(config.clientOutStreamSpecs);
 		zhttpOut->setClientInSpecs(config.clientInSpecs);
 
+		if(config.expectedConnections > 0)
+		{
+			zhttpIn->setCapacityHint(config.expectedConnections);
+			zhttpOut->setCapacityHint(config.expectedConnections);
+		}
+
 		log_info("zhttp in stream: %s", qPrintable(config.serverInStreamSpecs.join(", ")));
 		log_info("zhttp out: %s", qPrintable(config.serverOutSpecs.join(", ")));
 
@@ -1446,6 +2154,10 @@ public:
 			acceptServer->setIpcFileMode(config.ipcFileMode);
 			connect(acceptServer, &ZrpcManager::requestReady, this, &Private::acceptServer_requestReady);
 
+			acceptDrainTimer = new QTimer(this);
+			acceptDrainTimer->setSingleShot(true);
+			connect(acceptDrainTimer, &QTimer::timeout, this, &Private::acceptDrain_timeout);
+
 			if(!acceptServer->setServerSpecs(QStringList() << config.acceptSpec))
 			{
 				// zrpcmanager logs error
@@ -1469,6 +2181,8 @@ public:
 			}
 
 			log_info("state client: %s", qPrintable(config.stateSpec));
+
+			sessionUpdater = new SessionUpdater(stateClient, this);
 		}
 
 		if(!config.commandSpec.isEmpty())
@@ -1478,6 +2192,10 @@ public:
 			controlServer->setIpcFileMode(config.ipcFileMode);
 			connect(controlServer, &ZrpcManager::requestReady, this, &Private::controlServer_requestReady);
 
+			sessionDrainTimer = new QTimer(this);
+			sessionDrainTimer->setSingleShot(true);
+			connect(sessionDrainTimer, &QTimer::timeout, this, &Private::sessionDrain_timeout);
+
 			if(!controlServer->setServerSpecs(QStringList() << config.commandSpec))
 			{
 				// zrpcmanager logs error
@@ -1487,47 +2205,134 @@ public:
 			log_info("control server: %s", qPrintable(config.commandSpec));
 		}
 
-		if(!config.pushInSpec.isEmpty())
+		if(!config.pushInSpecs.isEmpty())
 		{
-			inPullSock = new QZmq::Socket(QZmq::Socket::Pull, this);
-			inPullSock->setHwm(DEFAULT_HWM);
-
-			QString errorMessage;
-			if(!ZUtil::setupSocket(inPullSock, config.pushInSpec, true, config.ipcFileMode, &errorMessage))
+			// one pull socket per spec. publishers can be spread across
+			//   the endpoints so fan-in isn't bottlenecked on a single
+			//   socket's queue
+			foreach(const QString &spec, config.pushInSpecs)
 			{
-					log_error("%s", qPrintable(errorMessage));
-					return false;
+				QZmq::Socket *sock = new QZmq::Socket(QZmq::Socket::Pull, this);
+				sock->setHwm(zmqHwm);
+
+				QString errorMessage;
+				if(!ZUtil::setupSocket(sock, spec, true, config.ipcFileMode, &errorMessage))
+				{
+						log_error("%s", qPrintable(errorMessage));
+						return false;
+				}
+
+				connect(sock, &QZmq::Socket::readyRead, this, &Private::inPull_readyRead);
+
+				inPullSocks += sock;
 			}
 
-			inPullValve = new QZmq::Valve(inPullSock, this);
-			connect(inPullValve, &QZmq::Valve::readyRead, this, &Private::inPull_readyRead);
+			inPullDrainTimer = new QTimer(this);
+			inPullDrainTimer->setSingleShot(true);
+			connect(inPullDrainTimer, &QTimer::timeout, this, &Private::inPull_readyRead);
 
-			log_info("in pull: %s", qPrintable(config.pushInSpec));
+			log_info("in pull: %s", qPrintable(config.pushInSpecs.join(", ")));
 		}
 
 		if(!config.pushInSubSpec.isEmpty())
 		{
+			bool brokerMode = (!config.pushInBrokerSpec.isEmpty());
+
+			if(brokerMode)
+			{
+				// broker mode: publishers connect to the broker's xsub
+				//   side, which only carries channels our sub socket has
+				//   actually subscribed to. the broker binds the sub spec,
+				//   so our own socket connects instead of binding
+				broker = new ZPubSubBroker(this);
+				broker->setHwm(zmqHwm);
+				broker->setIpcFileMode(config.ipcFileMode);
+
+				QString errorMessage;
+				if(!broker->setup(config.pushInBrokerSpec, config.pushInSubSpec, &errorMessage))
+				{
+					log_error("%s", qPrintable(errorMessage));
+					return false;
+				}
+
+				log_info("in broker: %s", qPrintable(config.pushInBrokerSpec));
+			}
+
 			inSubSock = new QZmq::Socket(QZmq::Socket::Sub, this);
 			inSubSock->setSendHwm(SUB_SNDHWM);
 			inSubSock->setShutdownWaitTime(0);
 
 			QString errorMessage;
-			if(!ZUtil::setupSocket(inSubSock, config.pushInSubSpec, true, config.ipcFileMode, &errorMessage))
+			if(!ZUtil::setupSocket(inSubSock, config.pushInSubSpec, !brokerMode, config.ipcFileMode, &errorMessage))
 			{
 					log_error("%s", qPrintable(errorMessage));
 					return false;
 			}
 
-			inSubValve = new QZmq::Valve(inSubSock, this);
-			connect(inSubValve, &QZmq::Valve::readyRead, this, &Private::inSub_readyRead);
+			connect(inSubSock, &QZmq::Socket::readyRead, this, &Private::inSub_readyRead);
+
+			inSubDrainTimer = new QTimer(this);
+			inSubDrainTimer->setSingleShot(true);
+			connect(inSubDrainTimer, &QTimer::timeout, this, &Private::inSub_readyRead);
 
 			log_info("in sub: %s", qPrintable(config.pushInSubSpec));
 		}
 
+		if(!config.peerOutSpec.isEmpty())
+		{
+			peerOutSock = new QZmq::Socket(QZmq::Socket::Pub, this);
+			peerOutSock->setHwm(zmqHwm);
+			peerOutSock->setShutdownWaitTime(0);
+
+			QString errorMessage;
+			if(!ZUtil::setupSocket(peerOutSock, config.peerOutSpec, true, config.ipcFileMode, &errorMessage))
+			{
+				log_error("%s", qPrintable(errorMessage));
+				return false;
+			}
+
+			log_info("peer out: %s", qPrintable(config.peerOutSpec));
+		}
+
+		if(!config.peerInSpecs.isEmpty())
+		{
+			peerInSock = new QZmq::Socket(QZmq::Socket::Sub, this);
+			peerInSock->setHwm(zmqHwm);
+			peerInSock->setShutdownWaitTime(0);
+
+			QString errorMessage;
+			if(!ZUtil::setupSocket(peerInSock, config.peerInSpecs, false, config.ipcFileMode, &errorMessage))
+			{
+				log_error("%s", qPrintable(errorMessage));
+				return false;
+			}
+
+			connect(peerInSock, &QZmq::Socket::readyRead, this, &Private::peerIn_readyRead);
+
+			peerInDrainTimer = new QTimer(this);
+			peerInDrainTimer->setSingleShot(true);
+			connect(peerInDrainTimer, &QTimer::timeout, this, &Private::peerIn_readyRead);
+
+			log_info("peer in: %s", qPrintable(config.peerInSpecs.join(", ")));
+		}
+
+		if(inSubSock || peerInSock)
+		{
+			subSyncTimer = new QTimer(this);
+			subSyncTimer->setSingleShot(true);
+			connect(subSyncTimer, &QTimer::timeout, this, &Private::subSync_timeout);
+		}
+
+		// periodic halving of the top-channel trackers, so the rankings
+		//   reflect recent rates rather than totals since startup
+		topDecayTimer = new QTimer(this);
+		connect(topDecayTimer, &QTimer::timeout, this, &Private::topDecay_timeout);
+		topDecayTimer->start(TOP_CHANNELS_DECAY_INTERVAL);
+
 		if(!config.retryOutSpec.isEmpty())
 		{
 			retrySock = new QZmq::Socket(QZmq::Socket::Push, this);
-			retrySock->setHwm(DEFAULT_HWM);
+			retrySock->setHwm(zmqHwm);
 			retrySock->setShutdownWaitTime(RETRY_WAIT_TIME);
 
 			QString errorMessage;
@@ -1537,13 +2342,17 @@ public:
 					return false;
 			}
 
+			retryFlushTimer = new QTimer(this);
+			retryFlushTimer->setSingleShot(true);
+			connect(retryFlushTimer, &QTimer::timeout, this, &Private::retryFlush_timeout);
+
 			log_info("retry: %s", qPrintable(config.retryOutSpec));
 		}
 
 		if(!config.wsControlInSpec.isEmpty() && !config.wsControlOutSpec.isEmpty())
 		{
 			wsControlInSock = new QZmq::Socket(QZmq::Socket::Pull, this);
-			wsControlInSock->setHwm(DEFAULT_HWM);
+			wsControlInSock->setHwm(zmqHwm);
 
 			QString errorMessage;
 			if(!ZUtil::setupSocket(wsControlInSock, config.wsControlInSpec, false, config.ipcFileMode, &errorMessage))
@@ -1558,7 +2367,7 @@ public:
 			log_info("ws control in: %s", qPrintable(config.wsControlInSpec));
 
 			wsControlOutSock = new QZmq::Socket(QZmq::Socket::Push, this);
-			wsControlOutSock->setHwm(DEFAULT_HWM);
+			wsControlOutSock->setHwm(zmqHwm);
 			wsControlOutSock->setShutdownWaitTime(WSCONTROL_WAIT_TIME);
 
 			if(!ZUtil::setupSocket(wsControlOutSock, config.wsControlOutSpec, false, config.ipcFileMode, &errorMessage))
@@ -1567,18 +2376,24 @@ public:
 					return false;
 			}
 
+			wsControlFlushTimer = new QTimer(this);
+			wsControlFlushTimer->setSingleShot(true);
+			connect(wsControlFlushTimer, &QTimer::timeout, this, &Private::wsControlFlush_timeout);
+
 			log_info("ws control out: %s", qPrintable(config.wsControlOutSpec));
 		}
 
 		stats = new StatsManager(this);
 		connect(stats, &StatsManager::connectionsRefreshed, this, &Private::stats_connectionsRefreshed);
+
+		if(config.expectedConnections > 0)
+			stats->setCapacityHint(config.expectedConnections);
+
 		connect(stats, &StatsManager::unsubscribed, this, &Private::stats_unsubscribed);
 		connect(stats, &StatsManager::reported, this, &Private::stats_reported);
 
-		stats->setConnectionTtl(config.statsConnectionTtl);
-		stats->setSubscriptionTtl(config.statsSubscriptionTtl);
-		stats->setSubscriptionLinger(config.subscriptionLinger);
-		stats->setReportInterval(config.statsReportInterval);
+		// applies the limiter, queue bounds, ttls, and stats intervals
+		applyRuntimeConfig();
 
 		if(!config.statsSpec.isEmpty())
 		{
@@ -1597,7 +2412,7 @@ public:
 		if(!config.proxyStatsSpec.isEmpty())
 		{
 			proxyStatsSock = new QZmq::Socket(QZmq::Socket::Sub, this);
-			proxyStatsSock->setHwm(DEFAULT_HWM);
+			proxyStatsSock->setHwm(zmqHwm);
 			proxyStatsSock->setShutdownWaitTime(0);
 			proxyStatsSock->subscribe("");
 
@@ -1614,6 +2429,29 @@ public:
 			log_info("proxy stats: %s", qPrintable(config.proxyStatsSpec));
 		}
 
+		if(!config.statsInSpecs.isEmpty())
+		{
+			// aggregation mode: subscribe to other instances' stats
+			//   sockets and fold their report counters into our own, so
+			//   this instance emits fleet-level merged reports
+			peerStatsSock = new QZmq::Socket(QZmq::Socket::Sub, this);
+			peerStatsSock->setHwm(zmqHwm);
+			peerStatsSock->setShutdownWaitTime(0);
+			peerStatsSock->subscribe("report ");
+
+			QString errorMessage;
+			if(!ZUtil::setupSocket(peerStatsSock, config.statsInSpecs, false, config.ipcFileMode, &errorMessage))
+			{
+					log_error("%s", qPrintable(errorMessage));
+					return false;
+			}
+
+			peerStatsValve = new QZmq::Valve(peerStatsSock, this);
+			connect(peerStatsValve, &QZmq::Valve::readyRead, this, &Private::peerStats_readyRead);
+
+			log_info("stats in: %s", qPrintable(config.statsInSpecs.join(", ")));
+		}
+
 		if(!config.proxyCommandSpec.isEmpty())
 		{
 			proxyControlClient = new ZrpcManager(this);
@@ -1638,117 +2476,567 @@ public:
 			log_info("http control server: %s:%d", qPrintable(config.pushInHttpAddr.toString()), config.pushInHttpPort);
 		}
 
-		if(inPullValve)
-			inPullValve->open();
-		if(inSubValve)
-			inSubValve->open();
 		if(wsControlInValve)
 			wsControlInValve->open();
 		if(proxyStatsValve)
 			proxyStatsValve->open();
+		if(peerStatsValve)
+			peerStatsValve->open();
 
 		return true;
 	}
 
-	void reload()
+	// applies the config fields that can change at runtime. fields
+	//   that sessions read live (message block size, dedup window,
+	//   priority prefixes, stream gzip) take effect by assignment alone
+	void applyRuntimeConfig()
 	{
-		// nothing to do
-	}
-
-private:
-	void handlePublishItem(const PublishItem &item)
-	{
-		// only sequence if someone is listening, because we
-		//   clear lastId on unsubscribe and don't want it to
-		//   be set again until after a subscription returns
-
-		bool seq = (!item.noSeq && cs.subs.contains(item.channel));
+		publishLimiter->setRate(config.messageRate);
+		publishLimiter->setHwm(config.messageHwm);
 
-		sequencer->addItem(item, seq);
-	}
+		publishQueueHwm = config.publishQueueHwm;
+		publishQueueLwm = config.publishQueueLwm;
+		if(publishQueueLwm < 0)
+			publishQueueLwm = (publishQueueHwm > 0 ? publishQueueHwm / 2 : 0);
 
-	void writeRetryPacket(const RetryRequestPacket &packet)
-	{
-		if(!retrySock)
+		if(config.publishQueueOverflow == "drop-oldest")
 		{
-			log_error("retry: can't write, no socket");
-			return;
+			publishQueueOverflow = HttpSession::QueueDropOldest;
+		}
+		else if(config.publishQueueOverflow == "disconnect")
+		{
+			publishQueueOverflow = HttpSession::QueueDisconnect;
 		}
+		else
+		{
+			if(!config.publishQueueOverflow.isEmpty() && config.publishQueueOverflow != "drop-newest")
+				log_warning("unknown publish_queue_overflow value: %s, using drop-newest", qPrintable(config.publishQueueOverflow));
 
-		QVariant vout = packet.toVariant();
+			publishQueueOverflow = HttpSession::QueueDropNewest;
+		}
 
-		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-			log_debug("OUT retry: %s", qPrintable(TnetString::variantToString(vout, -1)));
+		sequencer->setIdCacheTtl(config.idCacheTtl);
 
-		retrySock->write(QList<QByteArray>() << TnetString::fromVariant(vout));
-	}
+		routeBudgets.setMaxConnections(config.routeConnectionsMax);
+		routeBudgets.setMaxHeldBytes(config.routeHeldBytesMax);
+		routeBudgets.setMaxSubscriptions(config.routeSubscriptionsMax);
 
-	void writeWsControlItems(const QList<WsControlPacket::Item> &items)
-	{
-		if(!wsControlOutSock)
-		{
-			log_error("wscontrol: can't write, no socket");
-			return;
-		}
+		cs.replayRing.setLimits(config.replayItemsMax, config.replayBytesMax, config.replayItemTtl);
 
-		WsControlPacket out;
-		out.items = items;
+		if(stats)
+		{
+			stats->setConnectionTtl(config.statsConnectionTtl);
+			stats->setSubscriptionTtl(config.statsSubscriptionTtl);
+			stats->setSubscriptionLinger(config.subscriptionLinger);
+			stats->setReportInterval(config.statsReportInterval);
 
-		QVariant vout = out.toVariant();
+			if(config.statsFormat == "compact")
+			{
+				stats->setOutputFormat(StatsManager::CompactFormat);
+			}
+			else
+			{
+				if(!config.statsFormat.isEmpty() && config.statsFormat != "tnetstring")
+					log_warning("unknown stats_format value: %s, using tnetstring", qPrintable(config.statsFormat));
 
-		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-			log_debug("OUT wscontrol: %s", qPrintable(TnetString::variantToString(vout, -1)));
+				stats->setOutputFormat(StatsManager::TnetStringFormat);
+			}
 
-		wsControlOutSock->write(QList<QByteArray>() << TnetString::fromVariant(vout));
-	}
+			if(config.eventLoopStallThreshold > 0)
+			{
+				if(!loopProfiler)
+				{
+					loopProfiler = new EventLoopProfiler(stats, this);
 
-	void addSub(const QString &channel)
-	{
-		if(!cs.subs.contains(channel))
-		{
-			Subscription *sub = new Subscription(channel);
-			connect(sub, &Subscription::subscribed, this, &Private::sub_subscribed);
-			cs.subs.insert(channel, sub);
-			sub->start();
+					log_info("event loop profiling enabled, stall threshold %dms", config.eventLoopStallThreshold);
+				}
 
-			if(inSubSock)
+				loopProfiler->setStallThreshold(config.eventLoopStallThreshold);
+			}
+			else if(loopProfiler)
 			{
-				log_debug("SUB socket subscribe: %s", qPrintable(channel));
-				inSubSock->subscribe(channel.toUtf8());
+				delete loopProfiler;
+				loopProfiler = 0;
+
+				log_info("event loop profiling disabled");
 			}
 		}
-	}
 
-	void removeSub(const QString &channel)
-	{
-		if(cs.subs.contains(channel))
+		if(config.busyPollIdleTimeout > 0)
 		{
-			Subscription *sub = cs.subs[channel];
-			cs.subs.remove(channel);
-			delete sub;
-
-			sequencer->clearPendingForChannel(channel);
-			cs.publishLastIds.remove(channel);
-
-			if(inSubSock)
+			if(!busyPoller)
 			{
-				log_debug("SUB socket unsubscribe: %s", qPrintable(channel));
-				inSubSock->unsubscribe(channel.toUtf8());
+				busyPoller = new BusyPoller(this);
+
+				log_info("busy-poll mode enabled, idle timeout %dms", config.busyPollIdleTimeout);
 			}
+
+			busyPoller->setIdleTimeout(config.busyPollIdleTimeout);
+		}
+		else if(busyPoller)
+		{
+			delete busyPoller;
+			busyPoller = 0;
+
+			log_info("busy-poll mode disabled");
 		}
 	}
 
-	void removeWsSession(WsSession *s)
+	void reload(const Configuration &newConfig)
 	{
-		removeSessionChannels(s);
+		// accept only the fields that are safe to change while
+		//   running. specs, shard layout, and identity keep their
+		//   startup values, so nothing here touches sockets or the
+		//   subscription table
+		config.messageRate = newConfig.messageRate;
+		config.messageHwm = newConfig.messageHwm;
+		config.messageBlockSize = newConfig.messageBlockSize;
+		config.priorityChannelPrefixes = newConfig.priorityChannelPrefixes;
+		config.lastItemChannelPrefixes = newConfig.lastItemChannelPrefixes;
+		config.replayChannelPrefixes = newConfig.replayChannelPrefixes;
+		config.replayItemsMax = newConfig.replayItemsMax;
+		config.replayBytesMax = newConfig.replayBytesMax;
+		config.replayItemTtl = newConfig.replayItemTtl;
+		config.idCacheTtl = newConfig.idCacheTtl;
+		config.connectionSubscriptionMax = newConfig.connectionSubscriptionMax;
+		config.routeConnectionsMax = newConfig.routeConnectionsMax;
+		config.routeHeldBytesMax = newConfig.routeHeldBytesMax;
+		config.routeSubscriptionsMax = newConfig.routeSubscriptionsMax;
+		config.publishQueueHwm = newConfig.publishQueueHwm;
+		config.publishQueueLwm = newConfig.publishQueueLwm;
+		config.publishQueueOverflow = newConfig.publishQueueOverflow;
+		config.publishDedupWindow = newConfig.publishDedupWindow;
+		config.unsubscribeLinger = newConfig.unsubscribeLinger;
+		config.unsubscribeLingerMax = newConfig.unsubscribeLingerMax;
+		config.subscriptionLinger = newConfig.subscriptionLinger;
+		config.statsConnectionTtl = newConfig.statsConnectionTtl;
+		config.statsSubscriptionTtl = newConfig.statsSubscriptionTtl;
+		config.statsReportInterval = newConfig.statsReportInterval;
+		config.statsFormat = newConfig.statsFormat;
+		config.eventLoopStallThreshold = newConfig.eventLoopStallThreshold;
+		config.busyPollIdleTimeout = newConfig.busyPollIdleTimeout;
+		config.streamGzip = newConfig.streamGzip;
+
+		applyRuntimeConfig();
+	}
 
-		log_debug("removed ws session: %s", qPrintable(s->cid));
+private:
+	bool lastItemChannel(const QString &channel) const
+	{
+		foreach(const QString &prefix, config.lastItemChannelPrefixes)
+		{
+			if(channel.startsWith(prefix))
+				return true;
+		}
 
-		cs.wsSessions.remove(s->cid);
-		delete s;
+		return false;
 	}
 
-	void httpControlRespond(SimpleHttpRequest *req, int code, const QByteArray &reason, const QString &body, const QByteArray &contentType = QByteArray(), const HttpHeaders &headers = HttpHeaders(), int items = -1)
+	bool replayChannel(const QString &channel) const
+	{
+		foreach(const QString &prefix, config.replayChannelPrefixes)
+		{
+			if(channel.startsWith(prefix))
+				return true;
+		}
+
+		return false;
+	}
+
+	int channelPriority(const QString &channel) const
+	{
+		foreach(const QString &prefix, config.priorityChannelPrefixes)
+		{
+			if(channel.startsWith(prefix))
+				return 1;
+		}
+
+		return 0;
+	}
+
+	// whether this instance owns the channel in sharded mode. wildcard
+	//   channels span shards and can't be mapped, so they always count
+	//   as owned
+	bool channelInShard(const QString &channel) const
+	{
+		if(config.shardCount < 2 || ChannelIndex::isWildcard(channel))
+			return true;
+
+		return (shardForHash(stableHash64(channel.toUtf8()), config.shardCount) == config.shardId);
+	}
+
+	// whether a publish should be processed by this instance. foreign
+	//   channels are still accepted if a local wildcard subscription
+	//   matches, since wildcards can't be confined to one shard
+	bool shardAcceptsChannel(const QString &channel) const
+	{
+		if(channelInShard(channel))
+			return true;
+
+		foreach(const QString &prefix, wildcardSubPrefixes)
+		{
+			if(channel.startsWith(prefix))
+				return true;
+		}
+
+		return false;
+	}
+
+	// forward a locally ingested publish to the peer mesh. peers
+	//   subscribe to the channels they hold, so zmq filters unwanted
+	//   channels on our side of the wire
+	void republishToPeers(const QString &channel, const QByteArray &data)
+	{
+		if(!peerOutSock)
+			return;
+
+		if(!peerOutSock->canWriteImmediately())
+			stats->addZmqHwmHit("peer-out");
+
+		peerOutSock->write(QList<QByteArray>() << channel.toUtf8() << data);
+	}
+
+	bool publishBacklogged() const
+	{
+		// consider fan-out saturated once the limiter backlog reaches
+		//   half the hwm, so spooling kicks in well before drops start
+		return (config.messageHwm > 0 && publishLimiter->queuedWeight() >= config.messageHwm / 2);
+	}
+
+	// returns true if the message was consumed by the spool
+	bool trySpool(const QByteArray &channel, const QByteArray &data)
+	{
+		if(!publishSpool.isReady())
+			return false;
+
+		// start spooling when fan-out is saturated. once the spool is
+		//   non-empty, everything goes through it until it drains, so
+		//   per-channel order is preserved
+		if(publishSpool.isEmpty() && !publishBacklogged())
+			return false;
+
+		QVariantList record;
+		record += channel;
+		record += data;
+
+		if(!publishSpool.append(TnetString::fromVariant(record)))
+		{
+			// ring full. at this point we're past what the operator
+			//   budgeted for bursts, so drop
+			stats->addMessageDropped(QByteArray());
+			return true;
+		}
+
+		if(!spoolHighWarned && publishSpool.depth() >= publishSpool.capacity() * 3 / 4)
+		{
+			log_warning("publish spool over 75%% full (%lld bytes)", (long long)publishSpool.depth());
+			spoolHighWarned = true;
+		}
+
+		stats->setPublishSpoolDepth(publishSpool.depth());
+
+		if(!spoolDrainTimer->isActive())
+			spoolDrainTimer->start(0);
+
+		return true;
+	}
+
+	void handlePublishItem(PublishItem item)
+	{
+		// in sharded mode, process only our slice of the channel space.
+		//   publishers that push everything to every instance rely on
+		//   this filter for multi-process scaling
+		if(config.shardCount > 1 && !shardAcceptsChannel(item.channel))
+		{
+			log_debug("shard: channel %s not owned by this instance, skipping", qPrintable(item.channel));
+			return;
+		}
+
+		// stamp ingest time, so delivery latency can be reported
+		item.ingestTime = QDateTime::currentMSecsSinceEpoch();
+
+		publishTop.add(item.channel);
+
+		TRACEPOINT2(publish_ingest, stableHash64(item.channel.toUtf8()), item.size);
+
+		// only sequence if someone is listening, because we
+		//   clear lastId on unsubscribe and don't want it to
+		//   be set again until after a subscription returns
+
+		bool seq = (!item.noSeq && cs.subs.contains(item.channel));
+
+		sequencer->addItem(std::move(item), seq);
+	}
+
+	void writeRetryPacket(const RetryRequestPacket &packet)
+	{
+		if(!retrySock)
+		{
+			log_error("retry: can't write, no socket");
+			return;
+		}
+
+		// aggregate packets generated within the same turn. a publish
+		//   that closes many held requests produces a burst of retries
+		pendingRetryPackets += packet;
+
+		if(pendingRetryPackets.count() >= RETRY_PACKETS_MAX)
+			flushRetryPackets();
+		else if(!retryFlushTimer->isActive())
+			retryFlushTimer->start(0);
+	}
+
+	void flushRetryPackets()
+	{
+		// coalesce packets carrying the same request template and
+		//   inspect info. the wire format already supports multiple
+		//   requests per packet, so sessions woken by the same publish
+		//   share one copy of the template instead of re-sending it per
+		//   connection
+		QList<RetryRequestPacket> merged;
+		QHash<QByteArray, int> indexByTemplate;
+
+		foreach(const RetryRequestPacket &p, pendingRetryPackets)
+		{
+			QVariantHash vtemplate = p.toVariant().toHash();
+			vtemplate.remove("requests");
+			QByteArray templateKey = TnetString::fromVariant(vtemplate);
+
+			int at = indexByTemplate.value(templateKey, -1);
+			if(at != -1 && merged[at].requests.count() + p.requests.count() <= RETRY_PACKET_REQUESTS_MAX)
+			{
+				merged[at].requests += p.requests;
+			}
+			else
+			{
+				merged += p;
+				indexByTemplate[templateKey] = merged.count() - 1;
+			}
+		}
+
+		pendingRetryPackets.clear();
+
+		foreach(const RetryRequestPacket &p, merged)
+		{
+			QVariant vout = p.toVariant();
+
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("OUT retry: %s", qPrintable(TnetString::variantToString(vout, -1)));
+
+			// if the zmq queue is at hwm, the write below backs up in
+			//   the wrapper. count the event so pressure here is visible
+			//   instead of showing up as hung clients
+			if(!retrySock->canWriteImmediately())
+				stats->addZmqHwmHit("retry");
+
+			retrySock->write(QList<QByteArray>() << TnetString::fromVariant(vout));
+		}
+
+		retryFlushTimer->stop();
+	}
+
+	void writeWsControlItems(const QList<WsControlPacket::Item> &items)
+	{
+		if(!wsControlOutSock)
+		{
+			log_error("wscontrol: can't write, no socket");
+			return;
+		}
+
+		// aggregate items generated within the same turn, so fanning out
+		//   to many ws sessions produces a few large packets instead of
+		//   one packet per session
+		pendingWsControlItems += items;
+
+		if(pendingWsControlItems.count() >= WSCONTROL_ITEMS_MAX)
+			flushWsControlItems();
+		else if(!wsControlFlushTimer->isActive())
+			wsControlFlushTimer->start(0);
+	}
+
+	void flushWsControlItems()
+	{
+		while(!pendingWsControlItems.isEmpty())
+		{
+			WsControlPacket out;
+			if(pendingWsControlItems.count() > WSCONTROL_ITEMS_MAX)
+			{
+				out.items = pendingWsControlItems.mid(0, WSCONTROL_ITEMS_MAX);
+				pendingWsControlItems = pendingWsControlItems.mid(WSCONTROL_ITEMS_MAX);
+			}
+			else
+			{
+				out.items = pendingWsControlItems;
+				pendingWsControlItems.clear();
+			}
+
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("OUT wscontrol: %s", qPrintable(TnetString::variantToString(out.toVariant(), -1)));
+
+			if(!wsControlOutSock->canWriteImmediately())
+				stats->addZmqHwmHit("ws-control");
+
+			// encode straight into the reused buffer, skipping the
+			//   QVariant intermediate on the hot path
+			out.toTnetString(&wsControlEncodeBuf);
+
+			wsControlOutSock->write(QList<QByteArray>() << wsControlEncodeBuf);
+		}
+
+		wsControlFlushTimer->stop();
+	}
+
+	void addSub(const QString &channel)
+	{
+		// a lingering channel is still subscribed, so resubscribing
+		//   just cancels the pending removal. the queue entry goes
+		//   stale and is skipped on pop
+		lingeringSubs.remove(channel);
+
+		if(!cs.subs.contains(channel))
+		{
+			if(config.shardCount > 1)
+			{
+				if(ChannelIndex::isWildcard(channel))
+					wildcardSubPrefixes += channel.left(channel.length() - 1);
+				else if(!channelInShard(channel))
+					log_warning("subscribe to channel %s, which belongs to another shard. client may be misrouted", qPrintable(channel));
+			}
+
+			Subscription *sub = new Subscription(channel);
+			connect(sub, &Subscription::subscribed, this, &Private::sub_subscribed);
+			cs.subs.insert(channel, sub);
+			sub->start();
+
+			subscribeTop.add(channel);
+
+			if(inSubSock || peerInSock)
+			{
+				// zmq SUB matching is by prefix, so a wildcard
+				//   subscription maps naturally: subscribe to the part
+				//   before the '*'
+				QByteArray sub = channel.toUtf8();
+				if(ChannelIndex::isWildcard(channel))
+					sub.truncate(sub.length() - 1);
+
+				queueSubOp(sub, 1);
+			}
+		}
+	}
+
+	void removeSub(const QString &channel)
+	{
+		if(!cs.subs.contains(channel))
+			return;
+
+		if(config.unsubscribeLinger > 0)
+		{
+			// retain the socket subscription for a while after the last
+			//   local session leaves. flappy clients otherwise cause
+			//   subscribe/unsubscribe oscillation on the SUB socket, and
+			//   each flap risks missing publishes during resubscribe
+			qint64 expires = QDateTime::currentMSecsSinceEpoch() + ((qint64)config.unsubscribeLinger * 1000);
+			lingeringSubs[channel] = expires;
+			lingerQueue += qMakePair(channel, expires);
+
+			// bound memory by forcing out the oldest lingering channels
+			while(lingeringSubs.count() > config.unsubscribeLingerMax && !lingerQueue.isEmpty())
+			{
+				QPair<QString, qint64> front = lingerQueue.takeFirst();
+				if(lingeringSubs.value(front.first, -1) != front.second)
+					continue;
+
+				lingeringSubs.remove(front.first);
+				finishRemoveSub(front.first);
+			}
+
+			if(!subLingerTimer)
+			{
+				subLingerTimer = new QTimer(this);
+				subLingerTimer->setSingleShot(true);
+				connect(subLingerTimer, &QTimer::timeout, this, &Private::subLinger_timeout);
+			}
+
+			if(!subLingerTimer->isActive())
+				subLingerTimer->start(config.unsubscribeLinger * 1000);
+
+			return;
+		}
+
+		finishRemoveSub(channel);
+	}
+
+	void finishRemoveSub(const QString &channel)
+	{
+		if(cs.subs.contains(channel))
+		{
+			if(config.shardCount > 1 && ChannelIndex::isWildcard(channel))
+				wildcardSubPrefixes.removeOne(channel.left(channel.length() - 1));
+
+			Subscription *sub = cs.subs[channel];
+			cs.subs.remove(channel);
+			delete sub;
+
+			sequencer->clearPendingForChannel(channel);
+			cs.publishLastIds.remove(channel);
+
+			if(inSubSock || peerInSock)
+			{
+				QByteArray sub = channel.toUtf8();
+				if(ChannelIndex::isWildcard(channel))
+					sub.truncate(sub.length() - 1);
+
+				queueSubOp(sub, -1);
+			}
+		}
+	}
+
+	// subscribe/unsubscribe ops are queued as net counts per prefix and
+	//   applied to the socket in batches by subSync_timeout. this
+	//   coalesces subscribe/unsubscribe churn, and during a mass
+	//   resubscribe (e.g. reconnect storms) the event loop keeps
+	//   processing publishes between batches instead of stalling on a
+	//   million socket calls
+	void queueSubOp(const QByteArray &prefix, int delta)
+	{
+		int &count = pendingSubOps[prefix];
+		count += delta;
+
+		if(count == 0)
+			pendingSubOps.remove(prefix);
+		else if(!subSyncTimer->isActive())
+			subSyncTimer->start(0);
+	}
+
+	void removeWsSession(WsSession *s)
+	{
+		removeSessionChannels(s);
+
+		log_debug("removed ws session: %s", qPrintable(s->cid));
+
+		cs.wsSessions.remove(s->cid);
+		routeBudgets.removeConnection(s->route);
+		delete s;
+	}
+
+	void refreshWsControlPeer(const QByteArray &peer, int ttl)
+	{
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+		// drop lapsed peers, so restarts don't accumulate entries. the
+		//   map holds one entry per proxy instance, so this scan is tiny
+		QMutableHashIterator<QByteArray, qint64> it(wsControlPeers);
+		while(it.hasNext())
+		{
+			it.next();
+			if(it.value() <= now)
+				it.remove();
+		}
+
+		wsControlPeers[peer] = now + (ttl * 1000);
+	}
+
+	void httpControlRespond(SimpleHttpRequest *req, int code, const QByteArray &reason, const QString &body, const QByteArray &contentType = QByteArray(), const HttpHeaders &headers = HttpHeaders(), int items = -1)
 	{
 		HttpHeaders outHeaders = headers;
 		if(!contentType.isEmpty())
@@ -1766,8 +3054,120 @@ private:
 		log_info("%s", qPrintable(msg));
 	}
 
+	// deliver a retained item to a session directly, picking the
+	//   format matching the session's hold mode. returns false if the
+	//   item carries no usable format
+	bool deliverRetainedItem(HttpSession *hs, const PublishItem &item)
+	{
+		PublishFormat::Type ftype = (hs->holdMode() == Instruct::ResponseHold) ? PublishFormat::HttpResponse : PublishFormat::HttpStream;
+		if(!item.formats.contains(ftype))
+			return false;
+
+		PublishItem i = item;
+		i.format = i.formats.value(ftype);
+		i.formats.clear();
+
+		PublishFormat &f = i.format;
+
+		QList<QByteArray> exposeHeaders = f.headers.getAll("Grip-Expose-Headers");
+
+		// strip out grip headers
+		for(int n = 0; n < f.headers.count(); ++n)
+		{
+			if(qstrnicmp(f.headers[n].first.data(), "Grip-", 5) == 0)
+			{
+				f.headers.removeAt(n);
+				--n; // adjust position
+			}
+		}
+
+		publishSend(hs, i, exposeHeaders);
+		return true;
+	}
+
+	// deliver the cached last item on a channel to a newly attached
+	//   session, so latest-value clients reach current state without
+	//   an origin fetch
+	void deliverLastItem(HttpSession *hs, const QString &channel)
+	{
+		PublishItem *cached = cs.lastItems.object(channel);
+		if(!cached)
+			return;
+
+		Instruct::HoldMode mode = hs->holdMode();
+
+		QString prevId = hs->channels().value(channel).prevId;
+
+		if(mode == Instruct::ResponseHold)
+		{
+			// only complete a response hold if the client stated a
+			//   position and it isn't current. without this check, a
+			//   long-poll without prev-id would spin on the cache
+			if(prevId.isNull() || cached->id.isEmpty() || prevId == cached->id)
+				return;
+		}
+		else
+		{
+			// stream holds get the latest value on attach, unless the
+			//   client is known to be current
+			if(!prevId.isNull() && !cached->id.isEmpty() && prevId == cached->id)
+				return;
+		}
+
+		deliverRetainedItem(hs, *cached);
+	}
+
+	// serve last-id catch-up for the channel from the replay ring.
+	//   returns true if the ring covered the client's position, whether
+	//   or not any items were actually missed
+	bool replayCatchUp(HttpSession *hs, const QString &channel)
+	{
+		QString prevId = hs->channels().value(channel).prevId;
+		if(prevId.isNull())
+			return false;
+
+		bool ok;
+		QList<PublishItem> missed = cs.replayRing.itemsSince(channel, prevId, QDateTime::currentMSecsSinceEpoch(), &ok);
+		if(!ok)
+			return false;
+
+		Instruct::HoldMode mode = hs->holdMode();
+		ZhttpRequest::Rid rid = hs->rid();
+
+		foreach(const PublishItem &item, missed)
+		{
+			deliverRetainedItem(hs, item);
+
+			// a response hold carries one item. the client's next poll
+			//   resumes from that item's id
+			if(mode == Instruct::ResponseHold)
+				break;
+
+			// delivering may close the session
+			if(cs.httpSessions.value(rid) != hs)
+				break;
+		}
+
+		return true;
+	}
+
+	void deliverLastItem(WsSession *s, const QString &channel)
+	{
+		PublishItem *cached = cs.lastItems.object(channel);
+		if(!cached || !cached->formats.contains(PublishFormat::WebSocketMessage))
+			return;
+
+		PublishItem i = *cached;
+		i.format = i.formats.value(PublishFormat::WebSocketMessage);
+		i.formats.clear();
+
+		publishSend(s, i, QList<QByteArray>());
+	}
+
 	void publishSend(QObject *target, const PublishItem &item, const QList<QByteArray> &exposeHeaders)
 	{
+		TRACEPOINT2(publish_deliver, target, item.ingestTime);
+
 		const PublishFormat &f = item.format;
 
 		if(f.type == PublishFormat::HttpResponse || f.type == PublishFormat::HttpStream)
@@ -1780,13 +3180,19 @@ private:
 		{
 			WsSession *s = qobject_cast<WsSession*>(target);
 
+			QString subChannel = s->subscriptionForChannel(item.channel);
+			if(subChannel.isNull())
+				return;
+
 			Filter::Context fc;
 			fc.subscriptionMeta = s->meta;
 			fc.publishMeta = item.meta;
+			fc.subscriberId = s->cid.toUtf8();
+			fc.channel = item.channel;
 
-			FilterStack filters(fc, s->channelFilters[item.channel]);
+			FilterStack *filters = FilterStack::cached(fc, s->channelFilters.value(subChannel));
 
-			if(filters.sendAction() == Filter::Drop)
+			if(filters->sendAction() == Filter::Drop)
 				return;
 
 			// TODO: hint support for websockets?
@@ -1798,11 +3204,27 @@ private:
 
 			if(f.action == PublishFormat::Send)
 			{
-				QByteArray body = filters.process(f.body);
-				if(body.isNull())
+				QByteArray body;
+
+				QByteArray cacheKey;
+				if(item.renderCache)
+					cacheKey = RenderCache::makeKey(f.type, s->channelFilters.value(subChannel), s->meta);
+
+				if(item.renderCache && item.renderCache->contains(cacheKey))
 				{
-					log_debug("filter error: %s", qPrintable(filters.errorMessage()));
-					return;
+					body = item.renderCache->value(cacheKey);
+				}
+				else
+				{
+					body = filters->process(f.body);
+					if(body.isNull())
+					{
+						log_debug("filter error: %s", qPrintable(filters->errorMessage()));
+						return;
+					}
+
+					if(item.renderCache)
+						item.renderCache->insert(cacheKey, body);
 				}
 
 				i.type = WsControlPacket::Item::Send;
@@ -1840,11 +3262,24 @@ private:
 	{
 		if(!channel.isNull())
 		{
-			QSet<HttpSession*> sessions = cs.responseSessionsByChannel.value(channel);
+			if(ChannelIndex::isWildcard(channel))
+			{
+				foreach(QObject *obj, cs.responseWildcards.subscribers(channel))
+					qobject_cast<HttpSession*>(obj)->update();
+
+				foreach(QObject *obj, cs.streamWildcards.subscribers(channel))
+					qobject_cast<HttpSession*>(obj)->update();
+
+				return;
+			}
+
+			int cid = cs.channelIntern.id(channel);
+
+			QSet<HttpSession*> sessions = cs.responseSessionsByChannel.value(cid);
 			foreach(HttpSession *hs, sessions)
 				hs->update();
 
-			sessions = cs.streamSessionsByChannel.value(channel);
+			sessions = cs.streamSessionsByChannel.value(cid);
 			foreach(HttpSession *hs, sessions)
 				hs->update();
 		}
@@ -1861,12 +3296,36 @@ private:
 		updateSessions();
 	}
 
+	// hand held requests back to the proxy for retry, so that another
+	//   instance can accept them. only response holds can move this way.
+	//   stream holds and websockets keep their transport until the
+	//   client reconnects
+	int drainCommand()
+	{
+		foreach(HttpSession *hs, cs.httpSessions)
+		{
+			if(hs->holdMode() == Instruct::ResponseHold)
+				drainSessions += hs;
+		}
+
+		int count = drainSessions.count();
+
+		if(count > 0)
+		{
+			log_info("drain: returning %d held responses for retry", count);
+
+			sessionDrainTimer->start();
+		}
+
+		return count;
+	}
+
 	void removeSessionChannel(HttpSession *hs, const QString &channel)
 	{
 		Instruct::HoldMode mode = hs->holdMode();
 		assert(mode == Instruct::ResponseHold || mode == Instruct::StreamHold);
 
-		QHash<QString, QSet<HttpSession*> > *sessionsByChannel;
+		QHash<int, QSet<HttpSession*> > *sessionsByChannel;
 		QString modeStr;
 
 		if(mode == Instruct::ResponseHold)
@@ -1880,22 +3339,53 @@ private:
 			modeStr = "stream";
 		}
 
-		if(!sessionsByChannel->contains(channel))
+		if(ChannelIndex::isWildcard(channel))
+		{
+			ChannelIndex *wildcards = (mode == Instruct::ResponseHold) ? &cs.responseWildcards : &cs.streamWildcards;
+
+			if(!wildcards->contains(channel))
+				return;
+
+			wildcards->remove(channel, hs);
+
+			routeBudgets.removeSubscription(hs->route());
+
+			int count = wildcards->count(channel);
+			if(count > 0)
+			{
+				stats->addSubscription(modeStr, channel, count);
+			}
+			else
+			{
+				// linger the unsub in case client long-polls again
+				bool linger = (mode == Instruct::ResponseHold);
+
+				stats->removeSubscription(modeStr, channel, linger);
+			}
+
+			return;
+		}
+
+		int cid = cs.channelIntern.id(channel);
+		if(cid < 0 || !sessionsByChannel->contains(cid))
 			return;
 
-		QSet<HttpSession*> &cur = (*sessionsByChannel)[channel];
+		QSet<HttpSession*> &cur = (*sessionsByChannel)[cid];
 		if(!cur.contains(hs))
 			return;
 
 		cur.remove(hs);
 
+		routeBudgets.removeSubscription(hs->route());
+
 		if(!cur.isEmpty())
 		{
 			stats->addSubscription(modeStr, channel, cur.count());
 		}
 		else
 		{
-			sessionsByChannel->remove(channel);
+			sessionsByChannel->remove(cid);
+			cs.channelIntern.release(cid);
 
 			// linger the unsub in case client long-polls again
 			bool linger = (mode == Instruct::ResponseHold);
@@ -1906,41 +3396,100 @@ private:
 
 	void removeSessionChannel(WsSession *s, const QString &channel)
 	{
-		if(!cs.wsSessionsByChannel.contains(channel))
+		if(ChannelIndex::isWildcard(channel))
+		{
+			if(!cs.wsWildcards.contains(channel))
+				return;
+
+			cs.wsWildcards.remove(channel, s);
+
+			routeBudgets.removeSubscription(s->route);
+
+			int count = cs.wsWildcards.count(channel);
+			if(count > 0)
+				stats->addSubscription("ws", channel, count);
+			else
+				stats->removeSubscription("ws", channel, false);
+
 			return;
+		}
 
-		QSet<WsSession*> &cur = cs.wsSessionsByChannel[channel];
+		int cid = cs.channelIntern.id(channel);
+		if(cid < 0 || !cs.wsSessionsByChannel.contains(cid))
+			return;
+
+		QSet<WsSession*> &cur = cs.wsSessionsByChannel[cid];
 		if(!cur.contains(s))
 			return;
 
 		cur.remove(s);
 
+		routeBudgets.removeSubscription(s->route);
+
 		if(!cur.isEmpty())
 		{
 			stats->addSubscription("ws", channel, cur.count());
 		}
 		else
 		{
-			cs.wsSessionsByChannel.remove(channel);
+			cs.wsSessionsByChannel.remove(cid);
+			cs.channelIntern.release(cid);
 
 			stats->removeSubscription("ws", channel, false);
 		}
 	}
 
-	void removeSessionChannels(WsSession *s)
-	{
-		foreach(const QString &channel, s->channels)
-			removeSessionChannel(s, channel);
+	void removeSessionChannels(WsSession *s)
+	{
+		foreach(const QString &channel, s->channels)
+			removeSessionChannel(s, channel);
+	}
+
+	bool startNextAccept()
+	{
+		ZrpcRequest *req = acceptServer->takeNext();
+		if(!req)
+			return false;
+
+		AcceptWorker *w;
+		if(!acceptWorkerPool.isEmpty())
+			w = acceptWorkerPool.takeLast();
+		else
+			w = new AcceptWorker(stateClient, sessionUpdater, &detectRuleCache, &cs, zhttpIn, zhttpOut, stats, updateLimiter, httpSessionUpdateManager, &bodyCache, &routeBudgets, &acceptWorkerPool, this);
+
+		connect(w, &AcceptWorker::finished, this, &Private::acceptWorker_finished);
+		connect(w, &AcceptWorker::sessionsReady, this, &Private::acceptWorker_sessionsReady);
+		connect(w, &AcceptWorker::retryPacketReady, this, &Private::acceptWorker_retryPacketReady);
+		acceptWorkers += w;
+		TRACEPOINT1(accept_start, w);
+		w->start(req, config.connectionSubscriptionMax, publishQueueHwm, publishQueueLwm, publishQueueOverflow, config.streamGzip);
+
+		stats->setRetainedBodyPool(bodyCache.totalBytes(), bodyCache.evictions());
+		stats->setRouteBudgetTotals(routeBudgets.totalHeldBytes(), routeBudgets.holdsRejected());
+
+		return true;
 	}
 
 private slots:
 	void sequencer_itemReady(const PublishItem &item)
 	{
+		// retain the latest item on opted-in channels. the copy shares
+		//   the item's buffers, so this holds references, not renders
+		if(lastItemChannel(item.channel))
+			cs.lastItems.insert(item.channel, new PublishItem(item));
+
+		if(replayChannel(item.channel))
+			cs.replayRing.add(item, QDateTime::currentMSecsSinceEpoch());
+
 		QList<HttpSession*> responseSessions;
 		QList<HttpSession*> streamSessions;
 		QList<WsSession*> wsSessions;
 		QSet<QString> sids;
 
+		// hash the channel name once. -1 (channel not interned) simply
+		//   misses in all of the indexes below
+		int cid = cs.channelIntern.id(item.channel);
+
 		int largestBlocks = -1;
 		if(item.size >= 0)
 			largestBlocks = blocksForData(item.size);
@@ -1950,7 +3499,7 @@ private slots:
 			if(item.size < 0)
 				largestBlocks = qMax(blocksForData(item.formats[PublishFormat::HttpResponse].body.size()), largestBlocks);
 
-			QSet<HttpSession*> sessions = cs.responseSessionsByChannel.value(item.channel);
+			QSet<HttpSession*> sessions = cs.responseSessionsByChannel.value(cid);
 			foreach(HttpSession *hs, sessions)
 			{
 				assert(hs->holdMode() == Instruct::ResponseHold);
@@ -1961,6 +3510,16 @@ private slots:
 				if(!hs->sid().isEmpty())
 					sids += hs->sid();
 			}
+
+			foreach(QObject *obj, cs.responseWildcards.matches(item.channel))
+			{
+				HttpSession *hs = qobject_cast<HttpSession*>(obj);
+
+				responseSessions += hs;
+
+				if(!hs->sid().isEmpty())
+					sids += hs->sid();
+			}
 		}
 
 		if(item.formats.contains(PublishFormat::HttpStream))
@@ -1968,7 +3527,7 @@ private slots:
 			if(item.size < 0)
 				largestBlocks = qMax(blocksForData(item.formats[PublishFormat::HttpStream].body.size()), largestBlocks);
 
-			QSet<HttpSession*> sessions = cs.streamSessionsByChannel.value(item.channel);
+			QSet<HttpSession*> sessions = cs.streamSessionsByChannel.value(cid);
 			foreach(HttpSession *hs, sessions)
 			{
 				// note: we used to assert that the session was currently a
@@ -1985,6 +3544,16 @@ private slots:
 				if(!hs->sid().isEmpty())
 					sids += hs->sid();
 			}
+
+			foreach(QObject *obj, cs.streamWildcards.matches(item.channel))
+			{
+				HttpSession *hs = qobject_cast<HttpSession*>(obj);
+
+				streamSessions += hs;
+
+				if(!hs->sid().isEmpty())
+					sids += hs->sid();
+			}
 		}
 
 		if(item.formats.contains(PublishFormat::WebSocketMessage))
@@ -1992,7 +3561,7 @@ private slots:
 			if(item.size < 0)
 				largestBlocks = qMax(blocksForData(item.formats[PublishFormat::WebSocketMessage].body.size()), largestBlocks);
 
-			QSet<WsSession*> wsbc = cs.wsSessionsByChannel.value(item.channel);
+			QSet<WsSession*> wsbc = cs.wsSessionsByChannel.value(cid);
 			foreach(WsSession *s, wsbc)
 			{
 				assert(s->channels.contains(item.channel));
@@ -2002,6 +3571,16 @@ private slots:
 				if(!s->sid.isEmpty())
 					sids += s->sid;
 			}
+
+			foreach(QObject *obj, cs.wsWildcards.matches(item.channel))
+			{
+				WsSession *s = qobject_cast<WsSession*>(obj);
+
+				wsSessions += s;
+
+				if(!s->sid.isEmpty())
+					sids += s->sid;
+			}
 		}
 
 		// always add for non-identified route
@@ -2012,6 +3591,7 @@ private slots:
 			PublishItem i = item;
 			i.format = item.formats.value(PublishFormat::HttpResponse);
 			i.formats.clear();
+			i.renderCache = QSharedPointer<RenderCache>(new RenderCache);
 
 			PublishFormat &f = i.format;
 
@@ -2039,20 +3619,14 @@ private slots:
 			else
 				blocks = blocksForData(f.body.size());
 
+			HttpFanOutJob *job = new HttpFanOutJob(this);
 			foreach(HttpSession *hs, responseSessions)
-			{
-				QString route = hs->route();
-
-				if(!publishLimiter->addAction(route, new PublishAction(this, hs, i, exposeHeaders), blocks != -1 ? blocks : 1))
-				{
-					if(!route.isEmpty())
-						log_warning("exceeded publish hwm (%d) for route %s, dropping message", config.messageHwm, qPrintable(route));
-					else
-						log_warning("exceeded publish hwm (%d), dropping message", config.messageHwm);
-				}
-
-				stats->addMessageSent(route.toUtf8(), "http-response", blocks);
-			}
+				job->sessions += QPointer<HttpSession>(hs);
+			job->item = i;
+			job->exposeHeaders = exposeHeaders;
+			job->transport = "http-response";
+			job->blocks = blocks;
+			fanOut->addJob(job);
 
 			stats->addMessage(i.channel, i.id, "http-response", responseSessions.count(), blocks != -1 ? blocks * responseSessions.count() : -1);
 		}
@@ -2062,9 +3636,16 @@ private slots:
 			PublishItem i = item;
 			i.format = item.formats.value(PublishFormat::HttpStream);
 			i.formats.clear();
+			i.renderCache = QSharedPointer<RenderCache>(new RenderCache);
 
 			PublishFormat &f = i.format;
 
+			// hash the payload so sessions can skip bodies they already
+			//   received via an overlapping channel. response holds are
+			//   excluded, since the hold must respond with something
+			if(config.publishDedupWindow > 0 && !f.body.isEmpty())
+				i.contentHash = stableHash64(f.body);
+
 			log_debug("relaying to %d http-stream subscribers", streamSessions.count());
 
 			int blocks;
@@ -2073,20 +3654,13 @@ private slots:
 			else
 				blocks = blocksForData(f.body.size());
 
+			HttpFanOutJob *job = new HttpFanOutJob(this);
 			foreach(HttpSession *hs, streamSessions)
-			{
-				QString route = hs->route();
-
-				if(!publishLimiter->addAction(route, new PublishAction(this, hs, i), blocks != -1 ? blocks : 1))
-				{
-					if(!route.isEmpty())
-						log_warning("exceeded publish hwm (%d) for route %s, dropping message", config.messageHwm, qPrintable(route));
-					else
-						log_warning("exceeded publish hwm (%d), dropping message", config.messageHwm);
-				}
-
-				stats->addMessageSent(route.toUtf8(), "http-stream", blocks);
-			}
+				job->sessions += QPointer<HttpSession>(hs);
+			job->item = i;
+			job->transport = "http-stream";
+			job->blocks = blocks;
+			fanOut->addJob(job);
 
 			stats->addMessage(i.channel, i.id, "http-stream", streamSessions.count(), blocks != -1 ? blocks * streamSessions.count() : -1);
 		}
@@ -2096,9 +3670,13 @@ private slots:
 			PublishItem i = item;
 			i.format = item.formats.value(PublishFormat::WebSocketMessage);
 			i.formats.clear();
+			i.renderCache = QSharedPointer<RenderCache>(new RenderCache);
 
 			PublishFormat &f = i.format;
 
+			if(config.publishDedupWindow > 0 && !f.body.isEmpty())
+				i.contentHash = stableHash64(f.body);
+
 			log_debug("relaying to %d ws-message subscribers", wsSessions.count());
 
 			int blocks;
@@ -2107,20 +3685,12 @@ private slots:
 			else
 				blocks = blocksForData(f.body.size());
 
+			WsFanOutJob *job = new WsFanOutJob(this);
 			foreach(WsSession *s, wsSessions)
-			{
-				QString route = s->route;
-
-				if(!publishLimiter->addAction(route, new PublishAction(this, s, i), blocks != -1 ? blocks : 1))
-				{
-					if(!route.isEmpty())
-						log_warning("exceeded publish hwm (%d) for route %s, dropping message", config.messageHwm, qPrintable(route));
-					else
-						log_warning("exceeded publish hwm (%d), dropping message", config.messageHwm);
-				}
-
-				stats->addMessageSent(route.toUtf8(), "ws-message", blocks);
-			}
+				job->sessions += QPointer<WsSession>(s);
+			job->item = i;
+			job->blocks = blocks;
+			fanOut->addJob(job);
 
 			stats->addMessage(i.channel, i.id, "ws-message", wsSessions.count(), blocks != -1 ? blocks * wsSessions.count() : -1);
 		}
@@ -2131,17 +3701,12 @@ private slots:
 		if(!item.id.isNull() && !sids.isEmpty() && stateClient)
 		{
 			// update sessions' last-id
-			QHash<QString, LastIds> sidLastIds;
 			foreach(const QString &sid, sids)
 			{
 				LastIds lastIds;
 				lastIds[item.channel] = item.id;
-				sidLastIds[sid] = lastIds;
+				sessionUpdater->update(sid, lastIds);
 			}
-
-			Deferred *d = SessionRequest::updateMany(stateClient, sidLastIds, this);
-			connect(d, &Deferred::finished, this, &Private::sessionUpdateMany_finished);
-			deferreds += d;
 		}
 	}
 
@@ -2154,9 +3719,15 @@ private slots:
 		if(!req)
 			return;
 
-		InspectWorker *w = new InspectWorker(req, stateClient, config.shareAll, this);
+		InspectWorker *w;
+		if(!inspectWorkerPool.isEmpty())
+			w = inspectWorkerPool.takeLast();
+		else
+			w = new InspectWorker(stateClient, &detectRuleCache, &inspectWorkerPool, this);
+
 		connect(w, &Deferred::finished, this, &Private::inspectWorker_finished);
 		inspectWorkers += w;
+		w->start(req, config.shareAll);
 	}
 
 	void acceptServer_requestReady()
@@ -2164,16 +3735,7 @@ private slots:
 		if(acceptWorkers.count() >= ACCEPT_WORKERS_MAX)
 			return;
 
-		ZrpcRequest *req = acceptServer->takeNext();
-		if(!req)
-			return;
-
-		AcceptWorker *w = new AcceptWorker(req, stateClient, &cs, zhttpIn, zhttpOut, stats, updateLimiter, httpSessionUpdateManager, config.connectionSubscriptionMax, this);
-		connect(w, &AcceptWorker::finished, this, &Private::acceptWorker_finished);
-		connect(w, &AcceptWorker::sessionsReady, this, &Private::acceptWorker_sessionsReady);
-		connect(w, &AcceptWorker::retryPacketReady, this, &Private::acceptWorker_retryPacketReady);
-		acceptWorkers += w;
-		w->start();
+		startNextAccept();
 	}
 
 	void controlServer_requestReady()
@@ -2196,96 +3758,602 @@ private slots:
 			QVariantHash out;
 			if(!config.commandSpec.isEmpty())
 				out["command"] = config.commandSpec.toUtf8();
-			if(!config.pushInSpec.isEmpty())
-				out["publish-pull"] = config.pushInSpec.toUtf8();
+			if(!config.pushInSpecs.isEmpty())
+				out["publish-pull"] = config.pushInSpecs.join(",").toUtf8();
 			if(!config.pushInSubSpec.isEmpty())
 				out["publish-sub"] = config.pushInSubSpec.toUtf8();
 			req->respond(out);
 			delete req;
 		}
-		else if(req->method() == "recover")
+		else if(req->method() == "recover")
+		{
+			recoverCommand();
+			req->respond();
+			delete req;
+		}
+		else if(req->method() == "refresh")
+		{
+			// for channel mode, resolve the target sessions up front so
+			//   the worker doesn't need access to engine internals
+			QStringList sessionCids;
+			QVariantHash args = req->args();
+			if(args.contains("channel") && args["channel"].type() == QVariant::ByteArray)
+			{
+				QString channel = QString::fromUtf8(args["channel"].toByteArray());
+				int cid = cs.channelIntern.id(channel);
+				if(cid >= 0)
+				{
+					foreach(WsSession *s, cs.wsSessionsByChannel.value(cid))
+						sessionCids += s->cid;
+				}
+			}
+
+			RefreshWorker *w = new RefreshWorker(req, proxyControlClient, sessionCids, this);
+			connect(w, &RefreshWorker::finished, this, &Private::deferred_finished);
+			deferreds += w;
+		}
+		else if(req->method() == "drain")
+		{
+			QVariantHash out;
+			out["held-responses"] = drainCommand();
+			req->respond(out);
+			delete req;
+		}
+		else if(req->method() == "top-channels")
+		{
+			// approximate counts from the heavy-hitter trackers.
+			//   counts decay by half every TOP_CHANNELS_DECAY_INTERVAL,
+			//   so they reflect recent rates, and can overcount on
+			//   sketch collisions
+			QVariantList publish;
+			{
+				QList<QPair<QString, quint64> > entries = publishTop.top();
+				for(int n = 0; n < entries.count(); ++n)
+				{
+					QVariantHash e;
+					e["channel"] = entries[n].first.toUtf8();
+					e["count"] = entries[n].second;
+					publish += e;
+				}
+			}
+
+			QVariantList subscribe;
+			{
+				QList<QPair<QString, quint64> > entries = subscribeTop.top();
+				for(int n = 0; n < entries.count(); ++n)
+				{
+					QVariantHash e;
+					e["channel"] = entries[n].first.toUtf8();
+					e["count"] = entries[n].second;
+					subscribe += e;
+				}
+			}
+
+			QVariantHash out;
+			out["publish"] = publish;
+			out["subscribe"] = subscribe;
+			req->respond(out);
+			delete req;
+		}
+		else if(req->method() == "list-subscriptions")
+		{
+			QVariantHash args = req->args();
+
+			int max = args.value("max").toInt();
+			if(max <= 0)
+				max = SUBS_DUMP_PAGE_DEFAULT;
+			max = qMin(max, SUBS_DUMP_PAGE_MAX);
+
+			int offset = 0;
+
+			if(args.contains("cursor"))
+			{
+				// cursor format: dumpId:offset, referring to the key
+				//   snapshot taken when the dump started
+				QByteArray cursor = args["cursor"].toByteArray();
+				int at = cursor.indexOf(':');
+				bool ok1 = false;
+				bool ok2 = false;
+				quint64 id = 0;
+				if(at > 0)
+				{
+					id = cursor.mid(0, at).toULongLong(&ok1);
+					offset = cursor.mid(at + 1).toInt(&ok2);
+				}
+
+				if(!ok1 || !ok2 || offset < 0)
+				{
+					req->respondError("bad-request");
+					delete req;
+					return;
+				}
+
+				if(id != subsDumpId || subsDumpKeys.isEmpty())
+				{
+					// the snapshot lapsed or was replaced by a newer
+					//   dump. the caller should restart from the top
+					req->respondError("cursor-expired");
+					delete req;
+					return;
+				}
+			}
+			else
+			{
+				// snapshot the channel names so pages stay stable
+				//   while the table changes underneath. the names are
+				//   implicitly shared, so this holds references, not
+				//   string copies. one dump is active at a time:
+				//   starting a new one expires outstanding cursors
+				++subsDumpId;
+				subsDumpKeys = cs.subs.keys();
+			}
+
+			QVariantList subscriptions;
+			int n = offset;
+			for(; n < subsDumpKeys.count() && n < offset + max; ++n)
+			{
+				const QString &channel = subsDumpKeys[n];
+
+				// skip channels unsubscribed since the snapshot
+				if(!cs.subs.contains(channel))
+					continue;
+
+				int resp = 0;
+				int strm = 0;
+				int ws = 0;
+				if(ChannelIndex::isWildcard(channel))
+				{
+					resp = cs.responseWildcards.count(channel);
+					strm = cs.streamWildcards.count(channel);
+					ws = cs.wsWildcards.count(channel);
+				}
+				else
+				{
+					int cid = cs.channelIntern.id(channel);
+					if(cid >= 0)
+					{
+						resp = cs.responseSessionsByChannel.value(cid).count();
+						strm = cs.streamSessionsByChannel.value(cid).count();
+						ws = cs.wsSessionsByChannel.value(cid).count();
+					}
+				}
+
+				QVariantHash e;
+				e["channel"] = channel.toUtf8();
+				e["response"] = resp;
+				e["stream"] = strm;
+				e["ws"] = ws;
+
+				subscriptions += e;
+			}
+
+			QVariantHash out;
+			out["subscriptions"] = subscriptions;
+			out["total"] = subsDumpKeys.count();
+
+			if(n < subsDumpKeys.count())
+			{
+				out["cursor"] = QByteArray::number(subsDumpId) + ':' + QByteArray::number(n);
+
+				if(!subsDumpExpireTimer)
+				{
+					subsDumpExpireTimer = new QTimer(this);
+					connect(subsDumpExpireTimer, &QTimer::timeout, this, &Private::subsDumpExpire_timeout);
+					subsDumpExpireTimer->setSingleShot(true);
+				}
+
+				subsDumpExpireTimer->start(SUBS_DUMP_TTL);
+			}
+			else
+			{
+				// done. release the snapshot
+				subsDumpKeys.clear();
+
+				if(subsDumpExpireTimer)
+					subsDumpExpireTimer->stop();
+			}
+
+			req->respond(out);
+			delete req;
+		}
+		else
+		{
+			req->respondError("method-not-found");
+			delete req;
+		}
+	}
+
+private:
+	void handlePullMessage(const QList<QByteArray> &message)
+	{
+		if(message.count() != 1)
+		{
+			log_warning("IN pull: received message with parts != 1, skipping");
+			return;
+		}
+
+		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+		{
+			bool ok_;
+			QVariant data = TnetString::toVariant(message[0], 0, &ok_);
+			if(ok_)
+				log_debug("IN pull: %s", qPrintable(TnetString::variantToString(data, -1)));
+		}
+
+		if(trySpool(QByteArray(), message[0]))
+			return;
+
+		bool ok;
+		QString errorMessage;
+		PublishItem item = PublishItem::fromTnetString(message[0], QString(), &ok, &errorMessage);
+		if(!ok)
+		{
+			log_warning("IN pull: received message with invalid format: %s, skipping", qPrintable(errorMessage));
+			return;
+		}
+
+		republishToPeers(item.channel, message[0]);
+
+		handlePublishItem(std::move(item));
+	}
+
+	void handleSubMessage(const QList<QByteArray> &message)
+	{
+		if(message.count() != 2)
+		{
+			log_warning("IN sub: received message with parts != 2, skipping");
+			return;
+		}
+
+		QString channel = QString::fromUtf8(message[0]);
+
+		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+		{
+			bool ok_;
+			QVariant data = TnetString::toVariant(message[1], 0, &ok_);
+			if(ok_)
+				log_debug("IN sub: channel=%s %s", qPrintable(channel), qPrintable(TnetString::variantToString(data, -1)));
+		}
+
+		if(trySpool(message[0], message[1]))
+			return;
+
+		bool ok;
+		QString errorMessage;
+		PublishItem item = PublishItem::fromTnetString(message[1], channel, &ok, &errorMessage);
+		if(!ok)
+		{
+			log_warning("IN sub: received message with invalid format: %s, skipping", qPrintable(errorMessage));
+			return;
+		}
+
+		handlePublishItem(std::move(item));
+	}
+
+	void handlePeerMessage(const QList<QByteArray> &message)
+	{
+		if(message.count() != 2)
+		{
+			log_warning("IN peer: received message with parts != 2, skipping");
+			return;
+		}
+
+		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+		{
+			bool ok_;
+			QVariant data = TnetString::toVariant(message[1], 0, &ok_);
+			if(ok_)
+				log_debug("IN peer: channel=%s %s", message[0].data(), qPrintable(TnetString::variantToString(data, -1)));
+		}
+
+		// the channel is embedded in the item. note: peer messages are
+		//   never republished or spooled, so the mesh can't loop
+		bool ok;
+		QString errorMessage;
+		PublishItem item = PublishItem::fromTnetString(message[1], QString(), &ok, &errorMessage);
+		if(!ok)
+		{
+			log_warning("IN peer: received message with invalid format: %s, skipping", qPrintable(errorMessage));
+			return;
+		}
+
+		handlePublishItem(std::move(item));
+	}
+
+private slots:
+	void inPull_readyRead()
+	{
+		// drain raw frames off the sockets eagerly, ahead of
+		//   processing, so that zmq's receive buffer is freed even
+		//   while heavy logic turns run in bounded slices. without
+		//   this, a long fan-out lets RCVHWM fill and upstream
+		//   senders block or drop. the sockets are drained
+		//   round-robin, so one busy endpoint can't starve the
+		//   others. if the pending queue hits its cap, we stop
+		//   reading and let zmq's own buffering apply backpressure
+		if(busyPoller)
+			busyPoller->activity();
+
+		bool readable = true;
+		while(readable && inPullPending.count() < PUBLISH_INGEST_QUEUE_MAX)
+		{
+			readable = false;
+			foreach(QZmq::Socket *sock, inPullSocks)
+			{
+				if(inPullPending.count() >= PUBLISH_INGEST_QUEUE_MAX)
+					break;
+
+				if(!sock->canRead())
+					continue;
+
+				inPullPending += sock->read();
+
+				if(sock->canRead())
+					readable = true;
+			}
+		}
+
+		// process a bounded batch per wakeup, so that other activity
+		//   isn't starved. anything left continues on the next pass
+		QPointer<QObject> self = this;
+
+		int count = 0;
+		while(!inPullPending.isEmpty() && count < PUBLISH_DRAIN_MAX)
+		{
+			QList<QByteArray> message = inPullPending.takeFirst();
+			++count;
+
+			handlePullMessage(message);
+			if(!self)
+				return;
+		}
+
+		if(!inPullPending.isEmpty())
 		{
-			recoverCommand();
-			req->respond();
-			delete req;
+			inPullDrainTimer->start();
+			return;
 		}
-		else if(req->method() == "refresh")
+
+		foreach(QZmq::Socket *sock, inPullSocks)
 		{
-			RefreshWorker *w = new RefreshWorker(req, proxyControlClient, this);
-			connect(w, &RefreshWorker::finished, this, &Private::deferred_finished);
-			deferreds += w;
+			if(sock->canRead())
+			{
+				inPullDrainTimer->start();
+				break;
+			}
 		}
-		else
+	}
+
+	void inSub_readyRead()
+	{
+		// as with inPull_readyRead: drain eagerly, process bounded.
+		//   this matters most here, since a SUB socket at RCVHWM
+		//   makes the publisher drop silently
+		if(busyPoller)
+			busyPoller->activity();
+
+		while(inSubSock->canRead() && inSubPending.count() < PUBLISH_INGEST_QUEUE_MAX)
+			inSubPending += inSubSock->read();
+
+		QPointer<QObject> self = this;
+
+		int count = 0;
+		while(!inSubPending.isEmpty() && count < PUBLISH_DRAIN_MAX)
 		{
-			req->respondError("method-not-found");
-			delete req;
+			QList<QByteArray> message = inSubPending.takeFirst();
+			++count;
+
+			handleSubMessage(message);
+			if(!self)
+				return;
 		}
+
+		if(!inSubPending.isEmpty() || inSubSock->canRead())
+			inSubDrainTimer->start();
 	}
 
-	void inPull_readyRead(const QList<QByteArray> &message)
+	void peerIn_readyRead()
 	{
-		if(message.count() != 1)
+		QPointer<QObject> self = this;
+
+		int count = 0;
+		while(peerInSock->canRead() && count < PUBLISH_DRAIN_MAX)
 		{
-			log_warning("IN pull: received message with parts != 1, skipping");
-			return;
+			QList<QByteArray> message = peerInSock->read();
+			++count;
+
+			handlePeerMessage(message);
+			if(!self)
+				return;
 		}
 
-		bool ok;
-		QVariant data = TnetString::toVariant(message[0], 0, &ok);
-		if(!ok)
+		if(peerInSock->canRead())
+			peerInDrainTimer->start();
+	}
+
+	void spoolDrain_timeout()
+	{
+		QPointer<QObject> self = this;
+
+		// replay in bounded batches, and only while fan-out has room.
+		//   if the backlog builds again mid-drain, pause and let the
+		//   limiter catch up before continuing
+		int count = 0;
+		while(!publishSpool.isEmpty() && count < PUBLISH_DRAIN_MAX && !publishBacklogged())
 		{
-			log_warning("IN pull: received message with invalid format (tnetstring parse failed), skipping");
-			return;
+			QByteArray record = publishSpool.takeNext();
+			++count;
+
+			bool ok;
+			QVariant vrecord = TnetString::toVariant(record, 0, &ok);
+			QVariantList list = (ok ? vrecord.toList() : QVariantList());
+			if(list.count() != 2)
+			{
+				// can't happen unless the mapping was corrupted
+				log_warning("spool: received invalid record, skipping");
+				continue;
+			}
+
+			QString channel = QString::fromUtf8(list[0].toByteArray());
+			QByteArray data = list[1].toByteArray();
+
+			QString errorMessage;
+			PublishItem item = PublishItem::fromTnetString(data, channel, &ok, &errorMessage);
+			if(!ok)
+			{
+				log_warning("spool: received message with invalid format: %s, skipping", qPrintable(errorMessage));
+				continue;
+			}
+
+			// pull-origin records (empty spool channel) are forwarded to
+			//   peers on replay, same as they would have been live
+			if(channel.isEmpty())
+				republishToPeers(item.channel, data);
+
+			handlePublishItem(std::move(item));
+			if(!self)
+				return;
 		}
 
-		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-			log_debug("IN pull: %s", qPrintable(TnetString::variantToString(data, -1)));
+		stats->setPublishSpoolDepth(publishSpool.depth());
 
-		QString errorMessage;
-		PublishItem item = PublishItem::fromVariant(data, QString(), &ok, &errorMessage);
-		if(!ok)
+		if(!publishSpool.isEmpty())
 		{
-			log_warning("IN pull: received message with invalid format: %s, skipping", qPrintable(errorMessage));
-			return;
+			// if we stopped on backlog rather than batch size, wait a
+			//   beat instead of spinning on a zero timer
+			spoolDrainTimer->start(publishBacklogged() ? SPOOL_DRAIN_RETRY_INTERVAL : 0);
+		}
+		else if(spoolHighWarned)
+		{
+			log_info("publish spool drained");
+			spoolHighWarned = false;
+		}
+	}
+
+	void sessionDrain_timeout()
+	{
+		QPointer<QObject> self = this;
+
+		int count = 0;
+		while(!drainSessions.isEmpty() && count < SESSION_DRAIN_MAX)
+		{
+			HttpSession *hs = *(drainSessions.begin());
+			drainSessions.remove(hs);
+			++count;
+
+			// pauses the request, which finishes the session with a
+			//   retry packet that we forward to the proxy
+			hs->finishForRetry();
+
+			if(!self)
+				return;
 		}
 
-		handlePublishItem(item);
+		if(!drainSessions.isEmpty())
+			sessionDrainTimer->start();
 	}
 
-	void inSub_readyRead(const QList<QByteArray> &message)
+	void subSync_timeout()
 	{
-		if(message.count() != 2)
+		int processed = 0;
+
+		QMutableHashIterator<QByteArray, int> it(pendingSubOps);
+		while(it.hasNext() && processed < SUB_SYNC_BATCH_MAX)
 		{
-			log_warning("IN sub: received message with parts != 2, skipping");
-			return;
+			it.next();
+			const QByteArray &prefix = it.key();
+			int count = it.value();
+
+			// apply the net count, preserving zmq's subscription
+			//   refcounting for prefixes shared by multiple channels
+			while(count > 0)
+			{
+				log_debug("SUB socket subscribe: %s", prefix.data());
+				if(inSubSock)
+					inSubSock->subscribe(prefix);
+				if(peerInSock)
+					peerInSock->subscribe(prefix);
+				--count;
+				++processed;
+			}
+			while(count < 0)
+			{
+				log_debug("SUB socket unsubscribe: %s", prefix.data());
+				if(inSubSock)
+					inSubSock->unsubscribe(prefix);
+				if(peerInSock)
+					peerInSock->unsubscribe(prefix);
+				++count;
+				++processed;
+			}
+
+			it.remove();
 		}
 
-		bool ok;
-		QVariant data = TnetString::toVariant(message[1], 0, &ok);
-		if(!ok)
+		if(!pendingSubOps.isEmpty())
 		{
-			log_warning("IN sub: received message with invalid format (tnetstring parse failed), skipping");
-			return;
+			log_info("sub sync: %d prefixes remaining", pendingSubOps.count());
+			subSyncTimer->start(0);
 		}
+	}
 
-		QString channel = QString::fromUtf8(message[0]);
+	void topDecay_timeout()
+	{
+		publishTop.decay();
+		subscribeTop.decay();
+	}
 
-		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-			log_debug("IN sub: channel=%s %s", qPrintable(channel), qPrintable(TnetString::variantToString(data, -1)));
+	void subLinger_timeout()
+	{
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
 
-		QString errorMessage;
-		PublishItem item = PublishItem::fromVariant(data, channel, &ok, &errorMessage);
-		if(!ok)
+		while(!lingerQueue.isEmpty())
 		{
-			log_warning("IN sub: received message with invalid format: %s, skipping", qPrintable(errorMessage));
-			return;
+			QPair<QString, qint64> front = lingerQueue.first();
+
+			// stale entry: the channel resubscribed, or lingered again
+			//   with a later expiry
+			if(lingeringSubs.value(front.first, -1) != front.second)
+			{
+				lingerQueue.removeFirst();
+				continue;
+			}
+
+			if(front.second > now)
+			{
+				subLingerTimer->start(front.second - now);
+				return;
+			}
+
+			lingerQueue.removeFirst();
+			lingeringSubs.remove(front.first);
+
+			finishRemoveSub(front.first);
 		}
+	}
+
+	void subsDumpExpire_timeout()
+	{
+		// abandoned dump. release the snapshot so it doesn't pin
+		//   channel names
+		subsDumpKeys.clear();
+	}
 
-		handlePublishItem(item);
+	void retryFlush_timeout()
+	{
+		flushRetryPackets();
+	}
+
+	void wsControlFlush_timeout()
+	{
+		flushWsControlItems();
 	}
 
 	void wsControlIn_readyRead(const QList<QByteArray> &message)
 	{
+		if(busyPoller)
+			busyPoller->activity();
+
 		if(message.count() != 1)
 		{
 			log_warning("IN wscontrol: received message with parts != 1, skipping");
@@ -2328,10 +4396,14 @@ private slots:
 
 			if(item.type == WsControlPacket::Item::Here)
 			{
+				bool isNew = false;
+
 				WsSession *s = cs.wsSessions.value(item.cid);
 				if(!s)
 				{
-					s = new WsSession(this);
+					isNew = true;
+
+					s = new WsSession(wsTimerWheel, this);
 					connect(s, &WsSession::send, this, &Private::wssession_send);
 					connect(s, &WsSession::expired, this, &Private::wssession_expired);
 					connect(s, &WsSession::error, this, &Private::wssession_error);
@@ -2343,8 +4415,27 @@ private slots:
 					log_debug("added ws session: %s", qPrintable(s->cid));
 				}
 
+				s->peer = packet.from;
 				s->route = item.route;
 				s->channelPrefix = QString::fromUtf8(item.channelPrefix);
+
+				// account after the route is known, since it arrives
+				//   in the same item that creates the session
+				if(isNew)
+					routeBudgets.addConnection(s->route);
+
+				continue;
+			}
+
+			if(item.type == WsControlPacket::Item::KeepAlive && item.cid.isEmpty())
+			{
+				// peer-level keep-alive: a single item covers every
+				//   session owned by the peer. sessions consult the
+				//   deadline lazily when their own timers fire, so the
+				//   cost here stays constant regardless of how many
+				//   sessions the peer holds
+				if(!packet.from.isEmpty() && item.ttl > 0)
+					refreshWsControlPeer(packet.from, item.ttl);
 				continue;
 			}
 
@@ -2374,19 +4465,16 @@ private slots:
 			{
 				QJsonParseError e;
 				QJsonDocument doc = QJsonDocument::fromJson(item.message, &e);
-				if(e.error != QJsonParseError::NoError || (!doc.isObject() && !doc.isArray()))
+				if(e.error != QJsonParseError::NoError || !doc.isObject())
 				{
-					log_debug("grip control message is not valid json");
+					log_debug("grip control message is not a valid json object");
 					return;
 				}
 
-				if(doc.isObject())
-					data = doc.object().toVariantMap();
-				else // isArray
-					data = doc.array().toVariantList();
-
+				// decode the json object directly rather than going
+				//   through a variant tree first
 				QString errorMessage;
-				WsControlMessage cm = WsControlMessage::fromVariant(data, &ok, &errorMessage);
+				WsControlMessage cm = WsControlMessage::fromJson(doc.object(), &ok, &errorMessage);
 				if(!ok)
 				{
 					log_debug("failed to parse grip control message: %s", qPrintable(errorMessage));
@@ -2399,19 +4487,44 @@ private slots:
 					{
 						QString channel = s->channelPrefix + cm.channel;
 						s->channels += channel;
-						s->channelFilters[channel] = cm.filters;
 
-						if(!cs.wsSessionsByChannel.contains(channel))
-							cs.wsSessionsByChannel.insert(channel, QSet<WsSession*>());
+						// most subscriptions carry no filters. leaving
+						//   those out keeps the per-session hash empty,
+						//   which in qt means no allocation at all
+						if(!cm.filters.isEmpty())
+							s->channelFilters[channel] = cm.filters;
+						else
+							s->channelFilters.remove(channel);
+
+						if(ChannelIndex::isWildcard(channel))
+						{
+							cs.wsWildcards.add(channel, s);
+
+							stats->addSubscription("ws", channel, cs.wsWildcards.count(channel));
+						}
+						else
+						{
+							int cid = cs.channelIntern.id(channel);
+							if(cid < 0 || !cs.wsSessionsByChannel.contains(cid))
+							{
+								cid = cs.channelIntern.add(channel);
+								cs.wsSessionsByChannel.insert(cid, QSet<WsSession*>());
+							}
+
+							cs.wsSessionsByChannel[cid] += s;
 
-						cs.wsSessionsByChannel[channel] += s;
+							stats->addSubscription("ws", channel, cs.wsSessionsByChannel.value(cid).count());
+						}
 
 						log_debug("ws session %s subscribed to %s", qPrintable(s->cid), qPrintable(channel));
 
-						stats->addSubscription("ws", channel, cs.wsSessionsByChannel.value(channel).count());
+						routeBudgets.addSubscription(s->route);
+
 						addSub(channel);
 
 						log_info("subscribe %s channel=%s", qPrintable(s->requestData.uri.toString(QUrl::FullyEncoded)), qPrintable(channel));
+
+						deliverLastItem(s, channel);
 					}
 					else
 					{
@@ -2478,6 +4591,14 @@ private slots:
 						s->keepAliveMessage = cm.content;
 
 						i.timeout = (cm.timeout > 0 ? cm.timeout : DEFAULT_WS_KEEPALIVE_TIMEOUT);
+
+						// include the content so the proxy can write the
+						//   frame itself on each interval. the state is
+						//   still kept here and NeedKeepAlive still
+						//   answered, for proxies that don't use the
+						//   template
+						i.contentType = contentType;
+						i.message = cm.content;
 					}
 					else
 					{
@@ -2529,17 +4650,35 @@ private slots:
 				s->channels += channel;
 				s->implicitChannels += channel;
 
-				if(!cs.wsSessionsByChannel.contains(channel))
-					cs.wsSessionsByChannel.insert(channel, QSet<WsSession*>());
+				if(ChannelIndex::isWildcard(channel))
+				{
+					cs.wsWildcards.add(channel, s);
+
+					stats->addSubscription("ws", channel, cs.wsWildcards.count(channel));
+				}
+				else
+				{
+					int cid = cs.channelIntern.id(channel);
+					if(cid < 0 || !cs.wsSessionsByChannel.contains(cid))
+					{
+						cid = cs.channelIntern.add(channel);
+						cs.wsSessionsByChannel.insert(cid, QSet<WsSession*>());
+					}
+
+					cs.wsSessionsByChannel[cid] += s;
 
-				cs.wsSessionsByChannel[channel] += s;
+					stats->addSubscription("ws", channel, cs.wsSessionsByChannel.value(cid).count());
+				}
 
 				log_debug("ws session %s subscribed to %s", qPrintable(s->cid), qPrintable(channel));
 
-				stats->addSubscription("ws", channel, cs.wsSessionsByChannel.value(channel).count());
+				routeBudgets.addSubscription(s->route);
+
 				addSub(channel);
 
 				log_info("subscribe %s channel=%s", qPrintable(s->requestData.uri.toString(QUrl::FullyEncoded)), qPrintable(channel));
+
+				deliverLastItem(s, channel);
 			}
 			else if(item.type == WsControlPacket::Item::Ack)
 			{
@@ -2554,11 +4693,7 @@ private slots:
 		if(stateClient && !updateSids.isEmpty())
 		{
 			foreach(const QString &sid, updateSids)
-			{
-				Deferred *d = SessionRequest::createOrUpdate(stateClient, sid, LastIds(), this);
-				connect(d, &Deferred::finished, this, &Private::sessionCreateOrUpdate_finished);
-				deferreds += d;
-			}
+				sessionUpdater->createOrUpdate(sid);
 		}
 	}
 
@@ -2579,28 +4714,42 @@ private slots:
 
 		QByteArray type = message[0].mid(0, at);
 
-		if(at + 1 >= message[0].length() || message[0][at + 1] != 'T')
+		if(at + 1 >= message[0].length() || (message[0][at + 1] != 'T' && message[0][at + 1] != 'B'))
 		{
 			log_warning("IN proxy stats: received message with unsupported format, skipping");
 			return;
 		}
 
-		bool ok;
-		QVariant data = TnetString::toVariant(message[0], at + 2, &ok);
-		if(!ok)
+		StatsPacket p;
+		if(message[0][at + 1] == 'B')
 		{
-			log_warning("IN proxy stats: received message with invalid format (tnetstring parse failed), skipping");
-			return;
+			if(!p.fromCompact(message[0].mid(at + 2)))
+			{
+				log_warning("IN proxy stats: received message with invalid format (compact parse failed), skipping");
+				return;
+			}
+
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("IN proxy stats: %s (compact)", type.data());
 		}
+		else
+		{
+			bool ok;
+			QVariant data = TnetString::toVariant(message[0], at + 2, &ok);
+			if(!ok)
+			{
+				log_warning("IN proxy stats: received message with invalid format (tnetstring parse failed), skipping");
+				return;
+			}
 
-		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-			log_debug("IN proxy stats: %s %s", type.data(), qPrintable(TnetString::variantToString(data, -1)));
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("IN proxy stats: %s %s", type.data(), qPrintable(TnetString::variantToString(data, -1)));
 
-		StatsPacket p;
-		if(!p.fromVariant(type, data))
-		{
-			log_warning("IN proxy stats: received message with invalid format, skipping");
-			return;
+			if(!p.fromVariant(type, data))
+			{
+				log_warning("IN proxy stats: received message with invalid format, skipping");
+				return;
+			}
 		}
 
 		if(p.type == StatsPacket::Activity)
@@ -2630,14 +4779,76 @@ private slots:
 			// update session
 			if(stateClient && !sid.isEmpty() && p.type == StatsPacket::Connected)
 			{
-				QHash<QString, LastIds> sidLastIds;
-				sidLastIds[sid] = LastIds();
-				Deferred *d = SessionRequest::updateMany(stateClient, sidLastIds, this);
-				connect(d, &Deferred::finished, this, &Private::sessionUpdateMany_finished);
-				deferreds += d;
+				sessionUpdater->update(sid);
+				return;
+			}
+		}
+	}
+
+	void peerStats_readyRead(const QList<QByteArray> &message)
+	{
+		if(message.count() != 1)
+		{
+			log_warning("IN peer stats: received message with parts != 1, skipping");
+			return;
+		}
+
+		int at = message[0].indexOf(' ');
+		if(at == -1)
+		{
+			log_warning("IN peer stats: received message with invalid format, skipping");
+			return;
+		}
+
+		QByteArray type = message[0].mid(0, at);
+
+		if(at + 1 >= message[0].length() || (message[0][at + 1] != 'T' && message[0][at + 1] != 'B'))
+		{
+			log_warning("IN peer stats: received message with unsupported format, skipping");
+			return;
+		}
+
+		StatsPacket p;
+		if(message[0][at + 1] == 'B')
+		{
+			if(!p.fromCompact(message[0].mid(at + 2)))
+			{
+				log_warning("IN peer stats: received message with invalid format (compact parse failed), skipping");
+				return;
+			}
+
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("IN peer stats: %s (compact)", type.data());
+		}
+		else
+		{
+			bool ok;
+			QVariant data = TnetString::toVariant(message[0], at + 2, &ok);
+			if(!ok)
+			{
+				log_warning("IN peer stats: received message with invalid format (tnetstring parse failed), skipping");
+				return;
+			}
+
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+				log_debug("IN peer stats: %s %s", type.data(), qPrintable(TnetString::variantToString(data, -1)));
+
+			if(!p.fromVariant(type, data))
+			{
+				log_warning("IN peer stats: received message with invalid format, skipping");
 				return;
 			}
 		}
+
+		if(p.type == StatsPacket::Report)
+		{
+			// a peer configured to subscribe back at us would double
+			//   count, so ignore our own reflections
+			if(p.from == config.instanceId)
+				return;
+
+			stats->processExternalReport(p);
+		}
 	}
 
 	void controlHttpServer_requestReady()
@@ -2756,8 +4967,13 @@ private slots:
 					httpControlRespond(req, 200, "OK", message + "\n", responseContentType, HttpHeaders(), items.count());
 				}
 
-				foreach(const PublishItem &item, items)
-					handlePublishItem(item);
+				for(int n = 0; n < items.count(); ++n)
+				{
+					if(peerOutSock)
+						republishToPeers(items[n].channel, TnetString::fromVariant(convertToTnetStyle(vitems[n])));
+
+					handlePublishItem(items[n]);
+				}
 			}
 			else
 			{
@@ -2792,30 +5008,26 @@ private slots:
 				httpControlRespond(req, 405, "Method Not Allowed", "Method not allowed: " + req->requestMethod() + ".\n", QByteArray(), headers);
 			}
 		}
+		else if(path == "/metrics")
+		{
+			if(req->requestMethod() == "GET")
+			{
+				QByteArray body = stats->prometheusMetrics();
+				httpControlRespond(req, 200, "OK", QString::fromUtf8(body), "text/plain; version=0.0.4");
+			}
+			else
+			{
+				HttpHeaders headers;
+				headers += HttpHeader("Allow", "GET");
+				httpControlRespond(req, 405, "Method Not Allowed", "Method not allowed: " + req->requestMethod() + ".\n", QByteArray(), headers);
+			}
+		}
 		else
 		{
 			httpControlRespond(req, 404, "Not Found", "Not Found\n");
 		}
 	}
 
-	void sessionCreateOrUpdate_finished(const DeferredResult &result)
-	{
-		Deferred *d = (Deferred *)sender();
-		deferreds.remove(d);
-
-		if(!result.success)
-			log_error("couldn't create/update session: condition=%d", result.value.toInt());
-	}
-
-	void sessionUpdateMany_finished(const DeferredResult &result)
-	{
-		Deferred *d = (Deferred *)sender();
-		deferreds.remove(d);
-
-		if(!result.success)
-			log_error("couldn't update session: condition=%d", result.value.toInt());
-	}
-
 	void inspectWorker_finished(const DeferredResult &result)
 	{
 		Q_UNUSED(result);
@@ -2834,8 +5046,26 @@ private slots:
 		AcceptWorker *w = (AcceptWorker *)sender();
 		acceptWorkers.remove(w);
 
-		// try to read again
-		acceptServer_requestReady();
+		// don't read again immediately. workers that complete synchronously
+		//   would chain here into draining the entire accept queue in one
+		//   pass, blocking publish fan-out during re-accept bursts. yield
+		//   to the event loop and refill from the timer instead
+		acceptDrainTimer->start(0);
+	}
+
+	void acceptDrain_timeout()
+	{
+		// refill up to the cap, then return to the event loop. a worker
+		//   that completes synchronously restarts the timer, so the number
+		//   of accepts processed per pass is bounded even then
+		int started = 0;
+		while(acceptWorkers.count() < ACCEPT_WORKERS_MAX && started < ACCEPT_WORKERS_MAX)
+		{
+			if(!startNextAccept())
+				break;
+
+			++started;
+		}
 	}
 
 	void acceptWorker_sessionsReady()
@@ -2843,6 +5073,7 @@ private slots:
 		AcceptWorker *w = (AcceptWorker *)sender();
 
 		QList<HttpSession*> sessions = w->takeSessions();
+		TRACEPOINT2(accept_sessions_ready, w, sessions.count());
 		foreach(HttpSession *hs, sessions)
 		{
 			hs->setParent(this);
@@ -2851,6 +5082,12 @@ private slots:
 			connect(hs, &HttpSession::finished, this, &Private::hs_finished);
 			cs.httpSessions.insert(hs->rid(), hs);
 
+			// snapshot the retained size so the removal matches the
+			//   add even if the session's state changes in between
+			qint64 heldBytes = hs->retainedBytes();
+			sessionHeldBytes.insert(hs, heldBytes);
+			routeBudgets.addConnection(hs->route(), heldBytes);
+
 			hs->start();
 		}
 	}
@@ -2867,7 +5104,7 @@ private slots:
 		Instruct::HoldMode mode = hs->holdMode();
 		assert(mode == Instruct::ResponseHold || mode == Instruct::StreamHold);
 
-		QHash<QString, QSet<HttpSession*> > *sessionsByChannel;
+		QHash<int, QSet<HttpSession*> > *sessionsByChannel;
 		QString modeStr;
 
 		if(mode == Instruct::ResponseHold)
@@ -2885,12 +5122,30 @@ private slots:
 			modeStr = "stream";
 		}
 
-		if(!sessionsByChannel->contains(channel))
-			sessionsByChannel->insert(channel, QSet<HttpSession*>());
+		if(ChannelIndex::isWildcard(channel))
+		{
+			ChannelIndex *wildcards = (mode == Instruct::ResponseHold) ? &cs.responseWildcards : &cs.streamWildcards;
+
+			wildcards->add(channel, hs);
+
+			stats->addSubscription(modeStr, channel, wildcards->count(channel));
+		}
+		else
+		{
+			int cid = cs.channelIntern.id(channel);
+			if(cid < 0 || !sessionsByChannel->contains(cid))
+			{
+				cid = cs.channelIntern.add(channel);
+				sessionsByChannel->insert(cid, QSet<HttpSession*>());
+			}
+
+			(*sessionsByChannel)[cid] += hs;
 
-		(*sessionsByChannel)[channel] += hs;
+			stats->addSubscription(modeStr, channel, sessionsByChannel->value(cid).count());
+		}
+
+		routeBudgets.addSubscription(hs->route());
 
-		stats->addSubscription(modeStr, channel, sessionsByChannel->value(channel).count());
 		addSub(channel);
 
 		QString msg = QString("subscribe %1 channel=%2").arg(hs->requestUri().toString(QUrl::FullyEncoded), channel);
@@ -2898,6 +5153,13 @@ private slots:
 			msg += " retry";
 
 		log_info("%s", qPrintable(msg));
+
+		// catch up from the replay ring first. if the ring covers the
+		//   gap, the last-item cache would only repeat its newest
+		//   entry. either call may complete the hold, so nothing after
+		//   this may touch hs
+		if(!replayCatchUp(hs, channel))
+			deliverLastItem(hs, channel);
 	}
 
 	void hs_unsubscribe(const QString &channel)
@@ -2913,7 +5175,9 @@ private slots:
 
 		RetryRequestPacket rp = hs->retryPacket();
 
+		drainSessions.remove(hs);
 		cs.httpSessions.remove(hs->rid());
+		routeBudgets.removeConnection(hs->route(), sessionHeldBytes.take(hs));
 		delete hs;
 
 		if(!rp.requests.isEmpty())
@@ -2939,6 +5203,15 @@ private slots:
 	{
 		WsSession *s = (WsSession *)sender();
 
+		// if the owning proxy is still alive then so is the session.
+		//   re-arm rather than expiring, so session liveness costs one
+		//   timer event per ttl instead of one control message each
+		if(!s->peer.isEmpty() && wsControlPeers.value(s->peer) > QDateTime::currentMSecsSinceEpoch())
+		{
+			s->refreshExpiration();
+			return;
+		}
+
 		removeWsSession(s);
 	}
 
@@ -2983,9 +5256,12 @@ private slots:
 
 			if(!sidLastIds.isEmpty())
 			{
-				Deferred *d = SessionRequest::updateMany(stateClient, sidLastIds, this);
-				connect(d, &Deferred::finished, this, &Private::sessionUpdateMany_finished);
-				deferreds += d;
+				QHashIterator<QString, LastIds> it(sidLastIds);
+				while(it.hasNext())
+				{
+					it.next();
+					sessionUpdater->update(it.key(), it.value());
+				}
 			}
 		}
 	}
@@ -2997,7 +5273,9 @@ private slots:
 
 		Q_UNUSED(mode);
 
-		if(!cs.responseSessionsByChannel.contains(channel) && !cs.streamSessionsByChannel.contains(channel) && !cs.wsSessionsByChannel.contains(channel))
+		int cid = cs.channelIntern.id(channel);
+
+		if((cid < 0 || (!cs.responseSessionsByChannel.contains(cid) && !cs.streamSessionsByChannel.contains(cid) && !cs.wsSessionsByChannel.contains(cid))) && !cs.responseWildcards.contains(channel) && !cs.streamWildcards.contains(channel) && !cs.wsWildcards.contains(channel))
 			removeSub(channel);
 	}
 
@@ -3014,6 +5292,7 @@ private slots:
 		all.messagesReceived = 0;
 		all.messagesSent = 0;
 		all.httpResponseMessagesSent = 0;
+		all.messagesDropped = 0;
 		foreach(const StatsPacket &p, packets)
 		{
 			all.connectionsMax += p.connectionsMax;
@@ -3021,6 +5300,7 @@ private slots:
 			all.messagesReceived += p.messagesReceived;
 			all.messagesSent += p.messagesSent;
 			all.httpResponseMessagesSent += p.httpResponseMessagesSent;
+			all.messagesDropped += p.messagesDropped;
 		}
 
 		report = ControlRequest::report(proxyControlClient, all, this);
@@ -3062,9 +5342,9 @@ bool Engine::start(const Configuration &config)
 	return d->start(config);
 }
 
-void Engine::reload()
+void Engine::reload(const Configuration &config)
 {
-	d->reload();
+	d->reload(config);
 }
 
 #include "engine.moc"
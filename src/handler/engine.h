@@ -54,12 +54,16 @@ public:
 		QString wsControlInSpec;
 		QString wsControlOutSpec;
 		QString statsSpec;
+		QStringList statsInSpecs;
 		QString commandSpec;
 		QString stateSpec;
 		QString proxyStatsSpec;
 		QString proxyCommandSpec;
-		QString pushInSpec;
+		QStringList pushInSpecs;
 		QString pushInSubSpec;
+		QString pushInBrokerSpec;
+		QString peerOutSpec;
+		QStringList peerInSpecs;
 		QHostAddress pushInHttpAddr;
 		int pushInHttpPort;
 		int ipcFileMode;
@@ -67,12 +71,41 @@ public:
 		int messageRate;
 		int messageHwm;
 		int messageBlockSize;
+		int publishShardSize;
+		int shardId;
+		int shardCount;
+		QStringList priorityChannelPrefixes;
 		int idCacheTtl;
+		QString lastIdsFile;
+		QString publishSpoolFile;
+		qint64 publishSpoolSize;
+		QStringList lastItemChannelPrefixes;
+		QStringList replayChannelPrefixes;
+		int replayItemsMax;
+		qint64 replayBytesMax;
+		int replayItemTtl; // seconds
 		int connectionSubscriptionMax;
+		int routeConnectionsMax;
+		qint64 routeHeldBytesMax;
+		int routeSubscriptionsMax;
+		int publishQueueHwm;
+		int publishQueueLwm;
+		QString publishQueueOverflow;
+		int publishDedupWindow; // msecs. 0 to disable
+		int unsubscribeLinger; // seconds. 0 to disable
+		int unsubscribeLingerMax; // max lingering channels
 		int subscriptionLinger;
 		int statsConnectionTtl;
 		int statsSubscriptionTtl;
 		int statsReportInterval;
+		QString statsFormat; // "tnetstring" or "compact"
+		int zmqHwm;
+		int eventLoopStallThreshold; // msecs. 0 to disable profiling
+		int busyPollIdleTimeout; // msecs. 0 to disable busy-poll mode
+		int expectedConnections; // steady-state hint. 0 for no pre-sizing
+		int expectedChannels; // steady-state hint. 0 for no pre-sizing
+		bool hugePages;
+		bool streamGzip;
 
 		Configuration() :
 			pushInHttpPort(-1),
@@ -81,12 +114,34 @@ public:
 			messageRate(-1),
 			messageHwm(-1),
 			messageBlockSize(-1),
+			publishShardSize(-1),
+			shardId(-1),
+			shardCount(-1),
 			idCacheTtl(-1),
+			publishSpoolSize(-1),
+			replayItemsMax(64),
+			replayBytesMax(262144),
+			replayItemTtl(60),
 			connectionSubscriptionMax(-1),
+			routeConnectionsMax(-1),
+			routeHeldBytesMax(-1),
+			routeSubscriptionsMax(-1),
+			publishQueueHwm(-1),
+			publishQueueLwm(-1),
+			publishDedupWindow(0),
+			unsubscribeLinger(0),
+			unsubscribeLingerMax(10000),
 			subscriptionLinger(-1),
 			statsConnectionTtl(-1),
 			statsSubscriptionTtl(-1),
-			statsReportInterval(-1)
+			statsReportInterval(-1),
+			zmqHwm(-1),
+			eventLoopStallThreshold(0),
+			busyPollIdleTimeout(0),
+			expectedConnections(0),
+			expectedChannels(0),
+			hugePages(false),
+			streamGzip(false)
 		{
 		}
 	};
@@ -95,7 +150,12 @@ public:
 	~Engine();
 
 	bool start(const Configuration &config);
-	void reload();
+
+	// re-apply the fields that are safe to change at runtime: rate
+	//   limits, queue bounds, ttls, stats intervals, and per-session
+	//   options. socket specs, shard layout, and identity fields are
+	//   ignored, and existing subscriptions are untouched
+	void reload(const Configuration &config);
 
 private:
 	class Private;
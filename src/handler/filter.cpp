@@ -28,9 +28,13 @@
 
 #include "filter.h"
 
+#include <QCache>
+#include <QDateTime>
 #include "log.h"
 #include "idformat.h"
 
+#define RATE_LIMIT_BUCKETS_MAX 10000
+
 namespace {
 
 class SkipSelfFilter : public Filter
@@ -97,10 +101,67 @@ public:
 	}
 };
 
+class RateLimitBucket
+{
+public:
+	qint64 tokens; // delivery credit, in thousandths of a message
+	qint64 lastRefill; // unix time, msec
+};
+
+// filter instances are shared across subscribers through the stack
+//   cache, so the buckets are kept in a process-wide table keyed by
+//   subscriber and channel instead of in the instance
+static QCache<QByteArray, RateLimitBucket> g_rateLimitBuckets(RATE_LIMIT_BUCKETS_MAX);
+
+class RateLimitFilter : public Filter
+{
+public:
+	RateLimitFilter() :
+		Filter("rate-limit")
+	{
+	}
+
+	virtual SendAction sendAction() const
+	{
+		int rate = context().subscriptionMeta.value("rate_limit").toInt();
+		if(rate <= 0)
+			return Send;
+
+		if(context().subscriberId.isEmpty())
+			return Send;
+
+		QByteArray key = context().subscriberId + '\n' + context().channel.toUtf8();
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+		qint64 cap = (qint64)rate * 1000;
+
+		RateLimitBucket *b = g_rateLimitBuckets.object(key);
+		if(!b)
+		{
+			b = new RateLimitBucket;
+			b->tokens = cap;
+			b->lastRefill = now;
+			g_rateLimitBuckets.insert(key, b);
+		}
+
+		// refill at the configured rate, allowing at most one second
+		//   of burst
+		b->tokens = qMin(b->tokens + (rate * (now - b->lastRefill)), cap);
+		b->lastRefill = now;
+
+		if(b->tokens < 1000)
+			return Drop;
+
+		b->tokens -= 1000;
+		return Send;
+	}
+};
+
 class BuildIdFilter : public Filter
 {
 public:
 	IdFormat::ContentRenderer *idContentRenderer;
+	QString idFormatSource;
+	IdFormat::Template idFormatTemplate;
 
 	BuildIdFilter() :
 		Filter("build-id"),
@@ -113,6 +174,14 @@ public:
 		delete idContentRenderer;
 	}
 
+	virtual void reset()
+	{
+		delete idContentRenderer;
+		idContentRenderer = 0;
+
+		Filter::reset();
+	}
+
 	bool ensureInit()
 	{
 		if(!idContentRenderer)
@@ -137,7 +206,20 @@ public:
 
 			if(!idTemplateVars.isEmpty())
 			{
-				id = IdFormat::renderId(idFormat.toUtf8(), idTemplateVars, &_error);
+				// the filter instance is reused across deliveries, so
+				//   compile the format only when it changes
+				if(idFormatTemplate.isNull() || idFormat != idFormatSource)
+				{
+					if(!idFormatTemplate.compile(idFormat.toUtf8(), 0, &_error))
+					{
+						setError(QString("failed to render ID: %1").arg(_error));
+						return false;
+					}
+
+					idFormatSource = idFormat;
+				}
+
+				id = idFormatTemplate.renderId(idTemplateVars, &_error);
 				if(id.isNull())
 				{
 					setError(QString("failed to render ID: %1").arg(_error));
@@ -245,6 +327,8 @@ Filter *Filter::create(const QString &name)
 		return new SkipUsersFilter;
 	else if(name == "require-sub")
 		return new RequireSubFilter;
+	else if(name == "rate-limit")
+		return new RateLimitFilter;
 	else if(name == "build-id")
 		return new BuildIdFilter;
 	else
@@ -257,6 +341,7 @@ QStringList Filter::names()
 		<< "skip-self"
 		<< "skip-users"
 		<< "require-sub"
+		<< "rate-limit"
 		<< "build-id");
 }
 
@@ -48,6 +48,12 @@ public:
 		QHash<QString, QString> prevIds;
 		QHash<QString, QString> subscriptionMeta;
 		QHash<QString, QString> publishMeta;
+
+		// identify the receiving subscriber and channel, for filters
+		//   that keep state across deliveries. may be left empty on
+		//   paths that only use content filtering
+		QByteArray subscriberId;
+		QString channel;
 	};
 
 	Filter(const QString &name = QString());
@@ -57,7 +63,11 @@ public:
 	const Context & context() const { return context_; }
 	QString errorMessage() const { return errorMessage_; }
 
-	void setContext(const Context &context) { context_ = context; }
+	virtual void setContext(const Context &context) { context_ = context; }
+
+	// return to a freshly-created state, so the filter can be reused
+	//   for another message
+	virtual void reset() { errorMessage_.clear(); }
 
 	virtual SendAction sendAction() const;
 
@@ -28,6 +28,12 @@
 
 #include "filterstack.h"
 
+#include <QCache>
+
+#define STACK_CACHE_MAX 100
+
+static QCache<QString, FilterStack> g_stackCache(STACK_CACHE_MAX);
+
 FilterStack::FilterStack(const Filter::Context &context, const QStringList &filters)
 {
 	foreach(const QString &name, filters)
@@ -54,6 +60,22 @@ FilterStack::~FilterStack()
 	qDeleteAll(filters_);
 }
 
+void FilterStack::setContext(const Context &context)
+{
+	Filter::setContext(context);
+
+	foreach(Filter *f, filters_)
+		f->setContext(context);
+}
+
+void FilterStack::reset()
+{
+	Filter::reset();
+
+	foreach(Filter *f, filters_)
+		f->reset();
+}
+
 Filter::SendAction FilterStack::sendAction() const
 {
 	foreach(Filter *f, filters_)
@@ -108,3 +130,23 @@ QByteArray FilterStack::finalize()
 
 	return out;
 }
+
+FilterStack *FilterStack::cached(const Filter::Context &context, const QStringList &filters)
+{
+	QString key = filters.join("\n");
+
+	FilterStack *fs = g_stackCache.object(key);
+	if(fs)
+	{
+		fs->reset();
+	}
+	else
+	{
+		fs = new FilterStack(context, filters);
+		g_stackCache.insert(key, fs);
+	}
+
+	fs->setContext(context);
+
+	return fs;
+}
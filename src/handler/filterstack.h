@@ -43,10 +43,18 @@ public:
 	~FilterStack();
 
 	// reimplemented
+	virtual void setContext(const Context &context);
+	virtual void reset();
 	virtual SendAction sendAction() const;
 	virtual QByteArray update(const QByteArray &data);
 	virtual QByteArray finalize();
 
+	// return a shared compiled stack for the given filter list, reset
+	//   and bound to the given context. the stack is owned by a
+	//   process-wide cache, so the caller must not delete it or hold it
+	//   beyond the current event. not thread safe
+	static FilterStack *cached(const Filter::Context &context, const QStringList &filters);
+
 private:
 	QList<Filter*> filters_;
 };
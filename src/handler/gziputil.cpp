@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "gziputil.h"
+
+#include <assert.h>
+#include <string.h>
+#include <zlib.h>
+#include <QByteArray>
+
+namespace GzipUtil {
+
+QByteArray compress(const QByteArray &in)
+{
+	z_stream strm;
+	memset(&strm, 0, sizeof(z_stream));
+
+	// windowBits + 16 selects the gzip wrapper
+	int ret = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+	assert(ret == Z_OK);
+
+	QByteArray out;
+	out.resize((int)deflateBound(&strm, in.size()) + 18); // account for gzip header/trailer
+
+	strm.next_in = (Bytef *)in.data();
+	strm.avail_in = in.size();
+	strm.next_out = (Bytef *)out.data();
+	strm.avail_out = out.size();
+
+	ret = deflate(&strm, Z_FINISH);
+	assert(ret == Z_STREAM_END);
+
+	out.resize(out.size() - strm.avail_out);
+
+	deflateEnd(&strm);
+
+	return out;
+}
+
+}
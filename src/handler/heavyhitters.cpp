@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "heavyhitters.h"
+
+#include <assert.h>
+#include <algorithm>
+#include "stablehash.h"
+
+// per-row hash seeds are spaced by the 64-bit golden ratio, so the rows
+//   act as independent hash functions over the same key
+#define ROW_SEED_BASE 14695981039346656037ULL
+#define ROW_SEED_STEP 0x9e3779b97f4a7c15ULL
+
+HeavyHitters::HeavyHitters(int width, int depth, int maxTop) :
+	width_(width),
+	depth_(depth),
+	maxTop_(maxTop),
+	topMin_(0)
+{
+	assert(width_ > 0 && depth_ > 0 && maxTop_ > 0);
+
+	counts_.fill(0, width_ * depth_);
+}
+
+void HeavyHitters::add(const QString &channel, quint32 count)
+{
+	QByteArray key = channel.toUtf8();
+
+	// bump every row, take the smallest cell as the estimate
+	quint64 est = 0;
+	for(int d = 0; d < depth_; ++d)
+	{
+		quint64 h = stableHash64(key, ROW_SEED_BASE + ((quint64)d * ROW_SEED_STEP));
+		quint32 &cell = counts_[(d * width_) + (int)(h % (quint64)width_)];
+
+		if(cell <= 0xffffffff - count)
+			cell += count;
+		else
+			cell = 0xffffffff;
+
+		if(d == 0 || cell < est)
+			est = cell;
+	}
+
+	if(topCounts_.contains(channel))
+	{
+		// already tracked. topMin_ stays a valid lower bound
+		topCounts_[channel] = est;
+		return;
+	}
+
+	if(topCounts_.count() < maxTop_)
+	{
+		topCounts_.insert(channel, est);
+
+		if(topCounts_.count() == 1 || est < topMin_)
+			topMin_ = est;
+
+		return;
+	}
+
+	if(est <= topMin_)
+		return;
+
+	// evict the smallest tracked entry to make room
+	QHash<QString, quint64>::iterator minIt = topCounts_.begin();
+	QHash<QString, quint64>::iterator it = topCounts_.begin();
+	for(; it != topCounts_.end(); ++it)
+	{
+		if(it.value() < minIt.value())
+			minIt = it;
+	}
+
+	if(est <= minIt.value())
+	{
+		// cached min was stale. refresh it and keep the table as-is
+		topMin_ = minIt.value();
+		return;
+	}
+
+	topCounts_.erase(minIt);
+	topCounts_.insert(channel, est);
+
+	topMin_ = est;
+	for(it = topCounts_.begin(); it != topCounts_.end(); ++it)
+	{
+		if(it.value() < topMin_)
+			topMin_ = it.value();
+	}
+}
+
+void HeavyHitters::decay()
+{
+	for(int n = 0; n < counts_.count(); ++n)
+		counts_[n] >>= 1;
+
+	topMin_ = 0;
+
+	QHash<QString, quint64>::iterator it = topCounts_.begin();
+	while(it != topCounts_.end())
+	{
+		quint64 v = it.value() >> 1;
+		if(v > 0)
+		{
+			it.value() = v;
+
+			if(topMin_ == 0 || v < topMin_)
+				topMin_ = v;
+
+			++it;
+		}
+		else
+			it = topCounts_.erase(it);
+	}
+}
+
+void HeavyHitters::clear()
+{
+	counts_.fill(0, width_ * depth_);
+	topCounts_.clear();
+	topMin_ = 0;
+}
+
+static bool countGreaterThan(const QPair<QString, quint64> &a, const QPair<QString, quint64> &b)
+{
+	if(a.second != b.second)
+		return a.second > b.second;
+
+	return a.first < b.first;
+}
+
+QList<QPair<QString, quint64> > HeavyHitters::top() const
+{
+	QList<QPair<QString, quint64> > out;
+
+	QHash<QString, quint64>::const_iterator it = topCounts_.constBegin();
+	for(; it != topCounts_.constEnd(); ++it)
+		out += qMakePair(it.key(), it.value());
+
+	std::sort(out.begin(), out.end(), countGreaterThan);
+
+	return out;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef HEAVYHITTERS_H
+#define HEAVYHITTERS_H
+
+#include <QString>
+#include <QPair>
+#include <QList>
+#include <QVector>
+#include <QHash>
+
+// approximate top-K channel tracker. counts go into a count-min sketch,
+//   so memory stays fixed no matter how many distinct channels pass
+//   through, and a small exact table follows the current top entries.
+//   estimates can overcount on hash collisions but never undercount.
+//   periodic decay halves everything, making the rankings favor recent
+//   activity
+class HeavyHitters
+{
+public:
+	HeavyHitters(int width = 2048, int depth = 4, int maxTop = 100);
+
+	// count an occurrence of the channel
+	void add(const QString &channel, quint32 count = 1);
+
+	// halve all counts. call periodically to approximate a rate
+	void decay();
+
+	void clear();
+
+	// the current top entries with estimated counts, highest first
+	QList<QPair<QString, quint64> > top() const;
+
+private:
+	int width_;
+	int depth_;
+	int maxTop_;
+	QVector<quint32> counts_;
+	QHash<QString, quint64> topCounts_;
+	quint64 topMin_;
+};
+
+#endif
@@ -35,6 +35,7 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include "log.h"
+#include "tnetstring.h"
 #include "bufferlist.h"
 #include "packet/retryrequestpacket.h"
 #include "zhttpmanager.h"
@@ -46,17 +47,23 @@
 #include "variantutil.h"
 #include "publishitem.h"
 #include "publishformat.h"
+#include "rendercache.h"
+#include "dedupring.h"
 #include "ratelimiter.h"
 #include "publishlastids.h"
 #include "httpsessionupdatemanager.h"
 #include "filterstack.h"
+#include "gziputil.h"
+#include "tracepoints.h"
 
 #define RETRY_TIMEOUT 1000
 #define RETRY_MAX 5
 #define RETRY_RAND_MAX 1000
 #define KEEPALIVE_RAND_MAX 1000
+#define TIMEOUT_RAND_MAX 5000
 #define UPDATES_PER_ACTION_MAX 100
 #define PUBLISH_QUEUE_MAX 100
+#define FIRST_INSTRUCT_CHUNK_MAX 16384
 
 static QByteArray applyBodyPatch(const QByteArray &in, const QVariantList &bodyPatch)
 {
@@ -104,7 +111,60 @@ static QByteArray applyBodyPatch(const QByteArray &in, const QVariantList &bodyP
 	return body;
 }
 
-class HttpSession::Private : public QObject
+static bool acceptsGzip(const HttpHeaders &headers)
+{
+	foreach(const QByteArray &value, headers.getAll("Accept-Encoding"))
+	{
+		foreach(const QByteArray &part, value.split(','))
+		{
+			QByteArray coding = part.trimmed();
+
+			int at = coding.indexOf(';');
+			if(at != -1)
+			{
+				if(coding.mid(at + 1).replace(" ", "") == "q=0")
+					continue;
+
+				coding.truncate(at);
+				coding = coding.trimmed();
+			}
+
+			if(qstricmp(coding.data(), "gzip") == 0)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static QVariant headersToVariant(const HttpHeaders &headers)
+{
+	QVariantList out;
+	foreach(const HttpHeader &h, headers)
+	{
+		QVariantList vheader;
+		vheader += h.first;
+		vheader += h.second;
+		out += QVariant(vheader);
+	}
+
+	return out;
+}
+
+static HttpHeaders variantToHeaders(const QVariant &in)
+{
+	HttpHeaders out;
+	foreach(const QVariant &vheader, in.toList())
+	{
+		QVariantList list = vheader.toList();
+		if(list.count() == 2)
+			out += HttpHeader(list[0].toByteArray(), list[1].toByteArray());
+	}
+
+	return out;
+}
+
+class HttpSession::Private : public QObject, public HttpRequest::Listener
 {
 	Q_OBJECT
 
@@ -156,9 +216,15 @@ public:
 	StatsManager *stats;
 	ZhttpManager *outZhttp;
 	ZhttpRequest *outReq; // for fetching next links
+	ZhttpRequest *prefetchReq; // speculative fetch of the link after outReq
+	QUrl prefetchUri;
+	HttpHeaders prefetchGripLast;
+	bool prefetchHaveData;
 	RateLimiter *updateLimiter;
 	PublishLastIds *publishLastIds;
 	HttpSessionUpdateManager *updateManager;
+	BufferList firstInstructBody; // unfiltered instruct body left to relay
+	FilterStack *firstInstructFilters;
 	BufferList firstInstructResponse;
 	bool haveOutReqHeaders;
 	int sentOutReqData;
@@ -170,19 +236,34 @@ public:
 	Priority needUpdatePriority;
 	UpdateAction *pendingAction;
 	QList<PublishItem> publishQueue;
+	QHash<QString, QString> cachedPrevIds;
+	bool prevIdsDirty;
+	DedupRing dedupRing;
 	RetryRequestPacket retryPacket;
 	LogUtil::Config logConfig;
 	FilterStack *responseFilters;
 	QSet<QString> activeChannels;
 	int connectionSubscriptionMax;
-
-	Private(HttpSession *_q, ZhttpRequest *_req, const HttpSession::AcceptData &_adata, const Instruct &_instruct, ZhttpManager *_outZhttp, StatsManager *_stats, RateLimiter *_updateLimiter, PublishLastIds *_publishLastIds, HttpSessionUpdateManager *_updateManager, int _connectionSubscriptionMax) :
+	int publishQueueHwm; // bytes. -1 means no byte limit
+	int publishQueueLwm;
+	HttpSession::QueueOverflowPolicy publishQueueOverflow;
+	int publishQueueBytes;
+	bool publishQueueBlocked;
+	bool gzipAllowed;
+	bool gzip;
+	QByteArray hibernatedState; // packed idle hold fields. null = live
+	qint64 retainedBodyBytes;
+
+	Private(HttpSession *_q, ZhttpRequest *_req, const HttpSession::AcceptData &_adata, const Instruct &_instruct, ZhttpManager *_outZhttp, StatsManager *_stats, RateLimiter *_updateLimiter, PublishLastIds *_publishLastIds, HttpSessionUpdateManager *_updateManager, int _connectionSubscriptionMax, int _publishQueueHwm, int _publishQueueLwm, HttpSession::QueueOverflowPolicy _publishQueueOverflow, bool _gzipAllowed) :
 		QObject(_q),
 		q(_q),
 		req(_req),
 		stats(_stats),
 		outZhttp(_outZhttp),
 		outReq(0),
+		prefetchReq(0),
+		prefetchHaveData(false),
+		firstInstructFilters(0),
 		updateLimiter(_updateLimiter),
 		publishLastIds(_publishLastIds),
 		updateManager(_updateManager),
@@ -191,13 +272,23 @@ public:
 		retries(0),
 		needUpdate(false),
 		pendingAction(0),
+		prevIdsDirty(true),
 		responseFilters(0),
-		connectionSubscriptionMax(_connectionSubscriptionMax)
+		connectionSubscriptionMax(_connectionSubscriptionMax),
+		publishQueueHwm(_publishQueueHwm),
+		publishQueueLwm(_publishQueueLwm),
+		publishQueueOverflow(_publishQueueOverflow),
+		publishQueueBytes(0),
+		publishQueueBlocked(false),
+		gzipAllowed(_gzipAllowed),
+		gzip(false)
 	{
 		state = NotStarted;
 
 		req->setParent(this);
-		connect(req, &ZhttpRequest::bytesWritten, this, &Private::req_bytesWritten);
+
+		// per-chunk events as direct calls; errors stay on a signal
+		req->setListener(this);
 		connect(req, &ZhttpRequest::error, this, &Private::req_error);
 
 		timer = new QTimer(this);
@@ -210,6 +301,10 @@ public:
 		adata = _adata;
 		instruct = _instruct;
 
+		// snapshot for retainedBytes(), which must stay stable across
+		//   hibernation and the initial body relay
+		retainedBodyBytes = adata.requestData.body.size() + instruct.response.body.size();
+
 		currentUri = req->requestUri();
 
 		if(!instruct.nextLink.isEmpty())
@@ -240,18 +335,22 @@ public:
 
 		// set up implicit channels
 		QPointer<QObject> self = this;
-		foreach(const QString &name, adata.implicitChannels)
+		if(adata.implicitChannels)
 		{
-			if(!channels.contains(name))
+			foreach(const QString &name, *adata.implicitChannels)
 			{
-				Instruct::Channel c;
-				c.name = name;
+				if(!channels.contains(name))
+				{
+					Instruct::Channel c;
+					c.name = name;
 
-				channels.insert(name, c);
+					channels.insert(name, c);
+					prevIdsDirty = true;
 
-				emit q->subscribe(name);
+					emit q->subscribe(name);
 
-				assert(self); // deleting here would leak subscriptions/connections
+					assert(self); // deleting here would leak subscriptions/connections
+				}
 			}
 		}
 
@@ -269,6 +368,18 @@ public:
 			headers.removeAll("Content-Length");
 			if(adata.autoCrossOrigin)
 				Cors::applyCorsHeaders(req->requestHeaders(), &headers);
+
+			// opt into gzip on stream holds when the client accepts it
+			//   and the origin didn't already encode the response. each
+			//   write goes out as a self-contained gzip member, so
+			//   published content can be compressed once per item and
+			//   the same buffer fanned out to every gzip subscriber
+			if(gzipAllowed && instruct.holdMode == Instruct::StreamHold && adata.jsonpCallback.isEmpty() && !headers.contains("Content-Encoding") && acceptsGzip(adata.requestData.headers))
+			{
+				gzip = true;
+				headers += HttpHeader("Content-Encoding", "gzip");
+			}
+
 			req->beginResponse(instruct.response.code, instruct.response.reason, headers);
 
 			if(!instruct.response.body.isEmpty())
@@ -287,18 +398,16 @@ public:
 				Filter::Context fc;
 				fc.subscriptionMeta = instruct.meta;
 
-				FilterStack fs(fc, allFilters);
-				instruct.response.body = fs.process(instruct.response.body);
-				if(instruct.response.body.isNull())
-				{
-					errorMessage = QString("filter error: %1").arg(fs.errorMessage());
-					doError();
-					return;
-				}
+				// filter and relay the body in chunks as the client
+				//   drains, rather than rendering a second full copy
+				//   up front
+				firstInstructFilters = new FilterStack(fc, allFilters);
+
+				firstInstructBody += instruct.response.body;
+				instruct.response.body.clear();
 
 				state = SendingFirstInstructResponse;
 
-				firstInstructResponse += instruct.response.body;
 				tryWriteFirstInstructResponse();
 				return;
 			}
@@ -380,6 +489,50 @@ public:
 		}
 	}
 
+	// filter contexts and render cache keys need a channel->prev-id
+	//   hash per delivery. channels and prev-ids change rarely relative
+	//   to deliveries, so keep the hash assembled and rebuild only
+	//   after a change
+	const QHash<QString, QString> & channelPrevIds()
+	{
+		if(prevIdsDirty)
+		{
+			cachedPrevIds.clear();
+
+			QHashIterator<QString, Instruct::Channel> it(channels);
+			while(it.hasNext())
+			{
+				it.next();
+				const Instruct::Channel &c = it.value();
+				cachedPrevIds[c.name] = c.prevId;
+			}
+
+			prevIdsDirty = false;
+		}
+
+		return cachedPrevIds;
+	}
+
+	// find the subscription entry matching a concrete channel, either
+	//   exact or wildcard prefix
+	QString subscriptionForChannel(const QString &channel) const
+	{
+		if(channels.contains(channel))
+			return channel;
+
+		QHashIterator<QString, Instruct::Channel> it(channels);
+		while(it.hasNext())
+		{
+			it.next();
+			const QString &name = it.key();
+
+			if(name.endsWith('*') && channel.startsWith(name.mid(0, name.length() - 1)))
+				return name;
+		}
+
+		return QString();
+	}
+
 	void publish(const PublishItem &item, const QList<QByteArray> &exposeHeaders)
 	{
 		const PublishFormat &f = item.format;
@@ -391,13 +544,14 @@ public:
 
 			assert(instruct.holdMode == Instruct::ResponseHold);
 
-			if(!channels.contains(item.channel))
+			QString subChannel = subscriptionForChannel(item.channel);
+			if(subChannel.isNull())
 			{
 				log_debug("httpsession: received publish for channel with no subscription, dropping");
 				return;
 			}
 
-			Instruct::Channel &channel = channels[item.channel];
+			Instruct::Channel &channel = channels[subChannel];
 
 			if(!channel.prevId.isNull())
 			{
@@ -411,13 +565,14 @@ public:
 				}
 
 				channel.prevId = item.id;
+				prevIdsDirty = true;
 			}
 
 			if(f.haveContentFilters)
 			{
 				// ensure content filters match
 				QStringList contentFilters;
-				foreach(const QString &f, channels[item.channel].filters)
+				foreach(const QString &f, channels[subChannel].filters)
 				{
 					if(Filter::isContentFilter(f))
 						contentFilters += f;
@@ -430,41 +585,53 @@ public:
 				}
 			}
 
-			QByteArray body;
-			if(f.haveBodyPatch)
-			{
-				body = applyBodyPatch(instruct.response.body, f.bodyPatch);
-			}
-			else
-			{
-				body = f.body;
-			}
-
-			QHash<QString, QString> prevIds;
-			QHashIterator<QString, Instruct::Channel> it(channels);
-			while(it.hasNext())
-			{
-				it.next();
-				const Instruct::Channel &c = it.value();
-				prevIds[c.name] = c.prevId;
-			}
+			const QHash<QString, QString> &prevIds = channelPrevIds();
 
 			Filter::Context fc;
 			fc.prevIds = prevIds;
 			fc.subscriptionMeta = instruct.meta;
 			fc.publishMeta = item.meta;
+			ZhttpRequest::Rid rid = req->rid();
+			fc.subscriberId = rid.first + ':' + rid.second;
+			fc.channel = item.channel;
 
-			FilterStack fs(fc, channels[item.channel].filters);
+			FilterStack *fs = FilterStack::cached(fc, channels[subChannel].filters);
 
-			if(fs.sendAction() == Filter::Drop)
+			if(fs->sendAction() == Filter::Drop)
 				return;
 
-			body = fs.process(body);
-			if(body.isNull())
+			// the held response is needed to render and send
+			rehydrate();
+
+			// body patches apply to this session's own response, but many
+			//   sessions hold identical responses, so patched renders are
+			//   shared by keying on the input body
+			QByteArray cacheKey;
+			if(item.renderCache)
+				cacheKey = RenderCache::makeKey(f.type, channels[subChannel].filters, instruct.meta, prevIds, f.haveBodyPatch ? instruct.response.body : QByteArray());
+
+			QByteArray body;
+			if(!cacheKey.isNull() && item.renderCache->contains(cacheKey))
 			{
-				errorMessage = QString("filter error: %1").arg(fs.errorMessage());
-				doError();
-				return;
+				body = item.renderCache->value(cacheKey);
+			}
+			else
+			{
+				if(f.haveBodyPatch)
+					body = applyBodyPatch(instruct.response.body, f.bodyPatch);
+				else
+					body = f.body;
+
+				body = fs->process(body);
+				if(body.isNull())
+				{
+					errorMessage = QString("filter error: %1").arg(fs->errorMessage());
+					doError();
+					return;
+				}
+
+				if(!cacheKey.isNull())
+					item.renderCache->insert(cacheKey, body);
 			}
 
 			// NOTE: http-response mode doesn't support a close
@@ -483,17 +650,11 @@ public:
 		{
 			if(state == WaitingToUpdate || state == Proxying || state == SendingQueue || state == Holding)
 			{
-				if(publishQueue.count() < PUBLISH_QUEUE_MAX)
+				if(tryQueuePublish(item))
 				{
-					publishQueue += item;
-
 					if(state == Holding)
 						trySendQueue();
 				}
-				else
-				{
-					log_debug("httpsession: publish queue at max, dropping");
-				}
 			}
 		}
 	}
@@ -506,6 +667,12 @@ private:
 		delete outReq;
 		outReq = 0;
 
+		delete prefetchReq;
+		prefetchReq = 0;
+
+		delete firstInstructFilters;
+		firstInstructFilters = 0;
+
 		delete responseFilters;
 		responseFilters = 0;
 	}
@@ -519,6 +686,49 @@ private:
 		}
 	}
 
+	// while holding, the request data and the instruct response sit
+	//   untouched until a wake (response publish, timeout, retry, or
+	//   the next link replacing the instruct). pack them into a single
+	//   buffer for the idle stretch, releasing their heap structures
+	void hibernate()
+	{
+		if(!hibernatedState.isNull())
+			return;
+
+		QVariantHash data;
+		data["req-method"] = adata.requestData.method.toUtf8();
+		data["req-uri"] = adata.requestData.uri.toEncoded();
+		data["req-headers"] = headersToVariant(adata.requestData.headers);
+		data["req-body"] = adata.requestData.body;
+		data["resp-code"] = instruct.response.code;
+		data["resp-reason"] = instruct.response.reason;
+		data["resp-headers"] = headersToVariant(instruct.response.headers);
+		data["resp-body"] = instruct.response.body;
+
+		hibernatedState = TnetString::fromVariant(data);
+
+		adata.requestData = HttpRequestData();
+		instruct.response = HttpResponseData();
+	}
+
+	void rehydrate()
+	{
+		if(hibernatedState.isNull())
+			return;
+
+		QVariantHash data = TnetString::toVariant(hibernatedState).toHash();
+		hibernatedState = QByteArray();
+
+		adata.requestData.method = QString::fromUtf8(data.value("req-method").toByteArray());
+		adata.requestData.uri = QUrl::fromEncoded(data.value("req-uri").toByteArray(), QUrl::StrictMode);
+		adata.requestData.headers = variantToHeaders(data.value("req-headers"));
+		adata.requestData.body = data.value("req-body").toByteArray();
+		instruct.response.code = data.value("resp-code").toInt();
+		instruct.response.reason = data.value("resp-reason").toByteArray();
+		instruct.response.headers = variantToHeaders(data.value("resp-headers"));
+		instruct.response.body = data.value("resp-body").toByteArray();
+	}
+
 	void setupKeepAliveTimer()
 	{
 		if(instruct.keepAliveTimeout >= 0)
@@ -533,21 +743,62 @@ private:
 	{
 		state = Closing;
 
-		publishQueue.clear();
+		publishQueueClear();
 		timer->stop();
 		updateManager->unregisterSession(q);
 	}
 
+	// all per-session body writes funnel through here, so a gzip
+	//   session encodes everything it sends. shared fan-out writes
+	//   compress through the render cache instead (see trySendQueue)
+	void writeBody(const QByteArray &body)
+	{
+		if(gzip && !body.isEmpty())
+			req->writeBody(GzipUtil::compress(body));
+		else
+			req->writeBody(body);
+	}
+
 	void tryWriteFirstInstructResponse()
 	{
 		int avail = req->writeBytesAvailable();
-		if(avail > 0)
+		if(avail <= 0)
+			return;
+
+		// pull more of the body through the filters, but only as much
+		//   as the client can currently accept, so per-session memory
+		//   stays bounded to a window
+		while(firstInstructFilters && firstInstructResponse.size() < avail)
 		{
-			req->writeBody(firstInstructResponse.take(avail));
+			QByteArray buf;
+			bool last = firstInstructBody.isEmpty();
 
-			if(firstInstructResponse.isEmpty())
-				firstInstructResponseDone();
+			if(!last)
+				buf = firstInstructFilters->update(firstInstructBody.take(FIRST_INSTRUCT_CHUNK_MAX));
+			else
+				buf = firstInstructFilters->finalize();
+
+			if(buf.isNull())
+			{
+				errorMessage = QString("filter error: %1").arg(firstInstructFilters->errorMessage());
+				doError();
+				return;
+			}
+
+			firstInstructResponse += buf;
+
+			if(last)
+			{
+				delete firstInstructFilters;
+				firstInstructFilters = 0;
+			}
 		}
+
+		if(!firstInstructResponse.isEmpty())
+			writeBody(firstInstructResponse.take(avail));
+
+		if(!firstInstructFilters && firstInstructResponse.isEmpty())
+			firstInstructResponseDone();
 	}
 
 	void firstInstructResponseDone()
@@ -585,6 +836,14 @@ private:
 	{
 		assert(instruct.holdMode != Instruct::NoHold);
 
+		if(prefetchReq)
+		{
+			// entering a hold. the next link won't be fetched until an
+			//   update triggers, so a prefetched response would go stale
+			delete prefetchReq;
+			prefetchReq = 0;
+		}
+
 		if(instruct.holdMode == Instruct::StreamHold)
 		{
 			// if prev ids used but not next link, error out
@@ -609,7 +868,7 @@ private:
 			it.next();
 			const QString &name = it.key();
 
-			if(adata.implicitChannels.contains(name))
+			if(adata.implicitChannels && adata.implicitChannels->contains(name))
 				continue;
 
 			bool found = false;
@@ -625,6 +884,7 @@ private:
 			{
 				channelsRemoved += name;
 				channels.remove(name);
+				prevIdsDirty = true;
 			}
 		}
 
@@ -644,6 +904,8 @@ private:
 				channels[name].prevId = c.prevId;
 				channels[name].filters = c.filters;
 			}
+
+			prevIdsDirty = true;
 		}
 
 		QPointer<QObject> self = this;
@@ -662,6 +924,8 @@ private:
 			assert(self); // deleting here would leak subscriptions/connections
 		}
 
+		TRACEPOINT2(hold_establish, q, (int)instruct.holdMode);
+
 		if(instruct.holdMode == Instruct::ResponseHold)
 		{
 			state = Holding;
@@ -670,8 +934,17 @@ private:
 			if(instruct.timeout >= 0)
 			{
 				timer->setSingleShot(true);
-				timer->start(instruct.timeout * 1000);
+
+				// spread deadlines so clients that connected together
+				//   don't all expire on the same tick
+				int timeout = instruct.timeout * 1000;
+				if(timeout > TIMEOUT_RAND_MAX * 2)
+					timeout -= qrand() % TIMEOUT_RAND_MAX;
+
+				timer->start(timeout);
 			}
+
+			hibernate();
 		}
 		else // StreamHold
 		{
@@ -716,19 +989,20 @@ private:
 			{
 				PublishItem &item = publishQueue.first();
 
-				if(!channels.contains(item.channel))
+				QString subChannel = subscriptionForChannel(item.channel);
+				if(subChannel.isNull())
 				{
 					// we don't care about this channel anymore
-					publishQueue.removeFirst();
+					publishQueueTakeFirst();
 					continue;
 				}
 
-				Instruct::Channel &channel = channels[item.channel];
+				Instruct::Channel &channel = channels[subChannel];
 
 				if(!channel.prevId.isNull() && channel.prevId != item.prevId)
 				{
 					// item doesn't follow the hold
-					publishQueue.removeFirst();
+					publishQueueTakeFirst();
 					continue;
 				}
 
@@ -747,21 +1021,98 @@ private:
 		}
 	}
 
+	bool queueOverHwm(int incomingBytes) const
+	{
+		if(publishQueue.count() >= PUBLISH_QUEUE_MAX)
+			return true;
+
+		return (publishQueueHwm >= 0 && publishQueueBytes + incomingBytes > publishQueueHwm);
+	}
+
+	bool tryQueuePublish(const PublishItem &item)
+	{
+		int bytes = item.format.body.size();
+
+		if(publishQueueBlocked && publishQueueBytes <= publishQueueLwm && publishQueue.count() < PUBLISH_QUEUE_MAX)
+			publishQueueBlocked = false;
+
+		if(publishQueueBlocked || queueOverHwm(bytes))
+		{
+			if(publishQueueOverflow == HttpSession::QueueDropOldest)
+			{
+				// make room at the head. the client is behind anyway, and
+				//   newer data supersedes older
+				int dropped = 0;
+				while(!publishQueue.isEmpty() && queueOverHwm(bytes))
+				{
+					publishQueueTakeFirst();
+					++dropped;
+				}
+
+				if(dropped > 0)
+				{
+					log_debug("httpsession: publish queue over hwm, dropped %d oldest", dropped);
+					stats->addMessageDropped(adata.route.toUtf8(), dropped);
+				}
+			}
+			else if(publishQueueOverflow == HttpSession::QueueDisconnect)
+			{
+				log_warning("httpsession: publish queue over hwm, closing slow connection");
+				stats->addMessageDropped(adata.route.toUtf8());
+
+				errorMessage = "connection too slow to keep up with channel";
+				doError();
+				return false;
+			}
+			else // QueueDropNewest
+			{
+				// hold off until the queue drains below the low watermark,
+				//   so a session at the boundary doesn't flap
+				publishQueueBlocked = true;
+
+				log_debug("httpsession: publish queue over hwm, dropping");
+				stats->addMessageDropped(adata.route.toUtf8());
+				return false;
+			}
+		}
+
+		publishQueue += item;
+		publishQueueBytes += bytes;
+
+		return true;
+	}
+
+	PublishItem publishQueueTakeFirst()
+	{
+		PublishItem item = publishQueue.takeFirst();
+		publishQueueBytes -= item.format.body.size();
+
+		return item;
+	}
+
+	void publishQueueClear()
+	{
+		publishQueue.clear();
+		publishQueueBytes = 0;
+		publishQueueBlocked = false;
+	}
+
 	void trySendQueue()
 	{
 		assert(instruct.holdMode == Instruct::StreamHold);
 
 		while(!publishQueue.isEmpty() && req->writeBytesAvailable() > 0)
 		{
-			PublishItem item = publishQueue.takeFirst();
+			PublishItem item = publishQueueTakeFirst();
 
-			if(!channels.contains(item.channel))
+			QString subChannel = subscriptionForChannel(item.channel);
+			if(subChannel.isNull())
 			{
 				log_debug("httpsession: received publish for channel with no subscription, dropping");
 				continue;
 			}
 
-			Instruct::Channel &channel = channels[item.channel];
+			Instruct::Channel &channel = channels[subChannel];
 
 			if(!channel.prevId.isNull())
 			{
@@ -770,13 +1121,14 @@ private:
 					log_debug("last ID inconsistency (got=%s, expected=%s), retrying", qPrintable(item.prevId), qPrintable(channel.prevId));
 					publishLastIds->remove(item.channel);
 
-					publishQueue.clear();
+					publishQueueClear();
 
 					update(LowPriority);
 					break;
 				}
 
 				channel.prevId = item.id;
+				prevIdsDirty = true;
 			}
 
 			PublishFormat &f = item.format;
@@ -785,7 +1137,7 @@ private:
 			{
 				// ensure content filters match
 				QStringList contentFilters;
-				foreach(const QString &f, channels[item.channel].filters)
+				foreach(const QString &f, channels[subChannel].filters)
 				{
 					if(Filter::isContentFilter(f))
 						contentFilters += f;
@@ -798,36 +1150,73 @@ private:
 				}
 			}
 
-			QHash<QString, QString> prevIds;
-			QHashIterator<QString, Instruct::Channel> it(channels);
-			while(it.hasNext())
-			{
-				it.next();
-				const Instruct::Channel &c = it.value();
-				prevIds[c.name] = c.prevId;
-			}
+			const QHash<QString, QString> &prevIds = channelPrevIds();
 
 			Filter::Context fc;
 			fc.prevIds = prevIds;
 			fc.subscriptionMeta = instruct.meta;
 			fc.publishMeta = item.meta;
+			ZhttpRequest::Rid rid = req->rid();
+			fc.subscriberId = rid.first + ':' + rid.second;
+			fc.channel = item.channel;
 
-			FilterStack fs(fc, channels[item.channel].filters);
+			FilterStack *fs = FilterStack::cached(fc, channels[subChannel].filters);
 
-			if(fs.sendAction() == Filter::Drop)
+			if(fs->sendAction() == Filter::Drop)
 				continue;
 
 			if(f.action == PublishFormat::Send)
 			{
-				QByteArray body = fs.process(f.body);
-				if(body.isNull())
+				QByteArray body;
+
+				QByteArray cacheKey;
+				if(item.renderCache)
+					cacheKey = RenderCache::makeKey(f.type, channels[subChannel].filters, instruct.meta, prevIds);
+
+				if(!cacheKey.isNull() && item.renderCache->contains(cacheKey))
 				{
-					errorMessage = QString("filter error: %1").arg(fs.errorMessage());
-					doError();
-					break;
+					body = item.renderCache->value(cacheKey);
 				}
+				else
+				{
+					body = fs->process(f.body);
+					if(body.isNull())
+					{
+						errorMessage = QString("filter error: %1").arg(fs->errorMessage());
+						doError();
+						break;
+					}
 
-				req->writeBody(body);
+					if(!cacheKey.isNull())
+						item.renderCache->insert(cacheKey, body);
+				}
+
+				if(gzip)
+				{
+					// compress once per render and share the result via
+					//   the item's render cache, so the cpu cost is per
+					//   publish rather than per subscriber
+					QByteArray gzKey;
+					if(!cacheKey.isNull())
+						gzKey = cacheKey + ".gz";
+
+					QByteArray gzBody;
+					if(!gzKey.isNull() && item.renderCache->contains(gzKey))
+					{
+						gzBody = item.renderCache->value(gzKey);
+					}
+					else
+					{
+						gzBody = GzipUtil::compress(body);
+
+						if(!gzKey.isNull())
+							item.renderCache->insert(gzKey, gzBody);
+					}
+
+					req->writeBody(gzBody);
+				}
+				else
+					req->writeBody(body);
 
 				// restart keep alive timer
 				setupKeepAliveTimer();
@@ -839,14 +1228,14 @@ private:
 					{
 						activeChannels.clear();
 
-						updateManager->registerSession(q, instruct.nextLinkTimeout, nextUri);
+						updateManager->registerSession(q, instruct.nextLinkTimeout);
 					}
 				}
 			}
 			else if(f.action == PublishFormat::Hint)
 			{
 				// clear queue since any items will be redundant
-				publishQueue.clear();
+				publishQueueClear();
 
 				update(HighPriority);
 				break;
@@ -886,7 +1275,9 @@ private:
 			setupKeepAliveTimer();
 
 		if(!nextUri.isEmpty() && instruct.nextLinkTimeout >= 0)
-			updateManager->registerSession(q, instruct.nextLinkTimeout, nextUri);
+			updateManager->registerSession(q, instruct.nextLinkTimeout);
+
+		hibernate();
 
 		if(needUpdate)
 			update(needUpdatePriority);
@@ -1040,6 +1431,9 @@ private:
 
 		if(retry)
 		{
+			// the retry packet carries the original request data
+			rehydrate();
+
 			// refresh before remove, to ensure transition
 			stats->refreshConnection(cid);
 			stats->removeConnection(cid, true);
@@ -1107,37 +1501,37 @@ private:
 		emit q->finished();
 	}
 
-	void requestNextLink()
+	HttpHeaders gripLastHeaders() const
 	{
-		log_debug("httpsession: next: %s", qPrintable(instruct.nextLink.toString()));
+		HttpHeaders headers;
 
-		if(!outZhttp)
+		foreach(const Instruct::Channel &c, channels.values())
 		{
-			errorMessage = "Instruct contained link, but handler not configured for outbound requests.";
-			QMetaObject::invokeMethod(this, "doError", Qt::QueuedConnection);
-			return;
+			if(!c.prevId.isNull())
+				headers += HttpHeader("Grip-Last", c.name.toUtf8() + "; last-id=" + c.prevId.toUtf8());
 		}
 
-		haveOutReqHeaders = false;
-		sentOutReqData = 0;
+		return headers;
+	}
 
-		outReq = outZhttp->createRequest();
-		outReq->setParent(this);
-		connect(outReq, &ZhttpRequest::readyRead, this, &Private::outReq_readyRead);
-		connect(outReq, &ZhttpRequest::error, this, &Private::outReq_error);
+	ZhttpRequest *startLinkRequest(const QUrl &uri, const QUrl &baseUri, const HttpHeaders &headers)
+	{
+		ZhttpRequest *r = outZhttp->createRequest();
+		r->setParent(this);
+		r->setListener(this);
 
-		int currentPort = currentUri.port(currentUri.scheme() == "https" ? 443 : 80);
-		int nextPort = nextUri.port(currentUri.scheme() == "https" ? 443 : 80);
+		int basePort = baseUri.port(baseUri.scheme() == "https" ? 443 : 80);
+		int port = uri.port(baseUri.scheme() == "https" ? 443 : 80);
 
 		QVariantHash passthroughData;
 
-		// if next link points to the same service as the current request,
-		//   then we can assume the network would send the request back to
-		//   us, so we can handle it internally. if the link points to a
-		//   different service, then we can't make this assumption and need
-		//   to make the request over the network. note that such a request
-		//   could still end up looping back to us
-		if(nextUri.scheme() == currentUri.scheme() && nextUri.host() == currentUri.host() && nextPort == currentPort)
+		// if the link points to the same service as the request that
+		//   produced it, then we can assume the network would send the
+		//   request back to us, so we can handle it internally. if the
+		//   link points to a different service, then we can't make this
+		//   assumption and need to make the request over the network.
+		//   note that such a request could still end up looping back
+		if(uri.scheme() == baseUri.scheme() && uri.host() == baseUri.host() && port == basePort)
 		{
 			// use proxy routing
 			passthroughData["route"] = true;
@@ -1157,17 +1551,99 @@ private:
 		// share requests to the same URI
 		passthroughData["auto-share"] = true;
 
-		outReq->setPassthroughData(passthroughData);
+		r->setPassthroughData(passthroughData);
 
-		HttpHeaders headers;
-		foreach(const Instruct::Channel &c, channels.values())
+		r->start("GET", uri, headers);
+		r->endBody();
+
+		return r;
+	}
+
+	void requestNextLink()
+	{
+		log_debug("httpsession: next: %s", qPrintable(instruct.nextLink.toString()));
+
+		if(!outZhttp)
 		{
-			if(!c.prevId.isNull())
-				headers += HttpHeader("Grip-Last", c.name.toUtf8() + "; last-id=" + c.prevId.toUtf8());
+			errorMessage = "Instruct contained link, but handler not configured for outbound requests.";
+			QMetaObject::invokeMethod(this, "doError", Qt::QueuedConnection);
+			return;
+		}
+
+		haveOutReqHeaders = false;
+		sentOutReqData = 0;
+
+		if(prefetchReq)
+		{
+			// adopt the prefetched request if it matches what we'd send
+			if(prefetchUri == nextUri && prefetchGripLast == gripLastHeaders())
+			{
+				log_debug("httpsession: next link already in flight");
+
+				outReq = prefetchReq;
+				prefetchReq = 0;
+
+				disconnect(outReq, &ZhttpRequest::error, this, &Private::prefetchReq_error);
+				connect(outReq, &ZhttpRequest::error, this, &Private::outReq_error);
+
+				// data that arrived before adoption is buffered in the
+				//   request and won't produce another event. pick it up
+				if(prefetchHaveData)
+					QMetaObject::invokeMethod(this, "outReq_readyRead", Qt::QueuedConnection);
+
+				return;
+			}
+
+			// the prefetch went stale. throw it away
+			delete prefetchReq;
+			prefetchReq = 0;
+		}
+
+		outReq = startLinkRequest(nextUri, currentUri, gripLastHeaders());
+		connect(outReq, &ZhttpRequest::error, this, &Private::outReq_error);
+	}
+
+	void maybeStartPrefetch()
+	{
+		if(prefetchReq || !outZhttp || state != Proxying)
+			return;
+
+		HttpHeaders headers = outReq->responseHeaders();
+
+		// a hold means the link after this one won't be fetched until
+		//   an update triggers, possibly much later, so only plain
+		//   continuation responses are worth prefetching
+		if(outReq->responseCode() < 200 || outReq->responseCode() >= 300 || headers.contains("Grip-Hold"))
+			return;
+
+		QUrl link;
+		foreach(const HttpHeaderParameters &params, headers.getAllAsParameters("Grip-Link"))
+		{
+			if(params.count() >= 2 && params.get("rel") == "next")
+			{
+				QByteArray linkParam = params[0].first;
+				if(linkParam.length() <= 2 || linkParam[0] != '<' || linkParam[linkParam.length() - 1] != '>')
+					return; // malformed. let the full parse report it
+
+				link = QUrl::fromEncoded(linkParam.mid(1, linkParam.length() - 2));
+				break;
+			}
 		}
 
-		outReq->start("GET", nextUri, headers);
-		outReq->endBody();
+		if(link.isEmpty() || !link.isValid())
+			return;
+
+		// start fetching the following segment while the current one
+		//   drains to the client, overlapping origin latency with
+		//   delivery
+		prefetchUri = nextUri.resolved(link);
+		prefetchGripLast = gripLastHeaders();
+		prefetchHaveData = false;
+
+		log_debug("httpsession: prefetching next link: %s", prefetchUri.toEncoded().data());
+
+		prefetchReq = startLinkRequest(prefetchUri, nextUri, prefetchGripLast);
+		connect(prefetchReq, &ZhttpRequest::error, this, &Private::prefetchReq_error);
 	}
 
 	void tryProcessOutReq()
@@ -1208,7 +1684,7 @@ private:
 					}
 				}
 
-				req->writeBody(buf);
+				writeBody(buf);
 
 				sentOutReqData += buf.size();
 			}
@@ -1232,7 +1708,7 @@ private:
 
 					if(!buf.isEmpty())
 					{
-						req->writeBody(buf);
+						writeBody(buf);
 
 						sentOutReqData += buf.size();
 					}
@@ -1266,6 +1742,10 @@ private:
 					return;
 				}
 
+				// unpack before replacing the instruct, so the request
+				//   data survives. the old response is superseded
+				rehydrate();
+
 				instruct = i;
 
 				currentUri = nextUri;
@@ -1342,6 +1822,28 @@ private:
 		LogUtil::logRequest(LOG_LEVEL_INFO, rd, logConfig);
 	}
 
+	// HttpRequest::Listener
+	//
+	// per-chunk events from the client request and the next link
+	//   request arrive here as direct calls, bypassing signal dispatch
+	virtual void requestReadyRead(HttpRequest *hreq)
+	{
+		if(hreq == outReq)
+			outReq_readyRead();
+		else if(hreq == prefetchReq)
+		{
+			// data accumulates in the request until adoption. flow
+			//   control keeps the buffering bounded
+			prefetchHaveData = true;
+		}
+	}
+
+	virtual void requestBytesWritten(HttpRequest *hreq, int count)
+	{
+		if(hreq == req)
+			req_bytesWritten(count);
+	}
+
 private slots:
 	void doError()
 	{
@@ -1363,7 +1865,7 @@ private slots:
 			prepareToClose();
 
 			if(adata.debug)
-				req->writeBody("\n\n" + errorMessage.toUtf8() + '\n');
+				writeBody("\n\n" + errorMessage.toUtf8() + '\n');
 
 			req->endBody();
 		}
@@ -1424,6 +1926,8 @@ private slots:
 			fc.subscriptionMeta = instruct.meta;
 
 			responseFilters = new FilterStack(fc, allFilters);
+
+			maybeStartPrefetch();
 		}
 
 		tryProcessOutReq();
@@ -1464,16 +1968,28 @@ private slots:
 		}
 	}
 
+	void prefetchReq_error()
+	{
+		// the prefetch is speculative, so failure isn't an error.
+		//   drop it and let the normal fetch path retry from scratch
+		log_debug("httpsession: prefetch of next link failed");
+
+		delete prefetchReq;
+		prefetchReq = 0;
+	}
+
 	void timer_timeout()
 	{
 		if(instruct.holdMode == Instruct::ResponseHold)
 		{
+			rehydrate();
+
 			// send timeout response
 			respond(instruct.response.code, instruct.response.reason, instruct.response.headers, instruct.response.body);
 		}
 		else if(instruct.holdMode == Instruct::StreamHold)
 		{
-			req->writeBody(instruct.keepAliveData);
+			writeBody(instruct.keepAliveData);
 
 			stats->addActivity(adata.route.toUtf8(), 1);
 		}
@@ -1485,10 +2001,10 @@ private slots:
 	}
 };
 
-HttpSession::HttpSession(ZhttpRequest *req, const HttpSession::AcceptData &adata, const Instruct &instruct, ZhttpManager *zhttpOut, StatsManager *stats, RateLimiter *updateLimiter, PublishLastIds *publishLastIds, HttpSessionUpdateManager *updateManager, int connectionSubscriptionMax, QObject *parent) :
+HttpSession::HttpSession(ZhttpRequest *req, const HttpSession::AcceptData &adata, const Instruct &instruct, ZhttpManager *zhttpOut, StatsManager *stats, RateLimiter *updateLimiter, PublishLastIds *publishLastIds, HttpSessionUpdateManager *updateManager, int connectionSubscriptionMax, int publishQueueHwm, int publishQueueLwm, QueueOverflowPolicy publishQueueOverflow, bool gzipAllowed, QObject *parent) :
 	QObject(parent)
 {
-	d = new Private(this, req, adata, instruct, zhttpOut, stats, updateLimiter, publishLastIds, updateManager, connectionSubscriptionMax);
+	d = new Private(this, req, adata, instruct, zhttpOut, stats, updateLimiter, publishLastIds, updateManager, connectionSubscriptionMax, publishQueueHwm, publishQueueLwm, publishQueueOverflow, gzipAllowed);
 }
 
 HttpSession::~HttpSession()
@@ -1547,6 +2063,16 @@ RetryRequestPacket HttpSession::retryPacket() const
 	return d->retryPacket;
 }
 
+qint64 HttpSession::retainedBytes() const
+{
+	return d->retainedBodyBytes;
+}
+
+bool HttpSession::recentlyDelivered(quint64 contentHash, qint64 now, int window)
+{
+	return d->dedupRing.checkUpdate(contentHash, now, window);
+}
+
 void HttpSession::start()
 {
 	d->start();
@@ -1557,6 +2083,13 @@ void HttpSession::update()
 	d->update(Private::LowPriority);
 }
 
+void HttpSession::finishForRetry()
+{
+	assert(d->instruct.holdMode == Instruct::ResponseHold);
+
+	d->update(Private::HighPriority);
+}
+
 void HttpSession::publish(const PublishItem &item, const QList<QByteArray> &exposeHeaders)
 {
 	d->publish(item, exposeHeaders);
@@ -30,6 +30,7 @@
 #define HTTPSESSION_H
 
 #include <QObject>
+#include <QSharedPointer>
 #include "packet/httprequestdata.h"
 #include "packet/httpresponsedata.h"
 #include "inspectdata.h"
@@ -50,6 +51,15 @@ class HttpSession : public QObject
 	Q_OBJECT
 
 public:
+	// what to do with incoming publishes when a session's send queue is
+	//   over its high watermark
+	enum QueueOverflowPolicy
+	{
+		QueueDropNewest, // drop incoming items until below the low watermark
+		QueueDropOldest, // evict from the head to make room
+		QueueDisconnect  // error out the session
+	};
+
 	class AcceptData
 	{
 	public:
@@ -62,7 +72,7 @@ public:
 		HttpRequestData requestData;
 		QString route;
 		QString channelPrefix;
-		QSet<QString> implicitChannels;
+		QSharedPointer<QSet<QString> > implicitChannels; // shared across sessions of a route. may be null
 		QByteArray sigIss;
 		QByteArray sigKey;
 		bool trusted;
@@ -83,7 +93,7 @@ public:
 		}
 	};
 
-	HttpSession(ZhttpRequest *req, const HttpSession::AcceptData &adata, const Instruct &instruct, ZhttpManager *outZhttp, StatsManager *stats, RateLimiter *updateLimiter, PublishLastIds *publishLastIds, HttpSessionUpdateManager *updateManager, int connectionSubscriptionMax, QObject *parent = 0);
+	HttpSession(ZhttpRequest *req, const HttpSession::AcceptData &adata, const Instruct &instruct, ZhttpManager *outZhttp, StatsManager *stats, RateLimiter *updateLimiter, PublishLastIds *publishLastIds, HttpSessionUpdateManager *updateManager, int connectionSubscriptionMax, int publishQueueHwm, int publishQueueLwm, QueueOverflowPolicy publishQueueOverflow, bool gzipAllowed, QObject *parent = 0);
 	~HttpSession();
 
 	Instruct::HoldMode holdMode() const;
@@ -96,10 +106,22 @@ public:
 	QHash<QString, QString> meta() const;
 	RetryRequestPacket retryPacket() const;
 
+	// bytes of request and response body the session retains for its
+	//   lifetime, for per-route accounting
+	qint64 retainedBytes() const;
+
+	// if the content hash was delivered within the window (msecs) then
+	//   return true, else record it and return false
+	bool recentlyDelivered(quint64 contentHash, qint64 now, int window);
+
 	void start();
 	void update();
 	void publish(const PublishItem &item, const QList<QByteArray> &exposeHeaders = QList<QByteArray>());
 
+	// finish the session and produce a retry packet, so the proxy can
+	//   hand the request to another instance. response holds only
+	void finishForRetry();
+
 signals:
 	void subscribe(const QString &channel);
 	void unsubscribe(const QString &channel);
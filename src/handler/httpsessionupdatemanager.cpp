@@ -29,7 +29,6 @@
 #include "httpsessionupdatemanager.h"
 
 #include <QTimer>
-#include <QUrl>
 #include "httpsession.h"
 
 class HttpSessionUpdateManager::Private : public QObject
@@ -40,14 +39,14 @@ public:
 	class Bucket
 	{
 	public:
-		QPair<int, QUrl> key;
+		int timeout;
 		QSet<HttpSession*> sessions;
 		QSet<HttpSession*> deferredSessions;
 		QTimer *timer;
 	};
 
 	HttpSessionUpdateManager *q;
-	QHash<QPair<int, QUrl>, Bucket*> buckets;
+	QHash<int, Bucket*> buckets;
 	QHash<QTimer*, Bucket*> bucketsByTimer;
 	QHash<HttpSession*, Bucket*> bucketsBySession;
 
@@ -59,7 +58,7 @@ public:
 
 	~Private()
 	{
-		QHashIterator<QPair<int, QUrl>, Bucket*> it(buckets);
+		QHashIterator<int, Bucket*> it(buckets);
 		while(it.hasNext())
 		{
 			it.next();
@@ -78,7 +77,7 @@ public:
 			bucketsBySession.remove(hs);
 
 		bucketsByTimer.remove(bucket->timer);
-		buckets.remove(bucket->key);
+		buckets.remove(bucket->timeout);
 
 		bucket->timer->disconnect(this);
 		bucket->timer->setParent(0);
@@ -86,28 +85,23 @@ public:
 		delete bucket;
 	}
 
-	void registerSession(HttpSession *hs, int timeout, const QUrl &uri)
+	void registerSession(HttpSession *hs, int timeout)
 	{
-		QUrl tmp = uri;
-		tmp.setQuery(QString()); // remove the query part
-		QPair<int, QUrl> key(timeout, tmp);
-
-		Bucket *bucket = buckets.value(key);
+		Bucket *bucket = buckets.value(timeout);
 		if(bucket)
 		{
-			if(bucket->sessions.contains(hs))
-			{
-				// if the session is already in this bucket, flag it
-				//   for later processing
-				bucket->deferredSessions += hs;
-			}
-			else
+			if(!bucket->sessions.contains(hs))
 			{
 				// move the session to this bucket
 				unregisterSession(hs);
 				bucket->sessions += hs;
 				bucketsBySession[hs] = bucket;
 			}
+
+			// sit out the in-progress interval, so a session never
+			//   waits less than its requested interval between
+			//   registration and update
+			bucket->deferredSessions += hs;
 		}
 		else
 		{
@@ -116,12 +110,12 @@ public:
 			unregisterSession(hs);
 
 			bucket = new Bucket;
-			bucket->key = key;
+			bucket->timeout = timeout;
 			bucket->sessions += hs;
 			bucket->timer = new QTimer(this);
 			connect(bucket->timer, &QTimer::timeout, this, &Private::timer_timeout);
 
-			buckets[key] = bucket;
+			buckets[timeout] = bucket;
 			bucketsByTimer[bucket->timer] = bucket;
 			bucketsBySession[hs] = bucket;
 
@@ -190,9 +184,9 @@ HttpSessionUpdateManager::~HttpSessionUpdateManager()
 	delete d;
 }
 
-void HttpSessionUpdateManager::registerSession(HttpSession *hs, int timeout, const QUrl &uri)
+void HttpSessionUpdateManager::registerSession(HttpSession *hs, int timeout)
 {
-	d->registerSession(hs, timeout, uri);
+	d->registerSession(hs, timeout);
 }
 
 void HttpSessionUpdateManager::unregisterSession(HttpSession *hs)
@@ -31,16 +31,19 @@
 
 #include <QObject>
 
-class QUrl;
 class HttpSession;
 
+// schedules next-link updates. sessions sharing an interval share one
+//   timer, so the loop wakes once per interval regardless of session
+//   count. updates fire between one and two intervals after
+//   registration, never sooner than one
 class HttpSessionUpdateManager : public QObject
 {
 public:
 	HttpSessionUpdateManager(QObject *parent = 0);
 	~HttpSessionUpdateManager();
 
-	void registerSession(HttpSession *hs, int timeout, const QUrl &uri);
+	void registerSession(HttpSession *hs, int timeout);
 	void unregisterSession(HttpSession *hs);
 
 private:
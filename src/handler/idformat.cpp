@@ -29,6 +29,10 @@
 #include "idformat.h"
 
 #include <ctype.h>
+#include <QCache>
+
+// total bytes of compiled content templates to retain
+#define CONTENT_TEMPLATE_CACHE_MAX 1000000
 
 namespace IdFormat {
 
@@ -41,9 +45,23 @@ public:
 	virtual QByteArray handle(char type, const QByteArray &arg, QString *error) const = 0;
 };
 
-static QByteArray processFormat(const QByteArray &format, FormatHandler *handler, int *partialPos = 0, QString *error = 0)
+Template::Template() :
+	literalSize_(0),
+	compiled_(false)
 {
-	QByteArray out("");
+}
+
+bool Template::compile(const QByteArray &format, int *partialPos, QString *error)
+{
+	segments_.clear();
+	literalSize_ = 0;
+	compiled_ = false;
+
+	QByteArray literal("");
+
+	if(partialPos)
+		*partialPos = format.length();
+
 	for(int n = 0; n < format.length(); ++n)
 	{
 		char c = format.at(n);
@@ -57,13 +75,13 @@ static QByteArray processFormat(const QByteArray &format, FormatHandler *handler
 				if(partialPos)
 				{
 					*partialPos = markerPos;
-					return out;
+					break;
 				}
 				else
 				{
 					if(error)
 						*error = QString("Expected directive after '%' at position %1").arg(n);
-					return QByteArray();
+					return false;
 				}
 			}
 
@@ -79,13 +97,13 @@ static QByteArray processFormat(const QByteArray &format, FormatHandler *handler
 					if(partialPos)
 					{
 						*partialPos = markerPos;
-						return out;
+						break;
 					}
 					else
 					{
 						if(error)
 							*error = QString("Expected character after '(' at position %1").arg(n);
-						return QByteArray();
+						return false;
 					}
 				}
 
@@ -95,6 +113,7 @@ static QByteArray processFormat(const QByteArray &format, FormatHandler *handler
 
 				// scan for ')'
 				bool ok = false;
+				bool partial = false;
 				for(; n < format.length(); ++n)
 				{
 					c = format.at(n);
@@ -106,13 +125,14 @@ static QByteArray processFormat(const QByteArray &format, FormatHandler *handler
 							if(partialPos)
 							{
 								*partialPos = markerPos;
-								return out;
+								partial = true;
+								break;
 							}
 							else
 							{
 								if(error)
 									*error = QString("Expected character after '\\' at position %1").arg(n);
-								return QByteArray();
+								return false;
 							}
 						}
 
@@ -131,18 +151,20 @@ static QByteArray processFormat(const QByteArray &format, FormatHandler *handler
 						arg += c;
 					}
 				}
+				if(partial)
+					break;
 				if(!ok)
 				{
 					if(partialPos)
 					{
 						*partialPos = markerPos;
-						return out;
+						break;
 					}
 					else
 					{
 						if(error)
 							*error = QString("Unterminated field starting at position %1").arg(fieldStart);
-						return QByteArray();
+						return false;
 					}
 				}
 
@@ -151,62 +173,104 @@ static QByteArray processFormat(const QByteArray &format, FormatHandler *handler
 					if(partialPos)
 					{
 						*partialPos = markerPos;
-						return out;
+						break;
 					}
 					else
 					{
 						if(error)
 							*error = QString("Expected directive after ')' at position %1").arg(n);
-						return QByteArray();
+						return false;
 					}
 				}
 
 				++n;
 				c = format.at(n);
 
-				QString _error;
-				QByteArray result = handler->handle(c, arg, &_error);
-				if(result.isNull())
+				if(!literal.isEmpty())
 				{
-					if(error)
-						*error = QString("%1 at position %2").arg(_error, QString::number(n));
-					return QByteArray();
+					Segment s;
+					s.literal = literal;
+					segments_ += s;
+					literal = QByteArray("");
 				}
 
-				out += result;
+				Segment s;
+				s.directive = c;
+				s.arg = arg;
+				s.pos = n;
+				segments_ += s;
 			}
 			else if(c == '%')
 			{
-				out += c;
+				literal += c;
 			}
 			else if(isalpha(c))
 			{
-				QString _error;
-				QByteArray result = handler->handle(c, QByteArray(), &_error);
-				if(result.isNull())
+				if(!literal.isEmpty())
 				{
-					if(error)
-						*error = QString("%1 at position %2").arg(_error, QString::number(n));
-					return QByteArray();
+					Segment s;
+					s.literal = literal;
+					segments_ += s;
+					literal = QByteArray("");
 				}
 
-				out += result;
+				Segment s;
+				s.directive = c;
+				s.pos = n;
+				segments_ += s;
 			}
 			else
 			{
 				if(error)
 					*error = QString("Unknown directive '%1' at position %2").arg(QString(c), QString::number(n));
-				return QByteArray();
+				return false;
 			}
 		}
 		else
 		{
-			out += c;
+			literal += c;
 		}
 	}
 
-	if(partialPos)
-		*partialPos = format.length();
+	if(!literal.isEmpty())
+	{
+		Segment s;
+		s.literal = literal;
+		segments_ += s;
+	}
+
+	foreach(const Segment &s, segments_)
+		literalSize_ += s.literal.size();
+
+	compiled_ = true;
+	return true;
+}
+
+QByteArray Template::render(const FormatHandler &handler, QString *error) const
+{
+	QByteArray out("");
+	out.reserve(literalSize_ + (segments_.count() * 16));
+
+	foreach(const Segment &s, segments_)
+	{
+		if(s.directive != 0)
+		{
+			QString _error;
+			QByteArray result = handler.handle(s.directive, s.arg, &_error);
+			if(result.isNull())
+			{
+				if(error)
+					*error = QString("%1 at position %2").arg(_error, QString::number(s.pos));
+				return QByteArray();
+			}
+
+			out += result;
+		}
+		else
+		{
+			out += s.literal;
+		}
+	}
 
 	return out;
 }
@@ -285,6 +349,67 @@ public:
 	}
 };
 
+QByteArray Template::renderId(const QHash<QString, QByteArray> &vars, QString *error) const
+{
+	IdFormatHandler handler;
+	handler.vars = vars;
+	return render(handler, error);
+}
+
+QByteArray Template::renderContent(const QByteArray &defaultId, bool hex, QString *error) const
+{
+	ContentFormatHandler handler;
+	handler.defaultId = defaultId;
+	handler.hex = hex;
+	return render(handler, error);
+}
+
+// compiled content templates, shared across renders. during a fan-out,
+//   the same published body is rendered once per subscriber, each with
+//   a different id, so the rendered output can't be shared but the
+//   compiled form can
+static QCache<QByteArray, Template> g_contentTemplates(CONTENT_TEMPLATE_CACHE_MAX);
+
+// render content via the compiled template cache. partialPos works the
+//   same as with Template::compile
+static QByteArray renderContentCached(const QByteArray &data, const QByteArray &defaultId, bool hex, int *partialPos, QString *error)
+{
+	ContentFormatHandler handler;
+	handler.defaultId = defaultId;
+	handler.hex = hex;
+
+	Template *t = g_contentTemplates.object(data);
+	if(t)
+	{
+		if(partialPos)
+			*partialPos = data.length();
+
+		return t->render(handler, error);
+	}
+
+	Template ct;
+	int pos;
+	if(!ct.compile(data, &pos, error))
+		return QByteArray();
+
+	if(!partialPos && pos < data.length())
+	{
+		// can't happen: without partialPos, compile errors instead
+		return QByteArray();
+	}
+
+	if(partialPos)
+		*partialPos = pos;
+
+	QByteArray ret = ct.render(handler, error);
+
+	// only complete templates are reusable
+	if(!ret.isNull() && pos == data.length())
+		g_contentTemplates.insert(data, new Template(ct), data.length() + 1);
+
+	return ret;
+}
+
 ContentRenderer::ContentRenderer(const QByteArray &defaultId, bool hex) :
 	defaultId_(defaultId),
 	hex_(hex)
@@ -295,13 +420,9 @@ QByteArray ContentRenderer::update(const QByteArray &data)
 {
 	buf_ += data;
 
-	ContentFormatHandler handler;
-	handler.defaultId = defaultId_;
-	handler.hex = hex_;
-
 	int partialPos;
 
-	QByteArray ret = processFormat(buf_, &handler, &partialPos, &errorMessage_);
+	QByteArray ret = renderContentCached(buf_, defaultId_, hex_, &partialPos, &errorMessage_);
 	if(!ret.isNull())
 	{
 		buf_ = buf_.mid(partialPos);
@@ -315,25 +436,21 @@ QByteArray ContentRenderer::finalize()
 	QByteArray data = buf_;
 	buf_.clear();
 
-	ContentFormatHandler handler;
-	handler.defaultId = defaultId_;
-	handler.hex = hex_;
-	return processFormat(data, &handler, 0, &errorMessage_);
+	return renderContentCached(data, defaultId_, hex_, 0, &errorMessage_);
 }
 
 QByteArray ContentRenderer::process(const QByteArray &data)
 {
-	ContentFormatHandler handler;
-	handler.defaultId = defaultId_;
-	handler.hex = hex_;
-	return processFormat(data, &handler, 0, &errorMessage_);
+	return renderContentCached(data, defaultId_, hex_, 0, &errorMessage_);
 }
 
 QByteArray renderId(const QByteArray &data, const QHash<QString, QByteArray> &vars, QString *error)
 {
-	IdFormatHandler handler;
-	handler.vars = vars;
-	return processFormat(data, &handler, 0, error);
+	Template t;
+	if(!t.compile(data, 0, error))
+		return QByteArray();
+
+	return t.renderId(vars, error);
 }
 
 }
@@ -35,6 +35,54 @@
 
 namespace IdFormat {
 
+class FormatHandler;
+
+// a format string compiled into a list of literal and directive
+//   segments, so one template can be rendered many times without
+//   re-scanning the source
+class Template
+{
+public:
+	Template();
+
+	bool isNull() const { return !compiled_; }
+
+	// compile the format. on failure, returns false and leaves the
+	//   template null. if partialPos is provided, an incomplete
+	//   directive at the end of the input is not an error; compilation
+	//   stops there and the position is returned
+	bool compile(const QByteArray &format, int *partialPos = 0, QString *error = 0);
+
+	// render %(name)s directives using vars
+	QByteArray renderId(const QHash<QString, QByteArray> &vars, QString *error = 0) const;
+
+	// render %I directives using the given ID
+	QByteArray renderContent(const QByteArray &defaultId, bool hex, QString *error = 0) const;
+
+	// for internal use
+	QByteArray render(const FormatHandler &handler, QString *error) const;
+
+private:
+	class Segment
+	{
+	public:
+		QByteArray literal; // used if directive is 0
+		char directive;
+		QByteArray arg;
+		int pos; // source position, for error messages
+
+		Segment() :
+			directive(0),
+			pos(-1)
+		{
+		}
+	};
+
+	QList<Segment> segments_;
+	int literalSize_;
+	bool compiled_;
+};
+
 class ContentRenderer
 {
 public:
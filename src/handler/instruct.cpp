@@ -29,6 +29,7 @@
 #include "instruct.h"
 
 #include <QVariant>
+#include <QCache>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include "variantutil.h"
@@ -38,6 +39,8 @@
 #define MINIMUM_RESPONSE_TIMEOUT 5
 #define DEFAULT_NEXTLINK_TIMEOUT 120
 
+#define GRIP_HEADERS_CACHE_MAX 100
+
 using namespace VariantUtil;
 
 static int charToHex(char c)
@@ -99,45 +102,68 @@ static QByteArray unescape(const QByteArray &in)
 	return out;
 }
 
-Instruct Instruct::fromResponse(const HttpResponseData &response, bool *ok, QString *errorMessage)
+// the values derived purely from the Grip-* headers. origins tend to
+//   emit the same instruct header set for a given endpoint, so parsed
+//   results are memoized by header signature
+class GripHeaderValues
 {
-	HoldMode holdMode = NoHold;
-	QList<Channel> channels;
-	int timeout = -1;
+public:
+	Instruct::HoldMode holdMode;
+	QList<Instruct::Channel> channels;
+	int timeout;
 	QList<QByteArray> exposeHeaders;
 	QByteArray keepAliveData;
-	int keepAliveTimeout = -1;
+	int keepAliveTimeout;
 	QHash<QString, QString> meta;
-	HttpResponseData newResponse;
+	int statusCode; // -1 = no Grip-Status
+	QByteArray statusReason;
+	QUrl nextLink;
+	int nextLinkTimeout;
+
+	GripHeaderValues() :
+		holdMode(Instruct::NoHold),
+		timeout(-1),
+		keepAliveTimeout(-1),
+		statusCode(-1),
+		nextLinkTimeout(-1)
+	{
+	}
+};
+
+// note: not thread safe. this is fine since instructs are parsed from
+//   a single thread
+static QCache<QByteArray, GripHeaderValues> g_gripHeadersCache(GRIP_HEADERS_CACHE_MAX);
 
-	if(response.headers.contains("Grip-Hold"))
+static bool parseGripHeaders(const HttpHeaders &headers, GripHeaderValues *values, bool *ok, QString *errorMessage)
+{
+	if(headers.contains("Grip-Hold"))
 	{
-		QByteArray gripHoldStr = response.headers.get("Grip-Hold");
+		QByteArray gripHoldStr = headers.get("Grip-Hold");
 		if(gripHoldStr == "response")
 		{
-			holdMode = ResponseHold;
+			values->holdMode = Instruct::ResponseHold;
 		}
 		else if(gripHoldStr == "stream")
 		{
-			holdMode = StreamHold;
+			values->holdMode = Instruct::StreamHold;
 		}
 		else
 		{
 			setError(ok, errorMessage, "Grip-Hold must be set to either 'response' or 'stream'");
-			return Instruct();
+			return false;
 		}
 	}
 
-	QList<HttpHeaderParameters> gripChannels = response.headers.getAllAsParameters("Grip-Channel");
+	QList<HttpHeaderParameters> gripChannels = headers.getAllAsParameters("Grip-Channel");
 	foreach(const HttpHeaderParameters &gripChannel, gripChannels)
 	{
 		if(gripChannel.isEmpty())
 		{
 			setError(ok, errorMessage, "failed to parse Grip-Channel");
-			return Instruct();
+			return false;
 		}
 
-		Channel c;
+		Instruct::Channel c;
 		c.name = QString::fromUtf8(gripChannel[0].first);
 		QByteArray param = gripChannel.get("prev-id");
 		if(!param.isNull())
@@ -150,102 +176,100 @@ Instruct Instruct::fromResponse(const HttpResponseData &response, bool *ok, QStr
 				c.filters += QString::fromUtf8(param.second);
 		}
 
-		channels += c;
+		values->channels += c;
 	}
 
-	if(response.headers.contains("Grip-Timeout"))
+	if(headers.contains("Grip-Timeout"))
 	{
 		bool x;
-		timeout = response.headers.get("Grip-Timeout").toInt(&x);
+		values->timeout = headers.get("Grip-Timeout").toInt(&x);
 		if(!x)
 		{
 			setError(ok, errorMessage, "failed to parse Grip-Timeout");
-			return Instruct();
+			return false;
 		}
 
-		if(timeout < 0)
+		if(values->timeout < 0)
 		{
 			setError(ok, errorMessage, "Grip-Timeout has invalid value");
-			return Instruct();
+			return false;
 		}
 	}
 
-	exposeHeaders = response.headers.getAll("Grip-Expose-Headers");
+	values->exposeHeaders = headers.getAll("Grip-Expose-Headers");
 
-	HttpHeaderParameters keepAliveParams = response.headers.getAsParameters("Grip-Keep-Alive");
+	HttpHeaderParameters keepAliveParams = headers.getAsParameters("Grip-Keep-Alive");
 	if(!keepAliveParams.isEmpty())
 	{
 		QByteArray val = keepAliveParams[0].first;
 		if(val.isEmpty())
 		{
 			setError(ok, errorMessage, "Grip-Keep-Alive cannot be empty");
-			return Instruct();
+			return false;
 		}
 
 		if(keepAliveParams.contains("timeout"))
 		{
 			bool x;
-			keepAliveTimeout = keepAliveParams.get("timeout").toInt(&x);
+			values->keepAliveTimeout = keepAliveParams.get("timeout").toInt(&x);
 			if(!x)
 			{
 				setError(ok, errorMessage, "failed to parse Grip-Keep-Alive timeout value");
-				return Instruct();
+				return false;
 			}
 
-			if(keepAliveTimeout < 0)
+			if(values->keepAliveTimeout < 0)
 			{
 				setError(ok, errorMessage, "Grip-Keep-Alive timeout has invalid value");
-				return Instruct();
+				return false;
 			}
 		}
 		else
 		{
-			keepAliveTimeout = DEFAULT_RESPONSE_TIMEOUT;
+			values->keepAliveTimeout = DEFAULT_RESPONSE_TIMEOUT;
 		}
 
 		QByteArray format = keepAliveParams.get("format");
 		if(format.isEmpty() || format == "raw")
 		{
-			keepAliveData = val;
+			values->keepAliveData = val;
 		}
 		else if(format == "cstring")
 		{
-			keepAliveData = unescape(val);
-			if(keepAliveData.isNull())
+			values->keepAliveData = unescape(val);
+			if(values->keepAliveData.isNull())
 			{
 				setError(ok, errorMessage, "failed to parse Grip-Keep-Alive cstring format");
-				return Instruct();
+				return false;
 			}
 		}
 		else if(format == "base64")
 		{
-			keepAliveData = QByteArray::fromBase64(val);
+			values->keepAliveData = QByteArray::fromBase64(val);
 		}
 		else
 		{
 			setError(ok, errorMessage, QString("no such Grip-Keep-Alive format '%1'").arg(QString::fromUtf8(format)));
-			return Instruct();
+			return false;
 		}
 	}
 
-	QList<HttpHeaderParameters> metaParams = response.headers.getAllAsParameters("Grip-Set-Meta", HttpHeaders::ParseAllParameters);
+	QList<HttpHeaderParameters> metaParams = headers.getAllAsParameters("Grip-Set-Meta", HttpHeaders::ParseAllParameters);
 	foreach(const HttpHeaderParameters &metaParam, metaParams)
 	{
 		if(metaParam.isEmpty())
 		{
 			setError(ok, errorMessage, "Grip-Set-Meta cannot be empty");
-			return Instruct();
+			return false;
 		}
 
 		QString key = QString::fromUtf8(metaParam[0].first);
 		QString val = QString::fromUtf8(metaParam[0].second);
 
-		meta[key] = val;
+		values->meta[key] = val;
 	}
 
-	newResponse = response;
-
-	QByteArray statusHeader = response.headers.get("Grip-Status");
+	QByteArray statusHeader = headers.get("Grip-Status");
 	if(!statusHeader.isEmpty())
 	{
 		QByteArray codeStr;
@@ -263,19 +287,17 @@ Instruct Instruct::fromResponse(const HttpResponseData &response, bool *ok, QStr
 		}
 
 		bool _ok;
-		newResponse.code = codeStr.toInt(&_ok);
-		if(!_ok || newResponse.code < 0 || newResponse.code > 999)
+		values->statusCode = codeStr.toInt(&_ok);
+		if(!_ok || values->statusCode < 0 || values->statusCode > 999)
 		{
 			setError(ok, errorMessage, "Grip-Status contains invalid status code");
-			return Instruct();
+			return false;
 		}
 
-		newResponse.reason = reason;
+		values->statusReason = reason;
 	}
 
-	QUrl nextLink;
-	int nextLinkTimeout = -1;
-	foreach(const HttpHeaderParameters &params, response.headers.getAllAsParameters("Grip-Link"))
+	foreach(const HttpHeaderParameters &params, headers.getAllAsParameters("Grip-Link"))
 	{
 		if(params.count() >= 2 && params.get("rel") == "next")
 		{
@@ -283,39 +305,96 @@ Instruct Instruct::fromResponse(const HttpResponseData &response, bool *ok, QStr
 			if(linkParam.length() <= 2 || linkParam[0] != '<' || linkParam[linkParam.length() - 1] != '>')
 			{
 				setError(ok, errorMessage, "failed to parse Grip-Link value");
-				return Instruct();
+				return false;
 			}
 
-			nextLink = QUrl::fromEncoded(linkParam.mid(1, linkParam.length() - 2));
-			if(!nextLink.isValid())
+			values->nextLink = QUrl::fromEncoded(linkParam.mid(1, linkParam.length() - 2));
+			if(!values->nextLink.isValid())
 			{
 				setError(ok, errorMessage, "Grip-Link contains invalid link");
-				return Instruct();
+				return false;
 			}
 
 			if(params.contains("timeout"))
 			{
 				bool x;
-				nextLinkTimeout = params.get("timeout").toInt(&x);
+				values->nextLinkTimeout = params.get("timeout").toInt(&x);
 				if(!x)
 				{
 					setError(ok, errorMessage, "failed to parse Grip-Link timeout value");
-					return Instruct();
+					return false;
 				}
 
-				if(nextLinkTimeout < 0)
+				if(values->nextLinkTimeout < 0)
 				{
 					setError(ok, errorMessage, "Grip-Link timeout has invalid value");
-					return Instruct();
+					return false;
 				}
 			}
 			else
 			{
-				nextLinkTimeout = DEFAULT_NEXTLINK_TIMEOUT;
+				values->nextLinkTimeout = DEFAULT_NEXTLINK_TIMEOUT;
 			}
 		}
 	}
 
+	return true;
+}
+
+Instruct Instruct::fromResponse(const HttpResponseData &response, bool *ok, QString *errorMessage)
+{
+	// collect the instruct-relevant headers and their signature, in order
+	QByteArray gripSig;
+	HttpHeaders gripHeaders;
+	foreach(const HttpHeader &h, response.headers)
+	{
+		if(qstrnicmp(h.first.data(), "Grip-", 5) == 0)
+		{
+			gripSig += h.first;
+			gripSig += ':';
+			gripSig += h.second;
+			gripSig += '\n';
+
+			gripHeaders += h;
+		}
+	}
+
+	GripHeaderValues g;
+
+	GripHeaderValues *cached = (!gripSig.isEmpty() ? g_gripHeadersCache.object(gripSig) : 0);
+	if(cached)
+	{
+		g = *cached;
+	}
+	else if(!gripHeaders.isEmpty())
+	{
+		// each named lookup during parsing scans only the grip headers,
+		//   not the whole header set
+		if(!parseGripHeaders(gripHeaders, &g, ok, errorMessage))
+			return Instruct();
+
+		// only remember responses that used grip headers at all
+		g_gripHeadersCache.insert(gripSig, new GripHeaderValues(g));
+	}
+
+	HoldMode holdMode = g.holdMode;
+	QList<Channel> channels = g.channels;
+	int timeout = g.timeout;
+	QList<QByteArray> exposeHeaders = g.exposeHeaders;
+	QByteArray keepAliveData = g.keepAliveData;
+	int keepAliveTimeout = g.keepAliveTimeout;
+	QHash<QString, QString> meta = g.meta;
+	QUrl nextLink = g.nextLink;
+	int nextLinkTimeout = g.nextLinkTimeout;
+
+	HttpResponseData newResponse = response;
+
+	if(g.statusCode != -1)
+	{
+		newResponse.code = g.statusCode;
+		newResponse.reason = g.statusReason;
+	}
+
 	newResponse.headers.clear();
 	foreach(const HttpHeader &h, response.headers)
 	{
@@ -29,7 +29,113 @@
 #include "jsonpointer.h"
 
 #include <assert.h>
+#include <QHash>
 #include <QStringList>
+#include <QVector>
+
+// bound on distinct pointer strings remembered. patch traffic
+//   resolves the same handful of paths over and over, so this is
+//   effectively never hit; if it is, the cache starts over
+#define POINTER_CACHE_MAX 1000
+
+namespace {
+
+// the data-independent part of a pointer: the unescaped reference
+//   names with their numeric interpretations precomputed. whether a
+//   token acts as an object key or an array index still depends on
+//   the document being resolved against
+class PointerToken
+{
+public:
+	QString name;
+	int index; // numeric value of name, if isIndex
+	bool isIndex;
+	bool isDash;
+
+	PointerToken() :
+		index(-1),
+		isIndex(false),
+		isDash(false)
+	{
+	}
+};
+
+class CompiledPointer
+{
+public:
+	bool valid;
+	QString errorMessage;
+	QVector<PointerToken> tokens;
+
+	CompiledPointer() :
+		valid(false)
+	{
+	}
+};
+
+}
+
+static const CompiledPointer &compiledPointer(const QString &pointerStr)
+{
+	static QHash<QString, CompiledPointer> cache;
+
+	QHash<QString, CompiledPointer>::const_iterator cit = cache.constFind(pointerStr);
+	if(cit != cache.constEnd())
+		return cit.value();
+
+	CompiledPointer c;
+
+	if(!pointerStr.startsWith('/'))
+	{
+		c.errorMessage = "pointer must start with /";
+	}
+	else
+	{
+		c.valid = true;
+
+		if(pointerStr.length() > 1)
+		{
+			QStringList parts = pointerStr.split('/').mid(1);
+			foreach(const QString &part, parts)
+			{
+				if(part.isEmpty())
+				{
+					c.valid = false;
+					c.errorMessage = "reference cannot be empty";
+					c.tokens.clear();
+					break;
+				}
+
+				PointerToken token;
+				token.name = part;
+				token.name.replace("~1", "/");
+				token.name.replace("~0", "~");
+
+				if(token.name == "-")
+				{
+					token.isDash = true;
+				}
+				else
+				{
+					bool ok;
+					int index = token.name.toInt(&ok);
+					if(ok)
+					{
+						token.index = index;
+						token.isIndex = true;
+					}
+				}
+
+				c.tokens += token;
+			}
+		}
+	}
+
+	if(cache.count() >= POINTER_CACHE_MAX)
+		cache.clear();
+
+	return cache.insert(pointerStr, c).value();
+}
 
 JsonPointer::JsonPointer() :
 	isNull_(true)
@@ -444,10 +550,15 @@ bool JsonPointer::isWithin(const QString &bPointerStr, const QString &aPointerSt
 
 JsonPointer JsonPointer::resolve(QVariant *data, const QString &pointerStr, QString *errorMessage)
 {
-	if(!pointerStr.startsWith('/'))
+	// tokenization, validation, and unescaping happen at most once
+	//   per distinct pointer string. only the document walk remains
+	//   per-resolve
+	const CompiledPointer &compiled = compiledPointer(pointerStr);
+
+	if(!compiled.valid)
 	{
 		if(errorMessage)
-			*errorMessage = "pointer must start with /";
+			*errorMessage = compiled.errorMessage;
 		return JsonPointer();
 	}
 
@@ -456,24 +567,12 @@ JsonPointer JsonPointer::resolve(QVariant *data, const QString &pointerStr, QStr
 	ptr.root_ = data;
 
 	// root
-	if(pointerStr.length() == 1)
+	if(compiled.tokens.isEmpty())
 		return ptr;
 
 	QVariant i = *ptr.root_;
-	QStringList parts = pointerStr.split('/').mid(1);
-	foreach(const QString &part, parts)
+	foreach(const PointerToken &token, compiled.tokens)
 	{
-		if(part.isEmpty())
-		{
-			if(errorMessage)
-				*errorMessage = "reference cannot be empty";
-			return JsonPointer();
-		}
-
-		QString p = part;
-		p.replace("~1", "/");
-		p.replace("~0", "~");
-
 		// validate and step into previous reference, if any
 		if(!ptr.refs_.isEmpty())
 		{
@@ -524,34 +623,32 @@ JsonPointer JsonPointer::resolve(QVariant *data, const QString &pointerStr, QStr
 
 		if(i.type() == QVariant::Hash || i.type() == QVariant::Map)
 		{
-			ptr.refs_ += Ref(p);
+			ptr.refs_ += Ref(token.name);
 		}
 		else if(i.type() == QVariant::List)
 		{
 			QVariantList l = i.toList();
-			if(p == "-")
+			if(token.isDash)
 			{
 				ptr.refs_ += Ref(-1);
 			}
 			else
 			{
-				bool ok;
-				int index = p.toInt(&ok);
-				if(!ok)
+				if(!token.isIndex)
 				{
 					if(errorMessage)
 						*errorMessage = "index must be an integer";
 					return JsonPointer();
 				}
 
-				if(index < 0 || index >= l.count())
+				if(token.index < 0 || token.index >= l.count())
 				{
 					if(errorMessage)
 						*errorMessage = "index out of range";
 					return JsonPointer();
 				}
 
-				ptr.refs_ += Ref(index);
+				ptr.refs_ += Ref(token.index);
 			}
 		}
 		else
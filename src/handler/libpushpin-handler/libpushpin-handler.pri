@@ -21,19 +21,31 @@ HEADERS += \
 	$$SRC_DIR/lastids.h \
 	$$SRC_DIR/cidset.h \
 	$$SRC_DIR/sessionrequest.h \
+	$$SRC_DIR/sessionupdater.h \
 	$$SRC_DIR/requeststate.h \
 	$$SRC_DIR/wscontrolmessage.h \
 	$$SRC_DIR/publishformat.h \
+	$$SRC_DIR/rendercache.h \
+	$$SRC_DIR/gziputil.h \
+	$$SRC_DIR/dedupring.h \
 	$$SRC_DIR/publishitem.h \
 	$$SRC_DIR/instruct.h \
 	$$SRC_DIR/idformat.h \
 	$$SRC_DIR/httpsession.h \
 	$$SRC_DIR/httpsessionupdatemanager.h \
 	$$SRC_DIR/publishlastids.h \
+	$$SRC_DIR/publishspool.h \
 	$$SRC_DIR/controlrequest.h \
 	$$SRC_DIR/conncheckworker.h \
 	$$SRC_DIR/refreshworker.h \
 	$$SRC_DIR/ratelimiter.h \
+	$$SRC_DIR/channelindex.h \
+	$$SRC_DIR/channelintern.h \
+	$$SRC_DIR/heavyhitters.h \
+	$$SRC_DIR/bodycache.h \
+	$$SRC_DIR/routebudgets.h \
+	$$SRC_DIR/replayring.h \
+	$$SRC_DIR/publishfanout.h \
 	$$SRC_DIR/sequencer.h \
 	$$SRC_DIR/filter.h \
 	$$SRC_DIR/filterstack.h \
@@ -46,19 +58,30 @@ SOURCES += \
 	$$SRC_DIR/jsonpointer.cpp \
 	$$SRC_DIR/jsonpatch.cpp \
 	$$SRC_DIR/sessionrequest.cpp \
+	$$SRC_DIR/sessionupdater.cpp \
 	$$SRC_DIR/requeststate.cpp \
 	$$SRC_DIR/wscontrolmessage.cpp \
 	$$SRC_DIR/publishformat.cpp \
+	$$SRC_DIR/rendercache.cpp \
+	$$SRC_DIR/gziputil.cpp \
 	$$SRC_DIR/publishitem.cpp \
 	$$SRC_DIR/instruct.cpp \
 	$$SRC_DIR/idformat.cpp \
 	$$SRC_DIR/httpsession.cpp \
 	$$SRC_DIR/httpsessionupdatemanager.cpp \
 	$$SRC_DIR/publishlastids.cpp \
+	$$SRC_DIR/publishspool.cpp \
 	$$SRC_DIR/controlrequest.cpp \
 	$$SRC_DIR/conncheckworker.cpp \
 	$$SRC_DIR/refreshworker.cpp \
 	$$SRC_DIR/ratelimiter.cpp \
+	$$SRC_DIR/channelindex.cpp \
+	$$SRC_DIR/channelintern.cpp \
+	$$SRC_DIR/heavyhitters.cpp \
+	$$SRC_DIR/bodycache.cpp \
+	$$SRC_DIR/routebudgets.cpp \
+	$$SRC_DIR/replayring.cpp \
+	$$SRC_DIR/publishfanout.cpp \
 	$$SRC_DIR/sequencer.cpp \
 	$$SRC_DIR/filter.cpp \
 	$$SRC_DIR/filterstack.cpp \
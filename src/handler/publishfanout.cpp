@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "publishfanout.h"
+
+#include <QList>
+#include <QTimer>
+
+#define DEFAULT_SHARD_SIZE 2000
+
+class PublishFanOut::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	QList<Job*> jobs;
+	int shardSize;
+	QTimer *timer;
+
+	Private(QObject *_q) :
+		QObject(_q),
+		shardSize(DEFAULT_SHARD_SIZE)
+	{
+		timer = new QTimer(this);
+		timer->setSingleShot(true);
+		connect(timer, &QTimer::timeout, this, &Private::timeout);
+	}
+
+	~Private()
+	{
+		qDeleteAll(jobs);
+
+		timer->disconnect(this);
+		timer->setParent(0);
+		timer->deleteLater();
+	}
+
+	void addJob(Job *job)
+	{
+		jobs += job;
+
+		if(!timer->isActive())
+			timer->start(0);
+	}
+
+private slots:
+	void timeout()
+	{
+		if(!jobs.isEmpty())
+		{
+			Job *job = jobs.takeFirst();
+
+			if(job->process(shardSize))
+				delete job;
+			else
+				jobs += job;
+		}
+
+		if(!jobs.isEmpty())
+			timer->start(0);
+	}
+};
+
+PublishFanOut::PublishFanOut(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+PublishFanOut::~PublishFanOut()
+{
+	delete d;
+}
+
+void PublishFanOut::setShardSize(int count)
+{
+	d->shardSize = count;
+}
+
+void PublishFanOut::addJob(Job *job)
+{
+	d->addJob(job);
+}
+
+#include "publishfanout.moc"
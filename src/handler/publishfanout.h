@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef PUBLISHFANOUT_H
+#define PUBLISHFANOUT_H
+
+#include <QObject>
+
+// spreads large subscriber fan-outs across event loop passes, so that a
+//   publish to a popular channel doesn't starve other processing. jobs are
+//   processed round-robin, at most shardSize targets per pass.
+class PublishFanOut : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Job
+	{
+	public:
+		virtual ~Job() {}
+
+		// process up to max targets. return true if the job is complete
+		virtual bool process(int max) = 0;
+	};
+
+	PublishFanOut(QObject *parent = 0);
+	~PublishFanOut();
+
+	void setShardSize(int count);
+
+	// takes ownership
+	void addJob(Job *job);
+
+private:
+	class Private;
+	Private *d;
+};
+
+#endif
@@ -231,17 +231,32 @@ PublishFormat PublishFormat::fromVariant(Type type, const QVariant &in, bool *ok
 				out.contentFilters = filters;
 			}
 
-			if(in.type() == QVariant::Map && keyedObjectContains(in, "body-bin")) // JSON input
+			if(keyedObjectContains(in, "body-bin"))
 			{
-				QString bodyBin = getString(in, pn, "body-bin", false, &ok_, errorMessage);
-				if(!ok_)
+				QVariant vbodyBin = keyedObjectGetValue(in, "body-bin");
+
+				if(in.type() == QVariant::Map) // JSON input
 				{
-					if(ok)
-						*ok = false;
-					return PublishFormat();
+					if(vbodyBin.type() != QVariant::String)
+					{
+						setError(ok, errorMessage, QString("%1 contains 'body-bin' with wrong type").arg(pn));
+						return PublishFormat();
+					}
+
+					out.body = QByteArray::fromBase64(vbodyBin.toString().toUtf8());
 				}
+				else
+				{
+					// tnetstring input is binary safe, so the bytes
+					//   arrive as-is without a base64 round trip
+					if(vbodyBin.type() != QVariant::ByteArray)
+					{
+						setError(ok, errorMessage, QString("%1 contains 'body-bin' with wrong type").arg(pn));
+						return PublishFormat();
+					}
 
-				out.body = QByteArray::fromBase64(bodyBin.toUtf8());
+					out.body = vbodyBin.toByteArray();
+				}
 			}
 			else if(keyedObjectContains(in, "body"))
 			{
@@ -270,10 +285,7 @@ PublishFormat PublishFormat::fromVariant(Type type, const QVariant &in, bool *ok
 			}
 			else
 			{
-				if(in.type() == QVariant::Map) // JSON input
-					setError(ok, errorMessage, QString("%1 does not contain 'body', 'body-bin', or 'body-patch'").arg(pn));
-				else
-					setError(ok, errorMessage, QString("%1 does not contain 'body' or 'body-patch'").arg(pn));
+				setError(ok, errorMessage, QString("%1 does not contain 'body', 'body-bin', or 'body-patch'").arg(pn));
 				return PublishFormat();
 			}
 		}
@@ -308,17 +320,32 @@ PublishFormat PublishFormat::fromVariant(Type type, const QVariant &in, bool *ok
 				out.contentFilters = filters;
 			}
 
-			if(in.type() == QVariant::Map && keyedObjectContains(in, "content-bin")) // JSON input
+			if(keyedObjectContains(in, "content-bin"))
 			{
-				QString contentBin = getString(in, pn, "content-bin", false, &ok_, errorMessage);
-				if(!ok_)
+				QVariant vcontentBin = keyedObjectGetValue(in, "content-bin");
+
+				if(in.type() == QVariant::Map) // JSON input
 				{
-					if(ok)
-						*ok = false;
-					return PublishFormat();
+					if(vcontentBin.type() != QVariant::String)
+					{
+						setError(ok, errorMessage, QString("%1 contains 'content-bin' with wrong type").arg(pn));
+						return PublishFormat();
+					}
+
+					out.body = QByteArray::fromBase64(vcontentBin.toString().toUtf8());
 				}
+				else
+				{
+					// tnetstring input is binary safe, so the bytes
+					//   arrive as-is without a base64 round trip
+					if(vcontentBin.type() != QVariant::ByteArray)
+					{
+						setError(ok, errorMessage, QString("%1 contains 'content-bin' with wrong type").arg(pn));
+						return PublishFormat();
+					}
 
-				out.body = QByteArray::fromBase64(contentBin.toUtf8());
+					out.body = vcontentBin.toByteArray();
+				}
 			}
 			else if(keyedObjectContains(in, "content"))
 			{
@@ -335,10 +362,7 @@ PublishFormat PublishFormat::fromVariant(Type type, const QVariant &in, bool *ok
 			}
 			else
 			{
-				if(in.type() == QVariant::Map) // JSON input
-					setError(ok, errorMessage, QString("%1 does not contain 'content' or 'content-bin'").arg(pn));
-				else
-					setError(ok, errorMessage, QString("%1 does not contain 'content'").arg(pn));
+				setError(ok, errorMessage, QString("%1 does not contain 'content' or 'content-bin'").arg(pn));
 				return PublishFormat();
 			}
 		}
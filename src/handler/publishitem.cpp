@@ -28,10 +28,41 @@
 
 #include "publishitem.h"
 
+#include "tnetstring.h"
+#include "tnetstringview.h"
 #include "variantutil.h"
 
 using namespace VariantUtil;
 
+// publishers often put the same payload in every format. QByteArray
+//   assignment shares data, so pointing formats with identical bytes
+//   at one buffer drops the extra copies for the item's lifetime
+static void shareIdenticalBodies(QHash<PublishFormat::Type, PublishFormat> *formats)
+{
+	QList<PublishFormat::Type> types = formats->keys();
+	if(types.count() < 2)
+		return;
+
+	for(int n = 1; n < types.count(); ++n)
+	{
+		PublishFormat &f = (*formats)[types[n]];
+
+		if(f.body.isEmpty())
+			continue;
+
+		for(int k = 0; k < n; ++k)
+		{
+			const PublishFormat &other = (*formats)[types[k]];
+
+			if(other.body.constData() != f.body.constData() && other.body == f.body)
+			{
+				f.body = other.body;
+				break;
+			}
+		}
+	}
+}
+
 PublishItem PublishItem::fromVariant(const QVariant &vitem, const QString &channel, bool *ok, QString *errorMessage)
 {
 	QString pn = "publish item object";
@@ -146,6 +177,8 @@ PublishItem PublishItem::fromVariant(const QVariant &vitem, const QString &chann
 		item.formats.insert(f.type, f);
 	}
 
+	shareIdenticalBodies(&item.formats);
+
 	QVariant vmeta = getKeyedObject(vitem, pn, "meta", false, &ok_, errorMessage);
 	if(!ok_)
 	{
@@ -233,3 +266,238 @@ PublishItem PublishItem::fromVariant(const QVariant &vitem, const QString &chann
 	setSuccess(ok, errorMessage);
 	return item;
 }
+
+PublishItem PublishItem::fromTnetString(const QByteArray &frame, const QString &channel, bool *ok, QString *errorMessage)
+{
+	QString pn = "publish item object";
+
+	TnetStringView root(frame);
+	if(root.type() != TnetStringView::Map)
+	{
+		setError(ok, errorMessage, QString("%1 is not an object").arg(pn));
+		return PublishItem();
+	}
+
+	PublishItem item;
+	bool ok_;
+
+	item.channel = channel;
+
+	TnetStringView vformats;
+	TnetStringView vhttpResponse;
+	TnetStringView vhttpStream;
+	TnetStringView vwsMessage;
+	TnetStringView vmeta;
+
+	QByteArray key;
+	TnetStringView value;
+	TnetStringView::MapIterator it(root);
+	while(it.next(&key, &value))
+	{
+		if(key == "channel")
+		{
+			if(item.channel.isEmpty())
+			{
+				if(value.type() != TnetStringView::ByteArray)
+				{
+					setError(ok, errorMessage, QString("%1 contains 'channel' with wrong type").arg(pn));
+					return PublishItem();
+				}
+
+				item.channel = QString::fromUtf8(value.toByteArray());
+			}
+		}
+		else if(key == "id")
+		{
+			if(value.type() != TnetStringView::ByteArray)
+			{
+				setError(ok, errorMessage, QString("%1 contains 'id' with wrong type").arg(pn));
+				return PublishItem();
+			}
+
+			item.id = QString::fromUtf8(value.toByteArray());
+		}
+		else if(key == "prev-id")
+		{
+			if(value.type() != TnetStringView::ByteArray)
+			{
+				setError(ok, errorMessage, QString("%1 contains 'prev-id' with wrong type").arg(pn));
+				return PublishItem();
+			}
+
+			item.prevId = QString::fromUtf8(value.toByteArray());
+		}
+		else if(key == "formats")
+		{
+			if(value.type() != TnetStringView::Map)
+			{
+				setError(ok, errorMessage, QString("%1 contains 'formats' with wrong type").arg(pn));
+				return PublishItem();
+			}
+
+			vformats = value;
+		}
+		else if(key == "http-response")
+		{
+			vhttpResponse = value;
+		}
+		else if(key == "http-stream")
+		{
+			vhttpStream = value;
+		}
+		else if(key == "ws-message")
+		{
+			vwsMessage = value;
+		}
+		else if(key == "meta")
+		{
+			if(value.type() != TnetStringView::Map)
+			{
+				setError(ok, errorMessage, QString("%1 contains 'meta' with wrong type").arg(pn));
+				return PublishItem();
+			}
+
+			vmeta = value;
+		}
+		else if(key == "size")
+		{
+			qint64 size = value.toInt(&ok_);
+			if(!ok_)
+			{
+				setError(ok, errorMessage, QString("%1 contains 'size' with wrong type").arg(pn));
+				return PublishItem();
+			}
+
+			if(size < 0)
+			{
+				setError(ok, errorMessage, QString("%1 contains 'size' with invalid value").arg(pn));
+				return PublishItem();
+			}
+
+			item.size = (int)size;
+		}
+		else if(key == "no-seq")
+		{
+			item.noSeq = value.toBool(&ok_);
+			if(!ok_)
+			{
+				setError(ok, errorMessage, QString("%1 contains 'no-seq' with wrong type").arg(pn));
+				return PublishItem();
+			}
+		}
+	}
+
+	if(item.channel.isEmpty())
+	{
+		setError(ok, errorMessage, QString("%1 does not contain 'channel'").arg(pn));
+		return PublishItem();
+	}
+
+	// format objects are handed to the variant-based parsers, but only
+	//   the subtrees actually present get converted
+
+	if(vformats.isValid())
+	{
+		// an explicit formats object supersedes any top-level entries
+		vhttpResponse = TnetStringView();
+		vhttpStream = TnetStringView();
+		vwsMessage = TnetStringView();
+
+		TnetStringView::MapIterator fit(vformats);
+		while(fit.next(&key, &value))
+		{
+			if(key == "http-response")
+				vhttpResponse = value;
+			else if(key == "http-stream")
+				vhttpStream = value;
+			else if(key == "ws-message")
+				vwsMessage = value;
+		}
+	}
+
+	if(vhttpResponse.isValid())
+	{
+		QVariant vformat = TnetString::toVariant(frame, vhttpResponse.offset(), &ok_);
+		if(!ok_)
+		{
+			setError(ok, errorMessage, QString("%1 contains 'http-response' with wrong type").arg(pn));
+			return PublishItem();
+		}
+
+		PublishFormat f = PublishFormat::fromVariant(PublishFormat::HttpResponse, vformat, &ok_, errorMessage);
+		if(!ok_)
+		{
+			if(ok)
+				*ok = false;
+			return PublishItem();
+		}
+
+		item.formats.insert(f.type, f);
+	}
+
+	if(vhttpStream.isValid())
+	{
+		QVariant vformat = TnetString::toVariant(frame, vhttpStream.offset(), &ok_);
+		if(!ok_)
+		{
+			setError(ok, errorMessage, QString("%1 contains 'http-stream' with wrong type").arg(pn));
+			return PublishItem();
+		}
+
+		PublishFormat f = PublishFormat::fromVariant(PublishFormat::HttpStream, vformat, &ok_, errorMessage);
+		if(!ok_)
+		{
+			if(ok)
+				*ok = false;
+			return PublishItem();
+		}
+
+		item.formats.insert(f.type, f);
+	}
+
+	if(vwsMessage.isValid())
+	{
+		QVariant vformat = TnetString::toVariant(frame, vwsMessage.offset(), &ok_);
+		if(!ok_)
+		{
+			setError(ok, errorMessage, QString("%1 contains 'ws-message' with wrong type").arg(pn));
+			return PublishItem();
+		}
+
+		PublishFormat f = PublishFormat::fromVariant(PublishFormat::WebSocketMessage, vformat, &ok_, errorMessage);
+		if(!ok_)
+		{
+			if(ok)
+				*ok = false;
+			return PublishItem();
+		}
+
+		item.formats.insert(f.type, f);
+	}
+
+	if(item.formats.isEmpty())
+	{
+		setError(ok, errorMessage, "no formats specified");
+		return PublishItem();
+	}
+
+	shareIdenticalBodies(&item.formats);
+
+	if(vmeta.isValid())
+	{
+		TnetStringView::MapIterator mit(vmeta);
+		while(mit.next(&key, &value))
+		{
+			if(value.type() != TnetStringView::ByteArray)
+			{
+				setError(ok, errorMessage, QString("'meta' contains '%1' with wrong type").arg(QString::fromUtf8(key)));
+				return PublishItem();
+			}
+
+			item.meta[QString::fromUtf8(key)] = QString::fromUtf8(value.toByteArray());
+		}
+	}
+
+	setSuccess(ok, errorMessage);
+	return item;
+}
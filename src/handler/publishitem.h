@@ -32,7 +32,9 @@
 #include <QString>
 #include <QHash>
 #include <QVariant>
+#include <QSharedPointer>
 #include "publishformat.h"
+#include "rendercache.h"
 
 class PublishItem
 {
@@ -45,15 +47,34 @@ public:
 	int size;
 	bool noSeq;
 
+	// msec timestamp of when the item entered the engine, for
+	//   publish-to-delivery latency reporting. -1 if not stamped
+	qint64 ingestTime;
+
+	// hash of the rendered payload, for duplicate suppression during
+	//   fan-out. 0 if not computed
+	quint64 contentHash;
+
 	PublishFormat format; // for single format items
 
+	// shared across all copies handed to subscribers during fan-out, so
+	//   that identical renders are computed only once per publish
+	QSharedPointer<RenderCache> renderCache;
+
 	PublishItem() :
 		size(-1),
-		noSeq(false)
+		noSeq(false),
+		ingestTime(-1),
+		contentHash(0)
 	{
 	}
 
 	static PublishItem fromVariant(const QVariant &vitem, const QString &channel = QString(), bool *ok = 0, QString *errorMessage = 0);
+
+	// parse directly from a tnetstring frame, avoiding the intermediate
+	//   variant tree. nested format objects are still converted via
+	//   variants, but the rest of the packet is read in place.
+	static PublishItem fromTnetString(const QByteArray &frame, const QString &channel = QString(), bool *ok = 0, QString *errorMessage = 0);
 };
 
 #endif
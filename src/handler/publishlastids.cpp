@@ -29,10 +29,131 @@
 #include "publishlastids.h"
 
 #include <assert.h>
+#include <string.h>
+#include <QFile>
+#include "log.h"
+
+// persistent file layout: a 16 byte header followed by a direct-mapped
+//   hash table of fixed-size slots, one per bucket, indexed by
+//   qHash(channel). each slot holds the utf-8 channel and id prefixed
+//   by their lengths. a zero channel length means the slot is empty.
+//   colliding channels simply overwrite each other, which only means
+//   those channels recover the slow way after a restart. the file uses
+//   host byte order and is not meant to be moved between machines
+#define PERSIST_VERSION 1
+#define PERSIST_HEADER_SIZE 16
+#define PERSIST_SLOT_SIZE 128
+
+static const char persistMagic[4] = { 'P', 'L', 'I', 'D' };
 
 PublishLastIds::PublishLastIds(int maxCapacity) :
-	maxCapacity_(maxCapacity)
+	maxCapacity_(maxCapacity),
+	persistFile_(0),
+	persistMap_(0),
+	persistSlotCount_(0)
+{
+}
+
+PublishLastIds::~PublishLastIds()
 {
+	delete persistFile_;
+}
+
+bool PublishLastIds::setPersistentFile(const QString &filePath)
+{
+	if(persistFile_)
+	{
+		delete persistFile_;
+		persistFile_ = 0;
+		persistMap_ = 0;
+		persistSlotCount_ = 0;
+	}
+
+	quint32 slotCount = qMax(maxCapacity_, 1);
+	qint64 size = PERSIST_HEADER_SIZE + ((qint64)slotCount * PERSIST_SLOT_SIZE);
+
+	QFile *f = new QFile(filePath);
+	if(!f->open(QIODevice::ReadWrite))
+	{
+		log_warning("failed to open %s: %s", qPrintable(filePath), qPrintable(f->errorString()));
+		delete f;
+		return false;
+	}
+
+	bool haveExisting = false;
+	if(f->size() == size)
+	{
+		char header[PERSIST_HEADER_SIZE];
+		if(f->read(header, PERSIST_HEADER_SIZE) == PERSIST_HEADER_SIZE)
+		{
+			quint32 version, count;
+			memcpy(&version, header + 4, 4);
+			memcpy(&count, header + 8, 4);
+			if(memcmp(header, persistMagic, 4) == 0 && version == PERSIST_VERSION && count == slotCount)
+				haveExisting = true;
+		}
+	}
+
+	if(!haveExisting)
+	{
+		// start fresh. resize() extends with zeroed (sparse) content
+		if(!f->resize(0) || !f->resize(size))
+		{
+			log_warning("failed to resize %s: %s", qPrintable(filePath), qPrintable(f->errorString()));
+			delete f;
+			return false;
+		}
+
+		char header[PERSIST_HEADER_SIZE];
+		memcpy(header, persistMagic, 4);
+		quint32 version = PERSIST_VERSION;
+		memcpy(header + 4, &version, 4);
+		memcpy(header + 8, &slotCount, 4);
+		quint32 slotSize = PERSIST_SLOT_SIZE;
+		memcpy(header + 12, &slotSize, 4);
+		f->seek(0);
+		if(f->write(header, PERSIST_HEADER_SIZE) != PERSIST_HEADER_SIZE)
+		{
+			log_warning("failed to write %s: %s", qPrintable(filePath), qPrintable(f->errorString()));
+			delete f;
+			return false;
+		}
+	}
+
+	uchar *map = f->map(0, size);
+	if(!map)
+	{
+		log_warning("failed to map %s", qPrintable(filePath));
+		delete f;
+		return false;
+	}
+
+	persistFile_ = f;
+	persistMap_ = map;
+	persistSlotCount_ = slotCount;
+
+	if(haveExisting)
+	{
+		int loaded = 0;
+		for(quint32 n = 0; n < slotCount; ++n)
+		{
+			const uchar *slot = persistMap_ + PERSIST_HEADER_SIZE + ((qint64)n * PERSIST_SLOT_SIZE);
+			quint16 channelLen, idLen;
+			memcpy(&channelLen, slot, 2);
+			memcpy(&idLen, slot + 2, 2);
+			if(channelLen == 0 || 4 + channelLen + idLen > PERSIST_SLOT_SIZE)
+				continue;
+
+			QString channel = QString::fromUtf8((const char *)slot + 4, channelLen);
+			QString id = QString::fromUtf8((const char *)slot + 4 + channelLen, idLen);
+			set(channel, id);
+			++loaded;
+		}
+
+		log_debug("loaded %d last ids from %s", loaded, qPrintable(filePath));
+	}
+
+	return true;
 }
 
 void PublishLastIds::set(const QString &channel, const QString &id)
@@ -58,6 +179,7 @@ void PublishLastIds::set(const QString &channel, const QString &id)
 			QString channel = it.value().channel;
 			it.remove();
 			table_.remove(channel);
+			persistRemove(channel);
 		}
 
 		Item i;
@@ -67,6 +189,8 @@ void PublishLastIds::set(const QString &channel, const QString &id)
 		table_.insert(channel, i);
 		recentlyUsed_.insert(TimeStringPair(i.time, channel), i);
 	}
+
+	persistWrite(channel, id);
 }
 
 void PublishLastIds::remove(const QString &channel)
@@ -76,6 +200,7 @@ void PublishLastIds::remove(const QString &channel)
 		Item &i = table_[channel];
 		recentlyUsed_.remove(TimeStringPair(i.time, channel));
 		table_.remove(channel);
+		persistRemove(channel);
 	}
 }
 
@@ -83,9 +208,63 @@ void PublishLastIds::clear()
 {
 	recentlyUsed_.clear();
 	table_.clear();
+
+	if(persistMap_)
+		memset(persistMap_ + PERSIST_HEADER_SIZE, 0, (size_t)persistSlotCount_ * PERSIST_SLOT_SIZE);
 }
 
 QString PublishLastIds::value(const QString &channel)
 {
 	return table_.value(channel).id;
 }
+
+void PublishLastIds::persistWrite(const QString &channel, const QString &id)
+{
+	if(!persistMap_)
+		return;
+
+	QByteArray channelBuf = channel.toUtf8();
+	QByteArray idBuf = id.toUtf8();
+	if(4 + channelBuf.size() + idBuf.size() > PERSIST_SLOT_SIZE)
+	{
+		// too large to persist. the channel will recover the slow way
+		//   after a restart
+		persistRemove(channel);
+		return;
+	}
+
+	uchar *slot = persistMap_ + PERSIST_HEADER_SIZE + ((qint64)(qHash(channel) % persistSlotCount_) * PERSIST_SLOT_SIZE);
+
+	// invalidate the slot before rewriting it, so a crash mid-write
+	//   leaves it empty rather than torn
+	quint16 channelLen = 0;
+	memcpy(slot, &channelLen, 2);
+
+	quint16 idLen = idBuf.size();
+	memcpy(slot + 2, &idLen, 2);
+	memcpy(slot + 4, channelBuf.data(), channelBuf.size());
+	memcpy(slot + 4 + channelBuf.size(), idBuf.data(), idBuf.size());
+
+	channelLen = channelBuf.size();
+	memcpy(slot, &channelLen, 2);
+}
+
+void PublishLastIds::persistRemove(const QString &channel)
+{
+	if(!persistMap_)
+		return;
+
+	QByteArray channelBuf = channel.toUtf8();
+	uchar *slot = persistMap_ + PERSIST_HEADER_SIZE + ((qint64)(qHash(channel) % persistSlotCount_) * PERSIST_SLOT_SIZE);
+
+	quint16 channelLen;
+	memcpy(&channelLen, slot, 2);
+	if(channelLen != channelBuf.size() || memcmp(slot + 4, channelBuf.data(), channelLen) != 0)
+	{
+		// slot holds a different channel, leave it alone
+		return;
+	}
+
+	channelLen = 0;
+	memcpy(slot, &channelLen, 2);
+}
@@ -34,11 +34,20 @@
 #include <QMap>
 #include <QHash>
 
+class QFile;
+
 // cache with LRU expiration
 class PublishLastIds
 {
 public:
 	PublishLastIds(int maxCapacity);
+	~PublishLastIds();
+
+	// enable write-through persistence to a memory-mapped file. any
+	//   state already in the file is loaded. returns false if the file
+	//   could not be opened or mapped
+	bool setPersistentFile(const QString &filePath);
+
 	void set(const QString &channel, const QString &id);
 	void remove(const QString &channel);
 	void clear();
@@ -58,6 +67,12 @@ private:
 	QHash<QString, Item> table_;
 	QMap<TimeStringPair, Item> recentlyUsed_;
 	int maxCapacity_;
+	QFile *persistFile_;
+	uchar *persistMap_;
+	quint32 persistSlotCount_;
+
+	void persistWrite(const QString &channel, const QString &id);
+	void persistRemove(const QString &channel);
 };
 
 #endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "publishspool.h"
+
+#include <assert.h>
+#include <string.h>
+#include <QFile>
+#include "log.h"
+
+#define SPOOL_HEADER_SIZE 16
+
+// file layout: header, then the ring area. messages are stored in the
+//   ring as a 4-byte length (host byte order) followed by the payload
+static const char * const spoolMagic = "PSPL";
+static quint32 spoolVersion = 1;
+
+PublishSpool::PublishSpool() :
+	file_(0),
+	map_(0),
+	ringSize_(0),
+	head_(0),
+	tail_(0),
+	depth_(0),
+	count_(0)
+{
+}
+
+PublishSpool::~PublishSpool()
+{
+	delete file_;
+}
+
+bool PublishSpool::setup(const QString &filePath, qint64 size)
+{
+	assert(!file_);
+	assert(size > 0);
+
+	QFile *f = new QFile(filePath);
+	if(!f->open(QFile::ReadWrite))
+	{
+		log_error("failed to open %s", qPrintable(filePath));
+		delete f;
+		return false;
+	}
+
+	// always start fresh. replaying stale publishes from a previous run
+	//   would do more harm than good. note that resizing makes a sparse
+	//   file on most filesystems, so the full capacity isn't allocated
+	//   up front
+	f->resize(0);
+	f->resize(SPOOL_HEADER_SIZE + size);
+
+	uchar *p = f->map(0, SPOOL_HEADER_SIZE + size);
+	if(!p)
+	{
+		log_error("failed to map %s", qPrintable(filePath));
+		delete f;
+		return false;
+	}
+
+	memcpy(p, spoolMagic, 4);
+	memcpy(p + 4, &spoolVersion, 4);
+
+	file_ = f;
+	map_ = p;
+	ringSize_ = size;
+	head_ = 0;
+	tail_ = 0;
+	depth_ = 0;
+	count_ = 0;
+
+	return true;
+}
+
+bool PublishSpool::append(const QByteArray &message)
+{
+	assert(map_);
+
+	qint64 need = 4 + message.size();
+	if(depth_ + need > ringSize_)
+		return false;
+
+	quint32 len = (quint32)message.size();
+	writeBytes((const char *)&len, 4);
+	writeBytes(message.data(), message.size());
+	++count_;
+
+	return true;
+}
+
+QByteArray PublishSpool::takeNext()
+{
+	if(count_ == 0)
+		return QByteArray();
+
+	quint32 len;
+	readBytes((char *)&len, 4);
+
+	QByteArray out;
+	out.resize((int)len);
+	readBytes(out.data(), len);
+	--count_;
+
+	return out;
+}
+
+void PublishSpool::writeBytes(const char *data, qint64 len)
+{
+	qint64 first = qMin(len, ringSize_ - tail_);
+	memcpy(map_ + SPOOL_HEADER_SIZE + tail_, data, first);
+	if(len > first)
+		memcpy(map_ + SPOOL_HEADER_SIZE, data + first, len - first);
+
+	tail_ = (tail_ + len) % ringSize_;
+	depth_ += len;
+}
+
+void PublishSpool::readBytes(char *dest, qint64 len)
+{
+	qint64 first = qMin(len, ringSize_ - head_);
+	memcpy(dest, map_ + SPOOL_HEADER_SIZE + head_, first);
+	if(len > first)
+		memcpy(dest + first, map_ + SPOOL_HEADER_SIZE, len - first);
+
+	head_ = (head_ + len) % ringSize_;
+	depth_ -= len;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef PUBLISHSPOOL_H
+#define PUBLISHSPOOL_H
+
+#include <QByteArray>
+#include <QString>
+
+class QFile;
+
+// file-backed ring buffer of raw publish messages, for absorbing
+//   ingest bursts that exceed fan-out capacity. the file is
+//   memory-mapped, so queued data stays off the heap and the OS is
+//   free to page it out under pressure. the spool is not persistent:
+//   it starts empty on every setup
+class PublishSpool
+{
+public:
+	PublishSpool();
+	~PublishSpool();
+
+	// size is the ring capacity in bytes
+	bool setup(const QString &filePath, qint64 size);
+
+	bool isReady() const { return map_ != 0; }
+	bool isEmpty() const { return count_ == 0; }
+	qint64 depth() const { return depth_; }
+	qint64 capacity() const { return ringSize_; }
+
+	// false means the ring is full and the message was not stored
+	bool append(const QByteArray &message);
+
+	// returns a null array if empty
+	QByteArray takeNext();
+
+private:
+	QFile *file_;
+	uchar *map_;
+	qint64 ringSize_;
+	qint64 head_;
+	qint64 tail_;
+	qint64 depth_;
+	qint64 count_;
+
+	void writeBytes(const char *data, qint64 len);
+	void readBytes(char *dest, qint64 len);
+};
+
+#endif
@@ -13,6 +13,8 @@ PRE_TARGETDEPS += $$PWD/../libpushpin-handler.a
 LIBS += -L$$PWD/../../corelib -lpushpin-core
 PRE_TARGETDEPS += $$PWD/../../corelib/libpushpin-core.a
 
+LIBS += -lz
+
 include($$OUT_PWD/../../../conf.pri)
 include(pushpin-handler.pri)
 
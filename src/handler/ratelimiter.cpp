@@ -30,6 +30,7 @@
 
 #include <QList>
 #include <QMap>
+#include <QPair>
 #include <QPointer>
 #include <QTimer>
 
@@ -53,10 +54,26 @@ public:
 		}
 	};
 
-	class Bucket
+	class SubQueue
 	{
 	public:
 		QList<ActionItem> actions;
+	};
+
+	// sub-queues are keyed by (negated priority, sub-key), so map
+	//   iteration order visits higher priority classes first
+	typedef QPair<int, QString> QueueKey;
+
+	// a top-level bucket (e.g. a route), containing a queue of actions
+	//   per sub-key (e.g. a channel). actions are taken from the sub
+	//   queues round-robin, so one hot sub-key can't starve the others
+	//   in the same bucket
+	class Bucket
+	{
+	public:
+		QMap<QueueKey, SubQueue> queues;
+		QueueKey lastQueueKey;
+		QueueKey lastAddedQueueKey;
 		int weight;
 		int debt;
 
@@ -68,14 +85,50 @@ public:
 
 		~Bucket()
 		{
-			foreach(const ActionItem &i, actions)
-				delete i.action;
+			QMapIterator<QueueKey, SubQueue> it(queues);
+			while(it.hasNext())
+			{
+				it.next();
+				foreach(const ActionItem &i, it.value().actions)
+					delete i.action;
+			}
+		}
+
+		bool isEmpty() const
+		{
+			return queues.isEmpty();
+		}
+
+		ActionItem takeNext()
+		{
+			// always drain from the highest priority class present,
+			//   round-robin within it
+			int negPriority = queues.begin().key().first;
+
+			QMap<QueueKey, SubQueue>::iterator it;
+			if(lastQueueKey.first == negPriority)
+				it = queues.upperBound(lastQueueKey);
+			else
+				it = queues.begin();
+			if(it == queues.end() || it.key().first != negPriority)
+				it = queues.begin();
+
+			lastQueueKey = it.key();
+
+			SubQueue &sq = it.value();
+			ActionItem ai = sq.actions.takeFirst();
+
+			if(sq.actions.isEmpty())
+				queues.erase(it);
+
+			return ai;
 		}
 	};
 
 	int rate;
 	int hwm;
 	bool batchWaitEnabled;
+	qint64 totalWeight; // summed over all buckets
 	QMap<QString, Bucket> buckets;
 	QString lastKey;
 	QTimer *timer;
@@ -89,6 +142,7 @@ public:
 		rate(-1),
 		hwm(-1),
 		batchWaitEnabled(false),
+		totalWeight(0),
 		batchInterval(-1),
 		batchSize(-1),
 		lastBatchEmpty(false)
@@ -131,14 +185,17 @@ public:
 		setup();
 	}
 
-	bool addAction(const QString &key, int weight, Action *action)
+	bool addAction(const QString &key, const QString &subKey, int weight, int priority, Action *action)
 	{
 		Bucket &bucket = buckets[key];
 		if(hwm > 0 && bucket.weight + weight > hwm)
 			return false;
 
-		bucket.actions += ActionItem(action, weight);
+		QueueKey queueKey(-priority, subKey);
+		bucket.queues[queueKey].actions += ActionItem(action, weight);
+		bucket.lastAddedQueueKey = queueKey;
 		bucket.weight += weight;
+		totalWeight += weight;
 
 		setup();
 		return true;
@@ -243,11 +300,12 @@ private:
 
 			if(bucket.debt <= 0)
 			{
-				ActionItem ai = bucket.actions.takeFirst();
+				ActionItem ai = bucket.takeNext();
 				Action *action = ai.action;
 				int weight = ai.weight;
 
 				bucket.weight -= weight;
+				totalWeight -= weight;
 
 				bool ret = action->execute();
 				delete action;
@@ -274,7 +332,7 @@ private:
 				++processed;
 			}
 
-			if(bucket.actions.isEmpty() && bucket.debt <= 0)
+			if(bucket.isEmpty() && bucket.debt <= 0)
 			{
 				lastKey = key;
 				it = buckets.erase(it);
@@ -331,9 +389,19 @@ void RateLimiter::setBatchWaitEnabled(bool on)
 	d->batchWaitEnabled = on;
 }
 
+qint64 RateLimiter::queuedWeight() const
+{
+	return d->totalWeight;
+}
+
 bool RateLimiter::addAction(const QString &key, Action *action, int weight)
 {
-	return d->addAction(key, weight, action);
+	return d->addAction(key, QString(), weight, 0, action);
+}
+
+bool RateLimiter::addAction(const QString &key, const QString &subKey, Action *action, int weight, int priority)
+{
+	return d->addAction(key, subKey, weight, priority, action);
 }
 
 RateLimiter::Action *RateLimiter::lastAction(const QString &key) const
@@ -341,8 +409,9 @@ RateLimiter::Action *RateLimiter::lastAction(const QString &key) const
 	if(d->buckets.contains(key))
 	{
 		const Private::Bucket &bucket = d->buckets[key];
-		if(!bucket.actions.isEmpty())
-			return bucket.actions.last().action;
+		QMap<Private::QueueKey, Private::SubQueue>::const_iterator it = bucket.queues.constFind(bucket.lastAddedQueueKey);
+		if(it != bucket.queues.constEnd() && !it.value().actions.isEmpty())
+			return it.value().actions.last().action;
 	}
 
 	return 0;
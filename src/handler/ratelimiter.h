@@ -51,7 +51,17 @@ public:
 	void setHwm(int hwm);
 	void setBatchWaitEnabled(bool on);
 
+	// total weight of all queued actions
+	qint64 queuedWeight() const;
+
 	bool addAction(const QString &key, Action *action, int weight = 1);
+
+	// actions sharing a key draw from that key's budget round-robin by
+	//   sub-key, so e.g. one hot channel can't starve the rest of its
+	//   route. sub-keys with a higher priority drain first; round-robin
+	//   applies within a priority class
+	bool addAction(const QString &key, const QString &subKey, Action *action, int weight = 1, int priority = 0);
+
 	Action *lastAction(const QString &key) const;
 
 private:
@@ -32,24 +32,59 @@
 #include "controlrequest.h"
 #include "statsmanager.h"
 
-RefreshWorker::RefreshWorker(ZrpcRequest *req, ZrpcManager *proxyControlClient, QObject *parent) :
+// a channel sweep keeps at most this many proxy refresh calls pending.
+//   progress continues from completion callbacks, so a refresh of a
+//   popular channel never occupies more than a sliver of any one event
+//   loop turn
+#define REFRESHES_IN_FLIGHT_MAX 10
+
+// cids per batched refresh call during a channel sweep
+#define REFRESH_BATCH_MAX 100
+
+RefreshWorker::RefreshWorker(ZrpcRequest *req, ZrpcManager *proxyControlClient, const QStringList &channelCids, QObject *parent) :
 	Deferred(parent),
+	ignoreErrors_(false),
+	inFlight_(0),
+	proxyControlClient_(proxyControlClient),
 	req_(req)
 {
 	req_->setParent(this);
 
 	QVariantHash args = req_->args();
 
-	if(!args.contains("cid") || args["cid"].type() != QVariant::ByteArray)
+	if(args.contains("cid"))
+	{
+		if(args["cid"].type() != QVariant::ByteArray)
+		{
+			respondError("bad-request");
+			return;
+		}
+
+		cids_ += args["cid"].toByteArray();
+	}
+	else if(args.contains("channel"))
+	{
+		if(args["channel"].type() != QVariant::ByteArray)
+		{
+			respondError("bad-request");
+			return;
+		}
+
+		// a sweep over a channel's sessions is best effort. sessions
+		//   come and go while it runs, so individual failures don't
+		//   fail the command
+		foreach(const QString &cid, channelCids)
+			cids_ += cid.toUtf8();
+
+		ignoreErrors_ = true;
+	}
+	else
 	{
 		respondError("bad-request");
 		return;
 	}
 
-	QByteArray cid = args["cid"].toByteArray();
-
-	Deferred *d = ControlRequest::refresh(proxyControlClient, cid, this);
-	connect(d, &Deferred::finished, this, &RefreshWorker::proxyRefresh_finished);
+	refreshNext();
 }
 
 void RefreshWorker::respondError(const QByteArray &condition)
@@ -58,15 +93,46 @@ void RefreshWorker::respondError(const QByteArray &condition)
 	setFinished(true);
 }
 
-void RefreshWorker::proxyRefresh_finished(const DeferredResult &result)
+void RefreshWorker::refreshNext()
 {
-	if(result.success)
+	while(!cids_.isEmpty() && inFlight_ < REFRESHES_IN_FLIGHT_MAX)
+	{
+		Deferred *d;
+
+		if(ignoreErrors_)
+		{
+			// channel sweep: many cids share one round-trip
+			QList<QByteArray> batch;
+			while(!cids_.isEmpty() && batch.count() < REFRESH_BATCH_MAX)
+				batch += cids_.takeFirst();
+
+			d = ControlRequest::refreshBatch(proxyControlClient_, batch, this);
+		}
+		else
+		{
+			d = ControlRequest::refresh(proxyControlClient_, cids_.takeFirst(), this);
+		}
+
+		connect(d, &Deferred::finished, this, &RefreshWorker::proxyRefresh_finished);
+		++inFlight_;
+	}
+
+	if(cids_.isEmpty() && inFlight_ == 0)
 	{
 		req_->respond();
 		setFinished(true);
 	}
-	else
+}
+
+void RefreshWorker::proxyRefresh_finished(const DeferredResult &result)
+{
+	--inFlight_;
+
+	if(!result.success && !ignoreErrors_)
 	{
 		respondError(result.value.toByteArray());
+		return;
 	}
+
+	refreshNext();
 }
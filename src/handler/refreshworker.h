@@ -30,6 +30,8 @@
 #define REFRESHWORKER_H
 
 #include <QByteArray>
+#include <QList>
+#include <QStringList>
 #include "deferred.h"
 
 class ZrpcRequest;
@@ -41,12 +43,20 @@ class RefreshWorker : public Deferred
 	Q_OBJECT
 
 public:
-	RefreshWorker(ZrpcRequest *req, ZrpcManager *proxyControlClient, QObject *parent = 0);
+	// channelCids are the connection ids currently subscribed to the
+	//   requested channel, resolved by the caller. only used when the
+	//   request args contain "channel" rather than "cid"
+	RefreshWorker(ZrpcRequest *req, ZrpcManager *proxyControlClient, const QStringList &channelCids, QObject *parent = 0);
 
 private:
+	bool ignoreErrors_;
+	int inFlight_;
+	QList<QByteArray> cids_;
+	ZrpcManager *proxyControlClient_;
 	ZrpcRequest *req_;
 
 	void respondError(const QByteArray &condition);
+	void refreshNext();
 
 private slots:
 	void proxyRefresh_finished(const DeferredResult &result);
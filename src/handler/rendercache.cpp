@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "rendercache.h"
+
+#include "stablehash.h"
+
+bool RenderCache::contains(const QByteArray &key) const
+{
+	return cache_.contains(key);
+}
+
+QByteArray RenderCache::value(const QByteArray &key) const
+{
+	return cache_.value(key);
+}
+
+void RenderCache::insert(const QByteArray &key, const QByteArray &body)
+{
+	cache_.insert(key, body);
+}
+
+QByteArray RenderCache::makeKey(PublishFormat::Type type, const QStringList &filters, const QHash<QString, QString> &subscriptionMeta, const QHash<QString, QString> &prevIds, const QByteArray &patchSource)
+{
+	QByteArray key = QByteArray::number((int)type);
+
+	if(!patchSource.isNull())
+		key += '|' + QByteArray::number(stableHash64(patchSource), 16);
+
+	foreach(const QString &f, filters)
+		key += '|' + f.toUtf8();
+
+	// hash iteration order is unstable, so sort for a canonical key
+	QStringList metaKeys = subscriptionMeta.keys();
+	metaKeys.sort();
+	foreach(const QString &k, metaKeys)
+		key += '|' + k.toUtf8() + '=' + subscriptionMeta.value(k).toUtf8();
+
+	QStringList prevIdKeys = prevIds.keys();
+	prevIdKeys.sort();
+	foreach(const QString &k, prevIdKeys)
+		key += '|' + k.toUtf8() + '=' + prevIds.value(k).toUtf8();
+
+	return key;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include "publishformat.h"
+
+// caches rendered message bodies for the lifetime of a single publish.
+//   subscribers whose filters and template vars are identical share one
+//   render instead of each processing the content separately. the cache
+//   is shared across subscribers by reference (see PublishItem), so it
+//   goes away once the fan-out completes.
+class RenderCache
+{
+public:
+	bool contains(const QByteArray &key) const;
+	QByteArray value(const QByteArray &key) const;
+	void insert(const QByteArray &key, const QByteArray &body);
+
+	// key covers everything a content filter's output can depend on.
+	//   for body-patch deliveries, pass the input body as patchSource so
+	//   that sessions holding identical responses share one patched
+	//   render
+	static QByteArray makeKey(PublishFormat::Type type, const QStringList &filters, const QHash<QString, QString> &subscriptionMeta, const QHash<QString, QString> &prevIds = QHash<QString, QString>(), const QByteArray &patchSource = QByteArray());
+
+private:
+	QHash<QByteArray, QByteArray> cache_;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "replayring.h"
+
+#define RING_CHANNELS_MAX 10000
+
+ReplayRing::ReplayRing(int maxItems, qint64 maxBytes, int ttl) :
+	maxItems_(maxItems),
+	maxBytes_(maxBytes),
+	ttl_(ttl),
+	rings_(RING_CHANNELS_MAX)
+{
+}
+
+void ReplayRing::setLimits(int maxItems, qint64 maxBytes, int ttl)
+{
+	maxItems_ = maxItems;
+	maxBytes_ = maxBytes;
+	ttl_ = ttl;
+}
+
+void ReplayRing::add(const PublishItem &item, qint64 now)
+{
+	if(item.id.isEmpty())
+		return;
+
+	ChannelRing *ring = rings_.object(item.channel);
+	if(!ring)
+	{
+		ring = new ChannelRing;
+		rings_.insert(item.channel, ring);
+	}
+
+	Entry e;
+	e.item = item;
+	e.time = now;
+
+	ring->entries += e;
+	ring->bytes += itemBytes(item);
+
+	trim(ring, now);
+}
+
+bool ReplayRing::contains(const QString &channel, const QString &prevId, qint64 now) const
+{
+	ChannelRing *ring = rings_.object(channel);
+	if(!ring)
+		return false;
+
+	foreach(const Entry &e, ring->entries)
+	{
+		if(now - e.time > (qint64)ttl_ * 1000)
+			continue;
+
+		if(e.item.id == prevId)
+			return true;
+	}
+
+	return false;
+}
+
+QList<PublishItem> ReplayRing::itemsSince(const QString &channel, const QString &prevId, qint64 now, bool *ok) const
+{
+	QList<PublishItem> out;
+
+	ChannelRing *ring = rings_.object(channel);
+	if(!ring)
+	{
+		*ok = false;
+		return out;
+	}
+
+	bool found = false;
+	foreach(const Entry &e, ring->entries)
+	{
+		if(now - e.time > (qint64)ttl_ * 1000)
+			continue;
+
+		if(found)
+			out += e.item;
+		else if(e.item.id == prevId)
+			found = true;
+	}
+
+	if(!found)
+	{
+		*ok = false;
+		out.clear();
+		return out;
+	}
+
+	*ok = true;
+	return out;
+}
+
+void ReplayRing::trim(ChannelRing *ring, qint64 now) const
+{
+	while(!ring->entries.isEmpty())
+	{
+		const Entry &first = ring->entries.first();
+
+		if(ring->entries.count() > maxItems_ || ring->bytes > maxBytes_ || now - first.time > (qint64)ttl_ * 1000)
+		{
+			ring->bytes -= itemBytes(first.item);
+			ring->entries.removeFirst();
+		}
+		else
+			break;
+	}
+}
+
+qint64 ReplayRing::itemBytes(const PublishItem &item)
+{
+	qint64 total = 0;
+
+	QHashIterator<PublishFormat::Type, PublishFormat> it(item.formats);
+	while(it.hasNext())
+	{
+		it.next();
+		total += it.value().body.size();
+	}
+
+	return total;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef REPLAYRING_H
+#define REPLAYRING_H
+
+#include <QCache>
+#include "publishitem.h"
+
+// bounded ring of recent published items per channel, for serving
+//   last-id catch-up from memory instead of retrying to the origin.
+//   items without an id aren't retained, since gaps can only be
+//   located by id
+class ReplayRing
+{
+public:
+	ReplayRing(int maxItems = 64, qint64 maxBytes = 262144, int ttl = 60);
+
+	// limits apply per channel. ttl is in seconds
+	void setLimits(int maxItems, qint64 maxBytes, int ttl);
+
+	void add(const PublishItem &item, qint64 now);
+
+	// whether prevId is within the retained window for the channel
+	bool contains(const QString &channel, const QString &prevId, qint64 now) const;
+
+	// the items published after prevId, oldest first. ok is set to
+	//   false if prevId is not within the retained window
+	QList<PublishItem> itemsSince(const QString &channel, const QString &prevId, qint64 now, bool *ok) const;
+
+private:
+	class Entry
+	{
+	public:
+		PublishItem item;
+		qint64 time;
+	};
+
+	class ChannelRing
+	{
+	public:
+		QList<Entry> entries;
+		qint64 bytes;
+
+		ChannelRing() :
+			bytes(0)
+		{
+		}
+	};
+
+	int maxItems_;
+	qint64 maxBytes_;
+	int ttl_;
+	QCache<QString, ChannelRing> rings_;
+
+	void trim(ChannelRing *ring, qint64 now) const;
+	static qint64 itemBytes(const PublishItem &item);
+};
+
+#endif
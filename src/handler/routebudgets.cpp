@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "routebudgets.h"
+
+#include <QDateTime>
+
+RouteBudgets::RouteBudgets() :
+	maxConnections_(-1),
+	maxHeldBytes_(-1),
+	maxSubscriptions_(-1),
+	totalHeldBytes_(0),
+	holdsRejected_(0)
+{
+}
+
+void RouteBudgets::setMaxConnections(int max)
+{
+	maxConnections_ = max;
+}
+
+void RouteBudgets::setMaxHeldBytes(qint64 max)
+{
+	maxHeldBytes_ = max;
+}
+
+void RouteBudgets::setMaxSubscriptions(int max)
+{
+	maxSubscriptions_ = max;
+}
+
+void RouteBudgets::addConnection(const QString &route, qint64 heldBytes)
+{
+	Entry &e = entries_[route];
+	++e.connections;
+	e.heldBytes += heldBytes;
+	totalHeldBytes_ += heldBytes;
+}
+
+void RouteBudgets::removeConnection(const QString &route, qint64 heldBytes)
+{
+	if(!entries_.contains(route))
+		return;
+
+	Entry &e = entries_[route];
+	e.connections = qMax(e.connections - 1, 0);
+
+	// clamp rather than go negative, in case the route changed
+	//   between add and remove
+	qint64 removed = qMin(heldBytes, e.heldBytes);
+	e.heldBytes -= removed;
+	totalHeldBytes_ -= removed;
+
+	removeIfEmpty(route);
+}
+
+void RouteBudgets::addSubscription(const QString &route)
+{
+	++entries_[route].subscriptions;
+}
+
+void RouteBudgets::removeSubscription(const QString &route)
+{
+	if(!entries_.contains(route))
+		return;
+
+	Entry &e = entries_[route];
+	e.subscriptions = qMax(e.subscriptions - 1, 0);
+
+	removeIfEmpty(route);
+}
+
+void RouteBudgets::addPublishBytes(const QString &route, qint64 bytes)
+{
+	Entry &e = entries_[route];
+	rollWindow(&e, QDateTime::currentMSecsSinceEpoch() / 1000);
+	e.publishBytes += bytes;
+}
+
+bool RouteBudgets::canAcceptHold(const QString &route, int count, qint64 bytes) const
+{
+	const Entry e = entries_.value(route);
+
+	if(maxConnections_ >= 0 && e.connections + count > maxConnections_)
+		return false;
+
+	if(maxHeldBytes_ >= 0 && e.heldBytes + bytes > maxHeldBytes_)
+		return false;
+
+	if(maxSubscriptions_ >= 0 && e.subscriptions > maxSubscriptions_)
+		return false;
+
+	return true;
+}
+
+void RouteBudgets::recordHoldRejected(const QString &route)
+{
+	Q_UNUSED(route);
+
+	++holdsRejected_;
+}
+
+int RouteBudgets::connections(const QString &route) const
+{
+	return entries_.value(route).connections;
+}
+
+qint64 RouteBudgets::heldBytes(const QString &route) const
+{
+	return entries_.value(route).heldBytes;
+}
+
+int RouteBudgets::subscriptions(const QString &route) const
+{
+	return entries_.value(route).subscriptions;
+}
+
+qint64 RouteBudgets::publishRate(const QString &route) const
+{
+	if(!entries_.contains(route))
+		return 0;
+
+	Entry e = entries_.value(route);
+	rollWindow(&e, QDateTime::currentMSecsSinceEpoch() / 1000);
+	return e.publishPrevBytes;
+}
+
+qint64 RouteBudgets::totalHeldBytes() const
+{
+	return totalHeldBytes_;
+}
+
+quint64 RouteBudgets::holdsRejected() const
+{
+	return holdsRejected_;
+}
+
+void RouteBudgets::removeIfEmpty(const QString &route)
+{
+	const Entry &e = entries_[route];
+	if(e.connections == 0 && e.heldBytes == 0 && e.subscriptions == 0)
+		entries_.remove(route);
+}
+
+void RouteBudgets::rollWindow(Entry *e, qint64 nowSecs)
+{
+	if(nowSecs == e->publishWindowStart)
+		return;
+
+	// a gap of more than one second means the previous complete
+	//   window had no traffic
+	e->publishPrevBytes = (nowSecs == e->publishWindowStart + 1) ? e->publishBytes : 0;
+	e->publishBytes = 0;
+	e->publishWindowStart = nowSecs;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef ROUTEBUDGETS_H
+#define ROUTEBUDGETS_H
+
+#include <QString>
+#include <QHash>
+
+// per-route resource accounting: held connections, retained body
+//   bytes, subscriptions, and delivered publish bytes. budgets apply
+//   uniformly to every route, so one route filling up throttles that
+//   route instead of exhausting the process
+class RouteBudgets
+{
+public:
+	RouteBudgets();
+
+	// -1 means unlimited
+	void setMaxConnections(int max);
+	void setMaxHeldBytes(qint64 max);
+	void setMaxSubscriptions(int max);
+
+	// callers must pass the same byte count at removal that they
+	//   passed at add, as the accounting doesn't track individual
+	//   connections
+	void addConnection(const QString &route, qint64 heldBytes = 0);
+	void removeConnection(const QString &route, qint64 heldBytes = 0);
+
+	void addSubscription(const QString &route);
+	void removeSubscription(const QString &route);
+
+	// delivered publish bytes, windowed per second
+	void addPublishBytes(const QString &route, qint64 bytes);
+
+	// whether the route can take on count more held connections
+	//   retaining bytes more body data. also false if the route is
+	//   already over its subscription budget
+	bool canAcceptHold(const QString &route, int count, qint64 bytes) const;
+	void recordHoldRejected(const QString &route);
+
+	int connections(const QString &route) const;
+	qint64 heldBytes(const QString &route) const;
+	int subscriptions(const QString &route) const;
+
+	// bytes delivered during the most recent complete one-second
+	//   window
+	qint64 publishRate(const QString &route) const;
+
+	qint64 totalHeldBytes() const;
+	quint64 holdsRejected() const;
+
+private:
+	class Entry
+	{
+	public:
+		int connections;
+		qint64 heldBytes;
+		int subscriptions;
+		qint64 publishBytes;
+		qint64 publishPrevBytes;
+		qint64 publishWindowStart; // seconds since epoch
+
+		Entry() :
+			connections(0),
+			heldBytes(0),
+			subscriptions(0),
+			publishBytes(0),
+			publishPrevBytes(0),
+			publishWindowStart(0)
+		{
+		}
+	};
+
+	int maxConnections_;
+	qint64 maxHeldBytes_;
+	int maxSubscriptions_;
+	QHash<QString, Entry> entries_;
+	qint64 totalHeldBytes_;
+	quint64 holdsRejected_;
+
+	void removeIfEmpty(const QString &route);
+	static void rollWindow(Entry *e, qint64 nowSecs);
+};
+
+#endif
@@ -28,15 +28,21 @@
 
 #include "sequencer.h"
 
+#include <utility>
+#include <QSet>
 #include <QDateTime>
 #include <QTimer>
+#include "stablehash.h"
 #include "log.h"
 #include "publishitem.h"
 #include "publishlastids.h"
 
 #define CHANNEL_PENDING_MAX 100
+#define PENDING_TOTAL_MAX 10000
+#define PENDING_EVICT_LOG_INTERVAL 1000
 #define PENDING_EXPIRE 5000
 #define EXPIRE_INTERVAL 1000
+#define SLOW_PATH_LOG_INTERVAL 10000
 
 class Sequencer::Private : public QObject
 {
@@ -61,27 +67,30 @@ public:
 		}
 	};
 
-	class CachedId
-	{
-	public:
-		qint64 expireTime;
-		QString channel;
-		QString id;
-	};
-
 	Sequencer *q;
 	PublishLastIds *lastIds;
 	QHash<QString, ChannelPendingItems> pendingItemsByChannel;
 	QMap<QPair<qint64, PendingItem*>, PendingItem*> pendingItemsByTime;
 	QTimer *expireTimer;
+	quint64 pendingEvictedCount;
+	quint64 fastPathCount;
+	quint64 slowPathCount;
 	int idCacheTtl;
-	QHash<QPair<QString, QString>, CachedId*> idCacheById;
-	QMap<QPair<qint64, CachedId*>, CachedId*> idCacheByExpireTime;
+
+	// seen ids are tracked as 64-bit fingerprints rather than storing
+	//   the channel/id strings, so a tracked id costs tens of bytes
+	//   instead of hundreds. expiration times are monotonic, so a plain
+	//   list in insertion order serves as the expiry queue
+	QSet<quint64> idCache; // fingerprints
+	QList<QPair<qint64, quint64> > idCacheByTime; // (expire time, fingerprint)
 
 	Private(Sequencer *_q, PublishLastIds *_publishLastIds) :
 		QObject(_q),
 		q(_q),
 		lastIds(_publishLastIds),
+		pendingEvictedCount(0),
+		fastPathCount(0),
+		slowPathCount(0),
 		idCacheTtl(-1)
 	{
 		expireTimer = new QTimer(this);
@@ -93,42 +102,33 @@ public:
 		expireTimer->disconnect(this);
 		expireTimer->setParent(0);
 		expireTimer->deleteLater();
-
-		qDeleteAll(idCacheById);
 	}
 
-	void addItem(const PublishItem &item, bool seq)
+	void addItem(PublishItem item, bool seq)
 	{
 		qint64 now = QDateTime::currentMSecsSinceEpoch();
 
-		while(!idCacheByExpireTime.isEmpty())
+		while(!idCacheByTime.isEmpty() && idCacheByTime.first().first <= now)
 		{
-			QMap<QPair<qint64, CachedId*>, CachedId*>::iterator it = idCacheByExpireTime.begin();
-			CachedId *i = it.value();
-
-			if(i->expireTime > now)
-				break;
-
-			idCacheById.remove(QPair<QString, QString>(i->channel, i->id));
-			idCacheByExpireTime.erase(it);
-			delete i;
+			idCache.remove(idCacheByTime.first().second);
+			idCacheByTime.removeFirst();
 		}
 
 		if(!item.id.isNull() && idCacheTtl > 0)
 		{
-			QPair<QString, QString> idKey(item.channel, item.id);
-			if(idCacheById.contains(idKey))
+			// a fingerprint collision wrongly drops a message, but at
+			//   64 bits the odds stay negligible even with tens of
+			//   millions of tracked ids
+			quint64 fp = stableHash64(item.channel.toUtf8() + '\0' + item.id.toUtf8());
+
+			if(idCache.contains(fp))
 			{
 				// we've seen this ID recently, drop the message
 				return;
 			}
 
-			CachedId *i = new CachedId;
-			i->expireTime = now + (idCacheTtl * 1000);
-			i->channel = item.channel;
-			i->id = item.id;
-			idCacheById.insert(idKey, i);
-			idCacheByExpireTime.insert(QPair<qint64, CachedId*>(i->expireTime, i), i);
+			idCache += fp;
+			idCacheByTime += QPair<qint64, quint64>(now + (idCacheTtl * 1000), fp);
 		}
 
 		if(!seq)
@@ -138,28 +138,83 @@ public:
 		}
 
 		QString lastId = lastIds->value(item.channel);
+		bool inOrder = (lastId.isNull() || item.prevId.isNull() || lastId == item.prevId);
+
+		// fast path: in-order arrival with nothing buffered for the
+		//   channel. forward straight through, touching only the
+		//   last-ids table. well-behaved publishers take this path
+		//   nearly always, so it allocates nothing and never looks at
+		//   the pending machinery
+		if(inOrder && !pendingItemsByChannel.contains(item.channel))
+		{
+			++fastPathCount;
 
-		if(!lastId.isNull() && !item.prevId.isNull() && lastId != item.prevId)
+			if(!item.id.isNull())
+				lastIds->set(item.channel, item.id);
+			else
+				lastIds->remove(item.channel);
+
+			emit q->itemReady(item);
+			return;
+		}
+
+		++slowPathCount;
+		if((slowPathCount % SLOW_PATH_LOG_INTERVAL) == 0)
+			log_debug("sequencer: %llu items in-order, %llu buffered/chained", (unsigned long long)fastPathCount, (unsigned long long)slowPathCount);
+
+		if(!inOrder)
 		{
-			ChannelPendingItems &channelPendingItems = pendingItemsByChannel[item.channel];
+			ChannelPendingItems *channelPendingItems = 0;
+			QHash<QString, ChannelPendingItems>::iterator cit = pendingItemsByChannel.find(item.channel);
+			if(cit != pendingItemsByChannel.end())
+				channelPendingItems = &cit.value();
 
-			if(channelPendingItems.itemsByPrevId.contains(item.prevId))
+			if(channelPendingItems && channelPendingItems->itemsByPrevId.contains(item.prevId))
 			{
 				log_debug("sequencer: already have item for channel [%s] depending on prev-id [%s], dropping", qPrintable(item.channel), qPrintable(item.prevId));
 				return;
 			}
 
-			if(channelPendingItems.itemsByPrevId.count() >= CHANNEL_PENDING_MAX)
+			if(pendingItemsByTime.count() >= PENDING_TOTAL_MAX)
+			{
+				// evict the oldest pending item overall
+				evictPendingItem(pendingItemsByTime.begin().value());
+			}
+			else if(channelPendingItems && channelPendingItems->itemsByPrevId.count() >= CHANNEL_PENDING_MAX)
 			{
-				log_debug("sequencer: too many pending items for channel [%s], dropping", qPrintable(item.channel));
+				// evict the oldest pending item for the channel. bounded
+				//   scan, since the channel holds at most
+				//   CHANNEL_PENDING_MAX items
+				PendingItem *oldest = 0;
+				QHashIterator<QString, PendingItem*> it(channelPendingItems->itemsByPrevId);
+				while(it.hasNext())
+				{
+					it.next();
+					if(!oldest || it.value()->time < oldest->time)
+						oldest = it.value();
+				}
+
+				evictPendingItem(oldest);
+			}
+
+			// eviction may have advanced the channel past our prev-id
+			lastId = lastIds->value(item.channel);
+			if(lastId.isNull() || lastId == item.prevId)
+			{
+				sendItem(item);
 				return;
 			}
 
 			PendingItem *i = new PendingItem;
 			i->time = now;
-			i->item = item;
 
-			channelPendingItems.itemsByPrevId.insert(item.prevId, i);
+			QString channel = item.channel;
+			QString prevId = item.prevId;
+			i->item = std::move(item);
+
+			// note: look up the channel again, since eviction may have
+			//   restructured the hash
+			pendingItemsByChannel[channel].itemsByPrevId.insert(prevId, i);
 			pendingItemsByTime.insert(QPair<qint64, PendingItem*>(i->time, i), i);
 
 			if(!expireTimer->isActive())
@@ -188,6 +243,33 @@ public:
 		pendingItemsByChannel.remove(channel);
 	}
 
+	// remove a pending item and send it on early. used when a pending
+	//   limit is reached, so that memory stays bounded even if a
+	//   publisher restarts without sequencing
+	void evictPendingItem(PendingItem *i)
+	{
+		PublishItem item = i->item;
+
+		ChannelPendingItems &channelPendingItems = pendingItemsByChannel[item.channel];
+		channelPendingItems.itemsByPrevId.remove(item.prevId);
+		pendingItemsByTime.remove(QPair<qint64, PendingItem*>(i->time, i));
+		delete i;
+
+		if(channelPendingItems.itemsByPrevId.isEmpty())
+		{
+			pendingItemsByChannel.remove(item.channel);
+
+			if(pendingItemsByChannel.isEmpty())
+				expireTimer->stop();
+		}
+
+		++pendingEvictedCount;
+		if(pendingEvictedCount == 1 || (pendingEvictedCount % PENDING_EVICT_LOG_INTERVAL) == 0)
+			log_warning("sequencer: pending limit reached, flushed %llu items early so far", (unsigned long long)pendingEvictedCount);
+
+		sendItem(item);
+	}
+
 	void sendItem(const PublishItem &item)
 	{
 		if(!item.id.isNull())
@@ -289,9 +371,24 @@ void Sequencer::addItem(const PublishItem &item, bool seq)
 	d->addItem(item, seq);
 }
 
+void Sequencer::addItem(PublishItem &&item, bool seq)
+{
+	d->addItem(std::move(item), seq);
+}
+
 void Sequencer::clearPendingForChannel(const QString &channel)
 {
 	d->clear(channel);
 }
 
+quint64 Sequencer::fastPathCount() const
+{
+	return d->fastPathCount;
+}
+
+quint64 Sequencer::slowPathCount() const
+{
+	return d->slowPathCount;
+}
+
 #include "sequencer.moc"
@@ -48,8 +48,16 @@ public:
 	// note: may emit signals
 	void addItem(const PublishItem &item, bool seq = true);
 
+	// rvalue variant, so callers done with the item can avoid a copy
+	void addItem(PublishItem &&item, bool seq = true);
+
 	void clearPendingForChannel(const QString &channel);
 
+	// diagnostic counters: items forwarded without touching the pending
+	//   machinery vs. items that engaged it
+	quint64 fastPathCount() const;
+	quint64 slowPathCount() const;
+
 signals:
 	void itemReady(const PublishItem &item);
 
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "sessionupdater.h"
+
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "log.h"
+#include "deferred.h"
+#include "sessionrequest.h"
+
+// sids per session-update-many call
+#define UPDATE_MANY_MAX 500
+
+// how long after a create-or-update a sid is assumed to still exist
+//   in the store. long-poll reconnect intervals are shorter than
+//   this, so reconnect storms hit the batched update path
+#define CREATE_CACHE_TTL (60 * 1000)
+
+// bound on remembered sids. pruned of expired entries when exceeded
+#define CREATE_CACHE_MAX 100000
+
+class SessionUpdater::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	SessionUpdater *q;
+	ZrpcManager *stateClient;
+	QHash<QString, LastIds> pendingUpdates;
+	QHash<QString, LastIds> pendingCreates;
+	QHash<QString, qint64> createTimes;
+	QElapsedTimer time;
+	QTimer *flushTimer;
+	QSet<Deferred*> deferreds;
+
+	Private(SessionUpdater *_q, ZrpcManager *_stateClient) :
+		QObject(_q),
+		q(_q),
+		stateClient(_stateClient)
+	{
+		time.start();
+
+		flushTimer = new QTimer(this);
+		connect(flushTimer, &QTimer::timeout, this, &Private::flushTimer_timeout);
+		flushTimer->setSingleShot(true);
+	}
+
+	~Private()
+	{
+		qDeleteAll(deferreds);
+	}
+
+	void scheduleFlush()
+	{
+		if(!flushTimer->isActive())
+			flushTimer->start(0);
+	}
+
+	void mergeInto(QHash<QString, LastIds> *pending, const QString &sid, const LastIds &lastIds)
+	{
+		LastIds &cur = (*pending)[sid];
+
+		QHashIterator<QString, QString> it(lastIds);
+		while(it.hasNext())
+		{
+			it.next();
+			cur[it.key()] = it.value();
+		}
+	}
+
+	void update(const QString &sid, const LastIds &lastIds)
+	{
+		// if a create is already queued for this sid, fold in there
+		//   so the create isn't overwritten by a plain update
+		if(pendingCreates.contains(sid))
+			mergeInto(&pendingCreates, sid, lastIds);
+		else
+			mergeInto(&pendingUpdates, sid, lastIds);
+
+		scheduleFlush();
+	}
+
+	void createOrUpdate(const QString &sid, const LastIds &lastIds)
+	{
+		qint64 createTime = createTimes.value(sid, -1);
+		if(createTime >= 0 && time.elapsed() - createTime < CREATE_CACHE_TTL)
+		{
+			// written recently, so the store already has the session
+			update(sid, lastIds);
+			return;
+		}
+
+		mergeInto(&pendingCreates, sid, lastIds);
+		scheduleFlush();
+	}
+
+	void pruneCreateTimes()
+	{
+		qint64 now = time.elapsed();
+
+		QMutableHashIterator<QString, qint64> it(createTimes);
+		while(it.hasNext())
+		{
+			it.next();
+			if(now - it.value() >= CREATE_CACHE_TTL)
+				it.remove();
+		}
+	}
+
+private slots:
+	void flushTimer_timeout()
+	{
+		// creates go out individually, as the verb has no multi form
+		QHashIterator<QString, LastIds> it(pendingCreates);
+		while(it.hasNext())
+		{
+			it.next();
+
+			Deferred *d = SessionRequest::createOrUpdate(stateClient, it.key(), it.value(), this);
+			connect(d, &Deferred::finished, this, &Private::sessionCreateOrUpdate_finished);
+			deferreds += d;
+
+			createTimes[it.key()] = time.elapsed();
+		}
+
+		pendingCreates.clear();
+
+		if(createTimes.count() > CREATE_CACHE_MAX)
+			pruneCreateTimes();
+
+		while(!pendingUpdates.isEmpty())
+		{
+			QHash<QString, LastIds> sidLastIds;
+
+			QMutableHashIterator<QString, LastIds> it(pendingUpdates);
+			while(it.hasNext() && sidLastIds.count() < UPDATE_MANY_MAX)
+			{
+				it.next();
+				sidLastIds.insert(it.key(), it.value());
+				it.remove();
+			}
+
+			Deferred *d = SessionRequest::updateMany(stateClient, sidLastIds, this);
+			connect(d, &Deferred::finished, this, &Private::sessionUpdateMany_finished);
+			deferreds += d;
+		}
+	}
+
+	void sessionCreateOrUpdate_finished(const DeferredResult &result)
+	{
+		Deferred *d = (Deferred *)sender();
+		deferreds.remove(d);
+
+		if(!result.success)
+			log_error("couldn't create/update session: condition=%d", result.value.toInt());
+	}
+
+	void sessionUpdateMany_finished(const DeferredResult &result)
+	{
+		Deferred *d = (Deferred *)sender();
+		deferreds.remove(d);
+
+		if(!result.success)
+			log_error("couldn't update session: condition=%d", result.value.toInt());
+	}
+};
+
+SessionUpdater::SessionUpdater(ZrpcManager *stateClient, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, stateClient);
+}
+
+SessionUpdater::~SessionUpdater()
+{
+	delete d;
+}
+
+void SessionUpdater::update(const QString &sid, const LastIds &lastIds)
+{
+	d->update(sid, lastIds);
+}
+
+void SessionUpdater::createOrUpdate(const QString &sid, const LastIds &lastIds)
+{
+	d->createOrUpdate(sid, lastIds);
+}
+
+#include "sessionupdater.moc"
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef SESSIONUPDATER_H
+#define SESSIONUPDATER_H
+
+#include <QObject>
+#include "lastids.h"
+
+class ZrpcManager;
+
+// write-behind front end for the session store. updates registered
+//   within the same event loop turn are merged into a single
+//   session-update-many call instead of one call per session, so
+//   accept and reconnect bursts don't multiply round-trips. results
+//   are not reported back; failures are logged
+class SessionUpdater : public QObject
+{
+	Q_OBJECT
+
+public:
+	SessionUpdater(ZrpcManager *stateClient, QObject *parent = 0);
+	~SessionUpdater();
+
+	// queue an update of a session's last ids. ids for the same sid
+	//   merge, newest value winning. the session must be known to
+	//   exist in the store
+	void update(const QString &sid, const LastIds &lastIds = LastIds());
+
+	// like update, but creates the session if the store doesn't have
+	//   it. sids written recently through this path are known to
+	//   exist and fold into the batched update instead
+	void createOrUpdate(const QString &sid, const LastIds &lastIds = LastIds());
+
+private:
+	class Private;
+	Private *d;
+};
+
+#endif
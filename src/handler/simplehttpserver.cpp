@@ -37,7 +37,45 @@
 #define MAX_HEADERS_SIZE 10000
 #define MAX_BODY_SIZE 1000000
 
-class SimpleHttpRequest::Private : public QObject
+class SimpleHttpRequest::Private
+{
+public:
+	SimpleHttpRequest *q;
+
+	// the connection currently serving this request, or 0 if the
+	//   connection went away
+	SimpleHttpConnection *conn;
+
+	QString method;
+	QByteArray uri;
+	HttpHeaders reqHeaders;
+	QByteArray reqBody;
+
+	Private(SimpleHttpRequest *_q) :
+		q(_q),
+		conn(0)
+	{
+	}
+
+	inline void respond(int code, const QByteArray &reason, const HttpHeaders &headers, const QByteArray &body);
+
+	void respond(int code, const QByteArray &reason, const QString &body)
+	{
+		HttpHeaders headers;
+		headers += HttpHeader("Content-Type", "text/plain");
+
+		respond(code, reason, headers, body.toUtf8());
+	}
+
+	void emitFinished()
+	{
+		emit q->finished();
+	}
+};
+
+// a persistent connection. requests are parsed and handled in order,
+//   one at a time, so a client may pipeline
+class SimpleHttpConnection : public QObject
 {
 	Q_OBJECT
 
@@ -46,36 +84,35 @@ public:
 	{
 		ReadHeader,
 		ReadBody,
-		WriteBody,
+		Handling,
 		WaitForWritten,
 		Closing
 	};
 
-	SimpleHttpRequest *q;
 	QTcpSocket *sock;
 	State state;
 	QByteArray inBuf;
 	bool version1dot0;
-	QString method;
-	QByteArray uri;
-	HttpHeaders reqHeaders;
-	QByteArray reqBody;
+	bool keepAlive;
 	int contentLength;
 	int pendingWritten;
+	SimpleHttpRequest *req;
 
-	Private(SimpleHttpRequest *_q) :
-		QObject(_q),
-		q(_q),
+	SimpleHttpConnection(QObject *parent = 0) :
+		QObject(parent),
 		sock(0),
 		state(ReadHeader),
 		version1dot0(false),
+		keepAlive(false),
 		contentLength(0),
-		pendingWritten(0)
+		pendingWritten(0),
+		req(0)
 	{
 	}
 
-	~Private()
+	~SimpleHttpConnection()
 	{
+		detachReq();
 		cleanup();
 	}
 
@@ -90,19 +127,33 @@ public:
 		}
 	}
 
+	void detachReq()
+	{
+		if(req)
+		{
+			req->d->conn = 0;
+
+			// let the owner know the request is over. emitted queued
+			//   since the owner may not have connected yet
+			QMetaObject::invokeMethod(req, "finished", Qt::QueuedConnection);
+
+			req = 0;
+		}
+	}
+
 	void start(QTcpSocket *_sock)
 	{
 		sock = _sock;
 		sock->setParent(this);
-		connect(sock, &QTcpSocket::readyRead, this, &Private::sock_readyRead);
-		connect(sock, &QTcpSocket::bytesWritten, this, &Private::sock_bytesWritten);
-		connect(sock, &QTcpSocket::disconnected, this, &Private::sock_disconnected);
+		connect(sock, &QTcpSocket::readyRead, this, &SimpleHttpConnection::sock_readyRead);
+		connect(sock, &QTcpSocket::bytesWritten, this, &SimpleHttpConnection::sock_bytesWritten);
+		connect(sock, &QTcpSocket::disconnected, this, &SimpleHttpConnection::sock_disconnected);
 		processIn();
 	}
 
 	void respond(int code, const QByteArray &reason, const HttpHeaders &headers, const QByteArray &body)
 	{
-		if(state != WriteBody)
+		if(state != Handling)
 			return;
 
 		HttpHeaders outHeaders = headers;
@@ -110,17 +161,33 @@ public:
 		outHeaders.removeAll("Transfer-Encoding");
 		outHeaders.removeAll("Content-Length");
 
-		outHeaders += HttpHeader("Connection", "close");
+		if(keepAlive)
+			outHeaders += HttpHeader("Connection", "keep-alive");
+		else
+			outHeaders += HttpHeader("Connection", "close");
 		outHeaders += HttpHeader("Content-Length", QByteArray::number(body.size()));
 
-		QByteArray respData = "HTTP/";
-		if(version1dot0)
-			respData += "1.0 ";
-		else
-			respData += "1.1 ";
-		respData += QByteArray::number(code) + " " + reason + "\r\n";
+		// size the buffer once so assembly doesn't realloc per append
+		int size = 16 + reason.size();
 		foreach(const HttpHeader &h, outHeaders)
-			respData += h.first + ": " + h.second + "\r\n";
+			size += h.first.size() + h.second.size() + 4;
+		size += 2 + body.size();
+
+		QByteArray respData;
+		respData.reserve(size);
+
+		respData += (version1dot0 ? "HTTP/1.0 " : "HTTP/1.1 ");
+		respData += QByteArray::number(code);
+		respData += ' ';
+		respData += reason;
+		respData += "\r\n";
+		foreach(const HttpHeader &h, outHeaders)
+		{
+			respData += h.first;
+			respData += ": ";
+			respData += h.second;
+			respData += "\r\n";
+		}
 		respData += "\r\n";
 		respData += body;
 
@@ -129,22 +196,22 @@ public:
 		sock->write(respData);
 	}
 
-	void respond(int code, const QByteArray &reason, const QString &body)
-	{
-		HttpHeaders headers;
-		headers += HttpHeader("Content-Type", "text/plain");
-
-		respond(code, reason, headers, body.toUtf8());
-	}
-
 signals:
-	void ready();
+	void requestReady(SimpleHttpRequest *req);
+	void finished();
 
 private:
 	void respondError(int code, const QByteArray &reason, const QString &body)
 	{
-		state = WriteBody;
-		respond(code, reason, body + '\n');
+		assert(!req);
+
+		state = Handling;
+		keepAlive = false;
+
+		HttpHeaders headers;
+		headers += HttpHeader("Content-Type", "text/plain");
+
+		respond(code, reason, headers, body.toUtf8() + '\n');
 	}
 
 	void respondBadRequest(const QString &body)
@@ -182,7 +249,7 @@ private:
 		if(at == -1)
 			return false;
 
-		method = QString::fromLatin1(requestLine.mid(0, at));
+		QString method = QString::fromLatin1(requestLine.mid(0, at));
 		if(method.isEmpty())
 			return false;
 
@@ -191,11 +258,12 @@ private:
 		if(end == -1)
 			return false;
 
-		uri = requestLine.mid(at, end - at);
+		QByteArray uri = requestLine.mid(at, end - at);
 
 		QByteArray versionStr = requestLine.mid(end + 1);
-		if(versionStr == "HTTP/1.0")
-			version1dot0 = true;
+		version1dot0 = (versionStr == "HTTP/1.0");
+
+		HttpHeaders reqHeaders;
 
 		for(int n = 1; n < lines.count(); ++n)
 		{
@@ -215,11 +283,23 @@ private:
 			reqHeaders += HttpHeader(name, val);
 		}
 
+		QByteArray connHeader = reqHeaders.get("Connection").toLower();
+		if(version1dot0)
+			keepAlive = connHeader.contains("keep-alive");
+		else
+			keepAlive = !connHeader.contains("close");
+
 		//log_debug("httpserver: IN method=[%s] uri=[%s] 1.1=%s", qPrintable(method), uri.data(), version1dot0 ? "no" : "yes");
 		//foreach(const HttpHeader &h, reqHeaders)
 		//	log_debug("httpserver:   [%s] [%s]", h.first.data(), h.second.data());
 		log_debug("httpserver: IN %s %s", qPrintable(method), uri.data());
 
+		req = new SimpleHttpRequest;
+		req->d->conn = this;
+		req->d->method = method;
+		req->d->uri = uri;
+		req->d->reqHeaders = reqHeaders;
+
 		return true;
 	}
 
@@ -251,39 +331,47 @@ private:
 			if(at != -1)
 			{
 				QByteArray headerData = inBuf.mid(0, at);
-				reqBody = inBuf.mid(next);
-				inBuf.clear();
 
 				if(!processHeaderData(headerData))
 				{
+					inBuf.clear();
 					respondBadRequest("Failed to parse request header.");
 					return;
 				}
 
-				bool methodAssumesBody = (method != "HEAD" && method != "GET" && method != "DELETE");
-				if(!reqHeaders.contains("Content-Length") && (reqHeaders.contains("Transfer-Encoding") || methodAssumesBody))
+				bool methodAssumesBody = (req->d->method != "HEAD" && req->d->method != "GET" && req->d->method != "DELETE");
+				if(!req->d->reqHeaders.contains("Content-Length") && (req->d->reqHeaders.contains("Transfer-Encoding") || methodAssumesBody))
 				{
+					inBuf.clear();
+					delete req;
+					req = 0;
 					respondLengthRequired("Request requires Content-Length.");
 					return;
 				}
 
-				if(reqHeaders.contains("Content-Length"))
+				if(req->d->reqHeaders.contains("Content-Length"))
 				{
 					bool ok;
-					contentLength = reqHeaders.get("Content-Length").toInt(&ok);
+					contentLength = req->d->reqHeaders.get("Content-Length").toInt(&ok);
 					if(!ok)
 					{
+						inBuf.clear();
+						delete req;
+						req = 0;
 						respondBadRequest("Bad Content-Length.");
 						return;
 					}
 
 					if(contentLength > MAX_BODY_SIZE)
 					{
+						inBuf.clear();
+						delete req;
+						req = 0;
 						respondBadRequest("Request body too large.");
 						return;
 					}
 
-					if(reqHeaders.get("Expect") == "100-continue")
+					if(req->d->reqHeaders.get("Expect") == "100-continue")
 					{
 						QByteArray respData = "HTTP/";
 						if(version1dot0)
@@ -296,13 +384,22 @@ private:
 						sock->write(respData);
 					}
 
+					// take only this request's body. anything left over
+					//   is the start of a pipelined request
+					int take = qMin(inBuf.size() - next, contentLength);
+					req->d->reqBody = inBuf.mid(next, take);
+					req->d->reqBody.reserve(contentLength);
+					inBuf = inBuf.mid(next + take);
+
 					state = ReadBody;
 					processIn();
 				}
 				else
 				{
-					state = WriteBody;
-					emit ready();
+					inBuf = inBuf.mid(next);
+
+					state = Handling;
+					emit requestReady(req);
 				}
 			}
 			else if(inBuf.size() >= MAX_HEADERS_SIZE)
@@ -314,19 +411,33 @@ private:
 		}
 		else if(state == ReadBody)
 		{
-			reqBody += sock->read(MAX_BODY_SIZE - reqBody.size() + 1);
+			req->d->reqBody += sock->read(contentLength - req->d->reqBody.size());
 
-			if(reqBody.size() > contentLength)
+			if(req->d->reqBody.size() == contentLength)
 			{
-				respondBadRequest("Request body exceeded Content-Length.");
-				return;
+				state = Handling;
+				emit requestReady(req);
 			}
+		}
+	}
 
-			if(reqBody.size() == contentLength)
-			{
-				state = WriteBody;
-				emit ready();
-			}
+	void requestDone()
+	{
+		req = 0;
+
+		if(keepAlive)
+		{
+			// on to the next request. any pipelined data is already in
+			//   inBuf or the socket buffer, so don't wait for readyRead
+			state = ReadHeader;
+			version1dot0 = false;
+			contentLength = 0;
+			processIn();
+		}
+		else
+		{
+			state = Closing;
+			sock->close();
 		}
 	}
 
@@ -347,19 +458,33 @@ private slots:
 
 		if(pendingWritten == 0)
 		{
-			state = Closing;
-			sock->close();
+			if(req)
+			{
+				SimpleHttpRequest *r = req;
+				req = 0;
+				r->d->conn = 0;
+				r->d->emitFinished();
+			}
+
+			requestDone();
 		}
 	}
 
 	void sock_disconnected()
 	{
+		detachReq();
 		cleanup();
 
-		emit q->finished();
+		emit finished();
 	}
 };
 
+inline void SimpleHttpRequest::Private::respond(int code, const QByteArray &reason, const HttpHeaders &headers, const QByteArray &body)
+{
+	if(conn)
+		conn->respond(code, reason, headers, body);
+}
+
 SimpleHttpRequest::SimpleHttpRequest(QObject *parent) :
 	QObject(parent)
 {
@@ -368,6 +493,15 @@ SimpleHttpRequest::SimpleHttpRequest(QObject *parent) :
 
 SimpleHttpRequest::~SimpleHttpRequest()
 {
+	if(d->conn)
+	{
+		// deleted without responding. drop the connection
+		SimpleHttpConnection *conn = d->conn;
+		d->conn = 0;
+		conn->req = 0;
+		conn->sock->close();
+	}
+
 	delete d;
 }
 
@@ -408,7 +542,7 @@ class SimpleHttpServerPrivate : public QObject
 public:
 	SimpleHttpServer *q;
 	QTcpServer *server;
-	QSet<SimpleHttpRequest*> accepting;
+	QSet<SimpleHttpConnection*> connections;
 	QList<SimpleHttpRequest*> pending;
 
 	SimpleHttpServerPrivate(SimpleHttpServer *_q) :
@@ -421,7 +555,7 @@ public:
 	~SimpleHttpServerPrivate()
 	{
 		qDeleteAll(pending);
-		qDeleteAll(accepting);
+		qDeleteAll(connections);
 	}
 
 	bool listen(const QHostAddress &addr, int port)
@@ -441,26 +575,31 @@ private slots:
 	void server_newConnection()
 	{
 		QTcpSocket *sock = server->nextPendingConnection();
-		SimpleHttpRequest *req = new SimpleHttpRequest;
-		connect(req->d, &SimpleHttpRequest::Private::ready, this, &SimpleHttpServerPrivate::req_ready);
-		connect(req, &SimpleHttpRequest::finished, this, &SimpleHttpServerPrivate::req_finished);
-		accepting += req;
-		req->d->start(sock);
+		SimpleHttpConnection *conn = new SimpleHttpConnection(this);
+		connect(conn, &SimpleHttpConnection::requestReady, this, &SimpleHttpServerPrivate::conn_requestReady);
+		connect(conn, &SimpleHttpConnection::finished, this, &SimpleHttpServerPrivate::conn_finished);
+		connections += conn;
+		conn->start(sock);
 	}
 
-	void req_ready()
+	void conn_requestReady(SimpleHttpRequest *req)
 	{
-		SimpleHttpRequest::Private *reqd = (SimpleHttpRequest::Private *)sender();
-		SimpleHttpRequest *req = reqd->q;
-		accepting.remove(req);
+		connect(req, &SimpleHttpRequest::finished, this, &SimpleHttpServerPrivate::req_finished);
 		pending += req;
 		emit q->requestReady();
 	}
 
+	void conn_finished()
+	{
+		SimpleHttpConnection *conn = (SimpleHttpConnection *)sender();
+		connections.remove(conn);
+		conn->setParent(0);
+		conn->deleteLater();
+	}
+
 	void req_finished()
 	{
 		SimpleHttpRequest *req = (SimpleHttpRequest *)sender();
-		accepting.remove(req);
 		pending.removeAll(req);
 		delete req;
 	}
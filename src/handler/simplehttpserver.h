@@ -33,6 +33,7 @@
 
 class HttpHeaders;
 
+class SimpleHttpConnection;
 class SimpleHttpServerPrivate;
 
 class SimpleHttpRequest : public QObject
@@ -56,6 +57,7 @@ signals:
 private:
 	class Private;
 	friend class Private;
+	friend class SimpleHttpConnection;
 	friend class SimpleHttpServerPrivate;
 	Private *d;
 
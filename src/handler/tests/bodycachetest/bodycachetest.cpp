@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "bodycache.h"
+
+class BodyCacheTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void sharing()
+	{
+		BodyCache c;
+
+		QByteArray a = "hello world";
+		QByteArray first = c.intern(a);
+		QCOMPARE(first, a);
+		QCOMPARE(c.totalBytes(), (qint64)a.size());
+
+		// a separate allocation with the same content must come back
+		//   pointing at the pooled buffer
+		QByteArray b = QByteArray("hello") + " world";
+		QByteArray second = c.intern(b);
+		QCOMPARE(second, a);
+		QVERIFY(second.constData() == first.constData());
+
+		QCOMPARE(c.totalBytes(), (qint64)a.size());
+	}
+
+	void emptyNotPooled()
+	{
+		BodyCache c;
+
+		QByteArray out = c.intern(QByteArray());
+		QVERIFY(out.isEmpty());
+		QCOMPARE(c.totalBytes(), (qint64)0);
+	}
+
+	void eviction()
+	{
+		BodyCache c(10);
+
+		c.intern(QByteArray("aaaa"));
+		c.intern(QByteArray("bbbb"));
+		QCOMPARE(c.totalBytes(), (qint64)8);
+		QCOMPARE(c.evictions(), (quint64)0);
+
+		// touch the first entry so the second is the eviction victim
+		QByteArray first = c.intern(QByteArray("aaaa"));
+
+		c.intern(QByteArray("cccc"));
+		QCOMPARE(c.evictions(), (quint64)1);
+		QCOMPARE(c.totalBytes(), (qint64)8);
+
+		// the first entry survived and still shares
+		QByteArray again = c.intern(QByteArray("aaaa"));
+		QVERIFY(again.constData() == first.constData());
+
+		// the evicted entry no longer shares with its old buffer, but
+		//   re-interning works
+		QByteArray b = c.intern(QByteArray("bbbb"));
+		QCOMPARE(b, QByteArray("bbbb"));
+	}
+
+	void oversizedNotPooled()
+	{
+		BodyCache c(4);
+
+		QByteArray big = "too large";
+		QByteArray out = c.intern(big);
+		QCOMPARE(out, big);
+		QCOMPARE(c.totalBytes(), (qint64)0);
+	}
+};
+
+QTEST_MAIN(BodyCacheTest)
+
+#include "bodycachetest.moc"
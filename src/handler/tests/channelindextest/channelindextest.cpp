@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "channelindex.h"
+
+class ChannelIndexTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void wildcardDetect()
+	{
+		QVERIFY(ChannelIndex::isWildcard("orders.*"));
+		QVERIFY(ChannelIndex::isWildcard("*"));
+		QVERIFY(!ChannelIndex::isWildcard("orders.1"));
+	}
+
+	void addRemoveMatch()
+	{
+		QObject a, b, c;
+
+		ChannelIndex index;
+		index.add("orders.*", &a);
+		index.add("orders.eu.*", &b);
+		index.add("users.*", &c);
+
+		QVERIFY(index.contains("orders.*"));
+		QCOMPARE(index.count("orders.*"), 1);
+
+		QSet<QObject*> m = index.matches("orders.eu.5");
+		QCOMPARE(m.count(), 2);
+		QVERIFY(m.contains(&a));
+		QVERIFY(m.contains(&b));
+
+		m = index.matches("orders.us.5");
+		QCOMPARE(m.count(), 1);
+		QVERIFY(m.contains(&a));
+
+		m = index.matches("other");
+		QVERIFY(m.isEmpty());
+
+		// subscription string itself shorter than the prefix
+		m = index.matches("orders");
+		QVERIFY(m.isEmpty());
+
+		index.remove("orders.*", &a);
+		QVERIFY(!index.contains("orders.*"));
+
+		m = index.matches("orders.eu.5");
+		QCOMPARE(m.count(), 1);
+		QVERIFY(m.contains(&b));
+	}
+
+	void matchAll()
+	{
+		QObject a;
+
+		ChannelIndex index;
+		index.add("*", &a);
+
+		QVERIFY(index.matches("anything").contains(&a));
+		QVERIFY(index.matches("").contains(&a));
+
+		index.remove("*", &a);
+		QVERIFY(index.matches("anything").isEmpty());
+	}
+
+	void multipleTargets()
+	{
+		QObject a, b;
+
+		ChannelIndex index;
+		index.add("orders.*", &a);
+		index.add("orders.*", &b);
+
+		QCOMPARE(index.count("orders.*"), 2);
+
+		index.remove("orders.*", &a);
+		QCOMPARE(index.count("orders.*"), 1);
+		QVERIFY(index.matches("orders.1").contains(&b));
+	}
+};
+
+QTEST_MAIN(ChannelIndexTest)
+
+#include "channelindextest.moc"
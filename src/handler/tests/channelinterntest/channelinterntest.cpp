@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "channelintern.h"
+
+class ChannelInternTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void addLookup()
+	{
+		ChannelIntern intern;
+
+		int a = intern.add("apple");
+		int b = intern.add("banana");
+		QVERIFY(a >= 0);
+		QVERIFY(b >= 0);
+		QVERIFY(a != b);
+		QCOMPARE(intern.count(), 2);
+
+		QCOMPARE(intern.id("apple"), a);
+		QCOMPARE(intern.id("banana"), b);
+		QCOMPARE(intern.id("cherry"), -1);
+
+		QCOMPARE(intern.name(a), QString("apple"));
+		QCOMPARE(intern.name(b), QString("banana"));
+	}
+
+	void refCount()
+	{
+		ChannelIntern intern;
+
+		int a = intern.add("apple");
+		QCOMPARE(intern.add("apple"), a);
+		QCOMPARE(intern.count(), 1);
+
+		intern.release(a);
+		QCOMPARE(intern.id("apple"), a);
+
+		intern.release(a);
+		QCOMPARE(intern.id("apple"), -1);
+		QCOMPARE(intern.count(), 0);
+	}
+
+	void recycleIds()
+	{
+		ChannelIntern intern;
+
+		int a = intern.add("apple");
+		intern.release(a);
+
+		int b = intern.add("banana");
+		QCOMPARE(b, a);
+		QCOMPARE(intern.name(b), QString("banana"));
+	}
+};
+
+QTEST_MAIN(ChannelInternTest)
+#include "channelinterntest.moc"
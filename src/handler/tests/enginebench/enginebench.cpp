@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+// benchmark for the handler engine's publish fan-out path. spins up a
+//   number of synthetic held stream sessions subscribed to one channel,
+//   publishes messages at a fixed rate and reports delivery throughput
+//   and fan-out completion latency percentiles.
+//
+// usage: enginebench [sessions] [messages] [interval-msec]
+//
+// not a testcase: it has no pass/fail conditions and runs for as long
+//   as the load takes, so it is excluded from `make check`
+
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include "qzmqsocket.h"
+#include "qzmqvalve.h"
+#include "qzmqreqmessage.h"
+#include "log.h"
+#include "tnetstring.h"
+#include "histogram.h"
+#include "zhttpresponsepacket.h"
+#include "engine.h"
+
+#define ACCEPT_BATCH 100
+
+class BenchWrapper : public QObject
+{
+	Q_OBJECT
+
+public:
+	QZmq::Socket *zhttpClientOutStreamSock;
+	QZmq::Socket *zhttpClientInSock;
+	QZmq::Valve *zhttpClientInValve;
+	QZmq::Socket *proxyAcceptSock;
+	QZmq::Valve *proxyAcceptValve;
+	QZmq::Socket *publishPushSock;
+
+	int acceptsPending;
+	quint64 deliveries;
+
+	BenchWrapper(QObject *parent = 0) :
+		QObject(parent),
+		acceptsPending(0),
+		deliveries(0)
+	{
+		zhttpClientOutStreamSock = new QZmq::Socket(QZmq::Socket::Router, this);
+
+		zhttpClientInSock = new QZmq::Socket(QZmq::Socket::Sub, this);
+		zhttpClientInValve = new QZmq::Valve(zhttpClientInSock, this);
+		connect(zhttpClientInValve, &QZmq::Valve::readyRead, this, &BenchWrapper::zhttpClientIn_readyRead);
+
+		proxyAcceptSock = new QZmq::Socket(QZmq::Socket::Dealer, this);
+		proxyAcceptValve = new QZmq::Valve(proxyAcceptSock, this);
+		connect(proxyAcceptValve, &QZmq::Valve::readyRead, this, &BenchWrapper::proxyAccept_readyRead);
+
+		publishPushSock = new QZmq::Socket(QZmq::Socket::Push, this);
+	}
+
+	void start()
+	{
+		zhttpClientOutStreamSock->bind("ipc://bench-client-out-stream");
+		zhttpClientInSock->bind("ipc://bench-client-in");
+		proxyAcceptSock->bind("ipc://bench-accept");
+
+		zhttpClientInSock->subscribe("bench-client ");
+
+		zhttpClientInValve->open();
+		proxyAcceptValve->open();
+	}
+
+	void startPublish()
+	{
+		publishPushSock->connectToAddress("ipc://bench-publish-pull");
+	}
+
+	// accept a batch of held stream sessions subscribed to the channel.
+	//   one accept request carries the state of many connections, so
+	//   setup scales to large session counts
+	void acceptSessions(int startId, int count, const QByteArray &channel)
+	{
+		QVariantList reqStates;
+		for(int n = 0; n < count; ++n)
+		{
+			QVariantHash rid;
+			rid["sender"] = QByteArray("bench-client");
+			rid["id"] = QByteArray::number(startId + n);
+
+			QVariantHash reqState;
+			reqState["rid"] = rid;
+			reqState["in-seq"] = 1;
+			reqState["out-seq"] = 1;
+			reqState["out-credits"] = 100000000;
+
+			reqStates += reqState;
+		}
+
+		QVariantHash req;
+		req["method"] = QByteArray("GET");
+		req["uri"] = QByteArray("http://example.com/path");
+		req["headers"] = QVariantList();
+		req["body"] = QByteArray();
+
+		QVariantHash resp;
+		resp["code"] = 200;
+		resp["reason"] = QByteArray("OK");
+		QVariantList respHeaders;
+		respHeaders += QVariant(QVariantList() << QByteArray("Content-Type") << QByteArray("text/plain"));
+		respHeaders += QVariant(QVariantList() << QByteArray("Grip-Hold") << QByteArray("stream"));
+		respHeaders += QVariant(QVariantList() << QByteArray("Grip-Channel") << channel);
+		resp["headers"] = respHeaders;
+		resp["body"] = QByteArray();
+
+		QVariantHash args;
+		args["requests"] = reqStates;
+		args["request-data"] = req;
+		args["orig-request-data"] = req;
+		args["response"] = resp;
+
+		QVariantHash data;
+		data["id"] = QByteArray::number(startId);
+		data["method"] = QByteArray("accept");
+		data["args"] = args;
+
+		++acceptsPending;
+
+		QByteArray buf = TnetString::fromVariant(data);
+		proxyAcceptSock->write(QList<QByteArray>() << QByteArray() << buf);
+	}
+
+	void publish(const QByteArray &channel, const QByteArray &content)
+	{
+		QVariantHash hs;
+		hs["content"] = content;
+
+		QVariantHash formats;
+		formats["http-stream"] = hs;
+
+		QVariantHash item;
+		item["channel"] = channel;
+		item["formats"] = formats;
+
+		publishPushSock->write(QList<QByteArray>() << TnetString::fromVariant(item));
+	}
+
+private slots:
+	void zhttpClientIn_readyRead(const QList<QByteArray> &message)
+	{
+		int at = message[0].indexOf(' ');
+		QVariant v = TnetString::toVariant(message[0].mid(at + 2));
+		ZhttpResponsePacket zresp;
+		zresp.fromVariant(v);
+
+		// initial held responses have an empty body. anything else is a
+		//   published message being delivered
+		if(zresp.type == ZhttpResponsePacket::Data && !zresp.body.isEmpty())
+			++deliveries;
+	}
+
+	void proxyAccept_readyRead(const QList<QByteArray> &_message)
+	{
+		QZmq::ReqMessage message(_message);
+		QVariant v = TnetString::toVariant(message.content()[0]);
+
+		bool success = false;
+		if(v.type() == QVariant::Hash)
+			success = v.toHash().value("success").toBool();
+
+		if(!success)
+		{
+			fprintf(stderr, "error: accept failed\n");
+			exit(1);
+		}
+
+		--acceptsPending;
+	}
+};
+
+static void waitFor(int msec)
+{
+	QEventLoop loop;
+	QTimer::singleShot(msec, &loop, SLOT(quit()));
+	loop.exec();
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication qapp(argc, argv);
+
+	log_setOutputLevel(LOG_LEVEL_WARNING);
+
+	int sessions = (argc > 1) ? QByteArray(argv[1]).toInt() : 1000;
+	int messages = (argc > 2) ? QByteArray(argv[2]).toInt() : 100;
+	int interval = (argc > 3) ? QByteArray(argv[3]).toInt() : 10;
+
+	if(sessions < 1 || messages < 1 || interval < 0)
+	{
+		fprintf(stderr, "usage: enginebench [sessions] [messages] [interval-msec]\n");
+		return 1;
+	}
+
+	BenchWrapper *wrapper = new BenchWrapper(&qapp);
+	wrapper->start();
+
+	Engine *engine = new Engine(&qapp);
+
+	Engine::Configuration config;
+	config.instanceId = "bench-handler";
+	config.serverInStreamSpecs = QStringList() << "ipc://bench-client-out-stream";
+	config.serverOutSpecs = QStringList() << "ipc://bench-client-in";
+	config.acceptSpec = "ipc://bench-accept";
+	config.pushInSpec = "ipc://bench-publish-pull";
+	config.connectionSubscriptionMax = 20;
+	if(!engine->start(config))
+	{
+		fprintf(stderr, "error: failed to start engine\n");
+		return 1;
+	}
+
+	wrapper->startPublish();
+
+	waitFor(500);
+
+	printf("setting up %d sessions...\n", sessions);
+
+	QByteArray channel = "bench";
+
+	for(int at = 0; at < sessions; at += ACCEPT_BATCH)
+		wrapper->acceptSessions(at, qMin(ACCEPT_BATCH, sessions - at), channel);
+
+	while(wrapper->acceptsPending > 0)
+		waitFor(10);
+
+	// let subscriptions settle
+	waitFor(500);
+
+	printf("publishing %d messages at %dms intervals...\n", messages, interval);
+
+	Histogram latency;
+	QElapsedTimer total;
+	total.start();
+
+	QByteArray content = "hello world\n";
+
+	for(int n = 0; n < messages; ++n)
+	{
+		quint64 expected = (quint64)(n + 1) * sessions;
+
+		QElapsedTimer t;
+		t.start();
+
+		wrapper->publish(channel, content);
+
+		// wait for the full fan-out of this message to reach zhttp
+		while(wrapper->deliveries < expected)
+			waitFor(1);
+
+		latency.add(t.elapsed());
+
+		if(interval > 0)
+			waitFor(interval);
+	}
+
+	qint64 elapsed = total.elapsed();
+	quint64 delivered = wrapper->deliveries;
+
+	printf("\n");
+	printf("sessions:   %d\n", sessions);
+	printf("messages:   %d\n", messages);
+	printf("deliveries: %llu in %llums (%llu/sec)\n",
+		(unsigned long long)delivered,
+		(unsigned long long)elapsed,
+		(unsigned long long)(elapsed > 0 ? (delivered * 1000) / elapsed : 0));
+	printf("fan-out completion latency (msec):\n");
+	printf("  p50=%lld p99=%lld p999=%lld max=%lld\n",
+		(long long)latency.percentile(0.5),
+		(long long)latency.percentile(0.99),
+		(long long)latency.percentile(0.999),
+		(long long)latency.maxValue());
+
+	delete engine;
+
+	return 0;
+}
+
+#include "enginebench.moc"
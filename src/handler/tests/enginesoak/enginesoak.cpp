@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+// soak harness for the handler engine. like enginebench, but built to
+//   run for hours: holds a configured number of stream sessions spread
+//   across channels, publishes at a steady rate, samples RSS and
+//   fan-out latency every few seconds into a CSV, and fails if memory
+//   grows past a ceiling predicted from the post-setup baseline or if
+//   latency drifts. steady-state publishing allocates nothing that
+//   outlives the publish, so sustained RSS growth is a leak
+//   (sequencer pending sets, stats ConnectionInfo, ws meta maps have
+//   all regressed this way).
+//
+// usage: enginesoak [sessions] [channels] [rate] [duration-sec] [csv-file]
+//
+// not a testcase: runtime is operator-chosen and typically long, so it
+//   is excluded from `make check`
+
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QTimer>
+#include "qzmqsocket.h"
+#include "qzmqvalve.h"
+#include "qzmqreqmessage.h"
+#include "log.h"
+#include "tnetstring.h"
+#include "histogram.h"
+#include "zhttpresponsepacket.h"
+#include "engine.h"
+
+#define ACCEPT_BATCH 100
+
+// seconds between CSV samples
+#define SAMPLE_INTERVAL 5
+
+// allowed RSS growth over the post-warmup baseline (kb). the engine
+//   holds no per-publish state once delivery completes, so the ceiling
+//   is simply baseline plus slack for allocator fragmentation
+#define RSS_HEADROOM_KB (64 * 1024)
+
+// the last sample window's p99 may not exceed this multiple of the
+//   first window's p99 (with a floor, so tiny absolute values don't
+//   trip it)
+#define LATENCY_DRIFT_FACTOR 3
+#define LATENCY_FLOOR_MSEC 10
+
+class SoakWrapper : public QObject
+{
+	Q_OBJECT
+
+public:
+	QZmq::Socket *zhttpClientOutStreamSock;
+	QZmq::Socket *zhttpClientInSock;
+	QZmq::Valve *zhttpClientInValve;
+	QZmq::Socket *proxyAcceptSock;
+	QZmq::Valve *proxyAcceptValve;
+	QZmq::Socket *publishPushSock;
+
+	int acceptsPending;
+	quint64 deliveries;
+
+	SoakWrapper(QObject *parent = 0) :
+		QObject(parent),
+		acceptsPending(0),
+		deliveries(0)
+	{
+		zhttpClientOutStreamSock = new QZmq::Socket(QZmq::Socket::Router, this);
+
+		zhttpClientInSock = new QZmq::Socket(QZmq::Socket::Sub, this);
+		zhttpClientInValve = new QZmq::Valve(zhttpClientInSock, this);
+		connect(zhttpClientInValve, &QZmq::Valve::readyRead, this, &SoakWrapper::zhttpClientIn_readyRead);
+
+		proxyAcceptSock = new QZmq::Socket(QZmq::Socket::Dealer, this);
+		proxyAcceptValve = new QZmq::Valve(proxyAcceptSock, this);
+		connect(proxyAcceptValve, &QZmq::Valve::readyRead, this, &SoakWrapper::proxyAccept_readyRead);
+
+		publishPushSock = new QZmq::Socket(QZmq::Socket::Push, this);
+	}
+
+	void start()
+	{
+		zhttpClientOutStreamSock->bind("ipc://soak-client-out-stream");
+		zhttpClientInSock->bind("ipc://soak-client-in");
+		proxyAcceptSock->bind("ipc://soak-accept");
+
+		zhttpClientInSock->subscribe("soak-client ");
+
+		zhttpClientInValve->open();
+		proxyAcceptValve->open();
+	}
+
+	void startPublish()
+	{
+		publishPushSock->connectToAddress("ipc://soak-publish-pull");
+	}
+
+	void acceptSessions(int startId, int count, const QByteArray &channel)
+	{
+		QVariantList reqStates;
+		for(int n = 0; n < count; ++n)
+		{
+			QVariantHash rid;
+			rid["sender"] = QByteArray("soak-client");
+			rid["id"] = QByteArray::number(startId + n);
+
+			QVariantHash reqState;
+			reqState["rid"] = rid;
+			reqState["in-seq"] = 1;
+			reqState["out-seq"] = 1;
+			reqState["out-credits"] = 100000000;
+
+			reqStates += reqState;
+		}
+
+		QVariantHash req;
+		req["method"] = QByteArray("GET");
+		req["uri"] = QByteArray("http://example.com/path");
+		req["headers"] = QVariantList();
+		req["body"] = QByteArray();
+
+		QVariantHash resp;
+		resp["code"] = 200;
+		resp["reason"] = QByteArray("OK");
+		QVariantList respHeaders;
+		respHeaders += QVariant(QVariantList() << QByteArray("Content-Type") << QByteArray("text/plain"));
+		respHeaders += QVariant(QVariantList() << QByteArray("Grip-Hold") << QByteArray("stream"));
+		respHeaders += QVariant(QVariantList() << QByteArray("Grip-Channel") << channel);
+		resp["headers"] = respHeaders;
+		resp["body"] = QByteArray();
+
+		QVariantHash args;
+		args["requests"] = reqStates;
+		args["request-data"] = req;
+		args["orig-request-data"] = req;
+		args["response"] = resp;
+
+		QVariantHash data;
+		data["id"] = QByteArray::number(startId);
+		data["method"] = QByteArray("accept");
+		data["args"] = args;
+
+		++acceptsPending;
+
+		QByteArray buf = TnetString::fromVariant(data);
+		proxyAcceptSock->write(QList<QByteArray>() << QByteArray() << buf);
+	}
+
+	void publish(const QByteArray &channel, const QByteArray &content)
+	{
+		QVariantHash hs;
+		hs["content"] = content;
+
+		QVariantHash formats;
+		formats["http-stream"] = hs;
+
+		QVariantHash item;
+		item["channel"] = channel;
+		item["formats"] = formats;
+
+		publishPushSock->write(QList<QByteArray>() << TnetString::fromVariant(item));
+	}
+
+private slots:
+	void zhttpClientIn_readyRead(const QList<QByteArray> &message)
+	{
+		int at = message[0].indexOf(' ');
+		QVariant v = TnetString::toVariant(message[0].mid(at + 2));
+		ZhttpResponsePacket zresp;
+		zresp.fromVariant(v);
+
+		if(zresp.type == ZhttpResponsePacket::Data && !zresp.body.isEmpty())
+			++deliveries;
+	}
+
+	void proxyAccept_readyRead(const QList<QByteArray> &_message)
+	{
+		QZmq::ReqMessage message(_message);
+		QVariant v = TnetString::toVariant(message.content()[0]);
+
+		bool success = false;
+		if(v.type() == QVariant::Hash)
+			success = v.toHash().value("success").toBool();
+
+		if(!success)
+		{
+			fprintf(stderr, "error: accept failed\n");
+			exit(1);
+		}
+
+		--acceptsPending;
+	}
+};
+
+static void waitFor(int msec)
+{
+	QEventLoop loop;
+	QTimer::singleShot(msec, &loop, SLOT(quit()));
+	loop.exec();
+}
+
+// current RSS in kb, or -1 if unknown (non-linux)
+static qint64 currentRssKb()
+{
+	QFile f("/proc/self/status");
+	if(!f.open(QFile::ReadOnly))
+		return -1;
+
+	foreach(const QByteArray &line, f.readAll().split('\n'))
+	{
+		if(line.startsWith("VmRSS:"))
+			return line.mid(6).trimmed().split(' ')[0].toLongLong();
+	}
+
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication qapp(argc, argv);
+
+	log_setOutputLevel(LOG_LEVEL_WARNING);
+
+	int sessions = (argc > 1) ? QByteArray(argv[1]).toInt() : 1000;
+	int channels = (argc > 2) ? QByteArray(argv[2]).toInt() : 10;
+	int rate = (argc > 3) ? QByteArray(argv[3]).toInt() : 100;
+	int duration = (argc > 4) ? QByteArray(argv[4]).toInt() : 60;
+	QString csvFile = (argc > 5) ? QString::fromLocal8Bit(argv[5]) : QString("enginesoak.csv");
+
+	if(sessions < 1 || channels < 1 || channels > sessions || rate < 1 || duration < 1)
+	{
+		fprintf(stderr, "usage: enginesoak [sessions] [channels] [rate] [duration-sec] [csv-file]\n");
+		return 1;
+	}
+
+	QFile csv(csvFile);
+	if(!csv.open(QFile::WriteOnly | QFile::Truncate))
+	{
+		fprintf(stderr, "error: can't write %s\n", qPrintable(csvFile));
+		return 1;
+	}
+
+	csv.write("elapsed_sec,published,delivered,rss_kb,p50_msec,p99_msec,max_msec\n");
+
+	SoakWrapper *wrapper = new SoakWrapper(&qapp);
+	wrapper->start();
+
+	Engine *engine = new Engine(&qapp);
+
+	Engine::Configuration config;
+	config.instanceId = "soak-handler";
+	config.serverInStreamSpecs = QStringList() << "ipc://soak-client-out-stream";
+	config.serverOutSpecs = QStringList() << "ipc://soak-client-in";
+	config.acceptSpec = "ipc://soak-accept";
+	config.pushInSpec = "ipc://soak-publish-pull";
+	config.connectionSubscriptionMax = 20;
+	if(!engine->start(config))
+	{
+		fprintf(stderr, "error: failed to start engine\n");
+		return 1;
+	}
+
+	wrapper->startPublish();
+
+	waitFor(500);
+
+	printf("setting up %d sessions across %d channels...\n", sessions, channels);
+
+	// sessions are assigned to channels round-robin by batch, so each
+	//   channel carries roughly sessions/channels subscribers
+	for(int at = 0; at < sessions; at += ACCEPT_BATCH)
+	{
+		QByteArray channel = "soak-" + QByteArray::number((at / ACCEPT_BATCH) % channels);
+		wrapper->acceptSessions(at, qMin(ACCEPT_BATCH, sessions - at), channel);
+	}
+
+	while(wrapper->acceptsPending > 0)
+		waitFor(10);
+
+	// let subscriptions and allocator churn from setup settle before
+	//   taking the memory baseline
+	waitFor(2000);
+
+	qint64 baselineRssKb = currentRssKb();
+	qint64 rssCeilingKb = (baselineRssKb >= 0) ? baselineRssKb + RSS_HEADROOM_KB : -1;
+
+	printf("baseline rss: %lldkb, ceiling: %lldkb\n", (long long)baselineRssKb, (long long)rssCeilingKb);
+	printf("publishing at %d/sec for %ds...\n", rate, duration);
+
+	int interval = qMax(1000 / rate, 1);
+	QByteArray content = "hello world\n";
+
+	Histogram window;
+	qint64 firstP99 = -1;
+	qint64 lastP99 = -1;
+	quint64 published = 0;
+	bool failed = false;
+
+	QElapsedTimer total;
+	total.start();
+
+	QElapsedTimer sample;
+	sample.start();
+
+	int channelAt = 0;
+	int sessionsPerChannel = sessions / channels;
+
+	while(total.elapsed() < (qint64)duration * 1000)
+	{
+		quint64 expected = wrapper->deliveries + sessionsPerChannel;
+
+		QElapsedTimer t;
+		t.start();
+
+		wrapper->publish("soak-" + QByteArray::number(channelAt), content);
+		channelAt = (channelAt + 1) % channels;
+		++published;
+
+		// wait for the fan-out of this message before pacing the next
+		while(wrapper->deliveries < expected)
+			waitFor(1);
+
+		window.add(t.elapsed());
+
+		if(sample.elapsed() >= SAMPLE_INTERVAL * 1000)
+		{
+			qint64 rssKb = currentRssKb();
+			qint64 p50 = window.percentile(0.5);
+			qint64 p99 = window.percentile(0.99);
+			qint64 max = window.maxValue();
+
+			char line[256];
+			int len = snprintf(line, sizeof(line), "%lld,%llu,%llu,%lld,%lld,%lld,%lld\n",
+				(long long)(total.elapsed() / 1000),
+				(unsigned long long)published,
+				(unsigned long long)wrapper->deliveries,
+				(long long)rssKb,
+				(long long)p50,
+				(long long)p99,
+				(long long)max);
+			csv.write(line, len);
+			csv.flush();
+
+			if(firstP99 < 0)
+				firstP99 = p99;
+			lastP99 = p99;
+
+			if(rssCeilingKb >= 0 && rssKb > rssCeilingKb)
+			{
+				fprintf(stderr, "FAIL: rss %lldkb exceeds ceiling %lldkb after %llds\n",
+					(long long)rssKb, (long long)rssCeilingKb, (long long)(total.elapsed() / 1000));
+				failed = true;
+				break;
+			}
+
+			window = Histogram();
+			sample.restart();
+		}
+
+		if(interval > 0)
+			waitFor(interval);
+	}
+
+	if(!failed && firstP99 >= 0 && lastP99 > qMax(firstP99 * LATENCY_DRIFT_FACTOR, (qint64)LATENCY_FLOOR_MSEC))
+	{
+		fprintf(stderr, "FAIL: p99 latency drifted from %lldms to %lldms\n",
+			(long long)firstP99, (long long)lastP99);
+		failed = true;
+	}
+
+	printf("\n");
+	printf("sessions:   %d\n", sessions);
+	printf("channels:   %d\n", channels);
+	printf("published:  %llu\n", (unsigned long long)published);
+	printf("deliveries: %llu\n", (unsigned long long)wrapper->deliveries);
+	printf("final rss:  %lldkb (baseline %lldkb)\n", (long long)currentRssKb(), (long long)baselineRssKb);
+	printf("result:     %s\n", failed ? "FAIL" : "OK");
+
+	delete engine;
+
+	return failed ? 1 : 0;
+}
+
+#include "enginesoak.moc"
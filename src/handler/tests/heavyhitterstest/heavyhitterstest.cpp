@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "heavyhitters.h"
+
+class HeavyHittersTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void basicCounts()
+	{
+		HeavyHitters hh;
+
+		hh.add("apple");
+		hh.add("apple");
+		hh.add("banana");
+
+		QList<QPair<QString, quint64> > top = hh.top();
+		QCOMPARE(top.count(), 2);
+		QCOMPARE(top[0].first, QString("apple"));
+		QVERIFY(top[0].second >= 2);
+		QCOMPARE(top[1].first, QString("banana"));
+		QVERIFY(top[1].second >= 1);
+	}
+
+	void boundedTracking()
+	{
+		// with K=3, the hot channels must end up tracked even though
+		//   many distinct channels pass through
+		HeavyHitters hh(2048, 4, 3);
+
+		for(int n = 0; n < 200; ++n)
+			hh.add(QString("cold-%1").arg(n));
+
+		for(int n = 0; n < 100; ++n)
+		{
+			hh.add("hot-a");
+			hh.add("hot-b");
+		}
+
+		QList<QPair<QString, quint64> > top = hh.top();
+		QCOMPARE(top.count(), 3);
+
+		QSet<QString> names;
+		names += top[0].first;
+		names += top[1].first;
+		QVERIFY(names.contains("hot-a"));
+		QVERIFY(names.contains("hot-b"));
+	}
+
+	void neverUndercounts()
+	{
+		HeavyHitters hh(64, 2, 10);
+
+		for(int n = 0; n < 50; ++n)
+			hh.add(QString("filler-%1").arg(n));
+
+		for(int n = 0; n < 20; ++n)
+			hh.add("target");
+
+		QList<QPair<QString, quint64> > top = hh.top();
+		quint64 est = 0;
+		for(int n = 0; n < top.count(); ++n)
+		{
+			if(top[n].first == "target")
+				est = top[n].second;
+		}
+
+		QVERIFY(est >= 20);
+	}
+
+	void decay()
+	{
+		HeavyHitters hh;
+
+		for(int n = 0; n < 8; ++n)
+			hh.add("apple");
+
+		hh.decay();
+
+		QList<QPair<QString, quint64> > top = hh.top();
+		QCOMPARE(top.count(), 1);
+		QVERIFY(top[0].second >= 4);
+		QVERIFY(top[0].second < 8);
+
+		// entries that decay to zero are dropped
+		hh.add("banana");
+		for(int n = 0; n < 10; ++n)
+			hh.decay();
+
+		QVERIFY(hh.top().isEmpty());
+	}
+
+	void clear()
+	{
+		HeavyHitters hh;
+
+		hh.add("apple");
+		hh.clear();
+		QVERIFY(hh.top().isEmpty());
+
+		hh.add("apple");
+		QList<QPair<QString, quint64> > top = hh.top();
+		QCOMPARE(top.count(), 1);
+		QCOMPARE(top[0].second, (quint64)1);
+	}
+};
+
+QTEST_MAIN(HeavyHittersTest)
+#include "heavyhitterstest.moc"
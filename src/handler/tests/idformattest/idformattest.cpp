@@ -68,6 +68,36 @@ private slots:
 		QCOMPARE(ret, QByteArray("The ID is 52324432."));
 	}
 
+	void compiledTemplate()
+	{
+		IdFormat::Template t;
+		QVERIFY(t.isNull());
+
+		QVERIFY(t.compile("My name is %(name)s."));
+		QVERIFY(!t.isNull());
+
+		// one compile, many renders
+		QHash<QString, QByteArray> vars;
+		vars["name"] = "Alice";
+		QCOMPARE(t.renderId(vars), QByteArray("My name is Alice."));
+		vars["name"] = "Bob";
+		QCOMPARE(t.renderId(vars), QByteArray("My name is Bob."));
+
+		QVERIFY(t.compile("The ID is %I."));
+		QCOMPARE(t.renderContent("C3PO", false), QByteArray("The ID is C3PO."));
+		QCOMPARE(t.renderContent("R2D2", true), QByteArray("The ID is 52324432."));
+
+		// incomplete directive at the end is an error without partialPos
+		QVERIFY(!t.compile("The ID is %(R2D"));
+		QVERIFY(t.isNull());
+
+		// with partialPos, compilation stops at the marker
+		int pos;
+		QVERIFY(t.compile("The ID is %(R2D", &pos));
+		QCOMPARE(pos, 10);
+		QCOMPARE(t.renderContent(QByteArray(), false), QByteArray("The ID is "));
+	}
+
 	void renderContentIncremental()
 	{
 		IdFormat::ContentRenderer cr(QByteArray(), true);
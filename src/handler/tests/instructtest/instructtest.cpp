@@ -276,6 +276,42 @@ private slots:
 		QCOMPARE(i.keepAliveData, QByteArray("ping3\n"));
 		QVERIFY(i.keepAliveTimeout > 0);
 	}
+
+	void repeatedHeaders()
+	{
+		HttpResponseData data;
+		data.code = 200;
+		data.reason = "OK";
+		data.headers += HttpHeader("Content-Type", "text/plain");
+		data.headers += HttpHeader("Grip-Hold", "stream");
+		data.headers += HttpHeader("Grip-Channel", "test");
+		data.body = "one";
+
+		Instruct i;
+		bool ok;
+		i = Instruct::fromResponse(data, &ok);
+		QVERIFY(ok);
+		QCOMPARE(i.holdMode, Instruct::StreamHold);
+		QCOMPARE(i.response.body, QByteArray("one"));
+
+		// same instruct headers again. the parsed values come from the
+		//   cache, but the response parts must reflect this response
+		data.body = "two";
+		i = Instruct::fromResponse(data, &ok);
+		QVERIFY(ok);
+		QCOMPARE(i.holdMode, Instruct::StreamHold);
+		QCOMPARE(i.channels.count(), 1);
+		QCOMPARE(i.channels[0].name, QString("test"));
+		QCOMPARE(i.response.body, QByteArray("two"));
+
+		// a different channel value must not hit the previous entry
+		data.headers.removeAll("Grip-Channel");
+		data.headers += HttpHeader("Grip-Channel", "other");
+		i = Instruct::fromResponse(data, &ok);
+		QVERIFY(ok);
+		QCOMPARE(i.channels.count(), 1);
+		QCOMPARE(i.channels[0].name, QString("other"));
+	}
 };
 
 QTEST_MAIN(InstructTest)
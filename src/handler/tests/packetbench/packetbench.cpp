@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+// benchmark for the packet codecs, round-tripping representative
+//   packets through their variant and tnetstring forms and reporting
+//   ns/op per direction plus the encoded size. serves as the baseline
+//   for comparing codec changes against the current encoding.
+//
+// usage: packetbench [iterations]
+//
+// not a testcase: it has no pass/fail conditions, so it is excluded
+//   from `make check`
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include "tnetstring.h"
+#include "httpheaders.h"
+#include "zhttprequestpacket.h"
+#include "retryrequestpacket.h"
+#include "wscontrolpacket.h"
+#include "statspacket.h"
+
+static int iterations = 100000;
+
+static void report(const char *name, qint64 encodeNs, qint64 decodeNs, int size)
+{
+	printf("%-14s encode %6d ns/op, decode %6d ns/op, %5d bytes\n", name, (int)(encodeNs / iterations), (int)(decodeNs / iterations), size);
+}
+
+// round-trip helper for packets with plain toVariant/fromVariant
+template <typename Packet>
+static void benchPacket(const char *name, const Packet &packet)
+{
+	QElapsedTimer t;
+	QByteArray buf;
+
+	t.start();
+	for(int n = 0; n < iterations; ++n)
+		buf = TnetString::fromVariant(packet.toVariant());
+	qint64 encodeNs = t.nsecsElapsed();
+
+	t.start();
+	for(int n = 0; n < iterations; ++n)
+	{
+		QVariant data = TnetString::toVariant(buf);
+		Packet p;
+		if(!p.fromVariant(data))
+		{
+			fprintf(stderr, "%s: decode failed\n", name);
+			exit(1);
+		}
+	}
+	qint64 decodeNs = t.nsecsElapsed();
+
+	report(name, encodeNs, decodeNs, buf.size());
+}
+
+static void benchZhttpData()
+{
+	// a typical proxied request data packet: modest header set, small
+	//   body, streamed
+	ZhttpRequestPacket p;
+	p.from = "pushpin-proxy_12345";
+	p.ids += ZhttpRequestPacket::Id("9ac43712-b6b7-4f33-86ef-6b9d340d1461", 3);
+	p.type = ZhttpRequestPacket::Data;
+	p.credits = 200000;
+	p.uri = QUrl::fromEncoded("https://example.com/api/items?cursor=abc123", QUrl::StrictMode);
+	p.method = "POST";
+	p.headers += HttpHeader("Host", "example.com");
+	p.headers += HttpHeader("Content-Type", "application/json");
+	p.headers += HttpHeader("Accept", "*/*");
+	p.headers += HttpHeader("User-Agent", "client/1.0");
+	p.headers += HttpHeader("Authorization", "Bearer 5551212abcdef");
+	p.stream = true;
+	p.multi = true;
+	p.body = "{\"name\":\"widget\",\"count\":3,\"tags\":[\"a\",\"b\"]}";
+	p.more = true;
+
+	benchPacket("zhttp-data", p);
+}
+
+static void benchRetryRequest()
+{
+	RetryRequestPacket p;
+
+	RetryRequestPacket::Request req;
+	req.rid = RetryRequestPacket::Rid("pushpin-proxy_12345", "9ac43712-b6b7-4f33-86ef-6b9d340d1461");
+	req.https = true;
+	req.peerAddress = QHostAddress("203.0.113.25");
+	req.inSeq = 4;
+	req.outSeq = 2;
+	req.outCredits = 200000;
+	p.requests += req;
+
+	p.requestData.method = "GET";
+	p.requestData.uri = QUrl::fromEncoded("https://example.com/stream/updates", QUrl::StrictMode);
+	p.requestData.headers += HttpHeader("Host", "example.com");
+	p.requestData.headers += HttpHeader("Accept", "text/event-stream");
+	p.requestData.headers += HttpHeader("Last-Event-ID", "1042");
+
+	p.haveInspectInfo = true;
+	p.inspectInfo.doProxy = true;
+	p.inspectInfo.sid = "session-1461";
+	p.inspectInfo.lastIds.insert("fruit", "1042");
+
+	benchPacket("retry-request", p);
+}
+
+static void benchWsControl()
+{
+	// a flush-sized batch: one announce, a few sends, a keep-alive
+	WsControlPacket p;
+	p.from = "pushpin-proxy_12345";
+
+	WsControlPacket::Item here;
+	here.cid = "9ac43712-b6b7-4f33-86ef-6b9d340d1461";
+	here.type = WsControlPacket::Item::Here;
+	here.uri = QUrl::fromEncoded("wss://example.com/updates", QUrl::StrictMode);
+	here.ttl = 60;
+	p.items += here;
+
+	for(int n = 0; n < 8; ++n)
+	{
+		WsControlPacket::Item send;
+		send.cid = "9ac43712-b6b7-4f33-86ef-6b9d340d1461";
+		send.type = WsControlPacket::Item::Send;
+		send.requestId = QByteArray::number(n);
+		send.message = "{\"channel\":\"fruit\",\"id\":\"1042\",\"data\":\"apple\"}";
+		p.items += send;
+	}
+
+	WsControlPacket::Item ka;
+	ka.type = WsControlPacket::Item::KeepAlive;
+	ka.ttl = 60;
+	p.items += ka;
+
+	benchPacket("wscontrol", p);
+}
+
+static void benchStats()
+{
+	// stats packets carry their type out-of-band, so they don't fit
+	//   the generic round-trip helper
+	StatsPacket p;
+	p.type = StatsPacket::Connected;
+	p.from = "pushpin-handler_12345";
+	p.route = "default";
+	p.connectionId = "9ac43712-b6b7-4f33-86ef-6b9d340d1461";
+	p.connectionType = StatsPacket::WebSocket;
+	p.peerAddress = QHostAddress("203.0.113.25");
+	p.ssl = true;
+	p.ttl = 120;
+
+	QElapsedTimer t;
+	QByteArray buf;
+
+	t.start();
+	for(int n = 0; n < iterations; ++n)
+		buf = TnetString::fromVariant(p.toVariant());
+	qint64 encodeNs = t.nsecsElapsed();
+
+	t.start();
+	for(int n = 0; n < iterations; ++n)
+	{
+		QVariant data = TnetString::toVariant(buf);
+		StatsPacket out;
+		if(!out.fromVariant("conn", data))
+		{
+			fprintf(stderr, "stats-conn: decode failed\n");
+			exit(1);
+		}
+	}
+	qint64 decodeNs = t.nsecsElapsed();
+
+	report("stats-conn", encodeNs, decodeNs, buf.size());
+}
+
+int main(int argc, char **argv)
+{
+	if(argc >= 2)
+		iterations = QByteArray(argv[1]).toInt();
+	if(iterations < 1)
+		iterations = 1;
+
+	printf("iterations per codec: %d\n", iterations);
+
+	benchZhttpData();
+	benchRetryRequest();
+	benchWsControl();
+	benchStats();
+
+	return 0;
+}
@@ -0,0 +1,3 @@
+include(../tests.pri)
+CONFIG -= testcase
+SOURCES += packetbench.cpp
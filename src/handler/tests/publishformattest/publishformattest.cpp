@@ -62,6 +62,22 @@ private slots:
 		QCOMPARE(f.reason, QByteArray("OK"));
 		QCOMPARE(f.headers.count(), 0);
 		QCOMPARE(f.body, QByteArray("other fields implied"));
+
+		// binary-safe input carries body-bin as raw bytes
+		data.clear();
+		data["body-bin"] = QByteArray("\x00\x01\x02", 3);
+
+		f = PublishFormat::fromVariant(PublishFormat::HttpResponse, data, &ok);
+		QVERIFY(ok);
+		QCOMPARE(f.body, QByteArray("\x00\x01\x02", 3));
+
+		// json input carries body-bin as base64
+		QVariantMap jdata;
+		jdata["body-bin"] = QString::fromUtf8(QByteArray("\x00\x01\x02", 3).toBase64());
+
+		f = PublishFormat::fromVariant(PublishFormat::HttpResponse, jdata, &ok);
+		QVERIFY(ok);
+		QCOMPARE(f.body, QByteArray("\x00\x01\x02", 3));
 	}
 
 	void streamFormat()
@@ -82,6 +98,15 @@ private slots:
 		QVERIFY(ok);
 		QVERIFY(f.action == PublishFormat::Close);
 		QVERIFY(f.body.isEmpty());
+
+		// binary-safe input carries content-bin as raw bytes
+		data.clear();
+		data["content-bin"] = QByteArray("\x00\x01\x02", 3);
+
+		f = PublishFormat::fromVariant(PublishFormat::HttpStream, data, &ok);
+		QVERIFY(ok);
+		QVERIFY(f.action == PublishFormat::Send);
+		QCOMPARE(f.body, QByteArray("\x00\x01\x02", 3));
 	}
 
 	void webSocketMessageFormat()
@@ -98,6 +98,72 @@ private slots:
 		QVERIFY(i.formats.contains(PublishFormat::HttpStream));
 		QCOMPARE(i.formats.value(PublishFormat::HttpStream).body, QByteArray("hello world"));
 	}
+
+	void parseItemTnetString()
+	{
+		QByteArray hs = "25:7:content,11:hello world,}";
+		QByteArray formats = QByteArray::number(hs.length() + 15) + ":11:http-stream," + hs + "}";
+		QByteArray meta = "24:3:foo,3:bar,3:bar,3:baz,}";
+		QByteArray payload =
+			"7:channel,5:apple,"
+			"2:id,5:item1,"
+			"7:prev-id,5:item0,"
+			"4:meta," + meta +
+			"7:formats," + formats;
+		QByteArray frame = QByteArray::number(payload.length()) + ":" + payload + "}";
+
+		bool ok;
+		PublishItem i = PublishItem::fromTnetString(frame, QString(), &ok);
+		QVERIFY(ok);
+		QCOMPARE(i.channel, QString("apple"));
+		QCOMPARE(i.id, QString("item1"));
+		QCOMPARE(i.prevId, QString("item0"));
+		QCOMPARE(i.meta.count(), 2);
+		QCOMPARE(i.meta.value("foo"), QString("bar"));
+		QCOMPARE(i.meta.value("bar"), QString("baz"));
+		QVERIFY(i.formats.contains(PublishFormat::HttpStream));
+		QCOMPARE(i.formats.value(PublishFormat::HttpStream).body, QByteArray("hello world"));
+
+		PublishItem::fromTnetString("5:hello,", QString(), &ok);
+		QVERIFY(!ok);
+	}
+
+	void sharedBodies()
+	{
+		QVariantHash hs;
+		hs["content"] = QByteArray("hello world");
+
+		QVariantHash ws;
+		ws["content"] = QByteArray("hello world");
+
+		QVariantHash formats;
+		formats["http-stream"] = hs;
+		formats["ws-message"] = ws;
+
+		QVariantHash data;
+		data["channel"] = QByteArray("apple");
+		data["formats"] = formats;
+
+		bool ok;
+		PublishItem i = PublishItem::fromVariant(data, QString(), &ok);
+		QVERIFY(ok);
+
+		// identical bodies collapse to one buffer
+		const QByteArray &b1 = i.formats.value(PublishFormat::HttpStream).body;
+		const QByteArray &b2 = i.formats.value(PublishFormat::WebSocketMessage).body;
+		QCOMPARE(b1, QByteArray("hello world"));
+		QVERIFY(b1.constData() == b2.constData());
+
+		// different bodies stay separate
+		ws["content"] = QByteArray("something else");
+		formats["ws-message"] = ws;
+		data["formats"] = formats;
+
+		i = PublishItem::fromVariant(data, QString(), &ok);
+		QVERIFY(ok);
+		QCOMPARE(i.formats.value(PublishFormat::HttpStream).body, QByteArray("hello world"));
+		QCOMPARE(i.formats.value(PublishFormat::WebSocketMessage).body, QByteArray("something else"));
+	}
 };
 
 QTEST_MAIN(PublishItemTest)
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "replayring.h"
+
+class ReplayRingTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	static PublishItem makeItem(const QString &channel, const QString &id, const QByteArray &body)
+	{
+		PublishItem item;
+		item.channel = channel;
+		item.id = id;
+
+		PublishFormat f;
+		f.type = PublishFormat::HttpStream;
+		f.body = body;
+		item.formats.insert(PublishFormat::HttpStream, f);
+
+		return item;
+	}
+
+private slots:
+	void catchUp()
+	{
+		ReplayRing r;
+
+		r.add(makeItem("test", "1", "one"), 1000);
+		r.add(makeItem("test", "2", "two"), 2000);
+		r.add(makeItem("test", "3", "three"), 3000);
+
+		QVERIFY(r.contains("test", "1", 3000));
+		QVERIFY(!r.contains("test", "0", 3000));
+		QVERIFY(!r.contains("other", "1", 3000));
+
+		bool ok;
+		QList<PublishItem> items = r.itemsSince("test", "1", 3000, &ok);
+		QVERIFY(ok);
+		QCOMPARE(items.count(), 2);
+		QCOMPARE(items[0].id, QString("2"));
+		QCOMPARE(items[1].id, QString("3"));
+
+		// current position yields an empty but successful result
+		items = r.itemsSince("test", "3", 3000, &ok);
+		QVERIFY(ok);
+		QVERIFY(items.isEmpty());
+
+		// unknown position fails
+		items = r.itemsSince("test", "0", 3000, &ok);
+		QVERIFY(!ok);
+	}
+
+	void itemsWithoutIdIgnored()
+	{
+		ReplayRing r;
+
+		r.add(makeItem("test", QString(), "one"), 1000);
+		QVERIFY(!r.contains("test", "", 1000));
+	}
+
+	void countLimit()
+	{
+		ReplayRing r(2, 262144, 60);
+
+		r.add(makeItem("test", "1", "one"), 1000);
+		r.add(makeItem("test", "2", "two"), 1000);
+		r.add(makeItem("test", "3", "three"), 1000);
+
+		// oldest dropped
+		QVERIFY(!r.contains("test", "1", 1000));
+		QVERIFY(r.contains("test", "2", 1000));
+		QVERIFY(r.contains("test", "3", 1000));
+	}
+
+	void byteLimit()
+	{
+		ReplayRing r(64, 10, 60);
+
+		r.add(makeItem("test", "1", "12345678"), 1000);
+		r.add(makeItem("test", "2", "12345678"), 1000);
+
+		QVERIFY(!r.contains("test", "1", 1000));
+		QVERIFY(r.contains("test", "2", 1000));
+	}
+
+	void ttl()
+	{
+		ReplayRing r(64, 262144, 60);
+
+		r.add(makeItem("test", "1", "one"), 1000);
+		r.add(makeItem("test", "2", "two"), 50000);
+
+		QVERIFY(r.contains("test", "1", 50000));
+
+		// expired entries don't satisfy a position, even before trim
+		QVERIFY(!r.contains("test", "1", 70000));
+		QVERIFY(r.contains("test", "2", 70000));
+	}
+};
+
+QTEST_MAIN(ReplayRingTest)
+#include "replayringtest.moc"
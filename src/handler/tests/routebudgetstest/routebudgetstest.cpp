@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "routebudgets.h"
+
+class RouteBudgetsTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void accounting()
+	{
+		RouteBudgets b;
+
+		b.addConnection("a", 100);
+		b.addConnection("a", 50);
+		b.addConnection("b", 10);
+		QCOMPARE(b.connections("a"), 2);
+		QCOMPARE(b.heldBytes("a"), (qint64)150);
+		QCOMPARE(b.totalHeldBytes(), (qint64)160);
+
+		b.removeConnection("a", 100);
+		QCOMPARE(b.connections("a"), 1);
+		QCOMPARE(b.heldBytes("a"), (qint64)50);
+		QCOMPARE(b.totalHeldBytes(), (qint64)60);
+
+		// empty routes disappear
+		b.removeConnection("b", 10);
+		QCOMPARE(b.connections("b"), 0);
+		QCOMPARE(b.totalHeldBytes(), (qint64)50);
+	}
+
+	void clamping()
+	{
+		RouteBudgets b;
+
+		// removal without a matching add must not go negative
+		b.removeConnection("a", 100);
+		QCOMPARE(b.connections("a"), 0);
+		QCOMPARE(b.totalHeldBytes(), (qint64)0);
+
+		b.addConnection("a", 10);
+		b.removeConnection("a", 50);
+		QCOMPARE(b.heldBytes("a"), (qint64)0);
+		QCOMPARE(b.totalHeldBytes(), (qint64)0);
+
+		b.removeSubscription("a");
+		QCOMPARE(b.subscriptions("a"), 0);
+	}
+
+	void connectionBudget()
+	{
+		RouteBudgets b;
+		b.setMaxConnections(2);
+
+		QVERIFY(b.canAcceptHold("a", 2, 0));
+		QVERIFY(!b.canAcceptHold("a", 3, 0));
+
+		b.addConnection("a");
+		QVERIFY(b.canAcceptHold("a", 1, 0));
+		QVERIFY(!b.canAcceptHold("a", 2, 0));
+
+		// other routes are unaffected
+		QVERIFY(b.canAcceptHold("b", 2, 0));
+	}
+
+	void heldBytesBudget()
+	{
+		RouteBudgets b;
+		b.setMaxHeldBytes(100);
+
+		b.addConnection("a", 80);
+		QVERIFY(b.canAcceptHold("a", 1, 20));
+		QVERIFY(!b.canAcceptHold("a", 1, 21));
+	}
+
+	void subscriptionBudget()
+	{
+		RouteBudgets b;
+		b.setMaxSubscriptions(1);
+
+		b.addSubscription("a");
+		QVERIFY(b.canAcceptHold("a", 1, 0));
+
+		b.addSubscription("a");
+		QVERIFY(!b.canAcceptHold("a", 1, 0));
+
+		b.removeSubscription("a");
+		QVERIFY(b.canAcceptHold("a", 1, 0));
+	}
+
+	void rejections()
+	{
+		RouteBudgets b;
+
+		QCOMPARE(b.holdsRejected(), (quint64)0);
+		b.recordHoldRejected("a");
+		b.recordHoldRejected("b");
+		QCOMPARE(b.holdsRejected(), (quint64)2);
+	}
+};
+
+QTEST_MAIN(RouteBudgetsTest)
+
+#include "routebudgetstest.moc"
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "publishitem.h"
+#include "publishlastids.h"
+#include "sequencer.h"
+
+class SequencerTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	static PublishItem makeItem(const QString &channel, const QString &id, const QString &prevId)
+	{
+		PublishItem item;
+		item.channel = channel;
+		item.id = id;
+		item.prevId = prevId;
+		return item;
+	}
+
+private slots:
+	void inOrderFastPath()
+	{
+		PublishLastIds lastIds(100);
+		Sequencer s(&lastIds);
+
+		QList<PublishItem> received;
+		connect(&s, &Sequencer::itemReady, [&](const PublishItem &item) {
+			received += item;
+		});
+
+		s.addItem(makeItem("apple", "1", QString()));
+		s.addItem(makeItem("apple", "2", "1"));
+		s.addItem(makeItem("apple", "3", "2"));
+
+		QCOMPARE(received.count(), 3);
+		QCOMPARE(received[2].id, QString("3"));
+		QCOMPARE(lastIds.value("apple"), QString("3"));
+
+		QCOMPARE(s.fastPathCount(), (quint64)3);
+		QCOMPARE(s.slowPathCount(), (quint64)0);
+	}
+
+	void outOfOrderBuffered()
+	{
+		PublishLastIds lastIds(100);
+		Sequencer s(&lastIds);
+
+		QList<PublishItem> received;
+		connect(&s, &Sequencer::itemReady, [&](const PublishItem &item) {
+			received += item;
+		});
+
+		s.addItem(makeItem("apple", "1", QString()));
+		QCOMPARE(s.fastPathCount(), (quint64)1);
+
+		// out of order: held until its prev-id arrives
+		s.addItem(makeItem("apple", "3", "2"));
+		QCOMPARE(received.count(), 1);
+
+		// filling the gap releases the chain
+		s.addItem(makeItem("apple", "2", "1"));
+		QCOMPARE(received.count(), 3);
+		QCOMPARE(received[1].id, QString("2"));
+		QCOMPARE(received[2].id, QString("3"));
+		QCOMPARE(lastIds.value("apple"), QString("3"));
+
+		QCOMPARE(s.fastPathCount(), (quint64)1);
+		QCOMPARE(s.slowPathCount(), (quint64)2);
+
+		// with nothing pending, the channel is back on the fast path
+		s.addItem(makeItem("apple", "4", "3"));
+		QCOMPARE(received.count(), 4);
+		QCOMPARE(s.fastPathCount(), (quint64)2);
+	}
+};
+
+QTEST_MAIN(SequencerTest)
+
+#include "sequencertest.moc"
@@ -15,6 +15,8 @@ PRE_TARGETDEPS += $$PWD/../libpushpin-handler.a
 LIBS += -L$$PWD/../../corelib -lpushpin-core
 PRE_TARGETDEPS += $$PWD/../../corelib/libpushpin-core.a
 
+LIBS += -lz
+
 include($$PWD/../../../conf.pri)
 
 INCLUDEPATH += $$SRC_DIR
@@ -6,4 +6,15 @@ SUBDIRS += \
 	idformattest \
 	publishformattest \
 	publishitemtest \
-	enginetest
+	wscontrolpackettest \
+	sequencertest \
+	channelindextest \
+	channelinterntest \
+	heavyhitterstest \
+	bodycachetest \
+	routebudgetstest \
+	replayringtest \
+	enginetest \
+	enginebench \
+	enginesoak \
+	packetbench
@@ -28,34 +28,35 @@
 
 #include "wscontrolmessage.h"
 
-#include <QVariant>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
 #include "variantutil.h"
 
-using namespace VariantUtil;
+using VariantUtil::setSuccess;
+using VariantUtil::setError;
 
-WsControlMessage WsControlMessage::fromVariant(const QVariant &in, bool *ok, QString *errorMessage)
+WsControlMessage WsControlMessage::fromJson(const QJsonObject &in, bool *ok, QString *errorMessage)
 {
-	QString pn = "grip control packet";
+	QString pn = "grip control object";
 
-	if(!isKeyedObject(in))
+	WsControlMessage out;
+
+	QJsonValue vtype = in.value("type");
+	if(vtype.isUndefined())
 	{
-		setError(ok, errorMessage, QString("%1 is not an object").arg(pn));
+		setError(ok, errorMessage, QString("%1 does not contain 'type'").arg(pn));
 		return WsControlMessage();
 	}
 
-	pn = "grip control object";
-
-	WsControlMessage out;
-
-	bool ok_;
-	QString type = getString(in, pn, "type", true, &ok_, errorMessage);
-	if(!ok_)
+	if(!vtype.isString())
 	{
-		if(ok)
-			*ok = false;
+		setError(ok, errorMessage, QString("%1 contains 'type' with wrong type").arg(pn));
 		return WsControlMessage();
 	}
 
+	QString type = vtype.toString();
+
 	if(type == "subscribe")
 		out.type = Subscribe;
 	else if(type == "unsubscribe")
@@ -80,14 +81,21 @@ WsControlMessage WsControlMessage::fromVariant(const QVariant &in, bool *ok, QSt
 
 	if(out.type == Subscribe || out.type == Unsubscribe)
 	{
-		out.channel = getString(in, pn, "channel", true, &ok_, errorMessage);
-		if(!ok_)
+		QJsonValue vchannel = in.value("channel");
+		if(vchannel.isUndefined())
+		{
+			setError(ok, errorMessage, QString("%1 does not contain 'channel'").arg(pn));
+			return WsControlMessage();
+		}
+
+		if(!vchannel.isString())
 		{
-			if(ok)
-				*ok = false;
+			setError(ok, errorMessage, QString("%1 contains 'channel' with wrong type").arg(pn));
 			return WsControlMessage();
 		}
 
+		out.channel = vchannel.toString();
+
 		if(out.channel.isEmpty())
 		{
 			setError(ok, errorMessage, QString("%1 contains 'channel' with invalid value").arg(pn));
@@ -96,73 +104,90 @@ WsControlMessage WsControlMessage::fromVariant(const QVariant &in, bool *ok, QSt
 
 		if(out.type == Subscribe)
 		{
-			QVariantList vfilters = getList(in, pn, "filters", false, &ok_, errorMessage);
-			if(!ok_)
+			QJsonValue vfilters = in.value("filters");
+			if(!vfilters.isUndefined())
 			{
-				if(ok)
-					*ok = false;
-				return WsControlMessage();
-			}
-
-			foreach(const QVariant &vfilter, vfilters)
-			{
-				QString filter = getString(vfilter, &ok_);
-				if(!ok_)
+				if(!vfilters.isArray())
 				{
-					setError(ok, errorMessage, "filters contains value with wrong type");
+					setError(ok, errorMessage, QString("%1 contains 'filters' with wrong type").arg(pn));
 					return WsControlMessage();
 				}
 
-				out.filters += filter;
+				foreach(const QJsonValue &vfilter, vfilters.toArray())
+				{
+					if(!vfilter.isString())
+					{
+						setError(ok, errorMessage, "filters contains value with wrong type");
+						return WsControlMessage();
+					}
+
+					out.filters += vfilter.toString();
+				}
 			}
 		}
 	}
 	else if(out.type == Session)
 	{
-		out.sessionId = getString(in, pn, "id", false, &ok_, errorMessage);
-		if(!ok_)
+		QJsonValue vid = in.value("id");
+		if(!vid.isUndefined())
 		{
-			if(ok)
-				*ok = false;
-			return WsControlMessage();
+			if(!vid.isString())
+			{
+				setError(ok, errorMessage, QString("%1 contains 'id' with wrong type").arg(pn));
+				return WsControlMessage();
+			}
+
+			out.sessionId = vid.toString();
 		}
 	}
 	else if(out.type == SetMeta)
 	{
-		out.metaName = getString(in, pn, "name", true, &ok_, errorMessage);
-		if(!ok_)
+		QJsonValue vname = in.value("name");
+		if(vname.isUndefined())
+		{
+			setError(ok, errorMessage, QString("%1 does not contain 'name'").arg(pn));
+			return WsControlMessage();
+		}
+
+		if(!vname.isString())
 		{
-			if(ok)
-				*ok = false;
+			setError(ok, errorMessage, QString("%1 contains 'name' with wrong type").arg(pn));
 			return WsControlMessage();
 		}
 
+		out.metaName = vname.toString();
+
 		if(out.metaName.isEmpty())
 		{
 			setError(ok, errorMessage, QString("%1 contains 'name' with invalid value").arg(pn));
 			return WsControlMessage();
 		}
 
-		out.metaValue = getString(in, pn, "value", false, &ok_, errorMessage);
-		if(!ok_)
+		QJsonValue vvalue = in.value("value");
+		if(!vvalue.isUndefined())
 		{
-			if(ok)
-				*ok = false;
-			return WsControlMessage();
+			if(!vvalue.isString())
+			{
+				setError(ok, errorMessage, QString("%1 contains 'value' with wrong type").arg(pn));
+				return WsControlMessage();
+			}
+
+			out.metaValue = vvalue.toString();
 		}
 	}
 	else if(out.type == KeepAlive || out.type == SendDelayed)
 	{
-		QString typeStr = getString(in, pn, "message-type", false, &ok_, errorMessage);
-		if(!ok_)
+		QJsonValue vmessageType = in.value("message-type");
+		if(!vmessageType.isUndefined())
 		{
-			if(ok)
-				*ok = false;
-			return WsControlMessage();
-		}
+			if(!vmessageType.isString())
+			{
+				setError(ok, errorMessage, QString("%1 contains 'message-type' with wrong type").arg(pn));
+				return WsControlMessage();
+			}
+
+			QString typeStr = vmessageType.toString();
 
-		if(!typeStr.isNull())
-		{
 			if(typeStr == "text")
 				out.messageType = Text;
 			else if(typeStr == "binary")
@@ -183,63 +208,47 @@ WsControlMessage WsControlMessage::fromVariant(const QVariant &in, bool *ok, QSt
 			out.messageType = Text;
 		}
 
-		if(keyedObjectContains(in, "content-bin"))
+		QJsonValue vcontentBin = in.value("content-bin");
+		QJsonValue vcontent = in.value("content");
+		if(!vcontentBin.isUndefined())
 		{
-			QVariant vcontentBin = keyedObjectGetValue(in, "content-bin");
-
-			if(in.type() == QVariant::Map) // JSON input
+			if(!vcontentBin.isString())
 			{
-				if(vcontentBin.type() != QVariant::String)
-				{
-					setError(ok, errorMessage, QString("%1 contains 'content-bin' with wrong type").arg(pn));
-					return WsControlMessage();
-				}
-
-				out.content = QByteArray::fromBase64(vcontentBin.toString().toUtf8());
+				setError(ok, errorMessage, QString("%1 contains 'content-bin' with wrong type").arg(pn));
+				return WsControlMessage();
 			}
-			else
-			{
-				if(vcontentBin.type() != QVariant::ByteArray)
-				{
-					setError(ok, errorMessage, QString("%1 contains 'content-bin' with wrong type").arg(pn));
-					return WsControlMessage();
-				}
 
-				out.content = vcontentBin.toByteArray();
-			}
+			out.content = QByteArray::fromBase64(vcontentBin.toString().toUtf8());
 
 			if(((int)out.messageType) == -1)
 				out.messageType = Binary;
 		}
-		else if(keyedObjectContains(in, "content"))
+		else if(!vcontent.isUndefined())
 		{
-			QVariant vcontent = keyedObjectGetValue(in, "content");
-			if(vcontent.type() == QVariant::ByteArray)
-				out.content = vcontent.toByteArray();
-			else if(vcontent.type() == QVariant::String)
-				out.content = vcontent.toString().toUtf8();
-			else
+			if(!vcontent.isString())
 			{
 				setError(ok, errorMessage, QString("%1 contains 'content' with wrong type").arg(pn));
 				return WsControlMessage();
 			}
 
+			out.content = vcontent.toString().toUtf8();
+
 			if(((int)out.messageType) == -1)
 				out.messageType = Text;
 		}
 
 		if(!out.content.isNull())
 		{
-			if(keyedObjectContains(in, "timeout"))
+			QJsonValue vtimeout = in.value("timeout");
+			if(!vtimeout.isUndefined())
 			{
-				QVariant vtimeout = keyedObjectGetValue(in, "timeout");
-				if(!vtimeout.canConvert(QVariant::Int))
+				if(!vtimeout.isDouble())
 				{
 					setError(ok, errorMessage, QString("%1 contains 'timeout' with wrong type").arg(pn));
 					return WsControlMessage();
 				}
 
-				out.timeout = vtimeout.toInt();
+				out.timeout = (int)vtimeout.toDouble();
 
 				if(out.timeout < 0)
 				{
@@ -250,5 +259,6 @@ WsControlMessage WsControlMessage::fromVariant(const QVariant &in, bool *ok, QSt
 		}
 	}
 
+	setSuccess(ok, errorMessage);
 	return out;
 }
@@ -32,7 +32,7 @@
 #include <QString>
 #include <QStringList>
 
-class QVariant;
+class QJsonObject;
 
 class WsControlMessage
 {
@@ -74,7 +74,10 @@ public:
 	{
 	}
 
-	static WsControlMessage fromVariant(const QVariant &in, bool *ok = 0, QString *errorMessage = 0);
+	// decode directly from a parsed json object. fields are read into
+	//   typed members in one pass, without building an intermediate
+	//   variant tree
+	static WsControlMessage fromJson(const QJsonObject &in, bool *ok = 0, QString *errorMessage = 0);
 };
 
 #endif
@@ -381,6 +381,7 @@ public:
 		int readCount;
 		BufferList pendingIn;
 		QList<ZhttpRequestPacket> pendingInPackets;
+		int pendingInBytes;
 		bool inFinished;
 
 		// zhttp stuff
@@ -406,6 +407,7 @@ public:
 			respondClose(false),
 			chunked(false),
 			readCount(0),
+			pendingInBytes(0),
 			inFinished(false),
 			sentResponseHeader(false),
 			outSeq(0),
@@ -455,6 +457,8 @@ public:
 	QTime time;
 	QTimer *statusTimer;
 	QTimer *refreshTimer;
+	QHash<QByteArray, QList<QByteArray> > pendingCancels; // k=sender
+	QTimer *cancelFlushTimer;
 
 	Private(App *_q) :
 		QObject(_q),
@@ -482,6 +486,10 @@ public:
 
 		refreshTimer = new QTimer(this);
 		connect(refreshTimer, &QTimer::timeout, this, &Private::refresh_timeout);
+
+		cancelFlushTimer = new QTimer(this);
+		cancelFlushTimer->setSingleShot(true);
+		connect(cancelFlushTimer, &QTimer::timeout, this, &Private::cancelFlush_timeout);
 	}
 
 	~Private()
@@ -935,6 +943,34 @@ public:
 		m2_out_sock->write(QList<QByteArray>() << buf);
 	}
 
+	// writev-style send: the wire message is assembled in one pass from
+	//   the payload pieces, so body data is copied exactly once on its
+	//   way out. mongrel2 expects a single-frame message, so the chain
+	//   is flattened into one buffer rather than sent as separate zmq
+	//   frames
+	void m2_out_writeParts(const QByteArray &sender, const QByteArray &id, const QList<QByteArray> &dataParts)
+	{
+		QByteArray tnetId = TnetString::fromByteArray(id);
+
+		int dataSize = 0;
+		foreach(const QByteArray &part, dataParts)
+			dataSize += part.size();
+
+		QByteArray buf;
+		buf.reserve(sender.size() + 1 + tnetId.size() + 1 + dataSize);
+		buf += sender;
+		buf += ' ';
+		buf += tnetId;
+		buf += ' ';
+		foreach(const QByteArray &part, dataParts)
+			buf += part;
+
+		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+			LogUtil::logByteArray(LOG_LEVEL_DEBUG, buf, "m2: OUT");
+
+		m2_out_sock->write(QList<QByteArray>() << buf);
+	}
+
 	void m2_control_write(int index, const QByteArray &cmd, const QVariantHash &args)
 	{
 		QVariantList vlist;
@@ -983,16 +1019,35 @@ public:
 
 	void m2_writeCtlCancel(const QByteArray &sender, const QByteArray &id)
 	{
-		M2ResponsePacket mresp;
-		mresp.sender = sender;
-		mresp.id = "X " + id;
-		QVariantHash args;
-		args["cancel"] = true;
-		QVariantList parts;
-		parts += QByteArray("ctl");
-		parts += args;
-		mresp.data = TnetString::fromVariant(parts);
-		m2_out_write(mresp);
+		// cancels batch for the turn and go out as multi-target ctl
+		//   packets, the way keep-alives already do, so a mass
+		//   disconnect doesn't send one message per connection
+		QList<QByteArray> &ids = pendingCancels[sender];
+		ids += id;
+
+		if(ids.count() >= M2_HANDLER_TARGETS_MAX)
+			flushCancels();
+		else if(!cancelFlushTimer->isActive())
+			cancelFlushTimer->start(0);
+	}
+
+	void flushCancels()
+	{
+		QHashIterator<QByteArray, QList<QByteArray> > it(pendingCancels);
+		while(it.hasNext())
+		{
+			it.next();
+			const QList<QByteArray> &ids = it.value();
+
+			QVariantHash args;
+			args["cancel"] = true;
+
+			for(int n = 0; n < ids.count(); n += M2_HANDLER_TARGETS_MAX)
+				m2_writeCtlMany(it.key(), ids.mid(n, M2_HANDLER_TARGETS_MAX), args);
+		}
+
+		pendingCancels.clear();
+		cancelFlushTimer->stop();
 	}
 
 	void m2_writeCtlCancel(M2Connection *conn)
@@ -1002,20 +1057,27 @@ public:
 		delete conn;
 	}
 
-	// contentSize = packet.data.size() - framing overhead
-	void m2_writeData(M2Connection *conn, const M2ResponsePacket &packet, int contentSize)
+	// contentSize = payload size - framing overhead. returns the
+	//   payload size written
+	int m2_writeData(M2Connection *conn, const QList<QByteArray> &dataParts, int contentSize)
 	{
+		int dataSize = 0;
+		foreach(const QByteArray &part, dataParts)
+			dataSize += part.size();
+
 		if(conn->outCreditsEnabled)
-			conn->outCredits -= packet.data.size();
+			conn->outCredits -= dataSize;
 
 		conn->bodyTracker.addPlain(contentSize);
-		conn->bodyTracker.specifyEncoded(packet.data.size(), contentSize);
+		conn->bodyTracker.specifyEncoded(dataSize, contentSize);
 
 		++(conn->packetsPending);
 		conn->packetTracker.addPlain(1);
-		conn->packetTracker.specifyEncoded(packet.data.size(), 1);
+		conn->packetTracker.specifyEncoded(dataSize, 1);
+
+		m2_out_writeParts(m2_send_idents[conn->identIndex], conn->id, dataParts);
 
-		m2_out_write(packet);
+		return dataSize;
 	}
 
 	void m2_queueHeaders(M2Connection *conn, const QByteArray &headerData)
@@ -1096,17 +1158,15 @@ public:
 			M2PendingOutItem *item = &conn->pendingOutItems.first();
 			if(item->type == M2PendingOutItem::Headers)
 			{
-				M2ResponsePacket packet;
-				packet.sender = m2_send_idents[conn->identIndex];
-				packet.id = conn->id;
-				packet.data = item->data.take();
+				QList<QByteArray> dataParts;
+				dataParts += item->data.take();
 
 				conn->pendingOutItems.removeFirst();
 
-				m2_writeData(conn, packet, 0);
+				int dataSize = m2_writeData(conn, dataParts, 0);
 
 				if(!conn->flowControl)
-					handleConnectionBytesWritten(conn, packet.data.size(), true);
+					handleConnectionBytesWritten(conn, dataSize, true);
 			}
 			else if(item->type == M2PendingOutItem::Response)
 			{
@@ -1133,38 +1193,39 @@ public:
 				QByteArray data = item->data.take(maxSize);
 				int contentSize = data.size();
 
-				M2ResponsePacket packet;
-				packet.sender = m2_send_idents[conn->identIndex];
-				packet.id = conn->id;
-
+				// chain the chunk framing around the body instead of
+				//   concatenating into a new buffer
+				QList<QByteArray> dataParts;
 				if(item->chunked)
-					packet.data = makeChunkHeader(data.size()) + data + makeChunkFooter();
+				{
+					dataParts += makeChunkHeader(data.size());
+					dataParts += data;
+					dataParts += makeChunkFooter();
+				}
 				else
-					packet.data = data;
+					dataParts += data;
 
 				if(item->data.isEmpty())
 					conn->pendingOutItems.removeFirst();
 
-				m2_writeData(conn, packet, contentSize);
+				int dataSize = m2_writeData(conn, dataParts, contentSize);
 
 				if(!conn->flowControl)
-					handleConnectionBytesWritten(conn, packet.data.size(), true);
+					handleConnectionBytesWritten(conn, dataSize, true);
 			}
 			else if(item->type == M2PendingOutItem::Frame)
 			{
-				M2ResponsePacket packet;
-				packet.sender = m2_send_idents[conn->identIndex];
-				packet.id = conn->id;
-				packet.data = item->data.take();
+				QList<QByteArray> dataParts;
+				dataParts += item->data.take();
 
 				int contentSize = item->contentSize;
 
 				conn->pendingOutItems.removeFirst();
 
-				m2_writeData(conn, packet, contentSize);
+				int dataSize = m2_writeData(conn, dataParts, contentSize);
 
 				if(!conn->flowControl)
-					handleConnectionBytesWritten(conn, packet.data.size(), true);
+					handleConnectionBytesWritten(conn, dataSize, true);
 			}
 			else if(item->type == M2PendingOutItem::Close)
 			{
@@ -1686,6 +1747,8 @@ public:
 
 					zhttp_out_write(s, zreq);
 				}
+
+				s->pendingInBytes = 0;
 			}
 
 			// if we didn't send credits as part of a data packet, we'll do them now
@@ -2651,6 +2714,18 @@ private slots:
 			{
 				if(s->inHandoff)
 				{
+					// during handoff there's no receiver to flow credits
+					//   from, so body data must queue here. bound it, so
+					//   a client that keeps uploading can't inflate
+					//   memory for the duration
+					if(s->pendingIn.size() + mreq.body.size() > m2_client_buffer)
+					{
+						log_warning("m2: %s id=%s handoff buffer full, closing", m2_send_idents[s->conn->identIndex].data(), mreq.id.data());
+						endSession(s);
+						m2_writeCtlCancel(conn);
+						return;
+					}
+
 					s->pendingIn += mreq.body;
 				}
 				else
@@ -2712,7 +2787,17 @@ private slots:
 
 				if(s->inHandoff)
 				{
+					// same bound as the http handoff buffer
+					if(s->pendingInBytes + zreq.body.size() > m2_client_buffer)
+					{
+						log_warning("m2: %s id=%s handoff buffer full, closing", m2_send_idents[s->conn->identIndex].data(), mreq.id.data());
+						endSession(s);
+						m2_writeCtlCancel(conn);
+						return;
+					}
+
 					s->pendingInPackets += zreq;
+					s->pendingInBytes += zreq.body.size();
 				}
 				else
 				{
@@ -2849,6 +2934,11 @@ private slots:
 		cancelSessions();
 	}
 
+	void cancelFlush_timeout()
+	{
+		flushCancels();
+	}
+
 	void reload()
 	{
 		log_info("reloading");
@@ -29,40 +29,46 @@
 #include "m2requestpacket.h"
 
 #include <QSet>
+#include <QHash>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include "tnetstring.h"
+#include "tnetstringview.h"
 
-static bool isAllCaps(const QString &s)
+static bool isAllCaps(const QByteArray &s)
 {
 	for(int n = 0; n < s.length(); ++n)
 	{
-		QChar c = s[n];
+		char c = s[n];
 
 		// non-letters are allowed, so what we really check against is
 		//   lowercase
-		if(c.isLower())
+		if(c >= 'a' && c <= 'z')
 			return false;
 	}
 
 	return true;
 }
 
-static QString makeMixedCaseHeader(const QString &s)
+static QByteArray makeMixedCaseHeader(const QByteArray &s)
 {
-	QString out;
-	for(int n = 0; n < s.length(); ++n)
+	QByteArray out = s;
+	for(int n = 0; n < out.length(); ++n)
 	{
-		QChar c = s[n];
-		if(n == 0 || (n - 1 >= 0 && s[n - 1] == '-'))
-			out += c.toUpper();
-		else
-			out += c;
+		char c = out[n];
+		if((n == 0 || out[n - 1] == '-') && c >= 'a' && c <= 'z')
+			out[n] = c - 0x20;
 	}
 
 	return out;
 }
 
+// detach a view from the source frame, for values retained beyond
+//   parsing
+static QByteArray copyView(const QByteArray &view)
+{
+	return QByteArray(view.constData(), view.size());
+}
+
 M2RequestPacket::M2RequestPacket() :
 	type((Type)-1),
 	uploadDone(false),
@@ -95,68 +101,63 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 		return false;
 
 	start = end + 1;
-	TnetString::Type htype;
-	int offset, size;
-	if(!TnetString::check(in, start, &htype, &offset, &size))
-		return false;
-
-	if(htype != TnetString::Hash && htype != TnetString::ByteArray)
+	TnetStringView hview(in, start);
+	if(!hview.isValid())
 		return false;
 
-	bool ok;
-	QVariant vheaders = TnetString::toVariant(in, start, htype, offset, size, &ok);
-	if(!ok)
+	if(hview.type() != TnetStringView::Map && hview.type() != TnetStringView::ByteArray)
 		return false;
 
-	QSet<QString> skipHeaders;
+	QSet<QByteArray> skipHeaders;
 	skipHeaders += "x-mongrel2-upload-start";
 	skipHeaders += "x-mongrel2-upload-done";
 
 	headers.clear(); // will store full headers
-	QMap<QString, QByteArray> m2headers; // single-value map for easy processing
-	if(htype == TnetString::Hash)
+	QHash<QByteArray, QByteArray> m2headers; // single-value map for easy processing
+	if(hview.type() == TnetStringView::Map)
 	{
-		QVariantMap headersMap = vheaders.toMap();
-		QMapIterator<QString, QVariant> vit(headersMap);
-		while(vit.hasNext())
+		// walk the encoded map in place. keys and values are views into
+		//   the input, so nothing is copied except the headers we keep
+		TnetStringView::MapIterator it(hview);
+		QByteArray key;
+		TnetStringView val;
+		while(it.next(&key, &val))
 		{
-			vit.next();
-
-			QString key = vit.key();
-			QVariant val = vit.value();
-
-			if(val.type() == QVariant::ByteArray)
+			if(val.type() == TnetStringView::ByteArray)
 			{
-				QByteArray ba = val.toByteArray();
-
-				m2headers[key] = ba;
+				m2headers[key] = val.toByteArray();
 
 				if(!isAllCaps(key) && !skipHeaders.contains(key))
-					headers += HttpHeader(makeMixedCaseHeader(key).toLatin1(), ba);
+					headers += HttpHeader(makeMixedCaseHeader(key), copyView(val.toByteArray()));
 			}
-			else if(val.type() == QVariant::List)
+			else if(val.type() == TnetStringView::List)
 			{
-				QVariantList vl = val.toList();
-				if(vl.isEmpty())
-					return false;
+				bool keep = (!isAllCaps(key) && !skipHeaders.contains(key));
 
-				if(vl[0].type() != QVariant::ByteArray)
-					return false;
-
-				m2headers[key] = vl[0].toByteArray();
+				QByteArray name;
+				if(keep)
+					name = makeMixedCaseHeader(key);
 
-				if(!isAllCaps(key) && !skipHeaders.contains(key))
+				TnetStringView::ListIterator lit(val);
+				TnetStringView lval;
+				bool first = true;
+				while(lit.next(&lval))
 				{
-					QByteArray name = makeMixedCaseHeader(key).toLatin1();
+					if(lval.type() != TnetStringView::ByteArray)
+						return false;
 
-					foreach(const QVariant &v, vl)
+					if(first)
 					{
-						if(v.type() != QVariant::ByteArray)
-							return false;
-
-						headers += HttpHeader(name, v.toByteArray());
+						m2headers[key] = lval.toByteArray();
+						first = false;
 					}
+
+					if(keep)
+						headers += HttpHeader(name, copyView(lval.toByteArray()));
 				}
+
+				if(first)
+					return false;
 			}
 			else
 				return false;
@@ -165,7 +166,7 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 	else // ByteArray
 	{
 		QJsonParseError error;
-		QJsonDocument doc = QJsonDocument::fromJson(vheaders.toByteArray(), &error);
+		QJsonDocument doc = QJsonDocument::fromJson(hview.toByteArray(), &error);
 		if(error.error != QJsonParseError::NoError || !doc.isObject())
 			return false;
 
@@ -175,7 +176,7 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 		{
 			vit.next();
 
-			QString key = vit.key();
+			QByteArray key = vit.key().toLatin1();
 			QVariant val = vit.value();
 
 			if(val.type() == QVariant::String)
@@ -185,7 +186,7 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 				m2headers[key] = ba;
 
 				if(!isAllCaps(key) && !skipHeaders.contains(key))
-					headers += HttpHeader(makeMixedCaseHeader(key).toLatin1(), ba);
+					headers += HttpHeader(makeMixedCaseHeader(key), ba);
 			}
 			else if(val.type() == QVariant::List)
 			{
@@ -200,7 +201,7 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 
 				if(!isAllCaps(key) && !skipHeaders.contains(key))
 				{
-					QByteArray name = makeMixedCaseHeader(key).toLatin1();
+					QByteArray name = makeMixedCaseHeader(key);
 
 					foreach(const QVariant &v, vl)
 					{
@@ -216,20 +217,19 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 		}
 	}
 
-	start = offset + size + 1;
-	TnetString::Type btype;
-	if(!TnetString::check(in, start, &btype, &offset, &size))
+	start = hview.offset() + hview.encodedSize();
+	TnetStringView bview(in, start);
+	if(!bview.isValid())
 		return false;
 
-	if(btype != TnetString::ByteArray)
+	if(bview.type() != TnetStringView::ByteArray)
 		return false;
 
-	body = TnetString::toByteArray(in, start, offset, size, &ok);
-	if(!ok)
-		return false;
+	// the body may outlive the input buffer, so this is the one copy
+	body = copyView(bview.toByteArray());
 
-	scheme = m2headers.value("URL_SCHEME");
-	version = m2headers.value("VERSION");
+	scheme = copyView(m2headers.value("URL_SCHEME"));
+	version = copyView(m2headers.value("VERSION"));
 
 	QByteArray m2method = m2headers.value("METHOD");
 
@@ -262,7 +262,7 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 	QByteArray m2RemoteAddr = m2headers.value("REMOTE_ADDR");
 
 	method = QString::fromLatin1(m2method);
-	uri = m2headers.value("URI");
+	uri = copyView(m2headers.value("URI"));
 
 	remoteAddress = QHostAddress();
 	if(!m2RemoteAddr.isEmpty())
@@ -278,6 +278,7 @@ bool M2RequestPacket::fromByteArray(const QByteArray &in)
 		type = WebSocketFrame;
 
 		QByteArray flagsStr = m2headers.value("FLAGS");
+		bool ok;
 		frameFlags = flagsStr.toInt(&ok, 16);
 		return ok;
 	}
@@ -36,5 +36,15 @@ M2ResponsePacket::M2ResponsePacket()
 
 QByteArray M2ResponsePacket::toByteArray() const
 {
-	return sender + ' ' + TnetString::fromByteArray(id) + ' ' + data;
+	QByteArray tnetId = TnetString::fromByteArray(id);
+
+	// single pass, avoiding intermediate concatenations
+	QByteArray out;
+	out.reserve(sender.size() + 1 + tnetId.size() + 1 + data.size());
+	out += sender;
+	out += ' ';
+	out += tnetId;
+	out += ' ';
+	out += data;
+	return out;
 }
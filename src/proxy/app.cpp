@@ -286,6 +286,7 @@ public:
 		int ipcFileMode = settings.value("proxy/ipc_file_mode", -1).toString().toInt(&ok, 8);
 		int maxWorkers = settings.value("proxy/max_open_requests", -1).toInt();
 		QString routesFile = settings.value("proxy/routesfile").toString();
+		QString routesCacheFile = settings.value("proxy/routes_cache_file").toString();
 		bool debug = settings.value("proxy/debug").toBool();
 		bool autoCrossOrigin = settings.value("proxy/auto_cross_origin").toBool();
 		bool acceptXForwardedProtocol = settings.value("proxy/accept_x_forwarded_protocol").toBool();
@@ -304,6 +305,9 @@ public:
 		QString updatesCheck = settings.value("proxy/updates_check").toString();
 		QString organizationName = settings.value("proxy/organization_name").toString();
 		int statsConnectionTtl = settings.value("global/stats_connection_ttl", 120).toInt();
+		int wsOverHttpMaxBatchEvents = settings.value("proxy/ws_over_http_max_batch_events", 64).toInt();
+		int wsOverHttpMaxBatchBytes = settings.value("proxy/ws_over_http_max_batch_bytes", 65536).toInt();
+		int wsOverHttpBatchDelay = settings.value("proxy/ws_over_http_batch_delay", 0).toInt();
 
 		QList<QByteArray> origHeadersNeedMark;
 		foreach(const QString &s, origHeadersNeedMarkStr)
@@ -314,6 +318,13 @@ public:
 		if(fi.isRelative())
 			routesFile = QFileInfo(QFileInfo(configFile).absoluteDir(), routesFile).filePath();
 
+		if(!routesCacheFile.isEmpty())
+		{
+			QFileInfo cfi(routesCacheFile);
+			if(cfi.isRelative())
+				routesCacheFile = QFileInfo(QFileInfo(configFile).absoluteDir(), routesCacheFile).filePath();
+		}
+
 		if(m2a_in_specs.isEmpty() || m2a_in_stream_specs.isEmpty() || m2a_out_specs.isEmpty() || zurl_out_specs.isEmpty() || zurl_out_stream_specs.isEmpty() || zurl_in_specs.isEmpty())
 		{
 			log_error("must set m2a_in_specs, m2a_in_stream_specs, m2a_out_specs, zurl_out_specs, zurl_out_stream_specs, and zurl_in_specs");
@@ -346,9 +357,14 @@ public:
 		config.ipcFileMode = ipcFileMode;
 		config.maxWorkers = maxWorkers;
 		if(!args.routeLines.isEmpty())
+		{
 			config.routeLines = args.routeLines;
+		}
 		else
+		{
 			config.routesFile = routesFile;
+			config.routesCacheFile = routesCacheFile;
+		}
 		config.debug = debug;
 		config.autoCrossOrigin = autoCrossOrigin;
 		config.acceptXForwardedProto = acceptXForwardedProtocol;
@@ -367,6 +383,9 @@ public:
 		config.organizationName = organizationName;
 		config.quietCheck = args.quietCheck;
 		config.statsConnectionTtl = statsConnectionTtl;
+		config.wsOverHttpMaxBatchEvents = wsOverHttpMaxBatchEvents;
+		config.wsOverHttpMaxBatchBytes = wsOverHttpMaxBatchBytes;
+		config.wsOverHttpBatchDelay = wsOverHttpBatchDelay;
 
 		engine = new Engine(this);
 		if(!engine->start(config))
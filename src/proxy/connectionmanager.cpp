@@ -29,44 +29,77 @@
 #include "connectionmanager.h"
 
 #include <assert.h>
+#include <QVector>
 #include <QHash>
 #include "uuidutil.h"
 
+// connections are kept in a slot table and the cid encodes the slot index,
+//   so that resolving a cid received from the handler is an array access
+//   instead of a hash lookup, and adding/removing a connection doesn't
+//   allocate a per-entry node. slots are reused via a free list, with a
+//   generation counter embedded in the cid so that a stale cid referring
+//   to a recycled slot can't resolve to the wrong connection. a random
+//   per-instance prefix keeps cids globally unique, as the uuids were
+
 class ConnectionManager::Private
 {
 public:
 	class Item
 	{
 	public:
-		QPair<QByteArray, QByteArray> rid;
 		WebSocket *sock;
-		QByteArray cid;
 		WsProxySession *proxy;
+		QByteArray cid;
+		quint32 generation;
+		int nextFree; // -1 if in use or end of list
 
 		Item() :
 			sock(0),
-			proxy(0)
+			proxy(0),
+			generation(0),
+			nextFree(-1)
 		{
 		}
 	};
 
-	QHash<WebSocket*, Item*> itemsBySock;
-	QHash<QByteArray, Item*> itemsByCid;
+	QByteArray prefix;
+	QVector<Item> items;
+	int firstFree;
+	QHash<WebSocket*, int> indexBySock;
 
-	Private()
+	Private() :
+		prefix(UuidUtil::createUuid()),
+		firstFree(-1)
 	{
 	}
 
-	~Private()
+	QByteArray makeCid(int index) const
 	{
-		clearItemsBySock();
+		return prefix + '-' + QByteArray::number(index) + '-' + QByteArray::number(items[index].generation);
 	}
 
-	void clearItemsBySock()
+	// returns -1 if the cid doesn't refer to a live slot
+	int resolveCid(const QByteArray &cid) const
 	{
-		qDeleteAll(itemsBySock);
-		itemsBySock.clear();
-		itemsByCid.clear();
+		if(!cid.startsWith(prefix) || cid.length() <= prefix.length() || cid[prefix.length()] != '-')
+			return -1;
+
+		int at = cid.indexOf('-', prefix.length() + 1);
+		if(at == -1)
+			return -1;
+
+		bool ok;
+		int index = cid.mid(prefix.length() + 1, at - prefix.length() - 1).toInt(&ok);
+		if(!ok || index < 0 || index >= items.count())
+			return -1;
+
+		const Item &i = items[index];
+
+		// comparing the full cid also covers the generation
+		if(!i.sock || i.cid != cid)
+			return -1;
+
+		return index;
 	}
 };
 
@@ -82,48 +115,67 @@ ConnectionManager::~ConnectionManager()
 
 QByteArray ConnectionManager::addConnection(WebSocket *sock)
 {
-	assert(!d->itemsBySock.contains(sock));
+	assert(!d->indexBySock.contains(sock));
+
+	int index;
+	if(d->firstFree != -1)
+	{
+		index = d->firstFree;
+		d->firstFree = d->items[index].nextFree;
+		d->items[index].nextFree = -1;
+	}
+	else
+	{
+		index = d->items.count();
+		d->items.resize(index + 1);
+	}
 
-	Private::Item *i = new Private::Item;
-	i->sock = sock;
-	i->cid = UuidUtil::createUuid();
-	d->itemsBySock[i->sock] = i;
-	d->itemsByCid[i->cid] = i;
+	Private::Item &i = d->items[index];
+	i.sock = sock;
+	i.cid = d->makeCid(index);
+	d->indexBySock.insert(sock, index);
 
-	return i->cid;
+	return i.cid;
 }
 
 QByteArray ConnectionManager::getConnection(WebSocket *sock) const
 {
-	Private::Item *i = d->itemsBySock.value(sock);
-	if(!i)
+	int index = d->indexBySock.value(sock, -1);
+	if(index == -1)
 		return QByteArray();
 
-	return i->cid;
+	return d->items[index].cid;
 }
 
 void ConnectionManager::removeConnection(WebSocket *sock)
 {
-	Private::Item *i = d->itemsBySock.value(sock);
-	assert(i);
-	d->itemsBySock.remove(sock);
-	d->itemsByCid.remove(i->cid);
-	delete i;
+	int index = d->indexBySock.value(sock, -1);
+	assert(index != -1);
+
+	d->indexBySock.remove(sock);
+
+	Private::Item &i = d->items[index];
+	i.sock = 0;
+	i.proxy = 0;
+	i.cid.clear();
+	++i.generation;
+	i.nextFree = d->firstFree;
+	d->firstFree = index;
 }
 
 WsProxySession *ConnectionManager::getProxyForConnection(const QByteArray &cid) const
 {
-	Private::Item *i = d->itemsByCid.value(cid);
-	if(!i)
+	int index = d->resolveCid(cid);
+	if(index == -1)
 		return 0;
 
-	return i->proxy;
+	return d->items[index].proxy;
 }
 
 void ConnectionManager::setProxyForConnection(WebSocket *sock, WsProxySession *proxy)
 {
-	Private::Item *i = d->itemsBySock.value(sock);
-	assert(i);
+	int index = d->indexBySock.value(sock, -1);
+	assert(index != -1);
 
-	i->proxy = proxy;
+	d->items[index].proxy = proxy;
 }
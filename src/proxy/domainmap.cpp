@@ -31,16 +31,30 @@
 #include <assert.h>
 #include <QStringList>
 #include <QHash>
+#include <QCache>
 #include <QTimer>
 #include <QThread>
 #include <QMutex>
 #include <QWaitCondition>
+#include <QSharedPointer>
+#include <QAtomicInteger>
 #include <QFile>
+#include <QSaveFile>
 #include <QTextStream>
+#include <QDataStream>
+#include <QCryptographicHash>
 #include <QFileSystemWatcher>
 #include "log.h"
 #include "routesfile.h"
 
+#define ENTRY_CACHE_MAX 100
+
+// routes cache file format: magic, format version, hash of the routes
+//   file content, then the line -> parsed rule table. bump the version
+//   whenever the rule serialization changes
+#define ROUTES_CACHE_MAGIC 0x50525443 // "PRTC"
+#define ROUTES_CACHE_VERSION 1
+
 static QByteArray parse_key(const QString &in)
 {
 	if(in.startsWith("base64:"))
@@ -78,6 +92,8 @@ public:
 		QByteArray sockJsPath;
 		QByteArray sockJsAsPath;
 		HttpHeaders headers;
+		int statsSample;
+		int statsConnsMax;
 		QList<Target> targets;
 
 		Rule() :
@@ -87,7 +103,9 @@ public:
 			pathRemove(0),
 			debug(false),
 			autoCrossOrigin(false),
-			session(false)
+			session(false),
+			statsSample(100),
+			statsConnsMax(-1)
 		{
 		}
 
@@ -153,18 +171,106 @@ public:
 			e.sockJsPath = sockJsPath;
 			e.sockJsAsPath = sockJsAsPath;
 			e.headers = headers;
+			e.statsSample = statsSample;
+			e.statsConnsMax = statsConnsMax;
 			e.targets = targets;
 			return e;
 		}
 	};
 
+	// compiled per-domain index over path prefixes. rules are attached
+	//   to the node matching their pathBeg, so a lookup only considers
+	//   rules along the request path's prefix chain instead of scanning
+	//   every rule in the domain
+	class PathTree
+	{
+	public:
+		void add(const QByteArray &pathBeg, int ruleIndex)
+		{
+			Node *at = &root;
+			for(int n = 0; n < pathBeg.length(); ++n)
+			{
+				char c = pathBeg[n];
+				Node *next = at->children.value(c);
+				if(!next)
+				{
+					next = new Node;
+					at->children.insert(c, next);
+				}
+
+				at = next;
+			}
+
+			at->ruleIndexes += ruleIndex;
+		}
+
+		// indexes of rules whose pathBeg is a prefix of path, in
+		//   ascending prefix length order
+		QList<int> candidates(const QByteArray &path) const
+		{
+			QList<int> out = root.ruleIndexes;
+
+			const Node *at = &root;
+			for(int n = 0; n < path.length(); ++n)
+			{
+				at = at->children.value(path[n]);
+				if(!at)
+					break;
+
+				out += at->ruleIndexes;
+			}
+
+			return out;
+		}
+
+	private:
+		class Node
+		{
+		public:
+			QHash<char, Node*> children;
+			QList<int> ruleIndexes;
+
+			~Node()
+			{
+				qDeleteAll(children);
+			}
+		};
+
+		Node root;
+	};
+
+	// immutable once published. lookups grab a reference under the
+	//   mutex (a pointer copy) and then work without any locking, so a
+	//   reload never stalls in-flight routing. the snapshot is freed
+	//   when the last reader drops its reference. trees of domains
+	//   untouched by a reload are shared with the previous snapshot
+	class Snapshot
+	{
+	public:
+		QHash< QString, QList<Rule> > map;
+		QHash< QString, QSharedPointer<PathTree> > pathTrees;
+		int maxPathBegLength; // longest pathBeg over all rules
+
+		Snapshot() :
+			maxPathBegLength(0)
+		{
+		}
+	};
+
 	QMutex m;
 	QString fileName;
-	QHash< QString, QList<Rule> > map;
+	QString cacheFileName; // empty = caching disabled
+	QSharedPointer<Snapshot> snapshot; // guarded by m, for swap/copy only
+	bool snapshotModified; // guarded by m. true if changed outside reload
+	QAtomicInteger<quint64> lookupCount;
+	QAtomicInteger<quint64> candidateCount;
+	QHash<QString, Rule> ruleCache; // worker thread only. k=line text
+	QHash<QString, QStringList> lastLinesByDomain; // worker thread only
 	QTimer t;
 	QFileSystemWatcher watcher;
 
 	Worker() :
+		snapshotModified(false),
 		t(this),
 		watcher(this)
 	{
@@ -172,6 +278,12 @@ public:
 		t.setSingleShot(true);
 	}
 
+	QSharedPointer<Snapshot> currentSnapshot()
+	{
+		QMutexLocker locker(&m);
+		return snapshot;
+	}
+
 	void reload()
 	{
 		QFile file(fileName);
@@ -181,27 +293,75 @@ public:
 			return;
 		}
 
+		// read the file up front so it can be hashed for the cache key.
+		//   routes files are small relative to their parse cost
+		QByteArray fileData = file.readAll();
+		QByteArray fileHash = QCryptographicHash::hash(fileData, QCryptographicHash::Sha1);
+
+		// on the initial load, a cache file matching the content hash
+		//   pre-populates the line cache, so the loop below parses
+		//   nothing. later reloads already have the previous load's
+		//   lines in memory
+		if(!cacheFileName.isEmpty() && ruleCache.isEmpty())
+			loadRuleCache(fileHash);
+
+		m.lock();
+		QSharedPointer<Snapshot> prev = snapshot;
+		bool canReuse = !snapshotModified;
+		m.unlock();
+
 		QHash< QString, QList<Rule> > newmap;
+		QHash<QString, Rule> newRuleCache;
+		QHash<QString, QStringList> linesByDomain;
+		int linesParsed = 0;
+		int maxPathBeg = 0;
 
-		QTextStream ts(&file);
+		QTextStream ts(&fileData, QIODevice::ReadOnly);
 		for(int lineNum = 1; !ts.atEnd(); ++lineNum)
 		{
 			QString line = ts.readLine();
 
 			Rule r;
-			if(!parseRouteLine(line, fileName, lineNum, &r))
+
+			// reuse the parse from the previous load if the line text
+			//   is unchanged, so reload cost tracks the size of the
+			//   edit rather than the size of the file
+			QHash<QString, Rule>::const_iterator cit = ruleCache.constFind(line);
+			if(cit != ruleCache.constEnd())
 			{
-				// parseRouteLine will have logged a message if needed
-				continue;
+				r = cit.value();
+			}
+			else
+			{
+				if(!parseRouteLine(line, fileName, lineNum, &r))
+				{
+					// parseRouteLine will have logged a message if needed
+					continue;
+				}
+
+				++linesParsed;
 			}
 
+			newRuleCache.insert(line, r);
+			linesByDomain[r.domain] += line;
+
 			if(!addRuleToMap(&newmap, r))
 			{
 				log_warning("%s:%d skipping duplicate condition", qPrintable(fileName), lineNum);
 				continue;
 			}
+
+			maxPathBeg = qMax(maxPathBeg, r.pathBeg.length());
 		}
 
+		// drop cache entries for lines no longer present
+		ruleCache = newRuleCache;
+
+		// refresh the cache file whenever any line was actually parsed.
+		//   a fully cache-served load leaves the file as is
+		if(!cacheFileName.isEmpty() && linesParsed > 0)
+			saveRuleCache(fileHash);
+
 		log_debug("routes map:");
 		QHashIterator< QString, QList<Rule> > it(newmap);
 		while(it.hasNext())
@@ -230,26 +390,79 @@ public:
 			}
 		}
 
-		// atomically replace the map
+		QSharedPointer<Snapshot> newSnapshot(new Snapshot);
+		newSnapshot->map = newmap;
+		newSnapshot->maxPathBegLength = maxPathBeg;
+
+		// rebuild trees only for domains whose lines changed. untouched
+		//   domains share the previous snapshot's tree
+		int treesBuilt = 0;
+		QHashIterator< QString, QList<Rule> > mit(newmap);
+		while(mit.hasNext())
+		{
+			mit.next();
+			const QString &domain = mit.key();
+
+			QSharedPointer<PathTree> tree;
+			if(canReuse && prev && lastLinesByDomain.value(domain) == linesByDomain.value(domain))
+				tree = prev->pathTrees.value(domain);
+
+			if(!tree)
+			{
+				tree = QSharedPointer<PathTree>(new PathTree);
+
+				const QList<Rule> &rules = mit.value();
+				for(int n = 0; n < rules.count(); ++n)
+					tree->add(rules[n].pathBeg, n);
+
+				++treesBuilt;
+			}
+
+			newSnapshot->pathTrees.insert(domain, tree);
+		}
+
+		lastLinesByDomain = linesByDomain;
+
+		// atomically replace the snapshot
 		m.lock();
-		map = newmap;
+		snapshot = newSnapshot;
+		snapshotModified = false;
 		m.unlock();
 
-		log_info("routes map loaded with %d entries", newmap.count());
+		log_info("routes map loaded with %d entries (%d lines parsed, %d trees built)", newmap.count(), linesParsed, treesBuilt);
 
 		QMetaObject::invokeMethod(this, "changed", Qt::QueuedConnection);
 	}
 
-	// mutex must be locked when calling this method
 	bool addRouteLine(const QString &line)
 	{
 		Rule r;
 		if(!parseRouteLine(line, "<route>", 1, &r))
 			return false;
 
-		if(!addRuleToMap(&map, r))
+		// copy-on-write: build a new snapshot rather than mutating the
+		//   current one, which readers may be using
+		QSharedPointer<Snapshot> cur = currentSnapshot();
+
+		QHash< QString, QList<Rule> > newmap;
+		if(cur)
+			newmap = cur->map;
+
+		if(!addRuleToMap(&newmap, r))
 			return false;
 
+		QSharedPointer<Snapshot> newSnapshot(new Snapshot);
+		newSnapshot->map = newmap;
+		newSnapshot->pathTrees = buildPathTrees(newmap);
+		newSnapshot->maxPathBegLength = qMax((cur ? cur->maxPathBegLength : 0), r.pathBeg.length());
+
+		// the next file reload can't assume its line cache describes
+		//   this snapshot, so mark it modified
+		m.lock();
+		snapshot = newSnapshot;
+		snapshotModified = true;
+		m.unlock();
+
 		return true;
 	}
 
@@ -297,6 +510,242 @@ public slots:
 	}
 
 private:
+	static void writeTarget(QDataStream &s, const Target &t)
+	{
+		s << (qint32)t.type;
+		s << t.connectHost;
+		s << (qint32)t.connectPort;
+		s << t.zhttpRoute.baseSpec;
+		s << t.zhttpRoute.req;
+		s << (qint32)t.zhttpRoute.ipcFileMode;
+		s << t.ssl;
+		s << t.trusted;
+		s << t.trustConnectHost;
+		s << t.insecure;
+		s << t.host;
+		s << t.subscriptions;
+		s << t.overHttp;
+		s << (qint32)t.weight;
+		s << (qint32)t.preconnect;
+		s << (qint32)t.testDelay;
+		s << (qint32)t.testDelayJitter;
+		s << (qint32)t.testBodySize;
+		s << (qint32)t.testGripRate;
+		s << (qint32)t.testWsEcho;
+	}
+
+	static void readTarget(QDataStream &s, Target *t)
+	{
+		qint32 x;
+		s >> x;
+		t->type = (Target::Type)x;
+		s >> t->connectHost;
+		s >> x;
+		t->connectPort = x;
+		s >> t->zhttpRoute.baseSpec;
+		s >> t->zhttpRoute.req;
+		s >> x;
+		t->zhttpRoute.ipcFileMode = x;
+		s >> t->ssl;
+		s >> t->trusted;
+		s >> t->trustConnectHost;
+		s >> t->insecure;
+		s >> t->host;
+		s >> t->subscriptions;
+		s >> t->overHttp;
+		s >> x;
+		t->weight = x;
+		s >> x;
+		t->preconnect = x;
+		s >> x;
+		t->testDelay = x;
+		s >> x;
+		t->testDelayJitter = x;
+		s >> x;
+		t->testBodySize = x;
+		s >> x;
+		t->testGripRate = x;
+		s >> x;
+		t->testWsEcho = x;
+	}
+
+	static void writeRule(QDataStream &s, const Rule &r)
+	{
+		s << r.domain;
+		s << (qint32)r.proto;
+		s << r.pathBeg;
+		s << (qint32)r.ssl;
+		s << r.id;
+		s << r.sigIss;
+		s << r.sigKey;
+		s << r.prefix;
+		s << r.origHeaders;
+		s << r.asHost;
+		s << (qint32)r.pathRemove;
+		s << r.pathPrepend;
+		s << r.debug;
+		s << r.autoCrossOrigin;
+		s << (qint32)r.jsonpConfig.mode;
+		s << r.jsonpConfig.callbackParam;
+		s << r.jsonpConfig.bodyParam;
+		s << r.jsonpConfig.defaultCallback;
+		s << r.jsonpConfig.defaultMethod;
+		s << r.session;
+		s << r.sockJsPath;
+		s << r.sockJsAsPath;
+
+		s << (quint32)r.headers.count();
+		foreach(const HttpHeader &h, r.headers)
+		{
+			s << h.first;
+			s << h.second;
+		}
+
+		s << (qint32)r.statsSample;
+		s << (qint32)r.statsConnsMax;
+
+		s << (quint32)r.targets.count();
+		foreach(const Target &t, r.targets)
+			writeTarget(s, t);
+	}
+
+	static bool readRule(QDataStream &s, Rule *r)
+	{
+		qint32 x;
+		s >> r->domain;
+		s >> x;
+		r->proto = x;
+		s >> r->pathBeg;
+		s >> x;
+		r->ssl = x;
+		s >> r->id;
+		s >> r->sigIss;
+		s >> r->sigKey;
+		s >> r->prefix;
+		s >> r->origHeaders;
+		s >> r->asHost;
+		s >> x;
+		r->pathRemove = x;
+		s >> r->pathPrepend;
+		s >> r->debug;
+		s >> r->autoCrossOrigin;
+		s >> x;
+		r->jsonpConfig.mode = (JsonpConfig::Mode)x;
+		s >> r->jsonpConfig.callbackParam;
+		s >> r->jsonpConfig.bodyParam;
+		s >> r->jsonpConfig.defaultCallback;
+		s >> r->jsonpConfig.defaultMethod;
+		s >> r->session;
+		s >> r->sockJsPath;
+		s >> r->sockJsAsPath;
+
+		quint32 count;
+		s >> count;
+		for(quint32 n = 0; n < count && s.status() == QDataStream::Ok; ++n)
+		{
+			QByteArray name, value;
+			s >> name;
+			s >> value;
+			r->headers += HttpHeader(name, value);
+		}
+
+		s >> x;
+		r->statsSample = x;
+		s >> x;
+		r->statsConnsMax = x;
+
+		s >> count;
+		for(quint32 n = 0; n < count && s.status() == QDataStream::Ok; ++n)
+		{
+			Target t;
+			readTarget(s, &t);
+			r->targets += t;
+		}
+
+		return (s.status() == QDataStream::Ok);
+	}
+
+	bool loadRuleCache(const QByteArray &fileHash)
+	{
+		QFile f(cacheFileName);
+		if(!f.open(QFile::ReadOnly))
+			return false;
+
+		QDataStream s(&f);
+		s.setVersion(QDataStream::Qt_5_0);
+
+		quint32 magic = 0, version = 0;
+		s >> magic >> version;
+		if(s.status() != QDataStream::Ok || magic != ROUTES_CACHE_MAGIC || version != ROUTES_CACHE_VERSION)
+		{
+			log_info("routes cache incompatible, ignoring: %s", qPrintable(cacheFileName));
+			return false;
+		}
+
+		QByteArray cachedHash;
+		s >> cachedHash;
+		if(cachedHash != fileHash)
+		{
+			log_info("routes file changed since cache was written, ignoring: %s", qPrintable(cacheFileName));
+			return false;
+		}
+
+		quint32 count = 0;
+		s >> count;
+
+		QHash<QString, Rule> cache;
+		for(quint32 n = 0; n < count; ++n)
+		{
+			QString line;
+			s >> line;
+
+			Rule r;
+			if(!readRule(s, &r))
+			{
+				log_warning("routes cache truncated or corrupt, ignoring: %s", qPrintable(cacheFileName));
+				return false;
+			}
+
+			cache.insert(line, r);
+		}
+
+		ruleCache = cache;
+
+		log_info("routes cache loaded with %d lines: %s", cache.count(), qPrintable(cacheFileName));
+		return true;
+	}
+
+	void saveRuleCache(const QByteArray &fileHash)
+	{
+		QSaveFile f(cacheFileName);
+		if(!f.open(QIODevice::WriteOnly))
+		{
+			log_warning("unable to write routes cache file: %s", qPrintable(cacheFileName));
+			return;
+		}
+
+		QDataStream s(&f);
+		s.setVersion(QDataStream::Qt_5_0);
+
+		s << (quint32)ROUTES_CACHE_MAGIC;
+		s << (quint32)ROUTES_CACHE_VERSION;
+		s << fileHash;
+
+		s << (quint32)ruleCache.count();
+		QHashIterator<QString, Rule> it(ruleCache);
+		while(it.hasNext())
+		{
+			it.next();
+			s << it.key();
+			writeRule(s, it.value());
+		}
+
+		if(f.commit())
+			log_debug("routes cache written: %s", qPrintable(cacheFileName));
+		else
+			log_warning("unable to write routes cache file: %s", qPrintable(cacheFileName));
+	}
+
 	static bool parseRouteLine(const QString &line, const QString &fileName, int lineNum, Rule *rule)
 	{
 		bool ok;
@@ -458,6 +907,32 @@ private:
 		if(props.contains("sockjs_as_path"))
 			r.sockJsAsPath = props.value("sockjs_as_path").toUtf8();
 
+		if(props.contains("stats_sample"))
+		{
+			bool ok_;
+			int x = props.value("stats_sample").toInt(&ok_);
+			if(!ok_ || x < 0 || x > 100)
+			{
+				log_warning("%s:%d: stats_sample must be a percentage from 0 to 100", qPrintable(fileName), lineNum);
+				return false;
+			}
+
+			r.statsSample = x;
+		}
+
+		if(props.contains("stats_conns_max"))
+		{
+			bool ok_;
+			int x = props.value("stats_conns_max").toInt(&ok_);
+			if(!ok_ || x < 0)
+			{
+				log_warning("%s:%d: stats_conns_max must be a non-negative integer", qPrintable(fileName), lineNum);
+				return false;
+			}
+
+			r.statsConnsMax = x;
+		}
+
 		if(props.contains("header"))
 		{
 			foreach(const QString &s, props.values("header"))
@@ -564,6 +1039,32 @@ private:
 			if(props.contains("over_http"))
 				target.overHttp = true;
 
+			if(props.contains("preconnect"))
+			{
+				int x = props.value("preconnect").toInt();
+				if(x < 1)
+				{
+					log_warning("%s:%d: preconnect must be a positive integer", qPrintable(fileName), lineNum);
+					ok = false;
+					break;
+				}
+
+				target.preconnect = x;
+			}
+
+			if(props.contains("weight"))
+			{
+				int x = props.value("weight").toInt();
+				if(x < 1)
+				{
+					log_warning("%s:%d: weight must be a positive integer", qPrintable(fileName), lineNum);
+					ok = false;
+					break;
+				}
+
+				target.weight = x;
+			}
+
 			if(props.contains("ipc_file_mode"))
 			{
 				bool ok_;
@@ -572,6 +1073,71 @@ private:
 					target.zhttpRoute.ipcFileMode = x;
 			}
 
+			if(props.contains("test_delay"))
+			{
+				int x = props.value("test_delay").toInt();
+				if(x < 0)
+				{
+					log_warning("%s:%d: test_delay must be a non-negative integer", qPrintable(fileName), lineNum);
+					ok = false;
+					break;
+				}
+
+				target.testDelay = x;
+			}
+
+			if(props.contains("test_delay_jitter"))
+			{
+				int x = props.value("test_delay_jitter").toInt();
+				if(x < 0)
+				{
+					log_warning("%s:%d: test_delay_jitter must be a non-negative integer", qPrintable(fileName), lineNum);
+					ok = false;
+					break;
+				}
+
+				target.testDelayJitter = x;
+			}
+
+			if(props.contains("test_body_size"))
+			{
+				int x = props.value("test_body_size").toInt();
+				if(x < 0)
+				{
+					log_warning("%s:%d: test_body_size must be a non-negative integer", qPrintable(fileName), lineNum);
+					ok = false;
+					break;
+				}
+
+				target.testBodySize = x;
+			}
+
+			if(props.contains("test_grip_rate"))
+			{
+				int x = props.value("test_grip_rate").toInt();
+				if(x < 0 || x > 100)
+				{
+					log_warning("%s:%d: test_grip_rate must be between 0 and 100", qPrintable(fileName), lineNum);
+					ok = false;
+					break;
+				}
+
+				target.testGripRate = x;
+			}
+
+			if(props.contains("test_ws_echo"))
+			{
+				int x = props.value("test_ws_echo").toInt();
+				if(x < 0 || x > 100)
+				{
+					log_warning("%s:%d: test_ws_echo must be between 0 and 100", qPrintable(fileName), lineNum);
+					ok = false;
+					break;
+				}
+
+				target.testWsEcho = x;
+			}
+
 			r.targets += target;
 		}
 
@@ -582,6 +1148,27 @@ private:
 		return true;
 	}
 
+	static QHash< QString, QSharedPointer<PathTree> > buildPathTrees(const QHash< QString, QList<Rule> > &m)
+	{
+		QHash< QString, QSharedPointer<PathTree> > out;
+
+		QHashIterator< QString, QList<Rule> > it(m);
+		while(it.hasNext())
+		{
+			it.next();
+
+			QSharedPointer<PathTree> tree(new PathTree);
+
+			const QList<Rule> &rules = it.value();
+			for(int n = 0; n < rules.count(); ++n)
+				tree->add(rules[n].pathBeg, n);
+
+			out.insert(it.key(), tree);
+		}
+
+		return out;
+	}
+
 	static bool addRuleToMap(QHash< QString,QList<Rule> > *m, const Rule &r)
 	{
 		QList<Rule> *rules = 0;
@@ -619,6 +1206,7 @@ class DomainMap::Thread : public QThread
 
 public:
 	QString fileName;
+	QString cacheFileName;
 	Worker *worker;
 	QMutex m;
 	QWaitCondition w;
@@ -640,6 +1228,7 @@ public:
 	{
 		worker = new Worker;
 		worker->fileName = fileName;
+		worker->cacheFileName = cacheFileName;
 		connect(worker, &Worker::started, this, &Thread::worker_started, Qt::DirectConnection);
 		QMetaObject::invokeMethod(worker, "start", Qt::QueuedConnection);
 		exec();
@@ -662,10 +1251,18 @@ public:
 	DomainMap *q;
 	Thread *thread;
 
+	// resolved entries keyed by (proto, ssl, domain, significant path
+	//   prefix), so the handful of hot routes resolve with one hash
+	//   probe. accessed from the caller's thread only, and flushed
+	//   whenever a different snapshot is observed
+	QCache<QByteArray, Entry> entryCache;
+	QSharedPointer<Worker::Snapshot> cachedSnapshot;
+
 	Private(DomainMap *_q) :
 		QObject(_q),
 		q(_q),
-		thread(0)
+		thread(0),
+		entryCache(ENTRY_CACHE_MAX)
 	{
 	}
 
@@ -674,10 +1271,11 @@ public:
 		delete thread;
 	}
 
-	void start(const QString &fileName = QString())
+	void start(const QString &fileName = QString(), const QString &cacheFileName = QString())
 	{
 		thread = new Thread;
 		thread->fileName = fileName;
+		thread->cacheFileName = cacheFileName;
 		thread->start();
 
 		// worker guaranteed to exist after starting
@@ -705,6 +1303,13 @@ DomainMap::DomainMap(const QString &fileName, QObject *parent) :
 	d->start(fileName);
 }
 
+DomainMap::DomainMap(const QString &fileName, const QString &cacheFileName, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+	d->start(fileName, cacheFileName);
+}
+
 DomainMap::~DomainMap()
 {
 	delete d;
@@ -717,41 +1322,91 @@ void DomainMap::reload()
 
 DomainMap::Entry DomainMap::entry(Protocol proto, bool ssl, const QString &domain, const QByteArray &path) const
 {
-	QMutexLocker locker(&d->thread->worker->m);
-
-	const QList<Worker::Rule> *rules;
-	QString empty("");
-	if(d->thread->worker->map.contains(domain))
-		rules = &d->thread->worker->map[domain];
-	else if(d->thread->worker->map.contains(empty))
-		rules = &d->thread->worker->map[empty];
-	else
+	Worker *w = d->thread->worker;
+
+	QSharedPointer<Worker::Snapshot> snap = w->currentSnapshot();
+	if(!snap)
 		return Entry();
 
-	const Worker::Rule *best = 0;
-	foreach(const Worker::Rule &r, *rules)
+	if(snap != d->cachedSnapshot)
 	{
-		if((!best && r.isMatch(proto, ssl, path)) || (best && r.isMoreSpecificMatch(*best, proto, ssl, path)))
+		d->entryCache.clear();
+		d->cachedSnapshot = snap;
+	}
+
+	// only the first maxPathBegLength bytes of the path can influence
+	//   matching, so truncating the key there lets requests differing
+	//   in the tail share a cache slot
+	QByteArray keyPath = (path.length() > snap->maxPathBegLength ? path.mid(0, snap->maxPathBegLength) : path);
+
+	QByteArray cacheKey;
+	cacheKey.reserve(keyPath.length() + domain.length() + 3);
+	cacheKey += (proto == Http ? 'h' : 'w');
+	cacheKey += (ssl ? 's' : 'p');
+	cacheKey += domain.toUtf8();
+	cacheKey += '\n';
+	cacheKey += keyPath;
+
+	Entry *cached = d->entryCache.object(cacheKey);
+	if(cached)
+	{
+		// entry members are implicitly shared, so this copy doesn't
+		//   duplicate the target list
+		return *cached;
+	}
+
+	Entry e;
+
+	QHash< QString, QList<Worker::Rule> >::const_iterator it = snap->map.constFind(domain);
+	if(it == snap->map.constEnd())
+		it = snap->map.constFind(QString(""));
+	if(it != snap->map.constEnd())
+	{
+		const QList<Worker::Rule> &rules = it.value();
+
+		QSharedPointer<Worker::PathTree> tree = snap->pathTrees.value(it.key());
+		assert(tree);
+
+		QList<int> indexes = tree->candidates(path);
+
+		w->lookupCount.fetchAndAddRelaxed(1);
+		w->candidateCount.fetchAndAddRelaxed(indexes.count());
+
+		const Worker::Rule *best = 0;
+		foreach(int n, indexes)
 		{
-			best = &r;
+			const Worker::Rule &r = rules.at(n);
+
+			if((!best && r.isMatch(proto, ssl, path)) || (best && r.isMoreSpecificMatch(*best, proto, ssl, path)))
+			{
+				best = &r;
+			}
 		}
-	}
 
-	if(!best)
-		return Entry();
+		if(best)
+		{
+			assert(!best->targets.isEmpty());
 
-	assert(!best->targets.isEmpty());
+			e = best->toEntry();
+		}
+	}
+
+	// non-matches are cached too. unroutable requests repeat just as
+	//   much as routable ones
+	d->entryCache.insert(cacheKey, new Entry(e));
 
-	return best->toEntry();
+	return e;
 }
 
 QList<DomainMap::ZhttpRoute> DomainMap::zhttpRoutes() const
 {
-	QMutexLocker locker(&d->thread->worker->m);
-
 	QList<ZhttpRoute> out;
 
-	QHashIterator< QString, QList<Worker::Rule> > it(d->thread->worker->map);
+	QSharedPointer<Worker::Snapshot> snap = d->thread->worker->currentSnapshot();
+	if(!snap)
+		return out;
+
+	QHashIterator< QString, QList<Worker::Rule> > it(snap->map);
 	while(it.hasNext())
 	{
 		it.next();
@@ -769,10 +1424,60 @@ QList<DomainMap::ZhttpRoute> DomainMap::zhttpRoutes() const
 	return out;
 }
 
+QList<DomainMap::Target> DomainMap::preconnectTargets() const
+{
+	QList<Target> out;
+	QHash<QString, int> indexByKey;
+
+	QSharedPointer<Worker::Snapshot> snap = d->thread->worker->currentSnapshot();
+	if(!snap)
+		return out;
+
+	QHashIterator< QString, QList<Worker::Rule> > it(snap->map);
+	while(it.hasNext())
+	{
+		it.next();
+		foreach(const Worker::Rule &r, it.value())
+		{
+			foreach(const Target &t, r.targets)
+			{
+				if(t.preconnect < 1)
+					continue;
+
+				QString key;
+				if(t.type == Target::Custom)
+					key = t.zhttpRoute.baseSpec;
+				else
+					key = t.connectHost + ';' + QString::number(t.connectPort) + ';' + (t.ssl ? 's' : 'p');
+
+				int at = indexByKey.value(key, -1);
+				if(at != -1)
+				{
+					// same target on multiple routes: warm the max
+					out[at].preconnect = qMax(out[at].preconnect, t.preconnect);
+					continue;
+				}
+
+				indexByKey[key] = out.count();
+				out += t;
+			}
+		}
+	}
+
+	return out;
+}
+
 bool DomainMap::addRouteLine(const QString &line)
 {
-	QMutexLocker locker(&d->thread->worker->m);
 	return d->thread->worker->addRouteLine(line);
 }
 
+void DomainMap::matchStats(quint64 *lookups, quint64 *candidates) const
+{
+	if(lookups)
+		*lookups = d->thread->worker->lookupCount.load();
+	if(candidates)
+		*candidates = d->thread->worker->candidateCount.load();
+}
+
 #include "domainmap.moc"
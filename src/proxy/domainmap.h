@@ -116,6 +116,15 @@ public:
 		QString host; // override input host
 		QStringList subscriptions; // implicit subscriptions
 		bool overHttp; // use websocket-over-http protocol
+		int weight; // relative share of traffic vs sibling targets
+		int preconnect; // origin connections to pre-establish
+
+		// synthetic origin tuning. only used by the test target
+		int testDelay; // msec before responding
+		int testDelayJitter; // extra uniform random msec added to testDelay
+		int testBodySize; // response body size in bytes, -1=canned text
+		int testGripRate; // percent of hold requests that get grip headers
+		int testWsEcho; // percent of websocket messages echoed back
 
 		Target() :
 			type(Default),
@@ -124,7 +133,14 @@ public:
 			trusted(false),
 			trustConnectHost(false),
 			insecure(false),
-			overHttp(false)
+			overHttp(false),
+			weight(1),
+			preconnect(0),
+			testDelay(0),
+			testDelayJitter(0),
+			testBodySize(-1),
+			testGripRate(100),
+			testWsEcho(100)
 		{
 		}
 	};
@@ -148,6 +164,8 @@ public:
 		QByteArray sockJsPath;
 		QByteArray sockJsAsPath;
 		HttpHeaders headers;
+		int statsSample; // percent of connections tracked individually
+		int statsConnsMax; // -1=unlimited
 		QList<Target> targets;
 
 		bool isNull() const
@@ -160,13 +178,21 @@ public:
 			pathRemove(0),
 			debug(false),
 			autoCrossOrigin(false),
-			session(false)
+			session(false),
+			statsSample(100),
+			statsConnsMax(-1)
 		{
 		}
 	};
 
 	DomainMap(QObject *parent = 0);
 	DomainMap(const QString &fileName, QObject *parent = 0);
+
+	// cacheFileName is a binary snapshot of the parsed routes, keyed by
+	//   a hash of the file content, so a restart with an unchanged file
+	//   skips parsing. it is written after any load that parsed lines
+	DomainMap(const QString &fileName, const QString &cacheFileName, QObject *parent = 0);
+
 	~DomainMap();
 
 	// shouldn't really ever need to call this, but it's here in case the
@@ -177,8 +203,15 @@ public:
 
 	QList<ZhttpRoute> zhttpRoutes() const;
 
+	// targets with a preconnect count, deduplicated across routes
+	QList<Target> preconnectTargets() const;
+
 	bool addRouteLine(const QString &line);
 
+	// cumulative entry() calls and rule candidates considered, for
+	//   verifying the effectiveness of the path index
+	void matchStats(quint64 *lookups, quint64 *candidates) const;
+
 signals:
 	void changed();
 
@@ -29,6 +29,7 @@
 #include "engine.h"
 
 #include <assert.h>
+#include <QTimer>
 #include "qzmqsocket.h"
 #include "qzmqvalve.h"
 #include "tnetstring.h"
@@ -46,12 +47,16 @@
 #include "zrpcmanager.h"
 #include "zrpcrequest.h"
 #include "zrpcchecker.h"
+#include "inspectcache.h"
+#include "preflightcache.h"
 #include "wscontrolmanager.h"
 #include "requestsession.h"
 #include "proxysession.h"
 #include "wsproxysession.h"
 #include "statsmanager.h"
+#include "proxyutil.h"
 #include "connectionmanager.h"
+#include "targettracker.h"
 #include "zutil.h"
 #include "sockjsmanager.h"
 #include "sockjssession.h"
@@ -60,6 +65,11 @@
 
 #define DEFAULT_HWM 1000
 
+// retry entries executed per event-loop pass. each entry restores a
+//   session and starts proxying, so mass retries are spread out
+//   instead of handled in one long iteration
+#define RETRY_DRAIN_MAX 50
+
 class Engine::Private : public QObject
 {
 	Q_OBJECT
@@ -100,17 +110,23 @@ public:
 	WsControlManager *wsControl;
 	DomainMap *domainMap;
 	ZrpcChecker *inspectChecker;
+	InspectCache inspectCache;
+	PreflightCache preflightCache;
 	StatsManager *stats;
 	ZrpcManager *command;
 	ZrpcManager *accept;
 	QZmq::Socket *handler_retry_in_sock;
 	QZmq::Valve *handler_retry_in_valve;
+	QList<RetryRequestPacket::LazyReader> retryPending;
+	QTimer *retryDrainTimer;
 	QSet<RequestSession*> requestSessions;
 	QHash<QByteArray, ProxyItem*> proxyItemsByKey;
 	QHash<ProxySession*, ProxyItem*> proxyItemsBySession;
 	QHash<WsProxySession*, WsProxyItem*> wsProxyItemsBySession;
 	SockJsManager *sockJsManager;
 	ConnectionManager connectionManager;
+	TargetTracker targetTracker;
+	QHash<ZhttpRequest*, ZhttpManager*> warmupRequests;
 	Updater *updater;
 	LogUtil::Config logConfig;
 
@@ -130,6 +146,7 @@ public:
 		accept(0),
 		handler_retry_in_sock(0),
 		handler_retry_in_valve(0),
+		retryDrainTimer(0),
 		sockJsManager(0),
 		updater(0)
 	{
@@ -168,6 +185,16 @@ public:
 			delete rs;
 		requestSessions.clear();
 
+		QHashIterator<ZhttpRequest*, ZhttpManager*> writ(warmupRequests);
+		while(writ.hasNext())
+		{
+			writ.next();
+			delete writ.key();
+			zroutes->removeRef(writ.value());
+		}
+
+		warmupRequests.clear();
+
 		WebSocketOverHttp::clearDisconnectManager();
 
 		// need to make sure this is deleted before inspect manager
@@ -182,6 +209,8 @@ public:
 		logConfig.fromAddress = config.logFrom;
 		logConfig.userAgent = config.logUserAgent;
 
+		WebSocketOverHttp::setEventBatchParams(config.wsOverHttpMaxBatchEvents, config.wsOverHttpMaxBatchBytes, config.wsOverHttpBatchDelay);
+
 		if(!config.routeLines.isEmpty())
 		{
 			domainMap = new DomainMap(this);
@@ -189,7 +218,7 @@ public:
 				domainMap->addRouteLine(line);
 		}
 		else
-			domainMap = new DomainMap(config.routesFile, this);
+			domainMap = new DomainMap(config.routesFile, config.routesCacheFile, this);
 
 		connect(domainMap, &DomainMap::changed, this, &Private::domainMap_changed);
 
@@ -270,6 +299,10 @@ public:
 
 			handler_retry_in_valve = new QZmq::Valve(handler_retry_in_sock, this);
 			connect(handler_retry_in_valve, &QZmq::Valve::readyRead, this, &Private::handler_retry_in_readyRead);
+
+			retryDrainTimer = new QTimer(this);
+			retryDrainTimer->setSingleShot(true);
+			connect(retryDrainTimer, &QTimer::timeout, this, &Private::retryDrain_timeout);
 		}
 
 		if(handler_retry_in_valve)
@@ -347,6 +380,21 @@ public:
 		// we'll always have a route
 		assert(!route.isNull());
 
+		// repeated CORS preflights can be answered from cache without
+		//   creating a proxysession or contacting the origin
+		QByteArray preflightKey = PreflightCache::requestKey(route.id, rs->requestData());
+		if(!preflightKey.isEmpty())
+		{
+			HttpResponseData resp;
+			if(preflightCache.get(preflightKey, &resp))
+			{
+				log_debug("answering preflight from cache for id=%s", rs->rid().second.data());
+
+				rs->respond(resp.code, resp.reason, resp.headers, resp.body);
+				return;
+			}
+		}
+
 		bool sharable = (idata && !idata->sharingKey.isEmpty() && rs->haveCompleteRequestBody());
 
 		ProxySession *ps = 0;
@@ -363,7 +411,7 @@ public:
 		{
 			log_debug("creating proxysession for id=%s", rs->rid().second.data());
 
-			ps = new ProxySession(zroutes, accept, logConfig, this);
+			ps = new ProxySession(zroutes, accept, &targetTracker, logConfig, this);
 			connect(ps, &ProxySession::addNotAllowed, this, &Private::ps_addNotAllowed);
 			connect(ps, &ProxySession::finished, this, &Private::ps_finished);
 			connect(ps, &ProxySession::requestSessionDestroyed, this, &Private::ps_requestSessionDestroyed);
@@ -375,6 +423,7 @@ public:
 			ps->setXffRules(config.xffUntrustedRule, config.xffTrustedRule);
 			ps->setOrigHeadersNeedMark(config.origHeadersNeedMark);
 			ps->setProxyInitialResponseEnabled(true);
+			ps->setPreflightCache(&preflightCache);
 
 			if(idata)
 				ps->setInspectData(*idata);
@@ -425,7 +474,11 @@ public:
 
 		if(stats)
 		{
-			stats->addConnection(cid, ps->routeId(), StatsManager::WebSocket, ps->logicalClientAddress(), sock->requestUri().scheme() == "wss", false);
+			// routes can opt out of tracking every connection. untracked
+			//   connections still count toward route activity
+			if(ProxyUtil::shouldTrackConnection(stats, route))
+				stats->addConnection(cid, ps->routeId(), StatsManager::WebSocket, ps->logicalClientAddress(), sock->requestUri().scheme() == "wss", false);
+
 			stats->addActivity(ps->routeId());
 		}
 	}
@@ -495,7 +548,7 @@ public:
 		RequestSession *rs;
 		if(lookupRoute)
 		{
-			rs = new RequestSession(domainMap, sockJsManager, inspect, inspectChecker, accept, stats, this);
+			rs = new RequestSession(domainMap, sockJsManager, inspect, inspectChecker, &inspectCache, accept, stats, this);
 			rs->setDebugEnabled(config.debug);
 			rs->setAutoCrossOrigin(config.autoCrossOrigin);
 			rs->setPrefetchSize(config.inspectPrefetch);
@@ -758,68 +811,106 @@ private slots:
 			return;
 		}
 
-		bool ok;
-		QVariant data = TnetString::toVariant(message[0], 0, &ok);
-		if(!ok)
+		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
 		{
-			log_warning("retry: received message with invalid format (tnetstring parse failed), skipping");
+			bool ok;
+			QVariant data = TnetString::toVariant(message[0], 0, &ok);
+			if(ok)
+				log_debug("retry: IN %s", qPrintable(TnetString::variantToString(data, -1)));
+		}
+
+		// parse the shared fields only. the request entries are
+		//   materialized one at a time as the retries are executed, so
+		//   a mass-retry packet doesn't cost a full parse up front
+		RetryRequestPacket::LazyReader reader;
+		if(!reader.start(message[0]))
+		{
+			log_warning("retry: received message with invalid format, skipping");
 			return;
 		}
 
-		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-			log_debug("retry: IN %s", qPrintable(TnetString::variantToString(data, -1)));
+		log_debug("IN (retry) %s %s", qPrintable(reader.requestData.method), reader.requestData.uri.toEncoded().data());
 
-		RetryRequestPacket p;
-		if(!p.fromVariant(data))
+		retryPending += reader;
+
+		processRetries();
+	}
+
+	void processRetries()
+	{
+		// execute a bounded batch of entries per pass, continuing from
+		//   the drain timer, so restoring thousands of sessions doesn't
+		//   stall the event loop
+		int count = 0;
+		while(!retryPending.isEmpty() && count < RETRY_DRAIN_MAX)
 		{
-			log_warning("retry: received message with invalid format (parse failed), skipping");
-			return;
+			RetryRequestPacket::LazyReader &reader = retryPending.first();
+
+			RetryRequestPacket::Request req;
+			int result = reader.nextRequest(&req);
+			if(result <= 0)
+			{
+				if(result < 0)
+					log_warning("retry: received entry with invalid format, skipping remainder of packet");
+
+				retryPending.removeFirst();
+				continue;
+			}
+
+			startRetry(reader, req);
+			++count;
 		}
 
-		log_debug("IN (retry) %s %s", qPrintable(p.requestData.method), p.requestData.uri.toEncoded().data());
+		if(!retryPending.isEmpty())
+			retryDrainTimer->start();
+	}
 
+	void startRetry(const RetryRequestPacket::LazyReader &reader, const RetryRequestPacket::Request &req)
+	{
 		InspectData idata;
-		if(p.haveInspectInfo)
+		if(reader.haveInspectInfo)
 		{
-			idata.doProxy = p.inspectInfo.doProxy;
-			idata.sharingKey = p.inspectInfo.sharingKey;
-			idata.sid = p.inspectInfo.sid;
-			idata.lastIds = p.inspectInfo.lastIds;
-			idata.userData = p.inspectInfo.userData;
+			idata.doProxy = reader.inspectInfo.doProxy;
+			idata.sharingKey = reader.inspectInfo.sharingKey;
+			idata.sid = reader.inspectInfo.sid;
+			idata.lastIds = reader.inspectInfo.lastIds;
+			idata.userData = reader.inspectInfo.userData;
 		}
 
-		foreach(const RetryRequestPacket::Request &req, p.requests)
-		{
-			ZhttpRequest::ServerState ss;
-			ss.rid = ZhttpRequest::Rid(req.rid.first, req.rid.second);
-			ss.peerAddress = req.peerAddress;
-			ss.requestMethod = p.requestData.method;
-			ss.requestUri = p.requestData.uri;
-			if(req.https)
-				ss.requestUri.setScheme("https");
-			ss.requestHeaders = p.requestData.headers;
-			ss.requestBody = p.requestData.body;
-			ss.inSeq = req.inSeq;
-			ss.outSeq = req.outSeq;
-			ss.outCredits = req.outCredits;
-			ss.userData = req.userData;
+		ZhttpRequest::ServerState ss;
+		ss.rid = ZhttpRequest::Rid(req.rid.first, req.rid.second);
+		ss.peerAddress = req.peerAddress;
+		ss.requestMethod = reader.requestData.method;
+		ss.requestUri = reader.requestData.uri;
+		if(req.https)
+			ss.requestUri.setScheme("https");
+		ss.requestHeaders = reader.requestData.headers;
+		ss.requestBody = reader.requestData.body;
+		ss.inSeq = req.inSeq;
+		ss.outSeq = req.outSeq;
+		ss.outCredits = req.outCredits;
+		ss.userData = req.userData;
 
-			ZhttpRequest *zhttpRequest = zhttpIn->createRequestFromState(ss);
+		ZhttpRequest *zhttpRequest = zhttpIn->createRequestFromState(ss);
 
-			RequestSession *rs = new RequestSession(domainMap, sockJsManager, inspect, inspectChecker, accept, stats, this);
+		RequestSession *rs = new RequestSession(domainMap, sockJsManager, inspect, inspectChecker, &inspectCache, accept, stats, this);
 
-			requestSessions += rs;
+		requestSessions += rs;
 
-			rs->setDefaultUpstreamKey(config.upstreamKey);
-			rs->setXffRules(config.xffUntrustedRule, config.xffTrustedRule);
+		rs->setDefaultUpstreamKey(config.upstreamKey);
+		rs->setXffRules(config.xffUntrustedRule, config.xffTrustedRule);
 
-			// note: if the routing table was changed, there's a chance the request
-			//   might get a different route id this time around. this could confuse
-			//   stats processors tracking route+connection mappings.
-			rs->startRetry(zhttpRequest, req.debug, req.autoCrossOrigin, req.jsonpCallback, req.jsonpExtendedResponse);
+		// note: if the routing table was changed, there's a chance the request
+		//   might get a different route id this time around. this could confuse
+		//   stats processors tracking route+connection mappings.
+		rs->startRetry(zhttpRequest, req.debug, req.autoCrossOrigin, req.jsonpCallback, req.jsonpExtendedResponse);
 
-			doProxy(rs, p.haveInspectInfo ? &idata : 0);
-		}
+		doProxy(rs, reader.haveInspectInfo ? &idata : 0);
+	}
+
+	void retryDrain_timeout()
+	{
+		processRetries();
 	}
 
 	void command_requestReady()
@@ -875,28 +966,81 @@ private slots:
 		else if(req->method() == "refresh")
 		{
 			QVariantHash args = req->args();
-			if(!args.contains("cid") || args["cid"].type() != QVariant::ByteArray)
+
+			// accepts a single cid or a batch. sweeps refresh many
+			//   connections at once, so the batch form carries one
+			//   round-trip for the lot and responds with the cids
+			//   that were actually refreshed
+			if(args.contains("cids"))
 			{
-				req->respondError("bad-format");
-				delete req;
-				return;
-			}
+				if(args["cids"].type() != QVariant::List)
+				{
+					req->respondError("bad-format");
+					delete req;
+					return;
+				}
 
-			QByteArray cid = args["cid"].toByteArray();
+				bool ok = true;
+				QList<QByteArray> cids;
+				foreach(const QVariant &vcid, args["cids"].toList())
+				{
+					if(vcid.type() != QVariant::ByteArray)
+					{
+						ok = false;
+						break;
+					}
 
-			WsProxySession *ps = connectionManager.getProxyForConnection(cid);
-			if(!ps)
-			{
-				req->respondError("item-not-found");
-				delete req;
-				return;
+					cids += vcid.toByteArray();
+				}
+				if(!ok)
+				{
+					req->respondError("bad-format");
+					delete req;
+					return;
+				}
+
+				QVariantList out;
+				foreach(const QByteArray &cid, cids)
+				{
+					WsProxySession *ps = connectionManager.getProxyForConnection(cid);
+					if(!ps)
+						continue;
+
+					WebSocketOverHttp *woh = qobject_cast<WebSocketOverHttp*>(ps->outSocket());
+					if(woh)
+					{
+						woh->refresh();
+						out += cid;
+					}
+				}
+
+				req->respond(out);
 			}
+			else
+			{
+				if(!args.contains("cid") || args["cid"].type() != QVariant::ByteArray)
+				{
+					req->respondError("bad-format");
+					delete req;
+					return;
+				}
 
-			WebSocketOverHttp *woh = qobject_cast<WebSocketOverHttp*>(ps->outSocket());
-			if(woh)
-				woh->refresh();
+				QByteArray cid = args["cid"].toByteArray();
 
-			req->respond();
+				WsProxySession *ps = connectionManager.getProxyForConnection(cid);
+				if(!ps)
+				{
+					req->respondError("item-not-found");
+					delete req;
+					return;
+				}
+
+				WebSocketOverHttp *woh = qobject_cast<WebSocketOverHttp*>(ps->outSocket());
+				if(woh)
+					woh->refresh();
+
+				req->respond();
+			}
 		}
 		else if(req->method() == "report")
 		{
@@ -950,6 +1094,92 @@ private slots:
 	{
 		// connect to new zhttp targets, disconnect from old
 		zroutes->setup(domainMap->zhttpRoutes());
+
+		warmupTargets();
+	}
+
+	// issue throwaway requests to targets marked with preconnect, so
+	//   origin connections are established before real traffic needs
+	//   them. the requests run concurrently, which is what forces one
+	//   connection each instead of keep-alive reuse
+	void warmupTargets()
+	{
+		foreach(const DomainMap::Target &t, domainMap->preconnectTargets())
+		{
+			if(t.type == DomainMap::Target::Test)
+				continue;
+
+			for(int n = 0; n < t.preconnect; ++n)
+			{
+				ZhttpManager *zhttpManager;
+				if(t.type == DomainMap::Target::Custom)
+					zhttpManager = zroutes->managerForRoute(t.zhttpRoute);
+				else
+					zhttpManager = zroutes->defaultManager();
+
+				zroutes->addRef(zhttpManager);
+
+				ZhttpRequest *req = zhttpManager->createRequest();
+				req->setParent(this);
+				connect(req, &ZhttpRequest::readyRead, this, &Private::warmupRequest_readyRead);
+				connect(req, &ZhttpRequest::error, this, &Private::warmupRequest_error);
+				warmupRequests.insert(req, zhttpManager);
+
+				if(t.trusted)
+					req->setIgnorePolicies(true);
+
+				if(t.trustConnectHost)
+					req->setTrustConnectHost(true);
+
+				if(t.insecure)
+					req->setIgnoreTlsErrors(true);
+
+				QUrl uri;
+				uri.setScheme(t.ssl ? "https" : "http");
+				uri.setHost(!t.host.isEmpty() ? t.host : t.connectHost);
+				uri.setPath("/");
+
+				if(t.type == DomainMap::Target::Default)
+				{
+					req->setConnectHost(t.connectHost);
+					req->setConnectPort(t.connectPort);
+				}
+
+				req->start("HEAD", uri, HttpHeaders());
+				req->endBody();
+			}
+		}
+	}
+
+	void finishWarmupRequest(ZhttpRequest *req)
+	{
+		ZhttpManager *zhttpManager = warmupRequests.take(req);
+
+		req->disconnect(this);
+		req->setParent(0);
+		req->deleteLater();
+
+		zroutes->removeRef(zhttpManager);
+	}
+
+	void warmupRequest_readyRead()
+	{
+		ZhttpRequest *req = (ZhttpRequest *)sender();
+
+		// the response doesn't matter, only that the connection is up
+		req->readBody();
+
+		if(req->isFinished())
+			finishWarmupRequest(req);
+	}
+
+	void warmupRequest_error()
+	{
+		ZhttpRequest *req = (ZhttpRequest *)sender();
+
+		log_debug("warmup: request failed, condition=%d", (int)req->errorCondition());
+
+		finishWarmupRequest(req);
 	}
 };
 
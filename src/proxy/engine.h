@@ -64,6 +64,7 @@ public:
 		int inspectTimeout;
 		int inspectPrefetch;
 		QString routesFile;
+		QString routesCacheFile;
 		QStringList routeLines;
 		bool debug;
 		bool autoCrossOrigin;
@@ -83,6 +84,9 @@ public:
 		QString organizationName;
 		bool quietCheck;
 		int statsConnectionTtl;
+		int wsOverHttpMaxBatchEvents;
+		int wsOverHttpMaxBatchBytes;
+		int wsOverHttpBatchDelay;
 
 		Configuration() :
 			ipcFileMode(-1),
@@ -98,7 +102,10 @@ public:
 			logUserAgent(false),
 			updatesCheck("check"),
 			quietCheck(false),
-			statsConnectionTtl(-1)
+			statsConnectionTtl(-1),
+			wsOverHttpMaxBatchEvents(64),
+			wsOverHttpMaxBatchBytes(65536),
+			wsOverHttpBatchDelay(0)
 		{
 		}
 	};
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "inspectcache.h"
+
+#include <QDateTime>
+
+#define CACHE_TTL 10000
+#define CACHE_MAX 1000
+
+InspectCache::InspectCache() :
+	cache_(CACHE_MAX)
+{
+}
+
+bool InspectCache::get(const QByteArray &key, InspectData *idata)
+{
+	Entry *e = cache_.object(key);
+	if(!e)
+		return false;
+
+	if(QDateTime::currentMSecsSinceEpoch() >= e->expires)
+	{
+		cache_.remove(key);
+		return false;
+	}
+
+	*idata = e->idata;
+	return true;
+}
+
+void InspectCache::insert(const QByteArray &key, const InspectData &idata)
+{
+	Entry *e = new Entry;
+	e->idata = idata;
+	e->expires = QDateTime::currentMSecsSinceEpoch() + CACHE_TTL;
+	cache_.insert(key, e);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef INSPECTCACHE_H
+#define INSPECTCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include "inspectdata.h"
+
+// short-TTL cache of inspect results. for routes without session
+//   inspection, the handler's answer depends only on the route, method,
+//   uri and Grip-Last headers, so hot endpoints can skip the inspect
+//   round trip. routes with session inspection must not be cached,
+//   since their results depend on request bodies and detect rules
+class InspectCache
+{
+public:
+	InspectCache();
+
+	bool get(const QByteArray &key, InspectData *idata);
+	void insert(const QByteArray &key, const InspectData &idata);
+
+private:
+	class Entry
+	{
+	public:
+		InspectData idata;
+		qint64 expires;
+	};
+
+	QCache<QByteArray, Entry> cache_;
+};
+
+#endif
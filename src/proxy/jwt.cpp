@@ -31,8 +31,17 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMessageAuthenticationCode>
+#include <QCache>
+#include <QDateTime>
 #include "log.h"
 
+#define DECODE_CACHE_MAX 1000
+
+// how long to remember that a token failed to verify. a token's
+//   validity against a given key never changes, so the ttl only bounds
+//   how long bad tokens can occupy cache slots
+#define DECODE_NEGATIVE_TTL 60000
+
 static QByteArray base64url(const QByteArray &in)
 {
 	QByteArray b64 = in.toBase64();
@@ -134,6 +143,11 @@ QVariant decode(const QByteArray &token, const QByteArray &key)
 	if(header.value("typ").toString() != "JWT" || header.value("alg").toString() != "HS256")
 		return QVariant();
 
+	// verify before parsing the claim, so a forged or garbled token
+	//   costs one mac computation rather than a mac plus a json parse
+	if(jws_sign(headerPart, claimPart, key) != sig)
+		return QVariant();
+
 	QByteArray claimJson = unbase64url(claimPart);
 	if(claimJson.isEmpty())
 		return QVariant();
@@ -142,10 +156,54 @@ QVariant decode(const QByteArray &token, const QByteArray &key)
 	if(error.error != QJsonParseError::NoError || !doc.isObject())
 		return QVariant();
 
-	QVariant claim = doc.object().toVariantMap();
+	return doc.object().toVariantMap();
+}
 
-	if(jws_sign(headerPart, claimPart, key) != sig)
-		return QVariant();
+class DecodeCacheEntry
+{
+public:
+	QVariant claim;
+	qint64 expires; // msecs since epoch, -1 = none
+};
+
+static QCache<QByteArray, DecodeCacheEntry> *g_decodeCache = 0;
+
+QVariant decodeCached(const QByteArray &token, const QByteArray &key)
+{
+	if(!g_decodeCache)
+		g_decodeCache = new QCache<QByteArray, DecodeCacheEntry>(DECODE_CACHE_MAX);
+
+	QByteArray cacheKey = token + '\n' + key;
+
+	DecodeCacheEntry *e = g_decodeCache->object(cacheKey);
+	if(e)
+	{
+		if(e->expires < 0 || QDateTime::currentMSecsSinceEpoch() < e->expires)
+			return e->claim;
+
+		g_decodeCache->remove(cacheKey);
+	}
+
+	QVariant claim = decode(token, key);
+
+	e = new DecodeCacheEntry;
+	e->claim = claim;
+	e->expires = -1;
+
+	if(claim.isValid())
+	{
+		QVariantMap m = claim.toMap();
+		if(m.contains("exp"))
+			e->expires = m.value("exp").toLongLong() * 1000;
+	}
+	else
+	{
+		// failures are cached too, so a client retrying a bad token in
+		//   a tight loop doesn't cost a signature check per attempt
+		e->expires = QDateTime::currentMSecsSinceEpoch() + DECODE_NEGATIVE_TTL;
+	}
+
+	g_decodeCache->insert(cacheKey, e);
 
 	return claim;
 }
@@ -36,6 +36,12 @@ namespace Jwt {
 QByteArray encode(const QVariant &claim, const QByteArray &key);
 QVariant decode(const QByteArray &token, const QByteArray &key);
 
+// like decode, but remembers successful verifications in an LRU cache
+//   so a token repeated within its validity window skips the signature
+//   computation. entries expire with the claim's "exp". not thread
+//   safe; call from one thread only
+QVariant decodeCached(const QByteArray &token, const QByteArray &key);
+
 }
 
 #endif
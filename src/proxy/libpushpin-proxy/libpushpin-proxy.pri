@@ -17,11 +17,15 @@ HEADERS += \
 	$$SRC_DIR/testwebsocket.h \
 	$$SRC_DIR/websocketoverhttp.h \
 	$$SRC_DIR/zrpcchecker.h \
+	$$SRC_DIR/sockjsutil.h \
 	$$SRC_DIR/sockjsmanager.h \
 	$$SRC_DIR/sockjssession.h \
 	$$SRC_DIR/inspectrequest.h \
+	$$SRC_DIR/inspectcache.h \
+	$$SRC_DIR/preflightcache.h \
 	$$SRC_DIR/acceptrequest.h \
 	$$SRC_DIR/connectionmanager.h \
+	$$SRC_DIR/targettracker.h \
 	$$SRC_DIR/wscontrolmanager.h \
 	$$SRC_DIR/wscontrolsession.h \
 	$$SRC_DIR/acceptdata.h \
@@ -42,11 +46,15 @@ SOURCES += \
 	$$SRC_DIR/testwebsocket.cpp \
 	$$SRC_DIR/websocketoverhttp.cpp \
 	$$SRC_DIR/zrpcchecker.cpp \
+	$$SRC_DIR/sockjsutil.cpp \
 	$$SRC_DIR/sockjsmanager.cpp \
 	$$SRC_DIR/sockjssession.cpp \
 	$$SRC_DIR/inspectrequest.cpp \
+	$$SRC_DIR/inspectcache.cpp \
+	$$SRC_DIR/preflightcache.cpp \
 	$$SRC_DIR/acceptrequest.cpp \
 	$$SRC_DIR/connectionmanager.cpp \
+	$$SRC_DIR/targettracker.cpp \
 	$$SRC_DIR/wscontrolmanager.cpp \
 	$$SRC_DIR/wscontrolsession.cpp \
 	$$SRC_DIR/routesfile.cpp \
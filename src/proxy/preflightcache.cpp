@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "preflightcache.h"
+
+#include <QDateTime>
+#include <QUrl>
+
+// spec default when the response carries no Access-Control-Max-Age
+#define MAX_AGE_DEFAULT 5000
+
+// cap the ttl regardless of what the origin claims
+#define MAX_AGE_MAX 86400000
+
+#define BODY_MAX 16384
+#define CACHE_MAX 1000
+
+PreflightCache::PreflightCache() :
+	cache_(CACHE_MAX)
+{
+}
+
+QByteArray PreflightCache::requestKey(const QByteArray &routeId, const HttpRequestData &requestData)
+{
+	if(requestData.method != "OPTIONS")
+		return QByteArray();
+
+	QByteArray origin = requestData.headers.get("Origin");
+	QByteArray requestMethod = requestData.headers.get("Access-Control-Request-Method");
+	if(origin.isEmpty() || requestMethod.isEmpty())
+		return QByteArray();
+
+	// include the path, since origins may allow different methods or
+	//   headers per resource. header names are lowercased so requests
+	//   differing only in case share an entry
+	QByteArray requestHeaders = HttpHeaders::join(requestData.headers.getAll("Access-Control-Request-Headers", true)).toLower();
+
+	QByteArray key;
+	key += routeId;
+	key += '\n';
+	key += origin;
+	key += '\n';
+	key += requestMethod;
+	key += '\n';
+	key += requestHeaders;
+	key += '\n';
+	key += requestData.uri.path(QUrl::FullyEncoded).toUtf8();
+	return key;
+}
+
+bool PreflightCache::get(const QByteArray &key, HttpResponseData *response)
+{
+	Entry *e = cache_.object(key);
+	if(!e)
+		return false;
+
+	if(QDateTime::currentMSecsSinceEpoch() >= e->expires)
+	{
+		cache_.remove(key);
+		return false;
+	}
+
+	*response = e->response;
+	return true;
+}
+
+void PreflightCache::insert(const QByteArray &key, const HttpResponseData &response)
+{
+	// only cache successful answers from origins that actually speak
+	//   CORS, and nothing that sets state on the client
+	if(response.code != 200 && response.code != 204)
+		return;
+
+	if(!response.headers.contains("Access-Control-Allow-Origin"))
+		return;
+
+	if(response.headers.contains("Set-Cookie"))
+		return;
+
+	if(response.body.size() > BODY_MAX)
+		return;
+
+	qint64 ttl = MAX_AGE_DEFAULT;
+	QByteArray maxAge = response.headers.get("Access-Control-Max-Age");
+	if(!maxAge.isEmpty())
+	{
+		bool ok;
+		qint64 secs = maxAge.toLongLong(&ok);
+		if(!ok || secs <= 0)
+		{
+			// the origin opted out of preflight caching
+			return;
+		}
+
+		ttl = qMin(secs * 1000, (qint64)MAX_AGE_MAX);
+	}
+
+	Entry *e = new Entry;
+	e->response = response;
+	e->expires = QDateTime::currentMSecsSinceEpoch() + ttl;
+	cache_.insert(key, e);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef PREFLIGHTCACHE_H
+#define PREFLIGHTCACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include "packet/httprequestdata.h"
+#include "packet/httpresponsedata.h"
+
+// cache of complete CORS preflight responses. browsers repeat the same
+//   OPTIONS preflight for every client against the same endpoints, so
+//   the full response can be replayed without contacting the origin.
+//   entries expire per the response's Access-Control-Max-Age
+class PreflightCache
+{
+public:
+	PreflightCache();
+
+	// the cache key for a request, or an empty array if the request is
+	//   not a cacheable preflight
+	static QByteArray requestKey(const QByteArray &routeId, const HttpRequestData &requestData);
+
+	bool get(const QByteArray &key, HttpResponseData *response);
+	void insert(const QByteArray &key, const HttpResponseData &response);
+
+private:
+	class Entry
+	{
+	public:
+		HttpResponseData response;
+		qint64 expires;
+	};
+
+	QCache<QByteArray, Entry> cache_;
+};
+
+#endif
@@ -46,8 +46,11 @@
 #include "xffrule.h"
 #include "requestsession.h"
 #include "proxyutil.h"
+#include "targettracker.h"
 #include "acceptrequest.h"
+#include "preflightcache.h"
 #include "testhttprequest.h"
+#include "tracepoints.h"
 
 #define MAX_ACCEPT_REQUEST_BODY 100000
 
@@ -57,7 +60,7 @@
 #define MAX_INITIAL_BUFFER 100000
 #define MAX_STREAM_BUFFER 100000
 
-class ProxySession::Private : public QObject
+class ProxySession::Private : public QObject, public HttpRequest::Listener
 {
 	Q_OBJECT
 
@@ -141,11 +144,15 @@ public:
 	XffRule xffTrustedRule;
 	QList<QByteArray> origHeadersNeedMark;
 	bool proxyInitialResponse;
+	PreflightCache *preflightCache;
+	QByteArray preflightCacheKey;
 	bool acceptAfterResponding;
 	AcceptRequest *acceptRequest;
+	TargetTracker *targetTracker;
+	QString trackedTarget;
 	LogUtil::Config logConfig;
 
-	Private(ProxySession *_q, ZRoutes *_zroutes, ZrpcManager *_acceptManager, const LogUtil::Config &_logConfig) :
+	Private(ProxySession *_q, ZRoutes *_zroutes, ZrpcManager *_acceptManager, TargetTracker *_targetTracker, const LogUtil::Config &_logConfig) :
 		QObject(_q),
 		q(_q),
 		state(Stopped),
@@ -167,8 +174,10 @@ public:
 		useXForwardedProto(false),
 		useXForwardedProtocol(false),
 		proxyInitialResponse(false),
+		preflightCache(0),
 		acceptAfterResponding(false),
 		acceptRequest(0),
+		targetTracker(_targetTracker),
 		logConfig(_logConfig)
 	{
 		acceptHeaderPrefixes += "Grip-";
@@ -193,6 +202,12 @@ public:
 		sessionItems.clear();
 		sessionItemsBySession.clear();
 
+		if(!trackedTarget.isEmpty())
+		{
+			targetTracker->removeOutstanding(trackedTarget);
+			trackedTarget.clear();
+		}
+
 		if(zhttpManager)
 		{
 			zroutes->removeRef(zhttpManager);
@@ -229,6 +244,11 @@ public:
 
 			origRequestData = requestData;
 
+			// if this is a preflight, remember the key so the response
+			//   can be cached for replay
+			if(preflightCache)
+				preflightCacheKey = PreflightCache::requestKey(route.id, origRequestData);
+
 			if(!route.asHost.isEmpty())
 				ProxyUtil::applyHost(&requestData.uri, route.asHost);
 
@@ -269,6 +289,8 @@ public:
 			{
 				inRequest = rs->request();
 
+				// the client request stays on signals: RequestSession
+				//   listens to the same object during respond
 				connect(inRequest, &ZhttpRequest::readyRead, this, &Private::inRequest_readyRead);
 				connect(inRequest, &ZhttpRequest::error, this, &Private::inRequest_error);
 
@@ -344,7 +366,40 @@ public:
 			return;
 		}
 
-		target = targets.takeFirst();
+		// weighted least-outstanding selection: pick the available
+		//   target with the fewest in-flight requests per unit weight.
+		//   ejected targets are only chosen if nothing else is left
+		int best = -1;
+		bool bestAvailable = false;
+		int bestOutstanding = 0;
+		for(int n = 0; n < targets.count(); ++n)
+		{
+			QString key = ProxyUtil::targetToString(targets[n]);
+			bool available = targetTracker->checkAvailable(key);
+			int out = targetTracker->outstanding(key);
+
+			if(best != -1)
+			{
+				if(bestAvailable && !available)
+					continue;
+
+				// compare out/weight to best/bestWeight without dividing
+				if(available == bestAvailable && out * targets[best].weight >= bestOutstanding * targets[n].weight)
+					continue;
+			}
+
+			best = n;
+			bestAvailable = available;
+			bestOutstanding = out;
+		}
+
+		target = targets.takeAt(best);
+
+		if(!trackedTarget.isEmpty())
+			targetTracker->removeOutstanding(trackedTarget);
+
+		trackedTarget = ProxyUtil::targetToString(target);
+		targetTracker->addOutstanding(trackedTarget);
 
 		if(target.overHttp)
 		{
@@ -390,7 +445,11 @@ public:
 					uri.setPath(uri.path(QUrl::FullyEncoded).mid(pathRemove));
 			}
 
-			zhttpRequest = new TestHttpRequest(this);
+			TestHttpRequest *treq = new TestHttpRequest(this);
+			treq->setResponseDelay(target.testDelay, target.testDelayJitter);
+			treq->setBodySize(target.testBodySize);
+			treq->setGripRate(target.testGripRate);
+			zhttpRequest = treq;
 		}
 		else
 		{
@@ -411,8 +470,8 @@ public:
 			zhttpRequest->setParent(this);
 		}
 
-		connect(zhttpRequest, &ZhttpRequest::readyRead, this, &Private::zhttpRequest_readyRead);
-		connect(zhttpRequest, &ZhttpRequest::bytesWritten, this, &Private::zhttpRequest_bytesWritten);
+		// per-chunk events as direct calls; errors stay on a signal
+		zhttpRequest->setListener(this);
 		connect(zhttpRequest, &ZhttpRequest::error, this, &Private::zhttpRequest_error);
 
 		if(target.trusted)
@@ -716,8 +775,18 @@ public:
 					}
 				}
 
-				if(proxyInitialResponse && (gripHold == "stream" || (gripHold.isEmpty() && !gripNextLinkParam.isEmpty())) && !usingBuildIdFilter)
+				bool canProxyInitialResponse = ((gripHold == "stream" || (gripHold.isEmpty() && !gripNextLinkParam.isEmpty())) && !usingBuildIdFilter);
+
+				if(canProxyInitialResponse)
 				{
+					// the accept packet can't reasonably carry a body this
+					//   large, so stream it to the clients from here and
+					//   accept with metadata only. routes can opt into this
+					//   mode unconditionally; for the rest it's the
+					//   fallback to what used to be a hard failure
+					if(!proxyInitialResponse)
+						log_warning("GRIP instruct response too large from %s, sending initial response from proxy", qPrintable(ProxyUtil::targetToString(target)));
+
 					// sending the initial response from the proxy means
 					//   we need to do some of the handler's job here
 
@@ -899,6 +968,18 @@ public:
 			}
 			else if(state == Responding)
 			{
+				// a fully buffered preflight answer can be replayed for
+				//   future preflights without contacting the origin
+				if(preflightCache && !preflightCacheKey.isEmpty() && buffering)
+				{
+					HttpResponseData resp;
+					resp.code = responseData.code;
+					resp.reason = responseData.reason;
+					resp.headers = responseData.headers;
+					resp.body = responseBody.toByteArray();
+					preflightCache->insert(preflightCacheKey, resp);
+				}
+
 				foreach(SessionItem *si, sessionItems)
 				{
 					assert(si->state != SessionItem::WaitingForResponse);
@@ -918,11 +999,20 @@ public:
 		state = Responding;
 
 		// don't relay these headers. their meaning is handled by
-		//   zurl and they only apply to the outgoing hop.
-		responseData.headers.removeAll("Connection");
-		responseData.headers.removeAll("Keep-Alive");
-		responseData.headers.removeAll("Content-Encoding");
-		responseData.headers.removeAll("Transfer-Encoding");
+		//   zurl and they only apply to the outgoing hop. remove in a
+		//   single pass, so the shared header list detaches and shifts
+		//   at most once instead of once per name
+		for(int n = responseData.headers.count() - 1; n >= 0; --n)
+		{
+			const QByteArray &name = responseData.headers.at(n).first;
+			if(qstricmp(name.data(), "Connection") == 0 ||
+				qstricmp(name.data(), "Keep-Alive") == 0 ||
+				qstricmp(name.data(), "Content-Encoding") == 0 ||
+				qstricmp(name.data(), "Transfer-Encoding") == 0)
+			{
+				responseData.headers.removeAt(n);
+			}
+		}
 
 		foreach(SessionItem *si, sessionItems)
 		{
@@ -977,6 +1067,26 @@ public:
 		LogUtil::logRequest(LOG_LEVEL_INFO, rd, logConfig);
 	}
 
+	// HttpRequest::Listener
+	//
+	// per-chunk events from the target request arrive here as direct
+	//   calls, bypassing signal dispatch. only the target request
+	//   registers: the client request is shared with RequestSession,
+	//   so it stays on signals
+	virtual void requestReadyRead(HttpRequest *req)
+	{
+		Q_UNUSED(req);
+
+		zhttpRequest_readyRead();
+	}
+
+	virtual void requestBytesWritten(HttpRequest *req, int count)
+	{
+		Q_UNUSED(req);
+
+		zhttpRequest_bytesWritten(count);
+	}
+
 public slots:
 	void inRequest_readyRead()
 	{
@@ -996,6 +1106,11 @@ public slots:
 
 		if(state == Requesting)
 		{
+			// first data from the target for this session
+			TRACEPOINT2(origin_first_byte, q, zhttpRequest->responseCode());
+
+			targetTracker->recordSuccess(trackedTarget);
+
 			responseData.code = zhttpRequest->responseCode();
 			responseData.reason = zhttpRequest->responseReason();
 			responseData.headers = zhttpRequest->responseHeaders();
@@ -1089,6 +1204,7 @@ public slots:
 				case ZhttpRequest::ErrorTls:
 					// it should not be possible to get one of these errors while accepting
 					assert(state == Requesting);
+					targetTracker->recordFailure(trackedTarget);
 					tryAgain = true;
 					break;
 				case ZhttpRequest::ErrorTimeout:
@@ -1381,10 +1497,10 @@ public slots:
 	}
 };
 
-ProxySession::ProxySession(ZRoutes *zroutes, ZrpcManager *acceptManager, const LogUtil::Config &logConfig, QObject *parent) :
+ProxySession::ProxySession(ZRoutes *zroutes, ZrpcManager *acceptManager, TargetTracker *targetTracker, const LogUtil::Config &logConfig, QObject *parent) :
 	QObject(parent)
 {
-	d = new Private(this, zroutes, acceptManager, logConfig);
+	d = new Private(this, zroutes, acceptManager, targetTracker, logConfig);
 }
 
 ProxySession::~ProxySession()
@@ -1430,6 +1546,11 @@ void ProxySession::setProxyInitialResponseEnabled(bool enabled)
 	d->proxyInitialResponse = enabled;
 }
 
+void ProxySession::setPreflightCache(PreflightCache *cache)
+{
+	d->preflightCache = cache;
+}
+
 void ProxySession::setInspectData(const InspectData &idata)
 {
 	d->haveInspectData = true;
@@ -39,13 +39,15 @@ class ZrpcManager;
 class ZRoutes;
 class XffRule;
 class RequestSession;
+class TargetTracker;
+class PreflightCache;
 
 class ProxySession : public QObject
 {
 	Q_OBJECT
 
 public:
-	ProxySession(ZRoutes *zroutes, ZrpcManager *acceptManager, const LogUtil::Config &logConfig, QObject *parent = 0);
+	ProxySession(ZRoutes *zroutes, ZrpcManager *acceptManager, TargetTracker *targetTracker, const LogUtil::Config &logConfig, QObject *parent = 0);
 	~ProxySession();
 
 	void setRoute(const DomainMap::Entry &route);
@@ -55,6 +57,7 @@ public:
 	void setXffRules(const XffRule &untrusted, const XffRule &trusted);
 	void setOrigHeadersNeedMark(const QList<QByteArray> &names);
 	void setProxyInitialResponseEnabled(bool enabled);
+	void setPreflightCache(PreflightCache *cache);
 
 	void setInspectData(const InspectData &idata);
 
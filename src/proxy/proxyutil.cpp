@@ -29,21 +29,57 @@
 #include "proxyutil.h"
 
 #include <QDateTime>
+#include <QCache>
 #include "log.h"
 #include "jwt.h"
 #include "inspectdata.h"
+#include "statsmanager.h"
+
+#define TOKEN_EXPIRE 3600
+#define TOKEN_ROTATE (TOKEN_EXPIRE / 6)
+#define TOKEN_CACHE_MAX 100
+
+class CachedToken
+{
+public:
+	QByteArray token;
+	uint regenAfter; // unix time
+};
+
+// the claims only carry iss/exp, so within the validity window every
+//   request to the same route gets an identical token. sign once per
+//   issuer/key and reuse, rotating well ahead of expiry
+static QCache<QByteArray, CachedToken> g_tokenCache(TOKEN_CACHE_MAX);
 
 static QByteArray make_token(const QByteArray &iss, const QByteArray &key)
 {
+	uint now = QDateTime::currentDateTimeUtc().toTime_t();
+
+	QByteArray cacheKey = iss + '\n' + key;
+
+	CachedToken *ct = g_tokenCache.object(cacheKey);
+	if(ct && now < ct->regenAfter)
+		return ct->token;
+
 	QVariantMap claim;
 	claim["iss"] = QString::fromUtf8(iss);
-	claim["exp"] = QDateTime::currentDateTimeUtc().toTime_t() + 3600;
-	return Jwt::encode(claim, key);
+	claim["exp"] = now + TOKEN_EXPIRE;
+
+	QByteArray token = Jwt::encode(claim, key);
+	if(token.isEmpty())
+		return token;
+
+	ct = new CachedToken;
+	ct->token = token;
+	ct->regenAfter = now + TOKEN_EXPIRE - TOKEN_ROTATE;
+	g_tokenCache.insert(cacheKey, ct);
+
+	return token;
 }
 
 static bool validate_token(const QByteArray &token, const QByteArray &key)
 {
-	QVariant claimObj = Jwt::decode(token, key);
+	QVariant claimObj = Jwt::decodeCached(token, key);
 	if(!claimObj.isValid() || claimObj.type() != QVariant::Map)
 		return false;
 
@@ -124,46 +160,68 @@ void manipulateRequestHeaders(const char *logprefix, void *object, HttpRequestDa
 		foreach(const HttpHeader &h, origHeaders)
 			requestData->headers += h;
 	}
-	else if(!entry.origHeaders)
-	{
-		// if we don't want original headers, then filter them out
-		//   before proxying
-		for(int n = 0; n < requestData->headers.count(); ++n)
-		{
-			const HttpHeader &h = requestData->headers[n];
 
-			if(qstrnicmp(h.first.data(), "eb9bf0f5-", 9) == 0)
-			{
-				requestData->headers.removeAt(n);
-				--n; // adjust position
-			}
-		}
-	}
+	// remove everything we don't relay in a single pass: headers whose
+	//   meaning is handled by mongrel2 and only applies to the incoming
+	//   hop, marked headers when originals aren't wanted, grip headers
+	//   from untrusted clients, and values we regenerate below
+	static const char *hopHeaders[] = {
+		"Connection",
+		"Keep-Alive",
+		"Accept-Encoding",
+		"Content-Encoding",
+		"Transfer-Encoding",
+		"Expect",
+		0
+	};
+
+	bool stripMarked = !entry.origHeaders;
+	bool stripGrip = (!trustedClient && stripHeaders);
+	bool stripXfp = (acceptXForwardedProtocol || useXForwardedProto || useXForwardedProtocol);
+
+	for(int n = 0; n < requestData->headers.count(); ++n)
+	{
+		const HttpHeader &h = requestData->headers[n];
 
-	// don't relay these headers. their meaning is handled by
-	//   mongrel2 and they only apply to the incoming hop.
-	requestData->headers.removeAll("Connection");
-	requestData->headers.removeAll("Keep-Alive");
-	requestData->headers.removeAll("Accept-Encoding");
-	requestData->headers.removeAll("Content-Encoding");
-	requestData->headers.removeAll("Transfer-Encoding");
-	requestData->headers.removeAll("Expect");
+		bool remove = false;
 
-	if(!trustedClient)
-	{
-		if(stripHeaders)
+		if(stripMarked && qstrnicmp(h.first.data(), "eb9bf0f5-", 9) == 0)
+		{
+			remove = true;
+		}
+		else if(stripGrip && qstrnicmp(h.first.data(), "Grip-", 5) == 0)
+		{
+			remove = true;
+		}
+		else if(qstricmp(h.first.data(), "Grip-Feature") == 0)
+		{
+			remove = true;
+		}
+		else if(stripXfp && (qstricmp(h.first.data(), "X-Forwarded-Proto") == 0 || qstricmp(h.first.data(), "X-Forwarded-Protocol") == 0))
+		{
+			remove = true;
+		}
+		else
 		{
-			// remove all Grip- headers
-			for(int n = 0; n < requestData->headers.count(); ++n)
+			for(int k = 0; hopHeaders[k]; ++k)
 			{
-				if(qstrnicmp(requestData->headers[n].first.data(), "Grip-", 5) == 0)
+				if(qstricmp(h.first.data(), hopHeaders[k]) == 0)
 				{
-					requestData->headers.removeAt(n);
-					--n; // adjust position
+					remove = true;
+					break;
 				}
 			}
 		}
 
+		if(remove)
+		{
+			requestData->headers.removeAt(n);
+			--n; // adjust position
+		}
+	}
+
+	if(!trustedClient)
+	{
 		// set Grip-Sig
 		if(!sigIss.isEmpty() && !sigKey.isEmpty())
 		{
@@ -175,9 +233,8 @@ void manipulateRequestHeaders(const char *logprefix, void *object, HttpRequestDa
 		}
 	}
 
-	requestData->headers.removeAll("Grip-Feature");
 	requestData->headers += HttpHeader("Grip-Feature",
-		"status, session, link:next, filter:skip-self, filter:skip-users, filter:require-sub, filter:build-id");
+		"status, session, link:next, filter:skip-self, filter:skip-users, filter:require-sub, filter:rate-limit, filter:build-id");
 
 	if(!idata.sid.isEmpty())
 	{
@@ -194,14 +251,6 @@ void manipulateRequestHeaders(const char *logprefix, void *object, HttpRequestDa
 		}
 	}
 
-	if(acceptXForwardedProtocol || useXForwardedProto || useXForwardedProtocol)
-	{
-		requestData->headers.removeAll("X-Forwarded-Proto");
-
-		// TODO: deprecate
-		requestData->headers.removeAll("X-Forwarded-Protocol");
-	}
-
 	if(useXForwardedProto || useXForwardedProtocol)
 	{
 		QString scheme = requestData->uri.scheme();
@@ -284,4 +333,16 @@ QHostAddress getLogicalAddress(const HttpHeaders &headers, const XffRule &xffRul
 	return peerAddress;
 }
 
+bool shouldTrackConnection(StatsManager *stats, const DomainMap::Entry &route)
+{
+	// beyond the cap, connections only count toward aggregate activity
+	if(route.statsConnsMax >= 0 && stats->connectionCount(route.id) >= route.statsConnsMax)
+		return false;
+
+	if(route.statsSample < 100 && (int)(qrand() % 100) >= route.statsSample)
+		return false;
+
+	return true;
+}
+
 }
@@ -37,6 +37,7 @@
 #include "xffrule.h"
 
 class InspectData;
+class StatsManager;
 
 namespace ProxyUtil {
 
@@ -52,6 +53,10 @@ QString targetToString(const DomainMap::Target &target);
 
 QHostAddress getLogicalAddress(const HttpHeaders &headers, const XffRule &xffRule, const QHostAddress &peerAddress);
 
+// whether a new connection on the route should be tracked individually
+//   in stats, applying the route's sampling rate and cardinality cap
+bool shouldTrackConnection(StatsManager *stats, const DomainMap::Entry &route);
+
 }
 
 #endif
@@ -29,6 +29,7 @@
 #include "requestsession.h"
 
 #include <assert.h>
+#include <algorithm>
 #include <QPointer>
 #include <QUrl>
 #include <QHostAddress>
@@ -47,11 +48,13 @@
 #include "zrpcmanager.h"
 #include "zrpcchecker.h"
 #include "inspectrequest.h"
+#include "inspectcache.h"
 #include "acceptrequest.h"
 #include "statsmanager.h"
 #include "cors.h"
 #include "proxyutil.h"
 #include "xffrule.h"
+#include "tracepoints.h"
 
 #define MAX_SHARED_REQUEST_BODY 100000
 #define MAX_ACCEPT_REQUEST_BODY 100000
@@ -131,6 +134,13 @@ static QByteArray ridToString(const QPair<QByteArray, QByteArray> &rid)
 	return rid.first + ':' + rid.second;
 }
 
+// response headers to mirror in a JSON-P wrapping response. shared across
+//   sessions so that plain pass-through requests don't pay to build a list
+static const char *jsonpExtractableHeaders[] = {
+	"Cache-Control",
+	0
+};
+
 class RequestSession::Private : public QObject
 {
 	Q_OBJECT
@@ -157,6 +167,7 @@ public:
 	SockJsManager *sockJsManager;
 	ZrpcManager *inspectManager;
 	ZrpcChecker *inspectChecker;
+	InspectCache *inspectCache;
 	ZrpcManager *acceptManager;
 	StatsManager *stats;
 	ZhttpRequest *zhttpRequest;
@@ -173,6 +184,7 @@ public:
 	AcceptRequest *acceptRequest;
 	BufferList in;
 	QByteArray jsonpCallback;
+	QByteArray jsonpPrefix; // "/**/callback(", built when the callback is set
 	bool jsonpExtendedResponse;
 	HttpResponseData responseData;
 	int responseBodySize;
@@ -181,7 +193,6 @@ public:
 	bool pendingResponseUpdate;
 	LayerTracker jsonpTracker;
 	bool isRetry;
-	QList<QByteArray> jsonpExtractableHeaders;
 	int prefetchSize;
 	bool needPause;
 	bool connectionRegistered;
@@ -192,7 +203,7 @@ public:
 	XffRule xffTrustedRule;
 	bool isSockJs;
 
-	Private(RequestSession *_q, DomainMap *_domainMap = 0, SockJsManager *_sockJsManager = 0, ZrpcManager *_inspectManager = 0, ZrpcChecker *_inspectChecker = 0, ZrpcManager *_acceptManager = 0, StatsManager *_stats = 0) :
+	Private(RequestSession *_q, DomainMap *_domainMap = 0, SockJsManager *_sockJsManager = 0, ZrpcManager *_inspectManager = 0, ZrpcChecker *_inspectChecker = 0, InspectCache *_inspectCache = 0, ZrpcManager *_acceptManager = 0, StatsManager *_stats = 0) :
 		QObject(_q),
 		q(_q),
 		state(Stopped),
@@ -200,6 +211,7 @@ public:
 		sockJsManager(_sockJsManager),
 		inspectManager(_inspectManager),
 		inspectChecker(_inspectChecker),
+		inspectCache(_inspectCache),
 		acceptManager(_acceptManager),
 		stats(_stats),
 		zhttpRequest(0),
@@ -221,7 +233,6 @@ public:
 		autoShare(false),
 		isSockJs(false)
 	{
-		jsonpExtractableHeaders += "Cache-Control";
 	}
 
 	~Private()
@@ -358,9 +369,15 @@ public:
 
 		if(stats && !passthrough)
 		{
-			connectionRegistered = true;
+			// routes can opt out of tracking every connection. untracked
+			//   connections still count toward route activity
+			if(ProxyUtil::shouldTrackConnection(stats, route))
+			{
+				connectionRegistered = true;
+
+				stats->addConnection(ridToString(rid), route.id, StatsManager::Http, logicalPeerAddress, isHttps, false);
+			}
 
-			stats->addConnection(ridToString(rid), route.id, StatsManager::Http, logicalPeerAddress, isHttps, false);
 			stats->addActivity(route.id);
 		}
 
@@ -409,6 +426,24 @@ public:
 		}
 	}
 
+	QByteArray inspectCacheKey() const
+	{
+		// for routes without session inspection, the inspect result
+		//   depends only on these parts of the request
+		QByteArray key = route.id + '|' + requestData.method.toLatin1() + '|' + requestData.uri.toEncoded();
+
+		QList<QByteArray> gripLastHeaders = requestData.headers.getAll("Grip-Last");
+		std::sort(gripLastHeaders.begin(), gripLastHeaders.end());
+
+		foreach(const QByteArray &h, gripLastHeaders)
+			key += '|' + h;
+
+		if(autoShare)
+			key += "|auto";
+
+		return key;
+	}
+
 	void processIncomingRequest()
 	{
 		if(state == Prefetching)
@@ -423,6 +458,7 @@ public:
 				disconnect(zhttpRequest, &ZhttpRequest::readyRead, this, &Private::zhttpRequest_readyRead);
 
 				state = Inspecting;
+				TRACEPOINT1(inspect_start, q);
 				requestData.body = in.toByteArray();
 				bool truncated = (!zhttpRequest->isInputFinished() || zhttpRequest->bytesAvailable() > 0);
 
@@ -430,6 +466,20 @@ public:
 
 				if(inspectManager)
 				{
+					// if the route doesn't use session inspection, then the
+					//   result doesn't depend on the request body and we may
+					//   already have it cached
+					if(inspectCache && !route.session)
+					{
+						InspectData cached;
+						if(inspectCache->get(inspectCacheKey(), &cached))
+						{
+							idata = cached;
+							QMetaObject::invokeMethod(this, "doInspectDone", Qt::QueuedConnection);
+							return;
+						}
+					}
+
 					inspectRequest = new InspectRequest(inspectManager, this);
 
 					if(inspectChecker->isInterfaceAvailable())
@@ -438,13 +488,23 @@ public:
 						inspectChecker->watch(inspectRequest);
 						inspectRequest->start(requestData, truncated, route.session, autoShare);
 					}
-					else
+					else if(inspectChecker->probeDue())
 					{
+						// fire a recovery probe without waiting for the
+						//   result. the checker flips back to available
+						//   when a probe succeeds
 						inspectChecker->watch(inspectRequest);
 						inspectChecker->give(inspectRequest);
 						inspectRequest->start(requestData, truncated, route.session, autoShare);
 						inspectRequest = 0;
 					}
+					else
+					{
+						// interface down and a probe was sent recently,
+						//   so skip inspection without a zrpc call
+						delete inspectRequest;
+						inspectRequest = 0;
+					}
 				}
 
 				if(!inspectRequest)
@@ -536,7 +596,7 @@ public:
 	// returns null array on error
 	QByteArray makeJsonpStart(int code, const QByteArray &reason, const HttpHeaders &headers)
 	{
-		QByteArray out = "/**/" + jsonpCallback + "(";
+		QByteArray out = jsonpPrefix;
 
 		if(jsonpExtendedResponse)
 		{
@@ -595,6 +655,12 @@ public:
 		if(requestData.method != "GET")
 			return false;
 
+		// both ways of activating JSON-P require a query item, so if there
+		//   is no query string then we can skip parsing it. this is the
+		//   common case on auto-cross-origin routes
+		if(!requestData.uri.hasQuery())
+			return false;
+
 		QString callbackParam = QString::fromUtf8(config.callbackParam);
 		if(callbackParam.isEmpty())
 			callbackParam = "callback";
@@ -768,6 +834,7 @@ public:
 		in += body;
 
 		jsonpCallback = callback;
+		jsonpPrefix = "/**/" + callback + "(";
 		jsonpExtendedResponse = (config.mode == DomainMap::JsonpConfig::Extended);
 
 		return true;
@@ -869,33 +936,10 @@ public slots:
 		inspectChecker->give(inspectRequest);
 		inspectRequest = 0;
 
-		if(!idata.doProxy)
-		{
-			state = ReceivingForAccept;
+		if(inspectCache && !route.session)
+			inspectCache->insert(inspectCacheKey(), idata);
 
-			// successful inspect indicated we should not proxy. in that case,
-			//   collect the body and accept
-			connect(zhttpRequest, &ZhttpRequest::readyRead, this, &Private::zhttpRequest_readyRead);
-			processIncomingRequest();
-		}
-		else
-		{
-			if(!idata.sharingKey.isEmpty())
-			{
-				// a request can only be shared if we've read the entire
-				//   request body, so let's try to read it now
-				state = Receiving;
-
-				connect(zhttpRequest, &ZhttpRequest::readyRead, this, &Private::zhttpRequest_readyRead);
-				processIncomingRequest();
-			}
-			else
-			{
-				state = WaitingForResponse;
-				requestData.body = in.take();
-				emit q->inspected(idata);
-			}
-		}
+		doInspectDone();
 	}
 
 	void acceptRequest_finished()
@@ -996,9 +1040,9 @@ public slots:
 					// mirror headers in the wrapping response
 					foreach(const HttpHeader &h, responseData.headers)
 					{
-						foreach(const QByteArray &eh, jsonpExtractableHeaders)
+						for(int n = 0; jsonpExtractableHeaders[n]; ++n)
 						{
-							if(qstricmp(h.first.data(), eh.data()) == 0)
+							if(qstricmp(h.first.data(), jsonpExtractableHeaders[n]) == 0)
 							{
 								headers += h;
 								break;
@@ -1143,8 +1187,43 @@ public slots:
 		respond(200, "OK", message.toUtf8() + '\n');
 	}
 
+	void doInspectDone()
+	{
+		TRACEPOINT2(inspect_done, q, idata.doProxy ? 1 : 0);
+
+		if(!idata.doProxy)
+		{
+			state = ReceivingForAccept;
+
+			// successful inspect indicated we should not proxy. in that case,
+			//   collect the body and accept
+			connect(zhttpRequest, &ZhttpRequest::readyRead, this, &Private::zhttpRequest_readyRead);
+			processIncomingRequest();
+		}
+		else
+		{
+			if(!idata.sharingKey.isEmpty())
+			{
+				// a request can only be shared if we've read the entire
+				//   request body, so let's try to read it now
+				state = Receiving;
+
+				connect(zhttpRequest, &ZhttpRequest::readyRead, this, &Private::zhttpRequest_readyRead);
+				processIncomingRequest();
+			}
+			else
+			{
+				state = WaitingForResponse;
+				requestData.body = in.take();
+				emit q->inspected(idata);
+			}
+		}
+	}
+
 	void doInspectError()
 	{
+		TRACEPOINT1(inspect_error, q);
+
 		state = WaitingForResponse;
 		emit q->inspectError();
 	}
@@ -1153,13 +1232,13 @@ public slots:
 RequestSession::RequestSession(StatsManager *stats, QObject *parent) :
 	QObject(parent)
 {
-	d = new Private(this, 0, 0, 0, 0, 0, stats);
+	d = new Private(this, 0, 0, 0, 0, 0, 0, stats);
 }
 
-RequestSession::RequestSession(DomainMap *domainMap, SockJsManager *sockJsManager, ZrpcManager *inspectManager, ZrpcChecker *inspectChecker, ZrpcManager *acceptManager, StatsManager *stats, QObject *parent) :
+RequestSession::RequestSession(DomainMap *domainMap, SockJsManager *sockJsManager, ZrpcManager *inspectManager, ZrpcChecker *inspectChecker, InspectCache *inspectCache, ZrpcManager *acceptManager, StatsManager *stats, QObject *parent) :
 	QObject(parent)
 {
-	d = new Private(this, domainMap, sockJsManager, inspectManager, inspectChecker, acceptManager, stats);
+	d = new Private(this, domainMap, sockJsManager, inspectManager, inspectChecker, inspectCache, acceptManager, stats);
 }
 
 RequestSession::~RequestSession()
@@ -1306,6 +1385,8 @@ void RequestSession::startRetry(ZhttpRequest *req, bool debug, bool autoCrossOri
 	d->debug = debug;
 	d->autoCrossOrigin = autoCrossOrigin;
 	d->jsonpCallback = jsonpCallback;
+	if(!jsonpCallback.isEmpty())
+		d->jsonpPrefix = "/**/" + jsonpCallback + "(";
 	d->jsonpExtendedResponse = jsonpExtendedResponse;
 	d->requestData.method = req->requestMethod();
 	d->requestData.uri = req->requestUri();
@@ -1345,6 +1426,17 @@ void RequestSession::writeResponseBody(const QByteArray &body)
 	assert(d->state == Private::RespondingStart || d->state == Private::Responding);
 	assert(!d->responseBodyFinished);
 
+	// when streaming a plain response, hand the chunk straight to the
+	//   output request, which holds a reference to the same buffer the
+	//   relay read from the origin. queueing through the out list would
+	//   merge chunks into a fresh allocation per attached session
+	if(d->state == Private::Responding && d->jsonpCallback.isEmpty())
+	{
+		d->zhttpRequest->writeBody(body);
+		d->responseBodySize += body.size();
+		return;
+	}
+
 	d->out += body;
 	d->responseUpdate();
 }
@@ -42,6 +42,7 @@ class InspectData;
 class AcceptData;
 class ZrpcManager;
 class ZrpcChecker;
+class InspectCache;
 class StatsManager;
 class XffRule;
 
@@ -51,7 +52,7 @@ class RequestSession : public QObject
 
 public:
 	RequestSession(StatsManager *stats, QObject *parent = 0);
-	RequestSession(DomainMap *domainMap, SockJsManager *sockJsManager, ZrpcManager *inspectManager, ZrpcChecker *inspectChecker, ZrpcManager *accept, StatsManager *stats, QObject *parent = 0);
+	RequestSession(DomainMap *domainMap, SockJsManager *sockJsManager, ZrpcManager *inspectManager, ZrpcChecker *inspectChecker, InspectCache *inspectCache, ZrpcManager *accept, StatsManager *stats, QObject *parent = 0);
 	~RequestSession();
 
 	bool isRetry() const;
@@ -41,6 +41,7 @@
 #include "zhttprequest.h"
 #include "zwebsocket.h"
 #include "sockjssession.h"
+#include "sockjsutil.h"
 
 #define MAX_REQUEST_BODY 100000
 
@@ -62,17 +63,6 @@ const char *iframeHtmlTemplate =
 "</body>\n"
 "</html>\n";
 
-static QByteArray serializeJsonString(const QString &s)
-{
-	QByteArray tmp = QJsonDocument(QJsonArray::fromVariantList(QVariantList() << s)).toJson(QJsonDocument::Compact);
-
-	assert(tmp.length() >= 4);
-	assert(tmp[0] == '[' && tmp[tmp.length() - 1] == ']');
-	assert(tmp[1] == '"' && tmp[tmp.length() - 2] == '"');
-
-	return tmp.mid(1, tmp.length() - 2);
-}
-
 class SockJsManager::Private : public QObject
 {
 	Q_OBJECT
@@ -137,6 +127,8 @@ public:
 	QList<Session*> pendingSessions;
 	QByteArray iframeHtml;
 	QByteArray iframeHtmlEtag;
+	QByteArray infoBodyPrefix;
+	QByteArray infoBodySuffix;
 	QSet<ZhttpRequest*> discardedRequests;
 
 	Private(SockJsManager *_q, const QString &sockJsUrl) :
@@ -145,6 +137,20 @@ public:
 	{
 		iframeHtml = QString(iframeHtmlTemplate).arg(sockJsUrl).toUtf8();
 		iframeHtmlEtag = '\"' + QCryptographicHash::hash(iframeHtml, QCryptographicHash::Md5).toHex() + '\"';
+
+		// the info response is identical for every request except the
+		//   entropy value, so serialize once with a placeholder and
+		//   splice the number in per request
+		QVariantMap info;
+		info["websocket"] = true;
+		info["origins"] = QVariantList() << QString("*:*");
+		info["cookie_needed"] = false;
+		info["entropy"] = 0;
+		QByteArray json = QJsonDocument(QJsonObject::fromVariantMap(info)).toJson(QJsonDocument::Compact);
+		int at = json.indexOf("\"entropy\":0");
+		assert(at != -1);
+		infoBodyPrefix = json.mid(0, at + 10);
+		infoBodySuffix = json.mid(at + 11) + '\n'; // newline is required
 	}
 
 	~Private()
@@ -330,7 +336,7 @@ public:
 
 		if(!jsonpCallback.isEmpty())
 		{
-			QByteArray encBody = serializeJsonString(QString::fromUtf8(body));
+			QByteArray encBody = SockJsUtil::serializeJsonString(QString::fromUtf8(body));
 			body = "/**/" + jsonpCallback + '(' + encBody + ");\n";
 		}
 		else if(!body.isEmpty())
@@ -339,6 +345,18 @@ public:
 		respond(req, 200, "OK", headers, body);
 	}
 
+	void respondOkEncoded(ZhttpRequest *req, const QByteArray &body)
+	{
+		HttpHeaders headers;
+		headers += HttpHeader("Content-Type", "text/plain");
+
+		QByteArray outBody = body;
+		if(!outBody.isEmpty())
+			outBody += "\n"; // newline is required
+
+		respond(req, 200, "OK", headers, outBody);
+	}
+
 	void respondOk(ZhttpRequest *req, const QString &str, const QByteArray &jsonpCallback = QByteArray())
 	{
 		HttpHeaders headers;
@@ -350,7 +368,7 @@ public:
 		QByteArray body;
 		if(!jsonpCallback.isEmpty())
 		{
-			QByteArray encBody = serializeJsonString(str);
+			QByteArray encBody = SockJsUtil::serializeJsonString(str);
 			body = "/**/" + jsonpCallback + '(' + encBody + ");\n";
 		}
 		else
@@ -409,12 +427,9 @@ public:
 		{
 			quint32 x = (quint32)qrand();
 
-			QVariantMap out;
-			out["websocket"] = true;
-			out["origins"] = QVariantList() << QString("*:*");
-			out["cookie_needed"] = false;
-			out["entropy"] = x;
-			respondOk(s->req, out);
+			HttpHeaders headers;
+			headers += HttpHeader("Content-Type", "text/plain");
+			respond(s->req, 200, "OK", headers, infoBodyPrefix + QByteArray::number(x) + infoBodySuffix);
 		}
 		else if(method == "GET" && s->path.startsWith("/iframe") && s->path.endsWith(".html"))
 		{
@@ -720,6 +735,11 @@ void SockJsManager::respondOk(ZhttpRequest *req, const QString &str, const QByte
 	d->respondOk(req, str, jsonpCallback);
 }
 
+void SockJsManager::respondOkEncoded(ZhttpRequest *req, const QByteArray &body)
+{
+	d->respondOkEncoded(req, body);
+}
+
 void SockJsManager::respondError(ZhttpRequest *req, int code, const QByteArray &reason, const QString &message, bool discard)
 {
 	d->respondError(req, code, reason, message, discard);
@@ -63,6 +63,11 @@ private:
 	void setLinger(SockJsSession *sess, const QVariant &closeValue);
 	void respondOk(ZhttpRequest *req, const QVariant &data, const QByteArray &prefix = QByteArray(), const QByteArray &jsonpCallback = QByteArray());
 	void respondOk(ZhttpRequest *req, const QString &str, const QByteArray &jsonpCallback = QByteArray());
+
+	// body is already sockjs-encoded, e.g. an "a" frame assembled
+	//   from pre-encoded message payloads. the trailing newline and
+	//   headers are applied as in respondOk
+	void respondOkEncoded(ZhttpRequest *req, const QByteArray &body);
 	void respondError(ZhttpRequest *req, int code, const QByteArray &reason, const QString &message, bool discard = false);
 	void respond(ZhttpRequest *req, int code, const QByteArray &reason, const HttpHeaders &headers, const QByteArray &body);
 };
@@ -29,6 +29,7 @@
 #include "sockjssession.h"
 
 #include <assert.h>
+#include <QCache>
 #include <QPointer>
 #include <QTimer>
 #include <QUrlQuery>
@@ -41,11 +42,59 @@
 #include "zhttprequest.h"
 #include "zwebsocket.h"
 #include "sockjsmanager.h"
+#include "sockjsutil.h"
+#include "stablehash.h"
 
 #define BUFFER_SIZE 200000
 #define KEEPALIVE_TIMEOUT 25
 #define UNCONNECTED_TIMEOUT 5
 
+#define ENC_CACHE_MAX 1000
+#define ENC_CACHE_ITEM_MAX 65536
+
+namespace {
+
+// pre-encoded message payloads, shared process-wide. fan-out delivers
+//   the same payload to many sessions, so the json escape of a given
+//   message is usually computed once and reused
+class EncCacheEntry
+{
+public:
+	QByteArray raw;
+	QByteArray enc;
+};
+
+}
+
+static QCache<quint64, EncCacheEntry> g_encCache(ENC_CACHE_MAX);
+
+static QByteArray encodeMessage(const QByteArray &data)
+{
+	if(data.size() > ENC_CACHE_ITEM_MAX)
+		return SockJsUtil::serializeJsonString(QString::fromUtf8(data));
+
+	quint64 key = stableHash64(data);
+
+	EncCacheEntry *e = g_encCache.object(key);
+	if(e)
+	{
+		// same content required, not just same hash
+		if(e->raw == data)
+			return e->enc;
+
+		return SockJsUtil::serializeJsonString(QString::fromUtf8(data));
+	}
+
+	QByteArray enc = SockJsUtil::serializeJsonString(QString::fromUtf8(data));
+
+	e = new EncCacheEntry;
+	e->raw = data;
+	e->enc = enc;
+	g_encCache.insert(key, e);
+
+	return enc;
+}
+
 class SockJsSession::Private : public QObject
 {
 	Q_OBJECT
@@ -288,6 +337,11 @@ public:
 		manager->respondOk(req, str, jsonpCallback);
 	}
 
+	void respondOkEncoded(ZhttpRequest *req, const QByteArray &body)
+	{
+		manager->respondOkEncoded(req, body);
+	}
+
 	void respondError(ZhttpRequest *req, int code, const QByteArray &reason, const QString &message)
 	{
 		manager->respondError(req, code, reason, message);
@@ -504,11 +558,9 @@ public:
 			}
 			else // WebSocketFramed
 			{
-				QVariantList messages;
-				messages += QString::fromUtf8(frame.data);
-
-				QByteArray arrayJson = QJsonDocument(QJsonArray::fromVariantList(messages)).toJson(QJsonDocument::Compact);
-				Frame f(Frame::Text, "a" + arrayJson, false);
+				// same output as SockJsUtil::wrapTextMessage, but the
+				//   escaped payload is shared through the encode cache
+				Frame f(Frame::Text, "a[" + encodeMessage(frame.data) + ']', false);
 
 				pendingWrites += WriteItem(WriteItem::User, frame.data.size());
 				sock->writeFrame(f);
@@ -570,7 +622,7 @@ public:
 		if(ri->responded)
 			return;
 
-		QVariantList messages;
+		QList<QByteArray> msgs;
 
 		int frames = 0;
 		int bytes = 0;
@@ -602,16 +654,43 @@ public:
 			QByteArray data = bufs.toByteArray();
 
 			pendingWrites += WriteItem(WriteItem::User, data.size());
-			messages += QString::fromUtf8(data);
+			msgs += data;
 		}
 
 		ri->receiveFrames = frames;
 		ri->receiveBytes = bytes;
 
-		if(!messages.isEmpty())
+		if(!msgs.isEmpty())
 		{
 			ri->responded = true;
-			respondOk(req, messages, "a", ri->jsonpCallback);
+
+			if(ri->jsonpCallback.isEmpty())
+			{
+				// assemble the "a" frame from pre-encoded payloads,
+				//   skipping the per-response QJsonDocument round trip
+				QByteArray body = "a[";
+				for(int n = 0; n < msgs.count(); ++n)
+				{
+					if(n > 0)
+						body += ',';
+
+					body += encodeMessage(msgs[n]);
+				}
+				body += ']';
+
+				respondOkEncoded(req, body);
+			}
+			else
+			{
+				// jsonp re-escapes the whole body, so pre-encoded
+				//   payloads wouldn't be shareable here
+				QVariantList messages;
+				foreach(const QByteArray &data, msgs)
+					messages += QString::fromUtf8(data);
+
+				respondOk(req, messages, "a", ri->jsonpCallback);
+			}
+
 			keepAliveTimer->stop();
 		}
 		else if(state == Closing)
@@ -670,7 +749,7 @@ public:
 
 			if(emitReadyRead)
 			{
-				emit q->readyRead();
+				q->emitReadyRead();
 				if(!self)
 					return false;
 			}
@@ -785,7 +864,7 @@ public:
 
 			if(emitReadyRead)
 			{
-				emit q->readyRead();
+				q->emitReadyRead();
 				if(!self)
 					return false;
 			}
@@ -828,7 +907,7 @@ public:
 			pendingWrittenBytes = 0;
 		}
 
-		emit q->framesWritten(count, contentBytes);
+		q->emitFramesWritten(count, contentBytes);
 	}
 
 	QVariant applyLinger()
@@ -968,7 +1047,7 @@ private slots:
 		}
 		else // WebSocketPassthrough
 		{
-			emit q->readyRead();
+			q->emitReadyRead();
 		}
 	}
 
@@ -1017,7 +1096,7 @@ private slots:
 				pendingWrittenFrames = 0;
 				pendingWrittenBytes = 0;
 
-				emit q->framesWritten(count, contentBytes);
+				q->emitFramesWritten(count, contentBytes);
 			}
 		}
 	}
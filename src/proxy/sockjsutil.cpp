@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015-2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "sockjsutil.h"
+
+namespace SockJsUtil {
+
+static void appendSerialized(QByteArray *out, const QString &s)
+{
+	QByteArray in = s.toUtf8();
+
+	*out += '"';
+
+	for(int n = 0; n < in.size(); ++n)
+	{
+		char c = in[n];
+		switch(c)
+		{
+			case '"':  *out += "\\\""; break;
+			case '\\': *out += "\\\\"; break;
+			case '\b': *out += "\\b"; break;
+			case '\f': *out += "\\f"; break;
+			case '\n': *out += "\\n"; break;
+			case '\r': *out += "\\r"; break;
+			case '\t': *out += "\\t"; break;
+			default:
+				if((unsigned char)c < 0x20)
+				{
+					char buf[8];
+					qsnprintf(buf, sizeof(buf), "\\u%04x", (int)(unsigned char)c);
+					*out += buf;
+				}
+				else
+				{
+					// valid utf-8 passes through unescaped, same as
+					//   QJsonDocument
+					*out += c;
+				}
+				break;
+		}
+	}
+
+	*out += '"';
+}
+
+QByteArray serializeJsonString(const QString &s)
+{
+	QByteArray out;
+	out.reserve(s.size() + 16);
+	appendSerialized(&out, s);
+	return out;
+}
+
+QByteArray wrapTextMessage(const QString &message)
+{
+	QByteArray out;
+	out.reserve(message.size() + 16);
+	out += "a[";
+	appendSerialized(&out, message);
+	out += ']';
+	return out;
+}
+
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "targettracker.h"
+
+#include <assert.h>
+#include <QDateTime>
+#include <QHash>
+#include "log.h"
+
+#define EJECT_FAILURES 3
+#define BACKOFF_INITIAL 1000
+#define BACKOFF_MAX 64000
+
+class TargetTracker::Private
+{
+public:
+	class TargetState
+	{
+	public:
+		int outstanding;
+		int failures; // consecutive
+		int backoff; // msecs, current probe interval
+		qint64 probeTime; // when ejected, when the next probe is due
+
+		TargetState() :
+			outstanding(0),
+			failures(0),
+			backoff(0),
+			probeTime(-1)
+		{
+		}
+
+		bool isEmpty() const
+		{
+			return (outstanding == 0 && failures == 0);
+		}
+	};
+
+	QHash<QString, TargetState> targets;
+
+	// drop the entry once it carries no state, so the table stays
+	//   bounded by targets recently in use
+	void removeIfEmpty(const QString &target)
+	{
+		QHash<QString, TargetState>::iterator it = targets.find(target);
+		if(it != targets.end() && it.value().isEmpty())
+			targets.erase(it);
+	}
+};
+
+TargetTracker::TargetTracker()
+{
+	d = new Private;
+}
+
+TargetTracker::~TargetTracker()
+{
+	delete d;
+}
+
+int TargetTracker::outstanding(const QString &target) const
+{
+	return d->targets.value(target).outstanding;
+}
+
+bool TargetTracker::checkAvailable(const QString &target)
+{
+	QHash<QString, Private::TargetState>::iterator it = d->targets.find(target);
+	if(it == d->targets.end())
+		return true;
+
+	Private::TargetState &s = it.value();
+	if(s.failures < EJECT_FAILURES)
+		return true;
+
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+	if(now < s.probeTime)
+		return false;
+
+	// grant a probe, and don't grant another until the interval
+	//   passes again
+	s.probeTime = now + s.backoff;
+	return true;
+}
+
+void TargetTracker::addOutstanding(const QString &target)
+{
+	++d->targets[target].outstanding;
+}
+
+void TargetTracker::removeOutstanding(const QString &target)
+{
+	QHash<QString, Private::TargetState>::iterator it = d->targets.find(target);
+	assert(it != d->targets.end() && it.value().outstanding > 0);
+
+	--it.value().outstanding;
+	d->removeIfEmpty(target);
+}
+
+void TargetTracker::recordFailure(const QString &target)
+{
+	Private::TargetState &s = d->targets[target];
+
+	++s.failures;
+
+	if(s.failures >= EJECT_FAILURES)
+	{
+		s.backoff = (s.backoff > 0 ? qMin(s.backoff * 2, BACKOFF_MAX) : BACKOFF_INITIAL);
+		s.probeTime = QDateTime::currentMSecsSinceEpoch() + s.backoff;
+
+		if(s.failures == EJECT_FAILURES)
+			log_warning("target %s ejected after %d failures", qPrintable(target), s.failures);
+	}
+}
+
+void TargetTracker::recordSuccess(const QString &target)
+{
+	QHash<QString, Private::TargetState>::iterator it = d->targets.find(target);
+	if(it == d->targets.end())
+		return;
+
+	Private::TargetState &s = it.value();
+
+	if(s.failures >= EJECT_FAILURES)
+		log_info("target %s reinstated", qPrintable(target));
+
+	s.failures = 0;
+	s.backoff = 0;
+	s.probeTime = -1;
+	d->removeIfEmpty(target);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef TARGETTRACKER_H
+#define TARGETTRACKER_H
+
+#include <QString>
+
+// live per-target state shared by proxy sessions: in-flight request
+//   counts for least-loaded selection, and failure tracking with
+//   exponential probe-based reinstatement of ejected targets
+class TargetTracker
+{
+public:
+	TargetTracker();
+	~TargetTracker();
+
+	// number of in-flight requests to the target
+	int outstanding(const QString &target) const;
+
+	// false if the target is ejected and not yet due a probe. when a
+	//   probe is granted, the next one isn't due until the current
+	//   backoff interval passes again
+	bool checkAvailable(const QString &target);
+
+	void addOutstanding(const QString &target);
+	void removeOutstanding(const QString &target);
+
+	// a connect-level failure. repeated failures eject the target
+	void recordFailure(const QString &target);
+
+	// clears failure state and reinstates the target
+	void recordSuccess(const QString &target);
+
+private:
+	class Private;
+	Private *d;
+};
+
+#endif
@@ -30,6 +30,7 @@
 
 #include <assert.h>
 #include <QUrlQuery>
+#include <QTimer>
 #include "log.h"
 #include "bufferlist.h"
 #include "packet/httprequestdata.h"
@@ -59,16 +60,44 @@ public:
 	bool requestBodyFinished;
 	BufferList responseBody;
 	ErrorCondition errorCondition;
+	int delay;
+	int delayJitter;
+	int bodySize;
+	int gripRate;
 
 	Private(TestHttpRequest *_q) :
 		QObject(_q),
 		q(_q),
 		state(Idle),
 		requestBodyFinished(false),
-		errorCondition(ErrorGeneric)
+		errorCondition(ErrorGeneric),
+		delay(0),
+		delayJitter(0),
+		bodySize(-1),
+		gripRate(100)
 	{
 	}
 
+	void scheduleProcess()
+	{
+		int ms = delay;
+		if(delayJitter > 0)
+			ms += qrand() % (delayJitter + 1);
+
+		if(ms > 0)
+			QTimer::singleShot(ms, this, SLOT(processRequest()));
+		else
+			QMetaObject::invokeMethod(this, "processRequest", Qt::QueuedConnection);
+	}
+
+	QByteArray makeBody(const QByteArray &canned) const
+	{
+		if(bodySize < 0)
+			return canned;
+
+		return QByteArray(bodySize, 'a');
+	}
+
 public slots:
 	void processRequest()
 	{
@@ -80,7 +109,7 @@ public slots:
 			responseBody += QByteArray("request too large\n");
 
 			state = Responded;
-			emit q->readyRead();
+			q->emitReadyRead();
 			return;
 		}
 
@@ -103,30 +132,42 @@ public slots:
 		if(channels.isEmpty())
 			channels += "test";
 
+		// hold requests can be configured to only get grip headers some
+		//   of the time, to mix plain responses into a benchmark run
+		bool grip = (gripRate >= 100 || (gripRate > 0 && (qrand() % 100) < gripRate));
+
 		if(path == "/")
 		{
 			response.code = 200;
 			response.reason = StatusReasons::getReason(response.code);
 			response.headers += HttpHeader("Content-Type", "text/plain");
-			responseBody += QByteArray("Hello from the Pushpin test handler!\n");
+			responseBody += makeBody("Hello from the Pushpin test handler!\n");
 		}
 		else if(path == "/response")
 		{
 			response.code = 200;
 			response.reason = StatusReasons::getReason(response.code);
 			response.headers += HttpHeader("Content-Type", "text/plain");
-			response.headers += HttpHeader("Grip-Hold", "response");
-			response.headers += HttpHeader("Grip-Channel", QStringList(channels.toList()).join(", ").toUtf8());
-			responseBody += QByteArray("nothing for now\n");
+			if(grip)
+			{
+				response.headers += HttpHeader("Grip-Hold", "response");
+				response.headers += HttpHeader("Grip-Channel", QStringList(channels.toList()).join(", ").toUtf8());
+			}
+			responseBody += makeBody("nothing for now\n");
 		}
 		else if(path == "/stream")
 		{
 			response.code = 200;
 			response.reason = StatusReasons::getReason(response.code);
 			response.headers += HttpHeader("Content-Type", "text/plain");
-			response.headers += HttpHeader("Grip-Hold", "stream");
-			response.headers += HttpHeader("Grip-Channel", QStringList(channels.toList()).join(", ").toUtf8());
-			responseBody += QByteArray("[stream opened]\n");
+			if(grip)
+			{
+				response.headers += HttpHeader("Grip-Hold", "stream");
+				response.headers += HttpHeader("Grip-Channel", QStringList(channels.toList()).join(", ").toUtf8());
+				responseBody += QByteArray("[stream opened]\n");
+			}
+			else
+				responseBody += makeBody("[stream opened]\n");
 		}
 		else
 		{
@@ -137,7 +178,14 @@ public slots:
 		}
 
 		state = Responded;
-		emit q->readyRead();
+		q->emitReadyRead();
+	}
+
+	// deferred write acks go through the base class helper so the
+	//   listener fast path applies
+	void doBytesWritten(int count)
+	{
+		q->emitBytesWritten(count);
 	}
 };
 
@@ -152,6 +200,22 @@ TestHttpRequest::~TestHttpRequest()
 	delete d;
 }
 
+void TestHttpRequest::setResponseDelay(int msec, int jitterMsec)
+{
+	d->delay = msec;
+	d->delayJitter = jitterMsec;
+}
+
+void TestHttpRequest::setBodySize(int size)
+{
+	d->bodySize = size;
+}
+
+void TestHttpRequest::setGripRate(int percent)
+{
+	d->gripRate = percent;
+}
+
 QHostAddress TestHttpRequest::peerAddress() const
 {
 	// this class is client only
@@ -211,7 +275,7 @@ void TestHttpRequest::writeBody(const QByteArray &body)
 		if(d->requestBody.size() + body.size() > MAX_REQUEST_SIZE)
 		{
 			d->state = Private::Responding;
-			QMetaObject::invokeMethod(d, "processRequest", Qt::QueuedConnection);
+			d->scheduleProcess();
 			return;
 		}
 
@@ -221,7 +285,7 @@ void TestHttpRequest::writeBody(const QByteArray &body)
 		{
 			d->requestBody += buf;
 
-			QMetaObject::invokeMethod(this, "bytesWritten", Qt::QueuedConnection, Q_ARG(int, buf.size()));
+			QMetaObject::invokeMethod(d, "doBytesWritten", Qt::QueuedConnection, Q_ARG(int, buf.size()));
 		}
 	}
 }
@@ -233,7 +297,7 @@ void TestHttpRequest::endBody()
 		d->requestBodyFinished = true;
 
 		d->state = Private::Responding;
-		QMetaObject::invokeMethod(d, "processRequest", Qt::QueuedConnection);
+		d->scheduleProcess();
 	}
 }
 
@@ -42,6 +42,11 @@ public:
 	TestHttpRequest(QObject *parent = 0);
 	~TestHttpRequest();
 
+	// synthetic origin tuning, set before the request body completes
+	void setResponseDelay(int msec, int jitterMsec);
+	void setBodySize(int size);
+	void setGripRate(int percent);
+
 	// reimplemented
 
 	virtual QHostAddress peerAddress() const;
@@ -30,6 +30,7 @@
 
 #include <assert.h>
 #include <QUrlQuery>
+#include <QTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include "packet/httprequestdata.h"
@@ -60,6 +61,9 @@ public:
 	int peerCloseCode;
 	QString peerCloseReason;
 	ErrorCondition errorCondition;
+	int connectDelay;
+	int connectDelayJitter;
+	int echoRate;
 
 	Private(TestWebSocket *_q) :
 		QObject(_q),
@@ -67,10 +71,25 @@ public:
 		state(Idle),
 		gripEnabled(false),
 		peerCloseCode(-1),
-		errorCondition(ErrorGeneric)
+		errorCondition(ErrorGeneric),
+		connectDelay(0),
+		connectDelayJitter(0),
+		echoRate(100)
 	{
 	}
 
+	void scheduleConnect()
+	{
+		int ms = connectDelay;
+		if(connectDelayJitter > 0)
+			ms += qrand() % (connectDelayJitter + 1);
+
+		if(ms > 0)
+			QTimer::singleShot(ms, this, SLOT(handleConnect()));
+		else
+			QMetaObject::invokeMethod(this, "handleConnect", Qt::QueuedConnection);
+	}
+
 public slots:
 	void handleConnect()
 	{
@@ -123,7 +142,7 @@ public slots:
 			emit q->connected();
 
 			if(gripEnabled && !channels.isEmpty())
-				QMetaObject::invokeMethod(q, "readyRead", Qt::QueuedConnection);
+				QMetaObject::invokeMethod(this, "doReadyRead", Qt::QueuedConnection);
 		}
 		else
 		{
@@ -142,6 +161,18 @@ public slots:
 		state = Idle;
 		emit q->closed();
 	}
+
+	// deferred data events go through the base class helpers so the
+	//   listener fast path applies
+	void doReadyRead()
+	{
+		q->emitReadyRead();
+	}
+
+	void doFramesWritten(int count, int contentBytes)
+	{
+		q->emitFramesWritten(count, contentBytes);
+	}
 };
 
 TestWebSocket::TestWebSocket(QObject *parent) :
@@ -155,6 +186,17 @@ TestWebSocket::~TestWebSocket()
 	delete d;
 }
 
+void TestWebSocket::setConnectDelay(int msec, int jitterMsec)
+{
+	d->connectDelay = msec;
+	d->connectDelayJitter = jitterMsec;
+}
+
+void TestWebSocket::setEchoRate(int percent)
+{
+	d->echoRate = percent;
+}
+
 QHostAddress TestWebSocket::peerAddress() const
 {
 	// this class is client only
@@ -193,7 +235,7 @@ void TestWebSocket::start(const QUrl &uri, const HttpHeaders &headers)
 
 	d->state = Private::Connecting;
 
-	QMetaObject::invokeMethod(d, "handleConnect", Qt::QueuedConnection);
+	d->scheduleConnect();
 }
 
 void TestWebSocket::respondSuccess(const QByteArray &reason, const HttpHeaders &headers)
@@ -301,6 +343,18 @@ void TestWebSocket::writeFrame(const Frame &frame)
 {
 	Frame tmp = frame;
 
+	if(d->echoRate < 100 && (frame.type == Frame::Text || frame.type == Frame::Binary) && !frame.more)
+	{
+		// probabilistically skip echoing, to simulate origins that
+		//   consume more than they produce. only complete single-frame
+		//   messages are skipped, so fragmented messages stay intact
+		if(d->echoRate <= 0 || (qrand() % 100) >= d->echoRate)
+		{
+			QMetaObject::invokeMethod(d, "doFramesWritten", Qt::QueuedConnection, Q_ARG(int, 1), Q_ARG(int, tmp.data.size()));
+			return;
+		}
+	}
+
 	if(d->gripEnabled && (frame.type == Frame::Text || frame.type == Frame::Binary))
 	{
 		tmp.data = "m:" + tmp.data;
@@ -308,8 +362,8 @@ void TestWebSocket::writeFrame(const Frame &frame)
 
 	d->inFrames += tmp;
 
-	QMetaObject::invokeMethod(this, "framesWritten", Qt::QueuedConnection, Q_ARG(int, 1), Q_ARG(int, tmp.data.size()));
-	QMetaObject::invokeMethod(this, "readyRead", Qt::QueuedConnection);
+	QMetaObject::invokeMethod(d, "doFramesWritten", Qt::QueuedConnection, Q_ARG(int, 1), Q_ARG(int, tmp.data.size()));
+	QMetaObject::invokeMethod(d, "doReadyRead", Qt::QueuedConnection);
 }
 
 WebSocket::Frame TestWebSocket::readFrame()
@@ -41,6 +41,10 @@ public:
 	TestWebSocket(QObject *parent = 0);
 	~TestWebSocket();
 
+	// synthetic origin tuning, set before start()
+	void setConnectDelay(int msec, int jitterMsec);
+	void setEchoRate(int percent);
+
 	// reimplemented
 
 	virtual QHostAddress peerAddress() const;
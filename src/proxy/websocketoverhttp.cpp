@@ -109,6 +109,14 @@ private slots:
 
 WebSocketOverHttp::DisconnectManager *WebSocketOverHttp::g_disconnectManager = 0;
 
+// when a batch delay is set, frames written while no request is in
+//   flight are held for up to that long, or until the event/byte
+//   thresholds are reached, so that bursts of client activity coalesce
+//   into fewer, larger requests to the origin
+static int g_maxBatchEvents = 64;
+static int g_maxBatchBytes = 65536;
+static int g_maxBatchDelay = 0; // msecs. 0 means send immediately
+
 static QList<WsEvent> decodeEvents(const QByteArray &in, bool *ok = 0)
 {
 	QList<WsEvent> out;
@@ -191,6 +199,8 @@ public:
 	ErrorCondition pendingErrorCondition;
 	int keepAliveInterval;
 	HttpHeaders meta;
+	HttpHeaders cachedReqHeaders;
+	bool reqHeadersInvalid;
 	bool updating;
 	ZhttpRequest *req;
 	QByteArray reqBody;
@@ -212,6 +222,7 @@ public:
 	bool updateQueued;
 	QTimer *keepAliveTimer;
 	QTimer *retryTimer;
+	QTimer *batchTimer;
 	int retries;
 
 	Private(WebSocketOverHttp *_q) :
@@ -225,6 +236,7 @@ public:
 		errorCondition(ErrorGeneric),
 		pendingErrorCondition((ErrorCondition)-1),
 		keepAliveInterval(-1),
+		reqHeadersInvalid(true),
 		updating(false),
 		req(0),
 		reqPendingBytes(0),
@@ -250,6 +262,10 @@ public:
 		retryTimer = new QTimer(this);
 		connect(retryTimer, &QTimer::timeout, this, &Private::retryTimer_timeout);
 		retryTimer->setSingleShot(true);
+
+		batchTimer = new QTimer(this);
+		connect(batchTimer, &QTimer::timeout, this, &Private::batchTimer_timeout);
+		batchTimer->setSingleShot(true);
 	}
 
 	~Private()
@@ -261,12 +277,17 @@ public:
 		retryTimer->disconnect(this);
 		retryTimer->setParent(0);
 		retryTimer->deleteLater();
+
+		batchTimer->disconnect(this);
+		batchTimer->setParent(0);
+		batchTimer->deleteLater();
 	}
 
 	void cleanup()
 	{
 		keepAliveTimer->stop();
 		retryTimer->stop();
+		batchTimer->stop();
 
 		updating = false;
 		disconnecting = false;
@@ -318,8 +339,20 @@ public:
 
 		outFrames += frame;
 
-		if(needUpdate())
-			update();
+		if(!needUpdate())
+			return;
+
+		// when batching, hold the frame briefly in case more follow,
+		//   unless the batch is already large enough to be worth sending
+		if(g_maxBatchDelay > 0 && !updating && !batchFull())
+		{
+			if(!batchTimer->isActive())
+				batchTimer->start(g_maxBatchDelay);
+
+			return;
+		}
+
+		update();
 	}
 
 	Frame readFrame()
@@ -385,6 +418,20 @@ private:
 		return true;
 	}
 
+	bool batchFull() const
+	{
+		int messages = 0;
+		int bytes = 0;
+		foreach(const Frame &f, outFrames)
+		{
+			bytes += f.data.size();
+			if(!f.more)
+				++messages;
+		}
+
+		return (messages >= g_maxBatchEvents || bytes >= g_maxBatchBytes);
+	}
+
 	bool canSendCompleteMessage() const
 	{
 		foreach(const Frame &f, outFrames)
@@ -445,6 +492,7 @@ private:
 		updating = true;
 
 		keepAliveTimer->stop();
+		batchTimer->stop();
 
 		// if we can't send yet but also have no room for writes, then fail
 		if(!canSendCompleteMessage() && writeBytesAvailable() == 0)
@@ -579,15 +627,25 @@ private:
 		req->setIgnoreTlsErrors(ignoreTlsErrors);
 		req->setSendBodyAfterAcknowledgement(true);
 
-		HttpHeaders headers = requestData.headers;
+		if(reqHeadersInvalid)
+		{
+			// aside from the content length, the header set is the same
+			//   on every poll cycle. rebuild it only when the
+			//   handed-down headers or the meta set actually change
+			cachedReqHeaders = requestData.headers;
 
-		headers += HttpHeader("Accept", "application/websocket-events");
-		headers += HttpHeader("Connection-Id", cid);
-		headers += HttpHeader("Content-Type", "application/websocket-events");
-		headers += HttpHeader("Content-Length", QByteArray::number(reqBody.size()));
+			cachedReqHeaders += HttpHeader("Accept", "application/websocket-events");
+			cachedReqHeaders += HttpHeader("Connection-Id", cid);
+			cachedReqHeaders += HttpHeader("Content-Type", "application/websocket-events");
+
+			foreach(const HttpHeader &h, meta)
+				cachedReqHeaders += HttpHeader("Meta-" + h.first, h.second);
 
-		foreach(const HttpHeader &h, meta)
-			headers += HttpHeader("Meta-" + h.first, h.second);
+			reqHeadersInvalid = false;
+		}
+
+		HttpHeaders headers = cachedReqHeaders;
+		headers += HttpHeader("Content-Length", QByteArray::number(reqBody.size()));
 
 		reqPendingBytes = reqBody.size();
 
@@ -674,6 +732,8 @@ private slots:
 					meta.removeAll(name);
 				if(!h.second.isEmpty())
 					meta += HttpHeader(name, h.second);
+
+				reqHeadersInvalid = true;
 			}
 		}
 
@@ -800,14 +860,14 @@ private slots:
 
 		if(emitReadyRead)
 		{
-			emit q->readyRead();
+			q->emitReadyRead();
 			if(!self)
 				return;
 		}
 
 		if(reqFrames > 0)
 		{
-			emit q->framesWritten(reqFrames, reqContentSize);
+			q->emitFramesWritten(reqFrames, reqContentSize);
 			if(!self)
 				return;
 		}
@@ -934,6 +994,12 @@ private slots:
 		doRequest();
 	}
 
+	void batchTimer_timeout()
+	{
+		if(needUpdate())
+			update();
+	}
+
 	void doError()
 	{
 		cleanup();
@@ -988,6 +1054,13 @@ void WebSocketOverHttp::clearDisconnectManager()
 	g_disconnectManager = 0;
 }
 
+void WebSocketOverHttp::setEventBatchParams(int maxEvents, int maxBytes, int maxDelay)
+{
+	g_maxBatchEvents = maxEvents;
+	g_maxBatchBytes = maxBytes;
+	g_maxBatchDelay = maxDelay;
+}
+
 void WebSocketOverHttp::sendDisconnect()
 {
 	d->sendDisconnect();
@@ -1138,9 +1211,17 @@ void WebSocketOverHttp::close(int code, const QString &reason)
 
 void WebSocketOverHttp::setHeaders(const HttpHeaders &headers)
 {
+	HttpHeaders prev = d->requestData.headers;
+
 	d->requestData.headers = headers;
 
 	d->sanitizeRequestHeaders();
+
+	// the proxy hands down the same headers on almost every cycle (the
+	//   signature only rotates periodically), so keep the cached
+	//   request header set unless something actually changed
+	if(d->requestData.headers != prev)
+		d->reqHeadersInvalid = true;
 }
 
 #include "websocketoverhttp.moc"
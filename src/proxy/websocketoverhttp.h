@@ -46,6 +46,12 @@ public:
 
 	static void clearDisconnectManager();
 
+	// coalesce outgoing events written in bursts: wait up to maxDelay
+	//   msecs for more events before making a request, flushing early
+	//   once maxEvents or maxBytes are pending. a delay of 0 disables
+	//   batching. applies to all instances
+	static void setEventBatchParams(int maxEvents, int maxBytes, int maxDelay);
+
 	// reimplemented
 
 	virtual QHostAddress peerAddress() const;
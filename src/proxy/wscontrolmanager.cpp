@@ -30,7 +30,7 @@
 
 #include <assert.h>
 #include <QPointer>
-#include <QDateTime>
+#include <QSet>
 #include <QTimer>
 #include "qzmqsocket.h"
 #include "qzmqvalve.h"
@@ -38,16 +38,13 @@
 #include "tnetstring.h"
 #include "zutil.h"
 #include "logutil.h"
+#include "uuidutil.h"
 #include "wscontrolsession.h"
 
 #define DEFAULT_HWM 101000
 
-#define REFRESH_INTERVAL 1000
 #define SESSION_EXPIRE 60000
-
-#define SESSION_SHOULD_PROCESS (SESSION_EXPIRE * 3 / 4)
-#define SESSION_MUST_PROCESS (SESSION_EXPIRE * 4 / 5)
-#define SESSION_REFRESH_BUCKETS (SESSION_SHOULD_PROCESS / REFRESH_INTERVAL)
+#define KEEPALIVE_INTERVAL (SESSION_EXPIRE / 3)
 
 #define PACKET_ITEMS_MAX 128
 
@@ -56,15 +53,8 @@ class WsControlManager::Private : public QObject
 	Q_OBJECT
 
 public:
-	class KeepAliveRegistration
-	{
-	public:
-		WsControlSession *s;
-		qint64 lastRefresh;
-		int refreshBucket;
-	};
-
 	WsControlManager *q;
+	QByteArray instanceId;
 	int ipcFileMode;
 	QString inSpec;
 	QString outSpec;
@@ -72,29 +62,39 @@ public:
 	QZmq::Socket *outSock;
 	QZmq::Valve *inValve;
 	QHash<QByteArray, WsControlSession*> sessionsByCid;
+	QList<WsControlPacket::Item> pendingItems;
+	QTimer *flushTimer;
 	QTimer *refreshTimer;
-	QHash<WsControlSession*, KeepAliveRegistration*> keepAliveRegistrations;
-	QMap<QPair<qint64, KeepAliveRegistration*>, KeepAliveRegistration*> sessionsByLastRefresh;
-	QSet<KeepAliveRegistration*> sessionRefreshBuckets[SESSION_REFRESH_BUCKETS];
-	int currentSessionRefreshBucket;
+	QSet<WsControlSession*> keepAliveSessions;
 
 	Private(WsControlManager *_q) :
 		QObject(_q),
 		q(_q),
+		instanceId(UuidUtil::createUuid()),
 		ipcFileMode(-1),
 		inSock(0),
 		outSock(0),
-		inValve(0),
-		currentSessionRefreshBucket(0)
+		inValve(0)
 	{
+		flushTimer = new QTimer(this);
+		flushTimer->setSingleShot(true);
+		connect(flushTimer, &QTimer::timeout, this, &Private::flush_timeout);
+
 		refreshTimer = new QTimer(this);
 		connect(refreshTimer, &QTimer::timeout, this, &Private::refresh_timeout);
 	}
 
 	~Private()
 	{
+		if(outSock)
+			flushPendingItems();
+
 		assert(sessionsByCid.isEmpty());
-		assert(keepAliveRegistrations.isEmpty());
+		assert(keepAliveSessions.isEmpty());
+
+		flushTimer->disconnect(this);
+		flushTimer->setParent(0);
+		flushTimer->deleteLater();
 
 		refreshTimer->disconnect(this);
 		refreshTimer->setParent(0);
@@ -143,27 +143,14 @@ public:
 		return true;
 	}
 
-	int smallestSessionRefreshBucket()
-	{
-		int best = -1;
-		int bestSize;
-		for(int n = 0; n < SESSION_REFRESH_BUCKETS; ++n)
-		{
-			if(best == -1 || sessionRefreshBuckets[n].count() < bestSize)
-			{
-				best = n;
-				bestSize = sessionRefreshBuckets[n].count();
-			}
-		}
-
-		return best;
-	}
-
 	void write(const WsControlPacket &packet)
 	{
 		assert(outSock);
 
-		QVariant vpacket = packet.toVariant();
+		WsControlPacket p = packet;
+		p.from = instanceId;
+
+		QVariant vpacket = p.toVariant();
 		QByteArray buf = TnetString::fromVariant(vpacket);
 
 		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
@@ -174,57 +161,84 @@ public:
 
 	void write(const WsControlPacket::Item &item)
 	{
-		WsControlPacket out;
-		out.items += item;
-		write(out);
+		// aggregate items generated within the same turn, so session
+		//   events across many connections coalesce into a few large
+		//   packets instead of one packet per event
+		pendingItems += item;
+
+		if(pendingItems.count() >= PACKET_ITEMS_MAX)
+			flushPendingItems();
+		else if(!flushTimer->isActive())
+			flushTimer->start(0);
 	}
 
-	void registerKeepAlive(WsControlSession *s)
+	void flushPendingItems()
 	{
-		if(keepAliveRegistrations.contains(s))
-			return;
+		while(!pendingItems.isEmpty())
+		{
+			WsControlPacket out;
+			if(pendingItems.count() > PACKET_ITEMS_MAX)
+			{
+				out.items = pendingItems.mid(0, PACKET_ITEMS_MAX);
+				pendingItems = pendingItems.mid(PACKET_ITEMS_MAX);
+			}
+			else
+			{
+				out.items = pendingItems;
+				pendingItems.clear();
+			}
 
-		qint64 now = QDateTime::currentMSecsSinceEpoch();
+			write(out);
+		}
 
-		KeepAliveRegistration *r = new KeepAliveRegistration;
-		r->s = s;
-		keepAliveRegistrations.insert(s, r);
+		flushTimer->stop();
+	}
 
-		r->lastRefresh = now;
-		sessionsByLastRefresh.insert(QPair<qint64, KeepAliveRegistration*>(r->lastRefresh, r), r);
+	void registerKeepAlive(WsControlSession *s)
+	{
+		if(keepAliveSessions.contains(s))
+			return;
 
-		r->refreshBucket = smallestSessionRefreshBucket();
-		sessionRefreshBuckets[r->refreshBucket] += r;
+		keepAliveSessions += s;
 
-		setupKeepAlive();
+		// every session shares the process-level connection to the
+		//   handler, so liveness is expressed per-peer rather than
+		//   per-session: one keep-alive item covers all registered
+		//   sessions, no matter how many there are
+		if(!refreshTimer->isActive())
+		{
+			sendKeepAlive();
+			refreshTimer->start(KEEPALIVE_INTERVAL);
+		}
 	}
 
 	void unregisterKeepAlive(WsControlSession *s)
 	{
-		KeepAliveRegistration *r = keepAliveRegistrations.value(s);
-		if(!r)
+		if(!keepAliveSessions.remove(s))
 			return;
 
-		sessionRefreshBuckets[r->refreshBucket].remove(r);
-		sessionsByLastRefresh.remove(QPair<qint64, KeepAliveRegistration*>(r->lastRefresh, r));
-		keepAliveRegistrations.remove(s);
-		delete r;
-
-		setupKeepAlive();
+		if(keepAliveSessions.isEmpty())
+			refreshTimer->stop();
 	}
 
-	void setupKeepAlive()
+	void sendKeepAlive()
 	{
-		if(!keepAliveRegistrations.isEmpty())
-		{
-			if(!refreshTimer->isActive())
-				refreshTimer->start(REFRESH_INTERVAL);
-		}
-		else
-			refreshTimer->stop();
+		WsControlPacket packet;
+
+		WsControlPacket::Item i;
+		i.type = WsControlPacket::Item::KeepAlive;
+		i.ttl = SESSION_EXPIRE / 1000;
+		packet.items += i;
+
+		write(packet);
 	}
 
 private slots:
+	void flush_timeout()
+	{
+		flushPendingItems();
+	}
+
 	void in_readyRead(const QList<QByteArray> &message)
 	{
 		if(message.count() != 1)
@@ -280,70 +294,7 @@ private slots:
 
 	void refresh_timeout()
 	{
-		qint64 now = QDateTime::currentMSecsSinceEpoch();
-
-		WsControlPacket packet;
-
-		// process the current bucket
-		const QSet<KeepAliveRegistration*> &bucket = sessionRefreshBuckets[currentSessionRefreshBucket];
-		foreach(KeepAliveRegistration *r, bucket)
-		{
-			// move to the end
-			QPair<qint64, KeepAliveRegistration*> k(r->lastRefresh, r);
-			sessionsByLastRefresh.remove(k);
-			r->lastRefresh = now;
-			sessionsByLastRefresh.insert(QPair<qint64, KeepAliveRegistration*>(r->lastRefresh, r), r);
-
-			WsControlPacket::Item i;
-			i.cid = r->s->cid();
-			i.type = WsControlPacket::Item::KeepAlive;
-			i.ttl = SESSION_EXPIRE / 1000;
-			packet.items += i;
-
-			// if we're at max, send out now
-			if(packet.items.count() >= PACKET_ITEMS_MAX)
-			{
-				write(packet);
-				packet.items.clear();
-			}
-		}
-
-		// process any others
-		qint64 threshold = now - SESSION_MUST_PROCESS;
-		while(!sessionsByLastRefresh.isEmpty())
-		{
-			QMap<QPair<qint64, KeepAliveRegistration*>, KeepAliveRegistration*>::iterator it = sessionsByLastRefresh.begin();
-			KeepAliveRegistration *r = it.value();
-
-			if(r->lastRefresh > threshold)
-				break;
-
-			// move to the end
-			sessionsByLastRefresh.erase(it);
-			r->lastRefresh = now;
-			sessionsByLastRefresh.insert(QPair<qint64, KeepAliveRegistration*>(r->lastRefresh, r), r);
-
-			WsControlPacket::Item i;
-			i.cid = r->s->cid();
-			i.type = WsControlPacket::Item::KeepAlive;
-			i.ttl = SESSION_EXPIRE / 1000;
-			packet.items += i;
-
-			// if we're at max, send out now
-			if(packet.items.count() >= PACKET_ITEMS_MAX)
-			{
-				write(packet);
-				packet.items.clear();
-			}
-		}
-
-		// send the rest
-		if(!packet.items.isEmpty())
-			write(packet);
-
-		++currentSessionRefreshBucket;
-		if(currentSessionRefreshBucket >= SESSION_REFRESH_BUCKETS)
-			currentSessionRefreshBucket = 0;
+		sendKeepAlive();
 	}
 };
 
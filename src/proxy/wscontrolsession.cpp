@@ -209,7 +209,7 @@ public:
 		else if(item.type == WsControlPacket::Item::KeepAliveSetup)
 		{
 			if(item.timeout > 0)
-				emit q->keepAliveSetupEventReceived(true, item.timeout);
+				emit q->keepAliveSetupEventReceived(true, item.timeout, item.contentType, item.message);
 			else
 				emit q->keepAliveSetupEventReceived(false);
 		}
@@ -55,7 +55,7 @@ public:
 
 signals:
 	void sendEventReceived(WebSocket::Frame::Type type, const QByteArray &message, bool queue);
-	void keepAliveSetupEventReceived(bool enable, int timeout = -1);
+	void keepAliveSetupEventReceived(bool enable, int timeout = -1, const QByteArray &contentType = QByteArray(), const QByteArray &message = QByteArray());
 	void closeEventReceived(int code); // -1 for no code
 	void detachEventReceived();
 	void cancelEventReceived();
@@ -220,7 +220,7 @@ static HttpExtension getExtension(const QList<QByteArray> &extStrings, const QBy
 	return e;
 }
 
-class WsProxySession::Private : public QObject
+class WsProxySession::Private : public QObject, public WebSocket::Listener
 {
 	Q_OBJECT
 
@@ -264,6 +264,8 @@ public:
 	WebSocket *outSock;
 	int inPendingBytes;
 	QList<bool> inPendingFrames; // true means we should ack a send event
+	WebSocket::Frame pendingInFrame; // partial message frame held for coalescing
+	bool pendingInFrameValid;
 	int outPendingBytes;
 	int outReadInProgress; // frame type or -1
 	QByteArray pathBeg;
@@ -278,6 +280,8 @@ public:
 	QDateTime activityTime;
 	QByteArray publicCid;
 	QTimer *keepAliveTimer;
+	QByteArray keepAliveContentType; // empty = no local template
+	QByteArray keepAliveMessage;
 	QList<QueuedFrame> queuedInFrames; // frames to deliver after out read finishes
 	LogUtil::Config logConfig;
 
@@ -300,6 +304,8 @@ public:
 		inSock(0),
 		outSock(0),
 		inPendingBytes(0),
+		pendingInFrame(WebSocket::Frame::Continuation, QByteArray(), false),
+		pendingInFrameValid(false),
 		outPendingBytes(0),
 		outReadInProgress(-1),
 		acceptGripMessages(false),
@@ -367,8 +373,9 @@ public:
 
 		inSock = sock;
 		inSock->setParent(this);
-		connect(inSock, &WebSocket::readyRead, this, &Private::in_readyRead);
-		connect(inSock, &WebSocket::framesWritten, this, &Private::in_framesWritten);
+
+		// per-frame events as direct calls; lifecycle stays on signals
+		inSock->setListener(this);
 		connect(inSock, &WebSocket::peerClosed, this, &Private::in_peerClosed);
 		connect(inSock, &WebSocket::closed, this, &Private::in_closed);
 		connect(inSock, &WebSocket::error, this, &Private::in_error);
@@ -446,12 +453,48 @@ public:
 
 	void writeInFrame(const WebSocket::Frame &frame, bool fromSendEvent = false)
 	{
+		if(pendingInFrameValid)
+		{
+			// fold a continuation of the same message into the held frame
+			if(!fromSendEvent && frame.type == WebSocket::Frame::Continuation && pendingInFrame.data.size() + frame.data.size() <= FRAME_SIZE_MAX)
+			{
+				pendingInFrame.data += frame.data;
+				pendingInFrame.more = frame.more;
+				return;
+			}
+
+			flushInFrames();
+		}
+
+		// hold a small partial content frame in case the rest of the
+		//   message arrives within the same turn. send events are never
+		//   held, so their write acks stay one-to-one
+		if(!fromSendEvent && frame.more && frame.data.size() < FRAME_SIZE_MAX && (frame.type == WebSocket::Frame::Text || frame.type == WebSocket::Frame::Binary || frame.type == WebSocket::Frame::Continuation))
+		{
+			pendingInFrame = frame;
+			pendingInFrameValid = true;
+			return;
+		}
+
 		inPendingBytes += frame.data.size();
 		inPendingFrames += fromSendEvent;
 
 		inSock->writeFrame(frame);
 	}
 
+	void flushInFrames()
+	{
+		if(!pendingInFrameValid)
+			return;
+
+		pendingInFrameValid = false;
+
+		inPendingBytes += pendingInFrame.data.size();
+		inPendingFrames += false;
+
+		inSock->writeFrame(pendingInFrame);
+	}
+
 	void tryNextTarget()
 	{
 		if(targets.isEmpty())
@@ -497,7 +540,10 @@ public:
 					uri.setPath(uri.path(QUrl::FullyEncoded).mid(pathRemove));
 			}
 
-			outSock = new TestWebSocket(this);
+			TestWebSocket *tsock = new TestWebSocket(this);
+			tsock->setConnectDelay(target.testDelay, target.testDelayJitter);
+			tsock->setEchoRate(target.testWsEcho);
+			outSock = tsock;
 		}
 		else
 		{
@@ -535,9 +581,9 @@ public:
 			}
 		}
 
+		// per-frame events as direct calls; lifecycle stays on signals
+		outSock->setListener(this);
 		connect(outSock, &WebSocket::connected, this, &Private::out_connected);
-		connect(outSock, &WebSocket::readyRead, this, &Private::out_readyRead);
-		connect(outSock, &WebSocket::framesWritten, this, &Private::out_framesWritten);
 		connect(outSock, &WebSocket::peerClosed, this, &Private::out_peerClosed);
 		connect(outSock, &WebSocket::closed, this, &Private::out_closed);
 		connect(outSock, &WebSocket::error, this, &Private::out_error);
@@ -677,6 +723,9 @@ public:
 					writeInFrame(i.first, i.second);
 			}
 		}
+
+		if(inSock)
+			flushInFrames();
 	}
 
 	void tryFinish()
@@ -740,6 +789,26 @@ public:
 			keepAliveTimer->start();
 	}
 
+	// WebSocket::Listener
+	//
+	// per-frame events from the client and target sockets arrive here
+	//   as direct calls, bypassing signal dispatch
+	virtual void socketReadyRead(WebSocket *sock)
+	{
+		if(sock == inSock)
+			in_readyRead();
+		else
+			out_readyRead();
+	}
+
+	virtual void socketFramesWritten(WebSocket *sock, int count, int contentBytes)
+	{
+		if(sock == inSock)
+			in_framesWritten(count, contentBytes);
+		else
+			out_framesWritten(count, contentBytes);
+	}
+
 private slots:
 	void in_readyRead()
 	{
@@ -1029,13 +1098,20 @@ private slots:
 			}
 		}
 
+		flushInFrames();
+
 		restartKeepAlive();
 	}
 
-	void wsControl_keepAliveSetupEventReceived(bool enable, int timeout)
+	void wsControl_keepAliveSetupEventReceived(bool enable, int timeout, const QByteArray &contentType, const QByteArray &message)
 	{
 		if(enable)
 		{
+			// if the handler provided the keep-alive content, write the
+			//   frames from here instead of asking for them every interval
+			keepAliveContentType = contentType;
+			keepAliveMessage = message;
+
 			if(!keepAliveTimer)
 			{
 				keepAliveTimer = new QTimer(this);
@@ -1048,6 +1124,9 @@ private slots:
 		}
 		else
 		{
+			keepAliveContentType.clear();
+			keepAliveMessage.clear();
+
 			cleanupKeepAliveTimer();
 		}
 	}
@@ -1094,7 +1173,68 @@ private slots:
 
 	void keepAliveTimer_timeout()
 	{
-		wsControl->sendNeedKeepAlive();
+		if(!keepAliveContentType.isEmpty())
+		{
+			// the handler installed the keep-alive content here, so the
+			//   frame can be written without a control round trip
+			writeLocalKeepAlive();
+
+			keepAliveTimer->start();
+		}
+		else
+		{
+			wsControl->sendNeedKeepAlive();
+		}
+	}
+
+	void writeLocalKeepAlive()
+	{
+		if(!inSock)
+			return;
+
+		// keep-alives are droppable. if the client can't take a write
+		//   right now, other frames are flowing anyway
+		if(!inSock->canWrite() || outReadInProgress != -1)
+			return;
+
+		WebSocket::Frame::Type type;
+		if(keepAliveContentType == "binary")
+			type = WebSocket::Frame::Binary;
+		else if(keepAliveContentType == "ping")
+			type = WebSocket::Frame::Ping;
+		else if(keepAliveContentType == "pong")
+			type = WebSocket::Frame::Pong;
+		else
+			type = WebSocket::Frame::Text;
+
+		// split into frames to avoid credits issue
+		if(keepAliveMessage.size() > 0)
+		{
+			for(int n = 0; n < keepAliveMessage.size(); n += FRAME_SIZE_MAX)
+			{
+				WebSocket::Frame::Type ftype;
+				if(n == 0)
+					ftype = type;
+				else
+					ftype = WebSocket::Frame::Continuation;
+
+				QByteArray data = keepAliveMessage.mid(n, FRAME_SIZE_MAX);
+				bool more = (n + FRAME_SIZE_MAX < keepAliveMessage.size());
+
+				writeInFrame(WebSocket::Frame(ftype, data, more));
+			}
+		}
+		else
+		{
+			writeInFrame(WebSocket::Frame(type, QByteArray(), false));
+		}
+
+		flushInFrames();
+
+		// the handler counts keep-alives it sends as activity. do the
+		//   same for the ones written from here
+		if(statsManager)
+			statsManager->addActivity(routeId);
 	}
 };
 
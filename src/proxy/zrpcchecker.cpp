@@ -31,10 +31,15 @@
 #include <assert.h>
 #include <QHash>
 #include <QTimer>
+#include <QElapsedTimer>
 #include "zrpcrequest.h"
 
 #define CHECK_TIMEOUT 8
 
+// recovery probe backoff while unavailable (msecs)
+#define PROBE_DELAY_MIN 1000
+#define PROBE_DELAY_MAX 16000
+
 class ZrpcChecker::Private : public QObject
 {
 	Q_OBJECT
@@ -62,12 +67,15 @@ public:
 	ZrpcChecker *q;
 	bool avail;
 	QTimer *timer;
+	QElapsedTimer lastProbe;
+	int probeDelay;
 	QHash<ZrpcRequest*, Item*> requestsByReq;
 
 	Private(ZrpcChecker *_q) :
 		QObject(_q),
 		q(_q),
-		avail(true)
+		avail(true),
+		probeDelay(PROBE_DELAY_MIN)
 	{
 		timer = new QTimer(this);
 		connect(timer, &QTimer::timeout, this, &Private::timer_timeout);
@@ -143,6 +151,32 @@ public:
 		}
 	}
 
+	void setUnavailable()
+	{
+		if(avail)
+		{
+			avail = false;
+
+			// allow an immediate first probe, backing off after that
+			probeDelay = PROBE_DELAY_MIN;
+			lastProbe.invalidate();
+		}
+	}
+
+	bool probeDue()
+	{
+		if(avail)
+			return false;
+
+		if(lastProbe.isValid() && lastProbe.elapsed() < probeDelay)
+			return false;
+
+		// claim this probe slot and back off the next one
+		lastProbe.start();
+		probeDelay = qMin(probeDelay * 2, PROBE_DELAY_MAX);
+		return true;
+	}
+
 	void handleSuccess()
 	{
 		avail = true;
@@ -164,7 +198,7 @@ public:
 		{
 			// stop clock and immediately indicate unavailability
 			timer->stop();
-			avail = false;
+			setUnavailable();
 		}
 	}
 
@@ -211,7 +245,7 @@ public slots:
 
 	void timer_timeout()
 	{
-		avail = false;
+		setUnavailable();
 	}
 };
 
@@ -233,7 +267,15 @@ bool ZrpcChecker::isInterfaceAvailable() const
 
 void ZrpcChecker::setInterfaceAvailable(bool available)
 {
-	d->avail = available;
+	if(available)
+		d->avail = true;
+	else
+		d->setUnavailable();
+}
+
+bool ZrpcChecker::probeDue()
+{
+	return d->probeDue();
 }
         
 void ZrpcChecker::watch(ZrpcRequest *req)
@@ -48,6 +48,12 @@ public:
 	bool isInterfaceAvailable() const;
 	void setInterfaceAvailable(bool available);
 
+	// when the interface is unavailable, returns true if it's time to
+	//   send a recovery probe. probes back off exponentially, so during
+	//   an outage most callers take the skip path in microseconds
+	//   instead of waiting out a timeout
+	bool probeDue();
+
 	void watch(ZrpcRequest *req);
 	void give(ZrpcRequest *req);
 
@@ -35,6 +35,10 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QSettings>
+#include <QProcess>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "processquit.h"
 #include "log.h"
 #include "mongrel2service.h"
@@ -44,6 +48,10 @@
 #include "pushpinhandlerservice.h"
 #include "config.h"
 
+#define READY_CHECK_INTERVAL 100
+#define READY_PROBE_TIMEOUT 100
+#define READY_TIMEOUT 10000
+
 static void trimlist(QStringList *list)
 {
 	for(int n = 0; n < list->count(); ++n)
@@ -65,6 +73,43 @@ static bool ensureDir(const QString &path)
 	return QDir().mkpath(dir.absolutePath());
 }
 
+// parse a core spec such as "2" or "0-3" into a list of core numbers.
+//   noncontiguous sets are expressed as multiple entries for the same
+//   service
+static bool parseCpuList(const QString &s, QList<int> *out)
+{
+	int first, last;
+	bool ok;
+
+	int at = s.indexOf('-');
+	if(at != -1)
+	{
+		first = s.mid(0, at).toInt(&ok);
+		if(!ok)
+			return false;
+
+		last = s.mid(at + 1).toInt(&ok);
+		if(!ok)
+			return false;
+	}
+	else
+	{
+		first = s.toInt(&ok);
+		if(!ok)
+			return false;
+
+		last = first;
+	}
+
+	if(first < 0 || last < first)
+		return false;
+
+	for(int n = first; n <= last; ++n)
+		*out += n;
+
+	return true;
+}
+
 static QPair<QHostAddress, int> parsePort(const QString &s)
 {
 	int at = s.indexOf(':');
@@ -200,17 +245,27 @@ public:
 	App *q;
 	ArgsData args;
 	QList<Service*> services;
+	QList<Service*> pendingStartServices; // waiting on the m2sh load
+	QProcess *m2shProc;
+	QList<Mongrel2Service::Interface> interfaces;
+	QTimer *readyCheckTimer;
+	QElapsedTimer startTime;
 	bool stopping;
 	bool errored;
 
 	Private(App *_q) :
 		QObject(_q),
 		q(_q),
+		m2shProc(0),
 		stopping(false),
 		errored(false)
 	{
 		connect(ProcessQuit::instance(), &ProcessQuit::quit, this, &Private::processQuit);
 		connect(ProcessQuit::instance(), &ProcessQuit::hup, this, &Private::reload);
+
+		readyCheckTimer = new QTimer(this);
+		connect(readyCheckTimer, &QTimer::timeout, this, &Private::readyCheck_timeout);
+		readyCheckTimer->setInterval(READY_CHECK_INTERVAL);
 	}
 
 	void start()
@@ -252,6 +307,8 @@ public:
 
 		log_info("starting...");
 
+		startTime.start();
+
 		QStringList configFileList;
 
 		if(!args.configFile.isEmpty())
@@ -338,6 +395,30 @@ public:
 		QStringList serviceNames = settings.value("runner/services").toStringList();
 		trimlist(&serviceNames);
 
+		QStringList cpuAffinityStrs = settings.value("runner/cpu_affinity").toStringList();
+		trimlist(&cpuAffinityStrs);
+
+		QHash<QString, QList<int> > cpuAffinity;
+		foreach(const QString &str, cpuAffinityStrs)
+		{
+			int at = str.indexOf(':');
+			QString name = (at != -1) ? str.mid(0, at) : QString();
+
+			QList<int> cores;
+			bool ok = (at != -1 && serviceNames.contains(name));
+			if(ok)
+				ok = parseCpuList(str.mid(at + 1), &cores);
+
+			if(!ok)
+			{
+				log_error("invalid cpu_affinity entry: %s", qPrintable(str));
+				emit q->quit(1);
+				return;
+			}
+
+			cpuAffinity[name] += cores;
+		}
+
 		QString httpPortStr = settings.value("runner/http_port").toString();
 
 		QStringList httpsPortStrs = settings.value("runner/https_ports").toStringList();
@@ -401,8 +482,6 @@ public:
 		int portOffset = 0;
 		QString filePrefix;
 
-		QList<Mongrel2Service::Interface> interfaces;
-
 		if(args.port.second > 0)
 		{
 			// if port specified then instantiate a single http server
@@ -462,14 +541,30 @@ public:
 				m2shBin = settings.value("runner/m2sh_bin").toString();
 
 			QString certsDir = QDir(configDir).filePath("certs");
-			if(!Mongrel2Service::generateConfigFile(m2shBin, QDir(libDir).filePath("mongrel2.conf.template"), runDir, logDir, ipcPrefix, filePrefix, certsDir, interfaces))
+			if(!Mongrel2Service::generateConfigFile(QDir(libDir).filePath("mongrel2.conf.template"), runDir, logDir, ipcPrefix, filePrefix, certsDir, interfaces))
 			{
 				emit q->quit(1);
 				return;
 			}
 
 			foreach(const Mongrel2Service::Interface &i, interfaces)
-				services += new Mongrel2Service(m2Bin, QDir(runDir).filePath(QString("%1mongrel2.sqlite").arg(filePrefix)), "default_" + QString::number(i.port), runDir, logDir, filePrefix, i.port, i.ssl, this);
+			{
+				Service *s = new Mongrel2Service(m2Bin, QDir(runDir).filePath(QString("%1mongrel2.sqlite").arg(filePrefix)), "default_" + QString::number(i.port), runDir, logDir, filePrefix, i.port, i.ssl, this);
+				s->setCpuAffinity(cpuAffinity.value("mongrel2"));
+				services += s;
+
+				// can't start until the config db is loaded
+				pendingStartServices += s;
+			}
+
+			// load the config db concurrently with the rest of startup,
+			//   instead of blocking everything on m2sh
+			QStringList m2shArgs = Mongrel2Service::m2shLoadArguments(m2shBin, runDir, filePrefix);
+
+			m2shProc = new QProcess(this);
+			connect(m2shProc, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished), this, &Private::m2sh_finished);
+			connect(m2shProc, static_cast<void(QProcess::*)(QProcess::ProcessError)>(&QProcess::error), this, &Private::m2sh_error);
+			m2shProc->start(m2shArgs[0], m2shArgs.mid(1));
 		}
 
 		if(serviceNames.contains("m2adapter"))
@@ -478,7 +573,9 @@ public:
 			foreach(const Mongrel2Service::Interface &i, interfaces)
 				ports += i.port;
 
-			services += new M2AdapterService(m2aBin, QDir(libDir).filePath("m2adapter.conf.template"), runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, logLevel >= 3, ports, this);
+			Service *s = new M2AdapterService(m2aBin, QDir(libDir).filePath("m2adapter.conf.template"), runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, logLevel >= 3, ports, this);
+			s->setCpuAffinity(cpuAffinity.value("m2adapter"));
+			services += s;
 		}
 
 		bool quietCheck = false;
@@ -489,17 +586,27 @@ public:
 			if(settings.contains("runner/zurl_bin"))
 				zurlBin = settings.value("runner/zurl_bin").toString();
 
-			services += new ZurlService(zurlBin, QDir(libDir).filePath("zurl.conf.template"), runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, logLevel >= 3, this);
+			Service *s = new ZurlService(zurlBin, QDir(libDir).filePath("zurl.conf.template"), runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, logLevel >= 3, this);
+			s->setCpuAffinity(cpuAffinity.value("zurl"));
+			services += s;
 
 			// when zurl is managed by pushpin, log updates checks as debug level
 			quietCheck = true;
 		}
 
 		if(serviceNames.contains("pushpin-proxy"))
-			services += new PushpinProxyService(proxyBin, configFile, runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, logLevel >= 3, args.routeLines, quietCheck, this);
+		{
+			Service *s = new PushpinProxyService(proxyBin, configFile, runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, logLevel >= 3, args.routeLines, quietCheck, this);
+			s->setCpuAffinity(cpuAffinity.value("pushpin-proxy"));
+			services += s;
+		}
 
 		if(serviceNames.contains("pushpin-handler"))
-			services += new PushpinHandlerService(handlerBin, configFile, runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, portOffset, logLevel >= 3, this);
+		{
+			Service *s = new PushpinHandlerService(handlerBin, configFile, runDir, !args.mergeOutput ? logDir : QString(), ipcPrefix, filePrefix, portOffset, logLevel >= 3, this);
+			s->setCpuAffinity(cpuAffinity.value("pushpin-handler"));
+			services += s;
+		}
 
 		foreach(Service *s, services)
 		{
@@ -508,6 +615,9 @@ public:
 			connect(s, &Service::logLine, this, &Private::service_logLine);
 			connect(s, &Service::error, this, &Private::service_error);
 
+			if(pendingStartServices.contains(s))
+				continue;
+
 			if(!args.mergeOutput || qobject_cast<Mongrel2Service*>(s))
 				log_info("starting %s", qPrintable(s->name()));
 
@@ -542,6 +652,25 @@ private:
 
 	void stopAll()
 	{
+		readyCheckTimer->stop();
+
+		if(m2shProc)
+		{
+			m2shProc->disconnect(this);
+			m2shProc->kill();
+			m2shProc->waitForFinished();
+			delete m2shProc;
+			m2shProc = 0;
+		}
+
+		foreach(Service *s, pendingStartServices)
+		{
+			services.removeAll(s);
+			delete s;
+		}
+
+		pendingStartServices.clear();
+
 		foreach(Service *s, services)
 		{
 			if(!args.mergeOutput || qobject_cast<Mongrel2Service*>(s))
@@ -549,6 +678,9 @@ private:
 
 			s->stop();
 		}
+
+		// services that never started won't emit stopped
+		checkStopped();
 	}
 
 	void checkStopped()
@@ -565,21 +697,99 @@ private:
 		emit q->quit(errored ? 1 : 0);
 	}
 
-private slots:
-	void service_started()
+	void checkAllStarted()
 	{
-		bool allStarted = true;
+		if(!pendingStartServices.isEmpty() || m2shProc)
+			return;
+
+		bool haveMongrel2 = false;
 		foreach(Service *s, services)
 		{
 			if(!s->isStarted())
+				return;
+
+			if(qobject_cast<Mongrel2Service*>(s))
+				haveMongrel2 = true;
+		}
+
+		if(haveMongrel2 && !interfaces.isEmpty())
+		{
+			// all processes are up, but don't claim started until
+			//   traffic can actually flow
+			readyCheckTimer->start();
+		}
+		else
+		{
+			log_info("started");
+		}
+	}
+
+private slots:
+	void service_started()
+	{
+		checkAllStarted();
+	}
+
+	void m2sh_finished(int exitCode, QProcess::ExitStatus exitStatus)
+	{
+		Q_UNUSED(exitStatus);
+
+		m2shProc->deleteLater();
+		m2shProc = 0;
+
+		if(exitCode != 0)
+		{
+			log_error("Failed to run m2sh");
+
+			errored = true;
+			stopping = true;
+			stopAll();
+			return;
+		}
+
+		QList<Service*> starting = pendingStartServices;
+		pendingStartServices.clear();
+
+		foreach(Service *s, starting)
+		{
+			log_info("starting %s", qPrintable(s->name()));
+			s->start();
+		}
+	}
+
+	void m2sh_error(QProcess::ProcessError error)
+	{
+		if(error == QProcess::FailedToStart)
+			m2sh_finished(-1, QProcess::NormalExit);
+	}
+
+	void readyCheck_timeout()
+	{
+		foreach(const Mongrel2Service::Interface &i, interfaces)
+		{
+			QHostAddress addr = i.addr;
+			if(addr.isNull() || addr == QHostAddress::Any || addr == QHostAddress::AnyIPv4)
+				addr = QHostAddress::LocalHost;
+
+			QTcpSocket probe;
+			probe.connectToHost(addr, i.port);
+			bool ok = probe.waitForConnected(READY_PROBE_TIMEOUT);
+			probe.abort();
+
+			if(!ok)
 			{
-				allStarted = false;
-				break;
+				if(startTime.elapsed() >= READY_TIMEOUT)
+				{
+					readyCheckTimer->stop();
+					log_warning("started, but could not confirm port %d accepting connections", i.port);
+				}
+
+				return;
 			}
 		}
 
-		if(allStarted)
-			log_info("started");
+		readyCheckTimer->stop();
+		log_info("started (ready in %d ms)", (int)startTime.elapsed());
 	}
 
 	void service_stopped()
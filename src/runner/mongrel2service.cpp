@@ -59,7 +59,7 @@ Mongrel2Service::Mongrel2Service(
 	setStandardOutputFile(QDir(logDir).filePath(filePrefix + "mongrel2_" + QString::number(port) + ".log"));
 }
 
-bool Mongrel2Service::generateConfigFile(const QString &m2shBinFile, const QString &configTemplateFile, const QString &runDir, const QString &logDir, const QString &ipcPrefix, const QString &filePrefix, const QString &certsDir, const QList<Interface> &interfaces)
+bool Mongrel2Service::generateConfigFile(const QString &configTemplateFile, const QString &runDir, const QString &logDir, const QString &ipcPrefix, const QString &filePrefix, const QString &certsDir, const QList<Interface> &interfaces)
 {
 	QVariantList vinterfaces;
 
@@ -87,19 +87,18 @@ bool Mongrel2Service::generateConfigFile(const QString &m2shBinFile, const QStri
 		return false;
 	}
 
+	return true;
+}
+
+QStringList Mongrel2Service::m2shLoadArguments(const QString &m2shBinFile, const QString &runDir, const QString &filePrefix)
+{
 	QStringList args;
+	args << m2shBinFile;
 	args << "load";
 	args << "-config" << QDir(runDir).filePath(filePrefix + "mongrel2.conf");
 	args << "-db" << QDir(runDir).filePath(filePrefix + "mongrel2.sqlite");
 
-	int ret = QProcess::execute(m2shBinFile, args);
-	if(ret != 0)
-	{
-		log_error("Failed to run m2sh");
-		return false;
-	}
-
-	return true;
+	return args;
 }
 
 QStringList Mongrel2Service::arguments() const
@@ -69,7 +69,12 @@ public:
 		bool ssl,
 		QObject *parent = 0);
 
-	static bool generateConfigFile(const QString &m2shBinFile, const QString &configTemplateFile, const QString &runDir, const QString &logDir, const QString &ipcPrefix, const QString &filePrefix, const QString &certsDir, const QList<Interface> &interfaces);
+	static bool generateConfigFile(const QString &configTemplateFile, const QString &runDir, const QString &logDir, const QString &ipcPrefix, const QString &filePrefix, const QString &certsDir, const QList<Interface> &interfaces);
+
+	// command line for loading the generated config into the database.
+	//   run by the caller, so it can happen concurrently with other
+	//   startup work
+	static QStringList m2shLoadArguments(const QString &m2shBinFile, const QString &runDir, const QString &filePrefix);
 
 	// reimplemented
 
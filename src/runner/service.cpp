@@ -34,6 +34,9 @@
 #include <QTimer>
 #include <QFile>
 #include <QProcess>
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#endif
 #include "log.h"
 
 #define STOP_TIMEOUT 4000
@@ -43,6 +46,8 @@ class ServiceProcess : public QProcess
 	Q_OBJECT
 
 public:
+	QList<int> cpuAffinity;
+
 	ServiceProcess(QObject *parent = 0) :
 		QProcess(parent)
 	{
@@ -58,6 +63,21 @@ public:
 		//   detach from process group to ensure ctrl-c in a shell
 		//   doesn't cause SIGINT to be sent directly to subprocesses
 		setpgid(0, 0);
+
+#ifdef Q_OS_LINUX
+		if(!cpuAffinity.isEmpty())
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			foreach(int core, cpuAffinity)
+				CPU_SET(core, &set);
+
+			// note: this runs between fork and exec, where logging
+			//   isn't safe. invalid cores are reported by the runner
+			//   at config parse time, so a failure here is ignored
+			sched_setaffinity(0, sizeof(set), &set);
+		}
+#endif
 	}
 };
 
@@ -80,6 +100,7 @@ public:
 	QString name;
 	QString outputFile;
 	QString pidFile;
+	QList<int> cpuAffinity;
 	QProcess *proc;
 	bool terminateAfterStarted;
 	bool sentKill;
@@ -143,7 +164,9 @@ public:
 
 	void start()
 	{
-		proc = new ServiceProcess(this);
+		ServiceProcess *sproc = new ServiceProcess(this);
+		sproc->cpuAffinity = cpuAffinity;
+		proc = sproc;
 
 		connect(proc, &QProcess::started, this, &Private::proc_started);
 		connect(proc, &QProcess::readyReadStandardOutput, this, &Private::proc_readyRead);
@@ -300,6 +323,11 @@ QString Service::name() const
 	return d->name;
 }
 
+void Service::setCpuAffinity(const QList<int> &cores)
+{
+	d->cpuAffinity = cores;
+}
+
 bool Service::acceptSighup() const
 {
 	return false;
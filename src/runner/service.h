@@ -42,6 +42,12 @@ public:
 
 	QString name() const;
 
+	// pin the subprocess to these cpu cores. applied in the child after
+	//   fork, so threads the subprocess creates (including zmq i/o
+	//   threads) inherit the mask and stay on the same cores/numa node
+	//   as their socket owners. linux only; ignored elsewhere
+	void setCpuAffinity(const QList<int> &cores);
+
 	virtual QStringList arguments() const = 0;
 	virtual bool acceptSighup() const;
 	virtual bool isStarted() const;
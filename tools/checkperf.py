@@ -0,0 +1,179 @@
+#!/usr/bin/env python
+#
+# Copyright (C) 2018 Fanout, Inc.
+#
+# This file is part of Pushpin.
+#
+# Pushpin is free software: you can redistribute it and/or modify it under
+# the terms of the GNU Affero General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or (at your option)
+# any later version.
+#
+# Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+# more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+# run the benchmark targets, write machine-readable results, and compare
+# against a committed per-host baseline. benchmark numbers are only
+# comparable on the same hardware, so baselines live in
+# perf-baselines/<hostname>.json next to this script. a metric that moves
+# past the threshold in the bad direction fails the run.
+#
+# typical workflow:
+#   make check-perf                          # compare against baseline
+#   python tools/checkperf.py --write-baseline   # accept current numbers
+
+import sys
+import os
+import re
+import json
+import time
+import socket
+import subprocess
+from optparse import OptionParser
+
+DEFAULT_THRESHOLD_PCT = 10
+
+def parse_enginebench(output):
+	metrics = {}
+	m = re.search(r'deliveries: \d+ in \d+ms \((\d+)/sec\)', output)
+	if m:
+		metrics['enginebench.deliveries-per-sec'] = (int(m.group(1)), 'higher')
+	m = re.search(r'p50=(\d+) p99=(\d+) p999=(\d+)', output)
+	if m:
+		metrics['enginebench.fanout-p50-msec'] = (int(m.group(1)), 'lower')
+		metrics['enginebench.fanout-p99-msec'] = (int(m.group(2)), 'lower')
+	return metrics
+
+def parse_packetbench(output):
+	metrics = {}
+	for m in re.finditer(r'^(\S+)\s+encode\s+(\d+) ns/op, decode\s+(\d+) ns/op', output, re.M):
+		metrics['packetbench.%s.encode-ns' % m.group(1)] = (int(m.group(2)), 'lower')
+		metrics['packetbench.%s.decode-ns' % m.group(1)] = (int(m.group(3)), 'lower')
+	return metrics
+
+def parse_enginesoak(output):
+	metrics = {}
+	m = re.search(r'final rss:\s+(\d+)kb \(baseline (\d+)kb\)', output)
+	if m:
+		metrics['enginesoak.rss-growth-kb'] = (int(m.group(1)) - int(m.group(2)), 'lower')
+	return metrics
+
+# (name, binary path relative to build dir, args, parser)
+BENCHES = [
+	('enginebench', 'src/handler/tests/enginebench/enginebench', ['1000', '100', '0'], parse_enginebench),
+	('packetbench', 'src/handler/tests/packetbench/packetbench', [], parse_packetbench),
+]
+
+SOAK_BENCHES = [
+	('enginesoak', 'src/handler/tests/enginesoak/enginesoak', ['500', '50', '100', '60'], parse_enginesoak),
+]
+
+def run_bench(build_dir, name, path, args):
+	binpath = os.path.join(build_dir, path)
+	if not os.access(binpath, os.X_OK):
+		print 'error: %s not found. build the tree first' % binpath
+		return None
+	print '[%s] running...' % name
+	p = subprocess.Popen([binpath] + args, stdout=subprocess.PIPE)
+	out = p.communicate()[0]
+	if p.returncode != 0:
+		print '[%s] exited with code %d' % (name, p.returncode)
+		return None
+	return out
+
+def compare(metrics, baseline, threshold_pct):
+	regressions = []
+	for name, (value, direction) in sorted(metrics.items()):
+		if name not in baseline:
+			print '%-40s %10d  (no baseline)' % (name, value)
+			continue
+		base = baseline[name]
+		if base != 0:
+			delta_pct = (value - base) * 100.0 / base
+		else:
+			delta_pct = 0.0
+		bad = (direction == 'higher' and delta_pct < -threshold_pct) or \
+			(direction == 'lower' and delta_pct > threshold_pct)
+		flag = 'REGRESSION' if bad else 'ok'
+		print '%-40s %10d  (baseline %d, %+.1f%%, %s)' % (name, value, base, delta_pct, flag)
+		if bad:
+			regressions.append(name)
+	return regressions
+
+def main():
+	parser = OptionParser(usage='usage: %prog [options]')
+	parser.add_option('--build-dir', dest='build_dir', default='.', help='directory the tree was built in')
+	parser.add_option('-o', '--output', dest='output', default='perf-results.json', help='results file to write')
+	parser.add_option('--threshold', dest='threshold', type='int', default=DEFAULT_THRESHOLD_PCT, help='allowed regression percent')
+	parser.add_option('--soak', dest='soak', action='store_true', default=False, help='also run the soak benchmark (takes minutes)')
+	parser.add_option('--write-baseline', dest='write_baseline', action='store_true', default=False, help='store current results as this host\'s baseline')
+	(options, args) = parser.parse_args()
+
+	host = socket.gethostname().split('.')[0]
+	baseline_file = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'perf-baselines', '%s.json' % host)
+
+	benches = list(BENCHES)
+	if options.soak:
+		benches += SOAK_BENCHES
+
+	metrics = {}
+	failed = False
+	for name, path, bargs, parse in benches:
+		out = run_bench(options.build_dir, name, path, bargs)
+		if out is None:
+			failed = True
+			continue
+		parsed = parse(out)
+		if not parsed:
+			print '[%s] no metrics found in output' % name
+			failed = True
+		metrics.update(parsed)
+
+	results = {
+		'host': host,
+		'time': int(time.time()),
+		'metrics': dict((k, {'value': v, 'direction': d}) for k, (v, d) in metrics.items())
+	}
+
+	f = open(options.output, 'w')
+	f.write(json.dumps(results, indent=4, sort_keys=True) + '\n')
+	f.close()
+	print 'wrote %s' % options.output
+
+	if options.write_baseline:
+		f = open(baseline_file, 'w')
+		f.write(json.dumps(dict((k, v) for k, (v, d) in metrics.items()), indent=4, sort_keys=True) + '\n')
+		f.close()
+		print 'wrote %s' % baseline_file
+		return 1 if failed else 0
+
+	if not os.path.isfile(baseline_file):
+		print 'no baseline for host [%s]. run with --write-baseline to create one' % host
+		return 1 if failed else 0
+
+	f = open(baseline_file)
+	baseline = json.loads(f.read())
+	f.close()
+
+	print ''
+	regressions = compare(metrics, baseline, options.threshold)
+
+	if regressions:
+		print ''
+		print 'FAIL: %d metric(s) regressed past %d%%' % (len(regressions), options.threshold)
+		return 1
+
+	if failed:
+		return 1
+
+	print ''
+	print 'OK'
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
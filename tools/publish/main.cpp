@@ -28,7 +28,10 @@
 
 #include <stdio.h>
 #include <assert.h>
+#include <unistd.h>
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QCommandLineParser>
 #include <QJsonDocument>
@@ -36,6 +39,7 @@
 #include <QVariantList>
 #include "zmq.h"
 #include "tnetstring.h"
+#include "histogram.h"
 #include "config.h"
 
 // return true if item modified
@@ -131,13 +135,22 @@ public:
 	QString spec;
 	QString channel;
 	QString content;
+	bool firehose;
+	int count;
+	int rate;
+	int jitter;
+	QString listenSpec;
 
 	ArgsData() :
 		action(Send),
 		code(-1),
 		patch(false),
 		noSeq(false),
-		eol(true)
+		eol(true),
+		firehose(false),
+		count(-1),
+		rate(0),
+		jitter(0)
 	{
 	}
 };
@@ -169,6 +182,16 @@ static CommandLineParseResult parseCommandLine(QCommandLineParser *parser, ArgsD
 	parser->addOption(noEolOption);
 	const QCommandLineOption specOption("spec", "ZeroMQ PUSH spec (default: tcp://localhost:5560).", "spec", "tcp://localhost:5560");
 	parser->addOption(specOption);
+	const QCommandLineOption firehoseOption("firehose", "Keep the socket open and publish a stream of items. Content \"-\" or \"@file\" sends one item per input line, literal content is repeated (requires --count).");
+	parser->addOption(firehoseOption);
+	const QCommandLineOption countOption("count", "Max items to send in firehose mode (default: until input ends).", "n");
+	parser->addOption(countOption);
+	const QCommandLineOption rateOption("rate", "Target send rate (items/second) in firehose mode (default: no limit).", "rate");
+	parser->addOption(rateOption);
+	const QCommandLineOption jitterOption("jitter", "Random variation (percent) applied to firehose send spacing.", "pct");
+	parser->addOption(jitterOption);
+	const QCommandLineOption listenOption("listen", "ZeroMQ SUB spec to verify delivery against (e.g. the handler's peer_out_spec) and report publish latency.", "spec");
+	parser->addOption(listenOption);
 	parser->addPositionalArgument("channel", "Channel to send to.");
 	parser->addPositionalArgument("content", "Content to use for HTTP body and WebSocket message.");
 	const QCommandLineOption helpOption = parser->addHelpOption();
@@ -270,6 +293,51 @@ static CommandLineParseResult parseCommandLine(QCommandLineParser *parser, ArgsD
 
 	args->spec = parser->value(specOption);
 
+	if(parser->isSet(firehoseOption))
+		args->firehose = true;
+
+	if(parser->isSet(countOption))
+	{
+		bool ok;
+		int x = parser->value(countOption).toInt(&ok);
+		if(!ok || x < 1)
+		{
+			*errorMessage = "error: count must be a positive integer.";
+			return CommandLineError;
+		}
+
+		args->count = x;
+	}
+
+	if(parser->isSet(rateOption))
+	{
+		bool ok;
+		int x = parser->value(rateOption).toInt(&ok);
+		if(!ok || x < 1)
+		{
+			*errorMessage = "error: rate must be a positive integer.";
+			return CommandLineError;
+		}
+
+		args->rate = x;
+	}
+
+	if(parser->isSet(jitterOption))
+	{
+		bool ok;
+		int x = parser->value(jitterOption).toInt(&ok);
+		if(!ok || x < 0 || x > 100)
+		{
+			*errorMessage = "error: jitter must be an integer between 0 and 100.";
+			return CommandLineError;
+		}
+
+		args->jitter = x;
+	}
+
+	if(parser->isSet(listenOption))
+		args->listenSpec = parser->value(listenOption);
+
 	if(positionalArguments.isEmpty())
 	{
 		*errorMessage = "error: must specify channel";
@@ -287,55 +355,28 @@ static CommandLineParseResult parseCommandLine(QCommandLineParser *parser, ArgsD
 		return CommandLineError;
 	}
 
-	return CommandLineOk;
-}
-
-int main(int argc, char **argv)
-{
-	QCoreApplication app(argc, argv);
-
-	QCoreApplication::setApplicationName("pushpin-publish");
-	QCoreApplication::setApplicationVersion(VERSION);
-
-	QCommandLineParser parser;
-	parser.setApplicationDescription("Publish messages to Pushpin.");
-
-	ArgsData args;
-	QString errorMessage;
-	switch(parseCommandLine(&parser, &args, &errorMessage))
+	if(args->firehose)
 	{
-		case CommandLineOk:
-			break;
-		case CommandLineError:
-			fprintf(stderr, "%s\n\n%s", qPrintable(errorMessage), qPrintable(parser.helpText()));
-			return 1;
-		case CommandLineVersionRequested:
-			printf("%s %s\n", qPrintable(QCoreApplication::applicationName()),
-				qPrintable(QCoreApplication::applicationVersion()));
-			return 0;
-		case CommandLineHelpRequested:
-			parser.showHelp();
-			Q_UNREACHABLE();
-	}
-
-	QVariantHash formats;
-
-	bool isFile = false;
-	if(args.content.startsWith('@'))
-	{
-		QString fname = args.content.mid(1);
-		QFile f(fname);
-		if(!f.open(QFile::ReadOnly))
+		if(args->action != ArgsData::Send || args->patch)
 		{
-			errorMessage = QString("error: can't read file: %1").arg(fname);
-			fprintf(stderr, "%s\n\n%s", qPrintable(errorMessage), qPrintable(parser.helpText()));
-			return 1;
+			*errorMessage = "error: firehose mode requires plain send content";
+			return CommandLineError;
 		}
 
-		isFile = true;
-		args.content = f.readAll();
+		if(args->content != "-" && !args->content.startsWith('@') && args->count < 1)
+		{
+			*errorMessage = "error: firehose mode with literal content requires --count";
+			return CommandLineError;
+		}
 	}
 
+	return CommandLineOk;
+}
+
+static QByteArray buildMessage(const ArgsData &args, const QByteArray &content, bool isFile, qint64 pubTime)
+{
+	QVariantHash formats;
+
 	if(args.action == ArgsData::Send)
 	{
 		QVariantHash httpResponse;
@@ -346,7 +387,7 @@ int main(int argc, char **argv)
 		}
 		else
 		{
-			QByteArray body = args.content.toUtf8();
+			QByteArray body = content;
 			if(args.eol && !isFile)
 				body += '\n';
 			httpResponse["body"] = body;
@@ -369,14 +410,14 @@ int main(int argc, char **argv)
 		if(!args.patch)
 		{
 			QVariantHash httpStream;
-			QByteArray body = args.content.toUtf8();
+			QByteArray body = content;
 			if(args.eol && !isFile)
 				body += '\n';
 			httpStream["content"] = body;
 			formats["http-stream"] = httpStream;
 
 			QVariantHash wsMessage;
-			wsMessage["content"] = args.content.toUtf8();
+			wsMessage["content"] = content;
 			formats["ws-message"] = wsMessage;
 		}
 	}
@@ -409,6 +450,10 @@ int main(int argc, char **argv)
 	foreach(const ArgsData::Header &m, args.meta)
 		meta[QString::fromUtf8(m.first)] = m.second;
 
+	// stamp the send time, so a listener can compute publish latency
+	if(pubTime >= 0)
+		meta["pub-time"] = QByteArray::number(pubTime);
+
 	QVariantHash item;
 
 	item["channel"] = args.channel.toUtf8();
@@ -427,18 +472,263 @@ int main(int argc, char **argv)
 	if(args.noSeq)
 		item["no-seq"] = true;
 
-	QByteArray message = TnetString::fromVariant(item);
+	return TnetString::fromVariant(item);
+}
+
+// drain any received items from the listen socket, recording latency
+//   against the pub-time each carries
+static void processListenable(void *listenSock, Histogram *latency)
+{
+	while(true)
+	{
+		zmq_msg_t msg;
+		zmq_msg_init(&msg);
+		if(zmq_msg_recv(&msg, listenSock, ZMQ_DONTWAIT) < 0)
+		{
+			zmq_msg_close(&msg);
+			break;
+		}
+
+		QByteArray data;
+
+		// item data is in the last frame
+		while(true)
+		{
+			data = QByteArray((const char *)zmq_msg_data(&msg), zmq_msg_size(&msg));
+
+			if(!zmq_msg_more(&msg))
+				break;
+
+			zmq_msg_close(&msg);
+			zmq_msg_init(&msg);
+			if(zmq_msg_recv(&msg, listenSock, 0) < 0)
+				break;
+		}
+
+		zmq_msg_close(&msg);
+
+		QVariant item = TnetString::toVariant(data);
+		if(item.type() != QVariant::Hash)
+			continue;
+
+		QVariantHash meta = item.toHash().value("meta").toHash();
+		qint64 pubTime = meta.value("pub-time").toByteArray().toLongLong();
+		if(pubTime <= 0)
+			continue;
+
+		latency->add(QDateTime::currentMSecsSinceEpoch() - pubTime);
+	}
+}
+
+static int runFirehose(const ArgsData &args, void *sock, void *listenSock)
+{
+	QFile input;
+	bool haveInput = false;
+
+	if(args.content == "-")
+	{
+		if(!input.open(stdin, QFile::ReadOnly))
+		{
+			fprintf(stderr, "error: can't read stdin\n");
+			return 1;
+		}
+
+		haveInput = true;
+	}
+	else if(args.content.startsWith('@'))
+	{
+		QString fname = args.content.mid(1);
+		input.setFileName(fname);
+		if(!input.open(QFile::ReadOnly))
+		{
+			fprintf(stderr, "error: can't read file: %s\n", qPrintable(fname));
+			return 1;
+		}
+
+		haveInput = true;
+	}
+
+	// send in batches, so pacing wakeups stay bounded at high rates
+	int batch = 1;
+	qint64 batchUsecs = 0;
+	if(args.rate > 0)
+	{
+		batch = qMax(args.rate / 100, 1);
+		batchUsecs = (qint64)batch * 1000000 / args.rate;
+	}
+
+	qsrand((uint)QDateTime::currentMSecsSinceEpoch());
+
+	Histogram latency;
+	qint64 sent = 0;
+	qint64 intervalStart = 0;
+	qint64 intervalSent = 0;
+
+	QElapsedTimer elapsed;
+	elapsed.start();
+
+	bool done = false;
+	while(!done)
+	{
+		for(int n = 0; n < batch; ++n)
+		{
+			QByteArray content = args.content.toUtf8();
+			if(haveInput)
+			{
+				if(input.atEnd())
+				{
+					done = true;
+					break;
+				}
+
+				content = input.readLine();
+				while(content.endsWith('\n') || content.endsWith('\r'))
+					content.truncate(content.size() - 1);
+			}
+
+			qint64 pubTime = listenSock ? QDateTime::currentMSecsSinceEpoch() : -1;
+			QByteArray message = buildMessage(args, content, haveInput, pubTime);
+
+			zmq_send(sock, message.data(), message.size(), 0);
+			++sent;
+			++intervalSent;
+
+			if(args.count >= 1 && sent >= args.count)
+			{
+				done = true;
+				break;
+			}
+		}
+
+		if(listenSock)
+			processListenable(listenSock, &latency);
+
+		if(batchUsecs > 0 && !done)
+		{
+			qint64 usecs = batchUsecs;
+
+			if(args.jitter > 0)
+			{
+				// vary spacing by up to +/-jitter percent
+				int pct = (qrand() % (args.jitter * 2 + 1)) - args.jitter;
+				usecs += usecs * pct / 100;
+			}
+
+			usleep(usecs);
+		}
+
+		qint64 now = elapsed.elapsed();
+		if(now - intervalStart >= 1000)
+		{
+			if(listenSock)
+				printf("sent=%lld rate=%d/s recv=%llu latency p50=%lldms p99=%lldms max=%lldms\n", (long long)sent, (int)(intervalSent * 1000 / (now - intervalStart)), (unsigned long long)latency.count(), (long long)latency.percentile(0.5), (long long)latency.percentile(0.99), (long long)latency.maxValue());
+			else
+				printf("sent=%lld rate=%d/s\n", (long long)sent, (int)(intervalSent * 1000 / (now - intervalStart)));
+
+			intervalStart = now;
+			intervalSent = 0;
+		}
+	}
+
+	if(listenSock)
+	{
+		// allow in-flight items to arrive before summarizing
+		usleep(500000);
+		processListenable(listenSock, &latency);
+
+		printf("done. sent=%lld recv=%llu latency p50=%lldms p99=%lldms p999=%lldms max=%lldms\n", (long long)sent, (unsigned long long)latency.count(), (long long)latency.percentile(0.5), (long long)latency.percentile(0.99), (long long)latency.percentile(0.999), (long long)latency.maxValue());
+	}
+	else
+		printf("done. sent=%lld\n", (long long)sent);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+
+	QCoreApplication::setApplicationName("pushpin-publish");
+	QCoreApplication::setApplicationVersion(VERSION);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Publish messages to Pushpin.");
+
+	ArgsData args;
+	QString errorMessage;
+	switch(parseCommandLine(&parser, &args, &errorMessage))
+	{
+		case CommandLineOk:
+			break;
+		case CommandLineError:
+			fprintf(stderr, "%s\n\n%s", qPrintable(errorMessage), qPrintable(parser.helpText()));
+			return 1;
+		case CommandLineVersionRequested:
+			printf("%s %s\n", qPrintable(QCoreApplication::applicationName()),
+				qPrintable(QCoreApplication::applicationVersion()));
+			return 0;
+		case CommandLineHelpRequested:
+			parser.showHelp();
+			Q_UNREACHABLE();
+	}
 
 	void *context = zmq_ctx_new();
 	void *sock = zmq_socket(context, ZMQ_PUSH);
 	int rc = zmq_connect(sock, args.spec.toUtf8());
 	assert(rc == 0);
 
-	zmq_send(sock, message.data(), message.size(), 0);
+	void *listenSock = 0;
+	if(args.firehose && !args.listenSpec.isEmpty())
+	{
+		listenSock = zmq_socket(context, ZMQ_SUB);
+		rc = zmq_connect(listenSock, args.listenSpec.toUtf8());
+		assert(rc == 0);
+
+		QByteArray channel = args.channel.toUtf8();
+		rc = zmq_setsockopt(listenSock, ZMQ_SUBSCRIBE, channel.data(), channel.size());
+		assert(rc == 0);
+
+		// give the subscription a moment to propagate, so the first
+		//   items aren't lost to the pub/sub slow joiner problem
+		usleep(100000);
+	}
+
+	int ret = 0;
+
+	if(args.firehose)
+	{
+		ret = runFirehose(args, sock, listenSock);
+	}
+	else
+	{
+		bool isFile = false;
+		if(args.content.startsWith('@'))
+		{
+			QString fname = args.content.mid(1);
+			QFile f(fname);
+			if(!f.open(QFile::ReadOnly))
+			{
+				errorMessage = QString("error: can't read file: %1").arg(fname);
+				fprintf(stderr, "%s\n\n%s", qPrintable(errorMessage), qPrintable(parser.helpText()));
+				return 1;
+			}
+
+			isFile = true;
+			args.content = f.readAll();
+		}
+
+		QByteArray message = buildMessage(args, args.content.toUtf8(), isFile, -1);
+
+		zmq_send(sock, message.data(), message.size(), 0);
+
+		printf("Published\n");
+	}
+
+	if(listenSock)
+		zmq_close(listenSock);
 
 	zmq_close(sock);
 	zmq_ctx_destroy(context);
 
-	printf("Published\n");
-	return 0;
+	return ret;
 }
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+// replays a recorded request stream against the proxy's zhttp
+//   interface, for reproducing production traffic shapes during
+//   performance work.
+//
+// input is a file of JSON objects, one per line:
+//
+//   {"time": 120, "method": "GET", "uri": "http://example.com/path",
+//    "headers": [["Accept", "*/*"]], "body": ""}
+//
+// "time" is a millisecond offset from the start of the recording and
+//   is optional; requests without it are spaced by --interval. sending
+//   is open loop: each request goes out at its scheduled time divided
+//   by --speed, regardless of whether earlier responses have arrived,
+//   so slow responses show up as latency rather than reduced offered
+//   load.
+
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QTimer>
+#include <QUrl>
+#include "qzmqsocket.h"
+#include "qzmqvalve.h"
+#include "tnetstring.h"
+#include "histogram.h"
+#include "zhttprequestpacket.h"
+#include "zhttpresponsepacket.h"
+#include "config.h"
+
+#define FINISH_TIMEOUT 10000
+
+class RecordedRequest
+{
+public:
+	qint64 time; // msec offset, -1 if unspecified
+	QString method;
+	QUrl uri;
+	HttpHeaders headers;
+	QByteArray body;
+
+	RecordedRequest() :
+		time(-1)
+	{
+	}
+};
+
+class App : public QObject
+{
+	Q_OBJECT
+
+public:
+	QList<RecordedRequest> requests;
+	double speed;
+	int interval;
+	QByteArray instanceId;
+
+	QZmq::Socket *outSock;
+	QZmq::Socket *inSock;
+	QZmq::Valve *inValve;
+	QTimer *sendTimer;
+	QTimer *finishTimer;
+
+	int nextIndex;
+	int completed;
+	int errored;
+	QHash<QByteArray, qint64> sendTimes;
+	Histogram latency;
+	QElapsedTimer elapsed;
+
+	App(QObject *parent = 0) :
+		QObject(parent),
+		speed(1.0),
+		interval(10),
+		nextIndex(0),
+		completed(0),
+		errored(0)
+	{
+		instanceId = "replay-" + QByteArray::number(QCoreApplication::applicationPid());
+
+		outSock = new QZmq::Socket(QZmq::Socket::Push, this);
+
+		inSock = new QZmq::Socket(QZmq::Socket::Sub, this);
+		inValve = new QZmq::Valve(inSock, this);
+		connect(inValve, &QZmq::Valve::readyRead, this, &App::in_readyRead);
+
+		sendTimer = new QTimer(this);
+		sendTimer->setSingleShot(true);
+		connect(sendTimer, &QTimer::timeout, this, &App::send_timeout);
+
+		finishTimer = new QTimer(this);
+		finishTimer->setSingleShot(true);
+		connect(finishTimer, &QTimer::timeout, this, &App::finish_timeout);
+	}
+
+	bool start(const QString &outSpec, const QString &inSpec)
+	{
+		outSock->connectToAddress(outSpec);
+
+		inSock->connectToAddress(inSpec);
+		inSock->subscribe(instanceId + ' ');
+		inValve->open();
+
+		elapsed.start();
+
+		// give the subscription a moment to propagate before sending
+		sendTimer->start(100);
+
+		return true;
+	}
+
+signals:
+	void finished();
+
+private:
+	qint64 dueTime(int index) const
+	{
+		const RecordedRequest &r = requests[index];
+
+		qint64 t;
+		if(r.time >= 0)
+			t = r.time;
+		else
+			t = (qint64)index * interval;
+
+		return (qint64)(t / speed) + 100;
+	}
+
+	void sendRequest(int index)
+	{
+		const RecordedRequest &r = requests[index];
+
+		QByteArray id = QByteArray::number(index);
+
+		ZhttpRequestPacket zreq;
+		zreq.from = instanceId;
+		zreq.ids += ZhttpRequestPacket::Id(id, 0);
+		zreq.type = ZhttpRequestPacket::Data;
+		zreq.uri = r.uri;
+		zreq.method = r.method;
+		zreq.headers = r.headers;
+		zreq.body = r.body;
+		zreq.credits = 200000;
+
+		sendTimes[id] = elapsed.elapsed();
+
+		QByteArray buf = 'T' + TnetString::fromVariant(zreq.toVariant());
+		outSock->write(QList<QByteArray>() << buf);
+	}
+
+	void maybeFinish()
+	{
+		if(nextIndex >= requests.count() && completed + errored >= requests.count())
+		{
+			report();
+			emit finished();
+		}
+	}
+
+	void report()
+	{
+		finishTimer->stop();
+
+		printf("\n");
+		printf("sent:      %d\n", requests.count());
+		printf("completed: %d\n", completed);
+		printf("errored:   %d\n", errored + (requests.count() - completed - errored));
+		printf("elapsed:   %llums\n", (unsigned long long)elapsed.elapsed());
+		printf("response latency (msec):\n");
+		printf("  p50=%lld p99=%lld p999=%lld max=%lld\n",
+			(long long)latency.percentile(0.5),
+			(long long)latency.percentile(0.99),
+			(long long)latency.percentile(0.999),
+			(long long)latency.maxValue());
+	}
+
+private slots:
+	void send_timeout()
+	{
+		qint64 now = elapsed.elapsed();
+
+		// send everything that is due. open loop: don't wait on
+		//   responses
+		while(nextIndex < requests.count() && dueTime(nextIndex) <= now)
+		{
+			sendRequest(nextIndex);
+			++nextIndex;
+		}
+
+		if(nextIndex < requests.count())
+		{
+			sendTimer->start((int)qMax(dueTime(nextIndex) - now, (qint64)0));
+		}
+		else
+		{
+			// all sent. allow some time for remaining responses
+			finishTimer->start(FINISH_TIMEOUT);
+			maybeFinish();
+		}
+	}
+
+	void in_readyRead(const QList<QByteArray> &message)
+	{
+		if(message.count() != 1)
+			return;
+
+		int at = message[0].indexOf(' ');
+		if(at == -1 || at + 2 > message[0].length() || message[0][at + 1] != 'T')
+			return;
+
+		QVariant v = TnetString::toVariant(message[0].mid(at + 2));
+
+		ZhttpResponsePacket zresp;
+		if(!zresp.fromVariant(v))
+			return;
+
+		if(zresp.ids.isEmpty())
+			return;
+
+		QByteArray id = zresp.ids.first().id;
+		if(!sendTimes.contains(id))
+			return;
+
+		if(zresp.type == ZhttpResponsePacket::Data)
+		{
+			if(!zresp.more)
+			{
+				latency.add(elapsed.elapsed() - sendTimes.take(id));
+				++completed;
+				maybeFinish();
+			}
+		}
+		else if(zresp.type == ZhttpResponsePacket::Error || zresp.type == ZhttpResponsePacket::Cancel)
+		{
+			sendTimes.remove(id);
+			++errored;
+			maybeFinish();
+		}
+	}
+
+	void finish_timeout()
+	{
+		fprintf(stderr, "warning: timed out waiting for %d responses\n", requests.count() - completed - errored);
+		report();
+		emit finished();
+	}
+};
+
+static bool loadRequests(const QString &fileName, QList<RecordedRequest> *out, QString *errorMessage)
+{
+	QFile file(fileName);
+	if(!file.open(QFile::ReadOnly))
+	{
+		*errorMessage = QString("can't open %1").arg(fileName);
+		return false;
+	}
+
+	int lineNum = 0;
+	while(!file.atEnd())
+	{
+		QByteArray line = file.readLine().trimmed();
+		++lineNum;
+
+		if(line.isEmpty())
+			continue;
+
+		QJsonParseError e;
+		QJsonDocument doc = QJsonDocument::fromJson(line, &e);
+		if(e.error != QJsonParseError::NoError || !doc.isObject())
+		{
+			*errorMessage = QString("line %1: not a JSON object").arg(lineNum);
+			return false;
+		}
+
+		QJsonObject obj = doc.object();
+
+		RecordedRequest r;
+
+		if(obj.contains("time"))
+			r.time = (qint64)obj.value("time").toDouble();
+
+		r.method = obj.value("method").toString("GET");
+
+		r.uri = QUrl(obj.value("uri").toString(), QUrl::StrictMode);
+		if(!r.uri.isValid() || r.uri.scheme().isEmpty())
+		{
+			*errorMessage = QString("line %1: missing or invalid uri").arg(lineNum);
+			return false;
+		}
+
+		foreach(const QJsonValue &hv, obj.value("headers").toArray())
+		{
+			QJsonArray h = hv.toArray();
+			if(h.count() == 2)
+				r.headers += HttpHeader(h.at(0).toString().toUtf8(), h.at(1).toString().toUtf8());
+		}
+
+		r.body = obj.value("body").toString().toUtf8();
+
+		out->append(r);
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication qapp(argc, argv);
+
+	QCoreApplication::setApplicationName("pushpin-replay");
+	QCoreApplication::setApplicationVersion(VERSION);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Replay a recorded request stream over zhttp.");
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.setSingleDashWordOptionMode(QCommandLineParser::ParseAsLongOptions);
+	const QCommandLineOption inSpecOption("in-spec", "ZeroMQ SUB spec for responses (default: tcp://localhost:5561).", "spec", "tcp://localhost:5561");
+	parser.addOption(inSpecOption);
+	const QCommandLineOption outSpecOption("out-spec", "ZeroMQ PUSH spec for requests (default: tcp://localhost:5560).", "spec", "tcp://localhost:5560");
+	parser.addOption(outSpecOption);
+	const QCommandLineOption speedOption("speed", "Speed multiplier for recorded timing (default: 1.0).", "factor", "1.0");
+	parser.addOption(speedOption);
+	const QCommandLineOption intervalOption("interval", "Spacing in msec for requests without a time field (default: 10).", "msec", "10");
+	parser.addOption(intervalOption);
+	parser.addPositionalArgument("file", "File of recorded requests, one JSON object per line.");
+	parser.process(qapp);
+
+	QStringList posArgs = parser.positionalArguments();
+	if(posArgs.count() != 1)
+	{
+		fprintf(stderr, "error: expected file argument\n");
+		return 1;
+	}
+
+	bool ok;
+	double speed = parser.value(speedOption).toDouble(&ok);
+	if(!ok || speed <= 0.0)
+	{
+		fprintf(stderr, "error: speed must be a positive number\n");
+		return 1;
+	}
+
+	int interval = parser.value(intervalOption).toInt(&ok);
+	if(!ok || interval < 0)
+	{
+		fprintf(stderr, "error: interval must be a non-negative integer\n");
+		return 1;
+	}
+
+	App *app = new App(&qapp);
+	app->speed = speed;
+	app->interval = interval;
+
+	QString errorMessage;
+	if(!loadRequests(posArgs[0], &app->requests, &errorMessage))
+	{
+		fprintf(stderr, "error: %s\n", qPrintable(errorMessage));
+		return 1;
+	}
+
+	if(app->requests.isEmpty())
+	{
+		fprintf(stderr, "error: no requests in file\n");
+		return 1;
+	}
+
+	printf("replaying %d requests at %gx speed\n", app->requests.count(), speed);
+
+	QObject::connect(app, &App::finished, &qapp, &QCoreApplication::quit);
+
+	if(!app->start(parser.value(outSpecOption), parser.value(inSpecOption)))
+		return 1;
+
+	return qapp.exec();
+}
+
+#include "main.moc"
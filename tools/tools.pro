@@ -1,5 +1,9 @@
 TEMPLATE = subdirs
 
 publish.subdir = publish
+replay.subdir = replay
+wsbench.subdir = wsbench
 
 SUBDIRS += publish
+SUBDIRS += replay
+SUBDIRS += wsbench
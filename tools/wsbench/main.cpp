@@ -0,0 +1,593 @@
+/*
+ * Copyright (C) 2017 Fanout, Inc.
+ *
+ * This file is part of Pushpin.
+ *
+ * $FANOUT_BEGIN_LICENSE:AGPL$
+ *
+ * Pushpin is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * Pushpin is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Pushpin may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+// opens a swarm of websocket connections against the proxy's zhttp
+//   interface and measures connect rate, delivery latency, and
+//   fairness of fan-out across connections. driving the proxy over
+//   zmq instead of tcp avoids per-socket fd limits, so one process
+//   can hold hundreds of thousands of connections.
+//
+// each connection picks a channel from the configured distribution
+//   and substitutes it for "{channel}" in the uri (or appends it as a
+//   channel query parameter), so the origin can subscribe the
+//   connection accordingly. delivery latency is measured from
+//   publisher-embedded timestamps: a message whose body begins with
+//   an integer is taken to carry the publish time in milliseconds
+//   since the epoch.
+//
+// sockjs mode speaks the sockjs websocket transport: the session path
+//   is appended to the uri and "o"/"a"/"h"/"c" frames are interpreted,
+//   with each element of an "a" frame counting as one message.
+
+#include <stdio.h>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include "zhttpmanager.h"
+#include "zwebsocket.h"
+#include "histogram.h"
+#include "config.h"
+
+#define CONNECT_TICK_INTERVAL 10
+#define REPORT_INTERVAL 5000
+
+class BenchConn : public QObject
+{
+	Q_OBJECT
+
+public:
+	ZWebSocket *sock;
+	QString channel;
+	bool sockJs;
+	bool opened; // sockjs: received the "o" frame
+	bool wasConnected;
+	quint64 received;
+	qint64 connectStart;
+	QByteArray partial; // fragmented message being assembled
+
+	BenchConn(QObject *parent = 0) :
+		QObject(parent),
+		sock(0),
+		sockJs(false),
+		opened(false),
+		wasConnected(false),
+		received(0),
+		connectStart(-1)
+	{
+	}
+};
+
+class App : public QObject
+{
+	Q_OBJECT
+
+public:
+	int connections;
+	int connectRate; // per second
+	int channelCount;
+	QString channelPrefix;
+	bool zipf;
+	bool sockJs;
+	QUrl uri;
+	int duration; // seconds, 0 means run until interrupted
+
+	ZhttpManager *zhttp;
+	QSet<BenchConn*> conns;
+	QTimer *connectTimer;
+	QTimer *reportTimer;
+	QTimer *durationTimer;
+	QElapsedTimer elapsed;
+
+	int started;
+	int connected;
+	int errored;
+	quint64 messages;
+	Histogram connectTime;
+	Histogram latency;
+	QList<double> zipfCdf;
+
+	// deltas for the periodic report
+	int lastConnected;
+	quint64 lastMessages;
+	qint64 lastReportTime;
+
+	App(QObject *parent = 0) :
+		QObject(parent),
+		connections(1000),
+		connectRate(1000),
+		channelCount(1),
+		channelPrefix("channel-"),
+		zipf(false),
+		sockJs(false),
+		duration(0),
+		started(0),
+		connected(0),
+		errored(0),
+		messages(0),
+		lastConnected(0),
+		lastMessages(0),
+		lastReportTime(0)
+	{
+		zhttp = new ZhttpManager(this);
+		zhttp->setInstanceId("wsbench-" + QByteArray::number(QCoreApplication::applicationPid()));
+
+		connectTimer = new QTimer(this);
+		connect(connectTimer, &QTimer::timeout, this, &App::connect_timeout);
+
+		reportTimer = new QTimer(this);
+		connect(reportTimer, &QTimer::timeout, this, &App::report_timeout);
+
+		durationTimer = new QTimer(this);
+		durationTimer->setSingleShot(true);
+		connect(durationTimer, &QTimer::timeout, this, &App::duration_timeout);
+	}
+
+	bool start(const QString &outSpec, const QString &outStreamSpec, const QString &inSpec)
+	{
+		if(!zhttp->setClientOutSpecs(QStringList() << outSpec))
+			return false;
+		if(!zhttp->setClientOutStreamSpecs(QStringList() << outStreamSpec))
+			return false;
+		if(!zhttp->setClientInSpecs(QStringList() << inSpec))
+			return false;
+
+		if(zipf)
+		{
+			// zipf with s=1: weight of channel k is 1/(k+1).
+			//   precompute the cdf so selection is a binary search
+			double total = 0.0;
+			for(int n = 0; n < channelCount; ++n)
+				total += 1.0 / (double)(n + 1);
+
+			double acc = 0.0;
+			for(int n = 0; n < channelCount; ++n)
+			{
+				acc += (1.0 / (double)(n + 1)) / total;
+				zipfCdf += acc;
+			}
+		}
+
+		elapsed.start();
+		lastReportTime = 0;
+
+		connectTimer->start(CONNECT_TICK_INTERVAL);
+		reportTimer->start(REPORT_INTERVAL);
+
+		if(duration > 0)
+			durationTimer->start(duration * 1000);
+
+		return true;
+	}
+
+signals:
+	void finished();
+
+private:
+	QString pickChannel() const
+	{
+		int index;
+		if(zipf)
+		{
+			double r = (double)qrand() / (double)RAND_MAX;
+			index = 0;
+			while(index < zipfCdf.count() - 1 && zipfCdf[index] < r)
+				++index;
+		}
+		else
+			index = qrand() % channelCount;
+
+		return channelPrefix + QString::number(index);
+	}
+
+	void startConnection()
+	{
+		BenchConn *c = new BenchConn(this);
+		c->channel = pickChannel();
+		c->sockJs = sockJs;
+
+		QUrl u = uri;
+
+		QString path = u.path();
+		if(path.contains("{channel}"))
+		{
+			path.replace("{channel}", c->channel);
+		}
+		else
+		{
+			QUrlQuery query(u);
+			query.addQueryItem("channel", c->channel);
+			u.setQuery(query);
+		}
+
+		if(sockJs)
+		{
+			// sockjs websocket transport: /<server>/<session>/websocket
+			if(!path.endsWith('/'))
+				path += '/';
+			path += QString("000/wsbench%1/websocket").arg(started);
+		}
+
+		u.setPath(path);
+
+		c->sock = zhttp->createSocket();
+		c->sock->setParent(c);
+		connect(c->sock, &ZWebSocket::connected, this, &App::sock_connected);
+		connect(c->sock, &ZWebSocket::readyRead, this, &App::sock_readyRead);
+		connect(c->sock, &ZWebSocket::closed, this, &App::sock_closed);
+		connect(c->sock, &ZWebSocket::peerClosed, this, &App::sock_peerClosed);
+		connect(c->sock, &ZWebSocket::error, this, &App::sock_error);
+
+		c->connectStart = elapsed.elapsed();
+		conns += c;
+		++started;
+
+		c->sock->start(u, HttpHeaders());
+	}
+
+	BenchConn *connForSender(QObject *sender) const
+	{
+		ZWebSocket *sock = (ZWebSocket *)sender;
+		return (BenchConn *)sock->parent();
+	}
+
+	void handleMessage(BenchConn *c, const QByteArray &body)
+	{
+		++messages;
+		++c->received;
+
+		// publisher-embedded timestamp: leading integer msec epoch
+		int at = 0;
+		while(at < body.length() && body[at] >= '0' && body[at] <= '9')
+			++at;
+
+		if(at > 0)
+		{
+			bool ok;
+			qint64 ts = body.mid(0, at).toLongLong(&ok);
+			if(ok)
+			{
+				qint64 now = QDateTime::currentMSecsSinceEpoch();
+				if(now >= ts)
+					latency.add(now - ts);
+			}
+		}
+	}
+
+	void handleSockJsFrame(BenchConn *c, const QByteArray &body)
+	{
+		if(body.isEmpty())
+			return;
+
+		char type = body[0];
+
+		if(type == 'o')
+		{
+			c->opened = true;
+		}
+		else if(type == 'a')
+		{
+			QJsonDocument doc = QJsonDocument::fromJson(body.mid(1));
+			if(!doc.isArray())
+				return;
+
+			foreach(const QJsonValue &v, doc.array())
+				handleMessage(c, v.toString().toUtf8());
+		}
+		else if(type == 'c')
+		{
+			c->sock->close();
+		}
+
+		// 'h' heartbeats are ignored
+	}
+
+	void report(bool final)
+	{
+		qint64 now = elapsed.elapsed();
+		double interval = (double)(now - lastReportTime) / 1000.0;
+		if(interval <= 0.0)
+			interval = 1.0;
+
+		if(final)
+		{
+			printf("\n");
+			printf("connections: started=%d connected=%d errored=%d\n", started, connected, errored);
+			printf("connect time (msec): p50=%lld p99=%lld max=%lld\n",
+				(long long)connectTime.percentile(0.5),
+				(long long)connectTime.percentile(0.99),
+				(long long)connectTime.maxValue());
+			printf("messages: %llu\n", (unsigned long long)messages);
+			if(latency.count() > 0)
+			{
+				printf("delivery latency (msec): p50=%lld p99=%lld p999=%lld max=%lld\n",
+					(long long)latency.percentile(0.5),
+					(long long)latency.percentile(0.99),
+					(long long)latency.percentile(0.999),
+					(long long)latency.maxValue());
+			}
+
+			// fairness: spread of per-connection delivery counts
+			if(connected > 0)
+			{
+				Histogram perConn;
+				quint64 minCount = 0;
+				quint64 maxCount = 0;
+				bool first = true;
+				foreach(const BenchConn *c, conns)
+				{
+					if(c->sock->state() != WebSocket::Connected)
+						continue;
+
+					perConn.add(c->received);
+
+					if(first || c->received < minCount)
+						minCount = c->received;
+					if(first || c->received > maxCount)
+						maxCount = c->received;
+					first = false;
+				}
+
+				printf("per-connection messages: min=%llu p50=%lld max=%llu\n",
+					(unsigned long long)minCount,
+					(long long)perConn.percentile(0.5),
+					(unsigned long long)maxCount);
+			}
+		}
+		else
+		{
+			printf("conns=%d/%d (+%.0f/s) msgs=%llu (%.0f/s) latency p50=%lldms p99=%lldms\n",
+				connected,
+				connections,
+				(double)(connected - lastConnected) / interval,
+				(unsigned long long)messages,
+				(double)(messages - lastMessages) / interval,
+				(long long)latency.percentile(0.5),
+				(long long)latency.percentile(0.99));
+		}
+
+		lastConnected = connected;
+		lastMessages = messages;
+		lastReportTime = now;
+	}
+
+private slots:
+	void connect_timeout()
+	{
+		// open loop: ramp at the configured rate regardless of how
+		//   many connects have completed
+		int budget = qMax((connectRate * CONNECT_TICK_INTERVAL) / 1000, 1);
+		while(budget > 0 && started < connections)
+		{
+			startConnection();
+			--budget;
+		}
+
+		if(started >= connections)
+			connectTimer->stop();
+	}
+
+	void sock_connected()
+	{
+		BenchConn *c = connForSender(sender());
+
+		c->wasConnected = true;
+		++connected;
+		connectTime.add(elapsed.elapsed() - c->connectStart);
+	}
+
+	void sock_readyRead()
+	{
+		BenchConn *c = connForSender(sender());
+
+		while(c->sock->framesAvailable() > 0)
+		{
+			WebSocket::Frame frame = c->sock->readFrame();
+
+			if(frame.type == WebSocket::Frame::Ping || frame.type == WebSocket::Frame::Pong)
+				continue;
+
+			c->partial += frame.data;
+			if(frame.more)
+				continue;
+
+			QByteArray body = c->partial;
+			c->partial.clear();
+
+			if(c->sockJs)
+				handleSockJsFrame(c, body);
+			else
+				handleMessage(c, body);
+		}
+	}
+
+	void sock_peerClosed()
+	{
+		BenchConn *c = connForSender(sender());
+
+		c->sock->close();
+	}
+
+	void sock_closed()
+	{
+		BenchConn *c = connForSender(sender());
+
+		--connected;
+		conns.remove(c);
+		c->deleteLater();
+	}
+
+	void sock_error()
+	{
+		BenchConn *c = connForSender(sender());
+
+		if(c->wasConnected)
+			--connected;
+		else
+			++errored;
+
+		conns.remove(c);
+		c->deleteLater();
+	}
+
+	void report_timeout()
+	{
+		report(false);
+	}
+
+	void duration_timeout()
+	{
+		report(true);
+		emit finished();
+	}
+};
+
+int main(int argc, char **argv)
+{
+	QCoreApplication qapp(argc, argv);
+
+	QCoreApplication::setApplicationName("pushpin-wsbench");
+	QCoreApplication::setApplicationVersion(VERSION);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Websocket client swarm benchmark over zhttp.");
+	parser.addHelpOption();
+	parser.addVersionOption();
+	parser.setSingleDashWordOptionMode(QCommandLineParser::ParseAsLongOptions);
+	const QCommandLineOption outSpecOption("out-spec", "ZeroMQ PUSH spec to the proxy's server-in socket.", "spec");
+	parser.addOption(outSpecOption);
+	const QCommandLineOption outStreamSpecOption("out-stream-spec", "ZeroMQ ROUTER spec to the proxy's server-in-stream socket.", "spec");
+	parser.addOption(outStreamSpecOption);
+	const QCommandLineOption inSpecOption("in-spec", "ZeroMQ SUB spec from the proxy's server-out socket.", "spec");
+	parser.addOption(inSpecOption);
+	const QCommandLineOption uriOption("uri", "Websocket uri. \"{channel}\" in the path is substituted; otherwise the channel is appended as a query parameter (default: ws://localhost/).", "uri", "ws://localhost/");
+	parser.addOption(uriOption);
+	const QCommandLineOption connectionsOption("connections", "Number of connections to open (default: 1000).", "count", "1000");
+	parser.addOption(connectionsOption);
+	const QCommandLineOption connectRateOption("connect-rate", "Connections to open per second (default: 1000).", "rate", "1000");
+	parser.addOption(connectRateOption);
+	const QCommandLineOption channelsOption("channels", "Number of channels to spread connections across (default: 1).", "count", "1");
+	parser.addOption(channelsOption);
+	const QCommandLineOption channelPrefixOption("channel-prefix", "Channel name prefix (default: channel-).", "prefix", "channel-");
+	parser.addOption(channelPrefixOption);
+	const QCommandLineOption distOption("dist", "Channel distribution: uniform or zipf (default: uniform).", "dist", "uniform");
+	parser.addOption(distOption);
+	const QCommandLineOption modeOption("mode", "Transport mode: ws or sockjs (default: ws).", "mode", "ws");
+	parser.addOption(modeOption);
+	const QCommandLineOption durationOption("duration", "Seconds to run before reporting and exiting. 0 runs until interrupted (default: 60).", "secs", "60");
+	parser.addOption(durationOption);
+	parser.process(qapp);
+
+	if(parser.value(outSpecOption).isEmpty() || parser.value(outStreamSpecOption).isEmpty() || parser.value(inSpecOption).isEmpty())
+	{
+		fprintf(stderr, "error: out-spec, out-stream-spec, and in-spec are required\n");
+		return 1;
+	}
+
+	QUrl uri(parser.value(uriOption), QUrl::StrictMode);
+	if(!uri.isValid() || (uri.scheme() != "ws" && uri.scheme() != "wss"))
+	{
+		fprintf(stderr, "error: uri must be a valid ws or wss uri\n");
+		return 1;
+	}
+
+	bool ok;
+	int connections = parser.value(connectionsOption).toInt(&ok);
+	if(!ok || connections < 1)
+	{
+		fprintf(stderr, "error: connections must be a positive integer\n");
+		return 1;
+	}
+
+	int connectRate = parser.value(connectRateOption).toInt(&ok);
+	if(!ok || connectRate < 1)
+	{
+		fprintf(stderr, "error: connect-rate must be a positive integer\n");
+		return 1;
+	}
+
+	int channels = parser.value(channelsOption).toInt(&ok);
+	if(!ok || channels < 1)
+	{
+		fprintf(stderr, "error: channels must be a positive integer\n");
+		return 1;
+	}
+
+	QString dist = parser.value(distOption);
+	if(dist != "uniform" && dist != "zipf")
+	{
+		fprintf(stderr, "error: dist must be uniform or zipf\n");
+		return 1;
+	}
+
+	QString mode = parser.value(modeOption);
+	if(mode != "ws" && mode != "sockjs")
+	{
+		fprintf(stderr, "error: mode must be ws or sockjs\n");
+		return 1;
+	}
+
+	int duration = parser.value(durationOption).toInt(&ok);
+	if(!ok || duration < 0)
+	{
+		fprintf(stderr, "error: duration must be a non-negative integer\n");
+		return 1;
+	}
+
+	qsrand((uint)QDateTime::currentMSecsSinceEpoch());
+
+	App *app = new App(&qapp);
+	app->connections = connections;
+	app->connectRate = connectRate;
+	app->channelCount = channels;
+	app->channelPrefix = parser.value(channelPrefixOption);
+	app->zipf = (dist == "zipf");
+	app->sockJs = (mode == "sockjs");
+	app->uri = uri;
+	app->duration = duration;
+
+	printf("opening %d connections at %d/s across %d channels (%s, %s)\n", connections, connectRate, channels, qPrintable(dist), qPrintable(mode));
+
+	QObject::connect(app, &App::finished, &qapp, &QCoreApplication::quit);
+
+	if(!app->start(parser.value(outSpecOption), parser.value(outStreamSpecOption), parser.value(inSpecOption)))
+	{
+		fprintf(stderr, "error: failed to set up zhttp sockets\n");
+		return 1;
+	}
+
+	return qapp.exec();
+}
+
+#include "main.moc"